@@ -95,6 +95,7 @@ public:
             auto& exh = item.second;
             // close(exh.fd);
             m_glex.deleteTexture(exh.gltex);
+            if (exh.glsem != 0) m_glex.deleteSemaphore(exh.glsem);
             delete exh.qsg;
         }
         delete m_init_texture;
@@ -108,14 +109,17 @@ public:
     // after gl, can run at any thread
     void initVulkan(uint16_t w, uint16_t h) {
         wallpaper::RenderInitInfo info;
-        info.enable_valid_layer = m_enable_valid;
-        info.offscreen          = true;
-        info.offscreen_tiling   = m_glex.tiling();
-        info.uuid               = m_glex.uuid();
-        info.width              = w;
-        info.height             = h;
-        info.redraw_callback    = [this]() {
-            Q_EMIT this->redraw();
+        info.enable_valid_layer  = m_enable_valid;
+        info.offscreen           = true;
+        info.offscreen_tiling    = m_glex.tiling();
+        info.uuid                = m_glex.uuid();
+        info.offscreen_modifiers = m_glex.modifiers();
+        info.width               = w;
+        info.height              = h;
+        // one update queued at a time, frames presented before it runs are eaten by it
+        info.frame_ready_callback = [this](const wallpaper::FrameReady& ready) {
+            if (ready.frame_id <= m_shown_frame.load(std::memory_order_relaxed)) return;
+            if (! m_update_queued.exchange(true, std::memory_order_acq_rel)) Q_EMIT this->redraw();
         };
 
         auto cb = std::make_shared<wallpaper::FirstFrameCallback>([this]() {
@@ -138,8 +142,10 @@ public slots:
     void newTexture() {
         if (! m_scene->inited() || m_scene->exSwapchain() == nullptr) return;
 
+        m_update_queued.store(false, std::memory_order_release);
         wallpaper::ExHandle* exh = m_scene->exSwapchain()->eatFrame();
         if (exh != nullptr) {
+            m_shown_frame.store(exh->frame_id, std::memory_order_relaxed);
             int id = exh->id();
             if (texs_map.count(id) == 0) {
                 _Q_INFO("receive external texture(%dx%d) from fd: %d",
@@ -151,19 +157,25 @@ public slots:
                 uint  gltex = m_glex.genExTexture(*exh);
 
                 ex_tex.gltex = gltex;
+                ex_tex.glsem = m_glex.importSemaphore(*exh);
                 ex_tex.qsg   = createTextureFromGl(gltex, QSize(exh->width, exh->height), m_window);
                 texs_map[id] = ex_tex;
                 close(fd);
             }
             auto& newtex = texs_map.at(id);
-            if (newtex.qsg != nullptr)
-                m_texture = newtex.qsg;
-            else
-                m_texture = m_init_texture;
-
-            setTexture(m_texture);
-            markDirty(DirtyMaterial);
-            Q_EMIT textureInUse();
+            // without a wait the semaphore stays signaled, the renderer waits it off on reuse
+            if (exh->signaled && newtex.glsem != 0 && newtex.gltex != 0) {
+                m_glex.waitSemaphore(newtex.glsem, exh->dma_buf ? 0 : newtex.gltex);
+                exh->signaled = false;
+            }
+            QSGTexture* tex = newtex.qsg != nullptr ? newtex.qsg : m_init_texture;
+            // the same image drawn again only needs the window redrawn, the material holds it
+            if (tex != m_texture) {
+                m_texture = tex;
+                setTexture(m_texture);
+                markDirty(DirtyMaterial);
+                Q_EMIT textureInUse();
+            }
 
             bool expected = true;
             if (m_first_frame.compare_exchange_strong(expected, false)) {
@@ -181,12 +193,16 @@ private:
     EatFrameOp        m_eatFrameOp;
     QQuickWindow*     m_window;
     std::atomic<bool> m_first_frame;
+    // frame_id of the frame eaten last, and whether an update is on its way to eat the next
+    std::atomic<uint64_t> m_shown_frame { 0 };
+    std::atomic<bool>     m_update_queued { false };
 
     GlExtra m_glex;
 
     struct ExTex {
         // int fd;
         uint        gltex;
+        uint        glsem { 0 };
         QSGTexture* qsg;
     };
     std::unordered_map<int, ExTex> texs_map;
@@ -199,6 +215,9 @@ SceneObject::SceneObject(QQuickItem* parent)
     setFlag(ItemHasContents, true);
     m_scene->init();
     m_scene->setPropertyString(wallpaper::PROPERTY_CACHE_PATH, GetDefaultCachePath());
+
+    connect(this, &QQuickItem::visibleChanged, this, &SceneObject::updateVisible);
+    connect(this, &QQuickItem::windowChanged, this, &SceneObject::watchWindow);
 }
 
 SceneObject::~SceneObject() { _Q_INFO("Destroy sceneobject", ""); }
@@ -305,6 +324,38 @@ void SceneObject::setUserProperties(const QString& value) {
 void SceneObject::play() { m_scene->play(); }
 void SceneObject::pause() { m_scene->pause(); }
 
+// minimized, unmapped or, where the compositor tells, fully covered windows aren't exposed
+void SceneObject::updateVisible() {
+    auto* win     = window();
+    bool  visible = isVisible() && win != nullptr && win->isExposed() &&
+                   win->visibility() != QWindow::Minimized &&
+                   win->visibility() != QWindow::Hidden;
+    if (visible == m_visible) return;
+    m_visible = visible;
+    _Q_INFO("scene %s", visible ? "visible" : "hidden");
+    m_scene->setVisible(visible);
+}
+
+void SceneObject::watchWindow(QQuickWindow* win) {
+    if (m_watched) {
+        m_watched->removeEventFilter(this);
+        disconnect(m_watched.data(), nullptr, this, nullptr);
+    }
+    m_watched = win;
+    if (win != nullptr) {
+        win->installEventFilter(this);
+        connect(win, &QWindow::visibilityChanged, this, &SceneObject::updateVisible);
+    }
+    updateVisible();
+}
+
+bool SceneObject::eventFilter(QObject* obj, QEvent* event) {
+    // the window's exposed state changes as the event is handled, seen after it
+    if (obj == m_watched && event->type() == QEvent::Expose)
+        QMetaObject::invokeMethod(this, &SceneObject::updateVisible, Qt::QueuedConnection);
+    return QQuickItem::eventFilter(obj, event);
+}
+
 bool SceneObject::vulkanValid() const { return m_enable_valid; }
 void SceneObject::enableVulkanValid() { m_enable_valid = true; }
 void SceneObject::enableGenGraphviz() { SET_PROPERTY(Bool, wallpaper::PROPERTY_GRAPHIVZ, true); }
@@ -3,6 +3,7 @@
 #include <QtQuick/QQuickFramebufferObject>
 #include <QtCore/QLoggingCategory>
 #include <QtCore/QTimer>
+#include <QtCore/QPointer>
 #include <QtGui/QMouseEvent>
 #include <QtGui/QHoverEvent>
 
@@ -63,6 +64,7 @@ public:
     Q_INVOKABLE void setAcceptHover(bool);
 
 protected:
+    bool eventFilter(QObject*, QEvent*) override;
     void mousePressEvent(QMouseEvent* event) override;
     void mouseMoveEvent(QMouseEvent* event) override;
     void hoverMoveEvent(QHoverEvent* event) override;
@@ -71,6 +73,8 @@ public slots:
     void resizeFb();
     void play();
     void pause();
+    // drawing stops while the item, or its window, can't be seen
+    void updateVisible();
 
 signals:
     void sourceChanged();
@@ -100,8 +104,12 @@ public:
 
 private:
     void setScenePropertyQurl(std::string_view, QUrl);
+    void watchWindow(QQuickWindow*);
     bool m_inited { false };
     bool m_enable_valid { false };
+    bool m_visible { true };
+
+    QPointer<QQuickWindow> m_watched;
 
     std::shared_ptr<wallpaper::SceneWallpaper> m_scene { nullptr };
 
@@ -1,12 +1,16 @@
 #include "glExtra.hpp"
 #include <glad/glad.h>
 #include <vector>
+#include <unistd.h>
 #include "Utils/Logging.h"
 
 #include <QtGui/QOpenGLContext>
 #include <QtGui/QOffscreenSurface>
 #include <QtGui/QSurfaceFormat>
 
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
 using namespace wallpaper;
 
 #define CHECK_GL_ERROR_IF_DEBUG() CheckGlError(__SHORT_FILE__, __FUNCTION__, __LINE__);
@@ -39,12 +43,101 @@ inline void CheckGlError(const char* file, const char* func, int line) {
 }
 } // namespace
 
+// DRM_FORMAT_ABGR8888, the bytes of VK_FORMAT_R8G8B8A8_UNORM
+constexpr EGLint drm_format_abgr8888 { 'A' | ('B' << 8) | ('2' << 16) | ('4' << 24) };
+
+using PFN_glEGLImageTargetTexture2DOES = void (*)(GLenum, GLeglImageOES);
+
 class GlExtra::impl {
 public:
     bool                                       test;
     std::array<std::uint8_t, GL_UUID_SIZE_EXT> uuid;
+
+    // dma-buf import, set if the context is egl's and has it
+    EGLDisplay                       egl_display { EGL_NO_DISPLAY };
+    PFNEGLCREATEIMAGEKHRPROC         createImage { nullptr };
+    PFNEGLDESTROYIMAGEKHRPROC        destroyImage { nullptr };
+    PFN_glEGLImageTargetTexture2DOES imageTargetTexture { nullptr };
+    std::vector<std::uint64_t>       modifiers;
+
+    void initDmaBuf(void* get_proc_address(const char*));
+    uint importDmaBuf(const ExHandle&);
 };
 
+void GlExtra::impl::initDmaBuf(void* get_proc_address(const char*)) {
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+    QOpenGLContext* ctx = QOpenGLContext::currentContext();
+    auto*           egl = ctx ? ctx->nativeInterface<QNativeInterface::QEGLContext>() : nullptr;
+    if (egl == nullptr) return;
+
+    auto queryModifiers =
+        (PFNEGLQUERYDMABUFMODIFIERSEXTPROC)get_proc_address("eglQueryDmaBufModifiersEXT");
+    createImage        = (PFNEGLCREATEIMAGEKHRPROC)get_proc_address("eglCreateImageKHR");
+    destroyImage       = (PFNEGLDESTROYIMAGEKHRPROC)get_proc_address("eglDestroyImageKHR");
+    imageTargetTexture =
+        (PFN_glEGLImageTargetTexture2DOES)get_proc_address("glEGLImageTargetTexture2DOES");
+    if (! (queryModifiers && createImage && destroyImage && imageTargetTexture)) return;
+
+    EGLDisplay dpy = egl->display();
+    EGLint     num { 0 };
+    if (! queryModifiers(dpy, drm_format_abgr8888, 0, nullptr, nullptr, &num) || num <= 0) return;
+    std::vector<EGLuint64KHR> mods((std::size_t)num);
+    std::vector<EGLBoolean>   external_only((std::size_t)num);
+    if (! queryModifiers(dpy, drm_format_abgr8888, num, mods.data(), external_only.data(), &num))
+        return;
+    // external only ones can't be GL_TEXTURE_2D
+    for (EGLint i = 0; i < num; i++) {
+        if (! external_only[(std::size_t)i]) modifiers.push_back(mods[(std::size_t)i]);
+    }
+    if (! modifiers.empty()) egl_display = dpy;
+    LOG_INFO("gl: egl imports rgba8 dma-bufs with %d modifiers", (int)modifiers.size());
+#else
+    (void)get_proc_address;
+#endif
+}
+
+uint GlExtra::impl::importDmaBuf(const ExHandle& handle) {
+    if (egl_display == EGL_NO_DISPLAY) {
+        LOG_ERROR("gl: can't import dma-buf without egl");
+        return 0;
+    }
+    const EGLint attribs[] = {
+        EGL_WIDTH,
+        handle.width,
+        EGL_HEIGHT,
+        handle.height,
+        EGL_LINUX_DRM_FOURCC_EXT,
+        drm_format_abgr8888,
+        EGL_DMA_BUF_PLANE0_FD_EXT,
+        handle.fd,
+        EGL_DMA_BUF_PLANE0_OFFSET_EXT,
+        (EGLint)handle.offset,
+        EGL_DMA_BUF_PLANE0_PITCH_EXT,
+        (EGLint)handle.stride,
+        EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT,
+        (EGLint)(handle.modifier & 0xffffffff),
+        EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT,
+        (EGLint)(handle.modifier >> 32),
+        EGL_NONE,
+    };
+    EGLImageKHR image =
+        createImage(egl_display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, nullptr, attribs);
+    if (image == EGL_NO_IMAGE_KHR) {
+        LOG_ERROR("gl: failed to import dma-buf (fd=%d)", handle.fd);
+        return 0;
+    }
+
+    uint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    imageTargetTexture(GL_TEXTURE_2D, image);
+    CHECK_GL_ERROR_IF_DEBUG()
+    glBindTexture(GL_TEXTURE_2D, 0);
+    // the texture keeps the buffer, egl dup'ed the fd
+    destroyImage(egl_display, image);
+    return tex;
+}
+
 GlExtra::GlExtra(): pImpl(std::make_unique<impl>()) {}
 GlExtra::~GlExtra() {
     delete m_surface;
@@ -128,6 +221,7 @@ bool GlExtra::init(void* get_proc_address(const char*)) {
 
         m_is_low_gl = is_low_gl;
         pImpl->uuid = getUUID();
+        pImpl->initDmaBuf(get_proc_address);
 
         std::string gl_verdor_name { (const char*)glGetString(GL_VENDOR) };
         LOG_INFO("gl: OpenGL vendor string: %s", gl_verdor_name.c_str());
@@ -201,11 +295,19 @@ std::span<const std::uint8_t> GlExtra::uuid() const { return pImpl->uuid; }
 
 TexTiling GlExtra::tiling() const { return m_tiling; }
 
+std::span<const std::uint64_t> GlExtra::modifiers() const { return pImpl->modifiers; }
+
 uint GlExtra::genExTexture(ExHandle& handle) {
     if (handle.fd < 0 || handle.size == 0) {
         LOG_ERROR("gl: invalid ExHandle (fd=%d, size=%zu)", handle.fd, handle.size);
         return 0;
     }
+    // egl imports it to the context sampling it, no memory object
+    if (handle.dma_buf) {
+        uint tex  = pImpl->importDmaBuf(handle);
+        handle.fd = -1;
+        return tex;
+    }
 
     QOpenGLContext* prev_ctx     = nullptr;
     QSurface*       prev_surface = nullptr;
@@ -257,3 +359,37 @@ void GlExtra::deleteTexture(uint tex) {
     glDeleteTextures(1, &tex);
     CHECK_GL_ERROR_IF_DEBUG();
 }
+
+uint GlExtra::importSemaphore(ExHandle& handle) {
+    if (handle.sem_fd < 0) return 0;
+    if (! GLAD_GL_EXT_semaphore_fd) {
+        close(handle.sem_fd);
+        handle.sem_fd = -1;
+        return 0;
+    }
+
+    uint sem;
+    glGenSemaphoresEXT(1, &sem);
+    glImportSemaphoreFdEXT(sem, GL_HANDLE_TYPE_OPAQUE_FD_EXT, handle.sem_fd);
+    CHECK_GL_ERROR_IF_DEBUG()
+    // the import took the fd
+    handle.sem_fd = -1;
+    if (! glIsSemaphoreEXT(sem)) {
+        LOG_ERROR("gl: failed to import ex semaphore");
+        glDeleteSemaphoresEXT(1, &sem);
+        return 0;
+    }
+    return sem;
+}
+
+void GlExtra::waitSemaphore(uint sem, uint tex) {
+    // vulkan leaves the image in general layout, a dma-buf's has none to tell
+    GLenum layout = GL_LAYOUT_GENERAL_EXT;
+    glWaitSemaphoreEXT(sem, 0, nullptr, tex != 0 ? 1 : 0, &tex, &layout);
+    CHECK_GL_ERROR_IF_DEBUG()
+}
+
+void GlExtra::deleteSemaphore(uint sem) {
+    glDeleteSemaphoresEXT(1, &sem);
+    CHECK_GL_ERROR_IF_DEBUG();
+}
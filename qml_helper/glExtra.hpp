@@ -16,9 +16,16 @@ public:
     bool init(void* get_proc_address(const char*));
     uint genExTexture(wallpaper::ExHandle&);
     void deleteTexture(uint);
+    // the semaphore of the handle, 0 without one, gl owns the fd after
+    uint importSemaphore(wallpaper::ExHandle&);
+    // the current context's commands after this wait until tex is drawn
+    void waitSemaphore(uint sem, uint tex);
+    void deleteSemaphore(uint);
 
     std::span<const std::uint8_t> uuid() const;
     wallpaper::TexTiling     tiling() const;
+    // drm format modifiers of rgba8 dma-bufs egl imports as textures, empty without egl
+    std::span<const std::uint64_t> modifiers() const;
 
 private:
     class impl;
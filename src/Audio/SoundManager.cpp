@@ -1,8 +1,22 @@
 #include "Audio/SoundManager.h"
 #include "miniaudio-wrapper.hpp"
+#include "SpectrumAnalyzer.hpp"
 #include "Fs/IBinaryStream.h"
 #include "Core/Literals.hpp"
 #include "Utils/Logging.h"
+#include "Utils/MemUse.hpp"
+#include "Utils/Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
 
 using namespace wallpaper;
 using namespace wallpaper::audio;
@@ -17,48 +31,295 @@ miniaudio::DeviceDesc ToSSDesc(const SoundStream::Desc& d) {
     return { .phyChannels = d.channels, .sampleRate = d.sampleRate };
 }
 
+// Interleaved frames from one writer thread to one reader thread, without locks.
+class PcmRing : NoCopy, NoMove {
+public:
+    // no reader or writer meanwhile
+    void Reset(u32 channels, u32 frames) {
+        m_channels = channels;
+        m_frames   = frames;
+        m_data.assign((usize)channels * frames, 0.0f);
+        m_read.store(0, std::memory_order_relaxed);
+        m_write.store(0, std::memory_order_relaxed);
+    }
+    u32   Channels() const { return m_channels; }
+    usize Bytes() const { return m_data.size() * sizeof(float); }
+
+    // writer
+    u32 Free() const {
+        u64 used = m_write.load(std::memory_order_relaxed) - m_read.load(std::memory_order_acquire);
+        return m_frames - (u32)used;
+    }
+    // at most Free frames
+    void Write(const float* pcm, u32 frames) {
+        u64 w     = m_write.load(std::memory_order_relaxed);
+        u32 at    = (u32)(w % m_frames);
+        u32 first = std::min(frames, m_frames - at);
+        std::memcpy(slot(at), pcm, bytes(first));
+        std::memcpy(slot(0), pcm + (usize)first * m_channels, bytes(frames - first));
+        m_write.store(w + frames, std::memory_order_release);
+    }
+    // reader, up to frames in place, the frames there
+    u32 Peek(std::array<miniaudio::PcmSpan, 2>& spans, u32 frames) {
+        u64 r     = m_read.load(std::memory_order_relaxed);
+        u32 n     = std::min(frames, (u32)(m_write.load(std::memory_order_acquire) - r));
+        u32 at    = n > 0 ? (u32)(r % m_frames) : 0;
+        u32 first = std::min(n, m_frames - at);
+        spans[0]  = { slot(at), first };
+        spans[1]  = { slot(0), n - first };
+        return n;
+    }
+    // reader, at most what Peek gave
+    void Consume(u32 frames) {
+        m_read.store(m_read.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+    }
+
+private:
+    float* slot(u32 frame) { return m_data.data() + (usize)frame * m_channels; }
+    usize  bytes(u32 frames) const { return (usize)frames * m_channels * sizeof(float); }
+
+    u32                m_channels { 0 };
+    u32                m_frames { 0 };
+    std::vector<float> m_data;
+    std::atomic<u64>   m_read { 0 };
+    std::atomic<u64>   m_write { 0 };
+};
+
 } // namespace
 
+// The device callback only copies out of the ring, the stream is decoded into it on the feeder
+// thread, opening and switching files there too.
 class Channel_Impl : public miniaudio::Channel {
 public:
-    Channel_Impl(std::unique_ptr<SoundStream>&& ss): m_ss(std::move(ss)) {}
+    // seconds decoded ahead, and in one go
+    constexpr static float RingSeconds { 0.5f };
+    constexpr static u32   ChunkFrames { 1024 };
+
+    Channel_Impl(std::unique_ptr<SoundStream>&& ss): m_gain(ss->Gain()), m_ss(std::move(ss)) {}
     virtual ~Channel_Impl() = default;
 
-    ma_uint64 NextPcmData(void* pData, ma_uint32 frameCount) override {
-        return m_ss->NextPcmData(pData, frameCount);
+    // real time, less than asked while the feeder is behind, the rest stays silent
+    ma_uint32 Peek(std::array<miniaudio::PcmSpan, 2>& spans, ma_uint32 frameCount) override {
+        if (m_ring.Channels() == 0) return 0;
+        return m_ring.Peek(spans, frameCount);
     }
+    void  Consume(ma_uint32 frames) override { m_ring.Consume(frames); }
+    bool  Ended() const override { return m_ended.load(std::memory_order_acquire); }
+    float Gain() const override { return m_gain; }
+    // not while the device reads the channel
     void PassDeviceDesc(const miniaudio::DeviceDesc& desc) override {
+        std::unique_lock<std::mutex> lock { m_fill_lock };
         m_ss->PassDesc(ToSSDesc(desc));
+        m_ring.Reset(desc.phyChannels, (u32)((float)desc.sampleRate * RingSeconds));
+        m_scratch.assign((usize)ChunkFrames * desc.phyChannels, 0.0f);
+        m_held.set(m_ring.Bytes() + m_scratch.size() * sizeof(float));
+        m_ended.store(false, std::memory_order_release);
+    }
+
+    // feeder thread, false once the stream ended
+    bool Fill() {
+        std::unique_lock<std::mutex> lock { m_fill_lock };
+        if (m_ring.Channels() == 0) return true;
+        while (! m_ended.load(std::memory_order_relaxed) && m_ring.Free() >= ChunkFrames) {
+            u32 frames = (u32)m_ss->NextPcmData(m_scratch.data(), ChunkFrames);
+            if (frames == 0)
+                m_ended.store(true, std::memory_order_release);
+            else
+                m_ring.Write(m_scratch.data(), std::min(frames, ChunkFrames));
+        }
+        return ! m_ended.load(std::memory_order_relaxed);
     }
 
 private:
-    miniaudio::DeviceDesc        m_desc;
+    const float                  m_gain;
     std::unique_ptr<SoundStream> m_ss;
+
+    std::mutex         m_fill_lock;
+    PcmRing            m_ring;
+    std::vector<float> m_scratch;
+    std::atomic<bool>  m_ended { false };
+    // the ring and the scratch
+    memuse::Held m_held { memuse::Pool::AudioDecoders };
 };
 
-struct BStreamWrapper {
-    std::shared_ptr<wallpaper::fs::IBinaryStream> stream;
-    size_t                                        Read(void* pBufferOut, size_t bytesToRead) {
-                                               size_t reads = stream->Read(pBufferOut, bytesToRead);
-                                               // LOG_INFO("r:%u, %u",bytesToRead, reads);
-                                               return reads;
+// One thread topping up the rings of a manager's channels, started with the first. Idle while
+// the device doesn't play, channels keep their place meanwhile.
+class StreamFeeder : NoCopy, NoMove {
+public:
+    constexpr static auto Period { std::chrono::milliseconds(10) };
+
+    ~StreamFeeder() {
+        {
+            std::unique_lock<std::mutex> lock { m_lock };
+            m_stop = true;
+        }
+        m_wake.notify_one();
+        if (m_thread.joinable()) m_thread.join();
+    }
+
+    void Add(std::shared_ptr<Channel_Impl> chn) {
+        {
+            std::unique_lock<std::mutex> lock { m_lock };
+            m_channels.push_back(std::move(chn));
+            if (! m_thread.joinable()) m_thread = std::thread(&StreamFeeder::loop, this);
+        }
+        m_wake.notify_one();
+    }
+    // returns once no channel is being decoded
+    void Clear() {
+        std::unique_lock<std::mutex> lock { m_lock };
+        m_channels.clear();
+    }
+    void SetIdle(bool idle) {
+        {
+            std::unique_lock<std::mutex> lock { m_lock };
+            m_idle = idle;
+        }
+        m_wake.notify_one();
+    }
+    void Take(StreamFeeder& other) {
+        std::vector<std::shared_ptr<Channel_Impl>> channels;
+        {
+            std::unique_lock<std::mutex> lock { other.m_lock };
+            channels.swap(other.m_channels);
+        }
+        for (auto& chn : channels) Add(std::move(chn));
+    }
+
+private:
+    void loop() {
+        TRACE_THREAD("audio feeder");
+        std::unique_lock<std::mutex> lock { m_lock };
+        while (! m_stop) {
+            if (m_idle) {
+                m_wake.wait(lock, [this]() {
+                    return m_stop || ! m_idle;
+                });
+                continue;
+            }
+            std::erase_if(m_channels, [](auto& chn) {
+                return ! chn->Fill();
+            });
+            m_wake.wait_for(lock, Period);
+        }
+    }
+
+    std::mutex                                 m_lock;
+    std::condition_variable                    m_wake;
+    bool                                       m_stop { false };
+    bool                                       m_idle { true };
+    std::vector<std::shared_ptr<Channel_Impl>> m_channels;
+    std::thread                                m_thread;
+};
+
+// What the decoder reads through. Miniaudio asks for a few bytes at a time and seeks a lot, each
+// becoming an fread or fseek on the pkg. A stream that can map its content is read straight from
+// memory, any other goes through a read ahead buffer, seeks inside it don't touch the stream.
+class BStreamWrapper {
+public:
+    constexpr static usize BufferSize { 64 * 1024 };
+
+    explicit BStreamWrapper(std::shared_ptr<wallpaper::fs::IBinaryStream> s)
+        : stream(std::move(s)) {
+        m_size = std::max<idx>(stream->Size(), 0);
+        m_map  = stream->TryMapView(0, (usize)m_size);
+        m_pos  = stream->Tell();
+    }
+
+    size_t Read(void* pBufferOut, size_t bytesToRead) {
+        auto* out = static_cast<uint8_t*>(pBufferOut);
+        if (! m_map.empty()) {
+            usize n = std::min<usize>(bytesToRead, (usize)std::max<idx>(m_size - m_pos, 0));
+            std::memcpy(out, m_map.data() + m_pos, n);
+            m_pos += (idx)n;
+            return n;
+        }
+        usize done = 0;
+        while (done < bytesToRead) {
+            if (m_cursor < m_filled) {
+                usize n = std::min(m_filled - m_cursor, bytesToRead - done);
+                std::memcpy(out + done, m_buffer.data() + m_cursor, n);
+                m_cursor += n;
+                done += n;
+                continue;
+            }
+            if (! Sync()) break;
+            // big reads skip the buffer
+            if (bytesToRead - done >= BufferSize) {
+                usize n = stream->Read(out + done, bytesToRead - done);
+                m_pos += (idx)n;
+                done += n;
+                break;
+            }
+            m_buffer.resize(BufferSize);
+            m_held.set(BufferSize);
+            m_base   = m_pos;
+            m_filled = stream->Read(m_buffer.data(), BufferSize);
+            m_cursor = 0;
+            m_pos += (idx)m_filled;
+            if (m_filled == 0) break;
+        }
+        return done;
     }
     bool Seek(idx offset, ma_seek_origin origin) {
-        bool result { false };
+        idx to { 0 };
         switch (origin) {
-        case ma_seek_origin_start: result = stream->SeekSet(offset); break;
-        case ma_seek_origin_current: result = stream->SeekCur(offset); break;
-        case ma_seek_origin_end: result = stream->SeekEnd(offset); break;
+        case ma_seek_origin_start: to = offset; break;
+        case ma_seek_origin_current: to = Tell() + offset; break;
+        case ma_seek_origin_end: to = m_size + offset; break;
+        }
+        if (to < 0 || to > m_size) return false;
+        if (! m_map.empty()) {
+            m_pos = to;
+            return true;
         }
-        // LOG_INFO("s:%u, %d",offset, result);
-        return result;
+        // inside what's buffered
+        if (m_filled > 0 && to >= m_base && to <= m_base + (idx)m_filled) {
+            m_cursor = (usize)(to - m_base);
+            return true;
+        }
+        m_filled = 0;
+        m_cursor = 0;
+        if (! stream->SeekSet(to)) return false;
+        m_pos = to;
+        return true;
+    }
+
+private:
+    // where the decoder is
+    idx Tell() const {
+        if (! m_map.empty() || m_filled == 0) return m_pos;
+        return m_base + (idx)m_cursor;
     }
+    // the stream back at the decoder's place after reading from a buffer seeked back into
+    bool Sync() {
+        idx at   = Tell();
+        m_filled = 0;
+        m_cursor = 0;
+        if (at == m_pos) return true;
+        if (! stream->SeekSet(at)) return false;
+        m_pos = at;
+        return true;
+    }
+
+    std::shared_ptr<wallpaper::fs::IBinaryStream> stream;
+    idx                                           m_size { 0 };
+    std::span<const uint8_t>                      m_map;
+    // the stream's position, of the mapped content if mapped
+    idx m_pos { 0 };
+    // the buffer holds m_filled bytes from m_base, the decoder is at m_cursor in it
+    std::vector<uint8_t> m_buffer;
+    idx                  m_base { 0 };
+    usize                m_filled { 0 };
+    usize                m_cursor { 0 };
+    memuse::Held         m_held { memuse::Pool::AudioDecoders };
 };
 
 template<typename T>
 class SoundStream_impl : public SoundStream {
 public:
-    SoundStream_impl(std::unique_ptr<T>&& ss): m_ss(std::move(ss)) {}
+    SoundStream_impl(std::unique_ptr<T>&& ss)
+        : m_ss(std::move(ss)), m_held(memuse::Pool::AudioDecoders, sizeof(T)) {}
     virtual ~SoundStream_impl() {}
 
     uint64_t NextPcmData(void* pData, uint32_t frameCount) override {
@@ -68,6 +329,8 @@ public:
 
 private:
     std::unique_ptr<T> m_ss;
+    // the decoder itself, what it allocates counts as it does
+    memuse::Held m_held;
 };
 
 std::unique_ptr<SoundStream>
@@ -82,9 +345,40 @@ wallpaper::audio::CreateSoundStream(std::shared_ptr<wallpaper::fs::IBinaryStream
 
 class SoundManager::impl : NoCopy, NoMove {
 public:
-    impl(): device() {};
+    impl(): device(), spectrum(std::make_shared<AudioSpectrum>()), analyzer(spectrum) {};
     ~impl() = default;
+    // stops before the device, which may hold the channels it feeds
     miniaudio::Device device {};
+    StreamFeeder      feeder;
+
+    std::shared_ptr<AudioSpectrum> spectrum;
+    SpectrumAnalyzer               analyzer;
+
+    // Init was called, the device opens once there's a stream and it's not muted
+    bool wanted { false };
+    bool playing { false };
+
+    // plays only with something to play, opened on the first need
+    void update() {
+        bool need = wanted && ! device.Muted() && device.HasChannels();
+        if (need && ! device.IsInited()) {
+            if (device.Init({})) {
+                analyzer.Init(device.GetDesc().sampleRate);
+                device.SetTap([this](const float* pcm, ma_uint32 frames, ma_uint32 channels) {
+                    analyzer.Feed(pcm, frames, channels);
+                });
+            } else
+                need = false;
+        }
+        bool was = device.IsStarted();
+        if (need && playing)
+            device.Start();
+        else
+            device.Stop();
+        // nothing is heard, the bands drop
+        if (was && ! device.IsStarted()) analyzer.Reset();
+        feeder.SetIdle(! device.IsStarted());
+    }
 };
 
 SoundManager::SoundManager(): pImpl(std::make_unique<impl>()) {}
@@ -92,7 +386,10 @@ SoundManager::~SoundManager() {}
 
 void SoundManager::MountStream(std::unique_ptr<SoundStream>&& ss) {
     // if(!IsInited()) return;
-    pImpl->device.MountChannel(std::make_unique<Channel_Impl>(std::move(ss)));
+    auto chn = std::make_shared<Channel_Impl>(std::move(ss));
+    pImpl->device.MountChannel(chn);
+    pImpl->feeder.Add(std::move(chn));
+    pImpl->update();
 }
 
 void SoundManager::Test(std::shared_ptr<fs::IBinaryStream> stream) {
@@ -100,26 +397,41 @@ void SoundManager::Test(std::shared_ptr<fs::IBinaryStream> stream) {
     auto           decoder = std::make_unique<miniaudio::Decoder<BStreamWrapper>>(std::move(sw));
 }
 bool SoundManager::Init() {
-    if (Muted()) {
-        LOG_INFO("muted, not init sound device");
-        return false;
-    }
-    return pImpl->device.Init({});
+    if (Muted()) LOG_INFO("muted, not init sound device");
+    pImpl->wanted = true;
+    pImpl->update();
+    return true;
+}
+bool SoundManager::IsInited() const { return pImpl->wanted; }
+void SoundManager::Play() {
+    pImpl->playing = true;
+    pImpl->update();
+}
+void SoundManager::Pause() {
+    pImpl->playing = false;
+    pImpl->update();
+}
+
+void SoundManager::UnMountAll() {
+    pImpl->device.UnmountAll();
+    pImpl->feeder.Clear();
+    pImpl->update();
+}
+void SoundManager::TakeStreams(SoundManager& o) {
+    pImpl->device.TakeChannels(o.pImpl->device);
+    pImpl->feeder.Take(o.pImpl->feeder);
+    pImpl->update();
 }
-bool SoundManager::IsInited() const { return pImpl->device.IsInited(); }
-void SoundManager::Play() { pImpl->device.Start(); }
-void SoundManager::Pause() { pImpl->device.Stop(); }
+bool SoundManager::HasStreams() const { return pImpl->device.HasChannels(); }
+
+std::shared_ptr<AudioSpectrum> SoundManager::Spectrum() const { return pImpl->spectrum; }
 
-void  SoundManager::UnMountAll() { pImpl->device.UnmountAll(); }
 float SoundManager::Volume() const { return pImpl->device.Volume(); }
 
 bool SoundManager::Muted() const { return pImpl->device.Muted(); }
 void SoundManager::SetMuted(bool v) {
+    // stopped while muted, streams go on from where they were after
     pImpl->device.SetMuted(v);
-    if (! Muted()) {
-        Init();
-    } else {
-        pImpl->device.UnInit();
-    }
+    pImpl->update();
 }
 void SoundManager::SetVolume(float v) { pImpl->device.SetVolume(v); }
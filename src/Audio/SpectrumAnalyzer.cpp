@@ -0,0 +1,144 @@
+#include "SpectrumAnalyzer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+
+using namespace wallpaper::audio;
+
+namespace
+{
+constexpr uint32_t Bands { 64 };
+constexpr float    LowHz { 30.0f };
+constexpr float    HighHz { 16000.0f };
+// the bands are 0 at MinDb and 1 at 0 db
+constexpr float MinDb { -60.0f };
+constexpr float DecaySeconds { 0.1f };
+
+float Level(float magnitude) {
+    float db = 20.0f * std::log10(std::max(magnitude, 1e-6f));
+    return std::clamp((db - MinDb) / -MinDb, 0.0f, 1.0f);
+}
+
+template<size_t N, size_t M>
+void Halve(const std::array<float, N>& from, std::array<float, M>& to) {
+    constexpr size_t step = N / M;
+    for (size_t i = 0; i < M; i++) {
+        float sum = 0.0f;
+        for (size_t j = 0; j < step; j++) sum += from[i * step + j];
+        to[i] = sum / step;
+    }
+}
+} // namespace
+
+SpectrumAnalyzer::SpectrumAnalyzer(std::shared_ptr<AudioSpectrum> spectrum)
+    : m_spectrum(std::move(spectrum)) {}
+
+void SpectrumAnalyzer::Init(uint32_t sampleRate) {
+    if (sampleRate == 0 || sampleRate == m_rate) return;
+    m_rate  = sampleRate;
+    m_decay = std::exp(-(float)Hop / (DecaySeconds * (float)sampleRate));
+
+    m_left.assign(Size, 0.0f);
+    m_right.assign(Size, 0.0f);
+    m_bins.assign(Size, {});
+    m_window.resize(Size);
+    for (uint32_t i = 0; i < Size; i++) {
+        m_window[i] =
+            0.5f - 0.5f * std::cos(2.0f * std::numbers::pi_v<float> * (float)i / (float)(Size - 1));
+    }
+
+    uint32_t bits = std::countr_zero(Size);
+    m_reverse.resize(Size);
+    for (uint32_t i = 0; i < Size; i++) {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; b++) r |= ((i >> b) & 1u) << (bits - 1 - b);
+        m_reverse[i] = r;
+    }
+    m_twiddle.resize(Size / 2);
+    for (uint32_t i = 0; i < Size / 2; i++) {
+        m_twiddle[i] = std::polar(1.0f, -2.0f * std::numbers::pi_v<float> * (float)i / (float)Size);
+    }
+
+    // log spaced, a bin at least each
+    const float high = std::min(HighHz, (float)sampleRate / 2.0f);
+    m_edges.resize(Bands + 1);
+    m_edges[0] = 1;
+    for (uint32_t b = 1; b <= Bands; b++) {
+        float    hz  = LowHz * std::pow(high / LowHz, (float)b / (float)Bands);
+        uint32_t bin = (uint32_t)std::lround(hz * (float)Size / (float)sampleRate);
+        m_edges[b]   = std::min(std::max(bin, m_edges[b - 1] + 1), Size / 2);
+    }
+    Reset();
+}
+
+void SpectrumAnalyzer::Reset() {
+    if (m_rate == 0) return;
+    std::fill(m_left.begin(), m_left.end(), 0.0f);
+    std::fill(m_right.begin(), m_right.end(), 0.0f);
+    m_pos   = 0;
+    m_since = 0;
+    m_smooth_left.fill(0.0f);
+    m_smooth_right.fill(0.0f);
+    Publish();
+}
+
+void SpectrumAnalyzer::Feed(const float* pcm, uint32_t frames, uint32_t channels) {
+    if (m_rate == 0 || channels == 0) return;
+    const uint32_t right = channels > 1 ? 1 : 0;
+    for (uint32_t i = 0; i < frames; i++) {
+        m_left[m_pos]  = pcm[i * channels];
+        m_right[m_pos] = pcm[i * channels + right];
+        m_pos          = (m_pos + 1) % Size;
+        if (++m_since == Hop) {
+            m_since = 0;
+            Analyze();
+        }
+    }
+}
+
+void SpectrumAnalyzer::Analyze() {
+    for (uint32_t i = 0; i < Size; i++) {
+        uint32_t at          = (m_pos + i) % Size;
+        m_bins[m_reverse[i]] = { m_left[at] * m_window[i], m_right[at] * m_window[i] };
+    }
+    for (uint32_t len = 2; len <= Size; len <<= 1) {
+        const uint32_t half = len / 2;
+        const uint32_t step = Size / len;
+        for (uint32_t i = 0; i < Size; i += len) {
+            for (uint32_t j = 0; j < half; j++) {
+                auto t               = m_twiddle[j * step] * m_bins[i + j + half];
+                m_bins[i + j + half] = m_bins[i + j] - t;
+                m_bins[i + j] += t;
+            }
+        }
+    }
+
+    // z = l + i r, so L(k) = (Z(k) + conj Z(N - k)) / 2 and R(k) = (Z(k) - conj Z(N - k)) / 2i,
+    // the hann window sums to N / 2, amplitude is 2 |X| / that
+    const float scale = 2.0f / Size;
+    for (uint32_t b = 0; b < Bands; b++) {
+        float left = 0.0f, right = 0.0f;
+        for (uint32_t k = m_edges[b]; k < m_edges[b + 1]; k++) {
+            auto z  = m_bins[k];
+            auto zn = std::conj(m_bins[Size - k]);
+            left    = std::max(left, std::abs(z + zn));
+            right   = std::max(right, std::abs(z - zn));
+        }
+        m_smooth_left[b]  = std::max(Level(left * scale), m_smooth_left[b] * m_decay);
+        m_smooth_right[b] = std::max(Level(right * scale), m_smooth_right[b] * m_decay);
+    }
+    Publish();
+}
+
+void SpectrumAnalyzer::Publish() {
+    auto& bands   = m_spectrum->back();
+    bands.left64  = m_smooth_left;
+    bands.right64 = m_smooth_right;
+    Halve(bands.left64, bands.left32);
+    Halve(bands.right64, bands.right32);
+    Halve(bands.left64, bands.left16);
+    Halve(bands.right64, bands.right16);
+    m_spectrum->publish();
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "Audio/AudioSpectrum.h"
+#include "Core/NoCopyMove.hpp"
+
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace wallpaper
+{
+namespace audio
+{
+
+// Bands of the mix the device plays, fed from its callback. Every Hop frames the last Size go
+// through one fft, left as the real part and right as the imaginary one, the bands are smoothed
+// and published to the spectrum.
+class SpectrumAnalyzer : NoCopy, NoMove {
+public:
+    constexpr static uint32_t Size { 1024 };
+    constexpr static uint32_t Hop { 512 };
+
+    explicit SpectrumAnalyzer(std::shared_ptr<AudioSpectrum>);
+
+    // not while fed, the tables are for the rate
+    void Init(uint32_t sampleRate);
+    // from the device callback, interleaved frames, the first two channels are left and right
+    void Feed(const float* pcm, uint32_t frames, uint32_t channels);
+    // not while fed, the bands go to 0
+    void Reset();
+
+private:
+    void Analyze();
+    void Publish();
+
+    std::shared_ptr<AudioSpectrum> m_spectrum;
+    uint32_t                       m_rate { 0 };
+    // of the last bands each hop, they fall off over about DecaySeconds
+    float m_decay { 0.0f };
+
+    // the last Size frames, m_pos is the oldest
+    std::vector<float> m_left;
+    std::vector<float> m_right;
+    uint32_t           m_pos { 0 };
+    uint32_t           m_since { 0 };
+
+    std::vector<float>               m_window;
+    std::vector<uint32_t>            m_reverse;
+    std::vector<std::complex<float>> m_twiddle;
+    std::vector<std::complex<float>> m_bins;
+    // first bin of each band, and one past the last
+    std::vector<uint32_t> m_edges;
+
+    std::array<float, 64> m_smooth_left {};
+    std::array<float, 64> m_smooth_right {};
+};
+
+} // namespace audio
+} // namespace wallpaper
@@ -0,0 +1,51 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include "Core/NoCopyMove.hpp"
+
+namespace wallpaper
+{
+namespace audio
+{
+
+// what's played in log spaced bands from low to high, 0 to 1, the g_AudioSpectrum uniforms
+struct SpectrumBands {
+    std::array<float, 16> left16 {};
+    std::array<float, 16> right16 {};
+    std::array<float, 32> left32 {};
+    std::array<float, 32> right32 {};
+    std::array<float, 64> left64 {};
+    std::array<float, 64> right64 {};
+};
+
+// The latest bands from the audio thread to one reader at a time, without locks. The writer fills
+// the back buffer and swaps it with the middle one, the reader swaps the middle one to the front
+// if it's newer.
+class AudioSpectrum : NoCopy, NoMove {
+public:
+    // writer
+    SpectrumBands& back() { return m_bands[m_back]; }
+    void           publish() {
+        m_back = m_middle.exchange(m_back | Fresh, std::memory_order_acq_rel) & Index;
+    }
+
+    // reader, the newest bands published, all 0 before the first
+    const SpectrumBands& latest() {
+        if (m_middle.load(std::memory_order_relaxed) & Fresh)
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & Index;
+        return m_bands[m_front];
+    }
+
+private:
+    constexpr static uint32_t Index { 3 };
+    constexpr static uint32_t Fresh { 4 };
+
+    std::array<SpectrumBands, 3> m_bands {};
+    uint32_t                     m_back { 0 };
+    std::atomic<uint32_t>        m_middle { 1 };
+    uint32_t                     m_front { 2 };
+};
+
+} // namespace audio
+} // namespace wallpaper
@@ -14,6 +14,7 @@ class IBinaryStream;
 }
 namespace audio
 {
+class AudioSpectrum;
 
 class SoundStream : NoCopy, NoMove {
 public:
@@ -28,6 +29,8 @@ public:
 
     virtual uint64_t NextPcmData(void* pData, uint32_t frameCount) = 0;
     virtual void     PassDesc(const Desc&)                         = 0;
+    // applied as it's mixed, once with the master volume
+    virtual float Gain() const { return 1.0f; }
 };
 std::unique_ptr<SoundStream> CreateSoundStream(std::shared_ptr<fs::IBinaryStream>,
                                                const SoundStream::Desc&);
@@ -38,12 +41,19 @@ public:
     ~SoundManager();
     void MountStream(std::unique_ptr<SoundStream>&&);
     void UnMountAll();
+    // moves the streams mounted on another manager here, it needn't be inited
+    void TakeStreams(SoundManager&);
+    bool HasStreams() const;
     void Test(std::shared_ptr<fs::IBinaryStream>);
+    // the device is opened once a stream is mounted and not muted, and only runs while playing
     bool Init();
     bool IsInited() const;
     void Play();
     void Pause();
 
+    // bands of what the device plays, read by one reader at a time, all 0 while it's stopped
+    std::shared_ptr<AudioSpectrum> Spectrum() const;
+
     float Volume() const;
     bool  Muted() const;
     void  SetMuted(bool);
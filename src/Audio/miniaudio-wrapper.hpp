@@ -1,5 +1,7 @@
 #pragma once
+#include <array>
 #include <memory>
+#include <span>
 #include <vector>
 #include <mutex>
 #include <cstdint>
@@ -8,9 +10,14 @@
 #include <cstring>
 #include <atomic>
 #include <utility>
+#include <cstdlib>
+#include <malloc.h>
 
 #include "Utils/Logging.h"
+#include "Utils/MemUse.hpp"
+#include "Utils/Trace.h"
 #include "Core/NoCopyMove.hpp"
+#include "Core/Simd.hpp"
 
 #define MA_NO_WASAPI
 #define MA_NO_DSOUND
@@ -34,6 +41,28 @@ struct DeviceDesc {
     static const ma_format format { ma_format_f32 };
 };
 
+// what decoders allocate counts in memuse, sizes are asked of malloc as free isn't told them
+inline void* CountedMalloc(size_t size, void*) {
+    namespace memuse = wallpaper::memuse;
+    void* p          = std::malloc(size);
+    if (p != nullptr) memuse::Add(memuse::Pool::AudioDecoders, malloc_usable_size(p));
+    return p;
+}
+inline void* CountedRealloc(void* p, size_t size, void*) {
+    namespace memuse = wallpaper::memuse;
+    const size_t was = p != nullptr ? malloc_usable_size(p) : 0;
+    void*        to  = std::realloc(p, size);
+    // a size of 0 freed it
+    if (to != nullptr || size == 0) memuse::Sub(memuse::Pool::AudioDecoders, was);
+    if (to != nullptr) memuse::Add(memuse::Pool::AudioDecoders, malloc_usable_size(to));
+    return to;
+}
+inline void CountedFree(void* p, void*) {
+    namespace memuse = wallpaper::memuse;
+    if (p != nullptr) memuse::Sub(memuse::Pool::AudioDecoders, malloc_usable_size(p));
+    std::free(p);
+}
+
 template<typename TStream>
 class Decoder : NoCopy {
 public:
@@ -50,6 +79,7 @@ public:
     bool Init(const DeviceDesc& d) {
         ma_decoder_config config =
             ma_decoder_config_init(DeviceDesc::format, d.phyChannels, d.sampleRate);
+        config.allocationCallbacks = { nullptr, CountedMalloc, CountedRealloc, CountedFree };
         ma_result result = ma_decoder_init(Read, Seek, this, &config, &m_decoder);
         m_inited         = result == MA_SUCCESS;
         if (! m_inited) {
@@ -82,15 +112,93 @@ private:
     TStream    m_stream;
 };
 
+// interleaved frames at the device's desc
+struct PcmSpan {
+    const float* data { nullptr };
+    ma_uint32    frames { 0 };
+};
+
 class Channel : NoCopy {
 public:
     Channel()          = default;
     virtual ~Channel() = default;
 
-    virtual ma_uint64 NextPcmData(void* pData, ma_uint32 frameCount) = 0;
-    virtual void      PassDeviceDesc(const DeviceDesc&)              = 0;
+    // real time, up to frameCount frames ready to mix in one or two pieces, the frames of both
+    virtual ma_uint32 Peek(std::array<PcmSpan, 2>&, ma_uint32 frameCount) = 0;
+    // real time, the peeked frames were mixed
+    virtual void Consume(ma_uint32 frames) = 0;
+    // real time, nothing comes after what's ready
+    virtual bool  Ended() const                     = 0;
+    virtual float Gain() const                      = 0;
+    virtual void  PassDeviceDesc(const DeviceDesc&) = 0;
+};
+
+// what a channel gives to one callback
+struct MixSource {
+    std::array<PcmSpan, 2> spans;
+    ma_uint32              frames { 0 };
+    float                  gain { 1.0f };
 };
 
+// out = sum of gains[s] * ins[s], or added to out, n floats
+inline void MixBlock(float* out, size_t n, std::span<const float* const> ins,
+                     std::span<const float> gains, bool accumulate) {
+    using namespace wallpaper::simd;
+    ForEach(n, [&]<typename F>(size_t i) {
+        F acc = accumulate ? F::Load(out + i) : F::Set(0.0f);
+        for (size_t s = 0; s < ins.size(); s++) acc = acc + F::Load(ins[s] + i) * F::Set(gains[s]);
+        acc.Store(out + i);
+    });
+}
+
+// All sources into out in one pass, output frames are split where a source's piece or data
+// ends, a source that ran out adds nothing past it.
+inline void MixSources(float* out, ma_uint32 frameCount, ma_uint32 channels,
+                       std::span<const MixSource> sources) {
+    // kernel inputs at a time, more are added in further passes
+    constexpr size_t group { 16 };
+
+    std::array<const float*, group> ins;
+    std::array<float, group>        gains;
+    ma_uint32                       pos { 0 };
+    while (pos < frameCount) {
+        ma_uint32 end { frameCount };
+        for (auto& src : sources) {
+            if (pos >= src.frames) continue;
+            ma_uint32 first = src.spans[0].frames;
+            end             = std::min(end, pos < first ? first : src.frames);
+        }
+
+        float* dst        = out + (size_t)pos * channels;
+        size_t n          = (size_t)(end - pos) * channels;
+        size_t count      = 0;
+        bool   accumulate = false;
+        for (auto& src : sources) {
+            if (pos >= src.frames) continue;
+            ma_uint32 first = src.spans[0].frames;
+            ins[count]      = pos < first ? src.spans[0].data + (size_t)pos * channels
+                                          : src.spans[1].data + (size_t)(pos - first) * channels;
+            gains[count]    = src.gain;
+            if (++count == group) {
+                MixBlock(dst, n, ins, gains, accumulate);
+                count      = 0;
+                accumulate = true;
+            }
+        }
+        if (count > 0 || ! accumulate) {
+            MixBlock(dst,
+                     n,
+                     std::span(ins.data(), count),
+                     std::span(gains.data(), count),
+                     accumulate);
+        }
+        pos = end;
+    }
+}
+
+// sees the mix as it goes to the device, on its thread, interleaved frames
+using Tap = std::function<void(const float* pcm, ma_uint32 frames, ma_uint32 channels)>;
+
 class Device : NoCopy {
 public:
     Device() {}
@@ -102,12 +210,13 @@ public:
     }
 
 public:
+    // left stopped, channels keep what they have
     bool Init(const DeviceDesc& d) {
         if (IsInited()) return true; // already inited
         ma_result result;
         auto      config = GenMaDeviceConfig(d);
-        Stop();
-        result = ma_device_init(NULL, &config, &m_device);
+        m_running        = false;
+        result           = ma_device_init(NULL, &config, &m_device);
         if (result == MA_SUCCESS) {
             LOG_INFO("sound device inited");
         }
@@ -121,18 +230,12 @@ public:
             UnInit();
             return false;
         }
-        if (ma_device_start(&m_device) != MA_SUCCESS) {
-            LOG_ERROR("can't start sound device");
-            UnInit();
-            return false;
-        }
         {
             std::unique_lock<std::mutex> lock { m_mutex };
             for (auto& el : m_channels) {
                 el.chn->PassDeviceDesc(GetDesc());
             }
         }
-        Start();
         return true;
     }
     bool IsInited() const { return m_device.state.value != ma_device_state_uninitialized; }
@@ -140,30 +243,30 @@ public:
         if (IsInited()) {
             LOG_INFO("uninit sound device");
         }
-        UnmountAll();
+        m_running = false;
         ma_device_uninit(&m_device); // always do it
     }
-    // bool IsStarted() const { return ma_device_is_started(&m_device); }
-    // bool IsStopped() const { return ma_device_get_state(&m_device) == MA_STATE_STOPPED; }
+    bool IsStarted() const { return IsInited() && ma_device_is_started(&m_device); }
+    // not from the callback
     void Start() {
         m_running = true;
-        /*
-        if(!IsStopped()) return;
-        LOG_INFO("state: %d", ma_device_get_state(&m_device));
+        if (! IsInited() || IsStarted()) return;
         if (ma_device_start(&m_device) != MA_SUCCESS) {
             LOG_ERROR("can't start sound device");
-            //ma_device_uninit(&m_device);
+            m_running = false;
         }
-        */
     }
+    // no callbacks after, the channels stay where they are
     void Stop() {
         m_running = false;
-        /*
-        if(!IsStarted()) return;
-        LOG_INFO("state: %d", ma_device_get_state(&m_device));
-        if(ma_device_stop(&m_device) != MA_SUCCESS){
+        if (! IsStarted()) return;
+        if (ma_device_stop(&m_device) != MA_SUCCESS) {
             LOG_ERROR("can't stop sound device");
-        }*/
+        }
+    }
+    bool HasChannels() {
+        std::unique_lock<std::mutex> lock { m_mutex };
+        return ! m_channels.empty();
     }
     float Volume() const { return m_volume; }
     bool  Muted() const { return m_muted; }
@@ -177,6 +280,7 @@ public:
         {
             std::unique_lock<std::mutex> lock { m_mutex };
             m_channels.push_back(chnw);
+            m_sources.reserve(m_channels.size());
         }
     }
     void UnmountAll() {
@@ -185,6 +289,22 @@ public:
             m_channels.clear();
         }
     }
+    // moves the channels of another device here, they get this device's desc
+    void TakeChannels(Device& other) {
+        std::vector<ChannelWrap> channels;
+        {
+            std::unique_lock<std::mutex> lock { other.m_mutex };
+            channels.swap(other.m_channels);
+        }
+        for (auto& chnw : channels) chnw.chn->PassDeviceDesc(GetDesc());
+        {
+            std::unique_lock<std::mutex> lock { m_mutex };
+            for (auto& chnw : channels) m_channels.push_back(chnw);
+            m_sources.reserve(m_channels.size());
+        }
+    }
+    // not while started
+    void       SetTap(Tap tap) { m_tap = std::move(tap); }
     DeviceDesc GetDesc() const {
         return DeviceDesc { .phyChannels = m_device.playback.channels,
                             .sampleRate  = m_device.sampleRate };
@@ -195,32 +315,36 @@ private:
                               ma_uint32 frameCount) {
         Device* pDevice = static_cast<Device*>(pMaDevice->pUserData);
         if (! pDevice->IsInited()) return;
+        // the backend's thread, named on its first callback
+        thread_local bool named { false };
+        if (! named) {
+            TRACE_THREAD("audio");
+            named = true;
+        }
         pDevice->data_callback(pOutput, pInput, frameCount);
     }
     void data_callback(void* pOutput, const void* pInput, ma_uint32 frameCount) {
         (void)pInput;
         if (! m_running || m_muted) return;
-        const auto phyChannels    = m_device.playback.channels;
-        const auto framesSize     = frameCount * phyChannels;
-        const auto framesByteSize = framesSize * sizeof(float);
-        {
-            if (m_frameBuffer.size() < framesByteSize) m_frameBuffer.resize(framesByteSize);
-            // std::memset(pOutput, 0, framesByteSize);
-        }
+        wallpaper::simd::FlushDenormals flush;
         {
             std::unique_lock<std::mutex> lock { m_mutex };
 
-            float* pOutput_float = static_cast<float*>(pOutput);
-            float* pBuffer_float = reinterpret_cast<float*>(m_frameBuffer.data());
-            for (ma_uint32 i = 0; i < m_channels.size(); i++) {
-                ma_uint64 framesReaded =
-                    m_channels[i].chn->NextPcmData(m_frameBuffer.data(), frameCount);
-                if (framesReaded == 0) {
-                    m_channels[i].end = true;
-                } else {
-                    for (size_t i = 0; i < framesSize; i++)
-                        pOutput_float[i] += m_volume * pBuffer_float[i];
-                }
+            // the master volume goes into each gain, samples are touched once
+            m_sources.clear();
+            for (auto& chnw : m_channels) {
+                MixSource src;
+                src.frames = chnw.chn->Peek(src.spans, frameCount);
+                src.gain   = m_volume * chnw.chn->Gain();
+                if (src.frames == 0 && chnw.chn->Ended()) chnw.end = true;
+                m_sources.push_back(src);
+            }
+            MixSources(static_cast<float*>(pOutput),
+                       frameCount,
+                       m_device.playback.channels,
+                       m_sources);
+            for (size_t i = 0; i < m_channels.size(); i++) {
+                if (m_sources[i].frames > 0) m_channels[i].chn->Consume(m_sources[i].frames);
             }
             m_channels.erase(std::remove_if(m_channels.begin(),
                                             m_channels.end(),
@@ -229,6 +353,9 @@ private:
                                             }),
                              m_channels.end());
         }
+        if (m_tap) {
+            m_tap(static_cast<const float*>(pOutput), frameCount, m_device.playback.channels);
+        }
     }
     ma_device_config GenMaDeviceConfig(const DeviceDesc& d) {
         ma_device_config config  = ma_device_config_init(ma_device_type_playback);
@@ -253,7 +380,9 @@ private:
     bool  m_muted { false };
 
     std::vector<ChannelWrap> m_channels;
-    std::vector<uint8_t>     m_frameBuffer;
+    // of m_channels, reserved as they're mounted
+    std::vector<MixSource> m_sources;
+    Tap                    m_tap;
 };
 
 } // namespace miniaudio
@@ -0,0 +1,164 @@
+#include "BcEncode.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+using namespace wallpaper;
+
+namespace
+{
+using Block = std::array<std::array<uint8_t, 4>, 16>;
+
+u16 To565(int r, int g, int b) {
+    return (u16)((((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) |
+                 ((b * 31 + 127) / 255));
+}
+
+std::array<int, 3> From565(u16 c) {
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    return { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2) };
+}
+
+void LoadBlock(const uint8_t* rgba, i32 w, i32 h, i32 bx, i32 by, Block& block) {
+    for (i32 y = 0; y < 4; y++) {
+        i32 sy = std::min(by + y, h - 1);
+        for (i32 x = 0; x < 4; x++) {
+            i32 sx = std::min(bx + x, w - 1);
+            auto* src = rgba + ((usize)sy * (usize)w + (usize)sx) * 4;
+            std::memcpy(block[(usize)(y * 4 + x)].data(), src, 4);
+        }
+    }
+}
+
+void EncodeColor(const Block& block, uint8_t* out) {
+    std::array<int, 3> lo { 255, 255, 255 }, hi { 0, 0, 0 };
+    for (auto& p : block) {
+        for (usize c = 0; c < 3; c++) {
+            lo[c] = std::min<int>(lo[c], p[c]);
+            hi[c] = std::max<int>(hi[c], p[c]);
+        }
+    }
+    // red and blue against green, the box diagonal follows how they vary together
+    std::array<int, 3> center { (lo[0] + hi[0]) / 2, (lo[1] + hi[1]) / 2, (lo[2] + hi[2]) / 2 };
+    int                cov_r { 0 }, cov_b { 0 };
+    for (auto& p : block) {
+        int dg = p[1] - center[1];
+        cov_r += (p[0] - center[0]) * dg;
+        cov_b += (p[2] - center[2]) * dg;
+    }
+    if (cov_r < 0) std::swap(lo[0], hi[0]);
+    if (cov_b < 0) std::swap(lo[2], hi[2]);
+    // inset by a 16th of the range, the ends are rarely hit exactly
+    for (usize c = 0; c < 3; c++) {
+        int inset = (hi[c] - lo[c]) / 16;
+        hi[c]     = std::clamp(hi[c] - inset, 0, 255);
+        lo[c]     = std::clamp(lo[c] + inset, 0, 255);
+    }
+
+    u16 c0 = To565(hi[0], hi[1], hi[2]);
+    u16 c1 = To565(lo[0], lo[1], lo[2]);
+    // c0 > c1 selects four colors
+    if (c0 < c1) std::swap(c0, c1);
+
+    u32 indices { 0 };
+    if (c0 != c1) {
+        auto                              e0 = From565(c0), e1 = From565(c1);
+        std::array<std::array<int, 3>, 4> palette;
+        for (usize c = 0; c < 3; c++) {
+            palette[0][c] = e0[c];
+            palette[1][c] = e1[c];
+            palette[2][c] = (2 * e0[c] + e1[c]) / 3;
+            palette[3][c] = (e0[c] + 2 * e1[c]) / 3;
+        }
+        for (usize i = 0; i < 16; i++) {
+            u32 best { 0 };
+            int best_d { INT32_MAX };
+            for (u32 k = 0; k < 4; k++) {
+                int d = 0;
+                for (usize c = 0; c < 3; c++) {
+                    int v = block[i][c] - palette[k][c];
+                    d += v * v;
+                }
+                if (d < best_d) {
+                    best_d = d;
+                    best   = k;
+                }
+            }
+            indices |= best << (i * 2);
+        }
+    }
+    out[0] = (uint8_t)(c0 & 0xff);
+    out[1] = (uint8_t)(c0 >> 8);
+    out[2] = (uint8_t)(c1 & 0xff);
+    out[3] = (uint8_t)(c1 >> 8);
+    for (usize i = 0; i < 4; i++) out[4 + i] = (uint8_t)(indices >> (i * 8));
+}
+
+void EncodeAlpha(const Block& block, uint8_t* out) {
+    int a0 { 0 }, a1 { 255 };
+    for (auto& p : block) {
+        a0 = std::max<int>(a0, p[3]);
+        a1 = std::min<int>(a1, p[3]);
+    }
+    u64 indices { 0 };
+    // a0 > a1 selects eight values, equal ends leave every index at a0
+    if (a0 != a1) {
+        std::array<int, 8> palette { a0, a1 };
+        for (int k = 1; k < 7; k++) palette[(usize)k + 1] = ((7 - k) * a0 + k * a1) / 7;
+        for (usize i = 0; i < 16; i++) {
+            u64 best { 0 };
+            int best_d { 256 };
+            for (u64 k = 0; k < 8; k++) {
+                int d = std::abs(block[i][3] - palette[k]);
+                if (d < best_d) {
+                    best_d = d;
+                    best   = k;
+                }
+            }
+            indices |= best << (i * 3);
+        }
+    }
+    out[0] = (uint8_t)a0;
+    out[1] = (uint8_t)a1;
+    for (usize i = 0; i < 6; i++) out[2 + i] = (uint8_t)(indices >> (i * 8));
+}
+} // namespace
+
+usize wallpaper::MipDataSize(TextureFormat format, i32 w, i32 h) {
+    if (w <= 0 || h <= 0) return 0;
+    usize blocks = (usize)((w + 3) / 4) * (usize)((h + 3) / 4);
+    switch (format) {
+    case TextureFormat::RGBA8: return (usize)w * (usize)h * 4;
+    case TextureFormat::BC1: return blocks * 8;
+    case TextureFormat::BC3: return blocks * 16;
+    default: return 0;
+    }
+}
+
+bool wallpaper::IsOpaque(std::span<const uint8_t> rgba) {
+    for (usize i = 3; i < rgba.size(); i += 4) {
+        if (rgba[i] != 255) return false;
+    }
+    return true;
+}
+
+bool wallpaper::EncodeBc(TextureFormat format, const uint8_t* rgba, i32 w, i32 h, uint8_t* out) {
+    if (format != TextureFormat::BC1 && format != TextureFormat::BC3) return false;
+    const bool alpha = format == TextureFormat::BC3;
+
+    Block block;
+    for (i32 by = 0; by < h; by += 4) {
+        for (i32 bx = 0; bx < w; bx += 4) {
+            LoadBlock(rgba, w, h, bx, by, block);
+            if (alpha) {
+                EncodeAlpha(block, out);
+                out += 8;
+            }
+            EncodeColor(block, out);
+            out += 8;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Type.hpp"
+
+#include <cstdint>
+#include <span>
+
+namespace wallpaper
+{
+
+// bytes of a w x h mip, compressed formats take whole 4x4 blocks, 0 for formats not handled
+usize MipDataSize(TextureFormat, i32 w, i32 h);
+
+// every alpha of the rgba8 pixels is 255
+bool IsOpaque(std::span<const uint8_t> rgba);
+
+// Range fit encoder for rgba8 pixels to bc1, opaque only, or bc3. Endpoints are the inset
+// bounding box with its diagonal flipped to the sign of the covariance, good for photos and
+// gradients, not meant for normal maps. Partial edge blocks repeat the last row and column.
+// out takes MipDataSize bytes, false for other formats.
+bool EncodeBc(TextureFormat, const uint8_t* rgba, i32 w, i32 h, uint8_t* out);
+
+} // namespace wallpaper
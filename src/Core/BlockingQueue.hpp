@@ -25,17 +25,17 @@ public:
     BlockingQueue(const usize cap = DEF_CAPACITY): m_capacity(cap) {}
     ~BlockingQueue() = default;
 
-    void full() const {
+    bool full() const {
         lock_type lock(m_op_mtx);
         return full_();
     }
 
-    void empty() const {
+    bool empty() const {
         lock_type lock(m_op_mtx);
         return empty_();
     }
 
-    void size() const {
+    usize size() const {
         lock_type lock(m_op_mtx);
         return size_();
     }
@@ -55,7 +55,8 @@ public:
         while (empty_()) {
             m_cond_not_empty.wait(lock);
         }
-        T front_item { m_queue.pop() };
+        T front_item { std::move(m_queue.front()) };
+        m_queue.pop();
         m_cond_not_full.notify_all();
         return front_item;
     }
@@ -70,9 +71,9 @@ public:
     }
 
 private:
-    void full_() const { return m_capacity == m_queue.size(); }
-    void empty_() const { return m_queue.empty(); }
-    void size_() const { return m_queue.size(); }
+    bool  full_() const { return m_capacity == m_queue.size(); }
+    bool  empty_() const { return m_queue.empty(); }
+    usize size_() const { return m_queue.size(); }
 
 private:
     mutable std::mutex      m_op_mtx;
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <functional>
 #include <map>
 #include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 namespace wallpaper
 {
@@ -12,6 +16,17 @@ using Map = std::map<Key, Value, std::less<>>;
 template<class Key>
 using Set = std::set<Key, std::less<>>;
 
+// hashes anything string like, for find without a temporary std::string
+struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const noexcept {
+        return std::hash<std::string_view> {}(s);
+    }
+};
+
+template<class Value>
+using StringHashMap = std::unordered_map<std::string, Value, StringHash, std::equal_to<>>;
+
 template<class Key, class Value, class KeyLike, class Allocator>
 inline bool exists(const std::map<Key, Value, std::less<>, Allocator>& m, const KeyLike& key) noexcept {
     auto iter = m.find(key);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "NoCopyMove.hpp"
+#include "Literals.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace wallpaper
+{
+
+// Bounded multi producer single consumer ring without locks. Every cell carries a sequence
+// number, a producer claims a cell by moving the tail and publishes it by bumping its sequence,
+// the consumer owns the head alone.
+// A claimed but not yet published cell reads as empty, the producer wakes the consumer after
+// publishing if it has to.
+template<typename T, usize N>
+class MpscRing : NoCopy, NoMove {
+    static_assert(N > 1 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+public:
+    MpscRing() {
+        for (usize i = 0; i < N; i++) m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    // any thread, false if full
+    bool push(T&& value) {
+        usize pos = m_tail.load(std::memory_order_relaxed);
+        Cell* cell { nullptr };
+        for (;;) {
+            cell      = &m_cells[pos & (N - 1)];
+            usize seq = cell->seq.load(std::memory_order_acquire);
+            auto  dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only, false if empty
+    bool pop(T& value) {
+        Cell& cell = m_cells[m_head & (N - 1)];
+        usize seq  = cell.seq.load(std::memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(m_head + 1) < 0) return false;
+        value = std::move(cell.value);
+        cell.value = T {};
+        cell.seq.store(m_head + N, std::memory_order_release);
+        m_head++;
+        return true;
+    }
+
+    // consumer only, a claimed cell not published yet counts
+    bool empty() const { return m_tail.load(std::memory_order_acquire) == m_head; }
+
+private:
+    struct Cell {
+        std::atomic<usize> seq;
+        T                  value {};
+    };
+
+    std::array<Cell, N> m_cells;
+    // apart, producers hammer the tail
+    alignas(64) std::atomic<usize> m_tail { 0 };
+    alignas(64) usize m_head { 0 };
+};
+
+} // namespace wallpaper
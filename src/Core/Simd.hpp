@@ -0,0 +1,160 @@
+#pragma once
+#include "Core/Literals.hpp"
+
+#include <algorithm>
+
+#if defined(__AVX__)
+#    include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#    include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#    include <arm_neon.h>
+#endif
+
+// Minimal float vector for the particle and audio kernels, the widest one the target compiles
+// for. Kernels are written once against this interface and use Scalar for the tail.
+namespace wallpaper
+{
+namespace simd
+{
+
+struct Scalar {
+    using Mask = bool;
+    constexpr static usize Width { 1 };
+
+    float v;
+
+    static Scalar Load(const float* p) { return { *p }; }
+    static Scalar Set(float x) { return { x }; }
+    void          Store(float* p) const { *p = v; }
+
+    friend Scalar operator+(Scalar a, Scalar b) { return { a.v + b.v }; }
+    friend Scalar operator-(Scalar a, Scalar b) { return { a.v - b.v }; }
+    friend Scalar operator*(Scalar a, Scalar b) { return { a.v * b.v }; }
+    friend Scalar operator/(Scalar a, Scalar b) { return { a.v / b.v }; }
+
+    friend Scalar Min(Scalar a, Scalar b) { return { std::min(a.v, b.v) }; }
+    friend Scalar Max(Scalar a, Scalar b) { return { std::max(a.v, b.v) }; }
+    friend Mask   Less(Scalar a, Scalar b) { return a.v < b.v; }
+    friend Mask   LessEq(Scalar a, Scalar b) { return a.v <= b.v; }
+    friend Mask   Greater(Scalar a, Scalar b) { return a.v > b.v; }
+    // m ? a : b
+    friend Scalar Select(Mask m, Scalar a, Scalar b) { return m ? a : b; }
+};
+
+#if defined(__AVX__)
+struct Vec {
+    using Mask = __m256;
+    constexpr static usize Width { 8 };
+
+    __m256 v;
+
+    static Vec Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+    static Vec Set(float x) { return { _mm256_set1_ps(x) }; }
+    void       Store(float* p) const { _mm256_storeu_ps(p, v); }
+
+    friend Vec operator+(Vec a, Vec b) { return { _mm256_add_ps(a.v, b.v) }; }
+    friend Vec operator-(Vec a, Vec b) { return { _mm256_sub_ps(a.v, b.v) }; }
+    friend Vec operator*(Vec a, Vec b) { return { _mm256_mul_ps(a.v, b.v) }; }
+    friend Vec operator/(Vec a, Vec b) { return { _mm256_div_ps(a.v, b.v) }; }
+
+    friend Vec  Min(Vec a, Vec b) { return { _mm256_min_ps(a.v, b.v) }; }
+    friend Vec  Max(Vec a, Vec b) { return { _mm256_max_ps(a.v, b.v) }; }
+    friend Mask Less(Vec a, Vec b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+    friend Mask LessEq(Vec a, Vec b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+    friend Mask Greater(Vec a, Vec b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+    friend Vec  Select(Mask m, Vec a, Vec b) { return { _mm256_blendv_ps(b.v, a.v, m) }; }
+};
+#elif defined(__SSE2__) || defined(_M_X64)
+struct Vec {
+    using Mask = __m128;
+    constexpr static usize Width { 4 };
+
+    __m128 v;
+
+    static Vec Load(const float* p) { return { _mm_loadu_ps(p) }; }
+    static Vec Set(float x) { return { _mm_set1_ps(x) }; }
+    void       Store(float* p) const { _mm_storeu_ps(p, v); }
+
+    friend Vec operator+(Vec a, Vec b) { return { _mm_add_ps(a.v, b.v) }; }
+    friend Vec operator-(Vec a, Vec b) { return { _mm_sub_ps(a.v, b.v) }; }
+    friend Vec operator*(Vec a, Vec b) { return { _mm_mul_ps(a.v, b.v) }; }
+    friend Vec operator/(Vec a, Vec b) { return { _mm_div_ps(a.v, b.v) }; }
+
+    friend Vec  Min(Vec a, Vec b) { return { _mm_min_ps(a.v, b.v) }; }
+    friend Vec  Max(Vec a, Vec b) { return { _mm_max_ps(a.v, b.v) }; }
+    friend Mask Less(Vec a, Vec b) { return _mm_cmplt_ps(a.v, b.v); }
+    friend Mask LessEq(Vec a, Vec b) { return _mm_cmple_ps(a.v, b.v); }
+    friend Mask Greater(Vec a, Vec b) { return _mm_cmpgt_ps(a.v, b.v); }
+    // no blendv before sse4.1
+    friend Vec Select(Mask m, Vec a, Vec b) {
+        return { _mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v)) };
+    }
+};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+struct Vec {
+    using Mask = uint32x4_t;
+    constexpr static usize Width { 4 };
+
+    float32x4_t v;
+
+    static Vec Load(const float* p) { return { vld1q_f32(p) }; }
+    static Vec Set(float x) { return { vdupq_n_f32(x) }; }
+    void       Store(float* p) const { vst1q_f32(p, v); }
+
+    friend Vec operator+(Vec a, Vec b) { return { vaddq_f32(a.v, b.v) }; }
+    friend Vec operator-(Vec a, Vec b) { return { vsubq_f32(a.v, b.v) }; }
+    friend Vec operator*(Vec a, Vec b) { return { vmulq_f32(a.v, b.v) }; }
+    friend Vec operator/(Vec a, Vec b) { return { vdivq_f32(a.v, b.v) }; }
+
+    friend Vec  Min(Vec a, Vec b) { return { vminq_f32(a.v, b.v) }; }
+    friend Vec  Max(Vec a, Vec b) { return { vmaxq_f32(a.v, b.v) }; }
+    friend Mask Less(Vec a, Vec b) { return vcltq_f32(a.v, b.v); }
+    friend Mask LessEq(Vec a, Vec b) { return vcleq_f32(a.v, b.v); }
+    friend Mask Greater(Vec a, Vec b) { return vcgtq_f32(a.v, b.v); }
+    friend Vec  Select(Mask m, Vec a, Vec b) { return { vbslq_f32(m, a.v, b.v) }; }
+};
+#else
+using Vec = Scalar;
+#endif
+
+// fn.operator()<V>(i) over [0, n), Vec for the body and Scalar for the tail
+template<typename Fn>
+inline void ForEach(usize n, Fn&& fn) {
+    usize i = 0;
+    if constexpr (Vec::Width > 1) {
+        for (; i + Vec::Width <= n; i += Vec::Width) fn.template operator()<Vec>(i);
+    }
+    for (; i < n; i++) fn.template operator()<Scalar>(i);
+}
+
+// denormals read and made are zero on this thread while it's alive, they are slow to compute with
+// on most cpus
+class FlushDenormals {
+public:
+    FlushDenormals(const FlushDenormals&)            = delete;
+    FlushDenormals& operator=(const FlushDenormals&) = delete;
+
+#if defined(__SSE2__) || defined(_M_X64)
+    // flush to zero and denormals are zero
+    FlushDenormals(): m_saved(_mm_getcsr()) { _mm_setcsr(m_saved | 0x8040u); }
+    ~FlushDenormals() { _mm_setcsr(m_saved); }
+
+private:
+    unsigned m_saved;
+#elif defined(__aarch64__)
+    FlushDenormals() {
+        asm volatile("mrs %0, fpcr" : "=r"(m_saved));
+        asm volatile("msr fpcr, %0" ::"r"(m_saved | (1ull << 24)));
+    }
+    ~FlushDenormals() { asm volatile("msr fpcr, %0" ::"r"(m_saved)); }
+
+private:
+    unsigned long long m_saved;
+#else
+    FlushDenormals() = default;
+#endif
+};
+
+} // namespace simd
+} // namespace wallpaper
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+#include "Literals.hpp"
+#include "MapSet.hpp"
+
+namespace wallpaper
+{
+
+// A name interned once for the process. Equal names get the same id for as long as it runs, ids
+// are small and dense from 1, so what's looked up by name every frame can be indexed by id.
+// Interning takes a lock, copying and comparing ids don't.
+class StringId {
+public:
+    // of the empty name
+    constexpr static u32 None { 0 };
+
+    StringId() = default;
+    explicit StringId(std::string_view name): m_id(Intern(name)) {}
+
+    u32  value() const { return m_id; }
+    bool empty() const { return m_id == None; }
+    // stays valid for the process
+    const std::string& str() const {
+        auto&                               t = table();
+        std::shared_lock<std::shared_mutex> lock { t.lock };
+        return t.names[m_id];
+    }
+
+    bool operator==(const StringId&) const  = default;
+    auto operator<=>(const StringId&) const = default;
+
+private:
+    struct Table {
+        std::shared_mutex       lock;
+        std::deque<std::string> names { std::string() };
+        StringHashMap<u32>      ids { { std::string(), None } };
+    };
+    static Table& table() {
+        static Table t;
+        return t;
+    }
+    static u32 Intern(std::string_view name) {
+        auto& t = table();
+        {
+            std::shared_lock<std::shared_mutex> lock { t.lock };
+            if (auto it = t.ids.find(name); it != t.ids.end()) return it->second;
+        }
+        std::unique_lock<std::shared_mutex> lock { t.lock };
+        auto [it, inserted] = t.ids.try_emplace(std::string(name), (u32)t.names.size());
+        if (inserted) t.names.emplace_back(name);
+        return it->second;
+    }
+
+    u32 m_id { None };
+};
+
+} // namespace wallpaper
+
+template<>
+struct std::hash<wallpaper::StringId> {
+    std::size_t operator()(const wallpaper::StringId& id) const noexcept { return id.value(); }
+};
@@ -0,0 +1,366 @@
+#include "AsyncReader.h"
+#include "MemBinaryStream.h"
+#include "SpanBinaryStream.h"
+#include "Utils/Logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#    include <linux/io_uring.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    define WP_IO_URING 1
+#endif
+
+using namespace wallpaper;
+using namespace wallpaper::fs;
+
+namespace
+{
+constexpr usize pool_threads { 4 };
+// a read of more is split, the kernel reads less in one go anyway
+constexpr usize max_read_size { 1u << 30 };
+
+struct Request {
+    int                  fd { -1 };
+    u64                  offset { 0 };
+    std::vector<uint8_t> data;
+    usize                read { 0 };
+    ReadDone             done;
+};
+
+// the file opened and the buffer sized, false if there's nothing to read
+bool Prepare(Request& req, const std::filesystem::path& path, u64 offset, usize size) {
+    req.fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (req.fd < 0) return false;
+    struct stat st {};
+    if (::fstat(req.fd, &st) != 0 || offset > (u64)st.st_size) return false;
+    if (size == AsyncReader::ToEnd) size = (usize)((u64)st.st_size - offset);
+    req.offset = offset;
+    req.data.resize(size);
+    return true;
+}
+
+void Finish(Request& req, bool ok) {
+    if (req.fd >= 0) ::close(req.fd);
+    req.fd = -1;
+    if (! ok) {
+        req.done(nullptr);
+        return;
+    }
+    req.done(std::make_shared<MemBinaryStream>(std::move(req.data)));
+}
+} // namespace
+
+struct AsyncReader::Impl {
+    Impl() {
+#if WP_IO_URING
+        if (! setupRing()) LOG_INFO("no io_uring, files are read on %zu threads", pool_threads);
+#endif
+    }
+    ~Impl() {
+#if WP_IO_URING
+        closeRing();
+#endif
+        {
+            std::lock_guard l(pool_lock);
+            pool_stop = true;
+        }
+        pool_cv.notify_all();
+        for (auto& t : pool) t.join();
+    }
+
+    void post(std::function<void()> fn) {
+        {
+            std::lock_guard l(pool_lock);
+            for (usize i = pool.size(); i < pool_threads; i++) {
+                pool.emplace_back([this]() {
+                    poolLoop();
+                });
+            }
+            pool_jobs.push_back(std::move(fn));
+        }
+        pool_cv.notify_one();
+    }
+
+    void poolLoop() {
+        while (true) {
+            std::function<void()> fn;
+            {
+                std::unique_lock l(pool_lock);
+                pool_cv.wait(l, [this]() {
+                    return pool_stop || ! pool_jobs.empty();
+                });
+                if (pool_jobs.empty()) return;
+                fn = std::move(pool_jobs.front());
+                pool_jobs.pop_front();
+            }
+            fn();
+        }
+    }
+
+    static void preadAll(Request& req) {
+        while (req.read < req.data.size()) {
+            usize   want = std::min(req.data.size() - req.read, max_read_size);
+            ssize_t got =
+                ::pread(req.fd, req.data.data() + req.read, want, (off_t)(req.offset + req.read));
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return Finish(req, false);
+            req.read += (usize)got;
+        }
+        Finish(req, true);
+    }
+
+    void read(std::unique_ptr<Request> req) {
+        if (req->data.empty()) return Finish(*req, true);
+#if WP_IO_URING
+        if (ring_fd >= 0) return submit(req.release());
+#endif
+        post([req = std::shared_ptr<Request>(std::move(req))]() {
+            preadAll(*req);
+        });
+    }
+
+    std::mutex                        pool_lock;
+    std::condition_variable           pool_cv;
+    std::deque<std::function<void()>> pool_jobs;
+    std::vector<std::thread>          pool;
+    bool                              pool_stop { false };
+
+#if WP_IO_URING
+    // the ring of the kernel's io_uring, submitted under sq_lock, completed on the reaper
+    bool setupRing() {
+        io_uring_params params {};
+        ring_fd = (int)::syscall(__NR_io_uring_setup, ring_entries, &params);
+        if (ring_fd < 0) return false;
+
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sq_size = cq_size = std::max(sq_size, cq_size);
+        }
+        sq_ptr = ::mmap(nullptr,
+                        sq_size,
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE,
+                        ring_fd,
+                        IORING_OFF_SQ_RING);
+        cq_ptr = (params.features & IORING_FEAT_SINGLE_MMAP)
+                     ? sq_ptr
+                     : ::mmap(nullptr,
+                              cq_size,
+                              PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE,
+                              ring_fd,
+                              IORING_OFF_CQ_RING);
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes_ptr =
+            sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED
+                ? MAP_FAILED
+                : ::mmap(nullptr,
+                         sqes_size,
+                         PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE,
+                         ring_fd,
+                         IORING_OFF_SQES);
+        if (sqes_ptr == MAP_FAILED) {
+            unmapRing();
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe*>(sqes_ptr);
+
+        auto* sq  = static_cast<uint8_t*>(sq_ptr);
+        auto* cq  = static_cast<uint8_t*>(cq_ptr);
+        sq_head   = reinterpret_cast<u32*>(sq + params.sq_off.head);
+        sq_tail   = reinterpret_cast<u32*>(sq + params.sq_off.tail);
+        sq_mask   = *reinterpret_cast<u32*>(sq + params.sq_off.ring_mask);
+        sq_array  = reinterpret_cast<u32*>(sq + params.sq_off.array);
+        cq_head   = reinterpret_cast<u32*>(cq + params.cq_off.head);
+        cq_tail   = reinterpret_cast<u32*>(cq + params.cq_off.tail);
+        cq_mask   = *reinterpret_cast<u32*>(cq + params.cq_off.ring_mask);
+        cqes      = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        sq_slots  = params.sq_entries;
+        max_ahead = params.cq_entries;
+
+        reaper = std::thread([this]() {
+            reap();
+        });
+        return true;
+    }
+
+    void unmapRing() {
+        if (sqes != nullptr) ::munmap(sqes, sqes_size);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) ::munmap(cq_ptr, cq_size);
+        if (sq_ptr != MAP_FAILED) ::munmap(sq_ptr, sq_size);
+        sqes   = nullptr;
+        sq_ptr = cq_ptr = MAP_FAILED;
+        ::close(ring_fd);
+        ring_fd = -1;
+    }
+
+    void closeRing() {
+        if (ring_fd < 0) return;
+        {
+            // a nop without a request wakes the reaper, which leaves once nothing is in flight
+            std::unique_lock l(sq_lock);
+            ring_stop = true;
+            while (! push(IORING_OP_NOP, nullptr)) {
+                l.unlock();
+                std::this_thread::yield();
+                l.lock();
+            }
+        }
+        reaper.join();
+        unmapRing();
+    }
+
+    // an entry into the ring and submitted, under sq_lock, false if the ring is full
+    bool push(u8 op, Request* req) {
+        u32 tail = *sq_tail;
+        if (tail - std::atomic_ref<u32>(*sq_head).load(std::memory_order_acquire) >= sq_slots)
+            return false;
+        u32   index = tail & sq_mask;
+        auto& sqe   = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode    = op;
+        sqe.fd        = -1;
+        sqe.user_data = (u64)(uintptr_t)req;
+        if (req != nullptr) {
+            sqe.fd     = req->fd;
+            sqe.addr   = (u64)(uintptr_t)(req->data.data() + req->read);
+            sqe.len    = (u32)std::min(req->data.size() - req->read, max_read_size);
+            sqe.off    = req->offset + req->read;
+            in_flight++;
+        }
+        sq_array[index] = index;
+        std::atomic_ref<u32>(*sq_tail).store(tail + 1, std::memory_order_release);
+        unsubmitted++;
+
+        int done = (int)::syscall(__NR_io_uring_enter, ring_fd, unsubmitted, 0, 0, nullptr, 0);
+        // the rest goes with the next enter
+        if (done > 0) unsubmitted -= (u32)done;
+        return true;
+    }
+
+    void submit(Request* req) {
+        std::lock_guard l(sq_lock);
+        // the completion ring can't overflow, reads past it wait for earlier ones
+        if (in_flight >= max_ahead || ! push(IORING_OP_READ, req)) backlog.push_back(req);
+    }
+
+    void reap() {
+        while (true) {
+            int rv = (int)::syscall(
+                __NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (rv < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                LOG_ERROR("io_uring wait failed: %s", std::strerror(errno));
+                return;
+            }
+            u32 head = *cq_head;
+            u32 tail = std::atomic_ref<u32>(*cq_tail).load(std::memory_order_acquire);
+            for (; head != tail; head++) {
+                auto& cqe = cqes[head & cq_mask];
+                auto* req = (Request*)(uintptr_t)cqe.user_data;
+                i32   res = cqe.res;
+                std::atomic_ref<u32>(*cq_head).store(head + 1, std::memory_order_release);
+                if (req != nullptr) complete(req, res);
+            }
+            std::lock_guard l(sq_lock);
+            if (ring_stop && in_flight == 0) return;
+        }
+    }
+
+    void complete(Request* req, i32 res) {
+        {
+            std::lock_guard l(sq_lock);
+            in_flight--;
+            while (! backlog.empty() && in_flight < max_ahead &&
+                   push(IORING_OP_READ, backlog.front()))
+                backlog.pop_front();
+        }
+        if (res == -EINTR || res == -EAGAIN) return submit(req);
+        if (res > 0) req->read += (usize)res;
+        if (res > 0 && req->read < req->data.size()) return submit(req);
+
+        // 0 is the end of the file before the range's
+        std::unique_ptr<Request> owned(req);
+        Finish(*owned, res > 0);
+    }
+
+    constexpr static u32 ring_entries { 64 };
+
+    int           ring_fd { -1 };
+    void*         sq_ptr { MAP_FAILED };
+    void*         cq_ptr { MAP_FAILED };
+    usize         sq_size { 0 };
+    usize         cq_size { 0 };
+    usize         sqes_size { 0 };
+    io_uring_sqe* sqes { nullptr };
+    io_uring_cqe* cqes { nullptr };
+    u32*          sq_head { nullptr };
+    u32*          sq_tail { nullptr };
+    u32*          sq_array { nullptr };
+    u32*          cq_head { nullptr };
+    u32*          cq_tail { nullptr };
+    u32           sq_mask { 0 };
+    u32           cq_mask { 0 };
+    u32           sq_slots { 0 };
+    u32           max_ahead { 0 };
+
+    std::mutex           sq_lock;
+    std::deque<Request*> backlog;
+    u32                  in_flight { 0 };
+    u32                  unsubmitted { 0 };
+    bool                 ring_stop { false };
+    std::thread          reaper;
+#endif
+};
+
+AsyncReader& AsyncReader::Shared() {
+    static AsyncReader reader;
+    return reader;
+}
+
+AsyncReader::AsyncReader(): m_impl(std::make_unique<Impl>()) {}
+AsyncReader::~AsyncReader() = default;
+
+void AsyncReader::Read(const std::filesystem::path& path, u64 offset, usize size, ReadDone done) {
+    auto req  = std::make_unique<Request>();
+    req->done = std::move(done);
+    if (! Prepare(*req, path, offset, size)) return Finish(*req, false);
+    m_impl->read(std::move(req));
+}
+
+void AsyncReader::Post(std::function<void()> fn) { m_impl->post(std::move(fn)); }
+
+bool AsyncReader::usesRing() const {
+#if WP_IO_URING
+    return m_impl->ring_fd >= 0;
+#else
+    return false;
+#endif
+}
+
+std::shared_ptr<IBinaryStream> wallpaper::fs::ReadRange(const std::shared_ptr<IBinaryStream>& f,
+                                                        idx offset, usize size) {
+    if (! f || offset < 0 || offset > f->Size()) return nullptr;
+    if (size == AsyncReader::ToEnd) size = (usize)(f->Size() - offset);
+    if (auto view = f->TryMapView(offset, size); view.size() == size && size > 0) {
+        return std::make_shared<SpanBinaryStream>(f, view);
+    }
+    std::vector<uint8_t> data(size);
+    if (! f->SeekSet(offset) || f->Read(data.data(), size) != size) return nullptr;
+    return std::make_shared<MemBinaryStream>(std::move(data));
+}
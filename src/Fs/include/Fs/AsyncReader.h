@@ -0,0 +1,49 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <memory>
+
+#include "IBinaryStream.h"
+#include "Core/NoCopyMove.hpp"
+
+namespace wallpaper
+{
+namespace fs
+{
+
+// the bytes read as a stream, null if the file isn't there or a read failed
+using ReadDone = std::function<void(std::shared_ptr<IBinaryStream>)>;
+
+// Reads ranges of files on disk in the background. On linux the reads go to an io_uring and one
+// thread takes their completions, so many are in flight on few threads. Where there is none, or
+// the kernel refuses to make one, a few threads read with pread.
+// done runs on a reader thread, right away if the file can't be opened, work that takes long
+// should go on from there.
+class AsyncReader : NoCopy, NoMove {
+public:
+    // as a size, the rest of the file
+    constexpr static usize ToEnd { ~usize(0) };
+
+    // process wide, started on first use
+    static AsyncReader& Shared();
+
+    AsyncReader();
+    ~AsyncReader();
+
+    void Read(const std::filesystem::path&, u64 offset, usize size, ReadDone);
+    // on one of the pread threads, for reads only a stream can do
+    void Post(std::function<void()>);
+
+    bool usesRing() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+// size bytes from offset of the stream in memory, a view if the stream has its content mapped
+std::shared_ptr<IBinaryStream> ReadRange(const std::shared_ptr<IBinaryStream>&, idx offset,
+                                         usize size);
+
+} // namespace fs
+} // namespace wallpaper
@@ -7,6 +7,9 @@
 #include <cassert>
 #include <memory>
 #include <filesystem>
+#include <type_traits>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "IBinaryStream.h"
 #include "Utils/Logging.h"
 
@@ -17,7 +20,10 @@ namespace fs
 template<typename TBinaryStream>
 class CBinaryStream : public TBinaryStream {
 public:
-    virtual ~CBinaryStream() { std::fclose(m_file); }
+    virtual ~CBinaryStream() {
+        if (m_map_data != nullptr) ::munmap(const_cast<uint8_t*>(m_map_data), m_map_size);
+        std::fclose(m_file);
+    }
 
 protected:
     CBinaryStream(std::string_view path, std::FILE* file): m_path(path), m_file(file) {}
@@ -45,9 +51,37 @@ public:
         return size;
     }
 
+    // read streams map the whole file on the first view
+    virtual std::span<const uint8_t> TryMapView(idx offset, usize size) const override {
+        if constexpr (! std::is_same_v<TBinaryStream, IBinaryStream>) {
+            return {};
+        } else {
+            if (! m_map_tried) {
+                m_map_tried = true;
+                Map();
+            }
+            if (m_map_data == nullptr) return {};
+            return IBinaryStream::SubView({ m_map_data, m_map_size }, offset, size);
+        }
+    }
+
 private:
+    void Map() const {
+        struct stat st {};
+        int         fd = fileno(m_file);
+        if (fd < 0 || ::fstat(fd, &st) != 0 || st.st_size <= 0) return;
+        void* addr = ::mmap(nullptr, (usize)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) return;
+        m_map_data = static_cast<const uint8_t*>(addr);
+        m_map_size = (usize)st.st_size;
+    }
+
     std::string m_path;
     std::FILE*  m_file;
+
+    mutable bool           m_map_tried { false };
+    mutable const uint8_t* m_map_data { nullptr };
+    mutable usize          m_map_size { 0 };
 };
 
 template<typename TBinaryStream>
@@ -1,6 +1,11 @@
 #pragma once
 #include <memory>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
 
+#include "AsyncReader.h"
 #include "IBinaryStream.h"
 #include "Core/NoCopyMove.hpp"
 
@@ -14,6 +19,22 @@ public:
 	virtual bool Contains(std::string_view path) const = 0;
 	virtual std::shared_ptr<IBinaryStream> Open(std::string_view path) = 0;
 	virtual std::shared_ptr<IBinaryStreamW> OpenW(std::string_view path) = 0;
+	// the file on disk, empty if this fs isn't a directory
+	virtual std::filesystem::path NativePath(std::string_view) const { return {}; }
+	// every file path when the fs knows them up front, empty if it has to be asked
+	virtual std::vector<std::string_view> Files() const { return {}; }
+	// changes whenever a file of the fs may have, empty if the fs can't tell
+	virtual std::string Stamp() const { return {}; }
+	// its files are about to be read, the fs may have the system read them ahead, only a hint
+	virtual void Prefetch() {}
+	// size bytes from offset of the file to done in the background, see AsyncReader, through
+	// Open on a pread thread unless the fs can do better, it must outlive the read then
+	virtual void ReadAsync(std::string_view path, idx offset, usize size, ReadDone done) {
+		AsyncReader::Shared().Post(
+			[this, path = std::string(path), offset, size, done = std::move(done)]() {
+				done(ReadRange(Open(path), offset, size));
+			});
+	}
 public:
 	Fs() = default;
 	virtual ~Fs() = default;
@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <span>
 #include <string>
 #include <type_traits>
 #include "Bswap.hpp"
@@ -75,6 +76,19 @@ public:
     i8 ReadInt8() { return _ReadInt<i8>(); }
     u8 ReadUint8() { return _ReadInt<u8>(); }
 
+    // count ints in one read, swapped in place unless the byte order matches, false if short
+    template<typename T>
+    bool ReadInts(T* out, usize count) {
+        static_assert(std::is_integral_v<T>);
+        if (Read(out, count * sizeof(T)) != count * sizeof(T)) return false;
+        if (! m_noswap) {
+            for (usize i = 0; i < count; i++) out[i] = bswap<T>(out[i]);
+        }
+        return true;
+    }
+    // ints read in bulk as raw bytes need bswap
+    bool Swaps() const { return ! m_noswap; }
+
     std::string ReadStr() {
         std::string str;
         char        c;
@@ -106,9 +120,23 @@ public:
 
     virtual isize Size() const = 0;
 
+    // size bytes from offset without copying them, when the stream can reach its content in
+    // memory, empty if not or out of range
+    // stays valid as long as the stream
+    virtual std::span<const uint8_t> TryMapView(idx, usize) const { return {}; }
+
+    std::span<const uint8_t> View() const { return TryMapView(0, Usize()); }
+
 protected:
     virtual usize Write_impl(const void* buffer, usize sizeInByte) = 0;
 
+    static std::span<const uint8_t> SubView(std::span<const uint8_t> data, idx offset,
+                                            usize size) {
+        if (offset < 0 || (usize)offset > data.size() || size > data.size() - (usize)offset)
+            return {};
+        return data.subspan((usize)offset, size);
+    }
+
 private:
     constexpr static ByteOrder default_byte_order { ByteOrder::LittleEndian };
     ByteOrder                  m_byte_order { default_byte_order };
@@ -121,6 +149,9 @@ public:
     usize Write(const void* buffer, usize sizeInByte) { return Write_impl(buffer, sizeInByte); }
     i32   WriteInt32(i32 x) { return _WriteInt<i32>(x); }
     i32   WriteUint32(u32 x) { return _WriteInt<u32>(x); }
+    i32   WriteUint64(u64 x) { return _WriteInt<u64>(x); }
+    // as ReadFloat reads it
+    usize WriteFloat(float x) { return Write_impl(&x, sizeof(x)); }
 };
 
 } // namespace fs
@@ -17,7 +17,7 @@ public:
     virtual ~LimitedBinaryStream() = default;
 
 private:
-    bool CheckInArea(idx pos) const { return pos > 0 && pos <= Size(); }
+    bool CheckInArea(idx pos) const { return pos >= 0 && pos <= Size(); }
 
     bool SeekInMPos(void) { return m_infs->SeekSet(m_start + m_pos); }
     bool SeekInPos(idx pos) {
@@ -65,6 +65,11 @@ public:
     }
     virtual isize Size() const { return m_end - m_start; }
 
+    virtual std::span<const uint8_t> TryMapView(idx offset, usize size) const {
+        if (offset < 0 || offset > Size() || (isize)size > Size() - offset) return {};
+        return m_infs->TryMapView(m_start + offset, size);
+    }
+
 private:
     idx                            m_pos; // 0 < m_pos <= m_end - m_start
     const idx                      m_start;
@@ -59,8 +59,12 @@ public:
     }
     virtual isize Size() const { return std::ssize(m_data); }
 
+    std::span<const uint8_t> TryMapView(idx offset, usize size) const override {
+        return SubView(m_data, offset, size);
+    }
+
 protected:
-    virtual usize Write_impl(const void* buffer, usize sizeInByte) { return 0; }
+    virtual usize Write_impl(const void*, usize) { return 0; }
 
 private:
     bool InArea(idx pos) const noexcept { return pos >= 0 && pos <= Size(); }
@@ -76,5 +80,34 @@ private:
     std::vector<uint8_t> m_data;
 };
 
+// Appends to a vector, for data stored as a whole once written.
+class MemBinaryStreamW : public IBinaryStreamW {
+public:
+    MemBinaryStreamW()          = default;
+    virtual ~MemBinaryStreamW() = default;
+
+    const std::vector<uint8_t>& Data() const { return m_data; }
+    // what was written, the stream is empty after
+    std::vector<uint8_t> Take() { return std::move(m_data); }
+
+public:
+    virtual usize Read(void*, usize) { return 0; }
+    virtual char* Gets(char* buffer, usize) { return buffer; }
+    virtual idx   Tell() const { return std::ssize(m_data); }
+    virtual bool  SeekSet(idx) { return false; }
+    virtual bool  SeekCur(idx) { return false; }
+    virtual bool  SeekEnd(idx) { return false; }
+    virtual isize Size() const { return std::ssize(m_data); }
+
+protected:
+    virtual usize Write_impl(const void* buffer, usize sizeInByte) {
+        m_data.insert(m_data.end(), (const uint8_t*)buffer, (const uint8_t*)buffer + sizeInByte);
+        return sizeInByte;
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+};
+
 } // namespace fs
 } // namespace wallpaper
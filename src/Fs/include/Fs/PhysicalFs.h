@@ -26,6 +26,13 @@ public:
         std::filesystem::create_directories(full_path.parent_path());
         return CreateCBinaryStreamW(full_path.native());
     }
+    std::filesystem::path NativePath(std::string_view path) const override {
+        return m_path / path.substr(1);
+    }
+    void ReadAsync(std::string_view path, idx offset, usize size, ReadDone done) override {
+        if (offset < 0) return done(nullptr);
+        AsyncReader::Shared().Read(NativePath(path), (u64)offset, size, std::move(done));
+    }
 
 private:
     std::string FullPath(std::string_view path) const {
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <span>
+
+#include "IBinaryStream.h"
+
+namespace wallpaper
+{
+namespace fs
+{
+
+// Reads bytes something else owns, like a file of a mapped pkg.
+// The owner is kept alive as long as the stream.
+class SpanBinaryStream : public IBinaryStream {
+public:
+    SpanBinaryStream(std::shared_ptr<const void> owner, std::span<const uint8_t> data)
+        : m_pos(0), m_data(data), m_owner(std::move(owner)) {}
+    virtual ~SpanBinaryStream() = default;
+
+public:
+    virtual usize Read(void* buffer, usize sizeInByte) {
+        usize moved = std::min(sizeInByte, m_data.size() - (usize)m_pos);
+        if (moved > 0) std::memcpy(buffer, m_data.data() + m_pos, moved);
+        m_pos += (idx)moved;
+        return moved;
+    }
+    virtual char* Gets(char* buffer, usize sizeStr) {
+        Read(buffer, sizeStr);
+        return buffer;
+    }
+    virtual idx  Tell() const { return m_pos; }
+    virtual bool SeekSet(idx offset) { return SeekTo(offset); }
+    virtual bool SeekCur(idx offset) { return SeekTo(m_pos + offset); }
+    virtual bool SeekEnd(idx offset) { return SeekTo(Size() + offset); }
+
+    virtual isize Size() const { return std::ssize(m_data); }
+
+    std::span<const uint8_t> TryMapView(idx offset, usize size) const override {
+        return SubView(m_data, offset, size);
+    }
+
+protected:
+    virtual usize Write_impl(const void*, usize) { return 0; }
+
+private:
+    bool SeekTo(idx pos) noexcept {
+        if (pos < 0 || pos > Size()) return false;
+        m_pos = pos;
+        return true;
+    }
+
+    idx                         m_pos;
+    std::span<const uint8_t>    m_data;
+    std::shared_ptr<const void> m_owner;
+};
+
+} // namespace fs
+} // namespace wallpaper
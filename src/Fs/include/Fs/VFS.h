@@ -4,9 +4,12 @@
 #include <string>
 #include <tuple>
 #include <algorithm>
+#include <future>
+#include <mutex>
 #include "Fs.h"
 #include "Utils/Logging.h"
 #include "Core/NoCopyMove.hpp"
+#include "Core/MapSet.hpp"
 
 namespace wallpaper
 {
@@ -16,6 +19,10 @@ namespace  fs
 /*
  * path like: /root/dir1/dir2/file
  * not resolve "." "..", empty dir name as this using full path match
+ *
+ * full paths are resolved to their mount once, files of fs that list them are indexed when
+ * mounted, others are remembered on the first lookup
+ * files made behind the vfs, not through OpenW, aren't seen once their path was looked up
  */
 
 class VFS : NoCopy,NoMove {
@@ -28,10 +35,11 @@ public:
 			return mountPoint[mountPoint.size()-1] != '/';
 		}
 		static bool InMountPoint(const std::string_view mountPoint, const std::string_view path) {
-			return path.compare(0, mountPoint.size() + 1, std::string(mountPoint) + '/') == 0;
+			return path.size() > mountPoint.size() && path[mountPoint.size()] == '/' &&
+			       path.starts_with(mountPoint);
 		}
-		static std::string GetPathInMount(const std::string_view mountPoint, const std::string_view path) {
-			return std::string(path.substr(mountPoint.size()));
+		static std::string_view GetPathInMount(const std::string_view mountPoint, const std::string_view path) {
+			return path.substr(mountPoint.size());
 		}
 	};
 public:
@@ -41,13 +49,28 @@ public:
 	bool Mount(std::string_view mountpoint, std::unique_ptr<Fs> fs, std::string_view name="") {
 		if(!MountedFs::CheckMountPoint(mountpoint) || !fs) return false;
 
+		auto files = fs->Files();
 		m_mountedFss.push_back({std::string(name), std::string(mountpoint), std::move(fs)});
+
+		std::lock_guard lock(m_index_mutex);
+		if (files.empty()) {
+			// may shadow anything resolved before
+			m_index.clear();
+			return true;
+		}
+		// the newest mount wins, its files point here whatever they resolved to
+		const isize mount = std::ssize(m_mountedFss) - 1;
+		for (auto file : files) {
+			m_index.insert_or_assign(std::string(mountpoint) + std::string(file), mount);
+		}
 		return true;
 	}
 	bool Unmount(std::string_view mountpoint) {
 		for(auto iter = m_mountedFss.rbegin();iter < m_mountedFss.rend();iter++) {
 			if(iter->mountPoint == mountpoint) {
 				m_mountedFss.erase((++iter).base());
+				std::lock_guard lock(m_index_mutex);
+				m_index.clear();
 				return true;
 			}
 		}
@@ -62,43 +85,97 @@ public:
 		return false;
 	}
 	std::shared_ptr<IBinaryStream> Open(std::string_view path) {
-        auto find_it = std::find_if(m_mountedFss.rbegin(), m_mountedFss.rend(), [&path](const auto& mfs) {
-			return MountedFs::InMountPoint(mfs.mountPoint, path) && 
-                   mfs.fs->Contains(MountedFs::GetPathInMount(mfs.mountPoint, path));
-        });
-        if(find_it != std::rend(m_mountedFss)) 
-            return find_it->fs->Open(MountedFs::GetPathInMount(find_it->mountPoint, path));
+		if (auto* mfs = Resolve(path))
+			return mfs->fs->Open(MountedFs::GetPathInMount(mfs->mountPoint, path));
 		LOG_ERROR("not found \"%s\" in vfs", path.data());
 		return nullptr;
 	}
 	std::shared_ptr<IBinaryStreamW> OpenW(std::string_view path) {
-        auto find_it = std::find_if(m_mountedFss.rbegin(), m_mountedFss.rend(), [&path](const auto& mfs) {
-			return MountedFs::InMountPoint(mfs.mountPoint, path) && 
-                   mfs.fs->Contains(MountedFs::GetPathInMount(mfs.mountPoint, path));
-        });
-        if (find_it == std::rend(m_mountedFss)) {
-            find_it = std::find_if(m_mountedFss.rbegin(), m_mountedFss.rend(), [&path](const auto& mfs) {
-			    return MountedFs::InMountPoint(mfs.mountPoint, path);
-            });
-        }
-        if(find_it != std::rend(m_mountedFss))
-            return find_it->fs->OpenW(MountedFs::GetPathInMount(find_it->mountPoint, path));
+		const MountedFs* mfs = Resolve(path);
+		if (mfs == nullptr) {
+			auto find_it = std::find_if(m_mountedFss.rbegin(), m_mountedFss.rend(), [&path](const auto& mfs) {
+				return MountedFs::InMountPoint(mfs.mountPoint, path);
+			});
+			if (find_it != std::rend(m_mountedFss)) mfs = &*find_it;
+		}
+		if (mfs != nullptr) {
+			auto file = mfs->fs->OpenW(MountedFs::GetPathInMount(mfs->mountPoint, path));
+			// the file may be new
+			std::lock_guard lock(m_index_mutex);
+			if (auto it = m_index.find(path); it != m_index.end()) m_index.erase(it);
+			return file;
+		}
 		LOG_ERROR("not found \"%s\" in vfs", path.data());
 		return nullptr;
 	}
-	bool Contains(std::string_view path) const {
+	std::filesystem::path NativePath(std::string_view path) const {
 		for(auto iter = m_mountedFss.rbegin();iter < m_mountedFss.rend();iter++) {
 			auto& el = *iter;
-			if(MountedFs::InMountPoint(el.mountPoint, path)) {
-				auto mpath = MountedFs::GetPathInMount(el.mountPoint, path);
-				if(el.fs->Contains(mpath))
-					return true;
-			}
+			if(MountedFs::InMountPoint(el.mountPoint, path))
+				return el.fs->NativePath(MountedFs::GetPathInMount(el.mountPoint, path));
 		}
-		return false;
+		return {};
+	}
+	bool Contains(std::string_view path) const { return Resolve(path) != nullptr; }
+	// a range of the file in the background, done gets null if there's none, see Fs::ReadAsync
+	void ReadAsync(std::string_view path, idx offset, usize size, ReadDone done) {
+		auto* mfs = Resolve(path);
+		if (mfs == nullptr) {
+			LOG_ERROR("not found \"%s\" in vfs", path.data());
+			return done(nullptr);
+		}
+		auto in_mount = MountedFs::GetPathInMount(mfs->mountPoint, path);
+		mfs->fs->ReadAsync(in_mount, offset, size, std::move(done));
+	}
+	std::future<std::shared_ptr<IBinaryStream>> ReadAsync(std::string_view path, idx offset = 0,
+	                                                      usize size = AsyncReader::ToEnd) {
+		auto promise = std::make_shared<std::promise<std::shared_ptr<IBinaryStream>>>();
+		auto future  = promise->get_future();
+		ReadAsync(path, offset, size, [promise](std::shared_ptr<IBinaryStream> stream) {
+			promise->set_value(std::move(stream));
+		});
+		return future;
+	}
+	// every fs mounted there, see Fs::Prefetch
+	void Prefetch(std::string_view mountpoint) {
+		for (auto& el : m_mountedFss) {
+			if (el.mountPoint == mountpoint) el.fs->Prefetch();
+		}
+	}
+	// of the fs the path resolves to, empty if none or it can't tell
+	std::string Stamp(std::string_view path) const {
+		if (auto* mfs = Resolve(path)) return mfs->fs->Stamp();
+		return {};
 	}
 private:
+	constexpr static isize NotFound { -1 };
+
+	// the newest mount that has the file, nullptr if none
+	const MountedFs* Resolve(std::string_view path) const {
+		{
+			std::lock_guard lock(m_index_mutex);
+			if (auto it = m_index.find(path); it != m_index.end())
+				return it->second == NotFound ? nullptr : &m_mountedFss[(usize)it->second];
+		}
+		isize mount = NotFound;
+		for (isize i = std::ssize(m_mountedFss) - 1; i >= 0; i--) {
+			auto& el = m_mountedFss[(usize)i];
+			if (MountedFs::InMountPoint(el.mountPoint, path) &&
+			    el.fs->Contains(MountedFs::GetPathInMount(el.mountPoint, path))) {
+				mount = i;
+				break;
+			}
+		}
+		std::lock_guard lock(m_index_mutex);
+		m_index.try_emplace(std::string(path), mount);
+		return mount == NotFound ? nullptr : &m_mountedFss[(usize)mount];
+	}
+
 	std::vector<MountedFs> m_mountedFss;
+
+	// full path to the index of its mount in m_mountedFss, or NotFound
+	mutable std::mutex           m_index_mutex;
+	mutable StringHashMap<isize> m_index;
 };
 
 inline std::string GetFileContent(fs::VFS& vfs, std::string_view path) {
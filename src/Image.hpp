@@ -1,31 +1,34 @@
 #pragma once
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <vector>
 #include <memory>
-#include <unordered_map>
 #include <functional>
+#include <span>
 
 #include "Core/Literals.hpp"
 #include "Type.hpp"
 #include "SpriteAnimation.hpp"
 #include "Scene/SceneTexture.h"
 #include "Core/NoCopyMove.hpp"
+#include "Utils/MemUse.hpp"
 
 namespace wallpaper
 {
-
-union ImageExtra {
-    int32_t val { 0 };
-    char    str[125];
-};
-
-typedef std::unique_ptr<uint8_t, std::function<void(uint8_t*)>> ImageDataPtr;
+namespace fs
+{
+class IBinaryStream;
+}
 
 struct ImageData {
-    i32          width { 0 };
-    i32          height { 0 };
-    isize        size { 0 };
-    ImageDataPtr data {};
+    i32   width { 0 };
+    i32   height { 0 };
+    isize size { 0 };
+    // into the pixels of its image, -1 if the mip has none there
+    isize offset { -1 };
+    // set instead of data when the mip is written straight into upload memory, fills size bytes
+    std::function<bool(std::span<uint8_t>)> fill {};
     ImageData() = default;
 };
 
@@ -37,6 +40,11 @@ struct ImageHeader {
     i32 mapWidth { 0 };
     i32 mapHeight { 0 };
 
+    // the first mip of the first image and its mip count, from ParseHeader, 0 if not known
+    i32 mipWidth { 0 };
+    i32 mipHeight { 0 };
+    i32 mipCount { 0 };
+
     bool mipmap_larger { false };
     bool mipmap_pow2 { false };
 
@@ -45,11 +53,24 @@ struct ImageHeader {
     i32           count { 0 };
 
     bool          isSprite { false };
+    // sprite images of one size and mip count, they fit the layers of one texture
+    bool          layerable { false };
     TextureSample sample;
 
     SpriteAnimation spriteAnim;
-    // for specific property
-    std::unordered_map<std::string, ImageExtra> extraHeader;
+
+    // false if no tex header was read, for fallbacks and missing files
+    bool fromTex { false };
+    // a TEXB0004 video texture, its payload is an mp4 clip
+    bool isVideo { false };
+    // versions of the tex sections
+    i32 texv { 0 };
+    i32 texi { 0 };
+    i32 texb { 0 };
+    // component flags
+    bool compo1 { false };
+    bool compo2 { false };
+    bool compo3 { false };
 };
 
 // slot is one singal image
@@ -65,6 +86,48 @@ struct Image : NoCopy, NoMove {
     ImageHeader       header;
     std::vector<Slot> slots;
     std::string       key;
+    // of the encoded pixels, images decoded from the same bytes get the same, 0 if not known
+    std::size_t content { 0 };
+    // the clip of a video texture, its one slot holds a transparent texel to show until a frame
+    // is decoded or if none can be
+    std::shared_ptr<fs::IBinaryStream> video;
+
+    // the bytes of all mips of all slots in one buffer, mips without a fill point into it
+    std::unique_ptr<uint8_t[]> pixels;
+    usize                      pixels_size { 0 };
+    usize                      pixels_capacity { 0 };
+    // of pixels_capacity, set with it
+    memuse::Held pixels_held { memuse::Pool::Images };
+
+    // size bytes at the end of pixels for the mip, the span is good until the next allocate
+    std::span<uint8_t> allocate(ImageData& mip, usize size) {
+        if (pixels_size + size > pixels_capacity) {
+            // the first is mostly the largest mip, the chain after it adds a third
+            usize cap = std::max({ pixels_size + size, pixels_capacity * 2, size + size / 3 });
+            auto  buf = std::make_unique_for_overwrite<uint8_t[]>(cap);
+            if (pixels_size > 0) std::memcpy(buf.get(), pixels.get(), pixels_size);
+            pixels          = std::move(buf);
+            pixels_capacity = cap;
+            pixels_held.set(cap);
+        }
+        mip.offset = (isize)pixels_size;
+        mip.size   = (isize)size;
+        pixels_size += size;
+        return { pixels.get() + mip.offset, size };
+    }
+    // drops the pixels of the mip, which must be the last allocated
+    void release(ImageData& mip) {
+        if (mip.offset >= 0 && (usize)(mip.offset + mip.size) == pixels_size)
+            pixels_size = (usize)mip.offset;
+        mip.offset = -1;
+    }
+
+    const uint8_t* data(const ImageData& mip) const {
+        return mip.offset >= 0 ? pixels.get() + mip.offset : nullptr;
+    }
+    uint8_t* data(const ImageData& mip) {
+        return mip.offset >= 0 ? pixels.get() + mip.offset : nullptr;
+    }
 };
 
 } // namespace wallpaper
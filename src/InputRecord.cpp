@@ -0,0 +1,110 @@
+#include "InputRecord.hpp"
+
+#include "Utils/Logging.h"
+
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+
+using namespace wallpaper;
+
+namespace
+{
+// the value's type is kept, a json number doesn't tell an int32 from a float
+constexpr std::array<const char*, std::variant_size_v<InputRecord::Value>> value_types {
+    "bool", "int32", "float", "string"
+};
+
+bool ParseValue(const nlohmann::json& prop, InputRecord::Value& value) {
+    const std::string type = prop.value("type", "");
+    auto&             v    = prop.at("value");
+    if (type == "bool" && v.is_boolean())
+        value = v.get<bool>();
+    else if (type == "int32" && v.is_number_integer())
+        value = v.get<i32>();
+    else if (type == "float" && v.is_number())
+        value = v.get<float>();
+    else if (type == "string" && v.is_string())
+        value = v.get<std::string>();
+    else
+        return false;
+    return true;
+}
+} // namespace
+
+bool InputRecord::Save(const std::string& path) const {
+    // a frame is an array, a long record stays readable and small
+    auto json_frames = nlohmann::json::array();
+    for (auto& f : frames) {
+        json_frames.push_back({ f.advance, f.frame_time, f.budget, f.mouse[0], f.mouse[1] });
+    }
+    auto json_props = nlohmann::json::array();
+    for (auto& p : properties) {
+        nlohmann::json prop { { "frame", p.frame },
+                              { "name", p.name },
+                              { "type", value_types[p.value.index()] } };
+        std::visit(
+            [&prop](const auto& v) {
+                prop["value"] = v;
+            },
+            p.value);
+        json_props.push_back(std::move(prop));
+    }
+    nlohmann::json json {
+        { "version", Version },
+        { "seed", seed },
+        { "frames", std::move(json_frames) },
+        { "properties", std::move(json_props) },
+    };
+
+    std::ofstream file(path);
+    file << json.dump() << '\n';
+    if (! file) {
+        LOG_ERROR("can't write input record %s", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool InputRecord::Load(const std::string& path, InputRecord& record) {
+    std::ifstream file(path);
+    if (! file) {
+        LOG_ERROR("can't read input record %s", path.c_str());
+        return false;
+    }
+    auto json = nlohmann::json::parse(file, nullptr, false);
+    if (json.is_discarded() || ! json.is_object() || json.value("version", 0) != Version) {
+        LOG_ERROR("%s isn't an input record of version %d", path.c_str(), Version);
+        return false;
+    }
+    record = {};
+    if (json.contains("seed") && json.at("seed").is_number_unsigned())
+        record.seed = json.at("seed").get<u64>();
+
+    auto broken = [&path]() {
+        LOG_ERROR("broken input record %s", path.c_str());
+        return false;
+    };
+    if (! json.contains("frames") || ! json.at("frames").is_array()) return broken();
+    for (auto& f : json.at("frames")) {
+        if (! f.is_array() || f.size() != 5) return broken();
+        for (auto& v : f) {
+            if (! v.is_number()) return broken();
+        }
+        record.frames.push_back({ .advance    = f[0].get<double>(),
+                                  .frame_time = f[1].get<double>(),
+                                  .budget     = f[2].get<double>(),
+                                  .mouse      = { f[3].get<float>(), f[4].get<float>() } });
+    }
+    if (json.contains("properties") && json.at("properties").is_array()) {
+        for (auto& p : json.at("properties")) {
+            Property prop;
+            if (! p.is_object() || ! p.contains("value") || ! ParseValue(p, prop.value))
+                return broken();
+            prop.frame = p.value("frame", u64(0));
+            prop.name  = p.value("name", "");
+            record.properties.push_back(std::move(prop));
+        }
+    }
+    return true;
+}
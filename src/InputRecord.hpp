@@ -0,0 +1,45 @@
+#pragma once
+#include "Core/Literals.hpp"
+
+#include <array>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace wallpaper
+{
+
+// What a run of a scene took from outside, frame by frame: the time each frame moved the scene
+// on, the mouse and the properties set. A replay of it with the same seed moves the scene the
+// same, so runs on different builds compare frame for frame. Written as json.
+struct InputRecord {
+    constexpr static i32 Version { 1 };
+
+    // of a simulated frame, in the order they ran
+    struct Frame {
+        // seconds the scene moved on, the time the frame before took and the one it had
+        double               advance { 0.0 };
+        double               frame_time { 0.0 };
+        double               budget { 0.0 };
+        std::array<float, 2> mouse { 0.5f, 0.5f };
+    };
+    // objects and callbacks aren't recorded
+    using Value = std::variant<bool, i32, float, std::string>;
+    struct Property {
+        // set before the frame of this index simulated
+        u64         frame { 0 };
+        std::string name;
+        Value       value;
+    };
+
+    // of Random for the parse and the particle systems
+    u64                   seed { 0 };
+    std::vector<Frame>    frames;
+    std::vector<Property> properties;
+
+    bool Save(const std::string& path) const;
+    // false if the file can't be read or isn't a record of this version
+    static bool Load(const std::string& path, InputRecord&);
+};
+
+} // namespace wallpaper
@@ -1,7 +1,9 @@
 #pragma once
 #include "Image.hpp"
 //#include "Fs/VFS.h"
+#include <functional>
 #include <memory>
+#include <span>
 #include <string>
 
 namespace wallpaper
@@ -12,5 +14,22 @@ public:
     virtual ~IImageParser()                                        = default;
     virtual std::shared_ptr<Image> Parse(const std::string&)       = 0;
     virtual ImageHeader            ParseHeader(const std::string&) = 0;
+
+    // decodes ahead of Parse, which then hands the image out once
+    virtual void Preload(const std::string&) {}
+    // a whole scene's textures, parsers may decode them in parallel, once stop returns true the
+    // rest is left undecoded
+    virtual void Preload(std::span<const std::string> names, std::function<bool()> stop = {}) {
+        for (auto& name : names) {
+            if (stop && stop()) return;
+            Preload(name);
+        }
+    }
+    // large static rgba8 textures may be compressed to bc on decode, set before decoding
+    virtual void SetTranscode(bool) {}
+    // mips with a side over this many pixels are not decoded, 0 for no cap, set before decoding
+    virtual void SetMaxSize(u32) {}
+    // frees decoded images no Parse took, once everything that was to upload them has
+    virtual void DropPreloaded() {}
 };
 } // namespace wallpaper
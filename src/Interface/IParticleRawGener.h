@@ -3,7 +3,7 @@
 #include <memory>
 #include <functional>
 
-#include "Particle/Particle.h"
+#include "Particle/ParticleBuffer.h"
 #include "Scene/SceneMesh.h"
 
 namespace wallpaper
@@ -11,7 +11,13 @@ namespace wallpaper
 struct ParticleRawGenSpec {
     float* lifetime;
 };
-using ParticleRawGenSpecOp = std::function<void(const Particle&, const ParticleRawGenSpec&)>;
+using ParticleRawGenSpecOp =
+    std::function<void(const ParticleBuffer&, usize index, const ParticleRawGenSpec&)>;
+// a particle of one of the instances given with it
+struct ParticleRef {
+    u32 instance { 0 };
+    u32 index { 0 };
+};
 
 class ParticleInstance;
 class IParticleRawGener {
@@ -19,7 +25,13 @@ public:
     IParticleRawGener()          = default;
     virtual ~IParticleRawGener() = default;
 
-    virtual void GenGLData(std::span<const std::unique_ptr<ParticleInstance>>, SceneMesh&,
-                           ParticleRawGenSpecOp&) = 0;
+    // blend < 1 draws positions between PrevPos and Pos, between two fixed steps
+    // quads are written in order if it's given, only live particles may be in it, else instance
+    // by instance, ropes always are
+    // writes from quad first on, the quads before stay and are drawn too, returns the quad past
+    // the last written
+    virtual u32 GenGLData(std::span<const std::unique_ptr<ParticleInstance>>, SceneMesh&,
+                          ParticleRawGenSpecOp&, float blend,
+                          std::span<const ParticleRef> order = {}, u32 first = 0) = 0;
 };
 } // namespace wallpaper
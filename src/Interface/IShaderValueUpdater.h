@@ -4,7 +4,9 @@
 #include "Core/MapSet.hpp"
 
 #include <functional>
+#include <span>
 #include <string_view>
+#include <vector>
 
 namespace wallpaper
 {
@@ -13,19 +15,34 @@ class SceneShader;
 class ShaderValue;
 class SpriteAnimation;
 
-using sprite_map_t    = Map<usize, SpriteAnimation>;
-using UpdateUniformOp = std::function<void(std::string_view, ShaderValue)>;
-using ExistsUniformOp = std::function<bool(std::string_view)>;
+using sprite_map_t = Map<usize, SpriteAnimation>;
+
+// index into the table a pass resolves uniform names to once, updates skip the name lookup
+using UniformSlot = i32;
+constexpr UniformSlot NoUniformSlot { -1 };
+constexpr bool        HasUniform(UniformSlot s) { return s != NoUniformSlot; }
+
+using ResolveUniformOp = std::function<UniformSlot(std::string_view)>;
+using UpdateUniformOp  = std::function<void(UniformSlot, ShaderValue)>;
+// values too big to copy, like bone palettes, the data stays put until the next frame
+using UpdateUniformSpanOp = std::function<void(UniformSlot, std::span<const float>)>;
 
 class IShaderValueUpdater : NoCopy, NoMove {
 public:
     IShaderValueUpdater()          = default;
     virtual ~IShaderValueUpdater() = default;
 
-    virtual void FrameBegin()                                                      = 0;
-    virtual void InitUniforms(SceneNode*, const ExistsUniformOp&)                  = 0;
-    virtual void UpdateUniforms(SceneNode*, sprite_map_t&, const UpdateUniformOp&) = 0;
-    virtual void FrameEnd()                                                        = 0;
+    // with the frame's simulation, on a job while the last frame records
+    // advances time driven state, uniform updates of the frame read it after
+    virtual void FrameBegin()                                      = 0;
+    virtual void InitUniforms(SceneNode*, const ResolveUniformOp&) = 0;
+    // run for many nodes at once on jobs, writes only what's kept for the node, the rest of the
+    // updater is read only meanwhile
+    virtual void UpdateUniforms(SceneNode*, sprite_map_t&, const UpdateUniformOp&,
+                                const UpdateUniformSpanOp&)        = 0;
+    virtual void FrameEnd()                                        = 0;
+    // the block of uniforms every node shares, filled once a frame, left empty if there is none
+    virtual void UpdateSharedUniforms(std::vector<uint8_t>&) = 0;
 
     virtual void MouseInput(double x, double y) = 0;
     virtual void SetTexelSize(float x, float y) = 0;
@@ -0,0 +1,243 @@
+#include "JobSystem.hpp"
+
+#include "Utils/Logging.h"
+#include "Utils/ThreadPolicy.hpp"
+#include "Utils/Trace.h"
+
+#include <array>
+#include <mutex>
+#include <thread>
+
+using namespace wallpaper;
+using namespace wallpaper::looper;
+
+namespace
+{
+constexpr usize NoWorker { ~(usize)0 };
+
+// set on worker threads, posts from them go to their own queue
+thread_local const JobSystem* t_owner { nullptr };
+thread_local usize            t_index { NoWorker };
+
+usize PickWorkerCount(usize num) {
+    if (num == 0) {
+        // the main and render loopers keep a core each
+        usize cores = std::thread::hardware_concurrency();
+        num         = cores > 2 ? cores - 2 : 1;
+    }
+    return std::min(num, JobSystem::MaxWorkers);
+}
+} // namespace
+
+struct JobSystem::Worker {
+    std::mutex                      mutex;
+    std::array<std::deque<Item>, 2> queues;
+    std::thread                     thread;
+};
+
+JobSystem& JobSystem::Shared() {
+    static JobSystem shared;
+    return shared;
+}
+
+JobSystem::JobSystem(usize workers) { start(PickWorkerCount(workers)); }
+JobSystem::~JobSystem() { stop(); }
+
+std::shared_lock<std::shared_mutex> JobSystem::lockWorkers() const {
+    // workers can't be swapped while one of them runs a job
+    if (t_owner == this) return {};
+    return std::shared_lock(m_workers_mutex);
+}
+
+void JobSystem::setWorkerCount(usize num) {
+    num = PickWorkerCount(num);
+    std::unique_lock lock(m_workers_mutex);
+    if (num == m_workers.size()) return;
+    stop();
+    start(num);
+}
+
+void JobSystem::setLoadWorkers(usize num) {
+    std::unique_lock lock(m_workers_mutex);
+    usize            workers = m_workers.size();
+    m_load_asked             = num;
+    if (std::min(num, workers - 1) == m_load_only.load()) return;
+    stop();
+    start(workers);
+}
+
+usize JobSystem::workerCount() const {
+    auto lock = lockWorkers();
+    return m_workers.size();
+}
+
+void JobSystem::start(usize num) {
+    m_stop      = false;
+    m_load_only = std::min(m_load_asked, num - 1);
+    for (usize i = 0; i < num; i++) m_workers.push_back(std::make_unique<Worker>());
+    for (usize i = 0; i < num; i++) m_workers[i]->thread = std::thread(&JobSystem::loop, this, i);
+    LOG_INFO("job workers: %d, load only: %d", (int)num, (int)m_load_only.load());
+}
+
+void JobSystem::stop() {
+    // workers leave once no queue has a job left
+    m_stop = true;
+    m_signal.fetch_add(1);
+    m_signal.notify_all();
+    for (auto& w : m_workers) {
+        if (w->thread.joinable()) w->thread.join();
+    }
+    m_workers.clear();
+}
+
+void JobSystem::loop(usize self) {
+    t_owner = this;
+    t_index = self;
+    TRACE_THREAD("job " + std::to_string(self));
+    // workers inherit the thread that started them, a boosted one too
+    const bool frame = self + m_load_only.load() < m_workers.size();
+    platform::ApplyThreadClass(frame ? platform::ThreadClass::Normal
+                                     : platform::ThreadClass::Load);
+    Item item;
+    while (true) {
+        if (take(item, self, true, frame)) {
+            execute(item);
+            continue;
+        }
+        // a post seeing no sleeper has its job found by the second take
+        u32 signal = m_signal.load();
+        m_sleeping++;
+        bool got = take(item, self, true, frame);
+        if (! got && ! m_stop) m_signal.wait(signal);
+        m_sleeping--;
+        if (got)
+            execute(item);
+        else if (m_stop)
+            break;
+    }
+    t_owner = nullptr;
+    t_index = NoWorker;
+}
+
+void JobSystem::push(Item&& item) {
+    usize index = t_owner == this ? t_index : m_next_worker++ % m_workers.size();
+    auto& w          = *m_workers[index];
+    bool  item_frame = item.group->m_priority == JobPriority::Frame;
+    {
+        std::lock_guard lock(w.mutex);
+        w.queues[(usize)item.group->m_priority].push_back(std::move(item));
+    }
+    if (m_sleeping.load() > 0) {
+        m_signal.fetch_add(1);
+        // a load only worker woken for a frame job would sleep again
+        if (item_frame && m_load_only.load() > 0)
+            m_signal.notify_all();
+        else
+            m_signal.notify_one();
+    }
+}
+
+bool JobSystem::take(Item& item, usize self, bool load, bool frame) {
+    const usize num = m_workers.size();
+    for (auto priority : { JobPriority::Frame, JobPriority::Load }) {
+        if (priority == JobPriority::Frame && ! frame) continue;
+        if (priority == JobPriority::Load && ! load) break;
+        const usize p = (usize)priority;
+        if (self != NoWorker) {
+            auto&           w = *m_workers[self];
+            std::lock_guard lock(w.mutex);
+            if (! w.queues[p].empty()) {
+                item = std::move(w.queues[p].back());
+                w.queues[p].pop_back();
+                return true;
+            }
+        }
+        usize first = self == NoWorker ? 0 : self + 1;
+        for (usize i = 0; i < num; i++) {
+            usize index = (first + i) % num;
+            if (index == self) continue;
+            auto&           w = *m_workers[index];
+            std::lock_guard lock(w.mutex);
+            if (! w.queues[p].empty()) {
+                item = std::move(w.queues[p].front());
+                w.queues[p].pop_front();
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(Item& item) {
+    JobGroup* group = item.group;
+    item.fn();
+    item = {};
+    // the group may be gone right after its last job
+    if (group->m_pending.fetch_sub(1) != 1) return;
+    m_done.fetch_add(1);
+    if (m_waiting.load() > 0) m_done.notify_all();
+}
+
+void JobSystem::run(JobGroup& group, Job job) {
+    auto lock = lockWorkers();
+    group.m_pending++;
+    push({ std::move(job), &group });
+}
+
+void JobSystem::wait(JobGroup& group) {
+    auto       lock = lockWorkers();
+    const bool load = group.m_priority == JobPriority::Load;
+    const bool own  = t_owner == this;
+    Item       item;
+    while (! group.done()) {
+        if (take(item, own ? t_index : NoWorker, load)) {
+            execute(item);
+            continue;
+        }
+        u32 done = m_done.load();
+        m_waiting++;
+        if (! group.done()) m_done.wait(done);
+        m_waiting--;
+    }
+}
+
+TaskGraph::Task TaskGraph::add(JobSystem::Job fn, std::initializer_list<Task> after) {
+    Task  task = m_nodes.size();
+    auto& node = m_nodes.emplace_back();
+    node.fn    = std::move(fn);
+    for (Task t : after) {
+        if (t >= task) {
+            LOG_ERROR("task %d comes after %d which isn't added yet", (int)task, (int)t);
+            continue;
+        }
+        m_nodes[t].next.push_back(task);
+        node.deps++;
+    }
+    return task;
+}
+
+void TaskGraph::run(JobSystem& jobs, JobPriority priority) {
+    JobGroup group(priority);
+    for (auto& node : m_nodes) node.pending = node.deps;
+    for (Task t = 0; t < m_nodes.size(); t++) {
+        if (m_nodes[t].deps == 0) {
+            jobs.run(group, [this, &jobs, &group, t]() {
+                runTask(jobs, group, t);
+            });
+        }
+    }
+    jobs.wait(group);
+}
+
+void TaskGraph::runTask(JobSystem& jobs, JobGroup& group, Task task) {
+    auto& node = m_nodes[task];
+    node.fn();
+    // posted before this one finishes, the group never reads done in between
+    for (Task t : node.next) {
+        if (--m_nodes[t].pending == 0) {
+            jobs.run(group, [this, &jobs, &group, t]() {
+                runTask(jobs, group, t);
+            });
+        }
+    }
+}
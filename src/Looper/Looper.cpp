@@ -1,41 +1,198 @@
 #include "Looper.hpp"
 #include <algorithm>
 
+#include "Core/MapSet.hpp"
 #include "Core/Visitors.hpp"
 #include "Utils/Logging.h"
+#include "Utils/MemUse.hpp"
+#include "Utils/Trace.h"
 
 #include <cassert>
+#include <shared_mutex>
+#include <unordered_set>
 
 using namespace wallpaper::looper;
 
 using Lock = std::unique_lock<std::mutex>;
 
+namespace wallpaper::looper
+{
+// messages of one looper done with, handed out again instead of allocated
+class MessagePool : NoCopy, NoMove {
+public:
+    ~MessagePool() {
+        for (auto* msg : m_free) delete msg;
+    }
+
+    Message* take() {
+        Lock lock(m_mutex);
+        if (m_free.empty()) return nullptr;
+        auto* msg = m_free.back();
+        m_free.pop_back();
+        return msg;
+    }
+    void give(Message* msg) {
+        msg->reset();
+        {
+            Lock lock(m_mutex);
+            if (m_free.size() < MaxFree) {
+                m_free.push_back(msg);
+                return;
+            }
+        }
+        delete msg;
+    }
+
+private:
+    // more than a burst of posts ever has in flight
+    constexpr static size_t MaxFree { 32 };
+
+    std::mutex            m_mutex;
+    std::vector<Message*> m_free;
+};
+} // namespace wallpaper::looper
+
+namespace
+{
+// the deleter of pooled messages, the pool may be gone before them
+struct Recycle {
+    std::weak_ptr<MessagePool> pool;
+    void                       operator()(Message* msg) const {
+        if (auto p = pool.lock())
+            p->give(msg);
+        else
+            delete msg;
+    }
+};
+
+// item names are a few literals, kept once for the program instead of in every item
+std::string_view InternName(std::string_view name) {
+    static std::shared_mutex                                             mutex;
+    static std::unordered_set<std::string, wallpaper::StringHash, std::equal_to<>> names;
+    {
+        std::shared_lock lock(mutex);
+        auto             it = names.find(name);
+        if (it != names.end()) return *it;
+    }
+    std::unique_lock lock(mutex);
+    return *names.emplace(name).first;
+}
+} // namespace
+
 void Looper::setName(std::string_view name) { m_name.assign(name); }
 
 const std::string_view Looper::name() const { return m_name; }
 
-Looper::Looper() {}
-Looper::~Looper() { stop(); }
+// the ring is held in place, messages count themselves
+Looper::Looper(): m_pool(std::make_shared<MessagePool>()) {
+    memuse::Add(memuse::Pool::LooperMessages, sizeof(m_ring));
+}
+Looper::~Looper() {
+    stop();
+    memuse::Sub(memuse::Pool::LooperMessages, sizeof(m_ring));
+}
+
+bool Looper::nextDue(std::shared_ptr<Message>& msg) {
+    auto due = m_next_due.load();
+    if (due == NoDue || due > Clock::now().time_since_epoch().count()) return false;
+    Lock lock(m_mutex);
+    auto it = m_delayed.begin();
+    if (it == m_delayed.end() || it->first > Clock::now()) return false;
+    msg = std::move(it->second);
+    m_delayed.erase(it);
+    m_next_due = m_delayed.empty() ? NoDue : m_delayed.begin()->first.time_since_epoch().count();
+    return true;
+}
+
+bool Looper::nextUrgent(std::shared_ptr<Message>& msg) {
+    if (! m_has_urgent.load()) return false;
+    Lock lock(m_mutex);
+    if (m_urgent.empty()) return false;
+    msg = std::move(m_urgent.front());
+    m_urgent.pop_front();
+    m_has_urgent = ! m_urgent.empty();
+    return true;
+}
+
+bool Looper::next(std::shared_ptr<Message>& msg) {
+    if (nextUrgent(msg)) return true;
+    if (nextDue(msg)) return true;
+    Posted posted;
+    while (msg == nullptr) {
+        if (! m_ring.pop(posted)) {
+            // the overflow is behind all of the ring, a push under way wakes the loop
+            if (! m_overflowing.load() || ! m_ring.empty()) return false;
+            Lock lock(m_mutex);
+            if (! m_overflow.empty()) {
+                posted = std::move(m_overflow.front());
+                m_overflow.pop_front();
+            }
+            if (m_overflow.empty()) m_overflowing = false;
+            if (posted.msg == nullptr && ! posted.key) return false;
+        }
+        if (posted.key) {
+            Lock lock(m_mutex);
+            auto it = m_coalesced.find(*posted.key);
+            if (it != m_coalesced.end()) {
+                msg = std::move(it->second);
+                // the node goes back to the next post of a key, coalesced posts don't allocate
+                m_spare_nodes.push_back(m_coalesced.extract(it));
+            }
+        } else {
+            msg = std::move(posted.msg);
+        }
+        posted = {};
+    }
+    return true;
+}
 
 bool Looper::loop() {
-    MessageWrapper msg;
-    {
-        Lock lock(m_mutex);
+    std::shared_ptr<Message> msg;
+    if (! next(msg)) {
         if (! m_running) return false;
-        if (m_msg_queue.empty()) {
-            m_condition.wait(lock);
-            return true;
-        }
-        msg = *m_msg_queue.begin();
-        m_msg_queue.erase(m_msg_queue.begin());
+        // parked, then checked again, a post seeing the loop not parked yet is found here
+        uint32_t signal = m_signal.load();
+        m_parked        = Park::Parked;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool got = next(msg);
+        if (! got && m_running) park(signal);
+        m_parked = Park::Awake;
+        if (! got) return true;
     }
-    msg.msg->deliver();
-    if (msg.msg->cleanAfterDeliver()) {
-        msg.msg->cleanContent();
+    msg->deliver();
+    if (msg->cleanAfterDeliver()) {
+        msg->cleanContent();
     }
     return true;
 }
 
+void Looper::park(uint32_t signal) {
+    auto due = m_next_due.load();
+    if (due == NoDue) {
+        m_signal.wait(signal);
+        return;
+    }
+    // a wake reading parked before this bumped the signal already
+    Lock lock(m_mutex);
+    m_parked = Park::ParkedUntil;
+    m_timed.wait_until(lock, Clock::time_point(Clock::duration(due)), [this, signal]() {
+        return m_signal.load() != signal;
+    });
+}
+
+void Looper::wake() {
+    if (m_parked.load() == Park::ParkedUntil) {
+        {
+            Lock lock(m_mutex);
+            m_signal.fetch_add(1);
+        }
+        m_timed.notify_one();
+    } else {
+        m_signal.fetch_add(1);
+        m_signal.notify_one();
+    }
+}
+
 status_t Looper::start() {
     Lock lock(m_mutex);
     if (m_running) return status_t::INVALID_OPERATION;
@@ -47,6 +204,7 @@ status_t Looper::start() {
             {
                 looper = wlooper.lock().get();
                 LOG_INFO("%s looper started", looper->name().data());
+                TRACE_THREAD(looper->name());
                 looper->m_running = true;
             }
             std::string name { looper->name() };
@@ -69,8 +227,8 @@ void Looper::stop() {
         Lock lock(m_mutex);
         m_thread.swap(thd);
         m_running = false;
-        m_condition.notify_one();
     }
+    wake();
     if (thd.joinable()) {
         if (std::this_thread::get_id() == thd.get_id()) {
             LOG_INFO("detach %s looper", m_name.c_str());
@@ -81,12 +239,66 @@ void Looper::stop() {
     }
 }
 
-void Looper::post(const std::shared_ptr<Message>& msg) {
+void Looper::enqueue(Posted&& posted) {
+    if (m_overflowing.load() || ! m_ring.push(std::move(posted))) {
+        Lock lock(m_mutex);
+        m_overflow.push_back(std::move(posted));
+        m_overflowing = true;
+    }
+    // pairs with the fence of the loop parking
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_parked.load() != Park::Awake) wake();
+}
+
+void Looper::post(const std::shared_ptr<Message>& msg) { enqueue({ msg, std::nullopt }); }
+
+void Looper::post(const std::shared_ptr<Message>& msg, const CoalesceKey& key) {
+    {
+        Lock lock(m_mutex);
+        auto it = m_coalesced.find(key);
+        if (it != m_coalesced.end()) {
+            it->second = msg;
+            return;
+        }
+        if (m_spare_nodes.empty()) {
+            m_coalesced.emplace(key, msg);
+        } else {
+            auto node     = std::move(m_spare_nodes.back());
+            node.key()    = key;
+            node.mapped() = msg;
+            m_spare_nodes.pop_back();
+            m_coalesced.insert(std::move(node));
+        }
+    }
+    enqueue({ nullptr, key });
+}
+
+void Looper::postDelayed(const std::shared_ptr<Message>& msg, Clock::duration delay) {
     {
         Lock lock(m_mutex);
-        m_msg_queue.insert(m_msg_queue.end(), { msg });
+        m_delayed.emplace(Clock::now() + delay, msg);
+        m_next_due = m_delayed.begin()->first.time_since_epoch().count();
     }
-    m_condition.notify_one();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_parked.load() != Park::Awake) wake();
+}
+
+void Looper::postUrgent(const std::shared_ptr<Message>& msg) {
+    {
+        Lock lock(m_mutex);
+        m_urgent.push_back(msg);
+        m_has_urgent = true;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_parked.load() != Park::Awake) wake();
+}
+
+std::shared_ptr<Message> Looper::obtain(uint32_t what, const std::shared_ptr<Handler>& handler) {
+    Message* msg = m_pool->take();
+    if (msg == nullptr) msg = new Message();
+    msg->setWhat(what);
+    msg->setTarget(handler);
+    return std::shared_ptr<Message>(msg, Recycle { m_pool });
 }
 
 handler_id Looper::registerHandler(const std::shared_ptr<Handler>& handler) {
@@ -126,11 +338,19 @@ bool Handler::setID(handler_id id, std::weak_ptr<Looper> looper) {
 
 void Handler::deliverMessage(const std::shared_ptr<Message>& msg) { onMessageReceived(msg); }
 
-Message::Message(): m_what(0), m_target(Handler::INVALID_HANDLER_ID) {}
+Message::Message(): m_what(0), m_target(Handler::INVALID_HANDLER_ID) {
+    memuse::Add(memuse::Pool::LooperMessages, sizeof(Message));
+}
 Message::Message(uint32_t what, const std::shared_ptr<Handler>& handler): m_what(what) {
+    memuse::Add(memuse::Pool::LooperMessages, sizeof(Message));
     setTarget(handler);
 }
 
+Message::~Message() {
+    clearCommand();
+    memuse::Sub(memuse::Pool::LooperMessages, sizeof(Message));
+}
+
 uint32_t Message::what() const { return m_what; };
 
 std::shared_ptr<Message> Message::create() {
@@ -138,6 +358,9 @@ std::shared_ptr<Message> Message::create() {
     return std::make_shared<Message_sp>();
 }
 std::shared_ptr<Message> Message::create(uint32_t what, const std::shared_ptr<Handler>& handler) {
+    if (handler != nullptr) {
+        if (auto looper = handler->getLooper().lock()) return looper->obtain(what, handler);
+    }
     return std::shared_ptr<Message>(new Message(what, handler));
 }
 
@@ -164,6 +387,34 @@ status_t Message::post() {
     return status_t::NOT_FOUND;
 }
 
+status_t Message::postCoalesced(std::string_view tag, uint64_t generation) {
+    auto looper = m_looper.lock();
+    if (looper != nullptr) {
+        looper->post(shared_from_this(),
+                     { m_target, m_what, InternName(tag).data(), generation });
+        return status_t::OK;
+    }
+    return status_t::NOT_FOUND;
+}
+
+status_t Message::postDelayed(std::chrono::steady_clock::duration delay) {
+    auto looper = m_looper.lock();
+    if (looper != nullptr) {
+        looper->postDelayed(shared_from_this(), delay);
+        return status_t::OK;
+    }
+    return status_t::NOT_FOUND;
+}
+
+status_t Message::postUrgent() {
+    auto looper = m_looper.lock();
+    if (looper != nullptr) {
+        looper->postUrgent(shared_from_this());
+        return status_t::OK;
+    }
+    return status_t::NOT_FOUND;
+}
+
 void Message::deliver() {
     auto handler = m_handler.lock();
     if (handler != nullptr) {
@@ -171,39 +422,42 @@ void Message::deliver() {
     }
 }
 
-void Message::Item::setName(std::string_view name) { this->name.assign(name); }
+void Message::Item::setName(std::string_view name) { this->name = InternName(name); }
 
 int32_t Message::countEntries() const { return m_num_items; }
 
 const Message::Item* Message::getEntryAt(int32_t index) const {
-    if (index < 0 || index >= m_num_items || index >= MaxNumItems) return nullptr;
-    return &m_items[(size_t)index];
+    if (index < 0 || index >= m_num_items) return nullptr;
+    return &itemAt(index);
+}
+
+Message::Item& Message::itemAt(int32_t index) {
+    if (index < NumInlineItems) return m_items[(size_t)index];
+    return m_spill_items[(size_t)(index - NumInlineItems)];
+}
+const Message::Item& Message::itemAt(int32_t index) const {
+    if (index < NumInlineItems) return m_items[(size_t)index];
+    return m_spill_items[(size_t)(index - NumInlineItems)];
 }
 
 template<typename T>
 const Message::Item* Message::findItem(std::string_view name) const {
-    auto end = m_items.begin() + m_num_items;
-    auto it  = std::find_if(m_items.begin(), end, [name](const Item& item) {
-        bool ok = item.name == name && std::holds_alternative<T>(item.value);
-        return ok;
-    });
-    return it != end ? &*it : nullptr;
+    for (int32_t i = 0; i < m_num_items; i++) {
+        const auto& item = itemAt(i);
+        if (item.name == name && std::holds_alternative<T>(item.value)) return &item;
+    }
+    return nullptr;
 }
 
 Message::Item* Message::allocateItem(std::string_view name) {
-    Item* item { nullptr };
-    if (m_num_items >= MaxNumItems) return item;
-    auto end = m_items.begin() + m_num_items;
-    auto it  = std::find_if(m_items.begin(), end, [name](const Item& item) {
-        return item.name == name;
-    });
-    item     = &*it;
-    if (it == end) {
-        item->name.assign(name);
-        m_num_items++;
+    for (int32_t i = 0; i < m_num_items; i++) {
+        if (itemAt(i).name == name) return &itemAt(i);
     }
-
-    return item;
+    if (m_num_items >= MaxNumItems) return nullptr;
+    if (m_num_items >= NumInlineItems) m_spill_items.emplace_back();
+    auto& item = itemAt(m_num_items++);
+    item.setName(name);
+    return &item;
 }
 
 #define BASIC_TYPE(NAME, TYPENAME)                                           \
@@ -242,4 +496,22 @@ template const Message::Item* Message::findItem<std::shared_ptr<void>>(std::stri
 
 bool Message::cleanAfterDeliver() const { return m_clean_after_dliver; }
 void Message::setCleanAfterDeliver(bool v) { m_clean_after_dliver = v; };
-void Message::cleanContent() { m_items.fill({}); }
+void Message::cleanContent() {
+    m_items.fill({});
+    m_spill_items.clear();
+    m_num_items = 0;
+    clearCommand();
+}
+
+void Message::clearCommand() {
+    if (m_command_destroy != nullptr) m_command_destroy(m_command.data());
+    m_command_type    = nullptr;
+    m_command_destroy = nullptr;
+}
+
+void Message::reset() {
+    cleanContent();
+    m_clean_after_dliver = false;
+    m_what               = 0;
+    setTarget(nullptr);
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <shared_mutex>
+#include <span>
+#include <vector>
+
+namespace wallpaper
+{
+namespace looper
+{
+
+// frame work is taken before load work, waiting on frame work never runs load work
+enum class JobPriority : u8
+{
+    Load  = 0,
+    Frame = 1
+};
+
+// the jobs of a batch, done once all of them ran
+class JobGroup : NoCopy, NoMove {
+public:
+    explicit JobGroup(JobPriority priority = JobPriority::Load): m_priority(priority) {}
+
+    JobPriority priority() const { return m_priority; }
+    bool        done() const { return m_pending.load() == 0; }
+
+private:
+    friend class JobSystem;
+
+    JobPriority        m_priority;
+    std::atomic<usize> m_pending { 0 };
+};
+
+// Workers with a queue each for every priority. A worker runs its own queue newest first and
+// steals the oldest of the others when it's empty, jobs a job posts stay on its thread. Posts
+// from outside go round the workers.
+// A thread waiting on a group runs queued jobs meanwhile, so waiting from a job is fine.
+class JobSystem : NoCopy, NoMove {
+public:
+    using Job = std::function<void()>;
+
+    constexpr static usize MaxWorkers { 16 };
+
+    // process wide, started on first use
+    static JobSystem& Shared();
+
+    // 0 picks the count from the cores, there is one at least
+    explicit JobSystem(usize workers = 0);
+    ~JobSystem();
+
+    // restarts the workers once what's queued ran, not from a job
+    void  setWorkerCount(usize);
+    usize workerCount() const;
+    // the last num workers only run load jobs, as platform::ThreadClass::Load, one is always left
+    // for frame jobs, restarts the workers like setWorkerCount
+    void setLoadWorkers(usize num);
+
+    void run(JobGroup&, Job);
+    void wait(JobGroup&);
+
+    // fn(index) for every index below count, grain indices a job, blocks till all ran
+    template<typename F>
+    void parallelFor(usize count, F&& fn, JobPriority priority, usize grain = 1) {
+        if (count == 0) return;
+        grain = std::max<usize>(grain, 1);
+        JobGroup group(priority);
+        for (usize first = grain; first < count; first += grain) {
+            usize last = std::min(first + grain, count);
+            run(group, [first, last, &fn]() {
+                for (usize i = first; i < last; i++) fn(i);
+            });
+        }
+        for (usize i = 0; i < std::min(grain, count); i++) fn(i);
+        wait(group);
+    }
+
+    template<typename T, typename F>
+    void parallelFor(std::span<T> items, F&& fn, JobPriority priority, usize grain = 1) {
+        parallelFor(
+            items.size(),
+            [&items, &fn](usize i) {
+                fn(items[i]);
+            },
+            priority,
+            grain);
+    }
+
+private:
+    struct Item {
+        Job       fn;
+        JobGroup* group { nullptr };
+    };
+    struct Worker;
+
+    std::shared_lock<std::shared_mutex> lockWorkers() const;
+
+    void start(usize);
+    void stop();
+    void loop(usize self);
+    void push(Item&&);
+    // own queue first, then the others, frame before load
+    bool take(Item&, usize self, bool load, bool frame = true);
+    void execute(Item&);
+
+    // workers are swapped under it, threads outside hold it shared while posting and waiting
+    mutable std::shared_mutex            m_workers_mutex;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<bool>                    m_stop { false };
+    std::atomic<usize>                   m_next_worker { 0 };
+    // asked for, and how many of the running workers are load only
+    usize              m_load_asked { 0 };
+    std::atomic<usize> m_load_only { 0 };
+
+    // bumped for sleeping workers when a job is posted
+    std::atomic<u32> m_signal { 0 };
+    std::atomic<u32> m_sleeping { 0 };
+    // bumped for waiters when a group is done
+    std::atomic<u32> m_done { 0 };
+    std::atomic<u32> m_waiting { 0 };
+};
+
+// Tasks run once those they come after are done, which are added before them. A graph may run
+// again once it's done.
+class TaskGraph : NoCopy, NoMove {
+public:
+    using Task = usize;
+
+    Task  add(JobSystem::Job, std::initializer_list<Task> after = {});
+    usize size() const { return m_nodes.size(); }
+    void  clear() { m_nodes.clear(); }
+
+    // blocks till every task ran
+    void run(JobSystem&, JobPriority);
+
+private:
+    struct Node {
+        JobSystem::Job    fn;
+        std::vector<Task> next;
+        u32               deps { 0 };
+        std::atomic<u32>  pending { 0 };
+    };
+    void runTask(JobSystem&, JobGroup&, Task);
+
+    std::deque<Node> m_nodes;
+};
+
+} // namespace looper
+} // namespace wallpaper
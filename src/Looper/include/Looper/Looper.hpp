@@ -4,16 +4,23 @@
 #include <cstdint>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
+#include <optional>
 #include <string>
 #include <thread>
-#include <list>
+#include <deque>
 #include <map>
 #include <string_view>
 #include <variant>
 #include <array>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
 
 #include "Core/Visitors.hpp"
 #include "Core/NoCopyMove.hpp"
+#include "Core/MpscRing.hpp"
 
 namespace wallpaper
 {
@@ -31,6 +38,18 @@ enum class status_t
 using handler_id = int32_t;
 class Handler;
 class Message;
+class MessagePool;
+
+// messages posted with the same key replace each other while queued, the tag is interned.
+// a new generation starts over behind what was posted in between
+struct CoalesceKey {
+    handler_id  target { 0 };
+    uint32_t    what { 0 };
+    const char* tag { nullptr };
+    uint64_t    generation { 0 };
+
+    auto operator<=>(const CoalesceKey&) const = default;
+};
 
 class Looper : NoCopy, public std::enable_shared_from_this<Looper> {
 public:
@@ -42,23 +61,75 @@ public:
     status_t               start();
     void                   stop();
     void                   post(const std::shared_ptr<Message>&);
+    // a queued message of the key is replaced by this one, which keeps its place in the queue
+    void post(const std::shared_ptr<Message>&, const CoalesceKey&);
+    // after the delay, delayed messages go out in order of their due time
+    void postDelayed(const std::shared_ptr<Message>&, std::chrono::steady_clock::duration);
+    // ahead of everything queued but urgent ones posted before, for what shouldn't wait behind
+    // heavy work
+    void postUrgent(const std::shared_ptr<Message>&);
     const std::string_view name() const;
     void                   setName(std::string_view);
 
+    // a message from this looper's free list, it goes back there when the last reference is
+    // dropped after delivery
+    std::shared_ptr<Message> obtain(uint32_t what, const std::shared_ptr<Handler>&);
+
 private:
-    struct MessageWrapper {
-        std::shared_ptr<Message> msg;
+    using Clock = std::chrono::steady_clock;
+
+    // a coalesced one has only the key, its message is the latest of the key when delivered
+    struct Posted {
+        std::shared_ptr<Message>   msg;
+        std::optional<CoalesceKey> key;
     };
+    enum class Park : uint8_t
+    {
+        Awake,
+        Parked,
+        // till the next delayed one is due
+        ParkedUntil
+    };
+    constexpr static Clock::rep NoDue { Clock::duration::max().count() };
+
     bool loop();
+    void enqueue(Posted&&);
+    bool next(std::shared_ptr<Message>&);
+    bool nextDue(std::shared_ptr<Message>&);
+    bool nextUrgent(std::shared_ptr<Message>&);
+    void park(uint32_t signal);
+    void wake();
 
-    bool                    m_running { false };
-    std::string             m_name { "unknown" };
-    std::mutex              m_mutex;
-    std::condition_variable m_condition;
+    std::atomic<bool> m_running { false };
+    std::string       m_name { "unknown" };
+    // handlers, the overflow, coalesced and delayed messages
+    std::mutex m_mutex;
 
     std::thread                                  m_thread;
-    std::list<MessageWrapper>                    m_msg_queue;
     std::map<handler_id, std::weak_ptr<Handler>> m_reg_handler;
+
+    // posts go to the ring, the overflow takes them while it is full and until it is drained,
+    // which keeps the order of a thread's posts
+    MpscRing<Posted, 256> m_ring;
+    std::deque<Posted>    m_overflow;
+    std::atomic<bool>     m_overflowing { false };
+
+    std::deque<std::shared_ptr<Message>> m_urgent;
+    std::atomic<bool>                    m_has_urgent { false };
+
+    std::map<CoalesceKey, std::shared_ptr<Message>>            m_coalesced;
+    std::vector<decltype(m_coalesced)::node_type>              m_spare_nodes;
+    std::multimap<Clock::time_point, std::shared_ptr<Message>> m_delayed;
+    std::atomic<Clock::rep>                                    m_next_due { NoDue };
+
+    // bumped to wake the loop, posts only touch it when the loop is parked, a timed park waits
+    // on the condition
+    std::atomic<uint32_t>   m_signal { 0 };
+    std::atomic<Park>       m_parked { Park::Awake };
+    std::condition_variable m_timed;
+
+    // shared with the messages out there, it may go before the last of them
+    std::shared_ptr<MessagePool> m_pool;
 };
 
 class Handler : NoCopy, public std::enable_shared_from_this<Handler> {
@@ -91,14 +162,22 @@ private:
     Message();
     Message(uint32_t what, const std::shared_ptr<Handler>&);
     friend class Looper;
+    friend class MessagePool;
 
 public:
+    ~Message();
+
     static std::shared_ptr<Message> create();
+    // pooled by the handler's looper if it has one
     static std::shared_ptr<Message> create(uint32_t what, const std::shared_ptr<Handler>&);
     uint32_t                        what() const;
     void                            setTarget(const std::shared_ptr<Handler>&);
     void                            setWhat(uint32_t);
     status_t                        post();
+    // replaces a queued one of the same target, what, tag and generation
+    status_t postCoalesced(std::string_view tag = {}, uint64_t generation = 0);
+    status_t postDelayed(std::chrono::steady_clock::duration delay);
+    status_t postUrgent();
     // status_t postAndWaitResponse(const std::shared_ptr<Message>&);
 
 private:
@@ -114,10 +193,11 @@ public:
     using ItemValue =
         std::variant<bool, int32_t, float, std::string, std::shared_ptr<void>, visitor::NoType>;
 
+    // names are interned, they live as long as the program
     struct Item {
-        ItemValue   value { visitor::NoType() };
-        std::string name;
-        void        setName(std::string_view name);
+        ItemValue        value { visitor::NoType() };
+        std::string_view name;
+        void             setName(std::string_view name);
     };
 
     int32_t     countEntries() const;
@@ -147,19 +227,60 @@ public:
         return false;
     }
 
+    // A command of the handler in place of named items, mostly a variant of its command structs.
+    // It's held in the message, which the pool keeps, so posting one allocates nothing. For a
+    // variant what is the index of the command, commands coalesce with those of their kind.
+    template<typename T>
+    void setCommand(T&& cmd) {
+        using C = std::decay_t<T>;
+        static_assert(sizeof(C) <= MaxCommandSize && alignof(C) <= alignof(std::max_align_t),
+                      "command too large for a message");
+        clearCommand();
+        if constexpr (requires(const C& c) { c.index(); }) m_what = (uint32_t)cmd.index();
+        new (m_command.data()) C(std::forward<T>(cmd));
+        m_command_type    = &CommandType<C>;
+        m_command_destroy = [](void* p) {
+            static_cast<C*>(p)->~C();
+        };
+    }
+    // null if the message has no command or one of another type
+    template<typename C>
+    C* command() {
+        if (m_command_type != &CommandType<C>) return nullptr;
+        return std::launder(reinterpret_cast<C*>(m_command.data()));
+    }
+
     bool cleanAfterDeliver() const;
     void setCleanAfterDeliver(bool v);
+    // the items and the command
     void cleanContent();
 
 private:
     template<typename T>
     const Item* findItem(std::string_view name) const;
     Item*       allocateItem(std::string_view name);
+    Item&       itemAt(int32_t index);
+    const Item& itemAt(int32_t index) const;
+    // back to a fresh message, what the items held is released
+    void reset();
+    void clearCommand();
+
+    // one address for each type of command
+    template<typename C>
+    inline static constexpr char CommandType {};
+
+    // messages carry a few items, the inline ones cover them and more go to the spill
+    constexpr static int32_t         MaxNumItems    = 64;
+    constexpr static int32_t         NumInlineItems = 4;
+    std::array<Item, NumInlineItems> m_items;
+    std::vector<Item>                m_spill_items;
+    int32_t                          m_num_items { 0 };
+    bool                             m_clean_after_dliver { false };
 
-    constexpr static int32_t      MaxNumItems = 64;
-    std::array<Item, MaxNumItems> m_items;
-    int32_t                       m_num_items { 0 };
-    bool                          m_clean_after_dliver { false };
+    constexpr static std::size_t MaxCommandSize { 192 };
+    alignas(std::max_align_t) std::array<std::byte, MaxCommandSize> m_command;
+    const void*                                                     m_command_type { nullptr };
+    void (*m_command_destroy)(void*) { nullptr };
 };
 
 } // namespace looper
@@ -0,0 +1,135 @@
+#include "ParticleBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+using namespace wallpaper;
+
+namespace
+{
+constexpr usize PadSize(usize n) {
+    return (n + ParticleBuffer::Padding - 1) / ParticleBuffer::Padding * ParticleBuffer::Padding;
+}
+} // namespace
+
+ParticleBuffer::~ParticleBuffer() {
+    if (m_data != nullptr) ::operator delete[](m_data, std::align_val_t { Alignment });
+}
+
+void ParticleBuffer::reserve(usize n) {
+    if (n > m_capacity) grow(n);
+}
+
+void ParticleBuffer::grow(usize n) {
+    usize capacity = PadSize(std::max<usize>(n, 64));
+
+    float* data = static_cast<float*>(
+        ::operator new[](capacity * StreamNum * sizeof(float), std::align_val_t { Alignment }));
+    // zeroed so padding lanes never hold nan or denormals
+    std::memset(data, 0, capacity * StreamNum * sizeof(float));
+    if (m_data != nullptr) {
+        for (usize s = 0; s < StreamNum; s++) {
+            std::memcpy(data + s * capacity, m_data + s * m_capacity, m_size * sizeof(float));
+        }
+        ::operator delete[](m_data, std::align_val_t { Alignment });
+    }
+    m_data     = data;
+    m_capacity = capacity;
+    m_new.resize(capacity, 0);
+    m_held.set(capacity * (StreamNum * sizeof(float) + sizeof(uint8_t)));
+}
+
+void ParticleBuffer::push_back(const Particle& p) {
+    if (m_size == m_capacity) grow(m_capacity * 2);
+    set(m_size++, p);
+    m_fresh = false;
+}
+
+void ParticleBuffer::set(usize i, const Particle& p) {
+    const float values[StreamNum] {
+        p.position[0],     p.position[1],        p.position[2],        p.velocity[0],
+        p.velocity[1],     p.velocity[2],        p.rotation[0],        p.rotation[1],
+        p.rotation[2],     p.angularVelocity[0], p.angularVelocity[1], p.angularVelocity[2],
+        p.color[0],        p.color[1],           p.color[2],           p.alpha,
+        p.size,            p.lifetime,           p.init.color[0],      p.init.color[1],
+        p.init.color[2],   p.init.alpha,         p.init.size,          p.init.lifetime,
+        p.position[0],     p.position[1],        p.position[2],
+    };
+    for (usize s = 0; s < StreamNum; s++) m_data[s * m_capacity + i] = values[s];
+    m_new[i] = p.mark_new;
+}
+
+Particle ParticleBuffer::get(usize i) const {
+    Particle p;
+    p.position        = { at(PosX, i), at(PosY, i), at(PosZ, i) };
+    p.velocity        = { at(VelX, i), at(VelY, i), at(VelZ, i) };
+    p.rotation        = { at(RotX, i), at(RotY, i), at(RotZ, i) };
+    p.angularVelocity = { at(AngularX, i), at(AngularY, i), at(AngularZ, i) };
+    p.color           = { at(ColorR, i), at(ColorG, i), at(ColorB, i) };
+    p.alpha           = at(Alpha, i);
+    p.size            = at(Size, i);
+    p.lifetime        = at(Lifetime, i);
+    p.init.color      = { at(InitColorR, i), at(InitColorG, i), at(InitColorB, i) };
+    p.init.alpha      = at(InitAlpha, i);
+    p.init.size       = at(InitSize, i);
+    p.init.lifetime   = at(InitLifetime, i);
+    p.mark_new        = isNew(i);
+    return p;
+}
+
+void ParticleBuffer::sortByAge() {
+    const float* lifetime = stream(Lifetime);
+
+    // three buckets keep the order inside a group, same result as a stable sort
+    m_order.clear();
+    m_order.reserve(m_size);
+    for (u32 i = 0; i < m_size; i++)
+        if (lifetime[i] > 0.0f && ! isNew(i)) m_order.push_back(i);
+    for (u32 i = 0; i < m_size; i++)
+        if (lifetime[i] > 0.0f && isNew(i)) m_order.push_back(i);
+    for (u32 i = 0; i < m_size; i++)
+        if (! (lifetime[i] > 0.0f)) m_order.push_back(i);
+
+    m_scratch.resize(m_size);
+    for (usize s = 0; s < StreamNum; s++) {
+        float* data = stream((Stream)s);
+        for (usize i = 0; i < m_size; i++) m_scratch[i] = data[m_order[i]];
+        std::copy_n(m_scratch.begin(), m_size, data);
+    }
+    std::vector<uint8_t> marks(m_size);
+    for (usize i = 0; i < m_size; i++) marks[i] = m_new[m_order[i]];
+    std::copy(marks.begin(), marks.end(), m_new.begin());
+}
+
+void ParticleBuffer::savePositions() {
+    for (usize s = 0; s < 3; s++) {
+        std::copy_n(stream((Stream)(PosX + s)), m_size, stream((Stream)(PrevPosX + s)));
+    }
+}
+
+bool ParticleBuffer::compact(std::vector<isize>& remap) {
+    const float* lifetime = stream(Lifetime);
+
+    usize first = 0;
+    while (first < m_size && lifetime[first] > 0.0f) first++;
+    if (first == m_size) return false;
+
+    m_order.clear();
+    remap.resize(m_size);
+    for (usize i = 0; i < m_size; i++) {
+        bool live = lifetime[i] > 0.0f;
+        remap[i]  = live ? (isize)m_order.size() : -1;
+        if (live) m_order.push_back((u32)i);
+    }
+
+    // everything before the first dead stays, the rest only moves down
+    const usize live = m_order.size();
+    for (usize s = 0; s < StreamNum; s++) {
+        float* data = stream((Stream)s);
+        for (usize i = first; i < live; i++) data[i] = data[m_order[i]];
+    }
+    for (usize i = first; i < live; i++) m_new[i] = m_new[m_order[i]];
+    m_size = live;
+    return true;
+}
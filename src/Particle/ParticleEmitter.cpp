@@ -3,24 +3,25 @@
 #include "Utils/Algorism.h"
 #include "Utils/Logging.h"
 #include "Utils/Algorism.h"
-#include "Core/Random.hpp"
+#include "ParticleRandom.h"
 
 #include <Eigen/src/Core/Matrix.h>
+#include <algorithm>
 #include <random>
 #include <array>
 #include <tuple>
 
 using namespace wallpaper;
 
-typedef std::function<Particle()> GenParticleOp;
-typedef std::function<Particle()> SpwanOp;
-
 namespace
 {
 
-inline std::tuple<u32, bool> FindLastParticle(std::span<const Particle> ps, u32 last) {
-    for (u32 i = last; i < ps.size(); i++) {
-        if (! ParticleModify::LifetimeOk(ps[i])) return { i, true };
+// slots past maxcount are not reused, they drain when it shrinks
+inline std::tuple<u32, bool> FindLastParticle(const ParticleBuffer& ps, u32 last, u32 maxcount) {
+    const float* lifetime = ps.stream(ParticleBuffer::Lifetime);
+    const u32    end      = std::min<u32>((u32)ps.size(), maxcount);
+    for (u32 i = last; i < end; i++) {
+        if (! (lifetime[i] > 0.0f)) return { i, true };
     }
     return { 0, false };
 }
@@ -34,44 +35,42 @@ inline u32 GetEmitNum(double& timer, float speed) {
     return num;
 }
 
-inline u32 Emitt(std::vector<Particle>& particles, u32 num, u32 maxcount, bool sort,
-                 SpwanOp Spwan) {
+template<typename SpwanOp>
+inline u32 Emitt(ParticleBuffer& particles, u32 num, u32 maxcount, bool sort, SpwanOp&& Spwan) {
     u32  lastPartcle = 0;
     bool has_dead    = true;
     u32  i           = 0;
 
     for (i = 0; i < num; i++) {
         if (has_dead) {
-            auto [r1, r2] = FindLastParticle(particles, lastPartcle);
+            auto [r1, r2] = FindLastParticle(particles, lastPartcle, maxcount);
             lastPartcle   = r1;
             has_dead      = r2;
         }
         if (has_dead) {
-            particles[lastPartcle] = Spwan();
+            particles.set(lastPartcle, Spwan());
 
         } else {
-            if (maxcount == particles.size()) break;
+            if (particles.size() >= maxcount) break;
             particles.push_back(Spwan());
         }
     }
 
-    if (sort) {
-        // old << new << dead
-        std::stable_sort(particles.begin(), particles.end(), [](const auto& a, const auto& b) {
-            bool l_a = ParticleModify::LifetimeOk(a);
-            bool l_b = ParticleModify::LifetimeOk(b);
-
-            return (l_a && ! l_b) ||
-                   (l_a && l_b && ! ParticleModify::IsNew(a) && ParticleModify::IsNew(b));
-        });
-    }
+    if (sort) particles.sortByAge();
 
     return i + 1;
 }
 
-inline Particle Spwan(GenParticleOp gen, std::vector<ParticleInitOp>& inis, double duration) {
+template<typename GenParticleOp>
+inline Particle Spwan(GenParticleOp&& gen, std::span<ParticleInitOp> inis, double duration) {
     auto particle = gen();
-    for (auto& el : inis) el(particle, duration);
+    for (auto& el : inis) {
+        std::visit(
+            [&particle, duration](auto& op) {
+                op(particle, duration);
+            },
+            el);
+    }
     return particle;
 }
 
@@ -88,66 +87,60 @@ inline void ApplySign(Eigen::Vector3d& p, int32_t x, int32_t y, int32_t z) noexc
 }
 } // namespace
 
-ParticleEmittOp ParticleBoxEmitterArgs::MakeEmittOp(ParticleBoxEmitterArgs a) {
-    double timer { 0.0f };
-    return [a, timer](std::vector<Particle>&       ps,
-                      std::vector<ParticleInitOp>& inis,
-                      u32                          maxcount,
-                      double                       timepass) mutable {
-        timer += timepass;
-        auto GenBox = [&]() {
-            Eigen::Vector3d pos;
-            for (int32_t i = 0; i < 3; i++)
-                pos[i] = algorism::lerp(Random::get(-1.0, 1.0), a.minDistance[i], a.maxDistance[i]);
-            auto p = Particle();
-            pos    = pos.cwiseProduct(Eigen::Vector3f { a.directions.data() }.cast<double>());
-            ParticleModify::MoveTo(p, pos);
-            ParticleModify::ChangeVelocity(p,
-                                           Random::get(a.minSpeed, a.maxSpeed) * pos.normalized());
-
-            ParticleModify::Move(p, a.orgin[0], a.orgin[1], a.orgin[2]);
-            return p;
-        };
-        u32 emit_num = GetEmitNum(timer, a.emitSpeed);
-        emit_num     = a.one_per_frame ? 1 : emit_num;
-        emit_num     = a.instantaneous > 0 && ps.empty() ? a.instantaneous : emit_num;
-        Emitt(ps, emit_num, maxcount, a.sort, [&]() {
-            return Spwan(GenBox, inis, 1.0f / a.emitSpeed);
-        });
+void ParticleBoxEmitter::operator()(ParticleBuffer& ps, std::span<ParticleInitOp> inis,
+                                    u32 maxcount, double timepass) {
+    const auto& a = m_args;
+    m_timer += timepass;
+    auto GenBox = [&]() {
+        Eigen::Vector3d pos;
+        for (int32_t i = 0; i < 3; i++)
+            pos[i] = algorism::lerp(
+                ParticleRandom::get(-1.0, 1.0), a.minDistance[i], a.maxDistance[i]);
+        auto p = Particle();
+        pos    = pos.cwiseProduct(Eigen::Vector3f { a.directions.data() }.cast<double>());
+        ParticleModify::MoveTo(p, pos);
+        ParticleModify::ChangeVelocity(p,
+                                       ParticleRandom::get(a.minSpeed, a.maxSpeed) *
+                                           pos.normalized());
+
+        ParticleModify::Move(p, a.orgin[0], a.orgin[1], a.orgin[2]);
+        return p;
     };
+    u32 emit_num = GetEmitNum(m_timer, a.emitSpeed);
+    emit_num     = a.one_per_frame ? 1 : emit_num;
+    emit_num     = a.instantaneous > 0 && ps.fresh() ? a.instantaneous : emit_num;
+    Emitt(ps, emit_num, maxcount, a.sort, [&]() {
+        return Spwan(GenBox, inis, 1.0f / a.emitSpeed);
+    });
 }
 
-ParticleEmittOp ParticleSphereEmitterArgs::MakeEmittOp(ParticleSphereEmitterArgs a) {
-    using namespace Eigen;
-    double timer { 0.0f };
-    return [a, timer](std::vector<Particle>&       ps,
-                      std::vector<ParticleInitOp>& inis,
-                      u32                          maxcount,
-                      double                       timepass) mutable {
-        timer += timepass;
-        auto GenSphere = [&]() {
-            auto   p = Particle();
-            double r = algorism::lerp(
-                std::pow(Random::get(0.0, 1.0), 1.0 / 3.0), a.minDistance, a.maxDistance);
-            Eigen::Vector3d sp = r * algorism::GenSphereSurfaceNormal(
-                                         [](double u, double o) {
-                                             return Random::get<std::normal_distribution<>>(u, o);
-                                         },
-                                         Eigen::Vector3f { a.directions.data() }.cast<double>());
-            ApplySign(sp, a.sign[0], a.sign[1], a.sign[2]);
-
-            ParticleModify::MoveTo(p, sp);
-            ParticleModify::ChangeVelocity(p,
-                                           Random::get(a.minSpeed, a.maxSpeed) * sp.normalized());
-
-            ParticleModify::Move(p, Eigen::Vector3f { a.orgin.data() }.cast<double>());
-            return p;
-        };
-        u32 emit_num = GetEmitNum(timer, a.emitSpeed);
-        emit_num     = a.one_per_frame ? 1 : emit_num;
-        emit_num     = a.instantaneous > 0 && ps.empty() ? a.instantaneous : emit_num;
-        Emitt(ps, emit_num, maxcount, a.sort, [&]() {
-            return Spwan(GenSphere, inis, 1.0f / a.emitSpeed);
-        });
+void ParticleSphereEmitter::operator()(ParticleBuffer& ps, std::span<ParticleInitOp> inis,
+                                       u32 maxcount, double timepass) {
+    const auto& a = m_args;
+    m_timer += timepass;
+    auto GenSphere = [&]() {
+        auto   p = Particle();
+        double r = algorism::lerp(
+            std::pow(ParticleRandom::get(0.0, 1.0), 1.0 / 3.0), a.minDistance, a.maxDistance);
+        Eigen::Vector3d sp = r * algorism::GenSphereSurfaceNormal(
+                                     [](double u, double o) {
+                                         return ParticleRandom::normal(u, o);
+                                     },
+                                     Eigen::Vector3f { a.directions.data() }.cast<double>());
+        ApplySign(sp, a.sign[0], a.sign[1], a.sign[2]);
+
+        ParticleModify::MoveTo(p, sp);
+        ParticleModify::ChangeVelocity(p,
+                                       ParticleRandom::get(a.minSpeed, a.maxSpeed) *
+                                           sp.normalized());
+
+        ParticleModify::Move(p, Eigen::Vector3f { a.orgin.data() }.cast<double>());
+        return p;
     };
+    u32 emit_num = GetEmitNum(m_timer, a.emitSpeed);
+    emit_num     = a.one_per_frame ? 1 : emit_num;
+    emit_num     = a.instantaneous > 0 && ps.fresh() ? a.instantaneous : emit_num;
+    Emitt(ps, emit_num, maxcount, a.sort, [&]() {
+        return Spwan(GenSphere, inis, 1.0f / a.emitSpeed);
+    });
 }
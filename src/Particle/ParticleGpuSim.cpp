@@ -0,0 +1,108 @@
+#include "ParticleGpuSim.h"
+
+using namespace wallpaper;
+using PB     = ParticleBuffer;
+using Op     = SceneParticleSim::Op;
+using OpType = SceneParticleSim::OpType;
+using Target = SceneParticleSim::FadeTarget;
+
+namespace
+{
+std::array<float, 4> Vec4(const std::array<float, 3>& v) { return { v[0], v[1], v[2], 0.0f }; }
+
+Op FadeOp(Target target, const ParticleKernels::FadeCurve& c, float scale = 1.0f) {
+    return { .type = OpType::FADE,
+             .arg  = (u32)target,
+             .v    = { { { c.start, c.end, c.start_value * scale, c.end_value * scale } } } };
+}
+
+Target ToTarget(ParticleBuffer::Stream s) {
+    switch (s) {
+    case PB::Size: return Target::SIZE;
+    case PB::ColorR: return Target::COLOR_R;
+    case PB::ColorG: return Target::COLOR_G;
+    case PB::ColorB: return Target::COLOR_B;
+    default: return Target::ALPHA;
+    }
+}
+
+struct Translator {
+    std::vector<Op>& ops;
+
+    bool operator()(const MovementOp& o) {
+        ops.push_back({ .type = OpType::MOVEMENT,
+                        .v    = { { { o.drag, o.speed, 0.0f, 0.0f }, Vec4(o.gravity) } } });
+        return true;
+    }
+    bool operator()(const AngularMovementOp& o) {
+        ops.push_back({ .type = OpType::ANGULAR_MOVEMENT,
+                        .v    = { { { o.drag, 0.0f, 0.0f, 0.0f }, Vec4(o.force) } } });
+        return true;
+    }
+    bool operator()(const wallpaper::FadeOp& o) {
+        ops.push_back(FadeOp(ToTarget(o.stream), o.curve, o.scale));
+        return true;
+    }
+    bool operator()(const AlphaFadeOp& o) {
+        ops.push_back(
+            { .type = OpType::ALPHA_FADE, .v = { { { o.fadein, o.fadeout, 0.0f, 0.0f } } } });
+        return true;
+    }
+    bool operator()(const ColorChangeOp& o) {
+        ops.push_back(FadeOp(Target::COLOR_R, o.curves[0]));
+        ops.push_back(FadeOp(Target::COLOR_G, o.curves[1]));
+        ops.push_back(FadeOp(Target::COLOR_B, o.curves[2]));
+        return true;
+    }
+    bool operator()(const OscillateOp&) { return false; }
+    bool operator()(const OscillatePositionOp&) { return false; }
+    bool operator()(const TurbulenceOp& o) {
+        u32 mask = (o.mask[0] != 0 ? 1u : 0u) | (o.mask[1] != 0 ? 2u : 0u) |
+                   (o.mask[2] != 0 ? 4u : 0u);
+        ops.push_back(
+            { .type = OpType::TURBULENCE,
+              .arg  = mask,
+              .v    = { { { o.timescale, o.scale, (float)o.phase, (float)o.speed } } } });
+        return true;
+    }
+    bool operator()(const VortexOp& o) {
+        ops.push_back(
+            { .type = OpType::VORTEX,
+              .arg  = (u32)o.controlpoint,
+              .v    = { { { o.distanceinner, o.distanceouter, o.speedinner, o.speedouter },
+                          Vec4(o.offset),
+                          Vec4(o.axis) } } });
+        return true;
+    }
+    bool operator()(const ControlPointAttractOp& o) {
+        ops.push_back({ .type = OpType::CONTROLPOINT_ATTRACT,
+                        .arg  = (u32)o.controlpoint,
+                        .v    = { { { o.scale, o.threshold, 0.0f, 0.0f }, Vec4(o.origin) } } });
+        return true;
+    }
+};
+} // namespace
+
+bool ParticleGpuSim::TranslateOps(std::span<const ParticleOperatorOp> in, std::vector<Op>& out) {
+    out.clear();
+    Translator tr { out };
+    for (auto& op : in) {
+        if (! std::visit(tr, op)) return false;
+    }
+    return out.size() <= SceneParticleSim::MaxOps;
+}
+
+SceneParticleSim::Spawn ParticleGpuSim::MakeSpawn(const ParticleBuffer& ps, usize i) {
+    auto v = [&ps, i](PB::Stream x, PB::Stream y, PB::Stream z, PB::Stream w) {
+        return std::array { ps.at(x, i), ps.at(y, i), ps.at(z, i), ps.at(w, i) };
+    };
+    return {
+        .state = { v(PB::PosX, PB::PosY, PB::PosZ, PB::Lifetime),
+                   v(PB::VelX, PB::VelY, PB::VelZ, PB::InitLifetime),
+                   v(PB::RotX, PB::RotY, PB::RotZ, PB::InitSize),
+                   v(PB::AngularX, PB::AngularY, PB::AngularZ, PB::InitAlpha),
+                   { ps.at(PB::InitColorR, i), ps.at(PB::InitColorG, i), ps.at(PB::InitColorB, i),
+                     0.0f } },
+        .slot  = (u32)i,
+    };
+}
@@ -0,0 +1,101 @@
+#include "ParticleInitializer.h"
+#include "ParticleModify.h"
+#include "Utils/Algorism.h"
+#include "ParticleRandom.h"
+
+#include <Eigen/Geometry>
+
+using namespace wallpaper;
+using namespace Eigen;
+namespace PM = ParticleModify;
+
+namespace
+{
+inline Vector3d GenRandomVec3(const std::array<float, 3>& min, const std::array<float, 3>& max) {
+    Vector3d result(3);
+    for (int32_t i = 0; i < 3; i++) {
+        result[i] = ParticleRandom::get(min[i], max[i]);
+    }
+    return result;
+}
+} // namespace
+
+void ColorRandomInit::operator()(Particle& p, double) const {
+    double               random = ParticleRandom::get(0.0, 1.0);
+    std::array<float, 3> result;
+    for (int32_t i = 0; i < 3; i++) {
+        result[i] = (float)algorism::lerp(random, min[i], max[i]);
+    }
+    PM::InitColor(p, result[0], result[1], result[2]);
+}
+
+void LifetimeRandomInit::operator()(Particle& p, double) const {
+    PM::InitLifetime(p, ParticleRandom::get(min, max));
+}
+
+void SizeRandomInit::operator()(Particle& p, double) const {
+    PM::InitSize(p, ParticleRandom::get(min, max));
+}
+
+void AlphaRandomInit::operator()(Particle& p, double) const {
+    PM::InitAlpha(p, ParticleRandom::get(min, max));
+}
+
+void VelocityRandomInit::operator()(Particle& p, double) const {
+    auto result = GenRandomVec3(min, max);
+    PM::ChangeVelocity(p, result[0], result[1], result[2]);
+}
+
+void RotationRandomInit::operator()(Particle& p, double) const {
+    auto result = GenRandomVec3(min, max);
+    PM::ChangeRotation(p, result[0], result[1], result[2]);
+}
+
+void AngularVelocityRandomInit::operator()(Particle& p, double) const {
+    auto result = GenRandomVec3(min, max);
+    PM::ChangeAngularVelocity(p, result[0], result[1], result[2]);
+}
+
+void TurbulentVelocityRandomInit::operator()(Particle& p, double duration) {
+    // to do
+    Vector3f vforward(forward.data());
+    Vector3f vright(right.data());
+
+    float speed = ParticleRandom::get(speedmin, speedmax);
+    if (duration > 10.0f) {
+        pos[0] += speed;
+        duration = 0.0f;
+    }
+    Vector3f result;
+    do {
+        result = algorism::CurlNoise(pos.cast<double>()).cast<float>().normalized();
+        pos += result * 0.005f / timescale;
+        duration -= 0.01f;
+    } while (duration > 0.01f);
+    // limit direction
+    {
+        double c      = result.dot(vforward) / (result.norm() * vforward.norm());
+        float  a      = std::acos(c) / M_PI;
+        float  hscale = scale / 2.0f;
+        if (a > hscale) {
+            auto axis = result.cross(vforward).normalized();
+            result    = AngleAxisf((a - a * hscale) * M_PI, axis) * result;
+        }
+    }
+    // offset
+    result = AngleAxisf(offset, vright) * result;
+    result *= speed;
+    PM::ChangeVelocity(p, result[0], result[1], result[2]);
+}
+
+void OverrideInit::operator()(Particle& p, double) const {
+    PM::MutiplyInitLifeTime(p, lifetime);
+    PM::MutiplyInitAlpha(p, alpha);
+    PM::MutiplyInitSize(p, size);
+    PM::MutiplyVelocity(p, speed);
+    if (over_color) {
+        PM::InitColor(p, color[0], color[1], color[2]);
+    } else if (over_colorn) {
+        PM::MutiplyInitColor(p, colorn[0], colorn[1], colorn[2]);
+    }
+}
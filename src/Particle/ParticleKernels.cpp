@@ -0,0 +1,306 @@
+#include "ParticleKernels.h"
+#include "Core/Simd.hpp"
+#include "Utils/Algorism.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+using namespace wallpaper;
+using namespace wallpaper::simd;
+using PB = ParticleBuffer;
+
+namespace
+{
+
+template<typename F>
+inline F LifetimePos(F lifetime, F init) {
+    F pos = F::Set(1.0f) - lifetime / init;
+    return Select(Less(lifetime, F::Set(0.0f)), F::Set(1.0f), pos);
+}
+
+// clamped lerp, start == end steps at start
+template<typename F>
+inline F Fade(F life, float start, float end, float start_value, float end_value) {
+    float inv = end > start ? 1.0f / (end - start) : 1e30f;
+    F     t   = Min(Max((life - F::Set(start)) * F::Set(inv), F::Set(0.0f)), F::Set(1.0f));
+    return F::Set(start_value) + t * F::Set(end_value - start_value);
+}
+
+// particles one curl evaluation works on
+constexpr usize noise_lanes { 8 };
+using Lanes = std::array<float, noise_lanes>;
+
+// gradients of the 16 hashes of algorism::PerlinNoise
+constexpr std::array<std::array<float, 3>, 16> perlin_grads { {
+    { 1, 1, 0 },
+    { -1, 1, 0 },
+    { 1, -1, 0 },
+    { -1, -1, 0 },
+    { 1, 0, 1 },
+    { -1, 0, 1 },
+    { 1, 0, -1 },
+    { -1, 0, -1 },
+    { 0, 1, 1 },
+    { 0, -1, 1 },
+    { 0, 1, -1 },
+    { 0, -1, -1 },
+    { 1, 1, 0 },
+    { 0, -1, 1 },
+    { -1, 1, 0 },
+    { 0, -1, -1 },
+} };
+
+// offsets of the three noise channels, as algorism::PerlinNoiseVec3
+constexpr std::array<std::array<float, 3>, 3> channel_offsets { {
+    { 0.0f, 0.0f, 0.0f },
+    { 89.2f, 33.1f, 57.3f },
+    { 100.3f, 120.1f, 142.2f },
+} };
+
+// analytic gradient of perlin noise, dn/dx, dn/dy, dn/dz of every lane
+// only the hash lookups are per lane, the math between them is lane wise and vectorizes
+void PerlinGrad(const std::array<Lanes, 3>& p, std::array<Lanes, 3>& out) {
+    const u8* perm = algorism::PerlinPermutation();
+
+    std::array<Lanes, 3>                        f, s, ds;
+    std::array<std::array<i32, 3>, noise_lanes> cell;
+    for (usize d = 0; d < 3; d++) {
+        for (usize l = 0; l < noise_lanes; l++) {
+            float c    = std::floor(p[d][l]);
+            float t    = p[d][l] - c;
+            cell[l][d] = (i32)c & 255;
+            f[d][l]    = t;
+            s[d][l]    = t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+            ds[d][l]   = 30.0f * t * t * (t * (t - 2.0f) + 1.0f);
+        }
+    }
+
+    // corner c has bit 0 for x, 1 for y, 2 for z
+    std::array<std::array<Lanes, 3>, 8> g;
+    std::array<Lanes, 8>                n;
+    for (usize l = 0; l < noise_lanes; l++) {
+        auto [X, Y, Z] = cell[l];
+        i32 A = perm[X] + Y, AA = perm[A] + Z, AB = perm[A + 1] + Z;
+        i32 B = perm[X + 1] + Y, BA = perm[B] + Z, BB = perm[B + 1] + Z;
+
+        const std::array<u8, 8> hash { perm[AA],     perm[BA],     perm[AB],     perm[BB],
+                                       perm[AA + 1], perm[BA + 1], perm[AB + 1], perm[BB + 1] };
+        for (usize c = 0; c < 8; c++) {
+            const auto& gr = perlin_grads[hash[c] & 0xF];
+            for (usize d = 0; d < 3; d++) g[c][d][l] = gr[d];
+        }
+    }
+    for (usize c = 0; c < 8; c++) {
+        for (usize l = 0; l < noise_lanes; l++) {
+            float x = f[0][l] - (float)(c & 1), y = f[1][l] - (float)((c >> 1) & 1),
+                  z = f[2][l] - (float)((c >> 2) & 1);
+            n[c][l] = g[c][0][l] * x + g[c][1][l] * y + g[c][2][l] * z;
+        }
+    }
+
+    for (usize l = 0; l < noise_lanes; l++) {
+        float u = s[0][l], v = s[1][l], w = s[2][l];
+        // n = k0 + k1 u + k2 v + k3 w + k4 uv + k5 vw + k6 wu + k7 uvw
+        float k1 = n[1][l] - n[0][l];
+        float k2 = n[2][l] - n[0][l];
+        float k3 = n[4][l] - n[0][l];
+        float k4 = n[0][l] - n[1][l] - n[2][l] + n[3][l];
+        float k5 = n[0][l] - n[2][l] - n[4][l] + n[6][l];
+        float k6 = n[0][l] - n[1][l] - n[4][l] + n[5][l];
+        float k7 = -n[0][l] + n[1][l] + n[2][l] - n[3][l] + n[4][l] - n[5][l] - n[6][l] + n[7][l];
+        for (usize d = 0; d < 3; d++) {
+            float g0 = g[0][d][l];
+            float g1 = g[1][d][l] - g0;
+            float g2 = g[2][d][l] - g0;
+            float g3 = g[4][d][l] - g0;
+            float g4 = g0 - g[1][d][l] - g[2][d][l] + g[3][d][l];
+            float g5 = g0 - g[2][d][l] - g[4][d][l] + g[6][d][l];
+            float g6 = g0 - g[1][d][l] - g[4][d][l] + g[5][d][l];
+            float g7 = -g0 + g[1][d][l] + g[2][d][l] - g[3][d][l] + g[4][d][l] - g[5][d][l] -
+                       g[6][d][l] + g[7][d][l];
+            out[d][l] = g0 + g1 * u + g2 * v + g3 * w + g4 * u * v + g5 * v * w + g6 * w * u +
+                        g7 * u * v * w;
+        }
+        // the fade curves move with the position too
+        out[0][l] += ds[0][l] * (k1 + k4 * v + k6 * w + k7 * v * w);
+        out[1][l] += ds[1][l] * (k2 + k5 * w + k4 * u + k7 * w * u);
+        out[2][l] += ds[2][l] * (k3 + k6 * u + k5 * v + k7 * u * v);
+    }
+}
+
+// curl of the three channel field at every lane, not normalized
+void CurlLanes(const std::array<Lanes, 3>& p, std::array<Lanes, 3>& curl) {
+    // dn[channel][axis]
+    std::array<std::array<Lanes, 3>, 3> dn;
+    for (usize ch = 0; ch < 3; ch++) {
+        std::array<Lanes, 3> q;
+        for (usize d = 0; d < 3; d++) {
+            for (usize l = 0; l < noise_lanes; l++) q[d][l] = p[d][l] + channel_offsets[ch][d];
+        }
+        PerlinGrad(q, dn[ch]);
+    }
+    for (usize l = 0; l < noise_lanes; l++) {
+        curl[0][l] = dn[2][1][l] - dn[1][2][l];
+        curl[1][l] = dn[0][2][l] - dn[2][0][l];
+        curl[2][l] = dn[1][0][l] - dn[0][1][l];
+    }
+}
+
+} // namespace
+
+void ParticleKernels::Reset(ParticleBuffer& buf) {
+    const usize n = buf.size();
+    std::memcpy(buf.stream(PB::Alpha), buf.stream(PB::InitAlpha), n * sizeof(float));
+    std::memcpy(buf.stream(PB::Size), buf.stream(PB::InitSize), n * sizeof(float));
+    std::memcpy(buf.stream(PB::ColorR), buf.stream(PB::InitColorR), n * sizeof(float));
+    std::memcpy(buf.stream(PB::ColorG), buf.stream(PB::InitColorG), n * sizeof(float));
+    std::memcpy(buf.stream(PB::ColorB), buf.stream(PB::InitColorB), n * sizeof(float));
+}
+
+void ParticleKernels::Movement(ParticleBuffer& buf, float drag, float speed,
+                               const std::array<float, 3>& gravity, float t) {
+    for (usize d = 0; d < 3; d++) {
+        float* pos = buf.stream(PB::Stream(PB::PosX + d));
+        float* vel = buf.stream(PB::Stream(PB::VelX + d));
+        // v += (speed * g - 2 * speed * drag * v) * t
+        const float damp = 1.0f - 2.0f * speed * drag * t;
+        const float acc  = speed * gravity[d] * t;
+        ForEach(buf.size(), [&]<typename F>(usize i) {
+            F v = F::Load(vel + i) * F::Set(damp) + F::Set(acc);
+            F p = F::Load(pos + i) + v * F::Set(t);
+            v.Store(vel + i);
+            p.Store(pos + i);
+        });
+    }
+}
+
+void ParticleKernels::AngularMovement(ParticleBuffer& buf, float drag,
+                                      const std::array<float, 3>& force, float t) {
+    for (usize d = 0; d < 3; d++) {
+        float* rot = buf.stream(PB::Stream(PB::RotX + d));
+        float* vel = buf.stream(PB::Stream(PB::AngularX + d));
+        ForEach(buf.size(), [&]<typename F>(usize i) {
+            F r = F::Load(rot + i);
+            F v = F::Load(vel + i) +
+                  (F::Set(force[d]) - F::Set(2.0f * drag) * r) * F::Set(t);
+            r = r + v * F::Set(t);
+            v.Store(vel + i);
+            r.Store(rot + i);
+        });
+    }
+}
+
+void ParticleKernels::MultiplyFade(ParticleBuffer& buf, ParticleBuffer::Stream s,
+                                   const FadeCurve& c, float scale) {
+    float*       dst      = buf.stream(s);
+    const float* lifetime = buf.stream(PB::Lifetime);
+    const float* init     = buf.stream(PB::InitLifetime);
+    ForEach(buf.size(), [&]<typename F>(usize i) {
+        F life  = LifetimePos(F::Load(lifetime + i), F::Load(init + i));
+        F value = Fade(life, c.start, c.end, c.start_value * scale, c.end_value * scale);
+        (F::Load(dst + i) * value).Store(dst + i);
+    });
+}
+
+void ParticleKernels::AlphaFade(ParticleBuffer& buf, float fadein, float fadeout) {
+    float*       alpha    = buf.stream(PB::Alpha);
+    const float* lifetime = buf.stream(PB::Lifetime);
+    const float* init     = buf.stream(PB::InitLifetime);
+    ForEach(buf.size(), [&]<typename F>(usize i) {
+        F life     = LifetimePos(F::Load(lifetime + i), F::Load(init + i));
+        F fade_in  = Fade(life, 0.0f, fadein, 0.0f, 1.0f);
+        F fade_out = Fade(life, fadeout, 1.0f, 1.0f, 0.0f);
+        F value    = Select(LessEq(life, F::Set(fadein)),
+                         fade_in,
+                         Select(Greater(life, F::Set(fadeout)), fade_out, F::Set(1.0f)));
+        (F::Load(alpha + i) * value).Store(alpha + i);
+    });
+}
+
+void ParticleKernels::Turbulence(ParticleBuffer& buf, double offset, float scale, float speed,
+                                 const std::array<int32_t, 3>& mask, float t) {
+    // perlin noise repeats every 256, the offset grows with time and would eat float precision
+    const float ox = (float)std::fmod(offset * scale, 256.0);
+
+    std::array<float*, 3> pos, vel;
+    std::array<float, 3>  on;
+    for (usize d = 0; d < 3; d++) {
+        pos[d] = buf.stream(PB::Stream(PB::PosX + d));
+        vel[d] = buf.stream(PB::Stream(PB::VelX + d));
+        on[d]  = mask[d] != 0 ? 1.0f : 0.0f;
+    }
+
+    const usize          size = buf.size();
+    std::array<Lanes, 3> p {}, curl;
+    for (usize i = 0; i < size; i += noise_lanes) {
+        const usize num = std::min(noise_lanes, size - i);
+        for (usize d = 0; d < 3; d++) {
+            for (usize l = 0; l < num; l++) p[d][l] = pos[d][i + l] * scale;
+        }
+        for (usize l = 0; l < num; l++) p[0][l] += ox;
+        CurlLanes(p, curl);
+
+        for (usize l = 0; l < num; l++) {
+            float len = std::sqrt(curl[0][l] * curl[0][l] + curl[1][l] * curl[1][l] +
+                                  curl[2][l] * curl[2][l]);
+            float k   = len > 0.0f ? speed * t / len : 0.0f;
+            for (usize d = 0; d < 3; d++) vel[d][i + l] += curl[d][l] * k * on[d];
+        }
+    }
+}
+
+bool ParticleKernels::Bounds(const ParticleBuffer& buf, std::array<float, 3>& lo,
+                             std::array<float, 3>& hi) {
+    const float* lifetime = buf.stream(PB::Lifetime);
+    const float* size     = buf.stream(PB::Size);
+    bool         any      = false;
+    for (usize i = 0; i < buf.size(); i++) {
+        if (! (lifetime[i] > 0.0f)) continue;
+        any = true;
+        for (usize d = 0; d < 3; d++) {
+            float p = buf.at(PB::Stream(PB::PosX + d), i);
+            lo[d]   = std::min(lo[d], p - size[i]);
+            hi[d]   = std::max(hi[d], p + size[i]);
+        }
+    }
+    return any;
+}
+
+void ParticleKernels::Depth(const ParticleBuffer& buf, const std::array<float, 4>& plane,
+                            float* out) {
+    const float* x = buf.stream(PB::PosX);
+    const float* y = buf.stream(PB::PosY);
+    const float* z = buf.stream(PB::PosZ);
+    ForEach(buf.size(), [&]<typename F>(usize i) {
+        F d = F::Load(x + i) * F::Set(plane[0]) + F::Load(y + i) * F::Set(plane[1]) +
+              F::Load(z + i) * F::Set(plane[2]) + F::Set(plane[3]);
+        d.Store(out + i);
+    });
+}
+
+void ParticleKernels::SortKeys(std::span<const u16> keys, std::vector<u32>& order,
+                               std::vector<u32>& scratch) {
+    const usize n = keys.size();
+    order.resize(n);
+    scratch.resize(n);
+    for (usize i = 0; i < n; i++) order[i] = (u32)i;
+    if (n < 2) return;
+
+    // both histograms from one read
+    std::array<std::array<u32, 256>, 2> counts {};
+    for (u16 k : keys) {
+        counts[0][k & 0xFFu]++;
+        counts[1][k >> 8u]++;
+    }
+    for (u32 pass = 0; pass < 2; pass++) {
+        auto&     count = counts[pass];
+        const u32 shift = pass * 8;
+        if (count[(keys[0] >> shift) & 0xFFu] == n) continue;
+        u32 sum { 0 };
+        for (auto& c : count) sum += std::exchange(c, sum);
+        for (u32 i : order) scratch[count[(keys[i] >> shift) & 0xFFu]++] = i;
+        order.swap(scratch);
+    }
+}
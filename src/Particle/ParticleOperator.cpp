@@ -0,0 +1,146 @@
+#include "ParticleOperator.h"
+#include "ParticleModify.h"
+#include "ParticleKernels.h"
+#include "Utils/Algorism.h"
+#include "ParticleRandom.h"
+
+#include <Eigen/Dense>
+
+using namespace wallpaper;
+using namespace Eigen;
+namespace PM = ParticleModify;
+
+void MovementOp::operator()(const ParticleInfo& info) const {
+    ParticleKernels::Movement(info.particles, drag, speed, gravity, info.time_pass);
+}
+
+void AngularMovementOp::operator()(const ParticleInfo& info) const {
+    ParticleKernels::AngularMovement(info.particles, drag, force, info.time_pass);
+}
+
+void FadeOp::operator()(const ParticleInfo& info) const {
+    ParticleKernels::MultiplyFade(info.particles, stream, curve, scale);
+}
+
+void AlphaFadeOp::operator()(const ParticleInfo& info) const {
+    ParticleKernels::AlphaFade(info.particles, fadein, fadeout);
+}
+
+void ColorChangeOp::operator()(const ParticleInfo& info) const {
+    for (usize i = 0; i < 3; i++) {
+        auto s = ParticleBuffer::Stream(ParticleBuffer::ColorR + i);
+        ParticleKernels::MultiplyFade(info.particles, s, curves[i]);
+    }
+}
+
+void FrequencyValue::CheckAndResize(size_t s) {
+    if (storage.size() < s) storage.resize(2 * s, StorageRandom {});
+}
+
+void FrequencyValue::Compact(std::span<const isize> remap) {
+    usize live = 0;
+    for (usize i = 0; i < remap.size() && i < storage.size(); i++) {
+        if (remap[i] < 0) continue;
+        storage[(usize)remap[i]] = storage[i];
+        live++;
+    }
+    for (usize i = live; i < remap.size() && i < storage.size(); i++) storage[i].reset = true;
+}
+
+void FrequencyValue::GenFrequency(const ParticleBuffer& ps, uint32_t index) {
+    auto& st = storage.at(index);
+    if (! PM::LifetimeOk(ps, index)) st.reset = true;
+    if (st.reset) {
+        st.frequency = ParticleRandom::get(frequencymin, frequencymax);
+        st.scale     = ParticleRandom::get(scalemin, scalemax);
+        st.phase     = (float)ParticleRandom::get((double)phasemin, phasemax + 2.0 * M_PI);
+        st.reset     = false;
+    }
+}
+
+double FrequencyValue::GetScale(uint32_t index, double time) const {
+    const auto& st = storage.at(index);
+    double      f  = st.frequency / (2.0f * M_PI);
+    double      w  = 2.0f * M_PI * f;
+    return algorism::lerp((std::cos(w * time + st.phase) + 1.0f) * 0.5f, scalemin, scalemax);
+}
+
+double FrequencyValue::GetMove(uint32_t index, double time, double timePass) const {
+    const auto& st = storage.at(index);
+    double      f  = st.frequency / (2.0f * M_PI);
+    double      w  = 2.0f * M_PI * f;
+    return -1.0f * st.scale * w * std::sin(w * time + st.phase) * timePass;
+}
+
+void OscillateOp::operator()(const ParticleInfo& info) {
+    auto& ps = info.particles;
+    fv.CheckAndResize(ps.size());
+    float* dst = ps.stream(stream);
+    for (uint i = 0; i < ps.size(); i++) {
+        fv.GenFrequency(ps, i);
+        dst[i] *= fv.GetScale(i, PM::LifetimePassed(ps, i));
+    }
+}
+
+void OscillatePositionOp::operator()(const ParticleInfo& info) {
+    auto& ps = info.particles;
+    for (auto& f : fxp) f.CheckAndResize(ps.size());
+    for (uint i = 0; i < ps.size(); i++) {
+        Vector3d del { Vector3d::Zero() };
+        auto     time = PM::LifetimePassed(ps, i);
+        for (uint d = 0; d < 3; d++) {
+            if (fxp[0].mask[d] < 0.01) continue;
+            fxp[d].GenFrequency(ps, i);
+            del[d] = fxp[d].GetMove(i, time, info.time_pass);
+        }
+
+        PM::Move(ps, i, del);
+    }
+}
+
+void TurbulenceOp::operator()(const ParticleInfo& info) const {
+    ParticleKernels::Turbulence(info.particles,
+                                phase + timescale * info.time,
+                                scale * 2.0f,
+                                (float)speed,
+                                mask,
+                                (float)info.time_pass);
+}
+
+void VortexOp::operator()(const ParticleInfo& info) const {
+    Vector3d voffset =
+        info.controlpoints[controlpoint].offset + (Vector3f { offset.data() }).cast<double>();
+    Vector3d vaxis   = (Vector3f { axis.data() }).cast<double>();
+    double   dis_mid = distanceouter - distanceinner + 0.1f;
+
+    auto& ps = info.particles;
+    for (usize n = 0; n < ps.size(); n++) {
+        Vector3d pos      = PM::GetPos(ps, n).cast<double>();
+        Vector3d direct   = -vaxis.cross(pos).normalized();
+        double   distance = (pos - voffset).norm();
+        if (dis_mid < 0 || distance < distanceinner) {
+            PM::Accelerate(ps, n, direct * speedinner, info.time_pass);
+        }
+        if (distance > distanceouter) {
+            PM::Accelerate(ps, n, direct * speedouter, info.time_pass);
+        } else if (distance > distanceinner) {
+            double t = (distance - distanceinner) / dis_mid;
+            PM::Accelerate(
+                ps, n, direct * algorism::lerp(t, speedinner, speedouter), info.time_pass);
+        }
+    }
+}
+
+void ControlPointAttractOp::operator()(const ParticleInfo& info) const {
+    Vector3d voffset =
+        info.controlpoints[controlpoint].offset + Vector3f { origin.data() }.cast<double>();
+
+    auto& ps = info.particles;
+    for (usize n = 0; n < ps.size(); n++) {
+        Vector3d diff     = voffset - PM::GetPos(ps, n).cast<double>();
+        double   distance = diff.norm();
+        if (distance < threshold) {
+            PM::Accelerate(ps, n, diff.normalized() * scale, info.time_pass);
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#include "ParticleRandom.h"
+
+#include <cmath>
+#include <random>
+
+using namespace wallpaper;
+
+namespace
+{
+thread_local ParticleRandom* t_bound { nullptr };
+
+u64 SplitMix64(u64& x) {
+    u64 z = (x += 0x9e3779b97f4a7c15ull);
+    z     = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z     = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+inline u32 Rotl(u32 x, int k) { return (x << k) | (x >> (32 - k)); }
+} // namespace
+
+ParticleRandom::ParticleRandom(u64 seed) { Seed(seed); }
+
+void ParticleRandom::Seed(u64 seed) {
+    u64 x = seed;
+    for (usize l = 0; l < Lanes; l++) {
+        // splitmix spreads a small seed over the whole state
+        for (usize s = 0; s < 4; s += 2) {
+            u64 v             = SplitMix64(x);
+            m_state[s][l]     = (u32)v;
+            m_state[s + 1][l] = (u32)(v >> 32);
+        }
+    }
+    m_next = BlockSize;
+}
+
+void ParticleRandom::Generate(float* out, usize rounds) {
+    auto& [s0, s1, s2, s3] = m_state;
+    for (usize r = 0; r < rounds; r++) {
+        float* dst = out + r * Lanes;
+        for (usize l = 0; l < Lanes; l++) {
+            u32 result = s0[l] + s3[l];
+            u32 t      = s1[l] << 9;
+            s2[l] ^= s0[l];
+            s3[l] ^= s1[l];
+            s1[l] ^= s2[l];
+            s0[l] ^= s3[l];
+            s2[l] ^= t;
+            s3[l] = Rotl(s3[l], 11);
+            // the high 24 bits, the low ones of xoshiro+ are weak
+            dst[l] = (float)(result >> 8) * 0x1.0p-24f;
+        }
+    }
+}
+
+void ParticleRandom::Refill() {
+    Generate(m_block.data(), BlockSize / Lanes);
+    m_next = 0;
+}
+
+float ParticleRandom::Next() {
+    if (m_next == BlockSize) Refill();
+    return m_block[m_next++];
+}
+
+double ParticleRandom::Normal(double mean, double stddev) {
+    // box muller, 1 - u keeps the log finite
+    double u = 1.0 - Next();
+    double v = Next();
+    return mean + stddev * std::sqrt(-2.0 * std::log(u)) * std::cos(2.0 * M_PI * v);
+}
+
+void ParticleRandom::Fill(std::span<float> out, float min, float max) {
+    usize i = 0;
+    for (; i < out.size() && m_next < BlockSize; i++) out[i] = m_block[m_next++];
+    // whole rounds straight into the span
+    usize rounds = (out.size() - i) / Lanes;
+    Generate(out.data() + i, rounds);
+    i += rounds * Lanes;
+    for (; i < out.size(); i++) out[i] = Next();
+
+    const float range = max - min;
+    for (auto& x : out) x = min + range * x;
+}
+
+ParticleRandom& ParticleRandom::Current() {
+    if (t_bound != nullptr) return *t_bound;
+    thread_local ParticleRandom fallback { std::random_device {}() };
+    return fallback;
+}
+
+ParticleRandom::Bind::Bind(ParticleRandom& r): m_prev(t_bound) { t_bound = &r; }
+ParticleRandom::Bind::~Bind() { t_bound = m_prev; }
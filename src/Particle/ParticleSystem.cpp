@@ -2,20 +2,36 @@
 #include "Core/Literals.hpp"
 #include "Scene/Scene.h"
 #include "ParticleModify.h"
+#include "ParticleKernels.h"
+#include "ParticleGpuSim.h"
 #include "Scene/SceneMesh.h"
-#include "Core/Random.hpp"
+#include "SpecTexs.hpp"
 
 #include "Utils/Logging.h"
+#include "Utils/Trace.h"
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
 
 using namespace wallpaper;
 
+namespace
+{
+// seconds between the steps of culled subsystems
+constexpr double cull_interval { 0.2 };
+
+// seconds between lod changes, the frame time is averaged and needs a while to follow
+constexpr double budget_interval { 0.5 };
+} // namespace
+
 void ParticleInstance::Refresh() {
     SetDeath(false);
     SetNoLiveParticle(false);
+    SetFree(false);
     GetBoundedData() = {};
-    ParticlesVec().clear();
+    Particles().clear();
 }
 
 bool ParticleInstance::IsDeath() const { return m_is_death; }
@@ -24,8 +40,11 @@ void ParticleInstance::SetDeath(bool v) { m_is_death = v; };
 bool ParticleInstance::IsNoLiveParticle() const { return m_no_live_particle; };
 void ParticleInstance::SetNoLiveParticle(bool v) { m_no_live_particle = v; };
 
-std::span<const Particle> ParticleInstance::Particles() const { return m_particles; };
-std::vector<Particle>&    ParticleInstance::ParticlesVec() { return m_particles; };
+bool ParticleInstance::IsFree() const { return m_free; }
+void ParticleInstance::SetFree(bool v) { m_free = v; }
+
+const ParticleBuffer& ParticleInstance::Particles() const { return m_particles; };
+ParticleBuffer&       ParticleInstance::Particles() { return m_particles; };
 
 ParticleInstance::BoundedData& ParticleInstance::GetBoundedData() { return m_bounded_data; }
 
@@ -41,15 +60,22 @@ ParticleSubSystem::ParticleSubSystem(ParticleSystem& p, std::shared_ptr<SceneMes
       m_time(0),
       m_maxcount_instance(maxcount_instance),
       m_probability(probability),
-      m_spawn_type(type) {};
+      m_spawn_type(type),
+      m_random(p.NextSeed()) {};
 
 ParticleSubSystem::~ParticleSubSystem() = default;
 
-void ParticleSubSystem::AddEmitter(ParticleEmittOp&& em) { m_emiters.emplace_back(em); }
+void ParticleSubSystem::AddEmitter(ParticleEmittOp&& em) {
+    m_emiters.emplace_back(std::move(em));
+}
 
-void ParticleSubSystem::AddInitializer(ParticleInitOp&& ini) { m_initializers.emplace_back(ini); }
+void ParticleSubSystem::AddInitializer(ParticleInitOp&& ini) {
+    m_initializers.emplace_back(std::move(ini));
+}
 
-void ParticleSubSystem::AddOperator(ParticleOperatorOp&& op) { m_operators.emplace_back(op); }
+void ParticleSubSystem::AddOperator(ParticleOperatorOp&& op) {
+    m_operators.emplace_back(std::move(op));
+}
 
 std::span<const ParticleControlpoint> ParticleSubSystem::Controlpoints() const {
     return m_controlpoints;
@@ -64,25 +90,265 @@ void ParticleSubSystem::AddChild(std::unique_ptr<ParticleSubSystem>&& child) {
     m_children.emplace_back(std::move(child));
 }
 
+std::span<const std::unique_ptr<ParticleSubSystem>> ParticleSubSystem::Children() const {
+    return m_children;
+}
+
 ParticleInstance* ParticleSubSystem::QueryNewInstance() {
-    if (Random::get(0.0, 1.0) <= m_probability) {
-        for (auto& inst : m_instances) {
-            if (inst->IsDeath() && inst->IsNoLiveParticle()) {
-                inst->Refresh();
-                return inst.get();
-            }
+    if (m_random.Uniform(0.0, 1.0) <= m_probability) {
+        if (! m_free_instances.empty()) {
+            ParticleInstance* inst = m_free_instances.back();
+            m_free_instances.pop_back();
+            inst->Refresh();
+            m_dormant = false;
+            return inst;
         }
         if (m_instances.size() < m_maxcount_instance) {
             m_instances.emplace_back(std::make_unique<ParticleInstance>());
+            m_dormant = false;
             return m_instances.back().get();
         }
     }
     return nullptr;
 }
 
+bool ParticleSubSystem::EnableGpuSim(ParticleAnimationMode mode, float sequencemultiplier) {
+    // one instance whose slots stay put, spawned instances follow a parent on cpu
+    if (m_spawn_type != SpawnType::STATIC || m_depth_sort.plane) return false;
+    for (auto& em : m_emiters) {
+        bool sorts = std::visit(
+            [](auto& e) {
+                return e.Sorts();
+            },
+            em);
+        if (sorts) return false;
+    }
+    const auto& sv = m_mesh->GetVertexArray(0);
+    if (sv.GetOption(WE_PRENDER_ROPE)) return false;
+    // indices are u16, instanced meshes need none
+    if (! sv.PerInstance() && (usize)m_maxcount * 4 > std::numeric_limits<u16>::max())
+        return false;
+
+    auto sim = std::make_shared<SceneParticleSim>();
+    if (! ParticleGpuSim::TranslateOps(m_operators, sim->ops)) return false;
+    sim->capacity        = m_maxcount;
+    sim->thick_format    = sv.GetOption(WE_CB_THICK_FORMAT);
+    sim->anim_mode       = (u32)mode;
+    sim->anim_multiplier = sequencemultiplier;
+
+    m_gpu_sim = sim;
+    m_mesh->SetParticleSim(std::move(sim));
+    return true;
+}
+
+void ParticleSubSystem::Compacted(const ParticleInstance& inst, std::span<const isize> remap) {
+    // children run after this subsystem, they already saw the dropped particles die
+    for (auto& child : m_children) {
+        for (auto& child_inst : child->m_instances) {
+            auto& bounded = child_inst->GetBoundedData();
+            if (bounded.parent != &inst || bounded.particle_idx < 0) continue;
+            if ((usize)bounded.particle_idx < remap.size())
+                bounded.particle_idx = remap[(usize)bounded.particle_idx];
+        }
+    }
+    // per particle state of operators
+    for (auto& op : m_operators) {
+        std::visit(
+            [remap](auto& o) {
+                if constexpr (requires { o.Compact(remap); }) o.Compact(remap);
+            },
+            op);
+    }
+}
+
 void ParticleSubSystem::Emitt() {
-    double frameTime    = m_sys.scene.frameTime;
-    double particleTime = frameTime * m_rate;
+    EmittSelf();
+    for (auto& child : m_children) {
+        child->Emitt();
+    }
+}
+
+bool ParticleSubSystem::Animating() const {
+    if (m_live && ! m_culled) return true;
+    return std::any_of(m_children.begin(), m_children.end(), [](const auto& child) {
+        return child->Animating();
+    });
+}
+
+void ParticleSubSystem::SetLodFloor(float v) { m_lod_floor = std::clamp(v, 0.0f, 1.0f); }
+
+void ParticleSubSystem::SetVisibleTest(VisibleTest test) { m_visible_test = std::move(test); }
+
+void ParticleSubSystem::SetDepthSort(DepthPlane plane) { m_depth_sort.plane = std::move(plane); }
+
+std::span<const ParticleRef> ParticleSubSystem::DepthOrder() {
+    auto&                ds = m_depth_sort;
+    std::array<float, 4> plane;
+    if (! ds.plane || ! ds.plane(plane)) return {};
+
+    ds.depth.clear();
+    ds.refs.clear();
+    for (u32 k = 0; k < m_instances.size(); k++) {
+        auto& inst = *m_instances[k];
+        if (inst.IsNoLiveParticle()) continue;
+        const auto& ps  = inst.Particles();
+        const auto& off = inst.GetBoundedData().pos;
+        // the instance's offset is added when drawn
+        std::array<float, 4> p = plane;
+        p[3] += plane[0] * off[0] + plane[1] * off[1] + plane[2] * off[2];
+
+        const usize base = ds.depth.size();
+        ds.depth.resize(base + ps.size());
+        ParticleKernels::Depth(ps, p, ds.depth.data() + base);
+        usize live = base;
+        for (u32 n = 0; n < ps.size(); n++) {
+            if (! ParticleModify::LifetimeOk(ps, n)) continue;
+            ds.depth[live++] = ds.depth[base + n];
+            ds.refs.push_back({ .instance = k, .index = n });
+        }
+        ds.depth.resize(live);
+    }
+    if (ds.refs.size() < 2) return ds.refs;
+
+    auto [lo, hi] = std::minmax_element(ds.depth.begin(), ds.depth.end());
+    // all at one depth, as in a flat scene, spawn order is as good as any
+    if (! (*hi - *lo > 0.0f)) return ds.refs;
+    // farthest first, 65536 steps over the depth range
+    const float far   = *hi;
+    const float scale = 65535.0f / (*hi - *lo);
+    ds.keys.resize(ds.depth.size());
+    for (usize i = 0; i < ds.depth.size(); i++)
+        ds.keys[i] = (u16)std::min((far - ds.depth[i]) * scale, 65535.0f);
+    ParticleKernels::SortKeys(ds.keys, ds.order, ds.scratch);
+
+    ds.sorted.resize(ds.refs.size());
+    for (usize i = 0; i < ds.order.size(); i++) ds.sorted[i] = ds.refs[ds.order[i]];
+    return ds.sorted;
+}
+
+bool ParticleSubSystem::OffScreen() const {
+    // children follow particles of this one, the gpu keeps the positions
+    if (! m_visible_test || ! m_children.empty() || m_gpu_sim) return false;
+
+    std::array<float, 3> lo, hi;
+    lo.fill(std::numeric_limits<float>::max());
+    hi.fill(std::numeric_limits<float>::lowest());
+    bool any = false;
+    for (auto& inst : m_instances) {
+        if (inst->IsFree()) continue;
+        any = ParticleKernels::Bounds(inst->Particles(), lo, hi) || any;
+    }
+    // without particles the emitters decide, they may be in view
+    return any && ! m_visible_test(lo, hi);
+}
+
+bool ParticleSubSystem::CanSpawn() const {
+    // the static instance is made by the first step
+    if (m_spawn_type == SpawnType::STATIC && m_instances.empty()) return true;
+    for (auto& inst : m_instances) {
+        if (inst->IsFree()) continue;
+        // stepping follows the parent's particle and frees the instance once it's gone
+        if (inst->GetBoundedData().parent != nullptr) return true;
+        if (inst->IsDeath()) continue;
+        auto& ps = inst->Particles();
+        for (auto& em : m_emiters) {
+            bool exhausted = std::visit(
+                [&ps](auto& e) {
+                    return e.Exhausted(ps);
+                },
+                em);
+            if (! exhausted) return true;
+        }
+    }
+    return false;
+}
+
+void ParticleSubSystem::Reseed() {
+    m_random.Seed(m_sys.NextSeed());
+    for (auto& child : m_children) child->Reseed();
+}
+
+void ParticleSubSystem::JoinBatch(ParticleSubSystem& head) {
+    m_batch_prev      = head.m_batch_last != nullptr ? head.m_batch_last : &head;
+    head.m_batch_head = &head;
+    head.m_batch_last = this;
+    m_batch_head      = &head;
+    m_mesh            = head.m_mesh;
+}
+
+ParticleSubSystem* ParticleSubSystem::BatchPrev() const { return m_batch_prev; }
+
+void ParticleSubSystem::EmittSelf() {
+    // initializers, emitters and operators draw from this subsystem's generator
+    ParticleRandom::Bind bind(m_random);
+
+    // the members write the batch anew each frame, one after the other, members that don't
+    // write have nothing live
+    if (m_batch_head == this && std::exchange(m_batch_fill, 0) > 0) {
+        m_mesh->SetDirty();
+        m_sys.gener->GenGLData({}, *m_mesh, m_genSpecOp, 1.0f);
+    }
+
+    const double frame_time = m_sys.scene.frameTime;
+    const auto&  fixed      = m_sys.GetFixedStep();
+    const bool   use_fixed  = fixed.step > 0.0;
+
+    // the mesh was emptied when the last particle died, only the clock moves
+    if (m_dormant) {
+        m_time += frame_time * m_rate;
+        return;
+    }
+
+    u32    steps     = 1;
+    double step_time = frame_time;
+    float  blend     = 1.0f;
+    if (m_culled) {
+        // nothing shows, a coarse step now and then brings particles that move into view back
+        m_cull_accum += frame_time;
+        if (m_cull_accum < cull_interval) return;
+        m_live       = StepSelf(m_cull_accum, true, false);
+        m_cull_accum = 0.0;
+        m_culled     = OffScreen();
+        if (m_culled) return;
+        // the mesh still holds the last particles built
+        m_had_live = true;
+        steps      = 0;
+    } else if (use_fixed) {
+        m_step_accum += frame_time;
+        steps = (u32)std::min<double>(std::floor(m_step_accum / fixed.step), fixed.max_substeps);
+        m_step_accum -= steps * fixed.step;
+        // after a stall the backlog is dropped, catching it up would stall the next frame too
+        if (m_step_accum >= fixed.step) m_step_accum = std::fmod(m_step_accum, fixed.step);
+        step_time = fixed.step;
+        blend     = (float)(m_step_accum / fixed.step);
+        // children see spawns and deaths once their parent is done, a later step could reuse
+        // the slots before that, so due steps run as one
+        if (! m_children.empty() && steps > 1) {
+            step_time *= steps;
+            steps = 1;
+        }
+    }
+    for (u32 i = 0; i < steps; i++) m_live = StepSelf(step_time, i == 0, use_fixed);
+    if (steps > 0) m_culled = OffScreen();
+
+    // the gpu writes the mesh
+    if (m_gpu_synced) return;
+
+    // once the last particle is gone the mesh stays empty, don't mark it dirty every frame
+    // between fixed steps only the blend moves
+    if (m_live || m_had_live) {
+        m_mesh->SetDirty();
+        const u32 first = m_batch_head != nullptr ? m_batch_head->m_batch_fill : 0;
+        const u32 end =
+            m_sys.gener->GenGLData(m_instances, *m_mesh, m_genSpecOp, blend, DepthOrder(), first);
+        if (m_batch_head != nullptr) m_batch_head->m_batch_fill = end;
+    }
+    m_had_live = m_live;
+    if (! m_live && ! m_culled) m_dormant = ! CanSpawn();
+}
+
+bool ParticleSubSystem::StepSelf(double step_time, bool first, bool save_positions) {
+    double particleTime = step_time * m_rate;
     m_time += particleTime;
 
     if (m_spawn_type == SpawnType::STATIC) {
@@ -99,8 +365,21 @@ void ParticleSubSystem::Emitt() {
         }
     };
 
+    // children read particle positions, only the cpu has them
+    bool gpu     = m_gpu_sim && m_gpu_sim->active.load() && m_children.empty();
+    bool resync  = gpu && ! m_gpu_synced;
+    m_gpu_synced = gpu;
+    if (gpu && ! m_gpu_sim->pending) m_gpu_sim->spawns.clear();
+
+    // the lod scales the emitters' clock and the slots they may fill
+    const float  lod       = std::max(m_sys.Lod(), m_lod_floor);
+    const double emit_time = particleTime * lod;
+    const u32    maxcount  = std::max<u32>((u32)std::ceil((float)m_maxcount * lod), 1);
+
+    bool any_live = false;
     for (auto& inst : m_instances) {
         assert(inst);
+        if (inst->IsFree()) continue;
 
         auto& bounded_data = inst->GetBoundedData();
 
@@ -109,16 +388,16 @@ void ParticleSubSystem::Emitt() {
 
         // bouded data and death
         if (bounded_data.parent != nullptr) {
-            std::span particles = bounded_data.parent->Particles();
+            const auto& particles = bounded_data.parent->Particles();
             if (bounded_data.particle_idx != -1 && bounded_data.particle_idx < particles.size()) {
-                auto& p          = particles[bounded_data.particle_idx];
-                bounded_data.pos = ParticleModify::GetPos(p);
+                usize p          = bounded_data.particle_idx;
+                bounded_data.pos = ParticleModify::GetPos(particles, p);
                 // only update pos once when event_death
                 if (m_spawn_type == SpawnType::EVENT_DEATH) bounded_data.particle_idx = -1;
 
                 // death if bounded particle death
                 if (! inst->IsDeath() && type_has_death) {
-                    bool cur_life_ok = ParticleModify::LifetimeOk(p);
+                    bool cur_life_ok = ParticleModify::LifetimeOk(particles, p);
                     inst->SetDeath(! cur_life_ok && bounded_data.pre_lifetime_ok);
                     bounded_data.pre_lifetime_ok = cur_life_ok;
                 }
@@ -132,12 +411,21 @@ void ParticleSubSystem::Emitt() {
 
         // clear when death if follow
         if (inst->IsDeath() && m_spawn_type == SpawnType::EVENT_FOLLOW) {
-            inst->ParticlesVec().clear();
+            inst->Particles().clear();
         }
 
+        // last frame's dead leave, loops below only see live and new particles
+        // the gpu keeps particles in fixed slots
+        if (first && ! gpu && inst->Particles().compact(m_remap)) Compacted(*inst, m_remap);
+        if (save_positions && ! gpu) inst->Particles().savePositions();
+
         if (! inst->IsDeath()) {
             for (auto& emittOp : m_emiters) {
-                emittOp(inst->ParticlesVec(), m_initializers, m_maxcount, particleTime);
+                std::visit(
+                    [&](auto& em) {
+                        em(inst->Particles(), m_initializers, maxcount, emit_time);
+                    },
+                    emittOp);
             }
         }
 
@@ -145,37 +433,40 @@ void ParticleSubSystem::Emitt() {
         if (m_spawn_type == SpawnType::EVENT_DEATH) inst->SetDeath(true);
 
         ParticleInfo info {
-            .particles     = inst->ParticlesVec(),
+            .particles     = inst->Particles(),
             .controlpoints = m_controlpoints,
             .time          = m_time,
             .time_pass     = particleTime,
         };
 
+        auto& ps       = info.particles;
         bool  has_live = false;
-        isize i        = -1;
-        for (auto& p : info.particles) {
-            i++;
+        for (usize i = 0; i < ps.size(); i++) {
+            // before this frame's step, the gpu applies it
+            if (gpu && ParticleModify::LifetimeOk(ps, i) &&
+                (resync || ParticleModify::IsNew(ps, i)))
+                m_gpu_sim->spawns.push_back(ParticleGpuSim::MakeSpawn(ps, i));
 
-            if (ParticleModify::IsNew(p)) {
+            if (ParticleModify::IsNew(ps, i)) {
                 // new spawn
                 for (auto& child : m_children) {
                     if (child->Type() == SpawnType::EVENT_FOLLOW ||
                         child->Type() == SpawnType::EVENT_SPAWN)
-                        spawn_inst(*inst, *child, i);
+                        spawn_inst(*inst, *child, (isize)i);
                 }
             }
 
-            ParticleModify::MarkOld(p);
-            if (! ParticleModify::LifetimeOk(p)) {
+            ParticleModify::MarkOld(ps, i);
+            if (! ParticleModify::LifetimeOk(ps, i)) {
                 continue;
             }
-            ParticleModify::Reset(p);
-            ParticleModify::ChangeLifetime(p, -particleTime);
+            ParticleModify::ChangeLifetime(ps, i, -particleTime);
 
-            if (! ParticleModify::LifetimeOk(p)) {
+            if (! ParticleModify::LifetimeOk(ps, i)) {
                 // new dead
                 for (auto& child : m_children) {
-                    if (child->Type() == SpawnType::EVENT_DEATH) spawn_inst(*inst, *child, i);
+                    if (child->Type() == SpawnType::EVENT_DEATH)
+                        spawn_inst(*inst, *child, (isize)i);
                 }
             } else {
                 has_live = true;
@@ -183,25 +474,85 @@ void ParticleSubSystem::Emitt() {
         }
 
         inst->SetNoLiveParticle(! has_live);
+        any_live = any_live || has_live;
+        if (inst->IsDeath() && ! has_live) {
+            inst->SetFree(true);
+            m_free_instances.push_back(inst.get());
+        }
+        if (gpu) continue;
+
+        // dead particles are reset too, they are not drawn and get overwritten on spawn
+        ParticleKernels::Reset(ps);
+
+        // one dispatch per operator, the loops over the particles live inside
+        for (auto& op : m_operators) {
+            std::visit(
+                [&info](auto& o) {
+                    o(info);
+                },
+                op);
+        }
+    }
 
-        std::for_each(m_operators.begin(), m_operators.end(), [&info](ParticleOperatorOp& op) {
-            op(info);
-        });
+    if (gpu) {
+        if (any_live || m_had_live) {
+            auto& sim = *m_gpu_sim;
+            // steps the render missed add up
+            sim.time      = (float)m_time;
+            sim.time_pass = (float)particleTime + (sim.pending ? sim.time_pass : 0.0f);
+            for (usize i = 0; i < sim.controlpoints.size(); i++) {
+                auto& o              = m_controlpoints[i].offset;
+                sim.controlpoints[i] = { (float)o.x(), (float)o.y(), (float)o.z(), 0.0f };
+            }
+            sim.pending = true;
+        }
+        m_had_live = any_live;
     }
+    return any_live;
+}
 
-    m_mesh->SetDirty();
+void ParticleSystem::Emitt() {
+    TRACE_ZONE("ParticleSystem::Emitt");
+    m_workers.emitt(subsystems);
+}
 
-    m_sys.gener->GenGLData(m_instances, *m_mesh, m_genSpecOp);
+bool ParticleSystem::Animating() const {
+    return std::any_of(subsystems.begin(), subsystems.end(), [](const auto& sub) {
+        return sub->Animating();
+    });
+}
 
-    for (auto& child : m_children) {
-        child->Emitt();
+void ParticleSystem::UpdateBudget(double frame_time, double budget) {
+    if (budget <= 0.0) return;
+    m_budget_timer += scene.frameTime;
+    if (m_budget_timer < budget_interval) return;
+    m_budget_timer = 0.0;
+
+    const double load = frame_time / budget;
+    float        lod  = m_lod;
+    // the gap between both keeps the lod from flipping every interval
+    if (load > 0.9) {
+        lod = std::max(lod * 0.8f, 0.05f);
+    } else if (load < 0.6) {
+        lod = std::min(lod + 0.1f, m_lod_cap);
     }
+    if (lod != m_lod) LOG_INFO("particle lod %.2f, frame load %.2f", lod, load);
+    m_lod = lod;
 }
 
-void ParticleSystem::Emitt() {
-    for (auto& el : subsystems) {
-        el->Emitt();
-    }
+void ParticleSystem::SetSeed(u64 seed) {
+    m_seed       = seed;
+    m_seed_index = 0;
+    for (auto& subsys : subsystems) subsys->Reseed();
+}
+
+u64 ParticleSystem::NextSeed() { return m_seed ^ (m_seed_index++ * 0x9e3779b97f4a7c15ull); }
+
+void ParticleSystem::SetSimRate(u32 hz, u32 max_substeps) {
+    m_fixed_step = {
+        .step         = hz > 0 ? 1.0 / hz : 0.0,
+        .max_substeps = std::max<u32>(max_substeps, 1),
+    };
 }
 
 void ParticleSubSystem::UpdateMouseControlPoints(double sceneX, double sceneY) {
@@ -0,0 +1,65 @@
+#include "ParticleWorkers.h"
+#include "ParticleSystem.h"
+#include "Looper/JobSystem.hpp"
+
+#include <optional>
+#include <unordered_map>
+
+using namespace wallpaper;
+
+namespace
+{
+void Flatten(std::span<const std::unique_ptr<ParticleSubSystem>> subs,
+             std::vector<ParticleSubSystem*>&                    out) {
+    for (auto& sub : subs) {
+        out.push_back(sub.get());
+        Flatten(sub->Children(), out);
+    }
+}
+
+using Tasks = std::unordered_map<const ParticleSubSystem*, looper::TaskGraph::Task>;
+
+void AddTasks(looper::TaskGraph& graph, std::span<const std::unique_ptr<ParticleSubSystem>> subs,
+              std::optional<looper::TaskGraph::Task> parent, Tasks& tasks) {
+    for (auto& sub : subs) {
+        auto* s     = sub.get();
+        auto  emitt = [s]() {
+            s->EmittSelf();
+        };
+        looper::TaskGraph::Task task;
+        // members of a batch write one mesh in turn, the one before may be a sibling's child
+        auto* prev = s->BatchPrev();
+        if (! parent)
+            task = graph.add(emitt);
+        else if (prev != nullptr && tasks.at(prev) != *parent)
+            task = graph.add(emitt, { *parent, tasks.at(prev) });
+        else
+            task = graph.add(emitt, { *parent });
+        tasks[s] = task;
+        AddTasks(graph, sub->Children(), task, tasks);
+    }
+}
+} // namespace
+
+ParticleWorkers::ParticleWorkers(): m_graph(std::make_unique<looper::TaskGraph>()) {}
+ParticleWorkers::~ParticleWorkers() = default;
+
+void ParticleWorkers::build(std::span<const std::unique_ptr<ParticleSubSystem>> subs) {
+    std::vector<ParticleSubSystem*> tree;
+    Flatten(subs, tree);
+    if (tree == m_built) return;
+    m_built = std::move(tree);
+    m_graph->clear();
+    Tasks tasks;
+    AddTasks(*m_graph, subs, std::nullopt, tasks);
+}
+
+void ParticleWorkers::emitt(std::span<const std::unique_ptr<ParticleSubSystem>> subs) {
+    build(subs);
+    // a single subsystem has nothing to run beside
+    if (m_built.size() < 2) {
+        for (auto& sub : subs) sub->Emitt();
+        return;
+    }
+    m_graph->run(looper::JobSystem::Shared(), looper::JobPriority::Frame);
+}
@@ -1,8 +1,10 @@
 #include "WPParticleRawGener.h"
 
+#include <cmath>
 #include <cstring>
 #include <Eigen/Dense>
 #include <array>
+#include <utility>
 
 #include "Core/Literals.hpp"
 #include "SpecTexs.hpp"
@@ -13,203 +15,389 @@
 
 using namespace wallpaper;
 using namespace Eigen;
-
-struct WPGOption {
-    bool thick_format { false };
-    bool geometry_shader { false };
-};
+using PB = ParticleBuffer;
 
 namespace
 {
-inline void AssignVertexTimes(std::span<float> dst, std::span<const float> src, uint num) noexcept {
-    const uint dst_one_size = dst.size() / num;
-    for (uint i = 0; i < num; i++) {
-        std::copy(src.begin(), src.end(), dst.begin() + i * dst_one_size);
+using Attr = SceneVertexArray::AttrHandle;
+
+// how the vertices of a mesh are written, picked by its attributes on the first fill and kept
+// on the vertex array
+enum class GenLayout : u32
+{
+    Unknown = 0,
+    // attributes looked up by name, for layouts none of the below match
+    Generic,
+    Quad,
+    QuadThick,
+    Instanced,
+    InstancedThick,
+    GenericRope,
+    Rope,
+    RopeThick,
+};
+
+inline Vector3f BlendedPos(const ParticleBuffer& ps, usize n, float blend) noexcept {
+    Vector3f pos = ParticleModify::GetPos(ps, n);
+    if (blend < 1.0f) {
+        Vector3f prev { ps.at(PB::PrevPosX, n), ps.at(PB::PrevPosY, n), ps.at(PB::PrevPosZ, n) };
+        pos = prev + (pos - prev) * blend;
     }
+    return pos;
 }
 
-inline void AssignVertex(std::span<float> dst, std::span<const float> src, uint num) noexcept {
-    const uint dst_one_size = dst.size() / num;
-    const uint src_one_size = src.size() / num;
-    for (uint i = 0; i < num; i++) {
-        std::copy_n(src.begin() + i * src_one_size, src_one_size, dst.begin() + i * dst_one_size);
-    }
+// the same value to the attribute at Offset of Num vertices, all sizes known to the compiler
+template<usize Num, u32 Stride, u32 Offset, usize N>
+inline void PutFixed(float* data, const std::array<float, N>& value) noexcept {
+    for (usize i = 0; i < Num; i++) std::copy_n(value.data(), N, data + i * Stride + Offset);
+}
+template<usize Num, u32 Stride, u32 Offset, usize N>
+inline void PutEachFixed(float* data, const std::array<float, N>& values) noexcept {
+    constexpr usize one = N / Num;
+    for (usize i = 0; i < Num; i++)
+        std::copy_n(values.data() + i * one, one, data + i * Stride + Offset);
+}
+// packed words the same way
+template<usize Num, u32 Stride, u32 Offset, usize N>
+inline void PutWords(float* data, const std::array<u32, N>& words) noexcept {
+    for (usize i = 0; i < Num; i++) std::memcpy(data + i * Stride + Offset, words.data(), N * 4);
+}
+template<usize Num, u32 Stride, u32 Offset, usize N>
+inline void PutEachWord(float* data, const std::array<u32, N>& words) noexcept {
+    static_assert(N == Num);
+    for (usize i = 0; i < Num; i++) std::memcpy(data + i * Stride + Offset, &words[i], 4);
 }
 
-inline usize GenParticleData(std::span<const std::unique_ptr<ParticleInstance>> instances,
-                             const ParticleRawGenSpecOp& specOp, WPGOption opt,
-                             SceneVertexArray& sv) noexcept {
-    std::array<float, 32 * 4> storage;
+inline u32 PackColor(const std::array<float, 4>& color) noexcept {
+    return SceneVertexArray::Pack(VertexType::UNORM8X4, color)[0];
+}
+// the first of two halves in the low bits
+inline u32 PackHalf2(float a, float b) noexcept {
+    return (u32)SceneVertexArray::HalfOf(a) | (u32)SceneVertexArray::HalfOf(b) << 16;
+}
 
-    float* data = storage.data();
+// what a quad shows of a particle
+struct QuadParticle {
+    std::array<float, 3> pos;
+    float                rz;
+    float                size;
+    std::array<float, 4> color;
+    // velocity and lifetime, thick format only
+    std::array<float, 4> velocity;
+    std::array<float, 2> rotation;
+};
 
-    const auto one_size   = sv.OneSize();
-    const auto totle_size = 4 * one_size;
-    usize      i { 0 };
-    for (const auto& inst : instances) {
-        if (inst->IsNoLiveParticle()) continue;
+inline QuadParticle LoadQuad(ParticleInstance& inst, usize n, const ParticleRawGenSpecOp& specOp,
+                             float blend) noexcept {
+    const auto& ps       = inst.Particles();
+    float       lifetime = ps.at(PB::Lifetime, n);
+    specOp(ps, n, { &lifetime });
+
+    Vector3f pos = BlendedPos(ps, n, blend) + inst.GetBoundedData().pos;
+    return {
+        .pos      = { pos[0], pos[1], pos[2] },
+        // a half float keeps it precise close to 0 only
+        .rz       = std::remainder(ps.at(PB::RotZ, n), 2.0f * (float)M_PI),
+        .size     = ps.at(PB::Size, n) / 2.0f,
+        .color    = { ps.at(PB::ColorR, n), ps.at(PB::ColorG, n), ps.at(PB::ColorB, n),
+                      ps.at(PB::Alpha, n) },
+        .velocity = { ps.at(PB::VelX, n), ps.at(PB::VelY, n), ps.at(PB::VelZ, n), lifetime },
+        .rotation = { ps.at(PB::RotX, n), ps.at(PB::RotY, n) },
+    };
+}
 
-        for (const auto& p : inst->Particles()) {
-            if (! ParticleModify::LifetimeOk(p)) {
-                continue;
-            }
+// a_Position, a_TexCoordVec4 as half floats, a_Color as bytes, a_TexCoordVec4C1 if thick,
+// a_TexCoordC2, unpadded, as SetParticleMesh makes them, ParticleCompute writes the same
+template<bool Thick, bool Instanced>
+struct FixedQuad {
+    static constexpr usize num      = Instanced ? 1 : 4;
+    static constexpr u32   pos      = 0;
+    static constexpr u32   texcoord = 3;
+    static constexpr u32   color    = 5;
+    static constexpr u32   velocity = 6;
+    static constexpr u32   rotation = Thick ? 10 : 6;
+    static constexpr u32   stride   = rotation + 2;
+
+    static bool Matches(const SceneVertexArray& sv) {
+        auto at = [&sv](std::string_view name, u32 offset, VertexType type) {
+            auto attr = sv.FindAttr(name);
+            return attr.valid() && attr.offset == offset && attr.type == type;
+        };
+        return sv.OneSize() == stride && sv.PerInstance() == Instanced &&
+               at(WE_IN_POSITION, pos, VertexType::FLOAT3) &&
+               at(WE_IN_TEXCOORDVEC4, texcoord, VertexType::HALF4) &&
+               at(WE_IN_COLOR, color, VertexType::UNORM8X4) &&
+               (! Thick || at(WE_IN_TEXCOORDVEC4C1, velocity, VertexType::FLOAT4)) &&
+               at(WE_IN_TEXCOORDC2, rotation, VertexType::FLOAT2);
+    }
 
-            float lifetime = p.lifetime;
-            specOp(p, { &lifetime });
-
-            auto  pos  = inst->GetBoundedData().pos + p.position;
-            float size = p.size / 2.0f;
-
-            usize offset = 0;
-
-            // pos
-            AssignVertexTimes(
-                { data + offset, totle_size }, std::array { pos[0], pos[1], pos[2] }, 4);
-            offset += 4;
-            // TexCoordVec4
-            float      rz = p.rotation[2];
-            std::array t { 0.0f, 1.0f, rz, size, 1.0f, 1.0f, rz, size,
-                           1.0f, 0.0f, rz, size, 0.0f, 0.0f, rz, size };
-            AssignVertex({ data + offset, totle_size }, t, 4);
-            offset += 4;
-
-            // color
-            AssignVertexTimes({ data + offset, totle_size },
-                              std::array { p.color[0], p.color[1], p.color[2], p.alpha },
-                              4);
-            offset += 4;
-
-            if (opt.thick_format) {
-                AssignVertexTimes(
-                    { data + offset, totle_size },
-                    std::array { p.velocity[0], p.velocity[1], p.velocity[2], lifetime },
-                    4);
-                offset += 4;
-            }
-            // TexCoordC2
-            AssignVertexTimes(
-                { data + offset, totle_size }, std::array { p.rotation[0], p.rotation[1] }, 4);
+    void operator()(float* data, const QuadParticle& q) const noexcept {
+        PutFixed<num, stride, pos>(data, q.pos);
+        // corner uvs, instanced ones come from the vertex shader
+        const u32 rz_size = PackHalf2(q.rz, q.size);
+        if constexpr (Instanced) {
+            PutWords<num, stride, texcoord>(data, std::array { 0u, rz_size });
+        } else {
+            constexpr u32 one = 0x3c00u;
+            constexpr std::array corners { one << 16, one | one << 16, one, 0u };
+            PutEachWord<num, stride, texcoord>(data, corners);
+            PutWords<num, stride, texcoord + 1>(data, std::array { rz_size });
+        }
+        PutWords<num, stride, color>(data, std::array { PackColor(q.color) });
+        if constexpr (Thick) PutFixed<num, stride, velocity>(data, q.velocity);
+        PutFixed<num, stride, rotation>(data, q.rotation);
+    }
+};
 
-            sv.SetVertexs((i++) * 4, { data, totle_size });
+// attributes resolved once a fill, any layout of the names
+struct GenericQuad {
+    usize num;
+    Attr  pos, texcoord, color, velocity, rotation;
+    GenericQuad(const SceneVertexArray& sv, bool thick)
+        : num(sv.PerInstance() ? 1 : 4),
+          pos(sv.FindAttr(WE_IN_POSITION)),
+          texcoord(sv.FindAttr(WE_IN_TEXCOORDVEC4)),
+          color(sv.FindAttr(WE_IN_COLOR)),
+          velocity(thick ? sv.FindAttr(WE_IN_TEXCOORDVEC4C1) : Attr {}),
+          rotation(sv.FindAttr(WE_IN_TEXCOORDC2)) {}
+
+    void operator()(float* data, const QuadParticle& q) const noexcept {
+        using SV = SceneVertexArray;
+        SV::Put(pos, data, num, q.pos);
+        if (num == 1) {
+            SV::Put(texcoord, data, num, std::array { 0.0f, 0.0f, q.rz, q.size });
+        } else {
+            std::array t { 0.0f, 1.0f, q.rz, q.size, 1.0f, 1.0f, q.rz, q.size,
+                           1.0f, 0.0f, q.rz, q.size, 0.0f, 0.0f, q.rz, q.size };
+            SV::PutEach(texcoord, data, num, t);
+        }
+        SV::Put(color, data, num, q.color);
+        // only in the thick format
+        SV::Put(velocity, data, num, q.velocity);
+        SV::Put(rotation, data, num, q.rotation);
+    }
+};
+
+template<typename TWrite>
+inline usize GenParticleData(std::span<const std::unique_ptr<ParticleInstance>> instances,
+                             const ParticleRawGenSpecOp& specOp, float blend,
+                             std::span<const ParticleRef> order, SceneVertexArray& sv,
+                             usize first, const TWrite& write) noexcept {
+    const usize num = write.num;
+    usize       i { first };
+    // false once the vertex array is full
+    auto put = [&](ParticleInstance& inst, usize n) {
+        float* data = sv.WriteVertices(i * num, num);
+        if (data == nullptr) return false;
+        write(data, LoadQuad(inst, n, specOp, blend));
+        i++;
+        return true;
+    };
+    if (! order.empty()) {
+        for (auto& ref : order) {
+            if (! put(*instances[ref.instance], ref.index)) break;
+        }
+        return i;
+    }
+    for (const auto& inst : instances) {
+        if (inst->IsNoLiveParticle()) continue;
+
+        const auto& ps = inst->Particles();
+        for (usize n = 0; n < ps.size(); n++) {
+            if (! ParticleModify::LifetimeOk(ps, n)) continue;
+            if (! put(*inst, n)) return i;
         }
     }
     return i;
 }
 
-inline size_t GenRopeParticleData(std::span<const Particle>   particles,
-                                  const ParticleRawGenSpecOp& specOp, WPGOption opt,
-                                  SceneVertexArray& sv) {
-    /*
-    attribute vec4 a_PositionVec4;
-    attribute vec4 a_TexCoordVec4;
-    attribute vec4 a_TexCoordVec4C1;
-
-    #if THICKFORMAT
-    attribute vec4 a_TexCoordVec4C2;
-    attribute vec4 a_TexCoordVec4C3;
-    attribute vec2 a_TexCoordC4;
-    #else
-    attribute vec3 a_TexCoordVec3C2;
-    attribute vec2 a_TexCoordC3;
-    #endif
-
-    attribute vec4 a_Color;
-
-    #define in_ParticleTrailLength (a_TexCoordVec4.w)
-    #define in_ParticleTrailPosition (a_TexCoordVec4C1.w)
-    */
-    std::array<float, 32 * 4> storage;
-
-    float* data = storage.data();
-
-    const auto one_size   = sv.OneSize();
-    const auto totle_size = one_size * 4;
-    uint       i { 0 };
-    for (const auto& p : particles) {
-        if (i == 0) {
-            i++;
-            continue;
-        }
-        if (! ParticleModify::LifetimeOk(p)) break;
-
-        const auto& pre_p  = particles[i - 1];
-        float       size   = p.size / 2.0f;
-        std::size_t offset = 0;
-
-        float lifetime = p.lifetime;
-        specOp(p, { &lifetime });
-        float in_ParticleTrailLength   = particles.size();
-        float in_ParticleTrailPosition = i - 1;
-
-        Vector3f cp_vec = AngleAxisf(p.rotation[2] + M_PI / 2.0f, Vector3f::UnitZ()) *
-                          Vector3f { 0.0f, size / 2.0f, 0.0f };
-        Vector3f pos_vec = Vector3f { p.position } - Vector3f { pre_p.position };
-
-        cp_vec       = pos_vec.normalized().dot(cp_vec) > 0 ? cp_vec : -1.0f * cp_vec;
-        auto&    sp  = pre_p;
-        auto&    ep  = p;
-        Vector3f scp = Vector3f { sp.position } + cp_vec;
-        Vector3f ecp = Vector3f { ep.position } - cp_vec;
-
-        // a_PositionVec4: start pos
-        AssignVertexTimes({ data + offset, totle_size },
-                          std::array { sp.position[0], sp.position[1], sp.position[2], size },
-                          4);
-        offset += 4;
-        // a_TexCoordVec4: end pos
-        AssignVertexTimes(
-            { data + offset, totle_size },
-            std::array { ep.position[0], ep.position[1], ep.position[2], in_ParticleTrailLength },
-            4);
-        offset += 4;
-
-        // a_TexCoordVec4C1: cp start pos
-        AssignVertexTimes({ data + offset, totle_size },
-                          std::array { scp[0], scp[1], scp[2], in_ParticleTrailPosition },
-                          4);
-        offset += 4;
-
-        if (opt.thick_format) {
-            // a_TexCoordVec4C2: cp end pos, size_end
-            AssignVertexTimes(
-                { data + offset, totle_size }, std::array { ecp[0], ecp[1], ecp[2], size }, 4);
-            offset += 4;
-            // a_TexCoordVec4C3: color_end
-            AssignVertexTimes({ data + offset, totle_size },
-                              std::array { p.color[0], p.color[1], p.color[2], p.alpha },
-                              4);
-            offset += 4;
-            // a_TexCoordC4
-            std::array t { 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
-            AssignVertex({ data + offset, totle_size }, t, 4);
-            offset += 4;
+// what the quad of a rope segment shows
+struct RopeSegment {
+    std::array<float, 4> start;
+    std::array<float, 4> end;
+    std::array<float, 4> cp_start;
+    // cp end pos and size, the size only in the thick format
+    std::array<float, 4> cp_end;
+    std::array<float, 4> color;
+};
+
+// corner uvs
+constexpr std::array rope_corners { 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f };
+
+/*
+attribute vec4 a_PositionVec4;
+attribute vec4 a_TexCoordVec4;
+attribute vec4 a_TexCoordVec4C1;
+
+#if THICKFORMAT
+attribute vec4 a_TexCoordVec4C2;
+attribute vec4 a_TexCoordVec4C3;
+attribute vec2 a_TexCoordC4;
+#else
+attribute vec3 a_TexCoordVec3C2;
+attribute vec2 a_TexCoordC3;
+#endif
+
+attribute vec4 a_Color;
+
+#define in_ParticleTrailLength (a_TexCoordVec4.w)
+#define in_ParticleTrailPosition (a_TexCoordVec4C1.w)
+*/
+// floats padded to four but the thin cp end, colors as bytes and corners as shorts, as
+// SetRopeParticleMesh makes them
+template<bool Thick>
+struct FixedRope {
+    static constexpr usize num       = 4;
+    static constexpr u32   start     = 0;
+    static constexpr u32   end       = 4;
+    static constexpr u32   cp_start  = 8;
+    static constexpr u32   cp_end    = 12;
+    static constexpr u32   color_end = 16;
+    static constexpr u32   corner    = Thick ? 17 : 15;
+    static constexpr u32   color     = corner + 1;
+    static constexpr u32   stride    = color + 1;
+
+    static bool Matches(const SceneVertexArray& sv) {
+        auto at = [&sv](std::string_view name, u32 offset, VertexType type) {
+            auto attr = sv.FindAttr(name);
+            return attr.valid() && attr.offset == offset && attr.type == type;
+        };
+        return sv.OneSize() == stride && at(WE_IN_POSITIONVEC4, start, VertexType::FLOAT4) &&
+               at(WE_IN_TEXCOORDVEC4, end, VertexType::FLOAT4) &&
+               at(WE_IN_TEXCOORDVEC4C1, cp_start, VertexType::FLOAT4) &&
+               (Thick ? at(WE_IN_TEXCOORDVEC4C2, cp_end, VertexType::FLOAT4)
+                      : at(WE_IN_TEXCOORDVEC3C2, cp_end, VertexType::FLOAT3)) &&
+               (! Thick || at(WE_IN_TEXCOORDVEC4C3, color_end, VertexType::UNORM8X4)) &&
+               at(Thick ? WE_IN_TEXCOORDC4 : WE_IN_TEXCOORDC3, corner, VertexType::SNORM16X2) &&
+               at(WE_IN_COLOR, color, VertexType::UNORM8X4);
+    }
+
+    void operator()(float* data, const RopeSegment& s) const noexcept {
+        PutFixed<num, stride, start>(data, s.start);
+        PutFixed<num, stride, end>(data, s.end);
+        PutFixed<num, stride, cp_start>(data, s.cp_start);
+        const u32 color_word = PackColor(s.color);
+        if constexpr (Thick) {
+            PutFixed<num, stride, cp_end>(data, s.cp_end);
+            PutWords<num, stride, color_end>(data, std::array { color_word });
         } else {
-            // a_TexCoordVec3C2: cp end pos
-            AssignVertexTimes(
-                { data + offset, totle_size }, std::array { ecp[0], ecp[1], ecp[2] }, 4);
-            offset += 4;
-
-            // a_TexCoordC3
-            std::array t { 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
-            AssignVertex({ data + offset, totle_size }, t, 4);
-            offset += 4;
+            std::array cp_end3 { s.cp_end[0], s.cp_end[1], s.cp_end[2] };
+            PutFixed<num, stride, cp_end>(data, cp_end3);
         }
+        // 0 and 1 as snorm shorts
+        constexpr u32 one = 0x7fffu;
+        PutEachWord<num, stride, corner>(data, std::array { one << 16, one | one << 16, one, 0u });
+        PutWords<num, stride, color>(data, std::array { color_word });
+    }
+};
+
+struct GenericRope {
+    bool thick;
+    Attr start, end, cp_start, cp_end, color_end, corner, color;
+    GenericRope(const SceneVertexArray& sv, bool thick)
+        : thick(thick),
+          start(sv.FindAttr(WE_IN_POSITIONVEC4)),
+          end(sv.FindAttr(WE_IN_TEXCOORDVEC4)),
+          cp_start(sv.FindAttr(WE_IN_TEXCOORDVEC4C1)),
+          cp_end(sv.FindAttr(thick ? WE_IN_TEXCOORDVEC4C2 : WE_IN_TEXCOORDVEC3C2)),
+          color_end(thick ? sv.FindAttr(WE_IN_TEXCOORDVEC4C3) : Attr {}),
+          corner(sv.FindAttr(thick ? WE_IN_TEXCOORDC4 : WE_IN_TEXCOORDC3)),
+          color(sv.FindAttr(WE_IN_COLOR)) {}
+
+    void operator()(float* data, const RopeSegment& s) const noexcept {
+        using SV = SceneVertexArray;
+        SV::Put(start, data, 4, s.start);
+        SV::Put(end, data, 4, s.end);
+        SV::Put(cp_start, data, 4, s.cp_start);
+        SV::Put(cp_end, data, 4, std::span { s.cp_end }.first(thick ? 4 : 3));
+        SV::Put(color_end, data, 4, s.color);
+        SV::PutEach(corner, data, 4, rope_corners);
+        SV::Put(color, data, 4, s.color);
+    }
+};
 
-        // a_Color
-        AssignVertexTimes({ data + offset, totle_size },
-                          std::array { p.color[0], p.color[1], p.color[2], p.alpha },
-                          4);
+// a quad from every live particle to the next live one of its instance, the emitter keeps them
+// in spawn order
+// every particle is read once, the end of a segment is the start of the next
+template<typename TWrite>
+inline usize GenRopeParticleData(std::span<const std::unique_ptr<ParticleInstance>> instances,
+                                 float blend, SceneVertexArray& sv, usize first,
+                                 const TWrite& write) noexcept {
+    usize i { first };
+    for (const auto& inst : instances) {
+        if (inst->IsNoLiveParticle()) continue;
 
-        sv.SetVertexs((i++) * 4, { data, totle_size });
+        const auto& ps   = inst->Particles();
+        const auto& base = inst->GetBoundedData().pos;
+
+        usize live = 0;
+        for (usize n = 0; n < ps.size(); n++) live += ParticleModify::LifetimeOk(ps, n) ? 1 : 0;
+        if (live < 2) continue;
+        const float in_ParticleTrailLength = (float)live;
+
+        bool     has_start { false };
+        Vector3f sp;
+        usize    segment { 0 };
+        for (usize n = 0; n < ps.size(); n++) {
+            if (! ParticleModify::LifetimeOk(ps, n)) continue;
+            Vector3f ep = BlendedPos(ps, n, blend) + base;
+            if (! std::exchange(has_start, true)) {
+                sp = ep;
+                continue;
+            }
+
+            float* data = sv.WriteVertices(i * 4, 4);
+            if (data == nullptr) return i;
+
+            float size                     = ps.at(PB::Size, n) / 2.0f;
+            float in_ParticleTrailPosition = (float)segment++;
+
+            Vector3f cp_vec = AngleAxisf(ps.at(PB::RotZ, n) + M_PI / 2.0f, Vector3f::UnitZ()) *
+                              Vector3f { 0.0f, size / 2.0f, 0.0f };
+            cp_vec       = (ep - sp).normalized().dot(cp_vec) > 0 ? cp_vec : -1.0f * cp_vec;
+            Vector3f scp = sp + cp_vec;
+            Vector3f ecp = ep - cp_vec;
+
+            write(data,
+                  RopeSegment {
+                      .start    = { sp[0], sp[1], sp[2], size },
+                      .end      = { ep[0], ep[1], ep[2], in_ParticleTrailLength },
+                      .cp_start = { scp[0], scp[1], scp[2], in_ParticleTrailPosition },
+                      .cp_end   = { ecp[0], ecp[1], ecp[2], size },
+                      .color    = { ps.at(PB::ColorR, n), ps.at(PB::ColorG, n),
+                                    ps.at(PB::ColorB, n), ps.at(PB::Alpha, n) },
+                  });
+            i++;
+            sp = ep;
+        }
+    }
+    return i;
+}
+
+GenLayout PickLayout(const SceneVertexArray& sv) {
+    const bool thick = sv.GetOption(WE_CB_THICK_FORMAT);
+    if (! sv.PerInstance() && sv.GetOption(WE_PRENDER_ROPE)) {
+        if (thick && FixedRope<true>::Matches(sv)) return GenLayout::RopeThick;
+        if (! thick && FixedRope<false>::Matches(sv)) return GenLayout::Rope;
+        return GenLayout::GenericRope;
+    }
+    if (thick) {
+        if (FixedQuad<true, true>::Matches(sv)) return GenLayout::InstancedThick;
+        if (FixedQuad<true, false>::Matches(sv)) return GenLayout::QuadThick;
+    } else {
+        if (FixedQuad<false, true>::Matches(sv)) return GenLayout::Instanced;
+        if (FixedQuad<false, false>::Matches(sv)) return GenLayout::Quad;
     }
-    return i == 0 ? 0 : i - 1;
+    return GenLayout::Generic;
 }
 
-inline void updateIndexArray(uint16_t index, size_t count, SceneIndexArray& iarray) noexcept {
-    constexpr size_t single_size = 6;
-    const uint16_t   cv          = index * 4;
+// quads from index up to count, u16 indices pack two per element
+template<typename T>
+inline void updateIndexArray(usize index, usize count, SceneIndexArray& iarray) noexcept {
+    constexpr usize single_size = 6;
+    const T         cv          = (T)(index * 4);
 
-    std::array<uint16_t, single_size> single;
+    std::array<T, single_size> single;
     // 0 1 3
     // 1 2 3
     single[0] = cv;
@@ -219,36 +407,56 @@ inline void updateIndexArray(uint16_t index, size_t count, SceneIndexArray& iarr
     single[4] = cv + 2;
     single[5] = cv + 3;
     // every particle
-    for (uint16_t i = index; i < count; i++) {
-        iarray.AssignHalf(i * single_size, single);
+    for (usize i = index; i < count; i++) {
+        if constexpr (sizeof(T) == sizeof(u16))
+            iarray.AssignHalf(i * single_size, single);
+        else
+            iarray.Assign(i * single_size, single);
         for (auto& x : single) x += 4;
     }
 }
 } // namespace
 
-void WPParticleRawGener::GenGLData(std::span<const std::unique_ptr<ParticleInstance>> instances,
-                                   SceneMesh& mesh, ParticleRawGenSpecOp& specOp) {
+u32 WPParticleRawGener::GenGLData(std::span<const std::unique_ptr<ParticleInstance>> instances,
+                                  SceneMesh& mesh, ParticleRawGenSpecOp& specOp, float blend,
+                                  std::span<const ParticleRef> order, u32 first) {
     auto& sv = mesh.GetVertexArray(0);
-    auto& si = mesh.GetIndexArray(0);
-
-    WPGOption opt;
-
-    opt.thick_format = sv.GetOption(WE_CB_THICK_FORMAT);
-
+    if (sv.Layout() == 0) sv.SetLayout((u32)PickLayout(sv));
+
+    auto quads = [&](const auto& write) {
+        return GenParticleData(instances, specOp, blend, order, sv, first, write);
+    };
+    auto ropes = [&](const auto& write) {
+        return GenRopeParticleData(instances, blend, sv, first, write);
+    };
     usize particle_num { 0 };
+    switch ((GenLayout)sv.Layout()) {
+    case GenLayout::Quad: particle_num = quads(FixedQuad<false, false> {}); break;
+    case GenLayout::QuadThick: particle_num = quads(FixedQuad<true, false> {}); break;
+    case GenLayout::Instanced: particle_num = quads(FixedQuad<false, true> {}); break;
+    case GenLayout::InstancedThick: particle_num = quads(FixedQuad<true, true> {}); break;
+    case GenLayout::Rope: particle_num = ropes(FixedRope<false> {}); break;
+    case GenLayout::RopeThick: particle_num = ropes(FixedRope<true> {}); break;
+    case GenLayout::GenericRope:
+        particle_num = ropes(GenericRope(sv, sv.GetOption(WE_CB_THICK_FORMAT)));
+        break;
+    default: particle_num = quads(GenericQuad(sv, sv.GetOption(WE_CB_THICK_FORMAT))); break;
+    }
 
-    /*
-    if (sv.GetOption(WE_PRENDER_ROPE))
-        particle_num = GenRopeParticleData(particles, specOp, opt, sv);
-    else
-    */
-    particle_num += GenParticleData(instances, specOp, opt, sv);
-
-    // LOG_INFO("num: %d", particle_num);
+    if (sv.PerInstance()) {
+        mesh.SetInstanceCount((u32)particle_num);
+        return (u32)particle_num;
+    }
+    auto& si = mesh.GetIndexArray(0);
 
-    u16 indexNum = (si.DataCount() * 2) / 6;
-    if (particle_num > indexNum) {
-        updateIndexArray(indexNum, particle_num, si);
+    // the quads the index array holds stay, only new ones are added
+    usize index_num = si.IndexCount() / 6;
+    if (particle_num > index_num) {
+        if (si.Wide())
+            updateIndexArray<u32>(index_num, particle_num, si);
+        else
+            updateIndexArray<u16>(index_num, particle_num, si);
     }
-    si.SetRenderDataCount(particle_num * 6 / 2);
+    si.SetRenderDataCount(si.Wide() ? particle_num * 6 : particle_num * 6 / 2);
+    return (u32)particle_num;
 }
@@ -5,6 +5,7 @@
 namespace wallpaper
 {
 
+// a single particle while it is spawned, stored into a ParticleBuffer afterwards
 struct Particle {
     struct InitValue {
         Eigen::Vector3f color { 1.0f, 1.0f, 1.0f };
@@ -20,9 +21,7 @@ struct Particle {
 
     Eigen::Vector3f rotation { 0.0f, 0.0f, 0.0f }; // radian  z x y
     Eigen::Vector3f velocity { 0.0f, 0.0f, 0.0f };
-    Eigen::Vector3f acceleration { 0.0f, 0.0f, 0.0f };
     Eigen::Vector3f angularVelocity { 0.0f, 0.0f, 0.0f };
-    Eigen::Vector3f angularAcceleration { 0.0f, 0.0f, 0.0f };
 
     bool      mark_new { true };
     InitValue init {};
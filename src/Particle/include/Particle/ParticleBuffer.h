@@ -0,0 +1,106 @@
+#pragma once
+#include "Particle.h"
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+#include "Utils/MemUse.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace wallpaper
+{
+
+// Structure of arrays particle storage.
+// Every attribute is its own float stream, streams start 32 byte aligned and are padded to
+// a multiple of 8 floats, so operators touch only the floats they use and vectorize cleanly.
+class ParticleBuffer : NoCopy, NoMove {
+public:
+    enum Stream : usize
+    {
+        PosX = 0,
+        PosY,
+        PosZ,
+        VelX,
+        VelY,
+        VelZ,
+        RotX, // radian  z x y
+        RotY,
+        RotZ,
+        AngularX,
+        AngularY,
+        AngularZ,
+        ColorR,
+        ColorG,
+        ColorB,
+        Alpha,
+        Size,
+        Lifetime,
+        InitColorR,
+        InitColorG,
+        InitColorB,
+        InitAlpha,
+        InitSize,
+        InitLifetime,
+        // position before the last fixed step, set to the position on spawn
+        PrevPosX,
+        PrevPosY,
+        PrevPosZ,
+        StreamNum,
+    };
+
+    constexpr static usize Alignment { 32 };
+    constexpr static usize Padding { Alignment / sizeof(float) };
+
+    ParticleBuffer() = default;
+    ~ParticleBuffer();
+
+    usize size() const { return m_size; }
+    bool  empty() const { return m_size == 0; }
+    void  clear() {
+        m_size  = 0;
+        m_fresh = true;
+    }
+    void reserve(usize);
+    // nothing spawned since the last clear, compact() doesn't make a buffer fresh again
+    bool fresh() const { return m_fresh; }
+
+    void     push_back(const Particle&);
+    void     set(usize, const Particle&);
+    Particle get(usize) const;
+
+    float*       stream(Stream s) { return m_data + s * m_capacity; }
+    const float* stream(Stream s) const { return m_data + s * m_capacity; }
+
+    float& at(Stream s, usize i) { return stream(s)[i]; }
+    float  at(Stream s, usize i) const { return stream(s)[i]; }
+
+    bool isNew(usize i) const { return m_new[i] != 0; }
+    void markOld(usize i) { m_new[i] = 0; }
+
+    // old << new << dead, stable inside each group
+    void sortByAge();
+
+    // copies the positions to PrevPos before a fixed step
+    void savePositions();
+
+    // drops dead particles, the others keep their order
+    // false if none was dead, else remap holds the new index of every old one, -1 if dropped
+    bool compact(std::vector<isize>& remap);
+
+private:
+    void grow(usize);
+
+    float*               m_data { nullptr };
+    usize                m_capacity { 0 };
+    usize                m_size { 0 };
+    bool                 m_fresh { true };
+    std::vector<uint8_t> m_new;
+
+    std::vector<u32>   m_order;
+    std::vector<float> m_scratch;
+
+    // the streams and the new flags, the sort's scratch isn't counted
+    memuse::Held m_held { memuse::Pool::Particles };
+};
+
+} // namespace wallpaper
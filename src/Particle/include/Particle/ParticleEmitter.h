@@ -1,38 +1,19 @@
 #pragma once
 #include "Particle.h"
+#include "ParticleBuffer.h"
+#include "ParticleInitializer.h"
+#include "ParticleOperator.h"
 
 #include <vector>
-#include <random>
-#include <memory>
-#include <functional>
 #include <array>
 #include <span>
+#include <variant>
 
 #include "Core/Literals.hpp"
 
 namespace wallpaper
 {
 
-struct ParticleControlpoint {
-    bool            link_mouse { false };
-    bool            worldspace { false };
-    Eigen::Vector3d offset { 0, 0, 0 };
-};
-
-struct ParticleInfo {
-    std::span<Particle>                   particles;
-    std::span<const ParticleControlpoint> controlpoints;
-    double                                time;
-    double                                time_pass;
-};
-
-using ParticleInitOp = std::function<void(Particle&, double)>;
-// particle index lifetime-percent passTime
-using ParticleOperatorOp = std::function<void(const ParticleInfo&)>;
-
-using ParticleEmittOp = std::function<void(std::vector<Particle>&, std::vector<ParticleInitOp>&,
-                                           uint32_t maxcount, double timepass)>;
-
 struct ParticleBoxEmitterArgs {
     std::array<float, 3> directions;
     std::array<float, 3> minDistance;
@@ -44,8 +25,6 @@ struct ParticleBoxEmitterArgs {
     u32                  instantaneous;
     float                minSpeed;
     float                maxSpeed;
-
-    static ParticleEmittOp MakeEmittOp(ParticleBoxEmitterArgs);
 };
 
 struct ParticleSphereEmitterArgs {
@@ -60,8 +39,44 @@ struct ParticleSphereEmitterArgs {
     u32                    instantaneous;
     float                  minSpeed;
     float                  maxSpeed;
+};
+
+template<typename TArgs>
+inline bool ExhaustedFor(const TArgs& a, const ParticleBuffer& ps) {
+    return ! a.one_per_frame && ! (a.emitSpeed > 0.0f) && ! (a.instantaneous > 0 && ps.fresh());
+}
 
-    static ParticleEmittOp MakeEmittOp(ParticleSphereEmitterArgs);
+// spawns into the buffer and runs the initializers on every new particle
+class ParticleBoxEmitter {
+public:
+    ParticleBoxEmitter(const ParticleBoxEmitterArgs& a): m_args(a) {}
+
+    void operator()(ParticleBuffer&, std::span<ParticleInitOp>, u32 maxcount, double timepass);
+
+    // reorders the buffer after spawning
+    bool Sorts() const { return m_args.sort; }
+    // spawns nothing into the buffer anymore, as a burst that fired and has no rate
+    bool Exhausted(const ParticleBuffer& ps) const { return ExhaustedFor(m_args, ps); }
+
+private:
+    ParticleBoxEmitterArgs m_args;
+    double                 m_timer { 0.0 };
 };
 
+class ParticleSphereEmitter {
+public:
+    ParticleSphereEmitter(const ParticleSphereEmitterArgs& a): m_args(a) {}
+
+    void operator()(ParticleBuffer&, std::span<ParticleInitOp>, u32 maxcount, double timepass);
+
+    bool Sorts() const { return m_args.sort; }
+    bool Exhausted(const ParticleBuffer& ps) const { return ExhaustedFor(m_args, ps); }
+
+private:
+    ParticleSphereEmitterArgs m_args;
+    double                    m_timer { 0.0 };
+};
+
+using ParticleEmittOp = std::variant<ParticleBoxEmitter, ParticleSphereEmitter>;
+
 } // namespace wallpaper
@@ -0,0 +1,21 @@
+#pragma once
+#include "ParticleBuffer.h"
+#include "ParticleOperator.h"
+#include "Scene/SceneParticleSim.h"
+
+#include <span>
+#include <vector>
+
+namespace wallpaper
+{
+namespace ParticleGpuSim
+{
+
+// false if an operator has no compute version, the subsystem then stays on cpu
+// oscillators keep random per particle state and are not ported
+bool TranslateOps(std::span<const ParticleOperatorOp>, std::vector<SceneParticleSim::Op>&);
+
+SceneParticleSim::Spawn MakeSpawn(const ParticleBuffer&, usize index);
+
+} // namespace ParticleGpuSim
+} // namespace wallpaper
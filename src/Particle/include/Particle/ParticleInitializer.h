@@ -0,0 +1,107 @@
+#pragma once
+#include "Particle.h"
+
+#include <array>
+#include <cmath>
+#include <variant>
+
+namespace wallpaper
+{
+
+// run once on every spawned particle, duration is the time one emit takes
+
+struct ColorRandomInit {
+    // normalized
+    std::array<float, 3> min { 0.0f, 0.0f, 0.0f };
+    std::array<float, 3> max { 1.0f, 1.0f, 1.0f };
+
+    void operator()(Particle&, double) const;
+};
+
+struct LifetimeRandomInit {
+    float min { 0.0f };
+    float max { 1.0f };
+
+    void operator()(Particle&, double) const;
+};
+
+struct SizeRandomInit {
+    float min { 0.0f };
+    float max { 20.0f };
+
+    void operator()(Particle&, double) const;
+};
+
+struct AlphaRandomInit {
+    float min { 0.05f };
+    float max { 1.0f };
+
+    void operator()(Particle&, double) const;
+};
+
+struct VelocityRandomInit {
+    std::array<float, 3> min { -32.0f, -32.0f, 0.0f };
+    std::array<float, 3> max { 32.0f, 32.0f, 0.0f };
+
+    void operator()(Particle&, double) const;
+};
+
+struct RotationRandomInit {
+    std::array<float, 3> min { 0.0f, 0.0f, 0.0f };
+    std::array<float, 3> max { 0.0f, 0.0f, 2.0f * (float)M_PI };
+
+    void operator()(Particle&, double) const;
+};
+
+struct AngularVelocityRandomInit {
+    std::array<float, 3> min { 0.0f, 0.0f, -5.0f };
+    std::array<float, 3> max { 0.0f, 0.0f, 5.0f };
+
+    void operator()(Particle&, double) const;
+};
+
+struct TurbulentVelocityRandomInit {
+    float  scale { 1.0f };
+    double timescale { 1.0f };
+    float  offset { 0.0f };
+    float  speedmin { 100.0f };
+    float  speedmax { 250.0f };
+    float  phasemin { 0.0f };
+    float  phasemax { 0.1f };
+
+    std::array<float, 3> forward { 0.0f, 1.0f, 0.0f }; // x y z
+    std::array<float, 3> right { 0.0f, 0.0f, 1.0f };
+    std::array<float, 3> up { 1.0f, 0.0f, 0.0f };
+
+    // walks through the noise field with every spawn
+    Eigen::Vector3f pos { 0.0f, 0.0f, 0.0f };
+
+    void operator()(Particle&, double);
+};
+
+// instance override, applied after the other initializers
+struct OverrideInit {
+    float lifetime { 1.0f };
+    float alpha { 1.0f };
+    float size { 1.0f };
+    float speed { 1.0f };
+
+    bool                 over_color { false };
+    bool                 over_colorn { false };
+    std::array<float, 3> color { 1.0f, 1.0f, 1.0f }; // normalized
+    std::array<float, 3> colorn { 1.0f, 1.0f, 1.0f };
+
+    void operator()(Particle&, double) const;
+};
+
+using ParticleInitOp = std::variant<ColorRandomInit,
+                                    LifetimeRandomInit,
+                                    SizeRandomInit,
+                                    AlphaRandomInit,
+                                    VelocityRandomInit,
+                                    RotationRandomInit,
+                                    AngularVelocityRandomInit,
+                                    TurbulentVelocityRandomInit,
+                                    OverrideInit>;
+
+} // namespace wallpaper
@@ -0,0 +1,54 @@
+#pragma once
+#include "ParticleBuffer.h"
+
+#include <array>
+#include <span>
+#include <vector>
+
+namespace wallpaper
+{
+
+// Vectorized operators over whole particle streams.
+namespace ParticleKernels
+{
+
+// value over lifetime position, start_value until start, lerp to end_value until end
+struct FadeCurve {
+    float start { 0.0f };
+    float end { 1.0f };
+    float start_value { 1.0f };
+    float end_value { 0.0f };
+};
+
+// alpha, size and color back to their init values
+void Reset(ParticleBuffer&);
+
+// velocity += speed * (gravity - 2 * drag * velocity) * t, position += velocity * t
+void Movement(ParticleBuffer&, float drag, float speed, const std::array<float, 3>& gravity,
+              float t);
+// same as movement for angular velocity and rotation, the drag comes from the rotation
+void AngularMovement(ParticleBuffer&, float drag, const std::array<float, 3>& force, float t);
+
+// stream *= scale * curve(lifetime position)
+void MultiplyFade(ParticleBuffer&, ParticleBuffer::Stream, const FadeCurve&, float scale = 1.0f);
+
+// alpha fades in until fadein and out after fadeout, in lifetime position
+void AlphaFade(ParticleBuffer&, float fadein, float fadeout);
+
+// velocity += speed * normalize(curl(perlin((pos + (offset, 0, 0)) * scale))) * t on the axes
+// set in mask, the field of algorism::CurlNoise
+void Turbulence(ParticleBuffer&, double offset, float scale, float speed,
+                const std::array<int32_t, 3>& mask, float t);
+
+// grows lo, hi by the live particles, padded by their size, false if none lives
+bool Bounds(const ParticleBuffer&, std::array<float, 3>& lo, std::array<float, 3>& hi);
+
+// out[i] = plane . (pos, 1) of every particle, dead ones too, out holds buf.size()
+void Depth(const ParticleBuffer&, const std::array<float, 4>& plane, float* out);
+
+// order gets the indices of keys, ascending and stable, by a radix sort of a pass a byte, passes
+// all keys agree on are skipped, scratch is the second buffer, both keep their capacity
+void SortKeys(std::span<const u16> keys, std::vector<u32>& order, std::vector<u32>& scratch);
+
+} // namespace ParticleKernels
+} // namespace wallpaper
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Particle.h"
+#include "ParticleBuffer.h"
 
 #include <Eigen/Dense>
 #include <cstdint>
@@ -182,5 +183,39 @@ inline const Eigen::Vector3f& GetPos(const Particle& p) { return p.position; }
 inline const Eigen::Vector3f& GetVelocity(const Particle& p) { return p.velocity; }
 inline const Eigen::Vector3f& GetAngular(const Particle& p) { return p.rotation; }
 
+// single particle access into a buffer, for operators that do not map onto the kernels
+using PB = ParticleBuffer;
+
+inline Eigen::Vector3f GetPos(const PB& b, usize i) {
+    return { b.at(PB::PosX, i), b.at(PB::PosY, i), b.at(PB::PosZ, i) };
+}
+inline void Move(PB& b, usize i, const Eigen::Vector3d& d) noexcept {
+    b.at(PB::PosX, i) = (float)(b.at(PB::PosX, i) + d[0]);
+    b.at(PB::PosY, i) = (float)(b.at(PB::PosY, i) + d[1]);
+    b.at(PB::PosZ, i) = (float)(b.at(PB::PosZ, i) + d[2]);
+}
+inline void Accelerate(PB& b, usize i, const Eigen::Vector3d& acc, double t) noexcept {
+    b.at(PB::VelX, i) = (float)(b.at(PB::VelX, i) + acc[0] * t);
+    b.at(PB::VelY, i) = (float)(b.at(PB::VelY, i) + acc[1] * t);
+    b.at(PB::VelZ, i) = (float)(b.at(PB::VelZ, i) + acc[2] * t);
+}
+
+inline void ChangeLifetime(PB& b, usize i, double l) noexcept { b.at(PB::Lifetime, i) += l; }
+inline bool LifetimeOk(const PB& b, usize i) noexcept { return b.at(PB::Lifetime, i) > 0.0f; }
+inline double LifetimePos(const PB& b, usize i) {
+    float lifetime = b.at(PB::Lifetime, i);
+    if (lifetime < 0) return 1.0;
+    return 1.0 - (lifetime / b.at(PB::InitLifetime, i));
+}
+inline double LifetimePassed(const PB& b, usize i) noexcept {
+    return b.at(PB::InitLifetime, i) - b.at(PB::Lifetime, i);
+}
+
+inline void MutiplyAlpha(PB& b, usize i, double a) { b.at(PB::Alpha, i) *= a; }
+inline void MutiplySize(PB& b, usize i, double s) { b.at(PB::Size, i) *= s; }
+
+inline void MarkOld(PB& b, usize i) { b.markOld(i); }
+inline bool IsNew(const PB& b, usize i) { return b.isNew(i); }
+
 }; // namespace ParticleModify
 } // namespace wallpaper
@@ -0,0 +1,182 @@
+#pragma once
+#include "ParticleBuffer.h"
+#include "ParticleKernels.h"
+#include "Utils/BitFlags.hpp"
+
+#include <Eigen/Core>
+#include <array>
+#include <cmath>
+#include <span>
+#include <variant>
+#include <vector>
+
+namespace wallpaper
+{
+
+struct ParticleControlpoint {
+    bool            link_mouse { false };
+    bool            worldspace { false };
+    Eigen::Vector3d offset { 0, 0, 0 };
+};
+
+struct ParticleInfo {
+    ParticleBuffer&                       particles;
+    std::span<const ParticleControlpoint> controlpoints;
+    double                                time;
+    double                                time_pass;
+};
+
+// operators run once per instance and frame over all of its particles
+
+struct MovementOp {
+    float                drag { 0.0f };
+    float                speed { 1.0f };
+    std::array<float, 3> gravity { 0.0f, 0.0f, 0.0f };
+
+    void operator()(const ParticleInfo&) const;
+};
+
+struct AngularMovementOp {
+    float                drag { 0.0f };
+    std::array<float, 3> force { 0.0f, 0.0f, 0.0f };
+
+    void operator()(const ParticleInfo&) const;
+};
+
+// sizechange and alphachange
+struct FadeOp {
+    ParticleBuffer::Stream     stream { ParticleBuffer::Alpha };
+    ParticleKernels::FadeCurve curve {};
+    float                      scale { 1.0f };
+
+    void operator()(const ParticleInfo&) const;
+};
+
+struct AlphaFadeOp {
+    float fadein { 0.5f };
+    float fadeout { 0.5f };
+
+    void operator()(const ParticleInfo&) const;
+};
+
+struct ColorChangeOp {
+    std::array<ParticleKernels::FadeCurve, 3> curves {};
+
+    void operator()(const ParticleInfo&) const;
+};
+
+struct FrequencyValue {
+    std::array<float, 3> mask { 1.0f, 1.0f, 0.0f };
+
+    float frequencymin { 0.0f };
+    float frequencymax { 10.0f };
+    float scalemin { 0.0f };
+    float scalemax { 1.0f };
+    float phasemin { 0.0f };
+    float phasemax { static_cast<float>(2 * M_PI) };
+
+    struct StorageRandom {
+        bool  reset { true };
+        float frequency { 0.0f };
+        float scale { 1.0f };
+        float phase { 0.0f };
+    };
+
+    std::vector<StorageRandom> storage;
+
+    void   CheckAndResize(size_t s);
+    // follows ParticleBuffer::compact, freed entries draw new values
+    void   Compact(std::span<const isize> remap);
+    void   GenFrequency(const ParticleBuffer&, uint32_t index);
+    double GetScale(uint32_t index, double time) const;
+    double GetMove(uint32_t index, double time, double timePass) const;
+};
+
+// oscillatealpha and oscillatesize
+struct OscillateOp {
+    ParticleBuffer::Stream stream { ParticleBuffer::Alpha };
+    FrequencyValue         fv;
+
+    void operator()(const ParticleInfo&);
+    void Compact(std::span<const isize> remap) { fv.Compact(remap); }
+};
+
+struct OscillatePositionOp {
+    std::array<FrequencyValue, 3> fxp;
+
+    void operator()(const ParticleInfo&);
+    void Compact(std::span<const isize> remap) {
+        for (auto& f : fxp) f.Compact(remap);
+    }
+};
+
+struct TurbulenceOp {
+    // how fast the noise field changes shape.
+    float timescale { 20.0f };
+
+    float scale { 0.01f };
+
+    std::array<int32_t, 3> mask { 1, 1, 0 };
+
+    // picked once between phasemin/phasemax and speedmin/speedmax
+    double phase { 0.0 };
+    double speed { 500.0 };
+
+    void operator()(const ParticleInfo&) const;
+};
+
+struct VortexOp {
+    enum class FlagEnum
+    {
+        infinit_axis = 0, // 1
+    };
+    using EFlags = BitFlags<FlagEnum>;
+
+    i32 controlpoint { 0 };
+
+    // anything below this distance receives force multiplied with speed inner.
+    float distanceinner { 500.0f };
+    // anything above this distance receives force multiplied with speed outer.
+    float distanceouter { 650.0f };
+    // amount of force applied to inner ring.
+    float speedinner { 2500.0f };
+    // amount of force applied to outer ring.
+    float speedouter { 0 };
+
+    EFlags flags { 0 };
+
+    // positional offset from the center of the control point.
+    std::array<float, 3> offset { 0.0f, 0.0f, 0.0f };
+
+    // the axis to rotate around.
+    std::array<float, 3> axis { 0.0f, 0.0f, 1.0f };
+
+    void operator()(const ParticleInfo&) const;
+};
+
+struct ControlPointAttractOp {
+    i32 controlpoint { 0 };
+
+    // how strongly the control point attracts or repels.
+    float scale { 512.0f };
+    // the maximum distance between particle and control point where the force takes effect.
+    float threshold { 512.0f };
+
+    // positional offset from the center of the control point.
+    std::array<float, 3> origin { 0.0f, 0.0f, 0.0f };
+
+    void operator()(const ParticleInfo&) const;
+};
+
+using ParticleOperatorOp = std::variant<MovementOp,
+                                        AngularMovementOp,
+                                        FadeOp,
+                                        AlphaFadeOp,
+                                        ColorChangeOp,
+                                        OscillateOp,
+                                        OscillatePositionOp,
+                                        TurbulenceOp,
+                                        VortexOp,
+                                        ControlPointAttractOp>;
+
+} // namespace wallpaper
@@ -0,0 +1,64 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+#include <array>
+#include <span>
+
+namespace wallpaper
+{
+
+// xoshiro128+ on parallel lanes, floats are made a block at a time and handed out one by one.
+// Every subsystem owns one seeded from the system seed and binds it while it steps, so its
+// particles don't depend on which worker ran it.
+class ParticleRandom : NoCopy, NoMove {
+public:
+    explicit ParticleRandom(u64 seed = 0);
+
+    void Seed(u64);
+
+    // [0, 1)
+    float Next();
+    // [min, max)
+    template<typename T>
+    T Uniform(T min, T max) {
+        return min + (max - min) * (T)Next();
+    }
+    double Normal(double mean, double stddev);
+    // a span at once, a burst of spawns takes whole blocks
+    void Fill(std::span<float>, float min, float max);
+
+    // the generator of the calling thread, the bound one or a thread local fallback
+    static ParticleRandom& Current();
+
+    template<typename T>
+    static T get(T min, T max) {
+        return Current().Uniform(min, max);
+    }
+    static double normal(double mean, double stddev) { return Current().Normal(mean, stddev); }
+
+    // makes a generator current on this thread for the scope
+    class Bind : NoCopy, NoMove {
+    public:
+        explicit Bind(ParticleRandom&);
+        ~Bind();
+
+    private:
+        ParticleRandom* m_prev;
+    };
+
+private:
+    constexpr static usize Lanes { 8 };
+    constexpr static usize BlockSize { 256 };
+
+    // fills m_block, the lanes are independent so the loop vectorizes
+    void Refill();
+    void Generate(float* out, usize rounds);
+
+    // s0..s3 of every lane
+    alignas(32) std::array<std::array<u32, Lanes>, 4> m_state {};
+    alignas(32) std::array<float, BlockSize> m_block {};
+    usize m_next { BlockSize };
+};
+
+} // namespace wallpaper
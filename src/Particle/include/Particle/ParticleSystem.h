@@ -1,9 +1,13 @@
 #pragma once
 #include "ParticleEmitter.h"
+#include "ParticleWorkers.h"
+#include "ParticleRandom.h"
 #include "Interface/IParticleRawGener.h"
 #include "Core/NoCopyMove.hpp"
 #include "Core/MapSet.hpp"
 
+#include <algorithm>
+#include <functional>
 #include <memory>
 
 namespace wallpaper
@@ -16,6 +20,7 @@ enum class ParticleAnimationMode
 };
 
 class ParticleSystem;
+struct SceneParticleSim;
 
 class ParticleInstance : NoCopy, NoMove {
 public:
@@ -35,16 +40,21 @@ public:
     bool IsNoLiveParticle() const;
     void SetNoLiveParticle(bool);
 
-    std::span<const Particle> Particles() const;
-    std::vector<Particle>&    ParticlesVec();
+    // dead without particles, waiting in the subsystem's free list
+    bool IsFree() const;
+    void SetFree(bool);
+
+    const ParticleBuffer& Particles() const;
+    ParticleBuffer&       Particles();
 
     BoundedData& GetBoundedData();
 
 private:
-    bool                  m_is_death { false };
-    bool                  m_no_live_particle { false };
-    std::vector<Particle> m_particles;
-    BoundedData           m_bounded_data;
+    bool           m_is_death { false };
+    bool           m_no_live_particle { false };
+    bool           m_free { false };
+    ParticleBuffer m_particles;
+    BoundedData    m_bounded_data;
 };
 
 class ParticleSubSystem : NoCopy, NoMove {
@@ -63,7 +73,10 @@ public:
                       ParticleRawGenSpecOp specOp);
     ~ParticleSubSystem();
 
+    // this subsystem, then its children
     void Emitt();
+    // this subsystem only, children must run after it
+    void EmittSelf();
 
     ParticleInstance* QueryNewInstance();
 
@@ -73,6 +86,8 @@ public:
 
     void AddChild(std::unique_ptr<ParticleSubSystem>&&);
 
+    std::span<const std::unique_ptr<ParticleSubSystem>> Children() const;
+
     std::span<const ParticleControlpoint> Controlpoints() const;
     std::span<ParticleControlpoint>       Controlpoints();
 
@@ -82,7 +97,57 @@ public:
     SpawnType Type() const;
     u32       MaxInstanceCount() const;
 
+    // particles live in view after the last emitt, here or in a child
+    bool Animating() const;
+
+    // call once emitters and operators are added, links a compute simulation to the mesh if
+    // everything the subsystem does has a compute version
+    // the render may take it up, until then and whenever children read the particles the cpu
+    // path runs
+    bool EnableGpuSim(ParticleAnimationMode, float sequencemultiplier);
+
+    // share of emission rate and max count kept however far the system's lod drops
+    void SetLodFloor(float);
+
+    // lo, hi bound the live particles in the subsystem's space, false if nothing of that can
+    // be seen
+    using VisibleTest =
+        std::function<bool(const std::array<float, 3>& lo, const std::array<float, 3>& hi)>;
+    // unseen subsystems advance in coarse steps and build no mesh
+    // subsystems with children or on the gpu are never culled
+    void SetVisibleTest(VisibleTest);
+
+    // the view depth of a point in the subsystem's space is plane . (pos, 1), larger is farther,
+    // false if there is no view to sort for
+    using DepthPlane = std::function<bool(std::array<float, 4>& plane)>;
+    // live particles are drawn back to front each frame, for blending that depends on the order,
+    // set before EnableGpuSim, the gpu doesn't sort
+    void SetDepthSort(DepthPlane);
+
+    // takes the system's next seed, then the children
+    void Reseed();
+
+    // draws from the mesh of head, after head and the subsystems that joined it before, the
+    // head's mesh must hold them all
+    // only for cpu subsystems of head's tree, each must emitt after the one joined before it
+    void JoinBatch(ParticleSubSystem& head);
+    // the subsystem joined to the batch before this one, null outside a batch and for its head
+    ParticleSubSystem* BatchPrev() const;
+
 private:
+    // the live particles are all out of view
+    bool OffScreen() const;
+    // an instance may still spawn, new instances from a parent aside
+    bool CanSpawn() const;
+    // the live particles back to front, empty if they aren't sorted
+    std::span<const ParticleRef> DepthOrder();
+
+    // after an instance dropped its dead particles, moves what pointed at their old slots
+    void Compacted(const ParticleInstance&, std::span<const isize> remap);
+    // advances every instance by step_time, true if any particle lives
+    // first compacts, once per frame, save_positions keeps the state to blend from
+    bool StepSelf(double step_time, bool first, bool save_positions);
+
     ParticleSystem&            m_sys;
     std::shared_ptr<SceneMesh> m_mesh;
     //	std::vector<std::unique_ptr<ParticleEmitter>> m_emiters;
@@ -98,13 +163,53 @@ private:
     u32                  m_maxcount;
     double               m_rate;
     double               m_time;
+    bool                 m_had_live { true };
+    bool                 m_live { false };
+    // nothing lives and nothing can spawn, not stepped until a parent hands out an instance
+    bool m_dormant { false };
+    // fixed steps, time not yet simulated
+    double m_step_accum { 0.0 };
+
+    float       m_lod_floor { 0.25f };
+    VisibleTest m_visible_test;
+    bool        m_culled { false };
+    // culled, time not yet simulated
+    double m_cull_accum { 0.0 };
+
+    // scratch of DepthOrder, kept between frames
+    struct DepthSort {
+        DepthPlane               plane;
+        std::vector<float>       depth;
+        std::vector<u16>         keys;
+        std::vector<ParticleRef> refs;
+        std::vector<ParticleRef> sorted;
+        std::vector<u32>         order;
+        std::vector<u32>         scratch;
+    };
+    DepthSort m_depth_sort;
 
     std::vector<std::unique_ptr<ParticleSubSystem>> m_children;
     std::vector<std::unique_ptr<ParticleInstance>>  m_instances;
+    std::vector<ParticleInstance*>                  m_free_instances;
+    std::vector<isize>                              m_remap;
 
     u32       m_maxcount_instance { 1 };
     double    m_probability { 1.0f };
     SpawnType m_spawn_type { SpawnType::STATIC };
+
+    ParticleRandom m_random;
+
+    std::shared_ptr<SceneParticleSim> m_gpu_sim;
+    // the gpu holds every live particle, false after running on cpu
+    bool m_gpu_synced { false };
+
+    // this subsystem if it leads a batch
+    ParticleSubSystem* m_batch_head { nullptr };
+    ParticleSubSystem* m_batch_prev { nullptr };
+    // on the head, the member joined last
+    ParticleSubSystem* m_batch_last { nullptr };
+    // on the head, the quads the members wrote this frame
+    u32 m_batch_fill { 0 };
 };
 
 class Scene;
@@ -113,7 +218,39 @@ public:
     ParticleSystem(Scene& scene): scene(scene) {};
     ~ParticleSystem() = default;
 
+    // independent subsystems run in parallel
     void Emitt();
+    // any subsystem has particles live in view
+    bool Animating() const;
+
+    struct FixedStep {
+        // seconds, 0 steps with the render
+        double step { 0.0 };
+        u32    max_substeps { 4 };
+    };
+    // hz 0 advances particles by the frame time, else in steps of 1/hz seconds and draws them
+    // blended between the last two steps, a frame runs at most max_substeps
+    void             SetSimRate(u32 hz, u32 max_substeps = 4);
+    const FixedStep& GetFixedStep() const { return m_fixed_step; }
+
+    // subsystems seed their generators from it in load order, a seed repeats what spawns
+    void SetSeed(u64);
+    // seed of the next subsystem
+    u64 NextSeed();
+
+    // call once a frame before emitt, frame_time is the measured time to render a frame and
+    // budget the time it may take
+    // over budget the lod drops and subsystems emit less and keep fewer particles, with
+    // headroom it recovers
+    void  UpdateBudget(double frame_time, double budget);
+    float Lod() const { return m_lod; }
+    // where the budget starts, as a lod an earlier run settled on
+    void SetLod(float v) { m_lod = std::clamp(v, 0.05f, m_lod_cap); }
+    // the lod never recovers past it, for scenes shown small
+    void SetLodCap(float v) {
+        m_lod_cap = std::clamp(v, 0.05f, 1.0f);
+        m_lod     = std::min(m_lod, m_lod_cap);
+    }
 
     // Update control points that have link_mouse flag set
     // mousePos: normalized mouse position (0-1), orthoSize: scene dimensions
@@ -124,5 +261,16 @@ public:
 
     std::vector<std::unique_ptr<ParticleSubSystem>> subsystems;
     std::unique_ptr<IParticleRawGener>              gener;
+
+private:
+    ParticleWorkers m_workers;
+    FixedStep       m_fixed_step;
+
+    u64 m_seed { 0 };
+    u64 m_seed_index { 0 };
+
+    float  m_lod { 1.0f };
+    float  m_lod_cap { 1.0f };
+    double m_budget_timer { 0.0 };
 };
 } // namespace wallpaper
@@ -0,0 +1,38 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace wallpaper
+{
+
+namespace looper
+{
+class TaskGraph;
+}
+class ParticleSubSystem;
+
+// Simulates particle subsystems as frame jobs of the shared job system, the calling thread works
+// too. A subsystem is one task: its instances share emitter, initializer and operator state, so
+// they stay on one thread. Children come after their parent, they read its particles and
+// receive their spawned instances from it.
+class ParticleWorkers : NoCopy, NoMove {
+public:
+    ParticleWorkers();
+    ~ParticleWorkers();
+
+    // blocks until every subsystem and its children emitted
+    void emitt(std::span<const std::unique_ptr<ParticleSubSystem>>);
+
+private:
+    // the graph is kept while the tree stays the same
+    void build(std::span<const std::unique_ptr<ParticleSubSystem>>);
+
+    std::unique_ptr<looper::TaskGraph> m_graph;
+    std::vector<ParticleSubSystem*>    m_built;
+};
+
+} // namespace wallpaper
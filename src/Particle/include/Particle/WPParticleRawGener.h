@@ -10,8 +10,9 @@ public:
     WPParticleRawGener() {};
     virtual ~WPParticleRawGener() {};
 
-    virtual void GenGLData(std::span<const std::unique_ptr<ParticleInstance>>, SceneMesh&,
-                           ParticleRawGenSpecOp&);
+    virtual u32 GenGLData(std::span<const std::unique_ptr<ParticleInstance>>, SceneMesh&,
+                          ParticleRawGenSpecOp&, float blend, std::span<const ParticleRef> order,
+                          u32 first);
 };
 
 } // namespace wallpaper
@@ -1,71 +1,129 @@
 #include "DependencyGraph.hpp"
 #include <algorithm>
-#include <functional>
 #include <fstream>
 #include <cassert>
+#include <cstdio>
 #include "Utils/Logging.h"
 
 using namespace wallpaper::rg;
 
 std::vector<NodeID> DependencyGraph::GetNodeOut(NodeID i) const {
-    const auto&         nexts = m_nodeNext[i];
-    std::vector<NodeID> result(nexts.size());
-    std::transform(nexts.begin(), nexts.end(), result.begin(), [](NodeID i) {
-        return i;
+    std::vector<NodeID> result;
+    ForEachOut(i, [&result](NodeID out) {
+        result.push_back(out);
     });
     return result;
 }
 
 std::vector<NodeID> DependencyGraph::GetNodeIn(NodeID i) const {
     std::vector<NodeID> result;
-    for (NodeID in = 0; in < NodeNum(); in++) {
-        for (NodeID j : m_nodeNext[in]) {
-            if (i == j) result.push_back(in);
-        }
-    }
+    ForEachIn(i, [&result](NodeID in) {
+        result.push_back(in);
+    });
     return result;
 }
 
 NodeID DependencyGraph::AddNode(std::unique_ptr<Node>&& node) {
     m_nodes.emplace_back(std::move(node));
-    m_nodeNext.push_back({});
     Node& n = *(m_nodes.back());
     n.id    = m_nodes.size() - 1;
+    m_out_head.push_back(NoEdge);
+    m_in_head.push_back(NoEdge);
+    // no edges yet, last is as good as anywhere
+    m_pos.push_back(m_order.size());
+    m_order.push_back(n.id);
+    m_visited.push_back(false);
     return n.id;
 }
-void DependencyGraph::Connect(NodeID n1, NodeID n2) { m_nodeNext[n1].insert(n2); }
-
-typedef std::function<std::vector<NodeID>(NodeID)> NextNodeOp;
-typedef std::function<void(NodeID)>                DfsCallbackOp;
-static void Dfs(NodeID id, std::vector<bool>& rec, const NextNodeOp& next,
-                const DfsCallbackOp& dcOp, const DfsCallbackOp& reverseOp) {
-    if (rec[id]) return;
-    rec[id] = true;
-    if (dcOp) dcOp(id);
-    for (const auto& el : next(id)) Dfs(el, rec, next, dcOp, reverseOp);
-    if (reverseOp) reverseOp(id);
+
+void DependencyGraph::Connect(NodeID n1, NodeID n2) {
+    if (! m_edges.insert((u64)n1 << 32 | (u64)n2).second) return;
+    if (n1 == n2 || (m_pos[n1] > m_pos[n2] && ! reorder(n1, n2))) {
+        m_edges.erase((u64)n1 << 32 | (u64)n2);
+        m_cycle = true;
+        LOG_ERROR("edge n%zu->n%zu closes a cycle, left out", n1, n2);
+        return;
+    }
+    m_outs.push_back({ n2, m_out_head[n1] });
+    m_out_head[n1] = (u32)(m_outs.size() - 1);
+    m_ins.push_back({ n1, m_in_head[n2] });
+    m_in_head[n2] = (u32)(m_ins.size() - 1);
 }
 
-std::vector<NodeID> DependencyGraph::TopologicalOrder() const {
-    using namespace std::placeholders;
-    std::vector<NodeID> result;
-    result.reserve(m_nodes.size());
-    std::vector<bool> dfsrec(m_nodes.size(), false);
-    for (usize i = 0; i < dfsrec.size(); i++) {
-        if (dfsrec[i]) continue;
-        Dfs(
-            i,
-            dfsrec,
-            [this](NodeID i) {
-                return GetNodeOut(i);
-            },
-            DfsCallbackOp(),
-            [&](NodeID i) {
-                result.push_back(i);
-            });
+// Pearce and Kelly, only the nodes between the two ends of the edge move: those reached from
+// its head go right after those reaching its tail, in the places all of them had
+bool DependencyGraph::reorder(NodeID from, NodeID to) {
+    const usize lower = m_pos[to], upper = m_pos[from];
+
+    std::vector<NodeID> after, before, stack;
+    auto                search = [&](NodeID start, std::vector<NodeID>& found, bool forward) {
+        stack.push_back(start);
+        m_visited[start] = true;
+        bool cycle { false };
+        while (! stack.empty()) {
+            NodeID id = stack.back();
+            stack.pop_back();
+            found.push_back(id);
+            auto visit = [&](NodeID next) {
+                if (forward && next == from) cycle = true;
+                bool inside = forward ? m_pos[next] < upper : m_pos[next] > lower;
+                if (! inside || m_visited[next]) return;
+                m_visited[next] = true;
+                stack.push_back(next);
+            };
+            if (forward)
+                ForEachOut(id, visit);
+            else
+                ForEachIn(id, visit);
+        }
+        return ! cycle;
+    };
+    bool ok = search(to, after, true);
+    if (ok) search(from, before, false);
+    for (auto id : after) m_visited[id] = false;
+    for (auto id : before) m_visited[id] = false;
+    if (! ok) return false;
+
+    auto byPos = [this](NodeID a, NodeID b) {
+        return m_pos[a] < m_pos[b];
+    };
+    std::sort(after.begin(), after.end(), byPos);
+    std::sort(before.begin(), before.end(), byPos);
+
+    std::vector<usize> slots;
+    slots.reserve(after.size() + before.size());
+    for (auto id : before) slots.push_back(m_pos[id]);
+    for (auto id : after) slots.push_back(m_pos[id]);
+    std::inplace_merge(slots.begin(), slots.begin() + (long)before.size(), slots.end());
+
+    usize i { 0 };
+    for (auto* list : { &before, &after }) {
+        for (auto id : *list) {
+            m_pos[id]          = slots[i++];
+            m_order[m_pos[id]] = id;
+        }
     }
-    std::reverse(result.begin(), result.end());
-    return result;
+    return true;
+}
+
+std::string DependencyGraph::Node::JsonString(std::string_view in) {
+    std::string out;
+    out.reserve(in.size() + 2);
+    out += '"';
+    for (char c : in) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < ' ') {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+    return out;
 }
 
 void DependencyGraph::ToGraphviz(std::string_view path) const {
@@ -83,10 +141,10 @@ node [shape=box]
         output += n->ToGraphviz();
         output += '\n';
     }
-    for (usize i = 0; i < m_nodeNext.size(); i++) {
-        for (const auto& e : m_nodeNext[i]) {
+    for (usize i = 0; i < m_nodes.size(); i++) {
+        ForEachOut(i, [&output, i](NodeID e) {
             output += "n" + std::to_string(i) + "->n" + std::to_string(e) + "\n";
-        }
+        });
     }
 
     output += "}";
@@ -94,3 +152,30 @@ node [shape=box]
     fs << output;
     fs.close();
 };
+
+void DependencyGraph::ToJson(std::string_view path) const {
+    std::ofstream fs;
+    fs.open(std::string(path), std::fstream::out | std::fstream::trunc);
+    if (! fs.is_open()) {
+        LOG_ERROR("can't write graph json to %.*s", (int)path.size(), path.data());
+        return;
+    }
+    std::string output;
+    output.reserve(4096);
+    output += "{\"nodes\":[";
+    for (usize i = 0; i < m_nodes.size(); i++) {
+        if (i > 0) output += ',';
+        output += "\n{" + m_nodes[i]->ToJson() + "}";
+    }
+    output += "\n],\"edges\":[";
+    bool first { true };
+    for (usize i = 0; i < m_nodes.size(); i++) {
+        ForEachOut(i, [&output, &first, i](NodeID e) {
+            if (! first) output += ',';
+            first = false;
+            output += "[" + std::to_string(i) + "," + std::to_string(e) + "]";
+        });
+    }
+    output += "]}\n";
+    fs << output;
+}
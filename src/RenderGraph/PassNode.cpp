@@ -1,5 +1,7 @@
 #include "PassNode.hpp"
 
+#include <cstdio>
+
 using namespace wallpaper::rg;
 
 PassNode* PassNode::addPassNode(DependencyGraph& dg, PassNode::Type type) {
@@ -18,7 +20,39 @@ void PassNode::setName(std::string_view name) {
     m_name = name;
 }
 
+void PassNode::setGpuTime(double ms) { m_gpu_ms = ms; }
+void PassNode::setCpuTime(double ms) { m_cpu_ms = ms; }
+
 
 std::string PassNode::ToGraphviz() const {
-    return GraphID() + "[label=\""+m_name+"\"]";
-}
\ No newline at end of file
+    std::string label = m_name;
+    char        time[48];
+    if (m_gpu_ms >= 0.0) {
+        std::snprintf(time, sizeof(time), "\\ngpu %.3f ms", m_gpu_ms);
+        label += time;
+    }
+    if (m_cpu_ms >= 0.0) {
+        std::snprintf(time, sizeof(time), "\\ncpu %.3f ms", m_cpu_ms);
+        label += time;
+    }
+    if (m_culled) return GraphID() + "[label=\""+label+"\" style=dashed]";
+    return GraphID() + "[label=\""+label+"\"]";
+}
+
+std::string PassNode::ToJson() const {
+    constexpr const char* types[] = { "custom_shader", "copy", "virtual" };
+    std::string out = DependencyGraph::Node::ToJson();
+    out += ",\"kind\":\"pass\",\"name\":" + JsonString(m_name);
+    out += ",\"type\":\"" + std::string(types[(int)m_type]) + "\"";
+    out += std::string(",\"culled\":") + (m_culled ? "true" : "false");
+    char time[48];
+    if (m_gpu_ms >= 0.0) {
+        std::snprintf(time, sizeof(time), ",\"gpu_ms\":%.4f", m_gpu_ms);
+        out += time;
+    }
+    if (m_cpu_ms >= 0.0) {
+        std::snprintf(time, sizeof(time), ",\"cpu_ms\":%.4f", m_cpu_ms);
+        out += time;
+    }
+    return out;
+}
@@ -4,6 +4,7 @@
 #include "RenderGraph.hpp"
 
 #include "Utils/Logging.h"
+#include "Utils/Hash.h"
 #include "Pass.hpp"
 
 using namespace wallpaper::rg;
@@ -31,11 +32,18 @@ Pass* RenderGraph::getPass(NodeID id) const {
     return nullptr;
 }
 
+TexNode* RenderGraph::findTexNode(std::string_view key) const {
+    auto iter = m_key_texnode.find(key);
+    if(iter == m_key_texnode.end()) return nullptr;
+    return getTexNode(iter->second);
+}
+
 std::vector<NodeID> RenderGraph::topologicalOrder() const {
-  std::vector<NodeID> allnodes = m_dg.TopologicalOrder();
+  const auto& allnodes = m_dg.TopologicalOrder();
   std::vector<NodeID> passnodes;
   std::copy_if(allnodes.begin(), allnodes.end(), std::back_inserter(passnodes), [this](auto item) {
-      return exists(m_set_passnode, item) && !exists(m_set_vitrual_passnode, item);
+      return exists(m_set_passnode, item) && !exists(m_set_vitrual_passnode, item) &&
+             !getPassNode(item)->culled();
   });
   return passnodes;
 }
@@ -44,6 +52,14 @@ void RenderGraph::markPassNode(NodeID id) {
     m_set_passnode.insert(id);
 }
 
+std::vector<TexNode*> RenderGraph::texNodes() const {
+    std::vector<TexNode*> texs;
+    for (NodeID id = 0; id < m_dg.NodeNum(); id++) {
+        if (! isPassNode(id)) texs.push_back(static_cast<TexNode*>(m_dg.GetNode(id)));
+    }
+    return texs;
+}
+
 bool RenderGraph::isPassNode(NodeID id) const {
     return exists(m_set_passnode, id);
 }
@@ -109,15 +125,16 @@ void RenderGraphBuilder::write(TexNode* node) {
     // after all old reader
     if(node->version() > 0) {
         auto* old = node->preVer();
-        const auto& outs = m_rg.m_dg.GetNodeOut(old->ID());
+        bool read { false };
         // after reader
-        for(auto id:outs) {
+        m_rg.m_dg.ForEachOut(old->ID(), [this, &read](NodeID id) {
+            read = true;
             if(m_rg.isPassNode(id)) {
                 m_rg.m_dg.Connect(id, m_passnode_wip->ID());
             }
-        }
+        });
         // after old tex if no old reader
-        if(outs.empty())
+        if(! read)
             m_rg.m_dg.Connect(old->ID(), m_passnode_wip->ID());
     }
     m_rg.m_dg.Connect(m_passnode_wip->ID(), node->ID());
@@ -130,35 +147,101 @@ const PassNode& RenderGraphBuilder::workPassNode() const {
 }
 
 std::vector<std::vector<TexNode*>> RenderGraph::getLastReadTexs(std::span<const NodeID> nodes) const {
-    std::vector<std::vector<TexNode*>> res;
-    std::vector<Set<NodeID>> nodes_ids;
-    // get in
-    std::transform(nodes.begin(), nodes.end(), std::back_inserter(nodes_ids), [this, &nodes_ids](auto& n) {
-        Set<NodeID> sets;
-        const auto& ids = m_dg.GetNodeIn(n);
-        for(const auto& id:ids) sets.insert(id);
-        return sets;
+    // the last of the nodes reading each one, then each node's share of them
+    constexpr usize none { ~(usize)0 };
+    std::vector<usize> last(m_dg.NodeNum(), none);
+    for (usize i = 0; i < nodes.size(); i++) {
+        m_dg.ForEachIn(nodes[i], [&last, i](NodeID in) {
+            last[in] = i;
+        });
+    }
+    std::vector<std::vector<TexNode*>> res(nodes.size());
+    for (usize i = 0; i < nodes.size(); i++) {
+        m_dg.ForEachIn(nodes[i], [this, &last, &res, i](NodeID in) {
+            if (last[in] != i) return;
+            if (auto* tex = getTexNode(in); tex != nullptr) res[i].push_back(tex);
+        });
+    }
+    return res;
+}
+
+std::vector<TexNode*> RenderGraph::getPassReadTexs(NodeID id) const {
+    std::vector<TexNode*> texs;
+    m_dg.ForEachIn(id, [this, &texs](NodeID in) {
+        auto* tex = getTexNode(in);
+        if(tex != nullptr) texs.push_back(tex);
     });
-    // get last in
-    {
-        Set<NodeID> sets;
-        std::for_each(std::rbegin(nodes_ids), std::rend(nodes_ids), [&sets](auto& ids) {
-            std::vector<NodeID> copy {ids.begin(), ids.end()};
-            std::for_each(copy.begin(), copy.end(), [&sets, &ids](auto& id) { 
-                if(exists(sets, id))
-                    ids.erase(id);
-                else sets.insert(id);
-            });
+    return texs;
+}
+
+std::vector<TexNode*> RenderGraph::getPassWriteTexs(NodeID id) const {
+    std::vector<TexNode*> texs;
+    m_dg.ForEachOut(id, [this, &texs](NodeID out) {
+        auto* tex = getTexNode(out);
+        if(tex != nullptr) texs.push_back(tex);
+    });
+    return texs;
+}
+
+size_t RenderGraph::cull(std::span<const std::string_view> outputs) {
+    const usize num = m_dg.NodeNum();
+    std::vector<bool>   live(num, false);
+    std::vector<NodeID> work;
+    auto                mark = [&live, &work](NodeID id) {
+        if (live[id]) return;
+        live[id] = true;
+        work.push_back(id);
+    };
+    auto markLast = [this, &mark](std::string_view key) {
+        if (auto* tex = findTexNode(key); tex != nullptr) mark(tex->ID());
+    };
+    for (auto key : outputs) markLast(key);
+
+    while (! work.empty()) {
+        NodeID id = work.back();
+        work.pop_back();
+        if (auto* tex = getTexNode(id); tex != nullptr) {
+            if (tex->writer() != nullptr) mark(tex->writer()->ID());
+            // a writer draws over what the old version holds, unless it hides all of it
+            if (tex->preVer() != nullptr && ! tex->coversPreVer()) mark(tex->preVer()->ID());
+            continue;
+        }
+        // only the texs read, edges from other passes just order writes after reads
+        m_dg.ForEachIn(id, [&](NodeID in) {
+            auto* tex = getTexNode(in);
+            if (tex == nullptr) return;
+            mark(in);
+            // read before written, that's what the last writer left last frame
+            if (tex->writer() != nullptr && tex->writer()->type() == PassNode::Type::Virtual)
+                markLast(tex->key());
         });
     }
-    // to tex node
-    std::transform(nodes_ids.begin(), nodes_ids.end(), std::back_inserter(res), [this](auto& ids) {
-        std::vector<TexNode*> texs;
-        for(auto& id:ids) {
-            auto* tex = getTexNode(id);
-            if(tex != nullptr) texs.push_back(tex);
+
+    usize culled { 0 };
+    for (auto id : m_set_passnode) {
+        if (live[id] || exists(m_set_vitrual_passnode, id)) continue;
+        getPassNode(id)->setCulled(true);
+        culled++;
+    }
+    return culled;
+}
+
+size_t RenderGraph::structureHash() const {
+    size_t seed { 0 };
+    for (NodeID id = 0; id < m_dg.NodeNum(); id++) {
+        if (auto* pass = getPassNode(id); pass != nullptr) {
+            utils::hash_combine(seed, (int)pass->type());
+            utils::hash_combine(seed, pass->name());
+            utils::hash_combine(seed, pass->culled());
+        } else if (auto* tex = getTexNode(id); tex != nullptr) {
+            utils::hash_combine(seed, tex->key());
+            utils::hash_combine(seed, tex->version());
         }
-        return texs;
-    });
-    return res; 
+        // the out set has no fixed order
+        auto outs = m_dg.GetNodeOut(id);
+        std::sort(outs.begin(), outs.end());
+        utils::hash_combine(seed, outs.size());
+        for (auto out : outs) utils::hash_combine(seed, out);
+    }
+    return seed;
 }
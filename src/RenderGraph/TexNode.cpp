@@ -1,6 +1,8 @@
 #include "TexNode.hpp"
 #include "PassNode.hpp"
 
+#include <cstdio>
+
 using namespace wallpaper::rg;
 
 TexNode* TexNode::addTexNode(DependencyGraph& dg, const Desc& desc) {
@@ -54,6 +56,37 @@ void TexNode::setWriter(PassNode* w) {
 }
 
 
+void TexNode::setInfo(Info v) {
+    m_info = std::move(v);
+}
+
+
 std::string TexNode::ToGraphviz() const {
-    return GraphID() + "[label=\"" +m_key+ " v:" + std::to_string(m_version) + "\" shape=ellipse]";
-}
\ No newline at end of file
+    std::string label = m_key + " v:" + std::to_string(m_version);
+    if (m_info) {
+        char buf[96];
+        std::snprintf(buf, sizeof(buf), "\\n%dx%d %s %.1f KiB", m_info->width, m_info->height,
+                      m_info->format.c_str(), (double)m_info->bytes / 1024.0);
+        label += buf;
+        if (m_info->image >= 0) label += "\\nimage " + std::to_string(m_info->image);
+        if (m_info->alias_group >= 0)
+            label += " alias group " + std::to_string(m_info->alias_group);
+    }
+    return GraphID() + "[label=\"" + label + "\" shape=ellipse]";
+}
+
+std::string TexNode::ToJson() const {
+    std::string out = DependencyGraph::Node::ToJson();
+    out += ",\"kind\":\"tex\",\"key\":" + JsonString(m_key);
+    out += ",\"version\":" + std::to_string(m_version);
+    out += std::string(",\"imported\":") + (m_type == TexType::Imported ? "true" : "false");
+    if (m_info) {
+        out += ",\"width\":" + std::to_string(m_info->width);
+        out += ",\"height\":" + std::to_string(m_info->height);
+        out += ",\"format\":" + JsonString(m_info->format);
+        out += ",\"bytes\":" + std::to_string(m_info->bytes);
+        out += ",\"image\":" + std::to_string(m_info->image);
+        out += ",\"alias_group\":" + std::to_string(m_info->alias_group);
+    }
+    return out;
+}
@@ -32,6 +32,12 @@ public:
             auto sid = std::to_string(id);
             return "n" + sid + "[label=" + sid + "]";
         };
+        // the members of a json object, without braces
+        virtual std::string ToJson() const { return "\"id\":" + std::to_string(id); }
+
+    protected:
+        // quoted and escaped
+        static std::string JsonString(std::string_view);
 
     private:
         NodeID id;
@@ -40,38 +46,74 @@ public:
     DependencyGraph()  = default;
     ~DependencyGraph() = default;
 
-    DependencyGraph(DependencyGraph&& o)
-        : m_nodeNext(std::move(o.m_nodeNext)), m_nodes(std::move(o.m_nodes)) {}
+    DependencyGraph(DependencyGraph&& o) { *this = std::move(o); }
     DependencyGraph& operator=(DependencyGraph&& o) {
-        m_nodeNext = std::move(o.m_nodeNext);
         m_nodes    = std::move(o.m_nodes);
+        m_out_head = std::move(o.m_out_head);
+        m_in_head  = std::move(o.m_in_head);
+        m_outs     = std::move(o.m_outs);
+        m_ins      = std::move(o.m_ins);
+        m_edges    = std::move(o.m_edges);
+        m_order    = std::move(o.m_order);
+        m_pos      = std::move(o.m_pos);
+        m_visited  = std::move(o.m_visited);
+        m_cycle    = o.m_cycle;
         return *this;
     }
 
     size_t NodeNum() const { return m_nodes.size(); }
-    size_t EdgeNum() const {
-        return std::accumulate(
-            m_nodeNext.begin(), m_nodeNext.end(), 0u, [](size_t sum, const auto& v) {
-                return sum + v.size();
-            });
-    }
+    size_t EdgeNum() const { return m_outs.size(); }
     // const Node& GetNode(NodeID i) const { return *m_nodes[i]; }
     Node* GetNode(NodeID i) const { return m_nodes[i].get(); }
 
     std::vector<NodeID> GetNodeOut(NodeID) const;
     std::vector<NodeID> GetNodeIn(NodeID) const;
+    // the same without a vector, newest edge first
+    template<typename F>
+    void ForEachOut(NodeID i, F&& f) const {
+        for (u32 e = m_out_head[i]; e != NoEdge; e = m_outs[e].next) f(m_outs[e].node);
+    }
+    template<typename F>
+    void ForEachIn(NodeID i, F&& f) const {
+        for (u32 e = m_in_head[i]; e != NoEdge; e = m_ins[e].next) f(m_ins[e].node);
+    }
 
     NodeID AddNode(std::unique_ptr<Node>&&);
-    void   Connect(NodeID, NodeID);
+    // an edge closing a cycle is left out
+    void Connect(NodeID, NodeID);
 
-    bool                HasCycle() const;
-    std::vector<NodeID> TopologicalOrder() const;
+    bool HasCycle() const { return m_cycle; }
+    // kept while nodes and edges are added, nodes come in the order added unless an edge says
+    // otherwise
+    const std::vector<NodeID>& TopologicalOrder() const { return m_order; }
 
     void ToGraphviz(std::string_view) const;
+    // nodes and edges, for tools reading dumps
+    void ToJson(std::string_view) const;
 
 private:
-    std::vector<std::unordered_set<NodeID>> m_nodeNext;
-    std::vector<std::unique_ptr<Node>>      m_nodes;
+    static constexpr u32 NoEdge { ~0u };
+    // edges of a node chained through one array, newest first
+    struct Edge {
+        NodeID node;
+        u32    next;
+    };
+    // false if the edge would close a cycle
+    bool reorder(NodeID from, NodeID to);
+
+    std::vector<std::unique_ptr<Node>> m_nodes;
+    std::vector<u32>                   m_out_head;
+    std::vector<u32>                   m_in_head;
+    std::vector<Edge>                  m_outs;
+    std::vector<Edge>                  m_ins;
+    std::unordered_set<u64>            m_edges;
+
+    std::vector<NodeID> m_order;
+    // of each node in the order
+    std::vector<usize> m_pos;
+    // of the search in reorder, all false between calls
+    std::vector<bool> m_visited;
+    bool              m_cycle { false };
 };
 } // namespace rg
 } // namespace wallpaper
@@ -21,13 +21,24 @@ public:
     std::string_view name() const;
 
     void setName(std::string_view);
+    // measured gpu time, shown in the graphviz label when set
+    void setGpuTime(double ms);
+    // cpu time recording it took, the same
+    void setCpuTime(double ms);
+    // nothing reaching the outputs reads what it writes, it isn't run
+    bool culled() const { return m_culled; }
+    void setCulled(bool v) { m_culled = v; }
 
     std::string ToGraphviz() const override; 
+    std::string ToJson() const override;
 
 
 private:
     Type m_type;
     std::string m_name { "unknown pass" };
+    double      m_gpu_ms { -1.0 };
+    double      m_cpu_ms { -1.0 };
+    bool        m_culled { false };
 };
 }
 } 
@@ -39,12 +39,30 @@ public:
     PassNode* getPassNode(NodeID) const;
     TexNode*  getTexNode(NodeID) const;
     Pass*     getPass(NodeID) const;
+    // the last version of a key, null if nothing used it
+    TexNode* findTexNode(std::string_view key) const;
 
     // all render pass
     std::vector<NodeID>                topologicalOrder() const;
     std::vector<std::vector<TexNode*>> getLastReadTexs(std::span<const NodeID>) const;
+    // tex nodes connected to a pass node, read includes the old version a writer replaces
+    std::vector<TexNode*> getPassReadTexs(NodeID) const;
+    std::vector<TexNode*> getPassWriteTexs(NodeID) const;
+    // every version of every key, in the order they were added
+    std::vector<TexNode*> texNodes() const;
+
+    // Marks culled the passes whose writes nothing reaching the outputs reads, those are left out
+    // of topologicalOrder(). Outputs are tex keys read once the graph ran, the last version of each
+    // is kept, so are the versions before those drawn over only partly. Returns the number culled.
+    size_t cull(std::span<const std::string_view> outputs);
+
+    // Same for graphs a scene built again with nothing but values changed, from the passes, the
+    // tex versions and the edges between them
+    size_t structureHash() const;
 
     void ToGraphviz(std::string_view path) const { m_dg.ToGraphviz(path); };
+    // nodes with what they were annotated with, and edges as pairs of ids
+    void ToJson(std::string_view path) const { m_dg.ToJson(path); };
 
     template<typename CB>
     bool afterBuild(NodeID pass_node_id, CB&& callback) {
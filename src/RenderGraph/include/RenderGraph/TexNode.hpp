@@ -1,5 +1,6 @@
 #pragma once
 #include "DependencyGraph.hpp"
+#include <optional>
 #include <string>
 
 namespace wallpaper
@@ -21,6 +22,16 @@ public:
         std::string key;
         TexType type;
     };
+    // what the renderer made of it, shown in dumps when set
+    struct Info {
+        i32         width { 0 };
+        i32         height { 0 };
+        std::string format;
+        u64         bytes { 0 };
+        // texs of the same image share it, images of the same alias group share memory
+        i64 image { -1 };
+        i64 alias_group { -1 };
+    };
     static TexNode* addTexNode(DependencyGraph& dg, const Desc& type);
     static TexNode* addNewVersion(DependencyGraph& dg, TexNode* pre);
 
@@ -37,8 +48,14 @@ public:
     void setName(std::string_view);
     void setKey(std::string_view);
     void setWriter(PassNode*);
+    // the writer draws over all of the old version, what that held is never seen
+    void setCoversPreVer(bool v) { m_covers_pre_ver = v; }
+    bool coversPreVer() const { return m_covers_pre_ver; }
+    void setInfo(Info);
+    const std::optional<Info>& info() const { return m_info; }
 
     std::string ToGraphviz() const override; 
+    std::string ToJson() const override;
 private:
     friend class RenderGraphBuilder;
     TexType m_type;
@@ -49,6 +66,9 @@ private:
     TexNode*  m_pre    {nullptr};
     TexNode*  m_next    {nullptr};
     PassNode* m_writer  {nullptr};
+    bool      m_covers_pre_ver { false };
+
+    std::optional<Info> m_info;
 };
 }
 } 
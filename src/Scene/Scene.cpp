@@ -8,7 +8,9 @@
 namespace wallpaper 
 {
 
-Scene::Scene(): sceneGraph(std::make_shared<SceneNode>()) ,paritileSys(std::make_unique<ParticleSystem>(*this)) {}
+Scene::Scene()
+    : sceneGraph(arena.MakeShared<SceneNode>()),
+      paritileSys(std::make_unique<ParticleSystem>(*this)) {}
 Scene::~Scene() = default;
 
 }
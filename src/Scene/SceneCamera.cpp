@@ -55,6 +55,7 @@ void SceneCamera::CalculateViewProjectionMatrix() {
 
 void SceneCamera::Update() {
 	CalculateViewProjectionMatrix();
+	m_generation++;
 }
 
 
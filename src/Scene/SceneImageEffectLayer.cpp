@@ -63,7 +63,8 @@ void SceneImageEffectLayer::ResolveEffect(const SceneMesh& default_mesh,
         auto& mesh          = *(last_output->sceneNode->Mesh());
         auto& material      = *mesh.Material();
         {
-            material.blenmode = m_final_blend;
+            material.blenmode    = m_final_blend;
+            material.covers_view = m_final_covers_view;
             last_output->sceneNode->SetCamera(std::string());
             last_output->sceneNode->CopyTrans(*m_final_node);
             mesh.ChangeMeshDataFrom(*m_final_mesh);
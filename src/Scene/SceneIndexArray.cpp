@@ -4,9 +4,11 @@
 
 using namespace wallpaper;
 
-SceneIndexArray::SceneIndexArray(std::size_t indexCount): m_size(0), m_capacity(indexCount * 3) {
+SceneIndexArray::SceneIndexArray(std::size_t indexCount, bool wide)
+    : m_size(0), m_capacity(indexCount * (wide ? 6 : 3)), m_wide(wide) {
     m_pData = new uint32_t[m_capacity];
     std::memset(m_pData, 0, m_capacity * sizeof(uint32_t));
+    m_held.set(CapacitySizeof());
 }
 SceneIndexArray::SceneIndexArray(std::span<const uint32_t> data)
     : m_size(data.size()), m_capacity(m_size) {
@@ -14,13 +16,16 @@ SceneIndexArray::SceneIndexArray(std::span<const uint32_t> data)
     uint32_t* newdata  = new uint32_t[dataSize];
     std::memcpy(newdata, &data[0], DataSizeOf());
     m_pData = newdata;
+    m_held.set(CapacitySizeof());
 };
 SceneIndexArray::SceneIndexArray(SceneIndexArray&& o) noexcept
     : m_pData(std::exchange(o.m_pData, nullptr)),
       m_size(o.m_size),
       m_capacity(o.m_capacity),
       m_render_size(o.m_render_size),
-      m_id(o.m_id) {}
+      m_id(o.m_id),
+      m_wide(o.m_wide),
+      m_held(std::move(o.m_held)) {}
 
 SceneIndexArray::~SceneIndexArray() {
     if (m_pData != nullptr) delete[] m_pData;
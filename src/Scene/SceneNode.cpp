@@ -19,6 +19,10 @@ Matrix4d SceneNode::GetLocalTrans() const {
 }
 
 void SceneNode::UpdateTrans() {
+    if (m_table) {
+        m_table->Propagate();
+        return;
+    }
     if (! m_dirty) return;
     m_dirty = false;
 
@@ -28,13 +32,19 @@ void SceneNode::UpdateTrans() {
     {
         Affine3d trans = Affine3d::Identity();
         if (m_parent) {
-            trans *= m_parent->ModelTrans();
+            trans *= m_parent->ModelTrans().cast<double>();
         }
-        m_trans = (trans * GetLocalTrans()).matrix();
+        m_trans = (trans * GetLocalTrans()).matrix().cast<float>();
     }
+    m_trans_generation++;
 }
 
 void SceneNode::MarkTransDirty() {
+    // the table takes the children along as it propagates
+    if (m_table) {
+        m_table->MarkDirty(m_slot);
+        return;
+    }
     if (! m_dirty) {
         m_dirty = true;
         for (auto& child : m_children) {
@@ -0,0 +1,76 @@
+#include "SceneNodeTable.h"
+#include "SceneNode.h"
+
+using namespace wallpaper;
+
+SceneNodeTable::~SceneNodeTable() { Detach(); }
+
+void SceneNodeTable::Detach() {
+    for (auto* node : m_nodes) {
+        node->m_table = nullptr;
+        node->m_slot  = SceneNode::NoIndex;
+    }
+}
+
+void SceneNodeTable::Clear() {
+    Detach();
+    m_root      = nullptr;
+    m_stale     = false;
+    m_any_dirty = false;
+    m_nodes.clear();
+    m_parents.clear();
+    m_meshes.clear();
+    m_world.clear();
+    m_dirty.clear();
+}
+
+void SceneNodeTable::Build(SceneNode& root) {
+    Clear();
+    m_root = &root;
+
+    // explicit stack, children pushed in reverse keep the list order
+    std::vector<std::pair<SceneNode*, u32>> stack { { &root, NoParent } };
+    while (! stack.empty()) {
+        auto [node, parent] = stack.back();
+        stack.pop_back();
+
+        u32 slot = (u32)m_nodes.size();
+        m_nodes.push_back(node);
+        m_parents.push_back(parent);
+        m_meshes.push_back(node->Mesh());
+
+        auto& children = node->GetChildren();
+        for (auto it = children.rbegin(); it != children.rend(); it++)
+            stack.emplace_back(it->get(), slot);
+    }
+
+    m_world.assign(m_nodes.size(), Eigen::Matrix4f::Identity());
+    m_dirty.assign(m_nodes.size(), 1);
+    m_any_dirty = true;
+    for (u32 i = 0; i < m_nodes.size(); i++) {
+        m_nodes[i]->m_table = this;
+        m_nodes[i]->m_slot  = i;
+    }
+}
+
+std::span<SceneNode* const> SceneNodeTable::Nodes() {
+    if (m_stale) Build(*m_root);
+    return m_nodes;
+}
+
+void SceneNodeTable::Propagate() {
+    if (m_stale) Build(*m_root);
+    if (! m_any_dirty) return;
+    m_any_dirty = false;
+
+    for (usize i = 0; i < m_nodes.size(); i++) {
+        u32 parent = m_parents[i];
+        if (parent != NoParent && m_dirty[parent]) m_dirty[i] = 1;
+        if (! m_dirty[i]) continue;
+
+        Eigen::Matrix4f local = m_nodes[i]->GetLocalTrans().cast<float>();
+        m_world[i] = parent == NoParent ? local : Eigen::Matrix4f(m_world[parent] * local);
+        m_nodes[i]->m_trans_generation++;
+    }
+    std::fill(m_dirty.begin(), m_dirty.end(), 0);
+}
@@ -0,0 +1,163 @@
+#include "ScenePatch.h"
+#include "Scene.h"
+
+#include "SpecTexs.hpp"
+#include "Core/StringHelper.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace wallpaper;
+
+namespace
+{
+
+struct NodePair {
+    SceneNode* live;
+    SceneNode* fresh;
+    // a node of an image effect layer, its camera, blending, mesh and transform are set when
+    // the graph resolves the layer
+    bool effect;
+};
+
+template<typename T>
+bool SameKeys(const T& a, const T& b) {
+    if (a.size() != b.size()) return false;
+    return std::all_of(a.begin(), a.end(), [&b](auto& el) {
+        return b.count(el.first) != 0;
+    });
+}
+
+bool SameShader(const SceneShader* a, const SceneShader* b) {
+    if (a == nullptr || b == nullptr) return a == b;
+    return a->codes == b->codes && a->spec_constants == b->spec_constants;
+}
+
+// effect pingpong names are replaced in the live one once its layer is resolved
+bool SameTextures(const std::vector<std::string>& live, const std::vector<std::string>& fresh) {
+    if (live.size() != fresh.size()) return false;
+    for (usize i = 0; i < live.size(); i++) {
+        if (sstart_with(fresh[i], WE_EFFECT_PPONG_PREFIX)) continue;
+        if (live[i] != fresh[i]) return false;
+    }
+    return true;
+}
+
+bool SameMesh(const SceneMesh& a, const SceneMesh& b) {
+    if (a.Dynamic() != b.Dynamic() || a.VertexCount() != b.VertexCount() ||
+        a.IndexCount() != b.IndexCount())
+        return false;
+    // dynamic vertices change on their own
+    if (a.Dynamic()) return true;
+    for (usize i = 0; i < a.VertexCount(); i++) {
+        const auto& va = a.GetVertexArray(i);
+        const auto& vb = b.GetVertexArray(i);
+        if (va.DataSizeOf() != vb.DataSizeOf()) return false;
+        // packed attributes are bits, not floats
+        if (std::memcmp(va.Data(), vb.Data(), va.DataSizeOf()) != 0) return false;
+    }
+    return true;
+}
+
+bool SameValues(const ShaderValues& a, const ShaderValues& b) {
+    return std::equal(
+        a.begin(), a.end(), b.begin(), b.end(), [](const auto& x, const auto& y) {
+            return x.first == y.first && x.second.size() == y.second.size() &&
+                   std::equal(x.second.data(), x.second.data() + x.second.size(), y.second.data());
+        });
+}
+
+bool CollectLayer(Scene& live, Scene& fresh, SceneImageEffectLayer& a, SceneImageEffectLayer& b,
+                  std::vector<NodePair>& pairs);
+
+// pairs up the nodes of both trees, false at the first difference that can't be patched
+bool CollectNode(Scene& live, Scene& fresh, SceneNode& a, SceneNode& b, bool effect,
+                 std::vector<NodePair>& pairs) {
+    if (a.HasMaterial() != b.HasMaterial()) return false;
+    if (a.HasMaterial()) {
+        const auto& ma = *a.Mesh()->Material();
+        const auto& mb = *b.Mesh()->Material();
+        if (ma.name != mb.name || ma.hasSprite != mb.hasSprite || ma.defines != mb.defines)
+            return false;
+        if (! SameShader(ma.customShader.shader.get(), mb.customShader.shader.get())) return false;
+        if (! SameTextures(ma.textures, mb.textures)) return false;
+        if (! effect && (ma.blenmode != mb.blenmode || ! SameMesh(*a.Mesh(), *b.Mesh())))
+            return false;
+    } else if ((a.Mesh() == nullptr) != (b.Mesh() == nullptr)) {
+        return false;
+    }
+    pairs.push_back({ &a, &b, effect });
+
+    if (! effect) {
+        if (a.Camera() != b.Camera()) return false;
+        if (! a.Camera().empty()) {
+            auto ca = live.cameras.find(a.Camera());
+            auto cb = fresh.cameras.find(b.Camera());
+            if (ca == live.cameras.end() || cb == fresh.cameras.end()) return false;
+            if (ca->second->HasImgEffect() != cb->second->HasImgEffect()) return false;
+            if (ca->second->HasImgEffect() &&
+                ! CollectLayer(
+                    live, fresh, *ca->second->GetImgEffect(), *cb->second->GetImgEffect(), pairs))
+                return false;
+        }
+    }
+
+    auto& ka = a.GetChildren();
+    auto& kb = b.GetChildren();
+    if (ka.size() != kb.size()) return false;
+    for (auto ia = ka.begin(), ib = kb.begin(); ia != ka.end(); ia++, ib++) {
+        if (! CollectNode(live, fresh, **ia, **ib, effect, pairs)) return false;
+    }
+    return true;
+}
+
+bool CollectLayer(Scene& live, Scene& fresh, SceneImageEffectLayer& a, SceneImageEffectLayer& b,
+                  std::vector<NodePair>& pairs) {
+    if (a.EffectCount() != b.EffectCount()) return false;
+    for (usize i = 0; i < a.EffectCount(); i++) {
+        auto& ea = *a.GetEffect(i);
+        auto& eb = *b.GetEffect(i);
+        if (ea.nodes.size() != eb.nodes.size() || ea.commands.size() != eb.commands.size())
+            return false;
+        for (auto na = ea.nodes.begin(), nb = eb.nodes.begin(); na != ea.nodes.end(); na++, nb++) {
+            if (! CollectNode(live, fresh, *na->sceneNode, *nb->sceneNode, true, pairs))
+                return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool wallpaper::PatchScene(Scene& live, Scene& fresh, usize& patched) {
+    patched = 0;
+    if (! SameKeys(live.textures, fresh.textures) ||
+        ! SameKeys(live.renderTargets, fresh.renderTargets) ||
+        ! SameKeys(live.cameras, fresh.cameras) || live.lights.size() != fresh.lights.size())
+        return false;
+    if (live.clearColor != fresh.clearColor || live.ortho[0] != fresh.ortho[0] ||
+        live.ortho[1] != fresh.ortho[1])
+        return false;
+
+    // all compared first, a scene is either patched whole or not at all
+    std::vector<NodePair> pairs;
+    if (! CollectNode(live, fresh, *live.sceneGraph, *fresh.sceneGraph, false, pairs))
+        return false;
+
+    for (auto& [a, b, effect] : pairs) {
+        if (a->HasMaterial()) {
+            auto&       values       = a->Mesh()->Material()->customShader.constValues;
+            const auto& fresh_values = b->Mesh()->Material()->customShader.constValues;
+            if (! SameValues(values, fresh_values)) {
+                values = fresh_values;
+                patched++;
+            }
+        }
+        if (! effect && a->GetLocalTrans() != b->GetLocalTrans()) {
+            a->CopyTrans(*b);
+            patched++;
+        }
+    }
+    return true;
+}
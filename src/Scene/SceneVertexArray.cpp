@@ -4,6 +4,7 @@
 #include <utility>
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 
 using namespace wallpaper;
 
@@ -16,15 +17,81 @@ uint8_t SceneVertexArray::TypeCount(VertexType t) {
     case VertexType::FLOAT3:
     case VertexType::UINT3: return 3;
     case VertexType::FLOAT4:
-    case VertexType::UINT4: return 4;
+    case VertexType::UINT4:
+    case VertexType::HALF4:
+    case VertexType::UNORM8X4:
+    case VertexType::SNORM16X4: return 4;
+    case VertexType::SNORM16X2: return 2;
     }
     return 1;
 }
 
+uint8_t SceneVertexArray::TypeSize(VertexType t) {
+    switch (t) {
+    case VertexType::UNORM8X4:
+    case VertexType::SNORM16X2: return 1;
+    case VertexType::HALF4:
+    case VertexType::SNORM16X4: return 2;
+    default: return TypeCount(t);
+    }
+}
+
 uint8_t SceneVertexArray::RealAttributeSize(const SceneVertexArray::SceneVertexAttribute& attr) {
+    if (Packed(attr.type)) return TypeSize(attr.type);
     return attr.padding ? 4 : TypeCount(attr.type);
 }
 
+u16 SceneVertexArray::HalfOf(float f) noexcept {
+    u32 x;
+    std::memcpy(&x, &f, sizeof(x));
+    const u32 sign = (x >> 16) & 0x8000u;
+    x &= 0x7fffffffu;
+    // nan stays nan
+    if (x > 0x7f800000u) return (u16)(sign | 0x7e00u);
+    // past the largest half once rounded
+    if (x >= 0x477ff000u) return (u16)(sign | 0x7c00u);
+    // below the smallest normal half, subnormal or 0
+    if (x < 0x38800000u) {
+        if (x < 0x33000000u) return (u16)sign;
+        const u32 shift = 126u - (x >> 23);
+        const u32 m     = (x & 0x7fffffu) | 0x800000u;
+        u32       h     = m >> shift;
+        const u32 rest = m & ((1u << shift) - 1u), tie = 1u << (shift - 1u);
+        if (rest > tie || (rest == tie && (h & 1u))) h++;
+        return (u16)(sign | h);
+    }
+    // the exponent rebased, a carry out of the mantissa moves it up
+    u32       h    = (x - 0x38000000u) >> 13;
+    const u32 rest = x & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (h & 1u))) h++;
+    return (u16)(sign | h);
+}
+
+std::array<u32, 2> SceneVertexArray::Pack(VertexType t, std::span<const float> v) noexcept {
+    auto at = [v](usize i) {
+        return i < v.size() ? v[i] : 0.0f;
+    };
+    auto norm = [](float x, float lo, float scale) {
+        return (i32)std::lround(std::clamp(x, lo, 1.0f) * scale);
+    };
+    std::array<u32, 2> words {};
+    switch (t) {
+    case VertexType::HALF4:
+        for (usize i = 0; i < 4; i++) words[i / 2] |= (u32)HalfOf(at(i)) << (16 * (i % 2));
+        break;
+    case VertexType::UNORM8X4:
+        for (usize i = 0; i < 4; i++) words[0] |= (u32)norm(at(i), 0.0f, 255.0f) << (8 * i);
+        break;
+    case VertexType::SNORM16X2:
+    case VertexType::SNORM16X4:
+        for (usize i = 0; i < TypeCount(t); i++)
+            words[i / 2] |= (u32)(u16)norm(at(i), -1.0f, 32767.0f) << (16 * (i % 2));
+        break;
+    default: break;
+    }
+    return words;
+}
+
 SceneVertexArray::SceneVertexArray(const std::vector<SceneVertexAttribute>& attrs,
                                    const usize                              count)
     : m_attributes(attrs) {
@@ -35,6 +102,7 @@ SceneVertexArray::SceneVertexArray(const std::vector<SceneVertexAttribute>& attr
     m_capacity = m_oneSize * count;
     m_pData    = new float[m_capacity];
     std::fill(m_pData, m_pData + m_capacity, 0.0f);
+    m_held.set(CapacitySizeOf());
 }
 
 SceneVertexArray::~SceneVertexArray() {
@@ -46,15 +114,21 @@ SceneVertexArray::SceneVertexArray(SceneVertexArray&& o) noexcept
       m_oneSize(o.m_oneSize),
       m_size(o.m_size),
       m_capacity(o.m_capacity),
+      m_per_instance(o.m_per_instance),
+      m_layout(o.m_layout),
+      m_held(std::move(o.m_held)),
       m_id(o.m_id) {}
 
 SceneVertexArray& SceneVertexArray::operator=(SceneVertexArray&& o) noexcept {
-    m_attributes = o.m_attributes;
-    m_pData      = std::exchange(o.m_pData, nullptr);
-    m_oneSize    = o.m_oneSize;
-    m_size       = o.m_size;
-    m_capacity   = o.m_capacity;
-    m_id         = o.m_id;
+    m_attributes   = o.m_attributes;
+    m_pData        = std::exchange(o.m_pData, nullptr);
+    m_oneSize      = o.m_oneSize;
+    m_size         = o.m_size;
+    m_capacity     = o.m_capacity;
+    m_per_instance = o.m_per_instance;
+    m_layout       = o.m_layout;
+    m_held         = std::move(o.m_held);
+    m_id           = o.m_id;
     return *this;
 }
 
@@ -65,7 +139,12 @@ bool SceneVertexArray::AddVertex(const float* data) {
     float* mData = m_pData + m_size;
     for (const auto& el : m_attributes) {
         auto typeSize = SceneVertexArray::TypeCount(el.type);
-        std::copy(data + pos, data + pos + typeSize, m_pData + mpos);
+        if (Packed(el.type)) {
+            const auto words = Pack(el.type, { data + pos, typeSize });
+            std::memcpy(mData + mpos, words.data(), TypeSize(el.type) * sizeof(u32));
+        } else {
+            std::copy(data + pos, data + pos + typeSize, mData + mpos);
+        }
         pos += typeSize;
         mpos += SceneVertexArray::RealAttributeSize(el);
     }
@@ -74,23 +153,31 @@ bool SceneVertexArray::AddVertex(const float* data) {
 }
 
 bool SceneVertexArray::SetVertex(std::string_view name, std::span<const float> data) noexcept {
+    auto attr = FindAttr(name);
+    if (! attr.valid()) return false;
+    usize  count    = data.size() / attr.count;
+    float* vertices = WriteVertices(0, count);
+    if (vertices == nullptr) return false;
+    PutEach(attr, vertices, count, data);
+    return true;
+}
+
+SceneVertexArray::AttrHandle SceneVertexArray::FindAttr(std::string_view name) const noexcept {
     u32 offset = 0;
     for (const auto& el : m_attributes) {
-        if (el.name == name) {
-            usize typeSize = SceneVertexArray::TypeCount(el.type);
-            usize count    = data.size() / typeSize;
-            if (! TrySetSize(count * m_oneSize)) return false;
-
-            for (usize i = 0; i < data.size(); i += typeSize) {
-                auto  start = data.begin() + (isize)i;
-                usize num   = i / typeSize;
-                std::copy(start, start + (isize)typeSize, m_pData + offset + num * m_oneSize);
-            }
-            return true;
-        } else
-            offset += RealAttributeSize(el);
+        if (el.name == name)
+            return { .offset = offset,
+                     .count  = TypeCount(el.type),
+                     .stride = (u32)m_oneSize,
+                     .type   = el.type };
+        offset += RealAttributeSize(el);
     }
-    return false;
+    return {};
+}
+
+float* SceneVertexArray::WriteVertices(usize first, usize num) noexcept {
+    if (! TrySetSize((first + num) * m_oneSize)) return nullptr;
+    return m_pData + first * m_oneSize;
 }
 
 bool SceneVertexArray::SetVertexs(usize index, std::span<const float> data) noexcept {
@@ -111,19 +198,9 @@ bool SceneVertexArray::TrySetSize(usize new_size) noexcept {
     return true;
 }
 
-Map<std::string, SceneVertexArray::SceneVertexAttributeOffset>
-SceneVertexArray::GetAttrOffsetMap() const {
-    Map<std::string, SceneVertexArray::SceneVertexAttributeOffset> result;
-    usize                                                          offset { 0 };
-    for (const auto& attr : m_attributes) {
-        result[attr.name] = (SceneVertexAttributeOffset { .attr = attr, .offset = offset });
-        offset += SceneVertexArray::RealAttributeSize(attr) * sizeof(float);
-    }
-    return result;
-}
-
 bool SceneVertexArray::GetOption(std::string_view name) const {
-    return exists(m_options, name) && m_options.at(std::string(name));
+    auto it = m_options.find(name);
+    return it != m_options.end() && it->second;
 }
 void SceneVertexArray::SetOption(std::string_view name, bool value) {
     m_options[std::string(name)] = value;
@@ -5,8 +5,10 @@
 #include "SceneRenderTarget.h"
 #include "SceneNode.h"
 #include "SceneLight.hpp"
+#include "SceneArena.h"
 
 #include "Core/NoCopyMove.hpp"
+#include "Core/StringId.hpp"
 
 namespace wallpaper
 {
@@ -23,6 +25,9 @@ public:
     Scene();
     ~Scene();
 
+    // first so it goes last, nodes and meshes are made in it
+    SceneArena arena;
+
     std::unordered_map<std::string, SceneTexture>      textures;
     std::unordered_map<std::string, SceneRenderTarget> renderTargets;
 
@@ -31,13 +36,21 @@ public:
 
     std::vector<std::unique_ptr<SceneLight>> lights;
 
-    std::shared_ptr<SceneNode>           sceneGraph;
+    std::shared_ptr<SceneNode> sceneGraph;
+    // sceneGraph flattened, built once it's parsed, goes before the nodes
+    SceneNodeTable nodeTable;
+
     std::unique_ptr<IShaderValueUpdater> shaderValueUpdater;
     std::unique_ptr<IImageParser>        imageParser;
     std::unique_ptr<fs::VFS>             vfs;
 
     std::string scene_id { "unknown_id" };
 
+    // hz the passes of a layer re-render at instead of every frame, by the id of its object,
+    // 0 for every frame, layers without one take timeLayerRate if only time moves their shaders
+    std::unordered_map<i32, u32> layerRates;
+    u32                          timeLayerRate { 0 };
+
     bool first_frame_ok { false };
 
     SceneMesh default_effect_mesh;
@@ -66,5 +79,19 @@ public:
             }
         }
     }
+
+    // of renderTargets, the name is only hashed until it's found, null if there's none yet
+    SceneRenderTarget* FindRenderTarget(StringId id) {
+        if (id.value() < m_rt_by_id.size() && m_rt_by_id[id.value()] != nullptr)
+            return m_rt_by_id[id.value()];
+        auto it = renderTargets.find(id.str());
+        if (it == renderTargets.end()) return nullptr;
+        if (m_rt_by_id.size() <= id.value()) m_rt_by_id.resize(id.value() + 1, nullptr);
+        return m_rt_by_id[id.value()] = &it->second;
+    }
+
+private:
+    // render targets are never erased, the map keeps their addresses
+    std::vector<SceneRenderTarget*> m_rt_by_id;
 };
 } // namespace wallpaper
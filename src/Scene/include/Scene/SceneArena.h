@@ -0,0 +1,51 @@
+#pragma once
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+namespace wallpaper
+{
+
+// Memory of a scene's objects, handed out from growing blocks and given back all at once with the
+// scene instead of an object at a time. What's in it still gets its destructor, and must be gone
+// before the arena is.
+class SceneArena : public std::pmr::memory_resource, NoCopy, NoMove {
+public:
+    constexpr static usize FirstBlock { 64 * 1024 };
+
+    SceneArena()  = default;
+    ~SceneArena() = default;
+
+    // the object and its control block in the arena
+    template<typename T, typename... Args>
+    std::shared_ptr<T> MakeShared(Args&&... args) {
+        return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(this),
+                                       std::forward<Args>(args)...);
+    }
+
+    usize Used() const {
+        std::unique_lock<std::mutex> lock { m_mutex };
+        return m_used;
+    }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        std::unique_lock<std::mutex> lock { m_mutex };
+        m_used += bytes;
+        return m_blocks.allocate(bytes, alignment);
+    }
+    // all of it goes with the arena
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override {
+        return this == &o;
+    }
+
+    mutable std::mutex                  m_mutex;
+    usize                               m_used { 0 };
+    std::pmr::monotonic_buffer_resource m_blocks { FirstBlock };
+};
+
+} // namespace wallpaper
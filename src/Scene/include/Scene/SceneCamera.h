@@ -60,6 +60,9 @@ public:
 
     std::shared_ptr<SceneNode> GetAttachedNode() const { return m_node; }
 
+    // bumped by every Update, the matrices may have changed
+    u64 Generation() const { return m_generation; }
+
     void Clone(const SceneCamera& cam) {
         m_width       = cam.m_width;
         m_height      = cam.m_height;
@@ -82,6 +85,7 @@ private:
 
     Eigen::Matrix4d m_viewMat { Eigen::Matrix4d::Identity() };
     Eigen::Matrix4d m_viewProjectionMat { Eigen::Matrix4d::Identity() };
+    u64             m_generation { 0 };
 
     std::shared_ptr<SceneNode>             m_node;
     std::shared_ptr<SceneImageEffectLayer> m_imgEffect { nullptr };
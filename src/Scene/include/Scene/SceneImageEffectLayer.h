@@ -46,6 +46,7 @@ public:
     SceneMesh&  FinalMesh() const { return *m_final_mesh; }
     SceneNode&  FinalNode() const { return *m_final_node; }
     void        SetFinalBlend(BlendMode m) { m_final_blend = m; }
+    void        SetFinalCoversView(bool v) { m_final_covers_view = v; }
 
     void ResolveEffect(const SceneMesh& defualt_mesh, std::string_view effect_cam);
 
@@ -59,6 +60,7 @@ private:
     std::unique_ptr<SceneMesh> m_final_mesh;
     std::unique_ptr<SceneNode> m_final_node;
     BlendMode                  m_final_blend;
+    bool                       m_final_covers_view { false };
 
     std::vector<std::shared_ptr<SceneImageEffect>> m_effects;
 };
@@ -7,6 +7,7 @@
 
 #include "Core/NoCopyMove.hpp"
 #include "Core/Literals.hpp"
+#include "Utils/MemUse.hpp"
 
 namespace wallpaper
 {
@@ -14,7 +15,8 @@ class SceneIndexArray : NoCopy {
     constexpr static size_t Unit_Byte_Size { sizeof(uint32_t) };
 
 public:
-    SceneIndexArray(usize indexCount);
+    // room for indexCount quads, wide stores u32 indices instead of two u16 per element
+    SceneIndexArray(usize indexCount, bool wide = false);
     SceneIndexArray(std::span<const uint32_t> data);
 
     SceneIndexArray(SceneIndexArray&&) noexcept;
@@ -24,6 +26,7 @@ public:
     void AssignHalf(usize index, std::span<const uint16_t> data) { AssignSpan(index, data); }
 
     // Get
+    bool            Wide() const { return m_wide; }
     const uint32_t* Data() const { return m_pData; }
     usize           DataCount() const { return m_size; }
     usize           DataSizeOf() const { return m_size * Unit_Byte_Size; }
@@ -33,6 +36,12 @@ public:
     }
     void SetRenderDataCount(usize val) noexcept { m_render_size = val; }
 
+    // in indices rather than elements
+    usize IndexCount() const noexcept { return m_wide ? m_size : m_size * 2; }
+    usize RenderIndexCount() const noexcept {
+        return m_wide ? RenderDataCount() : RenderDataCount() * 2;
+    }
+
     usize CapacityCount() const { return m_capacity; }
     usize CapacitySizeof() const { return m_capacity * Unit_Byte_Size; }
 
@@ -56,5 +65,8 @@ private:
     usize m_render_size { std::numeric_limits<usize>::max() };
 
     uint32_t m_id;
+    bool     m_wide { false };
+
+    memuse::Held m_held { memuse::Pool::Geometry };
 };
 } // namespace wallpaper
@@ -29,6 +29,11 @@ public:
     std::vector<std::string> defines;
 
     bool hasSprite { false };
+    // the mesh covers all the camera sees wherever parallax moves it, with blending off nothing
+    // drawn beneath it shows
+    bool covers_view { false };
+    // the fragment shader as compiled has a discard, what's beneath may show where it runs
+    bool discards { false };
 
     SceneMaterialCustomShader customShader;
     BlendMode                 blenmode { BlendMode::Disable };
@@ -8,6 +8,7 @@
 #include "SceneVertexArray.h"
 #include "SceneIndexArray.h"
 #include "SceneMaterial.h"
+#include "SceneParticleSim.h"
 
 namespace wallpaper
 {
@@ -50,6 +51,13 @@ public:
 	void SetPrimitive(MeshPrimitive v) {  m_primitive = v; }
 	void SetPointSize(uint32_t v) { m_pointSize = v; }
 
+	// instanced meshes draw InstanceVertexCount() vertices as a strip for each of the
+	// InstanceCount() elements of their per instance arrays, 0 if not instanced
+	uint32_t InstanceVertexCount() const { return m_instance_vertex_count; }
+	void SetInstanceVertexCount(uint32_t v) { m_instance_vertex_count = v; }
+	uint32_t InstanceCount() const { return m_instance_count; }
+	void SetInstanceCount(uint32_t v) { m_instance_count = v; }
+
 
 	SceneMaterial* Material() { return m_material.get(); }
 
@@ -57,6 +65,10 @@ public:
 		m_data = o.m_data;
 	}
 
+	// set when a compute shader writes the vertices instead of the cpu
+	SceneParticleSim* ParticleSim() const { return m_particle_sim.get(); }
+	void SetParticleSim(std::shared_ptr<SceneParticleSim> v) { m_particle_sim = std::move(v); }
+
 private:
 	struct Data {
 		std::vector<SceneVertexArray> vertexArrays;
@@ -66,11 +78,14 @@ private:
 	uint32_t m_id { std::numeric_limits<uint32_t>::max() };
 	MeshPrimitive m_primitive {MeshPrimitive::TRIANGLE};
 	uint32_t m_pointSize {1};
+	uint32_t m_instance_vertex_count {0};
+	uint32_t m_instance_count {0};
 	bool m_dynamic;
 	std::atomic<bool> m_dirty;
 
 	std::shared_ptr<Data> m_data;
 	std::shared_ptr<SceneMaterial> m_material;
+	std::shared_ptr<SceneParticleSim> m_particle_sim;
 };
 
 }
@@ -5,6 +5,7 @@
 #include <Eigen/Dense>
 #include "SceneMesh.h"
 #include "SceneCamera.h"
+#include "SceneNodeTable.h"
 
 #include "Core/Literals.hpp"
 #include "Core/NoCopyMove.hpp"
@@ -14,6 +15,8 @@ namespace wallpaper
 
 class SceneNode : NoCopy, NoMove {
 public:
+    constexpr static u32 NoIndex { ~0u };
+
     SceneNode()
         : m_name(),
           m_dirty(true),
@@ -30,27 +33,44 @@ public:
 
     const auto& Camera() const { return m_cameraName; }
     void        SetCamera(const std::string& name) { m_cameraName = name; }
-    void        AddMesh(std::shared_ptr<SceneMesh> mesh) { m_mesh = mesh; }
-    void        AppendChild(std::shared_ptr<SceneNode> sub) {
-               sub->m_parent = this;
-               m_children.push_back(sub);
+    void        AddMesh(std::shared_ptr<SceneMesh> mesh) {
+               m_mesh = mesh;
+               if (m_table) m_table->Invalidate();
+    }
+    void AppendChild(std::shared_ptr<SceneNode> sub) {
+        sub->m_parent = this;
+        sub->MarkTransDirty();
+        m_children.push_back(sub);
+        if (m_table) m_table->Invalidate();
     }
     Eigen::Matrix4d GetLocalTrans() const;
 
     const auto& Translate() const { return m_translate; }
     const auto& Rotation() const { return m_rotation; }
-    void        SetRotation(Eigen::Vector3f v) { m_rotation = v; }
-    void        SetTranslate(Eigen::Vector3f v) { m_translate = v; }
+
+    void SetRotation(Eigen::Vector3f v) {
+        m_rotation = v;
+        MarkTransDirty();
+    }
+    void SetTranslate(Eigen::Vector3f v) {
+        m_translate = v;
+        MarkTransDirty();
+    }
 
     void CopyTrans(const SceneNode& node) {
         m_translate = node.m_translate;
         m_scale     = node.m_scale;
         m_rotation  = node.m_rotation;
+        MarkTransDirty();
     }
 
-    // update self modle trans (will update parent before)
-    void            UpdateTrans();
-    Eigen::Matrix4d ModelTrans() const { return m_trans; };
+    // update self modle trans (will update parent before), the whole table's dirty ones if in one
+    void                   UpdateTrans();
+    const Eigen::Matrix4f& ModelTrans() const {
+        return m_table ? m_table->World(m_slot) : m_trans;
+    };
+    // bumped whenever the model trans is recomputed, a parent's change counts
+    u64 TransGeneration() const { return m_trans_generation; }
 
     SceneMesh* Mesh() { return m_mesh.get(); }
     bool       HasMaterial() const { return m_mesh && m_mesh->Material() != nullptr; };
@@ -60,15 +80,22 @@ public:
 
     i32& ID() { return m_id; }
 
+    // dense per scene, given at parse so per node data can live in vectors
+    u32  Index() const { return m_index; }
+    void SetIndex(u32 value) { m_index = value; }
+
 private:
+    friend class SceneNodeTable;
     // mark self and all children
     void MarkTransDirty();
 
     i32         m_id;
+    u32         m_index { NoIndex };
     std::string m_name;
 
     bool            m_dirty;
-    Eigen::Matrix4d m_trans;
+    Eigen::Matrix4f m_trans;
+    u64             m_trans_generation { 0 };
 
     Eigen::Vector3f m_translate { 0.0f, 0.0f, 0.0f };
     Eigen::Vector3f m_scale { 1.0f, 1.0f, 1.0f };
@@ -80,6 +107,9 @@ private:
     std::string m_cameraName;
 
     SceneNode* m_parent { nullptr };
+    // set by the table the node is in, its slot there
+    SceneNodeTable* m_table { nullptr };
+    u32             m_slot { NoIndex };
 
     std::list<std::shared_ptr<SceneNode>> m_children;
 };
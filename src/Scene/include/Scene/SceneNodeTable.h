@@ -0,0 +1,66 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+namespace wallpaper
+{
+class SceneNode;
+class SceneMesh;
+
+// The scene graph flattened depth first, every node at its slot, a parent always before its
+// children. World transforms are propagated in one pass over the slots instead of a walk up the
+// parents of each node, the nodes read theirs from here once built. Not for nodes changed from
+// more than one thread.
+class SceneNodeTable : NoCopy, NoMove {
+public:
+    constexpr static u32 NoParent { ~0u };
+
+    SceneNodeTable() = default;
+    ~SceneNodeTable();
+
+    // the nodes under root, root too, get their slots
+    void Build(SceneNode& root);
+    // nodes are left with their own transforms
+    void Clear();
+    bool Built() const { return m_root != nullptr; }
+
+    // recomputes the world transforms of dirty nodes and of everything under them, rebuilds
+    // first if a child was appended since
+    void Propagate();
+    bool Dirty() const { return m_any_dirty; }
+
+    void MarkDirty(u32 slot) {
+        m_dirty[slot] = 1;
+        m_any_dirty   = true;
+    }
+    void Invalidate() {
+        m_stale     = true;
+        m_any_dirty = true;
+    }
+
+    usize Size() const { return m_nodes.size(); }
+    // in depth first order, rebuilt if stale
+    std::span<SceneNode* const> Nodes();
+
+    u32                    Parent(u32 slot) const { return m_parents[slot]; }
+    SceneMesh*             Mesh(u32 slot) const { return m_meshes[slot]; }
+    const Eigen::Matrix4f& World(u32 slot) const { return m_world[slot]; }
+
+private:
+    void Detach();
+
+    SceneNode* m_root { nullptr };
+    bool       m_stale { false };
+    bool       m_any_dirty { false };
+
+    std::vector<SceneNode*>      m_nodes;
+    std::vector<u32>             m_parents;
+    std::vector<SceneMesh*>      m_meshes;
+    std::vector<Eigen::Matrix4f> m_world;
+    std::vector<u8>              m_dirty;
+};
+} // namespace wallpaper
@@ -0,0 +1,75 @@
+#pragma once
+#include "Core/Literals.hpp"
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+namespace wallpaper
+{
+
+// Hand-off between a particle subsystem and the render when its particles are simulated by a
+// compute shader. The subsystem keeps spawning and lifetime bookkeeping on cpu and lists the
+// particles it spawned this frame, the render owns the state on the gpu, runs the operators
+// and writes the mesh vertices in place.
+// Layouts match the std430 blocks of the compute shader.
+struct SceneParticleSim {
+    enum class OpType : u32
+    {
+        MOVEMENT = 0,
+        ANGULAR_MOVEMENT,
+        FADE,
+        ALPHA_FADE,
+        TURBULENCE,
+        VORTEX,
+        CONTROLPOINT_ATTRACT,
+    };
+    // FADE targets
+    enum class FadeTarget : u32
+    {
+        ALPHA = 0,
+        SIZE,
+        COLOR_R,
+        COLOR_G,
+        COLOR_B,
+    };
+
+    struct Op {
+        OpType                              type;
+        u32                                 arg { 0 };
+        u32                                 pad[2] {};
+        std::array<std::array<float, 4>, 3> v {};
+    };
+
+    // pos lifetime, velocity init lifetime, rotation init size,
+    // angular velocity init alpha, init color
+    struct Spawn {
+        std::array<std::array<float, 4>, 5> state;
+        u32                                 slot;
+        u32                                 pad[3] {};
+    };
+
+    static constexpr usize MaxOps { 16 };
+    static constexpr usize MaxControlpoints { 8 };
+
+    // ----- set on load
+    u32  capacity { 0 };
+    bool thick_format { false };
+    // ParticleAnimationMode and its sequence multiplier, for the thick format lifetime
+    u32             anim_mode { 0 };
+    float           anim_multiplier { 1.0f };
+    std::vector<Op> ops;
+
+    // ----- per frame, written by the subsystem
+    float                                              time { 0.0f };
+    float                                              time_pass { 0.0f };
+    std::array<std::array<float, 4>, MaxControlpoints> controlpoints {};
+    std::vector<Spawn>                                 spawns;
+    // the subsystem stepped since the render consumed the last frame
+    bool pending { false };
+
+    // set by the render once the compute path is ready, the cpu path runs until then
+    std::atomic<bool> active { false };
+};
+
+} // namespace wallpaper
@@ -0,0 +1,14 @@
+#pragma once
+#include "Core/Literals.hpp"
+
+namespace wallpaper
+{
+class Scene;
+
+// Takes over what a scene parsed again from the same source changed, the const uniforms of every
+// material and the transforms of the nodes. Anything else has to match, shaders, textures,
+// targets and the node tree, or the live scene is left as it is and false returned.
+// Runs where the live scene is drawn, effect layers the graph resolved are expected in it.
+bool PatchScene(Scene& live, Scene& fresh, usize& patched);
+
+} // namespace wallpaper
@@ -2,6 +2,8 @@
 #include "SceneTexture.h"
 #include "Core/Literals.hpp"
 
+#include <array>
+
 namespace wallpaper
 {
 
@@ -11,6 +13,8 @@ struct SceneRenderTarget {
         std::string name {};
         bool        screen { false };
         double      scale { 1.0 };
+        // of width and height on top of scale
+        std::array<double, 2> axis_scale { 1.0, 1.0 };
     };
 
     i32           width;
@@ -19,6 +23,8 @@ struct SceneRenderTarget {
     bool          withDepth { false };
     bool          has_mipmap { false };
     uint          mipmap_level { 1 };
+    // of the color, effects declare fbos of one or two channels for masks
+    TextureFormat format { TextureFormat::RGBA8 };
     TextureSample sample { TextureWrap::CLAMP_TO_EDGE,
                            TextureWrap::CLAMP_TO_EDGE,
                            TextureFilter::LINEAR,
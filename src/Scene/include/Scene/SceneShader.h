@@ -10,6 +10,7 @@
 
 #include "Core/MapSet.hpp"
 #include "Core/ArrayHelper.hpp"
+#include "Utils/MemUse.hpp"
 
 namespace wallpaper
 {
@@ -86,8 +87,21 @@ public:
     */
 
     std::vector<ShaderCode> codes;
+    // the renderer's reflection of the codes, see vulkan::PackReflect, empty if not known
+    std::string reflection;
+    // specialization constant id and value, for every stage
+    std::vector<std::pair<uint32_t, int32_t>> spec_constants;
 
     std::vector<ShaderAttribute> attrs;
     ShaderValues                 default_uniforms;
+
+    // of codes and reflection, set by CountCodes once they're set
+    memuse::Held code_bytes { memuse::Pool::Spirv };
+
+    void CountCodes() {
+        usize n = reflection.capacity();
+        for (auto& code : codes) n += code.capacity() * sizeof(unsigned int);
+        code_bytes.set(n);
+    }
 };
 } // namespace wallpaper
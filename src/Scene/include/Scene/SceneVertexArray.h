@@ -1,4 +1,7 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <vector>
 #include <string>
 #include <cstddef>
@@ -8,6 +11,7 @@
 
 #include "Core/Literals.hpp"
 #include "Core/NoCopyMove.hpp"
+#include "Utils/MemUse.hpp"
 #include "Type.hpp"
 
 namespace wallpaper
@@ -20,9 +24,15 @@ public:
         VertexType  type;
         bool        padding { true };
     };
-    struct SceneVertexAttributeOffset {
-        SceneVertexAttribute attr;
-        usize                offset;
+    // an attribute resolved once, in 4 byte words, vertex i has it at i * stride + offset,
+    // count is of its components
+    struct AttrHandle {
+        u32        offset { 0 };
+        u32        count { 0 };
+        u32        stride { 0 };
+        VertexType type { VertexType::FLOAT1 };
+
+        bool valid() const { return count > 0; }
     };
 
     SceneVertexArray(const std::vector<SceneVertexAttribute>& attrs, const std::size_t count);
@@ -35,9 +45,58 @@ public:
     bool SetVertex(std::string_view name, std::span<const float> data) noexcept;
     bool SetVertexs(std::size_t index, std::span<const float> data) noexcept;
 
+    // invalid if there's none of the name
+    AttrHandle FindAttr(std::string_view name) const noexcept;
+    // vertices [first, first + num) to be written in place, they count as set, null past the
+    // capacity
+    float* WriteVertices(std::size_t first, std::size_t num) noexcept;
+    // the same value to the attribute of num vertices from the first
+    static void Put(const AttrHandle& h, float* vertices, usize num,
+                    std::span<const float> value) noexcept {
+        if (! h.valid()) return;
+        if (Packed(h.type)) {
+            const auto words = Pack(h.type, value);
+            for (usize i = 0; i < num; i++)
+                std::memcpy(vertices + i * h.stride + h.offset, words.data(), TypeSize(h.type) * 4);
+            return;
+        }
+        for (usize i = 0; i < num; i++)
+            std::copy(value.begin(), value.end(), vertices + i * h.stride + h.offset);
+    }
+    // values holds num of them, one for each vertex
+    static void PutEach(const AttrHandle& h, float* vertices, usize num,
+                        std::span<const float> values) noexcept {
+        if (! h.valid() || num == 0) return;
+        const usize one = values.size() / num;
+        for (usize i = 0; i < num; i++) {
+            float* to = vertices + i * h.stride + h.offset;
+            if (Packed(h.type)) {
+                const auto words = Pack(h.type, values.subspan(i * one, one));
+                std::memcpy(to, words.data(), TypeSize(h.type) * 4);
+            } else {
+                std::copy_n(values.begin() + (isize)(i * one), one, to);
+            }
+        }
+    }
+
+    // the words of a packed type from up to four components, missing ones are 0, the first
+    // component in the low bits
+    static std::array<u32, 2> Pack(VertexType, std::span<const float>) noexcept;
+    // round to nearest even, out of range goes to infinity
+    static u16 HalfOf(float) noexcept;
+
     bool GetOption(std::string_view) const;
     void SetOption(std::string_view, bool);
 
+    // one element per instance instead of per vertex
+    bool PerInstance() const { return m_per_instance; }
+    void SetPerInstance(bool v) { m_per_instance = v; }
+    // what writes the vertices picks its code for the attributes once and keeps it here, 0 until
+    // it did
+    u32  Layout() const { return m_layout; }
+    void SetLayout(u32 v) { m_layout = v; }
+
+    // 4 byte words, floats but for packed attributes, which hold their bits
     const float* Data() const { return m_pData; }
     usize        DataSize() const { return m_size; }
     usize        DataSizeOf() const { return m_size * sizeof(float); }
@@ -47,13 +106,16 @@ public:
     usize        OneSize() const { return m_oneSize; }
     usize        OneSizeOf() const { return m_oneSize * sizeof(float); }
 
-    const auto&                                  Attributes() const { return m_attributes; }
-    Map<std::string, SceneVertexAttributeOffset> GetAttrOffsetMap() const;
+    const auto& Attributes() const { return m_attributes; }
 
     uint32_t ID() const { return m_id; }
     void     SetID(uint32_t id) { m_id = id; }
 
+    // of components
     static uint8_t TypeCount(VertexType);
+    // of words
+    static uint8_t TypeSize(VertexType);
+    static bool    Packed(VertexType t) { return t >= VertexType::HALF4; }
     static uint8_t RealAttributeSize(const SceneVertexAttribute&);
 
 private:
@@ -67,6 +129,10 @@ private:
     usize  m_oneSize { 0 };
     usize  m_size { 0 };
     usize  m_capacity { 0 };
+    bool   m_per_instance { false };
+    u32    m_layout { 0 };
+
+    memuse::Held m_held { memuse::Pool::Geometry };
 
     uint32_t m_id;
 };
@@ -2,19 +2,36 @@
 #include "SceneWallpaperSurface.hpp"
 
 #include "Utils/Logging.h"
+#include "Utils/ThreadPolicy.hpp"
+#include "Utils/Trace.h"
+#include "Utils/Counters.hpp"
+#include "Utils/ThreadCpu.hpp"
+#include "Utils/MemUse.hpp"
 #include "Looper/Looper.hpp"
+#include "Looper/JobSystem.hpp"
+#include "Core/Random.hpp"
 
 #include "Timer/FrameTimer.hpp"
+#include "Timer/FpsGovernor.hpp"
+#include "Timer/FrameStats.hpp"
+#include "Timer/StallWatchdog.hpp"
 #include "Utils/FpsCounter.h"
 #include "WPSceneParser.hpp"
+#include "WPPerfProfile.hpp"
+#include "WPBake.hpp"
+#include "BcEncode.hpp"
+#include "InputRecord.hpp"
 #include "Scene/Scene.h"
+#include "Scene/ScenePatch.h"
 #include "Particle/ParticleSystem.h"
+#include "Interface/IImageParser.h"
 #include "Interface/IShaderValueUpdater.h"
 #include "WPShaderValueUpdater.hpp"
 
 #include "Fs/VFS.h"
 #include "Fs/PhysicalFs.h"
 #include "WPPkgFs.hpp"
+#include "WPBundleFs.hpp"
 
 #include "Audio/SoundManager.h"
 
@@ -22,31 +39,231 @@
 
 #include "VulkanRender/SceneToRenderGraph.hpp"
 #include "VulkanRender/VulkanRender.hpp"
+#include <algorithm>
 #include <atomic>
+#include <charconv>
+#include <cmath>
+#include <future>
+#include <optional>
+#include <variant>
 
 using namespace wallpaper;
 
-#define CASE_CMD(cmd)      \
-    case CMD::CMD_##cmd:   \
-        handle_##cmd(msg); \
-        break;
-#define MHANDLER_CMD(cmd) void handle_##cmd(const std::shared_ptr<looper::Message>& msg)
-#define MHANDLER_CMD_IMPL(cl, cmd) \
-    void impl_##cl::handle_##cmd(const std::shared_ptr<looper::Message>& msg)
-#define CALL_MHANDLER_CMD(cmd, msg) handle_##cmd(msg)
-
 namespace
 {
+// a message of the handler H with the command, one of H::Command
+template<typename H, typename C>
+std::shared_ptr<looper::Message> CreateCmdMsg(const std::shared_ptr<looper::Handler>& handler,
+                                              C&&                                     cmd) {
+    auto msg = looper::Message::create(0, handler);
+    msg->setCommand(typename H::Command(std::forward<C>(cmd)));
+    return msg;
+}
+
+// of a setProperty call
+using PropertyValue = std::variant<bool, int32_t, float, std::string, std::shared_ptr<void>>;
+
 template<typename T>
-void AddMsgCmd(looper::Message& msg, T cmd) {
-    msg.setInt32("cmd", (int32_t)cmd);
+bool ValueAs(const PropertyValue& value, T* out) {
+    auto* v = std::get_if<T>(&value);
+    if (v == nullptr) return false;
+    *out = *v;
+    return true;
 }
+// objects are set untyped, the property tells what they are
 template<typename T>
-std::shared_ptr<looper::Message> CreateMsgWithCmd(const std::shared_ptr<looper::Handler>& handler,
-                                                  T                                       cmd) {
-    auto msg = looper::Message::create(0, handler);
-    AddMsgCmd(*msg, cmd);
-    return msg;
+bool ObjectAs(const PropertyValue& value, std::shared_ptr<T>* out) {
+    auto* v = std::get_if<std::shared_ptr<void>>(&value);
+    if (v == nullptr) return false;
+    *out = std::static_pointer_cast<T>(*v);
+    return true;
+}
+
+// what a record keeps of a value, objects aren't kept
+std::optional<InputRecord::Value> RecordValue(const PropertyValue& value) {
+    if (auto* v = std::get_if<bool>(&value)) return *v;
+    if (auto* v = std::get_if<int32_t>(&value)) return *v;
+    if (auto* v = std::get_if<float>(&value)) return *v;
+    if (auto* v = std::get_if<std::string>(&value)) return *v;
+    return std::nullopt;
+}
+// the host picks the scene and what is recorded of it, a replay only sets the rest
+ShaderQuality ShaderQualityOf(int32_t quality) {
+    return quality == QUALITY_LOW ? ShaderQuality::Low : ShaderQuality::Full;
+}
+
+bool Replayable(std::string_view property) {
+    constexpr std::array skipped { PROPERTY_SOURCE,       PROPERTY_PREFETCH,
+                                   PROPERTY_ASSETS,       PROPERTY_CACHE_PATH,
+                                   PROPERTY_INPUT_RECORD, PROPERTY_INPUT_REPLAY,
+                                   PROPERTY_TRACE_FILE,   PROPERTY_DUMP_GRAPH,
+                                   PROPERTY_GPU_POLICY,   PROPERTY_STALL_WATCHDOG };
+    return std::find(skipped.begin(), skipped.end(), property) == skipped.end();
+}
+
+FrameTimeStats Summarize(const FrameHistogram::Snapshot& snap) {
+    auto ms = [](std::chrono::microseconds v) {
+        return v.count() / 1000.0;
+    };
+    return { .count  = snap.count,
+             .missed = snap.missed,
+             .p50    = ms(snap.Percentile(0.50)),
+             .p95    = ms(snap.Percentile(0.95)),
+             .p99    = ms(snap.Percentile(0.99)),
+             .max    = ms(snap.max) };
+}
+
+double Millis(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// of PROPERTY_LAYER_RATES
+struct LayerRates {
+    u32                          time_rate { 0 };
+    std::unordered_map<i32, u32> layers;
+
+    bool operator==(const LayerRates&) const = default;
+};
+
+LayerRates ParseLayerRates(std::string_view str) {
+    LayerRates rates;
+    auto       number = [](std::string_view s, auto& value) {
+        auto [ptr, ec] { std::from_chars(s.data(), s.data() + s.size(), value) };
+        return ec == std::errc() && ptr == s.data() + s.size();
+    };
+    while (! str.empty()) {
+        auto             end   = std::min(str.find(','), str.size());
+        std::string_view entry = str.substr(0, end);
+        str.remove_prefix(std::min(end + 1, str.size()));
+        if (entry.empty()) continue;
+
+        auto colon = entry.find(':');
+        i32  id { 0 };
+        u32  hz { 0 };
+        bool ok = colon == std::string_view::npos
+                      ? number(entry, rates.time_rate)
+                      : number(entry.substr(0, colon), id) && number(entry.substr(colon + 1), hz);
+        if (! ok)
+            LOG_ERROR("layer rate \'%.*s\' is not hz or id:hz", (int)entry.size(), entry.data());
+        else if (colon != std::string_view::npos)
+            rates.layers[id] = hz;
+    }
+    return rates;
+}
+
+// a load's report and what the render thread needs to finish it
+struct LoadTiming {
+    LoadReport                            report;
+    std::chrono::steady_clock::time_point start { std::chrono::steady_clock::now() };
+};
+
+// mounts the source's assets, pkg and cache and parses it, its sounds go to the sound manager
+// textures are decoded ahead unless it's only parsed to patch the drawn scene
+// the main thread's phases go to the report if given
+// the assets and the source's pkg, or its folder without one, and the scene json in them
+bool MountSource(fs::VFS& vfs, const std::string& assets, const std::string& source,
+                 std::string& scene_src, std::chrono::steady_clock::duration* index_time) {
+    if (! vfs.IsMounted("assets")) {
+        bool sus = vfs.Mount("/assets", fs::CreatePhysicalFs(assets), "assets");
+        if (! sus) {
+            LOG_ERROR("Mount assets dir failed");
+            return false;
+        }
+    }
+    std::filesystem::path pkgPath_fs { source };
+    pkgPath_fs.replace_extension("pkg");
+    std::string pkgPath  = pkgPath_fs.native();
+    std::string pkgEntry = pkgPath_fs.filename().replace_extension("json").native();
+    std::string pkgDir   = pkgPath_fs.parent_path().native();
+
+    // a bundle made by wpBundle goes before the pkg
+    std::filesystem::path bundlePath { pkgPath_fs };
+    bundlePath.replace_extension(fs::WPBundleFs::Extension);
+    auto                         index_begin = std::chrono::steady_clock::now();
+    auto                         bundle = fs::WPBundleFs::CreateBundleFs(bundlePath.native());
+    std::unique_ptr<fs::WPPkgFs> pkgfs;
+    if (! bundle) pkgfs = fs::WPPkgFs::CreatePkgFs(pkgPath);
+    if (index_time != nullptr) *index_time = std::chrono::steady_clock::now() - index_begin;
+    if (bundle) {
+        LOG_INFO("load bundle %s", bundlePath.c_str());
+        vfs.Mount("/assets", std::move(bundle));
+    } else if (! vfs.Mount("/assets", std::move(pkgfs))) {
+        LOG_INFO("load pkg file %s failed, fallback to use dir", pkgPath.c_str());
+        // load pkg dir
+        if (! vfs.Mount("/assets", fs::CreatePhysicalFs(pkgDir))) {
+            LOG_ERROR("can't load pkg directory: %s", pkgDir.c_str());
+            return false;
+        }
+    }
+
+    const std::string scenePath = "/assets/" + pkgEntry;
+    if (vfs.Contains(scenePath)) {
+        auto f = vfs.Open(scenePath);
+        if (f) scene_src = f->ReadAllStr();
+    }
+    if (scene_src.empty()) {
+        LOG_ERROR("Not supported scene type");
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<Scene> ParseScene(const std::string& assets, const std::string& source,
+                                  const std::string& cache_path, const std::string& user_props,
+                                  bool tex_transcode, i32 max_tex_size, WPSceneParser& parser,
+                                  audio::SoundManager& sound_manager, LoadReport* report = nullptr,
+                                  bool preload = true, std::function<bool()> stale = {}) {
+    using clock = std::chrono::steady_clock;
+    auto begin  = clock::now();
+    // mount assets dir
+    std::unique_ptr<fs::VFS> pVfs = std::make_unique<fs::VFS>();
+    auto&                    vfs  = *pVfs;
+    std::string              scene_src;
+    clock::duration          index_time {};
+    if (! MountSource(vfs, assets, source, scene_src, &index_time)) return nullptr;
+    std::string scene_id = std::filesystem::path(source).parent_path().filename().native();
+
+    if (! cache_path.empty()) {
+        if (! vfs.Mount("/cache", fs::CreatePhysicalFs(cache_path, true), "cache")) {
+            LOG_ERROR("can't load cache folder: %s", cache_path.c_str());
+        } else {
+            LOG_INFO("cache folder: %s", cache_path.c_str());
+        }
+    }
+    auto mount_end = clock::now();
+    // checked where a phase ends, a newer load makes the rest wasted
+    auto superseded = [&stale]() {
+        return stale && stale();
+    };
+    if (superseded()) return nullptr;
+
+    auto parse_begin = clock::now();
+    auto scene       = parser.Parse(scene_id, scene_src, vfs, sound_manager, user_props);
+    auto parse_end   = clock::now();
+    if (! scene) return nullptr;
+    scene->vfs.swap(pVfs);
+    if (report != nullptr) {
+        report->vfs_mount      = Millis(mount_end - begin);
+        report->pkg_index      = Millis(index_time);
+        report->scene_parse    = Millis(parse_end - parse_begin);
+        report->shader_compile = Millis(parser.ShaderTime());
+        report->shaders.clear();
+        for (auto& load : parser.ShaderLoads()) {
+            report->shaders.push_back(
+                { .name = load.name, .cached = load.cached, .compile = Millis(load.compile) });
+        }
+    }
+    if (! preload || superseded()) return scene;
+
+    // textures decode in parallel here, the render thread only uploads them
+    std::vector<std::string> tex_names;
+    tex_names.reserve(scene->textures.size());
+    for (auto& [name, _] : scene->textures) tex_names.push_back(name);
+    scene->imageParser->SetTranscode(tex_transcode);
+    scene->imageParser->SetMaxSize((u32)std::max(max_tex_size, 0));
+    scene->imageParser->Preload(tex_names, stale);
+    if (report != nullptr) report->texture_decode = Millis(clock::now() - parse_end);
+    return scene;
 }
 } // namespace
 
@@ -56,14 +273,37 @@ class RenderHandler;
 
 class MainHandler : public looper::Handler {
 public:
-    enum class CMD
-    {
-        CMD_LOAD_SCENE,
-        CMD_SET_PROPERTY,
-        CMD_STOP,
-        CMD_FIRST_FRAME,
-        CMD_NO
+    struct InitVulkan {
+        std::shared_ptr<RenderInitInfo> info;
+    };
+    struct LoadScene {};
+    struct SetProperty {
+        StringId      name;
+        PropertyValue value;
+        // of a source or assets change
+        std::optional<uint32_t> load_for {};
+    };
+    struct Stop {
+        bool value { false };
+    };
+    struct FirstFrame {};
+    struct PassTimes {
+        std::vector<std::pair<std::string, double>> times;
+    };
+    struct LoadDone {
+        std::shared_ptr<LoadTiming> load;
+    };
+    // a finished record, written here off the render thread
+    struct SaveRecord {
+        std::string                  path;
+        std::shared_ptr<InputRecord> record;
     };
+    // a bake of the key was written, the scene loads it if it's still the one drawn
+    struct Baked {
+        std::string key;
+    };
+    using Command = std::variant<InitVulkan, LoadScene, SetProperty, Stop, FirstFrame, PassTimes,
+                                 LoadDone, SaveRecord, Baked>;
 
 public:
     MainHandler();
@@ -75,30 +315,52 @@ public:
 
 public:
     void onMessageReceived(const std::shared_ptr<looper::Message>& msg) override {
-        int32_t cmd_int = (int32_t)CMD::CMD_NO;
-        if (msg->findInt32("cmd", &cmd_int)) {
-            CMD cmd = static_cast<CMD>(cmd_int);
-            switch (cmd) {
-                CASE_CMD(SET_PROPERTY);
-                CASE_CMD(LOAD_SCENE);
-                CASE_CMD(STOP);
-                CASE_CMD(FIRST_FRAME);
-            default: break;
-            }
+        if (auto* cmd = msg->command<Command>()) {
+            std::visit(
+                [this](const auto& c) {
+                    handle(c);
+                },
+                *cmd);
         }
     }
 
     void sendCmdLoadScene();
     void sendFirstFrameOk();
+    void sendPassTimes(std::vector<vulkan::PassTime>&);
+    void sendLoadReport(std::shared_ptr<LoadTiming>);
+    void sendSaveRecord(std::string path, std::shared_ptr<InputRecord>);
+    // from a job, dropped if the handler is gone
+    void sendBaked(std::string key);
+    // as the host would set it
+    void sendProperty(const InputRecord::Property&);
     bool isGenGraphviz() const { return m_gen_graphviz; }
 
+    // bumped from any thread before a source or assets change is posted, the number goes with it
+    uint32_t wantLoad() { return ++m_load_wanted; }
+    // a load for another number than the last wanted is dropped, on the main or render thread
+    bool loadSuperseded(uint32_t load) const { return load != m_load_wanted.load(); }
+
 private:
     void loadScene();
-
-    MHANDLER_CMD(LOAD_SCENE);
-    MHANDLER_CMD(SET_PROPERTY);
-    MHANDLER_CMD(STOP);
-    MHANDLER_CMD(FIRST_FRAME);
+    // false if the change needs a reload, else the drawn scene gets the new values
+    bool patchUserProps(const std::string& old_json);
+    // with reload it's parsed with the user properties and loaded once done, the drawn scene
+    // stays up meanwhile
+    void prefetchScene(const std::string& source, bool reload = false);
+    // the prefetched scene if it's of the current source, with its report
+    std::shared_ptr<Scene> takePrefetched(LoadReport&);
+    // of everything the frames of the current source depend on
+    std::string bakeKey() const;
+
+    void handle(const InitVulkan&);
+    void handle(const LoadScene&);
+    void handle(const SetProperty&);
+    void handle(const Stop&);
+    void handle(const FirstFrame&);
+    void handle(const PassTimes&);
+    void handle(const LoadDone&);
+    void handle(const SaveRecord&);
+    void handle(const Baked&);
 
 private:
     bool m_inited { false };
@@ -107,149 +369,1020 @@ private:
     std::string m_source;
     std::string m_cache_path;
     bool        m_gen_graphviz { false };
+    bool        m_tex_transcode { false };
+    int32_t     m_max_tex_size { 0 };
+    int32_t     m_preview { PREVIEW_OFF };
+    int32_t     m_quality { QUALITY_FULL };
+    int32_t     m_fillmode { (int32_t)FillMode::ASPECTCROP };
+    // the bake property, and the key of the loaded scene's bake while it's on
+    float       m_bake { 0.0f };
+    std::string m_bake_key;
+
+    std::atomic<uint32_t> m_load_wanted { 0 };
+    // of the last source or assets change handled
+    uint32_t m_load_for { 0 };
+    // of the running capture
+    std::string m_trace_path;
+    // of the running input record, and whether a replay runs, loads are seeded while either does
+    std::string        m_record_path;
+    bool               m_replaying { false };
+    std::optional<u64> m_input_seed;
 
     WPSceneParser                        m_scene_parser;
     std::unique_ptr<audio::SoundManager> m_sound_manager;
     FirstFrameCallback                   m_first_frame_callback;
+    PassTimesCallback                    m_pass_times_callback;
+    LoadReportCallback                   m_load_report_callback;
     std::string                          m_user_props_json;
+    // what the user properties were read for by the last parse
+    UserPropertyUses m_property_uses;
+
+    // a scene loaded in the background for a later source change
+    struct Prefetch {
+        std::string source;
+        std::string assets;
+        std::string cache_path;
+        bool        tex_transcode { false };
+        int32_t     max_tex_size { 0 };
+        bool        sounds { true };
+        int32_t     quality { QUALITY_FULL };
+        bool        bindless { false };
+        std::string user_props;
+        bool        reload { false };
+
+        WPSceneParser parser;
+        LoadReport    report;
+        // sounds are mounted here until the scene is taken
+        audio::SoundManager sound_manager;
+        // last, destroying it waits for the worker that uses the above
+        std::future<std::shared_ptr<Scene>> scene;
+    };
+    std::unique_ptr<Prefetch> m_prefetch;
 
 private:
     std::shared_ptr<looper::Looper> m_main_loop;
     std::shared_ptr<looper::Looper> m_render_loop;
     std::shared_ptr<RenderHandler>  m_render_handler;
 };
-// for macro
-using impl_MainHandler = MainHandler;
 
 class RenderHandler : public looper::Handler {
 public:
-    enum class CMD
-    {
-        CMD_INIT_VULKAN,
-        CMD_SET_SCENE,
-        CMD_SET_FILLMODE,
-        CMD_SET_SPEED,
-        CMD_STOP,
-        CMD_DRAW,
-        CMD_NO
+    struct InitVulkan {
+        std::shared_ptr<RenderInitInfo> info;
+    };
+    // the scene is drawn over its loop once it's compiled, if nothing keeps it from repeating
+    struct BakeRequest {
+        std::shared_ptr<WPBake> cache;
+        std::string             key;
+        // the bake property
+        double period { 0.0 };
+    };
+    struct SetScene {
+        std::shared_ptr<Scene>       scene;
+        std::shared_ptr<LoadTiming>  load;
+        uint32_t                     load_for { 0 };
+        std::shared_ptr<BakeRequest> bake {};
     };
+    struct PatchScene {
+        std::shared_ptr<Scene> scene;
+    };
+    struct SetFillMode {
+        FillMode mode { FillMode::ASPECTCROP };
+    };
+    struct SetSpeed {
+        float value { 1.0f };
+    };
+    // of what is set, the rest stays
+    struct SetProfiling {
+        std::optional<bool>    pass_times {};
+        std::optional<bool>    stats {};
+        std::optional<int32_t> stats_log {};
+        std::optional<bool>    dynamic_resolution {};
+    };
+    struct SetParticleRate {
+        int32_t rate { 0 };
+    };
+    struct SetLayerRates {
+        LayerRates rates;
+    };
+    struct SetPreview {
+        int32_t mode { PREVIEW_OFF };
+    };
+    struct SetTexRetain {
+        int32_t mb { 0 };
+    };
+    struct SetGpuPolicy {
+        int32_t policy { GPU_POLICY_COMPOSITOR };
+    };
+    // of what is set, the rest stays
+    struct SetPacing {
+        std::optional<int32_t> fps {};
+        std::optional<bool>    adaptive {};
+        std::optional<int32_t> hints {};
+    };
+    // dumps go to the dir, none with an empty one
+    struct SetWatchdog {
+        float       factor { 0.0f };
+        std::string dir;
+    };
+    struct CompileStep {
+        int32_t generation { 0 };
+    };
+    struct Resize {
+        int32_t width { 0 };
+        int32_t height { 0 };
+    };
+    struct DumpGraph {
+        std::string path;
+    };
+    struct Stop {
+        bool value { false };
+    };
+    struct SetVisible {
+        bool value { true };
+    };
+    // an empty path stops the running record
+    struct SetRecord {
+        std::string path;
+        u64         seed { 0 };
+    };
+    // null stops the replay
+    struct SetReplay {
+        std::shared_ptr<const InputRecord> record;
+    };
+    // set on the main thread, kept with the frame it comes before
+    struct RecordProperty {
+        std::string        name;
+        InputRecord::Value value;
+    };
+    struct Draw {};
+    using Command = std::variant<InitVulkan, SetScene, PatchScene, SetFillMode, SetSpeed,
+                                 SetProfiling, SetParticleRate, SetLayerRates, SetPreview,
+                                 SetTexRetain, SetGpuPolicy, SetPacing, SetWatchdog, CompileStep,
+                                 Resize, DumpGraph, Stop, SetVisible, SetRecord, SetReplay,
+                                 RecordProperty, Draw>;
+
     MainHandler& main_handler;
     RenderHandler(MainHandler& m)
         : main_handler(m), m_render(std::make_unique<vulkan::VulkanRender>()) {}
     virtual ~RenderHandler() {
         frame_timer.Stop();
+        syncSim();
+        savePerfProfile(true);
+        cancelBake();
+        looper::JobSystem::Shared().wait(m_bake_write);
         m_render->destroy();
+        looper::JobSystem::Shared().wait(m_release);
         LOG_INFO("render handler deleted");
     }
 
     void onMessageReceived(const std::shared_ptr<looper::Message>& msg) override {
-        int32_t cmd_int = (int32_t)CMD::CMD_NO;
-        if (msg->findInt32("cmd", &cmd_int)) {
-            CMD cmd = static_cast<CMD>(cmd_int);
-            switch (cmd) {
-                CASE_CMD(DRAW);
-                CASE_CMD(STOP);
-                CASE_CMD(SET_FILLMODE);
-                CASE_CMD(SET_SCENE);
-                CASE_CMD(SET_SPEED);
-                CASE_CMD(INIT_VULKAN);
-            default: break;
-            }
+        if (auto* cmd = msg->command<Command>()) {
+            std::visit(
+                [this](const auto& c) {
+                    handle(c);
+                },
+                *cmd);
         }
     }
 
-    ExSwapchain* exSwapchain() const { return m_render->exSwapchain(); }
+    // any thread, the renderer may be made again on another gpu meanwhile
+    ExSwapchain* exSwapchain() const { return m_ex_swapchain.load(); }
 
-    bool renderInited() const { return m_render->inited(); }
+    bool renderInited() const { return m_render_inited.load(); }
+    // any thread, what the scenes are parsed for, see VulkanRender::bindlessTextures
+    bool bindlessTextures() const { return m_bindless.load(); }
 
-    void setMousePos(double x, double y) { m_mouse_pos.store(std::array { (float)x, (float)y }); }
+    void setMousePos(double x, double y) {
+        m_mouse_pos.store(std::array { (float)x, (float)y });
+        // a throttled scene answers input right away
+        if (m_governor.Throttled()) frame_timer.Kick();
+    }
 
 private:
-    MHANDLER_CMD(STOP) {
-        bool stop { false };
-        if (msg->findBool("value", &stop)) {
-            if (stop)
-                frame_timer.Stop();
-            else
-                frame_timer.Run();
-        }
+    void handle(const Stop& cmd) {
+        m_stopped = cmd.value;
+        updateRunning();
+    }
+    void handle(const SetVisible& cmd) {
+        const bool visible = cmd.value;
+        if (visible == ! m_hidden) return;
+        m_hidden = ! visible;
+        updateRunning();
+        LOG_INFO("output %s", visible ? "shown, drawing" : "hidden, not drawing");
+        if (! visible) return;
+        // what's shown may be from before a resize or a scene switch while hidden
+        if (m_stopped || m_still) {
+            CreateCmdMsg<RenderHandler>(shared_from_this(), Draw {})->postCoalesced();
+        } else
+            frame_timer.Kick();
+    }
+    void updateRunning() {
+        if (m_stopped || m_hidden || m_still)
+            frame_timer.Stop();
+        else
+            frame_timer.Run();
     }
-    MHANDLER_CMD(DRAW) {
+    void handle(const SetWatchdog& cmd) {
+        m_watchdog.SetDumpDir(cmd.dir);
+        m_watchdog.SetFactor(cmd.factor);
+    }
+    void handle(const Draw&) {
+        TRACE_PHASE("frame");
+        platform::ApplyThreadClass(platform::ThreadClass::Frame);
+        auto start = std::chrono::steady_clock::now();
         frame_timer.FrameBegin();
-        if (m_rg) {
+        m_watchdog.FrameBegin(
+            std::chrono::microseconds(1000000 / std::max<u16>(frame_timer.RequiredFps(), 1)));
+        if (m_rg && ! m_compiling) {
+            // a still's frame once nothing more comes in is its last
+            const bool still = m_preview == PREVIEW_STILL && m_scene->first_frame_ok &&
+                               m_render->pipelinesReady() && m_render->texturesComplete();
             // LOG_INFO("frame info, fps: %.1f, frametime: %.1f", 1.0f, 1000.0f*m_scene->frameTime);
-            m_scene->shaderValueUpdater->FrameBegin();
-            {
-                auto pos = m_mouse_pos.load();
-                m_scene->shaderValueUpdater->MouseInput(pos[0], pos[1]);
-
-                // Update particle control points that follow the mouse
-                auto* wpUpdater =
-                    static_cast<WPShaderValueUpdater*>(m_scene->shaderValueUpdater.get());
-                auto mousePos = wpUpdater->GetMousePosition();
-                m_scene->paritileSys->UpdateMouseControlPoints(
-                    mousePos, { m_scene->ortho[0], m_scene->ortho[1] });
+            syncSim();
+            // the first frame of a scene, or the last one stopped before its passes updated
+            if (! m_simulated) {
+                simulate(simInput(m_advance));
+                m_advance = 0.0;
             }
-            m_scene->paritileSys->Emitt();
-
-            m_render->drawFrame(*m_scene);
-
-            m_scene->PassFrameTime(frame_timer.IdeaTime() * m_speed);
-
-            m_scene->shaderValueUpdater->FrameEnd();
+            m_simulated = false;
+            const bool capture = captureBake();
+
+            bool animating { false };
+            bool mouse_moved { m_mouse_moved };
+            // a static scene submits nothing until something changes
+            bool drawn = m_render->drawFrame(*m_scene, [this, &animating]() {
+                animating = m_scene->paritileSys->Animating();
+                m_scene->shaderValueUpdater->FrameEnd();
+                // the next frame simulates while this one records and submits, a bake's frames
+                // are its loop cut evenly
+                const bool baking = m_bake && m_bake->count > 0;
+                auto in = simInput(baking ? m_bake->frame_time : frame_timer.IdeaTime() * m_speed);
+                looper::JobSystem::Shared().run(m_sim, [this, in]() {
+                    simulate(in);
+                });
+                m_simulated = true;
+            });
+            if (! m_simulated) m_advance = frame_timer.IdeaTime() * m_speed;
             // fps_counter.RegisterFrame();
+            if (capture && ! drawn && m_bake) {
+                LOG_INFO("bake frame not drawn, bake dropped");
+                cancelBake();
+            }
 
-            if (! m_scene->first_frame_ok) {
+            if (drawn && ! m_scene->first_frame_ok) {
                 m_scene->first_frame_ok = true;
                 main_handler.sendFirstFrameOk();
             }
+            if (m_load) finishLoadReport(drawn);
+            if (drawn && m_profiling) reportPassTimes();
+
+            FrameActivity activity { FrameActivity::Static };
+            if (drawn) {
+                activity = mouse_moved || animating ? FrameActivity::Full : FrameActivity::Slow;
+            }
+            if (m_frame_stats) {
+                recordFrame(drawn, start);
+                if (m_stats_log.count() > 0) logFrameStats();
+            }
+            if (drawn) savePerfProfile(false);
+            applyFps(m_governor.Frame(activity, std::chrono::steady_clock::now()));
+            if (still && ! m_still) {
+                m_still = true;
+                updateRunning();
+                LOG_INFO("preview drawn, stopped");
+            }
         }
+        m_watchdog.FrameEnd();
         frame_timer.FrameEnd();
     }
-    MHANDLER_CMD(SET_FILLMODE) {
-        int32_t value;
-        if (msg->findInt32("value", &value)) {
-            m_fillmode = (FillMode)value;
-            if (m_scene && renderInited()) {
-                m_render->UpdateCameraFillMode(*m_scene, m_fillmode);
+    // the next frame of a started bake is read back, true if one was asked for
+    bool captureBake() {
+        if (! m_bake) return false;
+        auto& bake = *m_bake;
+        if (! bake.started) {
+            if (! m_scene->first_frame_ok || ! m_render->pipelinesReady() ||
+                ! m_render->texturesComplete())
+                return false;
+            bake.started = true;
+        }
+        // the first one is only read for the size, the loop starts at the one after
+        const bool  probe = bake.count == 0;
+        const usize index = probe ? 0 : bake.captured++;
+        m_render->captureNextFrame(
+            [this, weak = std::weak_ptr(m_bake), probe, index](
+                std::span<const uint8_t> rgba, uint32_t width, uint32_t height) {
+                auto bake = weak.lock();
+                if (! bake || bake != m_bake) return;
+                if (probe) {
+                    sizeBake(width, height);
+                    return;
+                }
+                if (width != bake->width || height != bake->height) {
+                    LOG_INFO("bake frame of another size, bake dropped");
+                    cancelBake();
+                    return;
+                }
+                encodeBakeFrame(rgba, index);
+            });
+        return true;
+    }
+    // the frame count of the loop, as many as the budget takes at this size
+    void sizeBake(u32 width, u32 height) {
+        auto&       bake  = *m_bake;
+        const usize size  = MipDataSize(TextureFormat::BC1, (i32)width, (i32)height);
+        const usize fit   = size > 0 ? bake_budget / size : 0;
+        const usize count = std::min<usize>(
+            { (usize)std::lround(bake.period * bake_fps), bake_max_frames, fit });
+        if ((double)count < bake.period * bake_min_fps) {
+            LOG_INFO("a bake of %ux%u over %.2fs would be too choppy, not baked",
+                     width,
+                     height,
+                     bake.period);
+            m_bake.reset();
+            return;
+        }
+        bake.width      = width;
+        bake.height     = height;
+        bake.count      = count;
+        bake.frame_time = bake.period / (double)count;
+        bake.frames.resize(count);
+        LOG_INFO("baking %zu frames of %ux%u over %.2fs", count, width, height, bake.period);
+    }
+    // bc1 on a job, the last frame writes the bake
+    void encodeBakeFrame(std::span<const uint8_t> rgba, usize index) {
+        auto                 bake = m_bake;
+        std::vector<uint8_t> pixels(rgba.begin(), rgba.end());
+        auto                 encode = [bake, index, pixels = std::move(pixels)]() mutable {
+            // what a layer left translucent is drawn over black anyway
+            for (usize i = 3; i < pixels.size(); i += 4) pixels[i] = 255;
+            const i32 w = (i32)bake->width, h = (i32)bake->height;
+            auto&     out = bake->frames[index];
+            out.resize(MipDataSize(TextureFormat::BC1, w, h));
+            if (! EncodeBc(TextureFormat::BC1, pixels.data(), w, h, out.data())) out.clear();
+        };
+        looper::JobSystem::Shared().run(bake->encode, std::move(encode));
+        // frames waiting for an encode hold their pixels, a few at most
+        if (index % bake_encode_batch == bake_encode_batch - 1)
+            looper::JobSystem::Shared().wait(bake->encode);
+        if (index + 1 < bake->count) return;
+
+        looper::JobSystem::Shared().wait(bake->encode);
+        m_bake.reset();
+        looper::JobSystem::Shared().run(m_bake_write, [this, bake]() {
+            TRACE_ZONE("writeBake");
+            auto& req = *bake->request;
+            if (req.cache->Write(
+                    req.key, bake->width, bake->height, bake->frame_time, bake->frames))
+                main_handler.sendBaked(req.key);
+        });
+    }
+    // the compiled scene is baked if it repeats and nothing outside it moves it
+    void beginBake(std::shared_ptr<BakeRequest> request) {
+        const char* refused { nullptr };
+        auto*       updater = static_cast<WPShaderValueUpdater*>(m_scene->shaderValueUpdater.get());
+        const auto  motion  = m_render->graphMotion();
+        double      period  = request->period;
+        if (! m_scene->paritileSys->subsystems.empty())
+            refused = "it has particles";
+        else if (motion.live)
+            refused = "it follows the mouse or audio";
+        else if (updater->CameraParallax().enable)
+            refused = "it has parallax";
+        else if (period <= 0.0) {
+            if (motion.time) {
+                refused = "shaders move with time, the bake property has to give the loop";
+            } else {
+                std::vector<double> periods;
+                for (auto& [_, tex] : m_scene->textures)
+                    if (tex.isSprite) periods.push_back(tex.spriteAnim.period());
+                updater->AnimationPeriods(periods);
+                if (periods.empty()) refused = "nothing in it moves";
+                period = WPBake::CommonPeriod(periods, bake_max_period);
+                if (! refused && period <= 0.0) refused = "its loop is too long";
             }
         }
+        if (refused) {
+            LOG_INFO("scene not baked, %s", refused);
+            return;
+        }
+        m_bake          = std::make_shared<Bake>();
+        m_bake->request = std::move(request);
+        m_bake->period  = period;
     }
-    MHANDLER_CMD(SET_SCENE) {
-        if (msg->findObject("scene", &m_scene)) {
-            if (m_rg) m_render->clearLastRenderGraph();
-            m_rg = sceneToRenderGraph(*m_scene);
-
-            if (main_handler.isGenGraphviz()) m_rg->ToGraphviz("graph.dot");
-            m_render->compileRenderGraph(*m_scene, *m_rg);
-            m_render->UpdateCameraFillMode(*m_scene, m_fillmode);
+    void cancelBake() {
+        if (! m_bake) return;
+        looper::JobSystem::Shared().wait(m_bake->encode);
+        m_bake.reset();
+    }
+    // what the simulation reads from outside the scene, taken on the render thread
+    struct SimInput {
+        // seconds the scene moves on first, the time the last frame took
+        double               advance { 0.0 };
+        double               frame_time { 0.0 };
+        double               budget { 0.0 };
+        std::array<float, 2> mouse_pos;
+    };
+    SimInput simInput(double advance) {
+        SimInput in { .advance    = advance,
+                      .frame_time = frame_timer.FrameTime(),
+                      .budget     = 1.0 / frame_timer.RequiredFps(),
+                      .mouse_pos  = m_mouse_pos.load() };
+        if (m_replay) replayInput(in);
+        if (m_record) {
+            m_record->frames.push_back({ .advance    = in.advance,
+                                         .frame_time = in.frame_time,
+                                         .budget     = in.budget,
+                                         .mouse      = in.mouse_pos });
         }
+        return in;
     }
-    MHANDLER_CMD(SET_SPEED) { msg->findFloat("value", &m_speed); }
-    MHANDLER_CMD(INIT_VULKAN) {
-        std::shared_ptr<RenderInitInfo> info;
-        if (msg->findObject("info", &info)) {
-            m_render->init(*info);
-
-            // inited, callback to laod scene
+    // the record's frame in place of the timer's and the mouse, its properties go out first
+    void replayInput(SimInput& in) {
+        auto& record = *m_replay;
+        for (; m_replay_props < record.properties.size() &&
+               record.properties[m_replay_props].frame <= m_replay_frame;
+             m_replay_props++) {
+            main_handler.sendProperty(record.properties[m_replay_props]);
+        }
+        if (m_replay_frame >= record.frames.size()) {
+            LOG_INFO("input replay done, %d frames", (int)m_replay_frame);
+            m_replay.reset();
+            return;
+        }
+        auto& f = record.frames[m_replay_frame++];
+        in      = { .advance    = f.advance,
+                    .frame_time = f.frame_time,
+                    .budget     = f.budget,
+                    .mouse_pos  = f.mouse };
+    }
+    void handle(const SetRecord& cmd) {
+        if (m_record) {
+            LOG_INFO("input record stopped, %d frames", (int)m_record->frames.size());
+            main_handler.sendSaveRecord(std::move(m_record_path), std::move(m_record));
+        }
+        m_record_path = cmd.path;
+        if (m_record_path.empty()) return;
+        m_record       = std::make_shared<InputRecord>();
+        m_record->seed = cmd.seed;
+        LOG_INFO("input record started");
+    }
+    void handle(const SetReplay& cmd) {
+        m_replay       = cmd.record;
+        m_replay_frame = 0;
+        m_replay_props = 0;
+        if (m_replay) LOG_INFO("input replay of %d frames", (int)m_replay->frames.size());
+    }
+    void handle(const RecordProperty& cmd) {
+        // what is set before is the host's setup, a replaying host does it itself
+        if (! m_record || m_record->frames.empty()) return;
+        m_record->properties.push_back(
+            { .frame = m_record->frames.size(), .name = cmd.name, .value = cmd.value });
+    }
+    // everything cpu side a frame shows, the passes take it from the scene when they update
+    void simulate(const SimInput& in) {
+        TRACE_PHASE("simulate");
+        m_scene->PassFrameTime(in.advance);
+        m_scene->shaderValueUpdater->FrameBegin();
+
+        m_mouse_moved    = in.mouse_pos != m_last_mouse_pos;
+        m_last_mouse_pos = in.mouse_pos;
+        m_scene->shaderValueUpdater->MouseInput(in.mouse_pos[0], in.mouse_pos[1]);
+
+        // Update particle control points that follow the mouse
+        auto* wpUpdater = static_cast<WPShaderValueUpdater*>(m_scene->shaderValueUpdater.get());
+        auto  mousePos  = wpUpdater->GetMousePosition();
+        m_scene->paritileSys->UpdateMouseControlPoints(mousePos,
+                                                       { m_scene->ortho[0], m_scene->ortho[1] });
+
+        m_scene->paritileSys->UpdateBudget(in.frame_time, in.budget);
+        m_scene->paritileSys->Emitt();
+    }
+    // once the first frame was submitted and the pipelines are made
+    void finishLoadReport(bool drawn) {
+        auto  now    = std::chrono::steady_clock::now();
+        auto& report = m_load->report;
+        if (drawn && ! m_load_drawn) {
+            m_load_drawn        = true;
+            report.first_submit = Millis(now - m_drawable);
+            report.total        = Millis(now - m_load->start);
+        }
+        if (! m_load_drawn || ! m_render->pipelinesReady()) return;
+        report.pipelines = Millis(now - m_compile_begin);
+        main_handler.sendLoadReport(std::move(m_load));
+    }
+    // before anything else touches the scene
+    void syncSim() { looper::JobSystem::Shared().wait(m_sim); }
+    // a big scene takes a while to free, it's not done on the render thread, nor is its graph
+    // with the passes, which point into it
+    void releaseScene(std::shared_ptr<Scene> scene, std::unique_ptr<rg::RenderGraph> rg = nullptr) {
+        if (! scene) return;
+        std::shared_ptr<rg::RenderGraph> graph = std::move(rg);
+        looper::JobSystem::Shared().run(
+            m_release, [scene = std::move(scene), graph = std::move(graph)]() mutable {
+                TRACE_ZONE("releaseScene");
+                graph.reset();
+                scene.reset();
+            });
+    }
+    void applyFps(u16 fps) {
+        if (fps != frame_timer.RequiredFps()) frame_timer.SetRequiredFps(fps);
+    }
+    void handle(const SetPacing& cmd) {
+        if (cmd.fps) {
+            m_governor.SetTarget((u16)*cmd.fps);
+            updateGpuBudget();
+        }
+        if (cmd.adaptive) m_governor.SetAdaptive(*cmd.adaptive);
+        if (cmd.hints) {
+            const int32_t hints = *cmd.hints;
+            m_on_battery        = (hints & POWER_HINT_ON_BATTERY) != 0;
+            m_governor.SetHints({ .on_battery = m_on_battery,
+                                  .covered    = (hints & POWER_HINT_COVERED) != 0,
+                                  .locked     = (hints & POWER_HINT_LOCKED) != 0 });
+            updateGpu();
+        }
+        u16 last = frame_timer.RequiredFps();
+        applyFps(m_governor.Fps());
+        // don't sit out what is left of a wait at the old rate
+        if (frame_timer.RequiredFps() > last) frame_timer.Kick();
+    }
+    void handle(const SetFillMode& cmd) {
+        syncSim();
+        bool fitted = m_fillmode == FillMode::ASPECTFIT;
+        m_fillmode  = cmd.mode;
+        // a fitted view shows more than the layers covering the scene's size
+        if (m_scene && fitted != (m_fillmode == FillMode::ASPECTFIT)) {
+            LOG_INFO("fill mode changed what's in view, reloading");
             main_handler.sendCmdLoadScene();
+            return;
+        }
+        // else taken once compiled
+        if (m_scene && renderInited() && ! m_compiling) {
+            m_render->UpdateCameraFillMode(*m_scene, m_fillmode);
+        }
+    }
+    void handle(const SetScene& cmd) {
+        auto scene = cmd.scene;
+        if (! scene) return;
+        if (main_handler.loadSuperseded(cmd.load_for)) {
+            // a newer scene is on its way, the drawn one stays till then
+            LOG_INFO("scene superseded before compiling, dropped");
+            releaseScene(std::move(scene));
+            return;
+        }
+        syncSim();
+        m_simulated = false;
+        m_advance   = 0.0;
+        cancelBake();
+        m_bake_request = cmd.bake;
+        if (std::exchange(m_still, false)) updateRunning();
+        // the passes point into the old scene till cleared
+        if (m_rg) m_render->clearLastRenderGraph();
+        // the passes take their rate when the graph is made
+        scene->layerRates    = m_layer_rates.layers;
+        scene->timeLayerRate = m_layer_rates.time_rate;
+        savePerfProfile(true);
+        auto old_rg = std::exchange(m_rg,
+                                    sceneToRenderGraph(*scene, m_fillmode != FillMode::ASPECTFIT));
+        releaseScene(std::exchange(m_scene, scene), std::move(old_rg));
+        loadPerfProfile();
+
+        m_load          = cmd.load;
+        m_load_drawn    = false;
+        m_compile_begin = std::chrono::steady_clock::now();
+        if (m_load) m_load->report.vulkan_init = std::exchange(m_vulkan_init, 0.0);
+
+        if (main_handler.isGenGraphviz()) m_rg->ToGraphviz("graph.dot");
+        // in steps, urgent messages and a newer scene don't wait for all of it
+        m_render->beginCompile(*m_scene, *m_rg);
+        m_compiling = true;
+        m_compile_generation++;
+        postCompileStep();
+    }
+    // where the adaptive systems settled on the last run of the scene on this gpu, they start there
+    void loadPerfProfile() {
+        m_perf_gpu_ms     = 0.0;
+        m_perf_frames     = 0;
+        m_perf_checked    = std::chrono::steady_clock::now();
+        m_perf_saved      = {};
+        // a preview's run says nothing of the scene at full size
+        m_perf = m_preview == PREVIEW_OFF ? WPPerfProfiles::FromVfs(*m_scene->vfs) : nullptr;
+        WPPerfProfile profile;
+        if (m_perf) {
+            m_perf_key = WPPerfProfiles::Key(m_scene->scene_id, m_render->gpuUuid());
+            if (m_perf->Load(m_perf_key, profile)) {
+                m_perf_saved = profile;
+                LOG_INFO("perf profile of \"%s\": scale %.3f, particle lod %.2f, %u fps",
+                         m_scene->scene_id.c_str(),
+                         profile.res_scale,
+                         profile.particle_lod,
+                         (unsigned)profile.fps);
+            }
+        }
+        m_render->setStartScale(profile.res_scale);
+        m_scene->paritileSys->SetLod(profile.particle_lod);
+        if (m_preview != PREVIEW_OFF) m_scene->paritileSys->SetLodCap(preview_particle_lod);
+        m_governor.SetLimit(profile.fps);
+    }
+    // every while on the render thread, and for the scene replaced, if it moved off the saved one
+    void savePerfProfile(bool now) {
+        if (! m_perf || ! m_scene) return;
+        double gpu_ms { 0.0 };
+        if (! now && m_render->gpuFrameTime(gpu_ms)) {
+            m_perf_gpu_ms += gpu_ms;
+            m_perf_frames++;
+        }
+        auto at = std::chrono::steady_clock::now();
+        if (! now && at - m_perf_checked < perf_save_interval) return;
+        m_perf_checked = at;
+
+        WPPerfProfile profile { .res_scale    = m_render->resolutionScale(),
+                                .particle_lod = m_scene->paritileSys->Lod(),
+                                .fps          = m_perf_saved.fps };
+        if (m_perf_frames > 0 && m_perf_gpu_ms > 0.0) {
+            double fps  = 1000.0 * m_perf_frames / m_perf_gpu_ms;
+            profile.fps = (u16)std::clamp(fps, 1.0, 1000.0);
+        }
+        m_perf_gpu_ms = 0.0;
+        m_perf_frames = 0;
+        // small moves of the lod and the fps aren't worth a write
+        auto& saved = m_perf_saved;
+        if (profile.res_scale == saved.res_scale &&
+            std::abs(profile.particle_lod - saved.particle_lod) < 0.05f &&
+            std::abs((int)profile.fps - (int)saved.fps) <= (int)saved.fps / 10)
+            return;
+        m_perf->Save(m_perf_key, profile);
+        m_perf_saved = profile;
+    }
+    void postCompileStep() {
+        CreateCmdMsg<RenderHandler>(shared_from_this(), CompileStep { m_compile_generation })
+            ->post();
+    }
+    void handle(const CompileStep& cmd) {
+        // one of a compile a later scene dropped
+        if (! m_compiling || cmd.generation != m_compile_generation) return;
+        if (! m_render->compileStep(compile_step_budget)) {
+            postCompileStep();
+            return;
+        }
+        m_compiling = false;
+        m_drawable  = std::chrono::steady_clock::now();
+        if (m_load) m_load->report.graph_compile = Millis(m_drawable - m_compile_begin);
+        m_render->UpdateCameraFillMode(*m_scene, m_fillmode);
+        m_scene->paritileSys->SetSimRate(m_particle_rate);
+        if (m_bake_request) beginBake(std::move(m_bake_request));
+    }
+    void handle(const Resize& cmd) {
+        if (cmd.width <= 0 || cmd.height <= 0 || ! renderInited()) return;
+        syncSim();
+        if (! m_render->resize(m_scene.get(), m_rg.get(), (u32)cmd.width, (u32)cmd.height)) return;
+        if (m_bake) {
+            LOG_INFO("resized while baking, bake dropped");
+            cancelBake();
+        }
+        if (m_compiling) {
+            // the compile began again, steps of the old one are dropped
+            m_compile_generation++;
+            postCompileStep();
+            return;
+        }
+        if (m_scene && m_rg) m_render->UpdateCameraFillMode(*m_scene, m_fillmode);
+        // a still draws again at the new size
+        if (std::exchange(m_still, false)) updateRunning();
+        frame_timer.Kick();
+    }
+    // the scene parsed again with other user properties, its values go into the drawn one if
+    // nothing else differs
+    void handle(const PatchScene& cmd) {
+        if (! cmd.scene) return;
+        syncSim();
+        usize patched { 0 };
+        if (m_scene && m_rg && ! m_compiling &&
+            wallpaper::PatchScene(*m_scene, *cmd.scene, patched)) {
+            m_render->reloadConstants();
+            LOG_INFO("user properties patched %zu values", patched);
+            return;
+        }
+        LOG_INFO("user properties changed the scene, reloading");
+        main_handler.sendCmdLoadScene();
+    }
+    void handle(const SetSpeed& cmd) { m_speed = cmd.value; }
+    void handle(const SetParticleRate& cmd) {
+        syncSim();
+        m_particle_rate = (u32)std::max(cmd.rate, 0);
+        if (m_scene) m_scene->paritileSys->SetSimRate(m_particle_rate);
+    }
+    void handle(const SetLayerRates& cmd) {
+        if (cmd.rates == m_layer_rates) return;
+        m_layer_rates = cmd.rates;
+        if (m_scene) main_handler.sendCmdLoadScene();
+    }
+    void handle(const SetPreview& cmd) {
+        m_preview = cmd.mode;
+        // from the next scene on
+        m_render->setTextureLevelBias(m_preview != PREVIEW_OFF ? preview_level_bias : 0);
+        if (m_preview != PREVIEW_STILL && std::exchange(m_still, false)) updateRunning();
+    }
+    void handle(const SetTexRetain& cmd) {
+        m_render->setTextureRetainBudget((u64)std::max(cmd.mb, 0) * 1024 * 1024);
+    }
+    void handle(const SetGpuPolicy& cmd) {
+        m_gpu_policy = std::clamp(cmd.policy, GPU_POLICY_COMPOSITOR, GPU_POLICY_DISCRETE);
+        updateGpu();
+    }
+    // what the policy picks now, matching the compositor means nothing without its uuid
+    int32_t gpuPolicy(const RenderInitInfo& info) const {
+        if (m_gpu_policy == GPU_POLICY_COMPOSITOR && info.uuid.empty() && m_on_battery)
+            return GPU_POLICY_INTEGRATED;
+        return m_gpu_policy;
+    }
+    // the scene is loaded again on the gpu the policy picks, if another than the one it's on
+    void updateGpu() {
+        if (! m_init_info || ! renderInited()) return;
+        auto&         info   = *m_init_info;
+        const int32_t policy = gpuPolicy(info);
+        if (policy == info.gpu_policy) return;
+        if (info.offscreen) {
+            LOG_INFO("gpu policy %d not taken, the host holds images of this gpu", policy);
+            return;
+        }
+        LOG_INFO("gpu policy %d to %d, making the renderer again", info.gpu_policy, policy);
+        syncSim();
+        savePerfProfile(true);
+        if (m_rg) m_render->clearLastRenderGraph();
+        m_compiling = false;
+        releaseScene(std::exchange(m_scene, nullptr), std::move(m_rg));
+
+        info.gpu_policy = policy;
+        initRender(true);
+    }
+    // then the scene loads, on the new device if it was made again
+    void initRender(bool again) {
+        m_render_inited = false;
+        m_ex_swapchain  = nullptr;
+        m_bindless      = false;
+        auto begin      = std::chrono::steady_clock::now();
+        if (again)
+            m_render->reinit(*m_init_info);
+        else
+            m_render->init(*m_init_info);
+        m_vulkan_init = Millis(std::chrono::steady_clock::now() - begin);
+        // the profiler and scaler of a new device start off
+        m_render->setProfiling(m_profiling || m_frame_stats || m_dynamic_resolution);
+        updateGpuBudget();
+        m_ex_swapchain  = m_render->exSwapchain();
+        m_bindless      = m_render->bindlessTextures();
+        m_render_inited = m_render->inited();
+
+        // inited, callback to laod scene
+        main_handler.sendCmdLoadScene();
+    }
+    void handle(const SetProfiling& cmd) {
+        if (cmd.pass_times) {
+            m_profiling       = *cmd.pass_times;
+            m_profiled_frames = 0;
+        }
+        if (cmd.stats && *cmd.stats != m_frame_stats) {
+            frame_stats.Reset();
+            m_last_present = 0;
+            m_frame_stats  = *cmd.stats;
+        }
+        if (cmd.stats_log) m_stats_log = std::chrono::seconds(std::max(*cmd.stats_log, 0));
+        if (cmd.dynamic_resolution) m_dynamic_resolution = *cmd.dynamic_resolution;
+        updateGpuBudget();
+        // the next log covers a whole window
+        if (cmd.stats || cmd.stats_log) {
+            m_stats_logged = std::chrono::steady_clock::now();
+            m_stats_snaps  = frame_stats.Read();
+        }
+        m_render->setProfiling(m_profiling || m_frame_stats || m_dynamic_resolution);
+    }
+    // of the fps asked for, frames throttled for a lack of activity have time to spare anyway
+    void updateGpuBudget() {
+        double ms = 1000.0 / std::max<u16>(m_governor.Target(), 1);
+        m_render->setGpuBudget(m_dynamic_resolution ? ms : 0.0);
+    }
+    // on the render thread, before the fps of the next frame is picked
+    void recordFrame(bool drawn, std::chrono::steady_clock::time_point start) {
+        using namespace std::chrono;
+        auto deadline      = microseconds(1000000 / std::max<u16>(frame_timer.RequiredFps(), 1));
+        m_present_deadline = deadline * 3 / 2;
+        if (! drawn) {
+            // the next present follows a pause, not a frame
+            m_last_present = 0;
+            return;
+        }
+        frame_stats.cpu.Record(duration_cast<microseconds>(steady_clock::now() - start), deadline);
+        double gpu_ms { 0.0 };
+        if (m_render->gpuFrameTime(gpu_ms)) {
+            frame_stats.gpu.Record(microseconds((i64)(gpu_ms * 1000.0)), deadline);
+        }
+    }
+    // from the presented callback
+    void recordPresent() {
+        using namespace std::chrono;
+        if (! m_frame_stats) return;
+        i64 now  = steady_clock::now().time_since_epoch().count();
+        i64 last = m_last_present.exchange(now);
+        if (last == 0) return;
+        auto interval = duration_cast<microseconds>(steady_clock::duration(now - last));
+        frame_stats.present.Record(interval, m_present_deadline.load());
+    }
+    // what the windows since the last log recorded
+    void logFrameStats() {
+        auto now = std::chrono::steady_clock::now();
+        if (now - m_stats_logged < m_stats_log) return;
+        m_stats_logged = now;
+
+        constexpr std::array names { "cpu", "gpu", "present" };
+        auto                 snaps = frame_stats.Read();
+        for (usize i = 0; i < snaps.size(); i++) {
+            auto st = Summarize(snaps[i].Since(m_stats_snaps[i]));
+            if (st.count == 0) continue;
+            LOG_INFO("frame %s, last %ds: n %lu, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f ms, "
+                     "missed %lu",
+                     names[i],
+                     (int)m_stats_log.count(),
+                     (unsigned long)st.count,
+                     st.p50,
+                     st.p95,
+                     st.p99,
+                     st.max,
+                     (unsigned long)st.missed);
+        }
+        m_stats_snaps = snaps;
+    }
+    void reportPassTimes() {
+        if (++m_profiled_frames < pass_times_interval) return;
+        std::vector<vulkan::PassTime> times;
+        if (! m_render->passTimes(times)) return;
+        m_profiled_frames = 0;
+        if (main_handler.isGenGraphviz()) {
+            annotateGraph(times);
+            m_rg->ToGraphviz("graph.dot");
+        }
+        main_handler.sendPassTimes(times);
+    }
+    void annotateGraph(std::span<const vulkan::PassTime> times) {
+        for (auto& t : times) {
+            if (! t.node) continue;
+            auto* node = m_rg->getPassNode(*t.node);
+            node->setGpuTime(t.gpu_ms);
+            node->setCpuTime(t.cpu_ms);
+        }
+        m_render->annotateGraph(*m_rg);
+    }
+    // the drawn graph as it is now, a graph still compiling has no targets to tell of yet
+    void handle(const DumpGraph& cmd) {
+        const auto& path = cmd.path;
+        if (path.empty()) return;
+        if (! m_rg || m_compiling) {
+            LOG_ERROR("no compiled render graph to dump to \"%s\"", path.c_str());
+            return;
+        }
+        std::vector<vulkan::PassTime> times;
+        if (! m_render->passTimes(times)) times.clear();
+        annotateGraph(times);
+        m_rg->ToGraphviz(path + ".dot");
+        m_rg->ToJson(path + ".json");
+        LOG_INFO("render graph dumped to \"%s\"", path.c_str());
+    }
+    void handle(const InitVulkan& cmd) {
+        if (auto& info = cmd.info) {
+            m_render->setPresentedCallback([this]() {
+                frame_timer.FramePresented();
+                recordPresent();
+            });
+            info->gpu_policy = gpuPolicy(*info);
+            m_init_info      = info;
+            initRender(false);
         }
     }
 
 public:
     FrameTimer frame_timer;
     FpsCounter fps_counter;
+    // recorded with frame_stats, read from any thread
+    FrameStats frame_stats;
 
 private:
     std::shared_ptr<Scene> m_scene { nullptr };
     float                  m_speed { 1.0f };
+    u32                    m_particle_rate { 0 };
+    LayerRates             m_layer_rates;
+    // frames are timed while neither paused nor hidden, nor a still preview that was drawn
+    bool m_stopped { false };
+    bool m_hidden { false };
+    bool m_still { false };
+
+    // a PREVIEW_ mode, the particles a preview keeps at most and the levels cut off its textures
+    // past what its size needs
+    int32_t                m_preview { PREVIEW_OFF };
+    static constexpr float preview_particle_lod { 0.25f };
+    static constexpr u32   preview_level_bias { 1 };
+
+    // drawn frames between two pass time reports
+    static constexpr u32 pass_times_interval { 60 };
+    // a compile step yields to queued messages after it
+    static constexpr std::chrono::milliseconds compile_step_budget { 10 };
+    // the scene's graph is compiled in steps till done, steps of older compiles are dropped
+    bool    m_compiling { false };
+    int32_t m_compile_generation { 0 };
+    bool                 m_profiling { false };
+    u32                  m_profiled_frames { 0 };
+    // targets scale with the gpu time against the target fps
+    bool m_dynamic_resolution { false };
+
+    std::atomic<bool> m_frame_stats { false };
+    // steady clock ticks of the last present, 0 if the frame before wasn't drawn
+    std::atomic<i64>                       m_last_present { 0 };
+    std::atomic<std::chrono::microseconds> m_present_deadline { std::chrono::microseconds(0) };
+    // logged windows, their start and what was read then
+    std::chrono::seconds                    m_stats_log { 0 };
+    std::chrono::steady_clock::time_point   m_stats_logged;
+    std::array<FrameHistogram::Snapshot, 3> m_stats_snaps;
 
     std::unique_ptr<vulkan::VulkanRender> m_render;
     std::unique_ptr<rg::RenderGraph>      m_rg { nullptr };
+    // of the renderer, kept to make it again on another gpu
+    std::shared_ptr<RenderInitInfo> m_init_info;
+    std::atomic<bool>               m_render_inited { false };
+    std::atomic<ExSwapchain*>       m_ex_swapchain { nullptr };
+    std::atomic<bool>               m_bindless { false };
+    int32_t                         m_gpu_policy { GPU_POLICY_COMPOSITOR };
+    bool                            m_on_battery { false };
 
     FillMode m_fillmode { FillMode::ASPECTCROP };
 
     std::atomic<std::array<float, 2>> m_mouse_pos { std::array { 0.5f, 0.5f } };
+    FpsGovernor                       m_governor;
+    StallWatchdog                     m_watchdog;
+
+    // of the scene, null without a cache folder
+    static constexpr std::chrono::seconds perf_save_interval { 10 };
+    std::unique_ptr<WPPerfProfiles>       m_perf;
+    std::string                           m_perf_key;
+    WPPerfProfile                         m_perf_saved;
+    double                                m_perf_gpu_ms { 0.0 };
+    u32                                   m_perf_frames { 0 };
+    std::chrono::steady_clock::time_point m_perf_checked;
+
+    // the next frame's simulation, see simulate
+    looper::JobGroup m_sim { looper::JobPriority::Frame };
+    // scenes replaced by later ones being freed
+    looper::JobGroup m_release;
+
+    // of the scene till its report went out
+    std::shared_ptr<LoadTiming>           m_load;
+    std::chrono::steady_clock::time_point m_compile_begin;
+    std::chrono::steady_clock::time_point m_drawable;
+    bool                                  m_load_drawn { false };
+    // milliseconds, taken by the next report
+    double m_vulkan_init { 0.0 };
+    // the scene holds a simulated frame not drawn yet, or the job making it
+    bool m_simulated { false };
+    // to pass before the next simulation started from the draw
+    double m_advance { 0.0 };
+    // simulation only
+    std::array<float, 2> m_last_mouse_pos { 0.5f, 0.5f };
+    bool                 m_mouse_moved { false };
+
+    // frames taken from outside are written into the record, or read from the replay
+    std::shared_ptr<InputRecord>       m_record;
+    std::string                        m_record_path;
+    std::shared_ptr<const InputRecord> m_replay;
+    usize                              m_replay_frame { 0 };
+    usize                              m_replay_props { 0 };
+
+    // a loop at most, frames a second and at least, and memory of the compressed frames
+    static constexpr double bake_max_period { 30.0 };
+    static constexpr double bake_fps { 30.0 };
+    static constexpr double bake_min_fps { 10.0 };
+    static constexpr usize  bake_max_frames { 256 };
+    static constexpr usize  bake_budget { 256ull << 20 };
+    // frames read back before their encodes are waited for
+    static constexpr usize bake_encode_batch { 8 };
+    // of the scene being baked, its frames are encoded on jobs as they're read back
+    struct Bake {
+        std::shared_ptr<BakeRequest> request;
+        double                       period { 0.0 };
+        bool                         started { false };
+        // known once the first frame was read
+        u32    width { 0 };
+        u32    height { 0 };
+        usize  count { 0 };
+        double frame_time { 0.0 };
+        usize  captured { 0 };
+
+        std::vector<std::vector<uint8_t>> frames;
+        looper::JobGroup                  encode;
+    };
+    // of the scene compiling, then of the one drawn
+    std::shared_ptr<BakeRequest> m_bake_request;
+    std::shared_ptr<Bake>        m_bake;
+    // bakes being written, waited for before the handler goes
+    looper::JobGroup m_bake_write;
 };
 } // namespace wallpaper
 
@@ -275,33 +1408,55 @@ bool SceneWallpaper::init() { return m_main_handler->init(); }
 void SceneWallpaper::initVulkan(const RenderInitInfo& info) {
     m_offscreen                             = info.offscreen;
     std::shared_ptr<RenderInitInfo> sp_info = std::make_shared<RenderInitInfo>(info);
-    auto                            msg =
-        CreateMsgWithCmd(m_main_handler->renderHandler(), RenderHandler::CMD::CMD_INIT_VULKAN);
-    msg->setObject("info", sp_info);
-    msg->post();
+    // through the main handler, which knows the cache folder
+    CreateCmdMsg<MainHandler>(m_main_handler, MainHandler::InitVulkan { sp_info })->post();
 }
 
 void SceneWallpaper::play() {
-    auto msg = CreateMsgWithCmd(m_main_handler, MainHandler::CMD::CMD_STOP);
-    msg->setBool("value", false);
-    msg->post();
+    CreateCmdMsg<MainHandler>(m_main_handler, MainHandler::Stop { false })->post();
 }
 void SceneWallpaper::pause() {
-    auto msg = CreateMsgWithCmd(m_main_handler, MainHandler::CMD::CMD_STOP);
-    msg->setBool("value", true);
-    msg->post();
+    CreateCmdMsg<MainHandler>(m_main_handler, MainHandler::Stop { true })->post();
+}
+
+void SceneWallpaper::setVisible(bool visible) {
+    CreateCmdMsg<RenderHandler>(m_main_handler->renderHandler(),
+                                RenderHandler::SetVisible { visible })
+        ->postCoalesced("visible");
 }
 
 void SceneWallpaper::mouseInput(double x, double y) {
     m_main_handler->renderHandler()->setMousePos(x, y);
 }
 
-#define BASIC_TYPE(NAME, TYPENAME)                                                       \
-    void SceneWallpaper::setProperty##NAME(std::string_view name, TYPENAME value) {      \
-        auto msg = CreateMsgWithCmd(m_main_handler, MainHandler::CMD::CMD_SET_PROPERTY); \
-        msg->setString("property", std::string(name));                                   \
-        msg->set##NAME("value", value);                                                  \
-        msg->post();                                                                     \
+void SceneWallpaper::resize(uint32_t width, uint32_t height) {
+    RenderHandler::Resize cmd { .width = (int32_t)width, .height = (int32_t)height };
+    CreateCmdMsg<RenderHandler>(m_main_handler->renderHandler(), cmd)->postCoalesced("resize");
+}
+
+namespace
+{
+// a burst of one property is merged, but never over a scene switch, which clears user props
+void PostProperty(const std::shared_ptr<MainHandler>& handler, std::string_view name,
+                  PropertyValue value, std::atomic<uint64_t>& generation) {
+    MainHandler::SetProperty cmd { .name = StringId(name), .value = std::move(value) };
+    if (name == PROPERTY_SOURCE || name == PROPERTY_ASSETS) {
+        // loads for changes still queued behind it are dropped
+        cmd.load_for = handler->wantLoad();
+        CreateCmdMsg<MainHandler>(handler, std::move(cmd))->post();
+        generation++;
+    } else {
+        CreateCmdMsg<MainHandler>(handler, std::move(cmd))->postCoalesced(name, generation);
+    }
+}
+} // namespace
+
+#define BASIC_TYPE(NAME, TYPENAME)                                                  \
+    void SceneWallpaper::setProperty##NAME(std::string_view name, TYPENAME value) { \
+        PostProperty(m_main_handler,                                                \
+                     name,                                                          \
+                     PropertyValue(std::in_place_type<TYPENAME>, std::move(value)), \
+                     m_property_generation);                                        \
     }
 
 BASIC_TYPE(Bool, bool);
@@ -314,183 +1469,549 @@ ExSwapchain* SceneWallpaper::exSwapchain() const {
     return m_main_handler->renderHandler()->exSwapchain();
 }
 
-MHANDLER_CMD_IMPL(MainHandler, LOAD_SCENE) {
+FrameStatsReport SceneWallpaper::frameStats(bool reset) const {
+    auto& stats = m_main_handler->renderHandler()->frame_stats;
+    auto  snaps = stats.Read();
+    if (reset) stats.Reset();
+    return { .cpu     = Summarize(snaps[0]),
+             .gpu     = Summarize(snaps[1]),
+             .present = Summarize(snaps[2]) };
+}
+
+std::vector<CacheCounter> SceneWallpaper::cacheCounters(bool reset) {
+    using counters::Counter;
+    std::vector<CacheCounter> res;
+    res.reserve((usize)Counter::Count);
+    for (usize i = 0; i < (usize)Counter::Count; i++)
+        res.push_back({ .name = counters::Name((Counter)i), .value = counters::Read((Counter)i) });
+    if (reset) counters::Reset();
+    return res;
+}
+
+std::vector<ThreadCpuUsage> SceneWallpaper::threadCpu(bool reset) {
+    std::vector<ThreadCpuUsage> res;
+    for (auto& usage : thread_cpu::read(reset)) {
+        auto& thread = res.emplace_back(ThreadCpuUsage { .name      = std::move(usage.name),
+                                                         .cpu       = (double)usage.cpu_ns / 1e6,
+                                                         .wakeups   = usage.voluntary,
+                                                         .preempted = usage.involuntary,
+                                                         .ended     = usage.ended,
+                                                         .phases    = {} });
+        for (auto& phase : usage.phases)
+            thread.phases.push_back(
+                { .name = phase.name, .cpu = (double)phase.cpu_ns / 1e6, .count = phase.count });
+    }
+    return res;
+}
+
+MemoryReport SceneWallpaper::memoryUse(bool reset) {
+    using memuse::Pool;
+    MemoryReport report { .resident = memuse::Resident(), .parts = {} };
+    report.parts.reserve((usize)Pool::Count);
+    for (usize i = 0; i < (usize)Pool::Count; i++)
+        report.parts.push_back({ .name  = memuse::Name((Pool)i),
+                                 .bytes = memuse::Read((Pool)i),
+                                 .peak  = memuse::Peak((Pool)i) });
+    if (reset) memuse::ResetPeaks();
+    return report;
+}
+
+bool SceneWallpaper::EstimateCost(const std::string& assets, const std::string& source,
+                                  SceneCost& cost, const std::string& user_props) {
+    fs::VFS     vfs;
+    std::string scene_src;
+    if (! MountSource(vfs, assets, source, scene_src, nullptr)) return false;
+    return WPSceneParser::Estimate(scene_src, vfs, cost, user_props);
+}
+
+void MainHandler::handle(const InitVulkan& cmd) {
+    auto info = cmd.info;
+    if (! info) return;
+    if (info->cache_path.empty()) info->cache_path = m_cache_path;
+
+    CreateCmdMsg<RenderHandler>(m_render_handler, RenderHandler::InitVulkan { info })->post();
+}
+
+void MainHandler::handle(const LoadScene&) {
     if (m_render_handler->renderInited()) {
         loadScene();
     }
 }
 
-MHANDLER_CMD_IMPL(MainHandler, SET_PROPERTY) {
-    std::string property;
-    if (msg->findString("property", &property)) {
-        if (property == PROPERTY_SOURCE) {
-            msg->findString("value", &m_source);
-            LOG_INFO("source: %s", m_source.c_str());
-            // Reset user properties when source changes (new wallpaper)
-            m_user_props_json.clear();
-            CALL_MHANDLER_CMD(LOAD_SCENE, msg);
-        } else if (property == PROPERTY_ASSETS) {
-            msg->findString("value", &m_assets);
-            CALL_MHANDLER_CMD(LOAD_SCENE, msg);
-        } else if (property == PROPERTY_FPS) {
-            int32_t fps { 15 };
-            msg->findInt32("value", &fps);
-            if (fps >= 5) {
-                m_render_handler->frame_timer.SetRequiredFps((uint8_t)fps);
-            }
-        } else if (property == PROPERTY_FILLMODE) {
-            int32_t value;
-            if (msg->findInt32("value", &value)) {
-                auto nmsg =
-                    CreateMsgWithCmd(m_render_handler, RenderHandler::CMD::CMD_SET_FILLMODE);
-                nmsg->setInt32("value", value);
-                nmsg->post();
-            }
-        } else if (property == PROPERTY_GRAPHIVZ) {
-            msg->findBool("value", &m_gen_graphviz);
-        } else if (property == PROPERTY_MUTED) {
-            bool muted { false };
-            msg->findBool("value", &muted);
-            m_sound_manager->SetMuted(muted);
-        } else if (property == PROPERTY_VOLUME) {
-            float volume { 1.0f };
-            msg->findFloat("value", &volume);
-            m_sound_manager->SetVolume(volume);
-        } else if (property == PROPERTY_CACHE_PATH) {
-            std::string path;
-            msg->findString("value", &path);
-            m_cache_path = path;
-        } else if (property == PROPERTY_FIRST_FRAME_CALLBACK) {
-            std::shared_ptr<FirstFrameCallback> cb;
-            msg->findObject("value", &cb);
-            m_first_frame_callback = *cb;
-        } else if (property == PROPERTY_SPEED) {
-            float speed { 1.0f };
-            if (msg->findFloat("value", &speed)) {
-                auto nmsg = CreateMsgWithCmd(m_render_handler, RenderHandler::CMD::CMD_SET_SPEED);
-                nmsg->setFloat("value", speed);
-                nmsg->post();
+void MainHandler::handle(const SetProperty& cmd) {
+    // render thread commands, sent ahead of queued frames
+    auto send = [this](RenderHandler::Command render_cmd) {
+        CreateCmdMsg<RenderHandler>(m_render_handler, std::move(render_cmd))->postUrgent();
+    };
+    const std::string& property = cmd.name.str();
+    const auto&        value    = cmd.value;
+    if (cmd.load_for) m_load_for = *cmd.load_for;
+    if (! m_record_path.empty() && Replayable(property)) {
+        if (auto v = RecordValue(value); v) send(RenderHandler::RecordProperty { property, *v });
+    }
+    if (property == PROPERTY_SOURCE) {
+        ValueAs(value, &m_source);
+        LOG_INFO("source: %s", m_source.c_str());
+        // Reset user properties when source changes (new wallpaper)
+        m_user_props_json.clear();
+        handle(LoadScene {});
+    } else if (property == PROPERTY_PREFETCH) {
+        std::string source;
+        ValueAs(value, &source);
+        prefetchScene(source);
+    } else if (property == PROPERTY_ASSETS) {
+        ValueAs(value, &m_assets);
+        handle(LoadScene {});
+    } else if (property == PROPERTY_FPS) {
+        int32_t fps { 15 };
+        ValueAs(value, &fps);
+        if (fps >= 5) send(RenderHandler::SetPacing { .fps = (uint8_t)fps });
+    } else if (property == PROPERTY_ADAPTIVE_FPS) {
+        bool adaptive { false };
+        if (ValueAs(value, &adaptive)) send(RenderHandler::SetPacing { .adaptive = adaptive });
+    } else if (property == PROPERTY_POWER_HINTS) {
+        int32_t hints { 0 };
+        if (ValueAs(value, &hints)) send(RenderHandler::SetPacing { .hints = hints });
+    } else if (property == PROPERTY_PRESENT_PACING) {
+        bool pacing { true };
+        if (ValueAs(value, &pacing)) {
+            m_render_handler->frame_timer.SetPresentPacing(pacing);
+        }
+    } else if (property == PROPERTY_FILLMODE) {
+        int32_t mode;
+        if (ValueAs(value, &mode)) {
+            m_fillmode = mode;
+            send(RenderHandler::SetFillMode { (FillMode)mode });
+        }
+    } else if (property == PROPERTY_GRAPHIVZ) {
+        ValueAs(value, &m_gen_graphviz);
+    } else if (property == PROPERTY_MUTED) {
+        bool muted { false };
+        ValueAs(value, &muted);
+        m_sound_manager->SetMuted(muted);
+    } else if (property == PROPERTY_VOLUME) {
+        float volume { 1.0f };
+        ValueAs(value, &volume);
+        m_sound_manager->SetVolume(volume);
+    } else if (property == PROPERTY_CACHE_PATH) {
+        std::string path;
+        ValueAs(value, &path);
+        m_cache_path = path;
+    } else if (property == PROPERTY_TEX_TRANSCODE) {
+        ValueAs(value, &m_tex_transcode);
+    } else if (property == PROPERTY_MAX_TEXTURE_SIZE) {
+        int32_t size { 0 };
+        if (ValueAs(value, &size)) m_max_tex_size = std::max(size, 0);
+    } else if (property == PROPERTY_PREVIEW) {
+        int32_t mode { PREVIEW_OFF };
+        if (ValueAs(value, &mode)) {
+            m_preview = std::clamp(mode, PREVIEW_OFF, PREVIEW_LOOP);
+            m_scene_parser.SetSounds(m_preview == PREVIEW_OFF);
+            send(RenderHandler::SetPreview { m_preview });
+        }
+    } else if (property == PROPERTY_QUALITY) {
+        int32_t quality { QUALITY_FULL };
+        if (ValueAs(value, &quality)) {
+            quality = std::clamp(quality, QUALITY_FULL, QUALITY_LOW);
+            if (quality != m_quality) {
+                m_quality = quality;
+                m_scene_parser.SetQuality(ShaderQualityOf(m_quality));
+                LOG_INFO("quality %s", m_quality == QUALITY_LOW ? "low" : "full");
+                if (! m_source.empty()) handle(LoadScene {});
             }
-        } else if (property == PROPERTY_USER_PROPS) {
-            std::string json;
-            msg->findString("value", &json);
-            if (m_user_props_json != json) {
-                m_user_props_json = json;
-                // Reload scene to apply new user properties (only if we have actual properties)
-                // Skip reload if json is empty - this means wallpaper is changing
-                if (!json.empty() && !m_source.empty() && !m_assets.empty()) {
-                    LOG_INFO("Reloading scene to apply user properties: %s", json.c_str());
-                    CALL_MHANDLER_CMD(LOAD_SCENE, msg);
-                }
+        }
+    } else if (property == PROPERTY_BAKE) {
+        float bake { 0.0f };
+        if (ValueAs(value, &bake) && bake != m_bake) {
+            m_bake = bake;
+            if (! m_source.empty()) handle(LoadScene {});
+        }
+    } else if (property == PROPERTY_GPU_POLICY) {
+        int32_t policy { GPU_POLICY_COMPOSITOR };
+        if (ValueAs(value, &policy)) send(RenderHandler::SetGpuPolicy { policy });
+    } else if (property == PROPERTY_TEX_RETAIN) {
+        int32_t mb { 0 };
+        if (ValueAs(value, &mb)) send(RenderHandler::SetTexRetain { mb });
+    } else if (property == PROPERTY_JOB_WORKERS) {
+        int32_t workers { 0 };
+        if (ValueAs(value, &workers) && workers >= 0) {
+            looper::JobSystem::Shared().setWorkerCount((usize)workers);
+        }
+    } else if (property == PROPERTY_THREAD_POLICY) {
+        int32_t flags { 0 };
+        if (ValueAs(value, &flags)) {
+            platform::ThreadPolicy policy {
+                .boost_frame      = (flags & THREAD_POLICY_BOOST_FRAME) != 0,
+                .idle_load        = (flags & THREAD_POLICY_IDLE_LOAD) != 0,
+                .efficiency_cores = (flags & THREAD_POLICY_EFFICIENCY_CORES) != 0,
+            };
+            platform::SetThreadPolicy(policy);
+            auto& jobs = looper::JobSystem::Shared();
+            jobs.setLoadWorkers(policy.idle_load ? jobs.workerCount() / 2 : 0);
+        }
+    } else if (property == PROPERTY_FIRST_FRAME_CALLBACK) {
+        std::shared_ptr<FirstFrameCallback> cb;
+        ObjectAs(value, &cb);
+        m_first_frame_callback = cb ? *cb : FirstFrameCallback {};
+    } else if (property == PROPERTY_PASS_TIMES_CALLBACK) {
+        std::shared_ptr<PassTimesCallback> cb;
+        ObjectAs(value, &cb);
+        m_pass_times_callback = cb ? *cb : PassTimesCallback {};
+        send(RenderHandler::SetProfiling { .pass_times = (bool)m_pass_times_callback });
+    } else if (property == PROPERTY_LOAD_REPORT_CALLBACK) {
+        std::shared_ptr<LoadReportCallback> cb;
+        ObjectAs(value, &cb);
+        m_load_report_callback = cb ? *cb : LoadReportCallback {};
+    } else if (property == PROPERTY_TRACE_FILE) {
+        std::string path;
+        ValueAs(value, &path);
+        if (path != m_trace_path) {
+            if (! m_trace_path.empty()) trace::stop(m_trace_path);
+            m_trace_path = path;
+            if (! m_trace_path.empty()) trace::start();
+        }
+    } else if (property == PROPERTY_STALL_WATCHDOG) {
+        float factor { 0.0f };
+        if (ValueAs(value, &factor)) {
+            send(RenderHandler::SetWatchdog {
+                .factor = factor, .dir = m_cache_path.empty() ? "" : m_cache_path + "/stalls" });
+        }
+    } else if (property == PROPERTY_INPUT_RECORD) {
+        std::string path;
+        ValueAs(value, &path);
+        if (path != m_record_path) {
+            m_record_path = path;
+            if (! path.empty() && ! m_input_seed) m_input_seed = 0;
+            if (path.empty() && ! m_replaying) m_input_seed.reset();
+            send(RenderHandler::SetRecord { path, m_input_seed.value_or(0) });
+        }
+    } else if (property == PROPERTY_INPUT_REPLAY) {
+        std::string                  path;
+        std::shared_ptr<InputRecord> record;
+        ValueAs(value, &path);
+        if (! path.empty()) {
+            record = std::make_shared<InputRecord>();
+            if (! InputRecord::Load(path, *record)) record.reset();
+        }
+        m_replaying = record != nullptr;
+        if (record)
+            m_input_seed = record->seed;
+        else if (m_record_path.empty())
+            m_input_seed.reset();
+        send(RenderHandler::SetReplay { std::move(record) });
+    } else if (property == PROPERTY_FRAME_STATS) {
+        bool stats { false };
+        if (ValueAs(value, &stats)) send(RenderHandler::SetProfiling { .stats = stats });
+    } else if (property == PROPERTY_FRAME_STATS_LOG) {
+        int32_t secs { 0 };
+        if (ValueAs(value, &secs)) send(RenderHandler::SetProfiling { .stats_log = secs });
+    } else if (property == PROPERTY_DYNAMIC_RESOLUTION) {
+        bool dynamic { false };
+        if (ValueAs(value, &dynamic)) {
+            send(RenderHandler::SetProfiling { .dynamic_resolution = dynamic });
+        }
+    } else if (property == PROPERTY_DUMP_GRAPH) {
+        std::string path;
+        if (ValueAs(value, &path) && ! path.empty()) {
+            CreateCmdMsg<RenderHandler>(m_render_handler, RenderHandler::DumpGraph { path })
+                ->post();
+        }
+    } else if (property == PROPERTY_PARTICLE_RATE) {
+        int32_t rate { 0 };
+        if (ValueAs(value, &rate)) send(RenderHandler::SetParticleRate { rate });
+    } else if (property == PROPERTY_LAYER_RATES) {
+        std::string rates;
+        if (ValueAs(value, &rates)) {
+            CreateCmdMsg<RenderHandler>(m_render_handler,
+                                        RenderHandler::SetLayerRates { ParseLayerRates(rates) })
+                ->post();
+        }
+    } else if (property == PROPERTY_SPEED) {
+        float speed { 1.0f };
+        if (ValueAs(value, &speed)) send(RenderHandler::SetSpeed { speed });
+    } else if (property == PROPERTY_USER_PROPS) {
+        std::string json;
+        ValueAs(value, &json);
+        if (m_user_props_json != json) {
+            std::string old_json = std::move(m_user_props_json);
+            m_user_props_json    = json;
+            // Reload scene to apply new user properties (only if we have actual properties)
+            // Skip reload if json is empty - this means wallpaper is changing
+            // Layers shown by the change are read then, parsed in the background while the
+            // drawn scene stays up
+            // A baked scene has no values to patch, it's parsed again for its other bake
+            if (!json.empty() && !m_source.empty() && !m_assets.empty() &&
+                (m_bake != 0.0f || ! patchUserProps(old_json))) {
+                LOG_INFO("Reloading scene to apply user properties: %s", json.c_str());
+                prefetchScene(m_source, true);
             }
         }
     }
 }
 
-MHANDLER_CMD_IMPL(MainHandler, STOP) {
-    bool stop { false };
-    if (msg->findBool("value", &stop)) {
-        if (stop) {
-            m_sound_manager->Pause();
-        } else {
-            m_sound_manager->Play();
-        }
-
-        auto msg_r = CreateMsgWithCmd(m_render_handler, RenderHandler::CMD::CMD_STOP);
-        msg_r->setBool("value", stop);
-        msg_r->post();
+void MainHandler::handle(const Stop& cmd) {
+    if (cmd.value) {
+        m_sound_manager->Pause();
+    } else {
+        m_sound_manager->Play();
     }
+    CreateCmdMsg<RenderHandler>(m_render_handler, RenderHandler::Stop { cmd.value })->postUrgent();
 }
 
-MHANDLER_CMD_IMPL(MainHandler, FIRST_FRAME) {
+void MainHandler::handle(const FirstFrame&) {
     if (m_first_frame_callback) m_first_frame_callback();
 }
 
+void MainHandler::handle(const LoadDone& cmd) {
+    if (! cmd.load) return;
+    auto& r = cmd.load->report;
+    LOG_INFO("scene loaded in %.1fms: mount %.1fms, parse %.1fms (shaders %.1fms), "
+             "decode %.1fms, graph %.1fms, pipelines %.1fms, first submit %.1fms",
+             r.total,
+             r.vfs_mount,
+             r.scene_parse,
+             r.shader_compile,
+             r.texture_decode,
+             r.graph_compile,
+             r.pipelines,
+             r.first_submit);
+    if (m_load_report_callback) m_load_report_callback(r);
+}
+
+void MainHandler::handle(const PassTimes& cmd) {
+    if (m_pass_times_callback) m_pass_times_callback(cmd.times);
+}
+
+void MainHandler::handle(const SaveRecord& cmd) {
+    if (cmd.record && cmd.record->Save(cmd.path)) {
+        LOG_INFO("input record written to %s", cmd.path.c_str());
+    }
+}
+
+void MainHandler::handle(const Baked& cmd) {
+    if (cmd.key != m_bake_key) return;
+    LOG_INFO("loading the bake of %s", m_source.c_str());
+    handle(LoadScene {});
+}
+
+std::string MainHandler::bakeKey() const {
+    // a new version of the scene bakes again
+    std::error_code ec;
+    auto            stamp = std::filesystem::last_write_time(m_source, ec);
+    std::string     salt  = m_source + '\n' + m_user_props_json + '\n' +
+                       std::to_string(stamp.time_since_epoch().count()) + '\n' +
+                       std::to_string(m_quality) + ' ' + std::to_string(m_fillmode) + ' ' +
+                       std::to_string(m_max_tex_size) + ' ' + std::to_string(m_bake);
+    return WPBake::Key(salt);
+}
+
 void MainHandler::loadScene() {
     if (m_source.empty() || m_assets.empty()) return;
+    // a source and then assets set one after the other load once, for the second
+    if (loadSuperseded(m_load_for)) {
+        LOG_INFO("scene load superseded, skipped: %s", m_source.c_str());
+        return;
+    }
+    TRACE_PHASE("loadScene");
 
     LOG_INFO("loading scene: %s", m_source.c_str());
 
-    if (! m_sound_manager->IsInited()) {
+    if (m_preview != PREVIEW_OFF) {
+        // silent, the audio device isn't opened for a preview
+        if (m_sound_manager->IsInited()) m_sound_manager->UnMountAll();
+    } else if (! m_sound_manager->IsInited()) {
         m_sound_manager->Init();
         m_sound_manager->Play();
     } else {
         m_sound_manager->UnMountAll();
     }
 
-    std::shared_ptr<Scene> scene { nullptr };
-
-    // mount assets dir
-    std::unique_ptr<fs::VFS> pVfs = std::make_unique<fs::VFS>();
-    auto&                    vfs  = *pVfs;
-    if (! vfs.IsMounted("assets")) {
-        bool sus = vfs.Mount("/assets", fs::CreatePhysicalFs(m_assets), "assets");
-        if (! sus) {
-            LOG_ERROR("Mount assets dir failed");
-            return;
+    // a bake of the scene is loaded in its place, one is made if there's none yet
+    std::shared_ptr<WPBake> bake;
+    std::string             source = m_source;
+    m_bake_key.clear();
+    if (m_bake != 0.0f && m_preview == PREVIEW_OFF) bake = WPBake::FromCachePath(m_cache_path);
+    if (bake) {
+        m_bake_key = bakeKey();
+        if (auto baked = bake->Find(m_bake_key); ! baked.empty()) {
+            LOG_INFO("using the bake %s", m_bake_key.c_str());
+            source = std::move(baked);
+            bake.reset();
         }
     }
-    std::filesystem::path pkgPath_fs { m_source };
-    pkgPath_fs.replace_extension("pkg");
-    std::string pkgPath  = pkgPath_fs.native();
-    std::string pkgEntry = pkgPath_fs.filename().replace_extension("json").native();
-    std::string pkgDir   = pkgPath_fs.parent_path().native();
-    std::string scene_id = pkgPath_fs.parent_path().filename().native();
+    const bool baked = source != m_source;
 
-    // load pkgfile
-    if (! vfs.Mount("/assets", fs::WPPkgFs::CreatePkgFs(pkgPath))) {
-        LOG_INFO("load pkg file %s failed, fallback to use dir", pkgPath.c_str());
-        // load pkg dir
-        if (! vfs.Mount("/assets", fs::CreatePhysicalFs(pkgDir))) {
-            LOG_ERROR("can't load pkg directory: %s", pkgDir.c_str());
-            return;
-        }
+    auto                   load  = std::make_shared<LoadTiming>();
+    std::shared_ptr<Scene> scene = baked ? nullptr : takePrefetched(load->report);
+    if (scene) {
+        LOG_INFO("using prefetched scene");
+    } else {
+        // also asked from decode jobs
+        auto stale = [this, load_for = m_load_for]() {
+            return loadSuperseded(load_for);
+        };
+        // the random values the parse picks, the same for a replay
+        if (m_input_seed) Random::seed((Random::engine_type::result_type)*m_input_seed);
+        m_scene_parser.SetBindless(m_render_handler->bindlessTextures());
+        scene = ParseScene(m_assets, source, m_cache_path, m_user_props_json, m_tex_transcode,
+                           m_max_tex_size, m_scene_parser, *m_sound_manager, &load->report, true,
+                           stale);
+        if (! scene) return;
+        m_property_uses = m_scene_parser.PropertyUses();
     }
-    if (! m_cache_path.empty()) {
-        if (! vfs.Mount("/cache", fs::CreatePhysicalFs(m_cache_path, true), "cache")) {
-            LOG_ERROR("can't load cache folder: %s", m_cache_path.c_str());
-        } else {
-            LOG_INFO("cache folder: %s", m_cache_path.c_str());
-        }
+    if (loadSuperseded(m_load_for)) {
+        LOG_INFO("scene load superseded, dropped: %s", m_source.c_str());
+        return;
     }
-
-    {
-        std::string       scene_src;
-        const std::string base { "/assets/" };
-        {
-            std::string scenePath = base + pkgEntry;
-            if (vfs.Contains(scenePath)) {
-                auto f = vfs.Open(scenePath);
-                if (f) scene_src = f->ReadAllStr();
-            }
-        }
-        if (scene_src.empty()) {
-            LOG_ERROR("Not supported scene type");
-            return;
-        }
-        scene = m_scene_parser.Parse(scene_id, scene_src, vfs, *m_sound_manager, m_user_props_json);
-        scene->vfs.swap(pVfs);
+    if (m_input_seed) scene->paritileSys->SetSeed(*m_input_seed);
+    // read on the render thread from here on
+    static_cast<WPShaderValueUpdater*>(scene->shaderValueUpdater.get())
+        ->SetAudioSpectrum(m_sound_manager->Spectrum());
+
+    RenderHandler::SetScene cmd { .scene = scene, .load = load, .load_for = m_load_for };
+    // sounds play along, a loop of the frames can't
+    if (bake && ! m_sound_manager->HasStreams()) {
+        cmd.bake = std::make_shared<RenderHandler::BakeRequest>(
+            RenderHandler::BakeRequest { .cache = bake, .key = m_bake_key, .period = m_bake });
     }
+    CreateCmdMsg<RenderHandler>(m_render_handler, std::move(cmd))->post();
 
-    {
-        auto msg = CreateMsgWithCmd(m_render_handler, RenderHandler::CMD::CMD_SET_SCENE);
-        msg->setObject("scene", scene);
-        msg->post();
+    // draw first frame
+    CreateCmdMsg<RenderHandler>(m_render_handler, RenderHandler::Draw {})->postCoalesced();
+}
+
+void MainHandler::prefetchScene(const std::string& source, bool reload) {
+    if (source.empty() || m_assets.empty()) return;
+    const bool sounds   = m_preview == PREVIEW_OFF;
+    const bool bindless = m_render_handler->bindlessTextures();
+    // a source change clears the user props, a prefetch is parsed without them
+    const std::string user_props = reload ? m_user_props_json : std::string {};
+    if (m_prefetch && m_prefetch->source == source && m_prefetch->assets == m_assets &&
+        m_prefetch->cache_path == m_cache_path && m_prefetch->tex_transcode == m_tex_transcode &&
+        m_prefetch->max_tex_size == m_max_tex_size && m_prefetch->sounds == sounds &&
+        m_prefetch->quality == m_quality && m_prefetch->bindless == bindless &&
+        m_prefetch->user_props == user_props && m_prefetch->reload == reload)
+        return;
+
+    LOG_INFO("prefetching scene: %s", source.c_str());
+    // waits for a running one, its scene is dropped
+    m_prefetch.reset();
+
+    auto  prefetch   = std::make_unique<Prefetch>();
+    auto& pf         = *prefetch;
+    pf.source        = source;
+    pf.assets        = m_assets;
+    pf.cache_path    = m_cache_path;
+    pf.tex_transcode = m_tex_transcode;
+    pf.max_tex_size  = m_max_tex_size;
+    pf.sounds        = sounds;
+    pf.quality       = m_quality;
+    pf.bindless      = bindless;
+    pf.user_props    = user_props;
+    pf.reload        = reload;
+    pf.scene         = std::async(std::launch::async, [&pf, self = weak_from_this()]() {
+        pf.parser.SetSounds(pf.sounds);
+        pf.parser.SetQuality(ShaderQualityOf(pf.quality));
+        pf.parser.SetBindless(pf.bindless);
+        auto scene = ParseScene(pf.assets,
+                                pf.source,
+                                pf.cache_path,
+                                pf.user_props,
+                                pf.tex_transcode,
+                                pf.max_tex_size,
+                                pf.parser,
+                                pf.sound_manager,
+                                &pf.report);
+        // gone if the handler is being destroyed, which waits for this
+        auto handler = self.lock();
+        if (pf.reload && scene && handler)
+            CreateCmdMsg<MainHandler>(handler, LoadScene {})->post();
+        return scene;
+    });
+    m_prefetch = std::move(prefetch);
+}
+
+std::shared_ptr<Scene> MainHandler::takePrefetched(LoadReport& report) {
+    // parsed unseeded
+    if (! m_prefetch || m_prefetch->source != m_source || m_input_seed) return nullptr;
+
+    auto pf = std::move(m_prefetch);
+    if (pf->assets != m_assets || pf->cache_path != m_cache_path ||
+        pf->tex_transcode != m_tex_transcode || pf->max_tex_size != m_max_tex_size ||
+        pf->sounds != (m_preview == PREVIEW_OFF) || pf->quality != m_quality ||
+        pf->bindless != m_render_handler->bindlessTextures() || pf->user_props != m_user_props_json)
+        return nullptr;
+
+    // still running if the switch came early, waiting beats starting over
+    auto scene = pf->scene.get();
+    if (scene) {
+        m_sound_manager->TakeStreams(pf->sound_manager);
+        m_property_uses   = pf->parser.PropertyUses();
+        report            = std::move(pf->report);
+        report.prefetched = true;
     }
+    return scene;
+}
 
-    // draw first frame
-    {
-        auto msg = CreateMsgWithCmd(m_render_handler, RenderHandler::CMD::CMD_DRAW);
-        msg->post();
+bool MainHandler::patchUserProps(const std::string& old_json) {
+    // the drawn scene is about to go, a patch would be of it
+    if (! m_render_handler->renderInited() || loadSuperseded(m_load_for)) return false;
+    auto changed = WPUserProperties::ChangedOverrides(old_json, m_user_props_json);
+    if (! changed) return false;
+
+    bool read { false };
+    for (auto& name : *changed) {
+        auto use = m_property_uses.find(name);
+        // not read by this scene, changes nothing
+        if (use == m_property_uses.end()) continue;
+        if (use->second != UserPropertyUse::Uniform) return false;
+        read = true;
     }
+    if (! read) return true;
+
+    // only the values are needed, sounds and textures stay with the drawn scene
+    audio::SoundManager sounds;
+    auto                scene = ParseScene(
+        m_assets, m_source, m_cache_path, m_user_props_json, m_tex_transcode, m_max_tex_size,
+        m_scene_parser, sounds, nullptr, false);
+    if (! scene) return false;
+    m_property_uses = m_scene_parser.PropertyUses();
+
+    CreateCmdMsg<RenderHandler>(m_render_handler, RenderHandler::PatchScene { scene })->post();
+    return true;
 }
+
 void MainHandler::sendCmdLoadScene() {
-    auto msg = CreateMsgWithCmd(shared_from_this(), MainHandler::CMD::CMD_LOAD_SCENE);
-    msg->post();
+    CreateCmdMsg<MainHandler>(shared_from_this(), LoadScene {})->post();
 }
 void MainHandler::sendFirstFrameOk() {
-    auto msg = CreateMsgWithCmd(shared_from_this(), MainHandler::CMD::CMD_FIRST_FRAME);
-    msg->post();
+    CreateCmdMsg<MainHandler>(shared_from_this(), FirstFrame {})->post();
+}
+void MainHandler::sendLoadReport(std::shared_ptr<LoadTiming> load) {
+    CreateCmdMsg<MainHandler>(shared_from_this(), LoadDone { std::move(load) })->post();
+}
+void MainHandler::sendSaveRecord(std::string path, std::shared_ptr<InputRecord> record) {
+    CreateCmdMsg<MainHandler>(shared_from_this(), SaveRecord { std::move(path), std::move(record) })
+        ->post();
+}
+void MainHandler::sendBaked(std::string key) {
+    if (auto self = weak_from_this().lock())
+        CreateCmdMsg<MainHandler>(self, Baked { std::move(key) })->post();
+}
+void MainHandler::sendProperty(const InputRecord::Property& prop) {
+    SetProperty cmd { .name = StringId(prop.name), .value = {} };
+    std::visit(
+        [&cmd](const auto& v) {
+            cmd.value = v;
+        },
+        prop.value);
+    CreateCmdMsg<MainHandler>(shared_from_this(), std::move(cmd))->post();
+}
+void MainHandler::sendPassTimes(std::vector<vulkan::PassTime>& times) {
+    PassTimes cmd;
+    cmd.times.reserve(times.size());
+    for (auto& t : times) cmd.times.emplace_back(std::move(t.name), t.gpu_ms);
+    CreateCmdMsg<MainHandler>(shared_from_this(), std::move(cmd))->post();
 }
 
 bool MainHandler::init() {
@@ -505,12 +2026,13 @@ bool MainHandler::init() {
     m_render_loop->registerHandler(m_render_handler);
 
     {
-        auto  msg        = CreateMsgWithCmd(m_render_handler, RenderHandler::CMD::CMD_DRAW);
+        auto  msg        = CreateCmdMsg<RenderHandler>(m_render_handler, RenderHandler::Draw {});
         auto& frameTimer = m_render_handler->frame_timer;
+        // a draw still queued behind a slow frame takes the new one
         frameTimer.SetCallback([msg]() {
-            msg->post();
+            msg->postCoalesced();
         });
-        frameTimer.SetRequiredFps(15);
+        frameTimer.SetRequiredFps(FpsGovernor::DefaultFps);
         frameTimer.Run();
     }
 
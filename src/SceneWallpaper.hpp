@@ -1,7 +1,12 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string_view>
 #include <functional>
+#include <string>
+#include <utility>
+#include <vector>
 #include "Type.hpp"
 #include "Swapchain/ExSwapchain.hpp"
 
@@ -9,6 +14,13 @@ namespace wallpaper
 {
 
 using FirstFrameCallback = std::function<void()>;
+// pass name and gpu milliseconds, in execution order, called about once a second
+using PassTimesCallback =
+    std::function<void(const std::vector<std::pair<std::string, double>>&)>;
+
+struct LoadReport;
+// once a loaded scene's first frame was submitted and its pipelines are made, on the main thread
+using LoadReportCallback = std::function<void(const LoadReport&)>;
 
 constexpr std::string_view PROPERTY_SOURCE               = "source";
 constexpr std::string_view PROPERTY_ASSETS               = "assets";
@@ -21,6 +33,242 @@ constexpr std::string_view PROPERTY_MUTED                = "muted";
 constexpr std::string_view PROPERTY_CACHE_PATH           = "cache_path";
 constexpr std::string_view PROPERTY_FIRST_FRAME_CALLBACK = "first_frame_callback";
 constexpr std::string_view PROPERTY_USER_PROPS           = "user_props";
+// shared_ptr<PassTimesCallback>, enables gpu timestamps, an empty callback disables them
+constexpr std::string_view PROPERTY_PASS_TIMES_CALLBACK = "pass_times_callback";
+// shared_ptr<LoadReportCallback>, where the time of every scene load went
+constexpr std::string_view PROPERTY_LOAD_REPORT_CALLBACK = "load_report_callback";
+// int32 hz, particles simulate in fixed steps at this rate and are drawn blended between them,
+// 0 steps them every frame
+constexpr std::string_view PROPERTY_PARTICLE_RATE = "particle_rate";
+// string, layers re-render at a rate of their own and show their last output in between, comma
+// separated, a bare hz for the layers only time moves, id:hz for the layer of that object and its
+// effects, 0 for every frame, as "10,42:2", off by default, a change reloads the scene
+constexpr std::string_view PROPERTY_LAYER_RATES = "layer_rates";
+// string, a source to load in the background, setting it as source later takes the loaded scene
+// as long as assets, cache path and user props didn't change in between
+constexpr std::string_view PROPERTY_PREFETCH = "prefetch";
+// bool, large static rgba8 textures are compressed to bc1 or bc3 on the first load of a scene and
+// read from the cache folder after, needs cache_path, off by default
+constexpr std::string_view PROPERTY_TEX_TRANSCODE = "tex_transcode";
+// int32 pixels, texture mips with a side over this are not decoded or uploaded, single mip images
+// over it are downscaled on decode, kept in the cache folder per cap, 0 for no cap, the default,
+// applies from the next load
+constexpr std::string_view PROPERTY_MAX_TEXTURE_SIZE = "max_texture_size";
+// int32 megabytes, gpu textures of scenes switched away from are kept up to this for a later scene
+// using the same images, the least recently used go first, 256 by default, 0 keeps none
+constexpr std::string_view PROPERTY_TEX_RETAIN = "tex_retain";
+// int32, threads of the job system that decodes, compiles and simulates particles, 0 picks one
+// from the cores, capped at 16
+constexpr std::string_view PROPERTY_JOB_WORKERS = "job_workers";
+// int32, THREAD_POLICY_ flags for the render and job threads, a flag the system doesn't allow is
+// logged once and left out, none by default
+constexpr std::string_view PROPERTY_THREAD_POLICY = "thread_policy";
+// bool, frames are timed from when the last one was shown, or eaten from the ex swapchain,
+// instead of a plain timer, on by default, a surface needs VK_KHR_present_wait for it
+constexpr std::string_view PROPERTY_PRESENT_PACING = "present_pacing";
+// bool, frames run below fps while the scene shows only shader values moving, and at 1 fps while
+// nothing changes, particles in view and mouse moves bring the full rate back, off by default
+constexpr std::string_view PROPERTY_ADAPTIVE_FPS = "adaptive_fps";
+// int32, POWER_HINT_ flags from the host, covered or locked drop to 1 fps, on battery halves fps
+// and caps it at 30
+constexpr std::string_view PROPERTY_POWER_HINTS = "power_hints";
+// int32 GPU_POLICY_, which gpu renders, set it before initVulkan. A surface's scene moves to the
+// gpu the policy picks when it changes later, or when on battery changes what it picks. An
+// offscreen scene stays on the gpu its images were exported from
+constexpr std::string_view PROPERTY_GPU_POLICY = "gpu_policy";
+
+// bool, frame, gpu and present times go into histograms read with frameStats, also turns on
+// gpu timestamps, off by default
+constexpr std::string_view PROPERTY_FRAME_STATS = "frame_stats";
+// int32 seconds, frame stats of every such window are logged, 0 logs none
+constexpr std::string_view PROPERTY_FRAME_STATS_LOG = "frame_stats_log";
+// bool, screen sized targets of effects are drawn down to half size while the gpu takes longer
+// than a frame at fps and back up once it has room, the layers compose at native size, also turns
+// on gpu timestamps, off by default
+constexpr std::string_view PROPERTY_DYNAMIC_RESOLUTION = "dynamic_resolution";
+
+// string, a path starts capturing cpu trace zones, an empty or another path stops it and writes
+// it to the path it started with as chrome trace json, perfetto opens it too, zones are only built
+// in with ENABLE_TRACE
+constexpr std::string_view PROPERTY_TRACE_FILE = "trace_file";
+// string, a path prefix the render graph of the drawn scene is written to once, as <path>.dot and
+// <path>.json, with the size, format and memory of each target and the gpu and cpu times of each
+// pass, times need profiling on from one of the properties above
+constexpr std::string_view PROPERTY_DUMP_GRAPH = "dump_graph";
+// float, a frame taking longer than this many times its interval at fps is a stall, logged with
+// the phase it hangs in and with the zones of the seconds before written to <cache_path>/stalls,
+// the newest 8 kept, only logged without a cache path. Coarse zones are built in for it without
+// ENABLE_TRACE, 0 turns it off, off by default
+constexpr std::string_view PROPERTY_STALL_WATCHDOG = "stall_watchdog";
+// string, a path starts recording the time each frame moves the scene on, the mouse and the
+// properties set after the first recorded frame, an empty or another path stops it and writes
+// the record to the path it started with, see InputRecord.hpp. Set it before the source, the load
+// is seeded then and a replay of the record starts where the scene did
+constexpr std::string_view PROPERTY_INPUT_RECORD = "input_record";
+// string, the path of a record whose frames the scene runs in place of the frame timer's times
+// and the mouse, with its seed and with its properties set again at their frames. Set it before
+// the source, the replay ends with the record or an empty path
+constexpr std::string_view PROPERTY_INPUT_REPLAY = "input_replay";
+
+// int32 QUALITY_, what the scene's shaders and effects are for, a change reloads the scene
+constexpr std::string_view PROPERTY_QUALITY = "quality";
+
+// float seconds, a scene that repeats is drawn once over its loop and the frames saved in
+// cache_path, later loads of it with the same properties play them back as one texture. Above 0
+// it's the loop, below 0 it's found from the scene's sprites and puppets, which fails for shaders
+// moving with time. Scenes with sound, particles, parallax or mouse or audio input aren't baked,
+// nor previews. A change reloads the scene, 0 turns it off, off by default
+constexpr std::string_view PROPERTY_BAKE = "bake";
+
+// int32 PREVIEW_ mode, for pickers showing many scenes small, scenes load without sound, with a
+// quarter of the particles at most and textures a level below what the output size needs, and
+// don't read or save a perf profile. Set it before the source, previews of one process share the
+// job system, the reader threads and the caches in cache_path, off by default
+constexpr std::string_view PROPERTY_PREVIEW = "preview";
+
+constexpr int32_t PREVIEW_OFF = 0;
+// draws until its pipelines are made and textures have all their levels, then stops till a
+// resize, reveal or another source
+constexpr int32_t PREVIEW_STILL = 1;
+// keeps animating at the fps property, a low one suits a preview
+constexpr int32_t PREVIEW_LOOP = 2;
+
+constexpr int32_t QUALITY_FULL = 0;
+// for battery, fragment shaders run at relaxed precision, blurs and effects with a choice of
+// taps or samples take the fewest, and effects that only add sheen or grain are left out. The
+// shader cache keeps these apart from the full ones
+constexpr int32_t QUALITY_LOW = 1;
+
+constexpr int32_t POWER_HINT_ON_BATTERY = 1 << 0;
+// a fullscreen window covers the wallpaper
+constexpr int32_t POWER_HINT_COVERED = 1 << 1;
+constexpr int32_t POWER_HINT_LOCKED  = 1 << 2;
+
+// the gpu of RenderInitInfo::uuid, the one the compositor draws with, so frames aren't copied
+// between gpus. Without a uuid the first gpu good enough, or an integrated one on battery
+constexpr int32_t GPU_POLICY_COMPOSITOR = 0;
+// a hybrid laptop's discrete gpu stays asleep, any other is taken if there's none
+constexpr int32_t GPU_POLICY_INTEGRATED = 1;
+constexpr int32_t GPU_POLICY_DISCRETE   = 2;
+
+// the render and timer threads go to SCHED_RR, or to a lower nice if realtime isn't allowed
+constexpr int32_t THREAD_POLICY_BOOST_FRAME = 1 << 0;
+// half the job workers only decode and compile, as SCHED_IDLE
+constexpr int32_t THREAD_POLICY_IDLE_LOAD = 1 << 1;
+// those workers are kept to the efficiency cores, on cpus that have them
+constexpr int32_t THREAD_POLICY_EFFICIENCY_CORES = 1 << 2;
+
+// milliseconds, percentiles are within about 12%
+struct FrameTimeStats {
+    uint64_t count { 0 };
+    // over a frame at the fps they ran at, present intervals over one and a half
+    uint64_t missed { 0 };
+    double   p50 { 0.0 };
+    double   p95 { 0.0 };
+    double   p99 { 0.0 };
+    double   max { 0.0 };
+};
+
+struct FrameStatsReport {
+    // render thread per drawn frame
+    FrameTimeStats cpu;
+    // first to last pass, empty if the device has no timestamps
+    FrameTimeStats gpu;
+    // between presents of frames drawn one after the other
+    FrameTimeStats present;
+};
+
+// a count of Utils/Counters.hpp, the names stay the same between versions
+struct CacheCounter {
+    std::string_view name;
+    uint64_t         value { 0 };
+};
+
+// cpu time of a thread of the renderer, the loopers, timer, job workers and audio threads
+struct ThreadCpuUsage {
+    std::string name;
+    // ms
+    double cpu { 0.0 };
+    // context switches, a voluntary one is the thread blocking, each is a wakeup after
+    uint64_t wakeups { 0 };
+    uint64_t preempted { 0 };
+    // the threads of the name that ended, summed
+    bool ended { false };
+
+    struct Phase {
+        std::string_view name;
+        // ms, without the phases inside it
+        double   cpu { 0.0 };
+        uint64_t count { 0 };
+    };
+    // only counted while a trace capture or the stall watchdog's flight recorder runs
+    std::vector<Phase> phases;
+};
+
+// cpu memory of the process, the parts are of every wallpaper in it, see Utils/MemUse.hpp
+struct MemoryReport {
+    // resident bytes of the whole process, what the parts don't cover is the libraries, the
+    // driver and what isn't counted
+    uint64_t resident { 0 };
+
+    struct Part {
+        // the names stay the same between versions
+        std::string_view name;
+        uint64_t         bytes { 0 };
+        // the most it held since the process started or the last reset
+        uint64_t peak { 0 };
+    };
+    std::vector<Part> parts;
+};
+
+// milliseconds of the phases of a scene load, the ones on the main thread run one after the other,
+// the render thread's follow
+struct LoadReport {
+    // instance, device and swapchain, only in the report of the first load after init
+    double vulkan_init { 0.0 };
+    // assets, pkg and cache folder, of it reading the pkg's index
+    double vfs_mount { 0.0 };
+    double pkg_index { 0.0 };
+    // the scene json, its objects and materials, of it compiling the shaders the cache didn't have
+    double scene_parse { 0.0 };
+    double shader_compile { 0.0 };
+    // textures decoded ahead of the render thread
+    double texture_decode { 0.0 };
+    // the render graph and its passes, textures are uploaded here
+    double graph_compile { 0.0 };
+    // from the compile beginning until the pipelines made on jobs are done
+    double pipelines { 0.0 };
+    // from the graph being drawable to the first frame submitted
+    double first_submit { 0.0 };
+    // from the load beginning to the first frame submitted
+    double total { 0.0 };
+    // parsed in the background ahead of the source change, the main thread's phases ran then
+    bool prefetched { false };
+
+    struct Shader {
+        std::string name;
+        bool        cached { false };
+        double      compile { 0.0 };
+    };
+    std::vector<Shader> shaders;
+};
+
+// what a scene would take, worked out from its json and the headers of its textures before it's
+// loaded, see SceneWallpaper::EstimateCost
+struct SceneCost {
+    // at full size, before the budget cuts levels
+    uint64_t texture_bytes { 0 };
+    uint32_t textures { 0 };
+    // at the scene's size, before targets are aliased, so at most that
+    uint64_t target_bytes { 0 };
+    uint32_t targets { 0 };
+    // of a frame, effect passes, copies and the layers they compose into each count
+    uint32_t passes { 0 };
+    // of every particle system and its children at their max counts
+    uint64_t particles { 0 };
+    // distinct shader and combo pairs, each a compile unless the shader cache has it
+    uint32_t shader_variants { 0 };
+};
 
 #include "Core/NoCopyMove.hpp"
 class MainHandler;
@@ -37,7 +285,12 @@ public:
 
     void play();
     void pause();
+    // whether anyone can see the output, hidden stops drawing but not the sound, play and pause
+    // still apply on top. A reveal draws a frame right away, paused or not
+    void setVisible(bool);
     void mouseInput(double x, double y);
+    // the surface changed size, a burst of them is drawn at the last one
+    void resize(uint32_t width, uint32_t height);
 
     void setPropertyBool(std::string_view, bool);
     void setPropertyInt32(std::string_view, int32_t);
@@ -47,6 +300,21 @@ public:
 
     ExSwapchain* exSwapchain() const;
 
+    // any thread, what was recorded since frame_stats was set or the last reset
+    FrameStatsReport frameStats(bool reset = false) const;
+    // any thread, hits, misses and evictions of the shader, texture, target and pipeline caches
+    // and the bytes uploaded, of every wallpaper of the process since it started or the last reset
+    static std::vector<CacheCounter> cacheCounters(bool reset = false);
+    // any thread, of every wallpaper of the process since its threads started or the last reset
+    static std::vector<ThreadCpuUsage> threadCpu(bool reset = false);
+    // any thread, parsed json, decoded images, geometry, particles, audio, shaders and looper
+    // messages, a reset starts the peaks over from now
+    static MemoryReport memoryUse(bool reset = false);
+
+    // any thread, blocks on reading the scene's pkg, false if the source can't be read
+    static bool EstimateCost(const std::string& assets, const std::string& source, SceneCost&,
+                             const std::string& user_props = "");
+
 private:
     bool m_inited { false };
 
@@ -55,5 +323,7 @@ private:
 
     bool                         m_offscreen { false };
     std::shared_ptr<MainHandler> m_main_handler;
+    // property posts of one generation are coalesced, a source or assets change starts the next
+    std::atomic<uint64_t> m_property_generation { 0 };
 };
 } // namespace wallpaper
@@ -1,16 +1,28 @@
 #pragma once
 #include "SceneWallpaper.hpp"
 
+#include <chrono>
 #include <functional>
 #include <string_view>
 #include <vulkan/vulkan.h>
 #include <cstdint>
 #include <span>
+#include <string>
 
 namespace wallpaper
 {
 using ReDrawCB = std::function<void()>;
 
+// an offscreen frame handed to the ex swapchain
+struct FrameReady {
+    // as ExHandle::frame_id
+    std::uint64_t                         frame_id { 0 };
+    // ExHandle::id of the image it is in
+    std::int32_t                          image { 0 };
+    std::chrono::steady_clock::time_point presented;
+};
+using FrameReadyCB = std::function<void(const FrameReady&)>;
+
 struct VulkanSurfaceInfo {
     std::function<VkResult(VkInstance, VkSurfaceKHR*)> createSurfaceOp;
     std::vector<std::string>                           instanceExts;
@@ -21,12 +33,37 @@ struct RenderInitInfo {
     bool offscreen { false };
 
     std::span<const std::uint8_t> uuid;
+    // a GPU_POLICY_, set from the gpu_policy property, the uuid is only matched for
+    // GPU_POLICY_COMPOSITOR
+    int32_t                       gpu_policy { GPU_POLICY_COMPOSITOR };
     TexTiling                     offscreen_tiling { TexTiling::OPTIMAL };
+    // images of the ex swapchain, 3 at least, 0 for frames_in_flight plus the one the host holds
+    // and the one waiting to be eaten
+    uint8_t offscreen_images { 0 };
+    // drm format modifiers the host imports rgba8 dma-bufs with, images are exported with one the
+    // gpu renders to if any, as opaque fds otherwise
+    std::span<const std::uint64_t> offscreen_modifiers;
+    // frames come with a semaphore to wait on where the gpu can export one, false hands them over
+    // once drawn, for a host passing each frame on to several eaters, which can't share a wait
+    bool offscreen_synced { true };
     VulkanSurfaceInfo             surface_info;
+    // of the surface, fifo if it lacks it, mailbox and immediate don't wait for vblank
+    VkPresentModeKHR present_mode { VK_PRESENT_MODE_FIFO_KHR };
+    // swapchain images, 0 for one more than the surface's minimum
+    uint8_t swapchain_images { 0 };
 
     uint16_t width { 1920 };
     uint16_t height { 1080 };
+    // frames recorded ahead of the gpu, 1 to 3
+    uint8_t  frames_in_flight { 2 };
+    // simulate particle systems in a compute shader where they allow it
+    bool     gpu_particles { false };
     ReDrawCB redraw_callback;
+    // render thread, for every offscreen frame presented, dropped ones included
+    FrameReadyCB frame_ready_callback;
+    // the gpu picked and the extensions found are kept here for the next start, the folder of
+    // the cache_path property if empty
+    std::string cache_path;
 };
 
 } // namespace wallpaper
@@ -0,0 +1,164 @@
+#include "RenderClient.hpp"
+#include "RenderProtocol.hpp"
+#include "Utils/Logging.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace wallpaper;
+using namespace wallpaper::service;
+
+// The daemon only sends a frame in an image this side gave back, so the receiver always finds
+// the image free. An image going back to the free ones, eaten past or dropped for a newer frame,
+// is given back to the daemon.
+class RenderClient::RemoteSwapchain : public ExSwapchain {
+public:
+    RemoteSwapchain(int sock, const MsgOpened& opened)
+        : m_sock(sock), m_width(opened.width), m_height(opened.height) {
+        m_handles.reserve(opened.images);
+        for (u32 i = 0; i < opened.images; i++) m_handles.emplace_back((int)i);
+        initImages();
+        m_live = true;
+    }
+
+    uint     width() const override { return m_width; }
+    uint     height() const override { return m_height; }
+    uint32_t count() const override { return (uint32_t)m_handles.size(); }
+
+    // receiver thread, an image is only described again after it was given back
+    void setImage(const MsgImage& msg, int fd) {
+        if (msg.id < 0 || (usize)msg.id >= m_handles.size()) {
+            ::close(fd);
+            return;
+        }
+        auto& h    = m_handles[(usize)msg.id];
+        h.fd       = fd;
+        h.width    = msg.width;
+        h.height   = msg.height;
+        h.size     = msg.size;
+        h.dma_buf  = msg.dma_buf != 0;
+        h.modifier = msg.modifier;
+        h.offset   = msg.offset;
+        h.stride   = msg.stride;
+    }
+    // receiver thread
+    bool frame(const MsgFrame& msg) {
+        if (msg.id < 0 || (usize)msg.id >= m_handles.size()) return false;
+        ExHandle* h = acquireImage((uint32_t)msg.id);
+        if (h == nullptr) {
+            LOG_ERROR("render daemon sent a frame in image %d, which is held", msg.id);
+            return false;
+        }
+        h->frame_id = msg.frame_id;
+        presentFrame(*h);
+        return true;
+    }
+
+protected:
+    ExHandle& image(uint32_t i) override { return m_handles.at(i); }
+    uint32_t  indexOf(const ExHandle& h) const override { return (uint32_t)h.id(); }
+    void      released(uint32_t index) override {
+        if (m_live) Send(m_sock, MsgType::Release, MsgImageId { .id = (i32)index });
+    }
+
+private:
+    int                   m_sock;
+    u32                   m_width;
+    u32                   m_height;
+    std::vector<ExHandle> m_handles;
+    // the images given back at the start aren't held by the daemon
+    bool m_live { false };
+};
+
+RenderClient::RenderClient() = default;
+
+RenderClient::~RenderClient() {
+    if (m_sock >= 0) ::shutdown(m_sock, SHUT_RDWR);
+    if (m_thread.joinable()) m_thread.join();
+    if (m_sock >= 0) ::close(m_sock);
+}
+
+bool RenderClient::open(const OpenInfo& info, const std::string& socket) {
+    if (m_sock >= 0) return false;
+    m_sock = Connect(socket);
+    if (m_sock < 0) return false;
+
+    MsgOpen msg { .width          = info.width,
+                  .height         = info.height,
+                  .fillmode       = info.fillmode,
+                  .fps            = info.fps,
+                  .tiling         = (u32)info.tiling,
+                  .modifier_count = (u32)info.modifiers.size() };
+    msg.uuid_size = (u32)std::min(info.uuid.size(), sizeof(msg.uuid));
+    std::copy_n(info.uuid.begin(), msg.uuid_size, msg.uuid);
+
+    std::vector<uint8_t> payload((const uint8_t*)&msg, (const uint8_t*)&msg + sizeof(msg));
+    payload.insert(payload.end(),
+                   (const uint8_t*)info.modifiers.data(),
+                   (const uint8_t*)(info.modifiers.data() + info.modifiers.size()));
+    for (const std::string* str : { &info.assets, &info.source, &info.user_props })
+        payload.insert(payload.end(), str->c_str(), str->c_str() + str->size() + 1);
+
+    MsgType              type;
+    std::vector<uint8_t> reply;
+    int                  fd { -1 };
+    MsgOpened            opened;
+    if (! SendBytes(m_sock, MsgType::Open, payload) || ! Receive(m_sock, type, reply, fd) ||
+        type != MsgType::Opened || ! Read(reply, opened) || opened.images == 0 ||
+        opened.images > ExSwapchain::max_images) {
+        if (fd >= 0) ::close(fd);
+        LOG_ERROR("render daemon didn't open %s", info.source.c_str());
+        ::close(m_sock);
+        m_sock = -1;
+        return false;
+    }
+    LOG_INFO("scene %s drawn by the render daemon, %ux%u", info.source.c_str(), opened.width,
+             opened.height);
+    m_swapchain = std::make_unique<RemoteSwapchain>(m_sock, opened);
+    m_connected = true;
+    m_thread    = std::thread([this]() {
+        receive();
+    });
+    return true;
+}
+
+ExSwapchain* RenderClient::exSwapchain() const { return m_swapchain.get(); }
+
+void RenderClient::setFrameCallback(std::function<void(uint64_t)> cb) {
+    m_frame_cb = std::move(cb);
+}
+
+void RenderClient::mouseInput(double x, double y) {
+    if (m_connected) Send(m_sock, MsgType::Mouse, MsgMouse { .x = (float)x, .y = (float)y });
+}
+
+void RenderClient::setVisible(bool visible) {
+    if (m_connected) Send(m_sock, MsgType::Visible, MsgVisible { .visible = visible ? 1u : 0u });
+}
+
+void RenderClient::receive() {
+    MsgType              type;
+    std::vector<uint8_t> payload;
+    int                  fd { -1 };
+    while (Receive(m_sock, type, payload, fd)) {
+        if (type == MsgType::Image) {
+            MsgImage msg;
+            if (fd >= 0 && Read(payload, msg))
+                m_swapchain->setImage(msg, fd);
+            else if (fd >= 0)
+                ::close(fd);
+        } else if (type == MsgType::Frame) {
+            MsgFrame msg;
+            if (Read(payload, msg) && m_swapchain->frame(msg) && m_frame_cb)
+                m_frame_cb(msg.frame_id);
+        } else if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    m_connected = false;
+    LOG_INFO("render daemon hung up");
+    if (m_frame_cb) m_frame_cb(0);
+}
@@ -0,0 +1,124 @@
+#include "RenderProtocol.hpp"
+#include "Utils/Logging.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace wallpaper;
+using namespace wallpaper::service;
+
+namespace
+{
+bool Address(const std::string& path, sockaddr_un& addr) {
+    addr            = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        LOG_ERROR("socket path too long: %s", path.c_str());
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+} // namespace
+
+std::string service::DefaultSocketPath() {
+    const char* dir = std::getenv("XDG_RUNTIME_DIR");
+    std::string path = dir != nullptr && *dir != '\0' ? dir : "/tmp";
+    return path + "/wescene-renderer.sock";
+}
+
+int service::Listen(const std::string& path) {
+    sockaddr_un addr;
+    if (! Address(path, addr)) return -1;
+    int sock = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0) return -1;
+    // left by a daemon that died, a live one would answer
+    if (int other = Connect(path); other >= 0) {
+        ::close(other);
+        ::close(sock);
+        LOG_ERROR("a render daemon already listens on %s", path.c_str());
+        return -1;
+    }
+    ::unlink(path.c_str());
+    if (::bind(sock, (const sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(sock, 16) != 0) {
+        LOG_ERROR("can't listen on %s: %s", path.c_str(), std::strerror(errno));
+        ::close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int service::Connect(const std::string& path) {
+    sockaddr_un addr;
+    if (! Address(path, addr)) return -1;
+    int sock = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0) return -1;
+    if (::connect(sock, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+        ::close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+bool service::SendBytes(int sock, MsgType type, std::span<const uint8_t> payload, int fd) {
+    if (payload.size() > MaxMessage) return false;
+    MsgHeader header { .type = type, .size = (u32)payload.size() };
+    iovec     iov[2] { { &header, sizeof(header) }, { (void*)payload.data(), payload.size() } };
+    msghdr    msg {};
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = 2;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] {};
+    if (fd >= 0) {
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+        cmsghdr* cmsg      = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level   = SOL_SOCKET;
+        cmsg->cmsg_type    = SCM_RIGHTS;
+        cmsg->cmsg_len     = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    ssize_t sent;
+    do {
+        sent = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == (ssize_t)(sizeof(header) + payload.size());
+}
+
+bool service::Receive(int sock, MsgType& type, std::vector<uint8_t>& payload, int& fd) {
+    fd = -1;
+    // a frame message is a few bytes, the buffer isn't cleared for each
+    thread_local std::vector<uint8_t> buf(sizeof(MsgHeader) + MaxMessage);
+    iovec                             iov { buf.data(), buf.size() };
+    msghdr                            msg {};
+    msg.msg_iov    = &iov;
+    msg.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] {};
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t got;
+    do {
+        got = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (got < 0 && errno == EINTR);
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    MsgHeader header {};
+    if (got >= (ssize_t)sizeof(header)) std::memcpy(&header, buf.data(), sizeof(header));
+    if (got < (ssize_t)sizeof(header) || (msg.msg_flags & MSG_TRUNC) != 0 ||
+        header.size != (usize)got - sizeof(header)) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        return false;
+    }
+    type = header.type;
+    payload.assign(buf.begin() + sizeof(header), buf.begin() + (isize)got);
+    return true;
+}
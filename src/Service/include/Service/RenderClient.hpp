@@ -0,0 +1,70 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+#include "Swapchain/ExSwapchain.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+
+namespace wallpaper
+{
+namespace service
+{
+
+// A scene drawn by the render daemon, eaten as the ex swapchain of a SceneWallpaper in this
+// process would be. Clients of one scene share its render, a view of another size samples it
+// scaled. Images come as fds the eater owns once it ate a frame in them, frames are handed over
+// drawn, without a semaphore.
+class RenderClient : NoCopy, NoMove {
+public:
+    struct OpenInfo {
+        std::string assets;
+        std::string source;
+        std::string user_props;
+        // of the first client of the scene, the size it's drawn at
+        u32 width { 1920 };
+        u32 height { 1080 };
+        // FillMode, part of what the scene is
+        i32 fillmode { 0 };
+        i32 fps { 15 };
+        // as RenderInitInfo, of the first client of the scene
+        TexTiling                     tiling { TexTiling::OPTIMAL };
+        std::span<const uint64_t>     modifiers;
+        std::span<const std::uint8_t> uuid;
+    };
+
+    RenderClient();
+    ~RenderClient();
+
+    // blocks till the daemon answered, false if none listens or it can't draw the scene
+    bool open(const OpenInfo&, const std::string& socket);
+    // null before open
+    ExSwapchain* exSwapchain() const;
+    // false once the daemon hung up, the host opens again or draws the scene itself
+    bool connected() const { return m_connected.load(); }
+
+    // receiver thread, for every frame that came, then once with 0 when the daemon hung up
+    void setFrameCallback(std::function<void(uint64_t frame_id)>);
+
+    void mouseInput(double x, double y);
+    void setVisible(bool);
+
+private:
+    class RemoteSwapchain;
+
+    void receive();
+
+    int                                    m_sock { -1 };
+    std::atomic<bool>                      m_connected { false };
+    std::unique_ptr<RemoteSwapchain>       m_swapchain;
+    std::function<void(uint64_t frame_id)> m_frame_cb;
+    std::thread                            m_thread;
+};
+
+} // namespace service
+} // namespace wallpaper
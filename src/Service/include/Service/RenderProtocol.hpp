@@ -0,0 +1,126 @@
+#pragma once
+#include "Core/Literals.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace wallpaper
+{
+namespace service
+{
+
+// What the render daemon and its clients say over a unix seqpacket socket, one message a packet,
+// a header and a fixed payload, some with strings or an fd after. Both ends are of the same build,
+// nothing is versioned.
+//
+// A client opens a scene and gets the images of its frames, an fd each the first time an image
+// holds one of its frames, then the frames as they're drawn. It holds a frame until a newer one
+// replaced it and gives the image back with Release, the daemon draws into it again once no
+// client holds it.
+
+enum class MsgType : u32
+{
+    // client, MsgOpen, then the drm modifiers and the assets, source and user properties strings
+    Open = 1,
+    // daemon, MsgOpened, the scene's images and size
+    Opened,
+    // daemon, MsgImage with its fd
+    Image,
+    // daemon, MsgFrame
+    Frame,
+    // client, MsgImageId of a frame it no longer shows
+    Release,
+    // client, MsgMouse
+    Mouse,
+    // client, MsgVisible
+    Visible,
+};
+
+struct MsgHeader {
+    MsgType type;
+    u32     size;
+};
+
+struct MsgOpen {
+    u32 width { 0 };
+    u32 height { 0 };
+    // FillMode
+    i32 fillmode { 0 };
+    i32 fps { 15 };
+    // TexTiling
+    u32     tiling { 0 };
+    u32     modifier_count { 0 };
+    uint8_t uuid[16] {};
+    u32     uuid_size { 0 };
+};
+
+struct MsgOpened {
+    u32 images { 0 };
+    u32 width { 0 };
+    u32 height { 0 };
+};
+
+// ExHandle but the fd and the semaphore, frames are sent once drawn
+struct MsgImage {
+    i32 id { 0 };
+    i32 width { 0 };
+    i32 height { 0 };
+    u32 dma_buf { 0 };
+    u64 size { 0 };
+    u64 modifier { 0 };
+    u32 offset { 0 };
+    u32 stride { 0 };
+};
+
+struct MsgFrame {
+    i32 id { 0 };
+    u64 frame_id { 0 };
+};
+
+struct MsgImageId {
+    i32 id { 0 };
+};
+
+struct MsgMouse {
+    float x { 0.0f };
+    float y { 0.0f };
+};
+
+struct MsgVisible {
+    u32 visible { 1 };
+};
+
+// bytes of a payload at most, under what a socket buffers by default, user properties fit
+constexpr usize MaxMessage { 128 * 1024 };
+
+// in XDG_RUNTIME_DIR, /tmp without
+std::string DefaultSocketPath();
+
+// the listening socket at path, a stale one is replaced, -1 on failure
+int Listen(const std::string& path);
+// -1 if nobody listens
+int Connect(const std::string& path);
+
+// fd goes along if it's not -1, the receiver gets its own, false for a payload over MaxMessage
+bool SendBytes(int sock, MsgType, std::span<const uint8_t> payload, int fd = -1);
+// a message of a fixed payload alone
+template<typename T>
+bool Send(int sock, MsgType type, const T& msg, int fd = -1) {
+    return SendBytes(sock, type, { (const uint8_t*)&msg, sizeof(T) }, fd);
+}
+// blocks, false on a hangup or a broken message, fd is -1 if none came, the caller owns it
+bool Receive(int sock, MsgType& type, std::vector<uint8_t>& payload, int& fd);
+
+// the fixed part of a payload, false if it's shorter
+template<typename T>
+bool Read(std::span<const uint8_t> payload, T& msg) {
+    if (payload.size() < sizeof(T)) return false;
+    std::memcpy(&msg, payload.data(), sizeof(T));
+    return true;
+}
+
+} // namespace service
+} // namespace wallpaper
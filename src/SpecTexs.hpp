@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <string_view>
 #include <cstdint>
 #include "Core/Literals.hpp"
@@ -18,6 +19,10 @@ constexpr std::array WE_GLTEX_RESOLUTION_NAMES { BASE_GLTEX_NAMES(Resolution) };
 constexpr std::array WE_GLTEX_ROTATION_NAMES { BASE_GLTEX_NAMES(Rotation) };
 constexpr std::array WE_GLTEX_TRANSLATION_NAMES { BASE_GLTEX_NAMES(Translation) };
 constexpr std::array WE_GLTEX_MIPMAPINFO_NAMES { BASE_GLTEX_NAMES(MipMapInfo) };
+// the sprite frame of a texture packed into array layers
+constexpr std::array WE_GLTEX_LAYER_NAMES { BASE_GLTEX_NAMES(Layer) };
+// the element of WE_BINDLESS_ARRAY a texture is sampled from
+constexpr std::array WE_GLTEX_INDEX_NAMES { BASE_GLTEX_NAMES(Index) };
 #undef BASE_GLTEX_NAMES
 
 constexpr std::string_view WE_SPEC_PREFIX { "_rt_" };
@@ -73,6 +78,53 @@ constexpr std::string_view G_TEXELSIZEHALF { "g_TexelSizeHalf" };
 constexpr std::string_view G_BONES { "g_Bones" };
 constexpr std::string_view G_SCREEN { "g_Screen" };
 constexpr std::string_view G_PARALLAXPOSITION { "g_ParallaxPosition" };
+constexpr std::string_view G_AUDIOSPECTRUM16LEFT { "g_AudioSpectrum16Left" };
+constexpr std::string_view G_AUDIOSPECTRUM16RIGHT { "g_AudioSpectrum16Right" };
+constexpr std::string_view G_AUDIOSPECTRUM32LEFT { "g_AudioSpectrum32Left" };
+constexpr std::string_view G_AUDIOSPECTRUM32RIGHT { "g_AudioSpectrum32Right" };
+constexpr std::string_view G_AUDIOSPECTRUM64LEFT { "g_AudioSpectrum64Left" };
+constexpr std::string_view G_AUDIOSPECTRUM64RIGHT { "g_AudioSpectrum64Right" };
+
+// Uniforms with the same value for every node. A program declaring them with these types gets
+// them from one block, written once a frame and bound by every pass, instead of from its own.
+// Offsets are std140 of the block with every member in this order.
+struct WEGlobalUniform {
+    std::string_view name;
+    std::string_view type;
+    u32              array { 0 };
+    u32              offset;
+};
+constexpr std::string_view WE_GLOBAL_BLOCK { "WPGlobals" };
+constexpr std::array       WE_GLOBAL_UNIFORMS {
+    WEGlobalUniform { .name = G_TIME, .type = "float", .offset = 0 },
+    WEGlobalUniform { .name = G_DAYTIME, .type = "float", .offset = 4 },
+    WEGlobalUniform { .name = G_POINTERPOSITION, .type = "vec2", .offset = 8 },
+    WEGlobalUniform { .name = G_TEXELSIZE, .type = "vec2", .offset = 16 },
+    WEGlobalUniform { .name = G_TEXELSIZEHALF, .type = "vec2", .offset = 24 },
+    WEGlobalUniform { .name = G_PARALLAXPOSITION, .type = "vec2", .offset = 32 },
+    WEGlobalUniform { .name = G_SCREEN, .type = "vec3", .offset = 48 },
+    WEGlobalUniform { .name = G_LP, .type = "vec4", .array = 4, .offset = 64 },
+    // array elements of std140 are vec4 aligned
+    WEGlobalUniform { .name = G_LCP, .type = "vec3", .array = 3, .offset = 128 },
+    // a float each 16 bytes
+    WEGlobalUniform { .name = G_AUDIOSPECTRUM16LEFT, .type = "float", .array = 16, .offset = 176 },
+    WEGlobalUniform { .name = G_AUDIOSPECTRUM16RIGHT, .type = "float", .array = 16, .offset = 432 },
+    WEGlobalUniform { .name = G_AUDIOSPECTRUM32LEFT, .type = "float", .array = 32, .offset = 688 },
+    WEGlobalUniform {
+        .name = G_AUDIOSPECTRUM32RIGHT, .type = "float", .array = 32, .offset = 1200 },
+    WEGlobalUniform { .name = G_AUDIOSPECTRUM64LEFT, .type = "float", .array = 64, .offset = 1712 },
+    WEGlobalUniform {
+        .name = G_AUDIOSPECTRUM64RIGHT, .type = "float", .array = 64, .offset = 2736 },
+};
+constexpr u32 WE_GLOBAL_BLOCK_SIZE { 3760 };
+
+// g_Bones as a storage buffer, see ENABLE_PUPPET_SSBO, std430 keeps mat4x3 at 16 floats
+constexpr std::string_view WE_BONE_BLOCK { "WPBones" };
+
+// the textures of a scene in one sampler array at set 1 binding 0, with descriptor indexing a
+// plain sampler of a texture slot is an element of it, see WPShaderInfo::bindless
+constexpr std::string_view WE_BINDLESS_ARRAY { "wp_Textures" };
+constexpr u32              WE_BINDLESS_CAPACITY { 4096 };
 
 constexpr std::string_view SpecTex_Default { "_rt_default" };
 constexpr std::string_view SpecTex_Link { "_rt_link_" };
@@ -37,6 +37,13 @@ public:
     void        AppendFrame(const SpriteFrame& frame) { m_frames.push_back(frame); }
 
     usize numFrames() const { return m_frames.size(); }
+    const std::vector<SpriteFrame>& frames() const { return m_frames; }
+    // seconds till it shows the first frame again
+    double period() const {
+        double sum { 0.0 };
+        for (const auto& f : m_frames) sum += f.frametime;
+        return sum;
+    }
 
 private:
     void SwitchToNext() {
@@ -1,5 +1,5 @@
 #pragma once
-#include "TripleSwapchain.hpp"
+#include "MailboxSwapchain.hpp"
 #include <cstdint>
 
 namespace wallpaper
@@ -18,6 +18,22 @@ struct ExHandle {
     std::size_t size { 0 };
     // format rgba8
 
+    // fd is a dma-buf of DRM_FORMAT_ABGR8888 with a drm format modifier, its one plane at offset
+    // stride bytes a row, an opaque fd of vulkan memory otherwise
+    bool     dma_buf { false };
+    uint64_t modifier { 0 };
+    uint32_t offset { 0 };
+    uint32_t stride { 0 };
+
+    // opaque fd of a semaphore signaled once the frame in the image is drawn, -1 if frames are
+    // handed over drawn already, the eater imports it once like the memory
+    int sem_fd { -1 };
+    // the semaphore got signaled and nobody waited on it yet, only touched by who holds the
+    // handle, the eater clears it once it waits
+    bool signaled { false };
+    // the frame in the image, counting up from 1, set by the drawer before it presents
+    uint64_t frame_id { 0 };
+
     ExHandle() = default;
     ExHandle(int id): m_id(id) {};
 
@@ -27,6 +43,5 @@ private:
     int32_t m_id { 0 };
 };
 
-// class ExSwapchain : public TripleSwapchain<ExHandle> {};
-using ExSwapchain = TripleSwapchain<ExHandle>;
+using ExSwapchain = MailboxSwapchain<ExHandle>;
 } // namespace wallpaper
@@ -0,0 +1,131 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include "Core/NoCopyMove.hpp"
+
+namespace wallpaper
+{
+
+// Images handed from one drawing thread to one eating thread, without locks.
+// The drawer acquires a free image, draws and presents it, the eater takes the latest presented
+// frame and holds it until it eats the next one. An uneaten frame is dropped for a newer one,
+// its image goes back to the free ones. Free images are handed out the longest free first, so
+// one just given back stays untouched for a while if there are spare ones.
+template<typename T>
+class MailboxSwapchain : NoCopy, NoMove {
+public:
+    static constexpr uint32_t max_images { 32 };
+
+    virtual ~MailboxSwapchain() = default;
+
+    // eating thread, the newest frame or nullptr if none came since the last
+    T* eatFrame() {
+        int32_t index = m_ready.exchange(-1, std::memory_order_acq_rel);
+        if (index < 0) return nullptr;
+        if (m_presented >= 0) release(m_presented);
+        m_presented = index;
+        if (m_eaten_cb) m_eaten_cb();
+        return &image((uint32_t)index);
+    }
+    // eating thread, for an eater handing frames on to others, the newest frame or nullptr like
+    // eatFrame, but frames taken stay held until given back
+    T* takeFrame() {
+        int32_t index = m_ready.exchange(-1, std::memory_order_acq_rel);
+        if (index < 0) return nullptr;
+        if (m_eaten_cb) m_eaten_cb();
+        return &image((uint32_t)index);
+    }
+    // eating thread, a taken frame nobody shows anymore
+    void giveBack(T& frame) { release((int32_t)indexOf(frame)); }
+
+    // drawing thread, nullptr if all images are held
+    T* acquireFrame() {
+        uint32_t mask = m_free.load(std::memory_order_acquire);
+        while (mask != 0) {
+            uint32_t index = oldest(mask);
+            uint32_t bit   = 1u << index;
+            if (m_free.compare_exchange_weak(mask, mask & ~bit, std::memory_order_acq_rel))
+                return &image(index);
+        }
+        return nullptr;
+    }
+    // drawing thread, an acquired image holding a new frame
+    void presentFrame(T& frame) {
+        int32_t dropped = m_ready.exchange((int32_t)indexOf(frame), std::memory_order_acq_rel);
+        if (dropped >= 0) {
+            release(dropped);
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    // drawing thread, an acquired image not presented after all
+    void releaseFrame(T& frame) { release((int32_t)indexOf(frame)); }
+    // drawing thread, the image at index if it's free, for a drawer told where a frame is
+    T* acquireImage(uint32_t index) {
+        uint32_t bit = 1u << index;
+        if ((m_free.fetch_and(~bit, std::memory_order_acq_rel) & bit) == 0) return nullptr;
+        return &image(index);
+    }
+
+    // called on the eating thread for every new frame eaten, set before frames are eaten
+    void setEatenCallback(std::function<void()> cb) { m_eaten_cb = std::move(cb); }
+
+    // frames presented but replaced before they were eaten
+    uint64_t droppedFrames() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    virtual uint     width() const  = 0;
+    virtual uint     height() const = 0;
+    virtual uint32_t count() const  = 0;
+
+protected:
+    MailboxSwapchain() = default;
+
+    // by the derived class once its images exist, all start free
+    void initImages() {
+        assert(count() >= 2 && count() <= max_images);
+        for (uint32_t i = 0; i < count(); i++) release((int32_t)i);
+    }
+
+    virtual T&       image(uint32_t)         = 0;
+    virtual uint32_t indexOf(const T&) const = 0;
+    // on either thread, the image went back to the free ones
+    virtual void released(uint32_t) {}
+
+private:
+    void release(int32_t index) {
+        m_freed_at[(uint32_t)index].store(m_clock.fetch_add(1, std::memory_order_relaxed),
+                                       std::memory_order_relaxed);
+        m_free.fetch_or(1u << (uint32_t)index, std::memory_order_release);
+        released((uint32_t)index);
+    }
+    uint32_t oldest(uint32_t mask) const {
+        uint32_t best { 0 };
+        uint64_t best_at { std::numeric_limits<uint64_t>::max() };
+        for (; mask != 0; mask &= mask - 1) {
+            uint32_t index = (uint32_t)std::countr_zero(mask);
+            uint64_t at    = m_freed_at[index].load(std::memory_order_relaxed);
+            if (at < best_at) {
+                best    = index;
+                best_at = at;
+            }
+        }
+        return best;
+    }
+
+    std::atomic<uint32_t> m_free { 0 };
+    std::atomic<int32_t>  m_ready { -1 };
+    // only the eating thread
+    int32_t m_presented { -1 };
+
+    std::atomic<uint64_t>                         m_clock { 0 };
+    std::array<std::atomic<uint64_t>, max_images> m_freed_at {};
+    std::atomic<uint64_t>                         m_dropped { 0 };
+
+    std::function<void()> m_eaten_cb;
+};
+
+} // namespace wallpaper
@@ -1,39 +0,0 @@
-#pragma once
-#include <atomic>
-#include "Core/NoCopyMove.hpp"
-
-namespace wallpaper
-{
-
-template<typename T>
-class TripleSwapchain : NoCopy, NoMove {
-public:
-    virtual ~TripleSwapchain() = default;
-
-    T* eatFrame() {
-        if (! dirty().exchange(false)) return nullptr;
-        presented() = ready().exchange(presented());
-        return presented();
-    }
-    void renderFrame() {
-        inprogress() = ready().exchange(inprogress());
-        dirty().exchange(true);
-    }
-    T* getInprogress() { return inprogress(); }
-
-    virtual uint width() const  = 0;
-    virtual uint height() const = 0;
-
-protected:
-    TripleSwapchain() = default;
-
-    virtual std::atomic<T*>& presented()  = 0;
-    virtual std::atomic<T*>& ready()      = 0;
-    virtual std::atomic<T*>& inprogress() = 0;
-
-private:
-    std::atomic<bool>& dirty() { return m_dirty; };
-    std::atomic<bool>  m_dirty { false };
-};
-
-} // namespace wallpaper
\ No newline at end of file
@@ -0,0 +1,300 @@
+// Micro benchmarks of what every frame runs on: looper posts and their delivery, the messages
+// commands are made of, the blocking queue, the frame timers and random numbers.
+//
+//   wpCoreBench [--filter <name part>] [--min-time S] [--ticks N] [--out <file.json>]
+//
+// looper/latency is a post and the wait until the handler got it, the loop parked in between.
+// looper/producers_N is the time a message takes with N threads posting at once, posted until all
+// are delivered. The timer cases give how far each tick was off its interval, over ticks ticks,
+// 120 by default, of which a quarter warm up.
+
+#include "Looper/Looper.hpp"
+#include "Timer/ThreadTimer.hpp"
+#include "Timer/FrameTimer.hpp"
+#include "Core/BlockingQueue.hpp"
+#include "Core/Random.hpp"
+#include "Particle/ParticleRandom.h"
+#include "Utils/Logging.h"
+#include "MicroBench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace wallpaper;
+using bench::Keep;
+using clk = std::chrono::steady_clock;
+
+namespace
+{
+
+struct Args {
+    std::string filter;
+    std::string out;
+    double      min_time { 0.5 };
+    u32         ticks { 120 };
+};
+
+bool ParseArgs(int argc, char** argv, Args& args) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view key = argv[i];
+        const char*      val = argv[i + 1];
+        if (key == "--filter")
+            args.filter = val;
+        else if (key == "--min-time")
+            args.min_time = std::strtod(val, nullptr);
+        else if (key == "--ticks")
+            args.ticks = (u32)std::strtoul(val, nullptr, 10);
+        else if (key == "--out")
+            args.out = val;
+        else {
+            LOG_ERROR("unknown option %s", argv[i]);
+            return false;
+        }
+    }
+    if (argc % 2 == 0) {
+        LOG_ERROR("option %s has no value", argv[argc - 1]);
+        return false;
+    }
+    return args.min_time > 0.0 && args.ticks > 1;
+}
+
+double Nanos(clk::duration d) { return std::chrono::duration<double, std::nano>(d).count(); }
+
+class CountHandler : public looper::Handler {
+public:
+    std::atomic<u64> delivered { 0 };
+
+    // spins, a wait on the counter would add the wakeup of this thread
+    void waitFor(u64 count) const {
+        while (delivered.load(std::memory_order_acquire) < count) std::this_thread::yield();
+    }
+
+protected:
+    void onMessageReceived(const std::shared_ptr<looper::Message>&) override {
+        delivered.fetch_add(1, std::memory_order_release);
+    }
+};
+
+void BenchLooper(bench::MicroBench& b) {
+    if (! b.wants("looper/")) return;
+    auto looper  = std::make_shared<looper::Looper>();
+    auto handler = std::make_shared<CountHandler>();
+    looper->setName("bench");
+    looper->start();
+    looper->registerHandler(handler);
+
+    b.run("looper/latency", [&] {
+        u64 want = handler->delivered.load() + 1;
+        looper::Message::create(1, handler)->post();
+        handler->waitFor(want);
+    });
+
+    constexpr u64 per_thread { 10000 };
+    for (u32 producers : { 1u, 2u, 4u, 8u }) {
+        std::string name = "looper/producers_" + std::to_string(producers);
+        if (! b.wants(name)) continue;
+
+        std::vector<double> samples;
+        auto                spent = clk::duration::zero();
+        while (spent < b.minTime() || samples.size() < 5) {
+            u64  want  = handler->delivered.load() + per_thread * producers;
+            auto begin = clk::now();
+
+            std::vector<std::thread> threads;
+            for (u32 t = 0; t < producers; t++) {
+                threads.emplace_back([&handler] {
+                    for (u64 i = 0; i < per_thread; i++)
+                        looper::Message::create(1, handler)->post();
+                });
+            }
+            for (auto& t : threads) t.join();
+            handler->waitFor(want);
+
+            auto took = clk::now() - begin;
+            spent += took;
+            samples.push_back(Nanos(took) / (double)(per_thread * producers));
+        }
+        b.record(name, std::move(samples));
+    }
+    looper->unregisterHandler(handler->id());
+    looper->stop();
+}
+
+void BenchMessage(bench::MicroBench& b) {
+    if (! b.wants("message/")) return;
+    auto looper  = std::make_shared<looper::Looper>();
+    auto handler = std::make_shared<CountHandler>();
+    looper->registerHandler(handler);
+
+    b.run("message/create", [] {
+        Keep(looper::Message::create());
+    });
+    // from the free list of the handler's looper
+    b.run("message/create_pooled", [&] {
+        Keep(looper::Message::create(1, handler));
+    });
+
+    auto obj = std::make_shared<int>(1);
+    // what a command posted to the render thread carries
+    b.run("message/command", [&] {
+        auto msg = looper::Message::create(1, handler);
+        msg->setInt32("cmd", 3);
+        msg->setFloat("value", 1.0f);
+        msg->setObject("scene", obj);
+        i32                  cmd { 0 };
+        float                value { 0.0f };
+        std::shared_ptr<int> scene;
+        Keep(msg->findInt32("cmd", &cmd) && msg->findFloat("value", &value) &&
+             msg->findObject("scene", &scene));
+    });
+
+    // more items than are inline, the last is found after a scan over all
+    auto full = looper::Message::create();
+    for (i32 i = 0; i < 8; i++) full->setInt32("item" + std::to_string(i), i);
+    b.run("message/find_last", [&] {
+        i32 v { 0 };
+        Keep(full->findInt32("item7", &v));
+    });
+    b.run("message/find_missing", [&] {
+        i32 v { 0 };
+        Keep(full->findInt32("none", &v));
+    });
+    looper->unregisterHandler(handler->id());
+}
+
+void BenchBlockingQueue(bench::MicroBench& b) {
+    BlockingQueue<i32> queue(64);
+    b.run("blocking_queue/push_pop", [&] {
+        queue.push(1);
+        Keep(queue.pop());
+    });
+
+    if (! b.wants("blocking_queue/handoff")) return;
+    // a producer thread keeps it full, until its last is a -1
+    std::atomic<bool> stop { false };
+    std::thread       producer([&] {
+        while (! stop.load(std::memory_order_relaxed)) queue.push(1);
+        queue.push(-1);
+    });
+    b.run("blocking_queue/handoff", [&] {
+        Keep(queue.pop());
+    });
+    stop = true;
+    while (queue.pop() != -1) {
+    }
+    producer.join();
+}
+
+// how far apart the ticks were from the interval, in ns, the first quarter warms up
+std::vector<double> TickErrors(const std::vector<clk::time_point>& ticks, clk::duration interval) {
+    std::vector<double> errors;
+    for (usize i = std::max<usize>(1, ticks.size() / 4); i < ticks.size(); i++)
+        errors.push_back(std::abs(Nanos(ticks[i] - ticks[i - 1] - interval)));
+    return errors;
+}
+
+void BenchTimers(bench::MicroBench& b, u32 count) {
+    using namespace std::chrono_literals;
+    for (auto interval : { 1000us, 16667us }) {
+        std::string name = "thread_timer/" + std::to_string(interval.count()) + "us";
+        if (! b.wants(name)) continue;
+
+        std::vector<clk::time_point> ticks;
+        ticks.reserve(count);
+        std::atomic<bool> done { false };
+        ThreadTimer       timer([&] {
+            if (ticks.size() < count) ticks.push_back(clk::now());
+            if (ticks.size() == count) done = true;
+        });
+        timer.SetInterval(interval);
+        timer.Start();
+        while (! done) std::this_thread::sleep_for(interval);
+        timer.Stop();
+        b.record(name, TickErrors(ticks, interval));
+    }
+
+    for (u16 fps : { (u16)30, (u16)60 }) {
+        std::string name = "frame_timer/" + std::to_string(fps) + "fps";
+        if (! b.wants(name)) continue;
+
+        std::vector<clk::time_point> ticks;
+        ticks.reserve(count);
+        std::atomic<bool> done { false };
+        FrameTimer        timer;
+        // a frame of no time, the next is due an interval after the last
+        timer.SetCallback([&] {
+            timer.FrameBegin();
+            if (ticks.size() < count) ticks.push_back(clk::now());
+            if (ticks.size() == count) done = true;
+            timer.FrameEnd();
+        });
+        timer.SetPresentPacing(false);
+        timer.SetRequiredFps(fps);
+        timer.Run();
+        while (! done) std::this_thread::sleep_for(10ms);
+        timer.Stop();
+        b.record(name, TickErrors(ticks, std::chrono::microseconds(1000000 / fps)));
+    }
+
+    // the frame timers of six monitors on the shared thread, the first one's ticks
+    if (std::string name = "frame_timer/6x60fps"; b.wants(name)) {
+        std::vector<clk::time_point> ticks;
+        ticks.reserve(count);
+        std::atomic<bool>                        done { false };
+        std::vector<std::unique_ptr<FrameTimer>> timers;
+        for (usize i = 0; i < 6; i++) {
+            auto& timer = *timers.emplace_back(std::make_unique<FrameTimer>());
+            timer.SetCallback([&timer, &ticks, &done, count, first = i == 0] {
+                timer.FrameBegin();
+                if (first && ticks.size() < count) ticks.push_back(clk::now());
+                if (first && ticks.size() == count) done = true;
+                timer.FrameEnd();
+            });
+            timer.SetPresentPacing(false);
+            timer.SetRequiredFps(60);
+            timer.Run();
+        }
+        while (! done) std::this_thread::sleep_for(10ms);
+        for (auto& timer : timers) timer->Stop();
+        b.record(name, TickErrors(ticks, std::chrono::microseconds(1000000 / 60)));
+    }
+}
+
+void BenchRandom(bench::MicroBench& b) {
+    b.run("random/int", [] {
+        Keep(Random::get(0, 1000));
+    });
+    b.run("random/float", [] {
+        Keep(Random::get(0.0f, 1.0f));
+    });
+    // what particles draw from
+    b.run("random/particle", [] {
+        Keep(ParticleRandom::get(0.0f, 1.0f));
+    });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Args args;
+    if (! ParseArgs(argc, argv, args)) return 1;
+
+    bench::MicroBench b(args.filter, args.min_time);
+    BenchLooper(b);
+    BenchMessage(b);
+    BenchBlockingQueue(b);
+    BenchTimers(b, args.ticks);
+    BenchRandom(b);
+
+    if (! args.out.empty() && ! b.save(args.out)) {
+        LOG_ERROR("can't write %s", args.out.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,311 @@
+// Micro benchmarks of the asset path a scene load goes through, with the files of a real scene:
+// lookups in the mounted vfs, reading the pkg toc, stream reads, tex and mdl decodes and the
+// scene parse. Prints the time an operation takes of every case.
+//
+//   wpIoBench --assets <dir> --scene <dir/scene.pkg> [--filter <name part>] [--min-time S]
+//             [--cache <dir>] [--out <file.json>]
+//
+// The tex cases decode every texture of the scene and fill the mips that are decoded late, raw
+// are the ones of pixels in the tex, lz4 compressed or not, image the png and jpeg ones. Without
+// --cache textures aren't taken from the transcode cache and shaders are compiled each parse.
+
+#include "WPSceneParser.hpp"
+#include "WPPkgFs.hpp"
+#include "WPTexImageParser.hpp"
+#include "WPMdlParser.hpp"
+#include "Scene/Scene.h"
+#include "Audio/SoundManager.h"
+#include "Fs/VFS.h"
+#include "Fs/PhysicalFs.h"
+#include "Fs/CBinaryStream.h"
+#include "Fs/LimitedBinaryStream.h"
+#include "Utils/Logging.h"
+#include "MicroBench.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace wallpaper;
+using bench::Keep;
+
+namespace
+{
+
+struct Args {
+    std::string assets;
+    std::string scene;
+    std::string cache;
+    std::string filter;
+    std::string out;
+    double      min_time { 0.5 };
+};
+
+bool ParseArgs(int argc, char** argv, Args& args) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view key = argv[i];
+        const char*      val = argv[i + 1];
+        if (key == "--assets")
+            args.assets = val;
+        else if (key == "--scene")
+            args.scene = val;
+        else if (key == "--cache")
+            args.cache = val;
+        else if (key == "--filter")
+            args.filter = val;
+        else if (key == "--min-time")
+            args.min_time = std::strtod(val, nullptr);
+        else if (key == "--out")
+            args.out = val;
+        else {
+            LOG_ERROR("unknown option %s", argv[i]);
+            return false;
+        }
+    }
+    if (argc % 2 == 0) {
+        LOG_ERROR("option %s has no value", argv[argc - 1]);
+        return false;
+    }
+    if (args.assets.empty() || args.scene.empty()) {
+        LOG_ERROR("--assets and --scene are needed");
+        return false;
+    }
+    return args.min_time > 0.0;
+}
+
+// a scene as SceneWallpaper mounts it, and the paths of its files in the vfs
+struct Mounted {
+    std::unique_ptr<fs::VFS> vfs;
+    std::string              pkg;
+    std::string              entry;
+    std::string              id;
+    std::vector<std::string> files;
+};
+
+bool MountScene(const Args& args, Mounted& m) {
+    m.vfs = std::make_unique<fs::VFS>();
+    if (! m.vfs->Mount("/assets", fs::CreatePhysicalFs(args.assets), "assets")) {
+        LOG_ERROR("can't mount %s", args.assets.c_str());
+        return false;
+    }
+    std::filesystem::path pkg { args.scene };
+    pkg.replace_extension("pkg");
+    m.entry = pkg.filename().replace_extension("json").native();
+    m.id    = pkg.parent_path().filename().native();
+
+    if (auto pkgfs = fs::WPPkgFs::CreatePkgFs(pkg.native())) {
+        for (auto path : pkgfs->Files()) m.files.push_back("/assets" + std::string(path));
+        m.pkg = pkg.native();
+        m.vfs->Mount("/assets", std::move(pkgfs));
+    } else {
+        auto            dir = pkg.parent_path();
+        std::error_code ec;
+        for (auto& e : std::filesystem::recursive_directory_iterator(dir, ec)) {
+            if (! e.is_regular_file()) continue;
+            m.files.push_back("/assets/" + e.path().lexically_relative(dir).generic_string());
+        }
+        if (! m.vfs->Mount("/assets", fs::CreatePhysicalFs(dir.native()))) {
+            LOG_ERROR("can't load %s", args.scene.c_str());
+            return false;
+        }
+    }
+    if (! args.cache.empty() &&
+        ! m.vfs->Mount("/cache", fs::CreatePhysicalFs(args.cache, true), "cache")) {
+        LOG_ERROR("can't mount cache folder %s", args.cache.c_str());
+    }
+    return ! m.files.empty();
+}
+
+bool EndsWith(std::string_view s, std::string_view end) {
+    return s.size() >= end.size() && s.substr(s.size() - end.size()) == end;
+}
+
+void BenchVfs(bench::MicroBench& b, const Mounted& m) {
+    // as many misses as hits, the misses go through every mount
+    std::vector<std::string> misses;
+    for (auto& f : m.files) misses.push_back(f + ".missing");
+
+    usize i { 0 };
+    b.run("vfs/contains", [&] {
+        Keep(m.vfs->Contains(m.files[i++ % m.files.size()]));
+    });
+    b.run("vfs/contains_miss", [&] {
+        Keep(m.vfs->Contains(misses[i++ % misses.size()]));
+    });
+    b.run("vfs/open", [&] {
+        Keep(m.vfs->Open(m.files[i++ % m.files.size()]));
+    });
+}
+
+void BenchPkg(bench::MicroBench& b, const Mounted& m) {
+    if (m.pkg.empty()) return;
+    b.run("pkg/index", [&] {
+        Keep(fs::WPPkgFs::CreatePkgFs(m.pkg, false));
+    });
+    b.run("pkg/index_reused", [&] {
+        Keep(fs::WPPkgFs::CreatePkgFs(m.pkg));
+    });
+}
+
+void BenchStream(bench::MicroBench& b, const std::string& name, fs::IBinaryStream& s,
+                 std::vector<uint8_t>& buf) {
+    // a toc or header read, ints one by one
+    b.run(name + "/ints", [&] {
+        if (s.Tell() + 4 > s.Size()) s.SeekSet(0);
+        Keep(s.ReadInt32());
+    });
+    b.run(
+        name + "/seq_4k",
+        [&] {
+            if (s.Read(buf.data(), 4096) < 4096) s.SeekSet(0);
+        },
+        4096);
+    b.run(
+        name + "/whole",
+        [&] {
+            s.SeekSet(0);
+            Keep(s.Read(buf.data(), buf.size()));
+        },
+        buf.size());
+    // entries of a pkg read out of order
+    std::mt19937                         rand(42);
+    std::uniform_int_distribution<isize> at(0, s.Size() - 4096);
+    b.run(
+        name + "/random_4k",
+        [&] {
+            s.SeekSet(at(rand));
+            Keep(s.Read(buf.data(), 4096));
+        },
+        4096);
+}
+
+void BenchStreams(bench::MicroBench& b, const Mounted& m) {
+    // the pkg from disk, or the largest file of a directory
+    std::string path = m.pkg;
+    if (path.empty()) {
+        uintmax_t largest { 0 };
+        for (auto& f : m.files) {
+            auto            native = m.vfs->NativePath(f);
+            std::error_code ec;
+            auto            size = std::filesystem::file_size(native, ec);
+            if (! ec && size > largest) {
+                largest = size;
+                path    = native.native();
+            }
+        }
+    }
+    auto file = fs::CreateCBinaryStream(path);
+    if (! file || file->Size() < 8192) return;
+
+    // a pkg entry is the range of a limited stream
+    const isize             size = file->Size();
+    fs::LimitedBinaryStream part(file, size / 4, size / 2);
+    std::vector<uint8_t>    buf(std::min<usize>(1 << 20, (usize)part.Size()));
+    BenchStream(b, "cbinary", *file, buf);
+    BenchStream(b, "limited", part, buf);
+}
+
+// textures by their name for the parser, raw ones and image ones
+void TexNames(const Mounted& m, std::vector<std::string>& raw, std::vector<std::string>& image) {
+    constexpr std::string_view dir { "/assets/materials/" }, ext { ".tex" };
+    WPTexImageParser           parser(m.vfs.get());
+    for (auto& f : m.files) {
+        if (! f.starts_with(dir) || ! EndsWith(f, ext)) continue;
+        auto name = f.substr(dir.size(), f.size() - dir.size() - ext.size());
+        auto head = parser.ParseHeader(name);
+        if (! head.fromTex || head.isVideo) continue;
+        (head.type == ImageType::UNKNOWN ? raw : image).push_back(std::move(name));
+    }
+}
+
+// bytes of all mips, those of a fill written into buf
+usize Decode(WPTexImageParser& parser, const std::string& name, std::vector<uint8_t>& buf) {
+    auto img = parser.Parse(name);
+    if (! img) return 0;
+    usize bytes { 0 };
+    for (auto& slot : img->slots) {
+        for (auto& mip : slot.mipmaps) {
+            bytes += (usize)mip.size;
+            if (! mip.fill) continue;
+            buf.resize(std::max(buf.size(), (usize)mip.size));
+            mip.fill({ buf.data(), (usize)mip.size });
+        }
+    }
+    Keep(img);
+    return bytes;
+}
+
+void BenchTex(bench::MicroBench& b, const Mounted& m) {
+    std::vector<std::string> raw, image;
+    TexNames(m, raw, image);
+
+    WPTexImageParser     parser(m.vfs.get());
+    std::vector<uint8_t> buf;
+    for (auto [name, texs] : { std::pair { "tex/raw", &raw }, { "tex/image", &image } }) {
+        if (texs->empty() || ! b.wants(name)) continue;
+        usize bytes { 0 };
+        for (auto& t : *texs) bytes += Decode(parser, t, buf);
+        b.run(
+            name,
+            [&, texs = texs] {
+                for (auto& t : *texs) Decode(parser, t, buf);
+            },
+            bytes);
+    }
+}
+
+void BenchMdl(bench::MicroBench& b, const Mounted& m) {
+    std::vector<std::string> mdls;
+    for (auto& f : m.files) {
+        if (EndsWith(f, ".mdl")) mdls.push_back(f.substr(std::string_view("/assets/").size()));
+    }
+    if (mdls.empty()) return;
+    b.run("mdl/parse", [&] {
+        for (auto& path : mdls) {
+            WPMdl mdl;
+            Keep(WPMdlParser::Parse(path, *m.vfs, mdl));
+        }
+    });
+}
+
+void BenchScene(bench::MicroBench& b, const Mounted& m) {
+    if (! b.wants("scene/parse")) return;
+    std::string src;
+    if (auto f = m.vfs->Open("/assets/" + m.entry)) src = f->ReadAllStr();
+    if (src.empty()) {
+        LOG_ERROR("no scene in %s", m.entry.c_str());
+        return;
+    }
+    // sounds are parsed, not played
+    audio::SoundManager sound;
+    b.run("scene/parse", [&] {
+        WPSceneParser parser;
+        Keep(parser.Parse(m.id, src, *m.vfs, sound));
+    });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Args args;
+    if (! ParseArgs(argc, argv, args)) return 1;
+
+    Mounted m;
+    if (! MountScene(args, m)) return 1;
+
+    bench::MicroBench b(args.filter, args.min_time);
+    BenchVfs(b, m);
+    BenchPkg(b, m);
+    BenchStreams(b, m);
+    BenchTex(b, m);
+    BenchMdl(b, m);
+    BenchScene(b, m);
+
+    if (! args.out.empty() && ! b.save(args.out)) {
+        LOG_ERROR("can't write %s", args.out.c_str());
+        return 1;
+    }
+    return 0;
+}
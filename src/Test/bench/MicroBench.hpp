@@ -0,0 +1,146 @@
+#pragma once
+// Timing of small operations for the micro benchmarks. A case runs in batches, each grown until it
+// takes a millisecond, until its minimum time is spent, the time an operation took in each batch
+// is a sample. A warm-up batch is not counted.
+
+#include "Core/Literals.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wallpaper
+{
+namespace bench
+{
+
+// the value counts as used, the work making it isn't optimized away
+template<typename T>
+inline void Keep(T const& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+class MicroBench {
+public:
+    using clk = std::chrono::steady_clock;
+
+    struct Result {
+        std::string name;
+        u64         ops { 0 };
+        double      mean_ns { 0.0 };
+        double      p50_ns { 0.0 };
+        double      p95_ns { 0.0 };
+        // of one operation, 0 if it has no size
+        u64 bytes { 0 };
+    };
+
+    // cases without filter in their name are skipped
+    MicroBench(std::string filter, double min_seconds)
+        : m_filter(std::move(filter)),
+          m_min_time(std::chrono::duration_cast<clk::duration>(
+              std::chrono::duration<double>(min_seconds))) {}
+
+    bool wants(std::string_view name) const {
+        return m_filter.empty() || name.find(m_filter) != std::string_view::npos;
+    }
+
+    // op does one operation, bytes of it give a rate
+    template<typename F>
+    void run(std::string_view name, F&& op, u64 bytes = 0) {
+        if (! wants(name)) return;
+
+        u64 batch { 1 };
+        for (;;) {
+            auto begin = clk::now();
+            for (u64 i = 0; i < batch; i++) op();
+            if (clk::now() - begin >= batch_time || batch >= max_batch) break;
+            batch *= 2;
+        }
+
+        std::vector<double> samples;
+        u64                 ops { 0 };
+        auto                spent = clk::duration::zero();
+        while (spent < m_min_time || samples.size() < min_samples) {
+            auto begin = clk::now();
+            for (u64 i = 0; i < batch; i++) op();
+            auto took = clk::now() - begin;
+            spent += took;
+            ops += batch;
+            samples.push_back(std::chrono::duration<double, std::nano>(took).count() /
+                              (double)batch);
+        }
+
+        record(name, std::move(samples), bytes, ops);
+    }
+
+    // for cases timed by themselves, the samples are the time of an operation, or what else is
+    // taken per operation
+    void record(std::string_view name, std::vector<double> samples_ns, u64 bytes = 0,
+                u64 ops = 0) {
+        if (samples_ns.empty() || ! wants(name)) return;
+        Result res { .name = std::string(name), .ops = ops, .bytes = bytes };
+        if (res.ops == 0) res.ops = samples_ns.size();
+        double sum { 0.0 };
+        for (double s : samples_ns) sum += s;
+        res.mean_ns = sum / (double)samples_ns.size();
+        std::sort(samples_ns.begin(), samples_ns.end());
+        auto at = [&samples_ns](double p) {
+            return samples_ns[std::min(samples_ns.size() - 1,
+                                       (usize)(p * (double)samples_ns.size()))];
+        };
+        res.p50_ns = at(0.5);
+        res.p95_ns = at(0.95);
+        print(res);
+        m_results.push_back(std::move(res));
+    }
+
+    clk::duration              minTime() const { return m_min_time; }
+    const std::vector<Result>& results() const { return m_results; }
+
+    nlohmann::json report() const {
+        auto cases = nlohmann::json::array();
+        for (auto& r : m_results) {
+            nlohmann::json c {
+                { "name", r.name },     { "ops", r.ops },       { "mean_ns", r.mean_ns },
+                { "p50_ns", r.p50_ns }, { "p95_ns", r.p95_ns },
+            };
+            if (r.bytes > 0) c["mb_per_s"] = MbPerSec(r);
+            cases.push_back(std::move(c));
+        }
+        return cases;
+    }
+
+    bool save(const std::string& path) const {
+        std::ofstream out(path);
+        if (! out.is_open()) return false;
+        out << report().dump(2) << '\n';
+        return out.good();
+    }
+
+private:
+    constexpr static auto  batch_time { std::chrono::milliseconds(1) };
+    constexpr static u64   max_batch { u64(1) << 30 };
+    constexpr static usize min_samples { 5 };
+
+    static double MbPerSec(const Result& r) { return (double)r.bytes / r.mean_ns * 1e3; }
+
+    static void print(const Result& r) {
+        std::printf("%-32s %12.1f ns/op  p50 %12.1f  p95 %12.1f", r.name.c_str(), r.mean_ns,
+                    r.p50_ns, r.p95_ns);
+        if (r.bytes > 0) std::printf("  %10.1f MB/s", MbPerSec(r));
+        std::printf("\n");
+    }
+
+    std::string         m_filter;
+    clk::duration       m_min_time;
+    std::vector<Result> m_results;
+};
+
+} // namespace bench
+} // namespace wallpaper
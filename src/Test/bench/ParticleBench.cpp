@@ -0,0 +1,260 @@
+// Headless particle benchmark, steps a particle system for a number of frames without a render
+// and reports the time per live particle of simulation and mesh generation.
+//
+//   wpParticleBench [--frames N] [--fps N] [--count N] [--lifetime S] [--ops a,b,..]
+//   wpParticleBench --assets <dir> --particle <particles/x.json> [--frames N] [--fps N]
+//
+// The first form builds one box emitter spawning count particles a lifetime with the given
+// operators, by their wallpaper engine names, the second loads a particle file as a scene
+// would. A quarter of the frames warm up and are not counted.
+
+#include "WPJson.hpp"
+#include "WPParticleParser.hpp"
+#include "wpscene/WPParticleObject.h"
+#include "Particle/ParticleSystem.h"
+#include "Particle/WPParticleRawGener.h"
+#include "Scene/Scene.h"
+#include "Fs/VFS.h"
+#include "Fs/PhysicalFs.h"
+#include "SpecTexs.hpp"
+#include "Utils/Logging.h"
+#include "Utils/AllocCount.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace wallpaper;
+using clk = std::chrono::steady_clock;
+
+namespace
+{
+
+u64 Nanos(clk::duration d) {
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+struct Args {
+    u32         frames { 600 };
+    u32         fps { 30 };
+    u32         count { 10000 };
+    float       lifetime { 2.0f };
+    std::string ops { "movement,alphafade,sizechange" };
+    std::string assets;
+    std::string particle;
+};
+
+bool ParseArgs(int argc, char** argv, Args& args) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view key = argv[i];
+        const char*      val = argv[i + 1];
+        if (key == "--frames")
+            args.frames = (u32)std::strtoul(val, nullptr, 10);
+        else if (key == "--fps")
+            args.fps = (u32)std::strtoul(val, nullptr, 10);
+        else if (key == "--count")
+            args.count = (u32)std::strtoul(val, nullptr, 10);
+        else if (key == "--lifetime")
+            args.lifetime = std::strtof(val, nullptr);
+        else if (key == "--ops")
+            args.ops = val;
+        else if (key == "--assets")
+            args.assets = val;
+        else if (key == "--particle")
+            args.particle = val;
+        else {
+            LOG_ERROR("unknown option %s", argv[i]);
+            return false;
+        }
+    }
+    if (argc % 2 == 0) {
+        LOG_ERROR("option %s has no value", argv[argc - 1]);
+        return false;
+    }
+    if (args.assets.empty() != args.particle.empty()) {
+        LOG_ERROR("--assets and --particle go together");
+        return false;
+    }
+    return args.frames > 0 && args.fps > 0;
+}
+
+// forwards to the wallpaper engine generator and sums the time it takes, subsystems run on
+// several workers so it's thread time
+class TimedGener : public IParticleRawGener {
+public:
+    u32 GenGLData(std::span<const std::unique_ptr<ParticleInstance>> instances, SceneMesh& mesh,
+                  ParticleRawGenSpecOp& specOp, float blend, std::span<const ParticleRef> order,
+                  u32 first) override {
+        auto begin    = clk::now();
+        u32  end_quad = m_gener.GenGLData(instances, mesh, specOp, blend, order, first);
+        auto end      = clk::now();
+        if (! counting) return end_quad;
+        ns += Nanos(end - begin);
+
+        u64 live = 0;
+        for (auto& inst : instances) {
+            const auto& ps = inst->Particles();
+            for (usize i = 0; i < ps.size(); i++) live += ps.at(ParticleBuffer::Lifetime, i) > 0;
+        }
+        particles += live;
+        return end_quad;
+    }
+
+    bool             counting { false };
+    std::atomic<u64> ns { 0 };
+    std::atomic<u64> particles { 0 };
+
+private:
+    WPParticleRawGener m_gener;
+};
+
+// the instanced sprite layout of the scene parser
+std::shared_ptr<SceneMesh> MakeMesh(u32 count) {
+    auto mesh = std::make_shared<SceneMesh>(true);
+    mesh->AddVertexArray(
+        SceneVertexArray({ { WE_IN_POSITION.data(), VertexType::FLOAT3, false },
+                           { WE_IN_TEXCOORDVEC4.data(), VertexType::HALF4 },
+                           { WE_IN_COLOR.data(), VertexType::UNORM8X4 },
+                           { WE_IN_TEXCOORDC2.data(), VertexType::FLOAT2, false } },
+                         count));
+    mesh->GetVertexArray(0).SetPerInstance(true);
+    mesh->SetInstanceVertexCount(4);
+    return mesh;
+}
+
+std::unique_ptr<ParticleSubSystem> MakeSubSystem(ParticleSystem& sys, u32 maxcount) {
+    return std::make_unique<ParticleSubSystem>(
+        sys,
+        MakeMesh(maxcount),
+        maxcount,
+        1.0,
+        1,
+        1.0,
+        ParticleSubSystem::SpawnType::STATIC,
+        [](const ParticleBuffer&, usize, const ParticleRawGenSpec& spec) {
+            if (*spec.lifetime < 0.0f) *spec.lifetime = 0.0f;
+        });
+}
+
+bool BuildSynthetic(ParticleSystem& sys, const Args& args) {
+    auto sub = MakeSubSystem(sys, args.count);
+
+    wpscene::Emitter emitter;
+    emitter.FromJson({ { "id", 1 },
+                       { "name", "boxrandom" },
+                       { "rate", (float)args.count / args.lifetime },
+                       { "distancemax", "512 512 0" },
+                       { "speedmin", 20.0f },
+                       { "speedmax", 200.0f } });
+    if (auto op = WPParticleParser::genParticleEmittOp(emitter)) sub->AddEmitter(std::move(*op));
+
+    for (auto& ini : { nlohmann::json { { "name", "lifetimerandom" },
+                                        { "min", args.lifetime },
+                                        { "max", args.lifetime } },
+                       nlohmann::json { { "name", "sizerandom" } },
+                       nlohmann::json { { "name", "colorrandom" } },
+                       nlohmann::json { { "name", "velocityrandom" } } }) {
+        if (auto op = WPParticleParser::genParticleInitOp(ini)) sub->AddInitializer(std::move(*op));
+    }
+
+    std::stringstream ss(args.ops);
+    std::string       name;
+    while (std::getline(ss, name, ',')) {
+        if (name.empty()) continue;
+        auto op = WPParticleParser::genParticleOperatorOp({ { "name", name } }, {});
+        if (! op) {
+            LOG_ERROR("unknown operator %s", name.c_str());
+            return false;
+        }
+        sub->AddOperator(std::move(*op));
+    }
+    sys.subsystems.emplace_back(std::move(sub));
+    return true;
+}
+
+// children are left out, they need the scene's node tree
+bool BuildFromFile(ParticleSystem& sys, Scene& scene, const Args& args) {
+    scene.vfs = std::make_unique<fs::VFS>();
+    if (! scene.vfs->Mount("/assets", fs::CreatePhysicalFs(args.assets))) {
+        LOG_ERROR("can't mount %s", args.assets.c_str());
+        return false;
+    }
+    nlohmann::json json;
+    if (! PARSE_JSON_FILE(*scene.vfs, "/assets/" + args.particle, json)) {
+        LOG_ERROR("can't read %s", args.particle.c_str());
+        return false;
+    }
+    wpscene::Particle particle;
+    if (! particle.FromJson(json, *scene.vfs)) return false;
+
+    u32  maxcount = std::min(particle.maxcount, 20000u);
+    auto sub      = MakeSubSystem(sys, maxcount);
+    for (auto& em : particle.emitters) {
+        if (auto op = WPParticleParser::genParticleEmittOp(em)) sub->AddEmitter(std::move(*op));
+    }
+    for (auto& ini : particle.initializers) {
+        if (auto op = WPParticleParser::genParticleInitOp(ini)) sub->AddInitializer(std::move(*op));
+    }
+    for (auto& opj : particle.operators) {
+        if (auto op = WPParticleParser::genParticleOperatorOp(opj, {}))
+            sub->AddOperator(std::move(*op));
+    }
+    sys.subsystems.emplace_back(std::move(sub));
+    return true;
+}
+
+double PerParticle(u64 ns, u64 particles) {
+    return particles > 0 ? (double)ns / (double)particles : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Args args;
+    if (! ParseArgs(argc, argv, args)) return 1;
+
+    Scene scene;
+    auto& sys   = *scene.paritileSys;
+    auto  gener = std::make_unique<TimedGener>();
+    auto& timed = *gener;
+    sys.gener   = std::move(gener);
+
+    bool built =
+        args.particle.empty() ? BuildSynthetic(sys, args) : BuildFromFile(sys, scene, args);
+    if (! built) return 1;
+
+    const u32 warmup = args.frames / 4;
+    u64       emitt_ns { 0 }, emitt_allocs { 0 };
+    for (u32 f = 0; f < args.frames + warmup; f++) {
+        timed.counting = f >= warmup;
+        scene.PassFrameTime(1.0 / args.fps);
+
+        const u64 allocs_begin = allocs::count();
+        auto      begin        = clk::now();
+        sys.Emitt();
+        auto end = clk::now();
+        if (! timed.counting) continue;
+        emitt_ns += Nanos(end - begin);
+        emitt_allocs += allocs::count() - allocs_begin;
+    }
+
+    const u64 particles = timed.particles.load();
+    const u64 mesh_ns   = timed.ns.load();
+    // workers overlap, the split is exact with one subsystem
+    const u64 sim_ns = emitt_ns > mesh_ns ? emitt_ns - mesh_ns : 0;
+
+    std::printf("frames     %u\n", args.frames);
+    std::printf("particles  %.1f per frame\n", (double)particles / args.frames);
+    std::printf("simulate   %.2f ns/particle\n", PerParticle(sim_ns, particles));
+    std::printf("mesh       %.2f ns/particle\n", PerParticle(mesh_ns, particles));
+    std::printf("total      %.2f ns/particle, %.3f ms/frame\n",
+                PerParticle(emitt_ns, particles),
+                (double)emitt_ns / args.frames / 1e6);
+    if (allocs::counting())
+        std::printf("allocs     %.1f per frame\n", (double)emitt_allocs / args.frames);
+    return 0;
+}
@@ -0,0 +1,486 @@
+// Headless scene benchmark, loads a scene as the wallpaper would, renders it offscreen for a
+// number of frames at a fixed timestep as fast as it can and prints the load phases, frame time
+// percentiles and peak device memory as json.
+//
+//   wpSceneBench --assets <dir> --scene <dir/scene.pkg> [--frames N] [--fps N] [--width N]
+//                [--height N] [--replay <record.json>] [--cache <dir>] [--out <file.json>]
+//   wpSceneBench --assets <dir> --suite <suite.json> --corpus <dir> [--baseline <file.json>]
+//                [--threshold F] [--cache <dir>] [--out <file.json>]
+//
+// fps only sets the timestep the scene moves on by, frames aren't paced. A quarter of the frames
+// warm up and are not counted. Frames of a static scene submit nothing, drawn tells how many did.
+// Built with ENABLE_ALLOC_COUNT the heap allocations of each frame are counted too, a steady
+// frame should make none.
+//
+// A replay runs the frames of an input record, see the input_record property, in place of the
+// fixed timestep: their times and mouse positions, with the record's seed, so two builds draw the
+// same frames. frames and fps don't apply then, the properties of the record aren't set.
+//
+// The second form runs every scene of a suite, see Test/bench/scene_suite.json, with scenes
+// relative to the corpus, as is a scene's replay. Its output is the baseline of a later run, which
+// fails with 2 if the total load time, the p95 render thread or gpu frame time, the allocations a
+// frame or the peak memory of a scene went up by more than the threshold, 0.1 by default.
+
+#include "WPSceneParser.hpp"
+#include "WPPkgFs.hpp"
+#include "SceneWallpaperSurface.hpp"
+#include "Scene/Scene.h"
+#include "Particle/ParticleSystem.h"
+#include "Interface/IImageParser.h"
+#include "Interface/IShaderValueUpdater.h"
+#include "WPShaderValueUpdater.hpp"
+#include "InputRecord.hpp"
+#include "Audio/SoundManager.h"
+#include "Fs/VFS.h"
+#include "Fs/PhysicalFs.h"
+#include "RenderGraph/RenderGraph.hpp"
+#include "VulkanRender/SceneToRenderGraph.hpp"
+#include "VulkanRender/VulkanRender.hpp"
+#include "Utils/Logging.h"
+#include "Utils/AllocCount.hpp"
+#include "Core/Random.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace wallpaper;
+using clk = std::chrono::steady_clock;
+
+namespace
+{
+
+double Ms(clk::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+// a scene and how it's run
+struct Run {
+    std::string name;
+    std::string scene;
+    u32         frames { 600 };
+    u32         fps { 30 };
+    u16         width { 1920 };
+    u16         height { 1080 };
+    // an input record the frames are taken from
+    std::string replay;
+};
+
+struct Args {
+    Run         run;
+    std::string assets;
+    std::string cache;
+    std::string out;
+    std::string suite;
+    std::string corpus;
+    std::string baseline;
+    double      threshold { 0.1 };
+};
+
+bool ValidRun(const Run& run) {
+    return run.frames > 0 && run.fps > 0 && run.width > 0 && run.height > 0;
+}
+
+bool ParseArgs(int argc, char** argv, Args& args) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view key = argv[i];
+        const char*      val = argv[i + 1];
+        if (key == "--frames")
+            args.run.frames = (u32)std::strtoul(val, nullptr, 10);
+        else if (key == "--fps")
+            args.run.fps = (u32)std::strtoul(val, nullptr, 10);
+        else if (key == "--width")
+            args.run.width = (u16)std::strtoul(val, nullptr, 10);
+        else if (key == "--height")
+            args.run.height = (u16)std::strtoul(val, nullptr, 10);
+        else if (key == "--assets")
+            args.assets = val;
+        else if (key == "--scene")
+            args.run.scene = val;
+        else if (key == "--replay")
+            args.run.replay = val;
+        else if (key == "--cache")
+            args.cache = val;
+        else if (key == "--out")
+            args.out = val;
+        else if (key == "--suite")
+            args.suite = val;
+        else if (key == "--corpus")
+            args.corpus = val;
+        else if (key == "--baseline")
+            args.baseline = val;
+        else if (key == "--threshold")
+            args.threshold = std::strtod(val, nullptr);
+        else {
+            LOG_ERROR("unknown option %s", argv[i]);
+            return false;
+        }
+    }
+    if (argc % 2 == 0) {
+        LOG_ERROR("option %s has no value", argv[argc - 1]);
+        return false;
+    }
+    if (args.assets.empty() || args.run.scene.empty() == args.suite.empty()) {
+        LOG_ERROR("--assets and one of --scene and --suite are needed");
+        return false;
+    }
+    if (args.suite.empty() != args.corpus.empty()) {
+        LOG_ERROR("--suite and --corpus go together");
+        return false;
+    }
+    if (! args.baseline.empty() && args.suite.empty()) {
+        LOG_ERROR("--baseline needs --suite");
+        return false;
+    }
+    if (! args.run.replay.empty() && ! args.suite.empty()) {
+        LOG_ERROR("--replay is of --scene, suite scenes have their own");
+        return false;
+    }
+    return ValidRun(args.run) && args.threshold >= 0.0;
+}
+
+// mounted as SceneWallpaper does, the pkg or the directory it's in
+std::unique_ptr<fs::VFS> MountScene(const Args& args, const std::string& scene,
+                                    std::string& entry, std::string& id) {
+    auto vfs = std::make_unique<fs::VFS>();
+    if (! vfs->Mount("/assets", fs::CreatePhysicalFs(args.assets), "assets")) {
+        LOG_ERROR("can't mount %s", args.assets.c_str());
+        return nullptr;
+    }
+    std::filesystem::path pkg { scene };
+    pkg.replace_extension("pkg");
+    entry = pkg.filename().replace_extension("json").native();
+    id    = pkg.parent_path().filename().native();
+    if (! vfs->Mount("/assets", fs::WPPkgFs::CreatePkgFs(pkg.native()))) {
+        if (! vfs->Mount("/assets", fs::CreatePhysicalFs(pkg.parent_path().native()))) {
+            LOG_ERROR("can't load %s", scene.c_str());
+            return nullptr;
+        }
+    }
+    if (! args.cache.empty() &&
+        ! vfs->Mount("/cache", fs::CreatePhysicalFs(args.cache, true), "cache")) {
+        LOG_ERROR("can't mount cache folder %s", args.cache.c_str());
+    }
+    return vfs;
+}
+
+nlohmann::json Percentiles(std::vector<double> ms) {
+    if (ms.empty()) return nullptr;
+    std::sort(ms.begin(), ms.end());
+    auto at = [&ms](double p) {
+        return ms[std::min(ms.size() - 1, (usize)(p * (double)ms.size()))];
+    };
+    double sum { 0.0 };
+    for (double v : ms) sum += v;
+    return {
+        { "count", ms.size() },
+        { "mean", sum / (double)ms.size() },
+        { "p50", at(0.5) },
+        { "p95", at(0.95) },
+        { "p99", at(0.99) },
+        { "max", ms.back() },
+    };
+}
+
+// the report of one scene, false if it didn't load
+bool RunScene(const Args& args, const Run& run, nlohmann::json& report) {
+    InputRecord record;
+    if (! run.replay.empty()) {
+        if (! InputRecord::Load(run.replay, record)) return false;
+        if (record.frames.empty()) {
+            LOG_ERROR("%s has no frames", run.replay.c_str());
+            return false;
+        }
+        if (! record.properties.empty())
+            LOG_INFO("%d properties of the record aren't set", (int)record.properties.size());
+    }
+    const bool replay = ! run.replay.empty();
+
+    vulkan::VulkanRender render;
+    {
+        RenderInitInfo info;
+        info.offscreen = true;
+        info.width     = run.width;
+        info.height    = run.height;
+        if (! render.init(info)) {
+            LOG_ERROR("init vulkan failed");
+            return false;
+        }
+    }
+    render.setProfiling(true);
+
+    nlohmann::json load;
+    auto           load_begin = clk::now();
+
+    std::string entry, id;
+    auto        vfs = MountScene(args, run.scene, entry, id);
+    if (! vfs) return false;
+    std::string src;
+    if (auto f = vfs->Open("/assets/" + entry)) src = f->ReadAllStr();
+    if (src.empty()) {
+        LOG_ERROR("no scene in %s", run.scene.c_str());
+        return false;
+    }
+
+    // sounds are mounted but not played, audio responses see silence
+    audio::SoundManager sound;
+    WPSceneParser       parser;
+    if (replay) Random::seed((Random::engine_type::result_type)record.seed);
+    auto begin = clk::now();
+    auto scene = parser.Parse(id, src, *vfs, sound);
+    if (! scene) return false;
+    scene->vfs.swap(vfs);
+    if (replay) scene->paritileSys->SetSeed(record.seed);
+    load["parse"]  = Ms(clk::now() - begin - parser.ShaderTime());
+    load["shader"] = Ms(parser.ShaderTime());
+
+    begin = clk::now();
+    std::vector<std::string> tex_names;
+    for (auto& [name, _] : scene->textures) tex_names.push_back(name);
+    scene->imageParser->Preload(tex_names);
+    load["texture"] = Ms(clk::now() - begin);
+
+    begin         = clk::now();
+    auto rg       = sceneToRenderGraph(*scene);
+    load["graph"] = Ms(clk::now() - begin);
+
+    // passes prepared, textures uploaded and pipelines made
+    begin = clk::now();
+    render.beginCompile(*scene, *rg);
+    while (! render.compileStep(std::chrono::milliseconds(16))) {
+    }
+    while (! render.pipelinesReady()) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    render.UpdateCameraFillMode(*scene, FillMode::ASPECTCROP);
+    load["pipeline"] = Ms(clk::now() - begin);
+    load["total"]    = Ms(clk::now() - load_begin);
+
+    const double timestep = 1.0 / run.fps;
+    // a replay's warm up is the start of the record
+    const u32 frames = replay ? (u32)record.frames.size() * 3 / 4 : run.frames;
+    const u32 warmup = replay ? (u32)record.frames.size() - frames : run.frames / 4;
+    auto*     updater = static_cast<WPShaderValueUpdater*>(scene->shaderValueUpdater.get());
+
+    std::vector<double>  sim_ms, cpu_ms, gpu_ms, frame_allocs;
+    u32                  drawn { 0 };
+    vulkan::MemoryStatus mem;
+    std::uint64_t        peak { 0 };
+    for (u32 f = 0; f < frames + warmup; f++) {
+        const bool counting = f >= warmup;
+
+        const u64 allocs_begin = allocs::count();
+        begin                  = clk::now();
+        if (replay) {
+            // as SceneWallpaper simulates a frame
+            auto& in = record.frames[f];
+            scene->PassFrameTime(in.advance);
+            updater->FrameBegin();
+            updater->MouseInput(in.mouse[0], in.mouse[1]);
+            scene->paritileSys->UpdateMouseControlPoints(updater->GetMousePosition(),
+                                                         { scene->ortho[0], scene->ortho[1] });
+            scene->paritileSys->UpdateBudget(in.frame_time, in.budget);
+        } else {
+            scene->PassFrameTime(timestep);
+            updater->FrameBegin();
+            scene->paritileSys->UpdateBudget(timestep, timestep);
+        }
+        scene->paritileSys->Emitt();
+        auto sim_end = clk::now();
+
+        bool ok = render.drawFrame(*scene, [&scene]() {
+            scene->shaderValueUpdater->FrameEnd();
+        });
+        auto      end       = clk::now();
+        const u64 allocated = allocs::count() - allocs_begin;
+        // the host would, so frames don't pile up
+        if (auto* ex = render.exSwapchain()) (void)ex->eatFrame();
+
+        if (render.memoryStatus(mem)) peak = std::max(peak, mem.usage);
+        if (! counting) continue;
+        if (ok) drawn++;
+        sim_ms.push_back(Ms(sim_end - begin));
+        cpu_ms.push_back(Ms(end - sim_end));
+        if (allocs::counting()) frame_allocs.push_back((double)allocated);
+        double gpu { 0.0 };
+        if (ok && render.gpuFrameTime(gpu)) gpu_ms.push_back(gpu);
+    }
+
+    report = {
+        { "scene", run.scene },
+        { "width", run.width },
+        { "height", run.height },
+        { "fps", run.fps },
+        { "frames", frames },
+        { "drawn", drawn },
+        { "load_ms", load },
+        { "sim_ms", Percentiles(sim_ms) },
+        { "cpu_ms", Percentiles(cpu_ms) },
+        // a few frames behind, null if the device has no timestamps
+        { "gpu_ms", Percentiles(gpu_ms) },
+        // null without ENABLE_ALLOC_COUNT
+        { "allocs", Percentiles(frame_allocs) },
+        { "memory", { { "peak", peak }, { "budget", mem.budget } } },
+    };
+    if (! run.name.empty()) report["name"] = run.name;
+    if (replay) report["replay"] = run.replay;
+    render.destroy();
+    return true;
+}
+
+bool ReadJson(const std::string& path, nlohmann::json& json) {
+    std::ifstream file(path);
+    if (! file) {
+        LOG_ERROR("can't read %s", path.c_str());
+        return false;
+    }
+    json = nlohmann::json::parse(file, nullptr, false);
+    if (json.is_discarded()) {
+        LOG_ERROR("%s isn't json", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// suite values default to the command line ones
+bool LoadSuite(const Args& args, std::vector<Run>& runs) {
+    nlohmann::json suite;
+    if (! ReadJson(args.suite, suite)) return false;
+    Run base    = args.run;
+    base.frames = suite.value("frames", base.frames);
+    base.fps    = suite.value("fps", base.fps);
+    base.width  = suite.value("width", base.width);
+    base.height = suite.value("height", base.height);
+    if (! suite.contains("scenes") || ! suite.at("scenes").is_array()) {
+        LOG_ERROR("suite %s has no scenes", args.suite.c_str());
+        return false;
+    }
+    for (auto& s : suite.at("scenes")) {
+        Run run    = base;
+        run.name   = s.value("name", "");
+        run.scene  = (std::filesystem::path(args.corpus) / s.value("scene", "")).native();
+        run.frames = s.value("frames", run.frames);
+        run.fps    = s.value("fps", run.fps);
+        run.width  = s.value("width", run.width);
+        run.height = s.value("height", run.height);
+        if (auto replay = s.value("replay", ""); ! replay.empty())
+            run.replay = (std::filesystem::path(args.corpus) / replay).native();
+        if (run.name.empty() || ! ValidRun(run)) {
+            LOG_ERROR("suite scene %s isn't complete", s.dump().c_str());
+            return false;
+        }
+        runs.push_back(std::move(run));
+    }
+    return true;
+}
+
+// what a regression is made of, values under slack are noise
+struct Metric {
+    const char* name;
+    const char* group;
+    const char* key;
+    double      slack;
+};
+constexpr std::array metrics {
+    Metric { "load", "load_ms", "total", 5.0 },
+    Metric { "cpu p95", "cpu_ms", "p95", 0.2 },
+    Metric { "gpu p95", "gpu_ms", "p95", 0.2 },
+    Metric { "allocs p95", "allocs", "p95", 0.5 },
+    Metric { "memory", "memory", "peak", 8.0 * 1024 * 1024 },
+};
+
+// flags what went up by more than the threshold, the count of them
+usize Compare(nlohmann::json& results, const nlohmann::json& baseline, double threshold) {
+    usize regressions { 0 };
+    for (auto& result : results) {
+        const std::string     name = result.value("name", "");
+        const nlohmann::json* base { nullptr };
+        if (baseline.contains("results")) {
+            for (auto& b : baseline.at("results")) {
+                if (b.value("name", "") == name) base = &b;
+            }
+        }
+        if (base == nullptr) {
+            LOG_INFO("%s has no baseline", name.c_str());
+            continue;
+        }
+        auto& flags = result["regressions"] = nlohmann::json::array();
+        for (auto& m : metrics) {
+            auto value = [&m](const nlohmann::json& r) -> std::optional<double> {
+                if (! r.contains(m.group) || ! r.at(m.group).is_object()) return std::nullopt;
+                auto& group = r.at(m.group);
+                if (! group.contains(m.key)) return std::nullopt;
+                return group.at(m.key).get<double>();
+            };
+            auto now = value(result), was = value(*base);
+            if (! now || ! was) continue;
+            if (*now - *was <= m.slack || *now <= *was * (1.0 + threshold)) continue;
+            LOG_ERROR("%s: %s %.2f, baseline %.2f", name.c_str(), m.name, *now, *was);
+            flags.push_back({ { "metric", m.name }, { "value", *now }, { "baseline", *was } });
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+bool Write(const Args& args, const nlohmann::json& json) {
+    const std::string text = json.dump(2);
+    if (args.out.empty()) {
+        std::printf("%s\n", text.c_str());
+        return true;
+    }
+    std::ofstream file(args.out);
+    file << text << '\n';
+    if (! file) {
+        LOG_ERROR("can't write %s", args.out.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Args args;
+    if (! ParseArgs(argc, argv, args)) return 1;
+
+    if (args.suite.empty()) {
+        nlohmann::json report;
+        if (! RunScene(args, args.run, report)) return 1;
+        return Write(args, report) ? 0 : 1;
+    }
+
+    std::vector<Run> runs;
+    if (! LoadSuite(args, runs)) return 1;
+    nlohmann::json baseline;
+    if (! args.baseline.empty() && ! ReadJson(args.baseline, baseline)) return 1;
+
+    nlohmann::json results = nlohmann::json::array();
+    usize          failed { 0 };
+    for (auto& run : runs) {
+        LOG_INFO("bench %s", run.name.c_str());
+        nlohmann::json report;
+        if (! RunScene(args, run, report)) {
+            LOG_ERROR("%s didn't load", run.name.c_str());
+            failed++;
+            continue;
+        }
+        results.push_back(std::move(report));
+    }
+    usize regressions = args.baseline.empty() ? 0 : Compare(results, baseline, args.threshold);
+
+    nlohmann::json out {
+        { "suite", args.suite },
+        { "threshold", args.threshold },
+        { "results", results },
+    };
+    if (! Write(args, out)) return 1;
+    if (failed > 0) return 1;
+    return regressions > 0 ? 2 : 0;
+}
@@ -0,0 +1,67 @@
+#include "FpsGovernor.hpp"
+
+#include <algorithm>
+
+using namespace wallpaper;
+
+void FpsGovernor::SetTarget(u16 v) {
+    m_target = std::max<u16>(v, 1);
+    UpdateThrottled();
+}
+
+void FpsGovernor::SetAdaptive(bool v) {
+    m_adaptive = v;
+    m_level    = FrameActivity::Full;
+    m_dropping = false;
+    UpdateThrottled();
+}
+
+void FpsGovernor::SetHints(Hints v) {
+    m_hints = v;
+    UpdateThrottled();
+}
+
+void FpsGovernor::SetLimit(u16 v) { m_limit = v; }
+
+u16 FpsGovernor::Frame(FrameActivity activity, Clock::time_point now) {
+    if (activity >= m_level) {
+        m_level    = activity;
+        m_dropping = false;
+    } else if (! m_dropping) {
+        m_dropping   = true;
+        m_drop_since = now;
+        m_drop_to    = activity;
+    } else {
+        m_drop_to = std::max(m_drop_to, activity);
+        if (now - m_drop_since >= DropAfter) {
+            m_level    = m_drop_to;
+            m_dropping = false;
+        }
+    }
+    UpdateThrottled();
+    return Fps();
+}
+
+u16 FpsGovernor::Fps() const { return RateOf(m_level); }
+
+u16 FpsGovernor::RateOf(FrameActivity level) const {
+    // nobody looks, a frame now and then keeps time moving
+    if (m_hints.covered || m_hints.locked) return IdleFps;
+
+    u16 fps = m_target;
+    if (m_hints.on_battery) fps = std::clamp<u16>(fps / 2, 1, BatteryMaxFps);
+    if (! m_adaptive) return fps;
+    if (m_limit > 0) fps = std::min(fps, m_limit);
+
+    switch (level) {
+    case FrameActivity::Full: return fps;
+    case FrameActivity::Slow: return std::min(fps, std::max<u16>(fps / 2, SlowMinFps));
+    case FrameActivity::Static: return std::min(fps, IdleFps);
+    }
+    return fps;
+}
+
+void FpsGovernor::UpdateThrottled() {
+    m_throttled = m_adaptive && m_level != FrameActivity::Full &&
+                  ! (m_hints.covered || m_hints.locked);
+}
@@ -0,0 +1,89 @@
+#include "FrameStats.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+using namespace wallpaper;
+using micros = std::chrono::microseconds;
+
+namespace
+{
+constexpr u64 FirstShift { 6 };
+constexpr u64 SubBits { 3 };
+} // namespace
+
+usize FrameHistogram::BucketOf(micros v) {
+    u64 us = (u64)std::max<i64>(v.count(), 0);
+    if (us < (1ull << FirstShift)) return 0;
+    u64   msb    = (u64)std::bit_width(us) - 1;
+    u64   octave = msb - FirstShift;
+    u64   sub    = (us >> (msb - SubBits)) & ((1ull << SubBits) - 1);
+    usize bucket = 1 + (usize)((octave << SubBits) + sub);
+    return std::min(bucket, NumBuckets - 1);
+}
+
+micros FrameHistogram::UpperOf(usize bucket) {
+    if (bucket == 0) return micros(1ll << FirstShift);
+    u64 octave = (bucket - 1) >> SubBits;
+    u64 sub    = (bucket - 1) & ((1ull << SubBits) - 1);
+    return micros((i64)(((1ull << SubBits) + sub + 1) << (octave + FirstShift - SubBits)));
+}
+
+void FrameHistogram::Record(micros v, micros deadline) {
+    m_counts[BucketOf(v)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    if (deadline.count() > 0 && v > deadline) m_missed.fetch_add(1, std::memory_order_relaxed);
+
+    i64 max = m_max.load(std::memory_order_relaxed);
+    while (v.count() > max &&
+           ! m_max.compare_exchange_weak(max, v.count(), std::memory_order_relaxed)) {
+    }
+}
+
+FrameHistogram::Snapshot FrameHistogram::Read() const {
+    Snapshot snap;
+    for (usize i = 0; i < NumBuckets; i++)
+        snap.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+    // from the buckets, a record halfway through is either in all of it or in some bucket only
+    for (u32 c : snap.counts) snap.count += c;
+    snap.missed = std::min(m_missed.load(std::memory_order_relaxed), snap.count);
+    snap.max    = micros(m_max.load(std::memory_order_relaxed));
+    return snap;
+}
+
+void FrameHistogram::Reset() {
+    for (auto& c : m_counts) c.store(0, std::memory_order_relaxed);
+    m_count.store(0, std::memory_order_relaxed);
+    m_missed.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+micros FrameHistogram::Snapshot::Percentile(double fraction) const {
+    if (count == 0) return micros(0);
+    u64 rank = (u64)std::ceil(std::clamp(fraction, 0.0, 1.0) * (double)count);
+    rank     = std::max<u64>(rank, 1);
+    u64 seen { 0 };
+    for (usize i = 0; i < NumBuckets; i++) {
+        seen += counts[i];
+        if (seen >= rank) return std::min(UpperOf(i), max);
+    }
+    return max;
+}
+
+FrameHistogram::Snapshot FrameHistogram::Snapshot::Since(const Snapshot& older) const {
+    // reset in between, all of this is newer
+    for (usize i = 0; i < NumBuckets; i++) {
+        if (counts[i] < older.counts[i]) return *this;
+    }
+    Snapshot diff;
+    usize    highest { 0 };
+    for (usize i = 0; i < NumBuckets; i++) {
+        diff.counts[i] = counts[i] - older.counts[i];
+        diff.count += diff.counts[i];
+        if (diff.counts[i] > 0) highest = i;
+    }
+    diff.missed = missed >= older.missed ? std::min(missed - older.missed, diff.count) : 0;
+    diff.max    = diff.count > 0 ? std::min(UpperOf(highest), max) : micros(0);
+    return diff;
+}
@@ -1,6 +1,7 @@
 #include "FrameTimer.hpp"
 #include "Utils//Logging.h"
 
+#include <algorithm>
 #include <numeric>
 
 using namespace wallpaper;
@@ -18,7 +19,8 @@ FrameTimer::FrameTimer(std::function<void()> cb)
               m_frame_busy_count++;
               m_callback();
           }
-      }) {
+      },
+      &TimerThread::Shared()) {
     SetRequiredFps(15);
 }
 
@@ -38,27 +40,45 @@ double FrameTimer::IdeaTime() const {
 }
 
 void FrameTimer::UpdateFrametime() {
+    if (m_frametime_num == 0) return;
     m_frametime.store(std::accumulate(m_frametime_queue.begin(),
-                                      m_frametime_queue.end(),
+                                      m_frametime_queue.begin() + (isize)m_frametime_num,
                                       duration_cast<microseconds>(0s)) /
-                      m_frametime_queue.size());
+                      (i64)m_frametime_num);
 }
 
 void FrameTimer::SetRequiredFps(u16 value) {
     m_req_fps             = value;
-    microseconds ideatime = milliseconds(1000 / m_req_fps);
+    microseconds ideatime = microseconds(1000000 / std::max<u16>(m_req_fps, 1));
     m_ideatime            = ideatime;
+    // late by a fraction of a frame at most, lets the kernel batch the wakeup
+    m_timer.SetSlack(std::clamp<nanoseconds>(ideatime / 64, 50us, 10ms));
+    // a guess till frames are measured, measured ones hold across rate changes
+    if (m_frametime_num > 0) return;
     for (usize i = 0; i < FrameTimer::FRAMETIME_QUEUE_SIZE; i++) {
         AddFrametime(ideatime);
     }
     UpdateFrametime();
 }
 
+void FrameTimer::SetPresentPacing(bool v) { m_present_pacing = v; }
+
+void FrameTimer::FramePresented() {
+    if (! m_present_pacing) return;
+    auto frametime = m_frametime.load();
+    auto ideatime  = m_ideatime.load();
+    // room for a frame running a bit long
+    auto slack = std::max<microseconds>(1ms, frametime / 4);
+    auto wait  = ideatime - frametime - slack;
+    m_timer.WakeIn(std::max<microseconds>(wait, 0us));
+}
+
+void FrameTimer::Kick() { m_timer.WakeIn(0us); }
+
 void FrameTimer::AddFrametime(micros t) {
-    m_frametime_queue.push_back(t);
-    while (m_frametime_queue.size() > FrameTimer::FRAMETIME_QUEUE_SIZE) {
-        m_frametime_queue.pop_front();
-    }
+    m_frametime_queue[m_frametime_next] = t;
+    m_frametime_next                    = (m_frametime_next + 1) % m_frametime_queue.size();
+    m_frametime_num                     = std::min(m_frametime_num + 1, m_frametime_queue.size());
 }
 
 void FrameTimer::FrameBegin() { m_clock = steady_clock::now(); }
@@ -67,12 +87,8 @@ void FrameTimer::FrameEnd() {
     AddFrametime(duration_cast<microseconds>(now - m_clock));
     UpdateFrametime();
 
-    i32 expected = m_frame_busy_count.load();
-    while (expected > 0) {
-        if (m_frame_busy_count.compare_exchange_weak(expected, expected - 1)) {
-            break;
-        }
-    }
+    // draws are coalesced, no more than one is left queued after a frame
+    m_frame_busy_count = 0;
 }
 
 void FrameTimer::SetCallback(const std::function<void()>& cb) {
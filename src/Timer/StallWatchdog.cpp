@@ -0,0 +1,101 @@
+#include "StallWatchdog.hpp"
+#include "Utils/Logging.h"
+#include "Utils/Trace.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+using namespace wallpaper;
+namespace sfs = std::filesystem;
+
+namespace
+{
+// how often a running frame is looked at, and how late the look may be
+constexpr std::chrono::milliseconds check_interval { 50 };
+constexpr std::chrono::milliseconds check_slack { 10 };
+
+i64 NowNs() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// the oldest go first, the names sort by time
+void TrimDumps(const sfs::path& dir) {
+    std::error_code        ec;
+    std::vector<sfs::path> dumps;
+    for (auto& entry : sfs::directory_iterator(dir, ec)) {
+        auto name = entry.path().filename().native();
+        if (name.starts_with("stall-") && entry.path().extension() == ".json")
+            dumps.push_back(entry.path());
+    }
+    if (dumps.size() <= StallWatchdog::KeepDumps) return;
+    std::sort(dumps.begin(), dumps.end());
+    for (usize i = 0; i + StallWatchdog::KeepDumps < dumps.size(); i++) sfs::remove(dumps[i], ec);
+}
+} // namespace
+
+StallWatchdog::StallWatchdog()
+    : m_timer([this]() {
+          check();
+      }) {
+    m_timer.SetInterval(check_interval);
+    m_timer.SetSlack(check_slack);
+}
+
+StallWatchdog::~StallWatchdog() { SetFactor(0.0); }
+
+void StallWatchdog::SetFactor(double factor) {
+    factor = std::max(factor, 0.0);
+    if ((m_factor.exchange(factor) > 0.0) == (factor > 0.0)) return;
+    if (factor > 0.0) {
+        trace::startFlight();
+        m_timer.Start();
+        LOG_INFO("stall watchdog on, frames over %.1fx their interval", factor);
+    } else {
+        m_timer.Stop();
+        trace::stopFlight();
+        m_frame_begin = 0;
+    }
+}
+
+void StallWatchdog::SetDumpDir(std::string dir) { m_dir = std::move(dir); }
+
+void StallWatchdog::FrameBegin(std::chrono::microseconds interval) {
+    const double factor = m_factor.load(std::memory_order_relaxed);
+    if (factor <= 0.0) return;
+    m_limit.store((i64)((double)interval.count() * 1000.0 * factor), std::memory_order_relaxed);
+    m_reported.store(false, std::memory_order_relaxed);
+    m_frame_begin.store(NowNs(), std::memory_order_release);
+}
+
+bool StallWatchdog::FrameEnd() {
+    const i64 begin = m_frame_begin.exchange(0, std::memory_order_acq_rel);
+    if (begin == 0) return false;
+    const i64 took  = NowNs() - begin;
+    const i64 limit = m_limit.load(std::memory_order_relaxed);
+    if (took <= limit) return false;
+
+    LOG_ERROR("stall: frame took %.1f ms, over %.1f ms", (double)took / 1e6, (double)limit / 1e6);
+    if (m_dir.empty()) return true;
+
+    std::error_code ec;
+    sfs::create_directories(m_dir, ec);
+    using namespace std::chrono;
+    auto stamp = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    auto path  = sfs::path(m_dir) / ("stall-" + std::to_string(stamp) + ".json");
+    if (trace::dumpFlight(path.native(), Window + nanoseconds(took))) TrimDumps(m_dir);
+    return true;
+}
+
+void StallWatchdog::check() {
+    const i64 begin = m_frame_begin.load(std::memory_order_acquire);
+    if (begin == 0) return;
+    const i64 running = NowNs() - begin;
+    if (running <= m_limit.load(std::memory_order_relaxed) ||
+        m_reported.exchange(true, std::memory_order_relaxed))
+        return;
+    LOG_ERROR("stall: frame running for %.1f ms, in\n%s",
+              (double)running / 1e6,
+              trace::openZones().c_str());
+}
@@ -1,46 +1,208 @@
 #include "ThreadTimer.hpp"
+#include "Utils/Logging.h"
+#include "Utils/ThreadPolicy.hpp"
+#include "Utils/Trace.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <cerrno>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <unistd.h>
 
 using namespace wallpaper;
 using micros = std::chrono::microseconds;
+using namespace std::chrono;
+
+namespace
+{
+// the first multiple of the interval after t, timers of one interval share these
+steady_clock::time_point AlignUp(steady_clock::time_point t, micros interval) {
+    if (interval <= 0us) return t;
+    auto step = duration_cast<steady_clock::duration>(interval);
+    auto at   = t.time_since_epoch();
+    return steady_clock::time_point(at - at % step + step);
+}
+} // namespace
+
+TimerThread::TimerThread() {
+    m_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_wake_fd < 0) LOG_ERROR("timer eventfd failed: %s", std::strerror(errno));
+}
+TimerThread::~TimerThread() {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    signal();
+    if (m_thread.joinable()) m_thread.join();
+    if (m_wake_fd >= 0) close(m_wake_fd);
+}
+
+TimerThread& TimerThread::Shared() {
+    static TimerThread shared;
+    return shared;
+}
+
+void TimerThread::signal() {
+    if (m_wake_fd < 0) return;
+    uint64_t one { 1 };
+    // only fails if the counter is full, the thread is woken then anyway
+    (void)! write(m_wake_fd, &one, sizeof(one));
+}
+
+void TimerThread::add(ThreadTimer* timer) {
+    std::unique_lock<std::mutex> op(m_op_mutex);
+    bool                         start { false };
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto                         interval = timer->m_interval.load();
+        timer->m_wake_in.reset();
+        timer->m_deadline_interval = interval;
+        timer->m_deadline          = AlignUp(steady_clock::now(), interval);
+        m_timers.push_back(timer);
+        start     = ! m_running;
+        m_running = true;
+    }
+    if (start) {
+        if (m_thread.joinable()) m_thread.join();
+        m_thread = std::thread(&TimerThread::loop, this);
+    } else
+        signal();
+}
+
+void TimerThread::remove(ThreadTimer* timer) {
+    std::unique_lock<std::mutex> op(m_op_mutex);
+    assert(std::this_thread::get_id() != m_thread.get_id());
+    bool stop { false };
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::erase(m_timers, timer);
+        stop = m_timers.empty() && m_running;
+        if (stop) m_running = false;
+    }
+    // a tick that took the timer before is done after this
+    { std::unique_lock<std::mutex> tick(m_tick_mutex); }
+    if (stop) {
+        signal();
+        if (m_thread.joinable()) m_thread.join();
+    }
+}
+
+void TimerThread::sleepUntil(std::optional<steady_clock::time_point> deadline) {
+    pollfd pfd { .fd = m_wake_fd, .events = POLLIN, .revents = 0 };
+    int    woken { 0 };
+    if (deadline) {
+        // steady_clock is CLOCK_MONOTONIC
+        auto     left = std::max(duration_cast<nanoseconds>(*deadline - steady_clock::now()), 0ns);
+        timespec ts { .tv_sec  = (time_t)(left.count() / 1000000000),
+                      .tv_nsec = (long)(left.count() % 1000000000) };
+        woken = ppoll(&pfd, 1, &ts, nullptr);
+    } else {
+        woken = ppoll(&pfd, 1, nullptr, nullptr);
+    }
+    if (woken > 0) {
+        uint64_t count;
+        (void)! read(m_wake_fd, &count, sizeof(count));
+    }
+}
+
+void TimerThread::loop() {
+    TRACE_THREAD("timer");
+    auto                      slack = nanoseconds(-1);
+    std::vector<ThreadTimer*> due;
+    while (true) {
+        std::optional<steady_clock::time_point> next;
+        nanoseconds                             want_slack { 0 };
+        {
+            std::unique_lock<std::mutex> tick(m_tick_mutex);
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (! m_running) break;
+                auto now = steady_clock::now();
+                due.clear();
+                for (auto* t : m_timers) {
+                    if (t->m_wake_in) {
+                        t->m_deadline = now + *t->m_wake_in;
+                        t->m_wake_in.reset();
+                    }
+                    if (t->m_deadline <= now) due.push_back(t);
+                }
+            }
+            if (! due.empty()) {
+                // wakes frames, cheap unless the policy changed
+                platform::ApplyThreadClass(platform::ThreadClass::Frame);
+                for (auto* t : due) {
+                    if (t->m_callback) t->m_callback();
+                }
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto                         now = steady_clock::now();
+            // a timer removed meanwhile waits for this tick, it's still there to write to
+            for (auto* t : due) {
+                // the callback may have set the interval, the phase follows it
+                auto interval = t->m_interval.load();
+                if (interval != t->m_deadline_interval) {
+                    t->m_deadline_interval = interval;
+                    t->m_deadline          = AlignUp(now, interval);
+                    continue;
+                }
+                t->m_deadline += interval;
+                if (t->m_deadline <= now) t->m_deadline = AlignUp(now, interval);
+            }
+            for (auto* t : m_timers) {
+                auto at = t->m_wake_in ? now : t->m_deadline;
+                if (! next || at < *next) next = at;
+                auto s = t->m_slack.load();
+                if (s > 0ns && (want_slack == 0ns || s < want_slack)) want_slack = s;
+            }
+        }
+        if (want_slack != slack) {
+            // 0 goes back to the default
+            prctl(PR_SET_TIMERSLACK, (unsigned long)want_slack.count(), 0, 0, 0);
+            slack = want_slack;
+        }
+        // woken early, check again what to wait for
+        sleepUntil(next);
+    }
+}
 
-ThreadTimer::ThreadTimer(std::function<void()> cb): m_callback(cb) {}
+ThreadTimer::ThreadTimer(std::function<void()> cb, TimerThread* shared)
+    : m_callback(cb),
+      m_own_thread(shared == nullptr ? std::make_unique<TimerThread>() : nullptr),
+      m_thread(shared != nullptr ? shared : m_own_thread.get()) {}
 ThreadTimer::~ThreadTimer() { Stop(); }
 
 bool ThreadTimer::Running() const { return m_running; }
 
 void ThreadTimer::SetInterval(micros v) { m_interval = v; }
 
+void ThreadTimer::SetSlack(nanoseconds v) { m_slack = v; }
+
+void ThreadTimer::WakeIn(micros v) {
+    {
+        std::unique_lock<std::mutex> lock(m_thread->m_mutex);
+        m_wake_in = v;
+    }
+    m_thread->signal();
+}
+
 void ThreadTimer::Start() {
     std::unique_lock<std::mutex> lock(m_op_mutex);
 
     if (Running()) return;
-    m_timer_thread = std::thread([this]() {
-        while (Running()) {
-            {
-                std::unique_lock<std::mutex> lock(m_cond_mutex);
-                m_condition.wait_for(lock, m_interval.load());
-            }
-            if (m_callback) m_callback();
-        }
-    });
-    m_running      = true;
+    // before the thread checks it
+    m_running = true;
+    m_thread->add(this);
 }
 
 void ThreadTimer::Stop() {
     std::unique_lock<std::mutex> lock(m_op_mutex);
-    assert(std::this_thread::get_id() != m_timer_thread.get_id());
 
     if (! Running()) return;
     m_running = false;
-
-    {
-        std::unique_lock<std::mutex> lock(m_cond_mutex);
-        m_condition.notify_all();
-    }
-
-    if (m_timer_thread.joinable()) {
-        m_timer_thread.join();
-    }
+    m_thread->remove(this);
 }
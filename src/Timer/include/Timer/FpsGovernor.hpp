@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+#include <atomic>
+#include <chrono>
+
+namespace wallpaper
+{
+
+// what a frame showed changing, ordered
+enum class FrameActivity : u8
+{
+    // nothing was drawn, the frame equals the last one
+    Static = 0,
+    // drawn, only shader values moved
+    Slow,
+    // particles live in view, or the mouse moved
+    Full
+};
+
+// Picks the rate frames are timed at. The target is the rate asked for, adaptive scales it down
+// with what the last frames showed, hints from the host cap it whatever the scene does.
+// A higher activity raises the rate for the next frame, a lower one only after it lasted a while.
+// Only used from the render thread but for Throttled().
+class FpsGovernor : NoCopy, NoMove {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Hints {
+        bool on_battery { false };
+        // a fullscreen window is on top, nothing of the wallpaper is seen
+        bool covered { false };
+        bool locked { false };
+    };
+
+    constexpr static u16 DefaultFps { 15 };
+    constexpr static u16 SlowMinFps { 10 };
+    constexpr static u16 IdleFps { 1 };
+    constexpr static u16 BatteryMaxFps { 30 };
+    constexpr static std::chrono::milliseconds DropAfter { 2000 };
+
+    void SetTarget(u16);
+    void SetAdaptive(bool);
+    void SetHints(Hints);
+    // frames a second the gpu was seen to keep up with, adaptive doesn't go over it, 0 for none
+    void SetLimit(u16);
+
+    u16 Target() const { return m_target; }
+
+    // once a frame, what it showed, returns the rate to time frames at
+    u16 Frame(FrameActivity, Clock::time_point now);
+    u16 Fps() const;
+
+    // any thread, running below the target for a lack of activity, input may wake it early
+    bool Throttled() const { return m_throttled; }
+
+private:
+    u16  RateOf(FrameActivity) const;
+    void UpdateThrottled();
+
+    u16   m_target { DefaultFps };
+    u16   m_limit { 0 };
+    bool  m_adaptive { false };
+    Hints m_hints;
+
+    FrameActivity m_level { FrameActivity::Full };
+    // lower than the level since then, the highest of that time is dropped to
+    bool              m_dropping { false };
+    Clock::time_point m_drop_since;
+    FrameActivity     m_drop_to { FrameActivity::Static };
+
+    std::atomic<bool> m_throttled { false };
+};
+
+} // namespace wallpaper
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+namespace wallpaper
+{
+
+// Counts durations in log spaced buckets, 8 a doubling from 64us to about 4s, longer ones go to
+// the last. Recording is lock free from any thread, percentiles are within a bucket, about 12%.
+class FrameHistogram : NoCopy, NoMove {
+public:
+    constexpr static usize NumBuckets { 1 + 16 * 8 };
+
+    struct Snapshot {
+        std::array<u32, NumBuckets> counts {};
+        u64                         count { 0 };
+        // took longer than their deadline
+        u64                       missed { 0 };
+        std::chrono::microseconds max { 0 };
+
+        // the upper edge of the bucket the fraction falls into, 0 if nothing was recorded
+        std::chrono::microseconds Percentile(double) const;
+        // what was recorded after older was read, the max is then bucket precise
+        Snapshot Since(const Snapshot& older) const;
+    };
+
+    // a deadline of 0 is never missed
+    void     Record(std::chrono::microseconds, std::chrono::microseconds deadline);
+    Snapshot Read() const;
+    // racing records may be lost to it or counted after
+    void Reset();
+
+    static usize                     BucketOf(std::chrono::microseconds);
+    static std::chrono::microseconds UpperOf(usize bucket);
+
+private:
+    std::array<std::atomic<u32>, NumBuckets> m_counts {};
+    std::atomic<u64>                         m_count { 0 };
+    std::atomic<u64>                         m_missed { 0 };
+    std::atomic<i64>                         m_max { 0 };
+};
+
+struct FrameStats {
+    // render thread, from the draw command to its end, drawn frames only
+    FrameHistogram cpu;
+    // first pass begin to the last pass end, a few frames behind
+    FrameHistogram gpu;
+    // between presents of frames drawn one after the other
+    FrameHistogram present;
+
+    // in the order above
+    std::array<FrameHistogram::Snapshot, 3> Read() const {
+        return { cpu.Read(), gpu.Read(), present.Read() };
+    }
+    void Reset() {
+        cpu.Reset();
+        gpu.Reset();
+        present.Reset();
+    }
+};
+
+} // namespace wallpaper
@@ -1,10 +1,12 @@
 #pragma once
 
 #include "ThreadTimer.hpp"
-#include <deque>
+#include <array>
 
 namespace wallpaper
 {
+// Ticks the frames of a render at its fps. Frame timers of the process share one thread, those at
+// the same fps wake together.
 class FrameTimer : NoCopy, NoMove {
     constexpr static usize FRAMETIME_QUEUE_SIZE { 5 };
 
@@ -24,6 +26,14 @@ public:
     double IdeaTime() const;
 
     void SetRequiredFps(u16);
+    // frames start so they are done right before the next one is due after the last shown,
+    // timer ticks only cover frames nothing was shown for
+    void SetPresentPacing(bool);
+
+    // any thread, right after a frame got on screen
+    void FramePresented();
+    // any thread, the next frame is due now instead of after the running wait
+    void Kick();
 
     // only used with one render
     void FrameBegin();
@@ -34,12 +44,16 @@ private:
     void UpdateFrametime();
 
     std::function<void()>                 m_callback;
-    std::deque<std::chrono::microseconds> m_frametime_queue;
+    // the last frame times, a ring, none until set
+    std::array<std::chrono::microseconds, FRAMETIME_QUEUE_SIZE> m_frametime_queue {};
+    usize                                                      m_frametime_num { 0 };
+    usize                                                      m_frametime_next { 0 };
 
     u16                                    m_req_fps;
     std::atomic<std::chrono::microseconds> m_frametime;
     std::atomic<std::chrono::microseconds> m_ideatime;
     std::atomic<i32>                       m_frame_busy_count;
+    std::atomic<bool>                      m_present_pacing { true };
 
     ThreadTimer m_timer;
 
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ThreadTimer.hpp"
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace wallpaper
+{
+
+// Watches the frames of a render thread from a timer thread of its own. A frame running longer
+// than the factor times its interval is a stall. It's logged once while it lasts with the zones
+// open on every thread, the phase it hangs in, and once it ends with its time, and the flight
+// recorder's zones of the seconds before and of the frame go to a file in the dump folder, of
+// which the newest few are kept. The flight recorder is on while it watches.
+class StallWatchdog : NoCopy, NoMove {
+public:
+    constexpr static usize                KeepDumps { 8 };
+    constexpr static std::chrono::seconds Window { 5 };
+
+    StallWatchdog();
+    ~StallWatchdog();
+
+    // 0 stops watching
+    void SetFactor(double);
+    // no dumps with an empty one, on the render thread
+    void SetDumpDir(std::string);
+
+    // on the render thread around each frame, its interval at the fps it's paced for
+    void FrameBegin(std::chrono::microseconds interval);
+    // true if the frame was a stall
+    bool FrameEnd();
+
+private:
+    // on the timer, while a frame runs
+    void check();
+
+    std::atomic<double> m_factor { 0.0 };
+    // steady clock ns, 0 between frames
+    std::atomic<i64> m_frame_begin { 0 };
+    std::atomic<i64> m_limit { 0 };
+    // logged while running already
+    std::atomic<bool> m_reported { false };
+
+    std::string m_dir;
+    ThreadTimer m_timer;
+};
+
+} // namespace wallpaper
@@ -3,20 +3,64 @@
 #include "Core/Literals.hpp"
 #include "Core/NoCopyMove.hpp"
 
+#include <memory>
 #include <mutex>
-#include <condition_variable>
 #include <thread>
 #include <atomic>
+#include <vector>
 
 #include <functional>
 #include <chrono>
+#include <optional>
 
 namespace wallpaper
 {
 
+class ThreadTimer;
+
+// A thread the ticks of its timers are called back on, one after the other. It runs while it has
+// a running timer. Ticks of timers with the same interval fall on the same multiples of it on the
+// steady clock, so they come in one wakeup, whichever thread they are on.
+// The thread sleeps in ppoll on an eventfd, which wakes it early, and its timer slack, the least
+// of its timers', lets the kernel batch the wakeup with others.
+class TimerThread : NoCopy, NoMove {
+public:
+    TimerThread();
+    ~TimerThread();
+
+    // of the process, the frame timers of every wallpaper tick on it
+    static TimerThread& Shared();
+
+private:
+    friend class ThreadTimer;
+
+    void add(ThreadTimer*);
+    // no tick of it runs once this returns, not to be called from a tick
+    void remove(ThreadTimer*);
+    void signal();
+
+    void loop();
+    void sleepUntil(std::optional<std::chrono::steady_clock::time_point>);
+
+    std::thread m_thread;
+    int         m_wake_fd { -1 };
+    // the timers and their deadlines
+    std::mutex                m_mutex;
+    std::vector<ThreadTimer*> m_timers;
+    bool                      m_running { false };
+    // held while ticks run, a removed timer waits on it
+    std::mutex m_tick_mutex;
+    // starts and joins the thread
+    std::mutex m_op_mutex;
+};
+
+// Calls back at absolute deadlines, each one interval after the last, so a slow callback or a
+// late wakeup doesn't push the ticks after it. Ticks missed by more than an interval are dropped.
+// Deadlines are multiples of the interval on the steady clock. On a thread of its own unless
+// given a shared one.
 class ThreadTimer : NoCopy, NoMove {
 public:
-    ThreadTimer(std::function<void()> callback);
+    ThreadTimer(std::function<void()> callback, TimerThread* shared = nullptr);
     ~ThreadTimer();
 
     void Start();
@@ -25,19 +69,28 @@ public:
     bool Running() const;
 
     void SetInterval(std::chrono::microseconds);
+    // the running wait ends this long from now instead, once
+    void WakeIn(std::chrono::microseconds);
+    // how late the kernel may wake the timer, 0 for the system default
+    void SetSlack(std::chrono::nanoseconds);
 
 private:
+    friend class TimerThread;
+
     std::function<void()> m_callback;
 
     std::mutex m_op_mutex;
 
-    std::thread             m_timer_thread;
-    std::mutex              m_cond_mutex;
-    std::condition_variable m_condition;
+    std::unique_ptr<TimerThread> m_own_thread;
+    TimerThread*                 m_thread;
+    // under the thread's mutex
+    std::optional<std::chrono::microseconds>  m_wake_in;
+    std::chrono::steady_clock::time_point     m_deadline;
+    std::chrono::microseconds                 m_deadline_interval { 0 };
 
-    // init
-    std::atomic<std::chrono::microseconds> m_interval;
-    std::atomic<bool>                      m_running;
+    std::atomic<std::chrono::microseconds> m_interval { std::chrono::microseconds(0) };
+    std::atomic<std::chrono::nanoseconds>  m_slack { std::chrono::nanoseconds(0) };
+    std::atomic<bool>                      m_running { false };
 };
 
 } // namespace wallpaper
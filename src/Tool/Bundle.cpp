@@ -0,0 +1,226 @@
+// Repacks a scene wallpaper into a bundle, see WPBundleFs, which the wallpaper loads in place of
+// its pkg when it's beside it, with near nothing to decode or compile on the way.
+//
+//   wpBundle --assets <dir> --scene <dir/scene.pkg> [--out <file.wpb>] [--quality full|low]
+//            [--transcode 0|1]
+//
+// Every file of the pkg, or of the scene's folder without one, goes in. Tex files are decoded
+// and stored as their mips, transcoded to bc with --transcode as the tex_transcode property
+// would, sprites and videos are kept as they are. The scene is then loaded from the bundle once
+// for the compiled scene and the spir-v and reflection of its shaders, which come along. Those are
+// for the quality given, a load with the other one compiles as it would without a bundle. The
+// bundle is written beside the scene unless out is given.
+
+#include "WPSceneParser.hpp"
+#include "WPPkgFs.hpp"
+#include "WPBundleFs.hpp"
+#include "WPCacheDir.hpp"
+#include "WPTexImageParser.hpp"
+#include "Scene/Scene.h"
+#include "Audio/SoundManager.h"
+#include "Fs/VFS.h"
+#include "Fs/PhysicalFs.h"
+#include "Fs/CBinaryStream.h"
+#include "Fs/MemBinaryStream.h"
+#include "Utils/Logging.h"
+#include "Utils/Sha.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace wallpaper;
+namespace sfs = std::filesystem;
+
+namespace
+{
+
+struct Args {
+    std::string   assets;
+    std::string   scene;
+    std::string   out;
+    ShaderQuality quality { ShaderQuality::Full };
+    bool          transcode { false };
+};
+
+bool ParseArgs(int argc, char** argv, Args& args) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view key = argv[i];
+        const char*      val = argv[i + 1];
+        if (key == "--assets")
+            args.assets = val;
+        else if (key == "--scene")
+            args.scene = val;
+        else if (key == "--out")
+            args.out = val;
+        else if (key == "--quality")
+            args.quality = std::strcmp(val, "low") == 0 ? ShaderQuality::Low : ShaderQuality::Full;
+        else if (key == "--transcode")
+            args.transcode = std::strtol(val, nullptr, 10) != 0;
+        else {
+            LOG_ERROR("unknown option %s", argv[i]);
+            return false;
+        }
+    }
+    if (argc % 2 == 0) {
+        LOG_ERROR("option %s has no value", argv[argc - 1]);
+        return false;
+    }
+    if (args.assets.empty() || args.scene.empty()) {
+        LOG_ERROR("--assets and --scene are needed");
+        return false;
+    }
+    return true;
+}
+
+// the pkg, or the folder of the scene without one, with the paths of its files
+std::unique_ptr<fs::Fs> OpenSource(const sfs::path& pkg, std::vector<std::string>& files) {
+    if (auto pkgfs = fs::WPPkgFs::CreatePkgFs(pkg.native())) {
+        for (auto file : pkgfs->Files()) files.emplace_back(file);
+        return pkgfs;
+    }
+    std::error_code ec;
+    const auto      dir = pkg.parent_path();
+    for (auto it = sfs::recursive_directory_iterator(dir, ec);
+         ! ec && it != sfs::recursive_directory_iterator();
+         it.increment(ec)) {
+        if (! it->is_regular_file() || it->path().extension() == fs::WPBundleFs::Extension)
+            continue;
+        files.push_back("/" + it->path().lexically_relative(dir).generic_string());
+    }
+    if (ec || files.empty()) {
+        LOG_ERROR("can't read %s", dir.c_str());
+        return nullptr;
+    }
+    return fs::CreatePhysicalFs(dir.native());
+}
+
+// of the paths and contents, a bundle of the same files gets the same
+std::string ContentStamp(const std::vector<fs::WPBundleFs::Entry>& entries) {
+    std::string all;
+    for (auto& e : entries) {
+        std::vector<char> data((usize)e.file->Size());
+        e.file->SeekSet(0);
+        if (e.file->Read(data.data(), data.size()) != data.size()) return {};
+        all += e.path + '\0' + utils::genSha1(data);
+    }
+    return "wpb-" + utils::genSha1({ all.data(), all.size() });
+}
+
+// the files of the cache folder, as a bundle carries them
+void AddCacheFiles(const sfs::path& cache, std::vector<fs::WPBundleFs::Entry>& entries) {
+    std::error_code ec;
+    for (auto it = sfs::recursive_directory_iterator(cache, ec);
+         ! ec && it != sfs::recursive_directory_iterator();
+         it.increment(ec)) {
+        const auto ext = it->path().extension();
+        if (! it->is_regular_file() || ext == ".tmp" || ext == ".lock") continue;
+        auto path = std::string(WPCacheDir::BundledDir) +
+                    it->path().lexically_relative(cache).generic_string();
+        if (auto file = fs::CreateCBinaryStream(it->path().native()))
+            entries.push_back({ std::move(path), std::move(file) });
+    }
+    std::string mark = "bundled\n";
+    entries.push_back({ std::string(WPCacheDir::BundledMark),
+                        std::make_shared<fs::MemBinaryStream>(
+                            std::vector<uint8_t>(mark.begin(), mark.end())) });
+}
+
+bool Bundle(const Args& args, const sfs::path& tmp) {
+    sfs::path pkg { args.scene };
+    pkg.replace_extension("pkg");
+    const std::string entry = "/" + pkg.filename().replace_extension("json").native();
+    const std::string id    = pkg.parent_path().filename().native();
+    sfs::path         out   = args.out.empty() ? sfs::path(pkg).replace_extension(
+                                                     fs::WPBundleFs::Extension)
+                                               : sfs::path(args.out);
+
+    std::vector<std::string> files;
+    auto                     source = OpenSource(pkg, files);
+    if (! source) return false;
+
+    // tex files decoded as a load decodes them, written back as plain mips
+    std::vector<fs::WPBundleFs::Entry> entries;
+    {
+        fs::VFS vfs;
+        vfs.Mount("/assets", fs::CreatePhysicalFs(args.assets), "assets");
+        vfs.Mount("/assets", std::move(source));
+        vfs.Mount("/cache", fs::CreatePhysicalFs((tmp / "decode").native(), true), "cache");
+        WPTexImageParser parser(&vfs);
+        parser.SetTranscode(args.transcode);
+
+        usize rewritten { 0 };
+        for (auto& path : files) {
+            constexpr std::string_view dir { "/materials/" }, ext { ".tex" };
+            auto                       file = vfs.Open("/assets" + path);
+            if (! file) return false;
+            if (path.starts_with(dir) && path.ends_with(ext)) {
+                auto name = path.substr(dir.size(), path.size() - dir.size() - ext.size());
+                auto img  = parser.Parse(name);
+                auto raw  = tmp / ("tex" + std::to_string(rewritten));
+                bool done { false };
+                if (img) {
+                    auto w = fs::CreateCBinaryStreamW(raw.native());
+                    done   = w && WPTexImageParser::WriteRaw(*w, *img);
+                }
+                if (done) {
+                    file = fs::CreateCBinaryStream(raw.native());
+                    rewritten++;
+                }
+            }
+            entries.push_back({ path, std::move(file) });
+        }
+        LOG_INFO("%d of %d files are decoded textures", (int)rewritten, (int)files.size());
+    }
+
+    const auto stamp = ContentStamp(entries);
+    if (stamp.empty()) return false;
+    const auto stage = tmp / ("stage" + std::string(fs::WPBundleFs::Extension));
+    if (! fs::WPBundleFs::Write(stage, entries, stamp)) return false;
+
+    // loaded from the bundle, the caches are what a load of it looks for
+    const auto cache = tmp / "cache";
+    {
+        fs::VFS vfs;
+        vfs.Mount("/assets", fs::CreatePhysicalFs(args.assets), "assets");
+        if (! vfs.Mount("/assets", fs::WPBundleFs::CreateBundleFs(stage.native()))) return false;
+        vfs.Mount("/cache", fs::CreatePhysicalFs(cache.native(), true), "cache");
+        std::string src;
+        if (auto f = vfs.Open("/assets" + entry)) src = f->ReadAllStr();
+        audio::SoundManager sound;
+        WPSceneParser       parser;
+        parser.SetSounds(false);
+        parser.SetQuality(args.quality);
+        if (src.empty() || ! parser.Parse(id, src, vfs, sound)) {
+            LOG_ERROR("can't load %s from the bundle", entry.c_str());
+            return false;
+        }
+    }
+    AddCacheFiles(cache, entries);
+
+    if (! fs::WPBundleFs::Write(out, entries, stamp)) return false;
+    LOG_INFO("bundle %s, %d files", out.c_str(), (int)entries.size());
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Args args;
+    if (! ParseArgs(argc, argv, args)) return 1;
+
+    std::error_code ec;
+    auto tmp = sfs::temp_directory_path(ec) / ("wpbundle." + std::to_string(::getpid()));
+    sfs::create_directories(tmp / "cache", ec);
+    if (ec) {
+        LOG_ERROR("can't make %s: %s", tmp.c_str(), ec.message().c_str());
+        return 1;
+    }
+    const bool ok = Bundle(args, tmp);
+    sfs::remove_all(tmp, ec);
+    return ok ? 0 : 1;
+}
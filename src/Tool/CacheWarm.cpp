@@ -0,0 +1,277 @@
+// Fills a cache folder ahead of the first load, for machines imaged with a fixed set of
+// wallpapers. Every scene of a workshop folder is loaded as the wallpaper would load it: the scene
+// json, its shaders to spir-v and their reflection, and its textures, png and jpeg ones decoded,
+// transcoded with --transcode. With --pipelines each scene is also compiled for a gpu offscreen
+// and drawn once, which seeds the vulkan pipeline cache of that gpu.
+//
+//   wpCacheWarm --assets <dir> --workshop <dir> --cache <dir> [--quality full|low]
+//               [--transcode 0|1] [--max-texture-size N] [--pipelines 0|1] [--gpu <uuid hex>]
+//
+// The workshop folder holds a folder per wallpaper, with its project.json, ones that aren't
+// scenes are skipped. The options are the properties of the same names the wallpaper runs with,
+// a cache warmed for other ones is missed. The cache folder is the wallpaper's cache_path.
+// Exits with 2 if a scene didn't load.
+
+#include "WPSceneParser.hpp"
+#include "WPPkgFs.hpp"
+#include "SceneWallpaperSurface.hpp"
+#include "Scene/Scene.h"
+#include "Interface/IImageParser.h"
+#include "Audio/SoundManager.h"
+#include "Fs/VFS.h"
+#include "Fs/PhysicalFs.h"
+#include "RenderGraph/RenderGraph.hpp"
+#include "VulkanRender/SceneToRenderGraph.hpp"
+#include "VulkanRender/VulkanRender.hpp"
+#include "Utils/Logging.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace wallpaper;
+using clk     = std::chrono::steady_clock;
+namespace sfs = std::filesystem;
+
+namespace
+{
+
+double Ms(clk::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+struct Args {
+    std::string          assets;
+    std::string          workshop;
+    std::string          cache;
+    ShaderQuality        quality { ShaderQuality::Full };
+    bool                 transcode { false };
+    u32                  max_texture_size { 0 };
+    bool                 pipelines { false };
+    std::vector<uint8_t> gpu;
+};
+
+// two hex digits a byte, dashes left out
+bool ParseUuid(std::string_view hex, std::vector<uint8_t>& out) {
+    std::string digits;
+    for (char c : hex) {
+        if (c != '-') digits += c;
+    }
+    if (digits.empty() || digits.size() % 2 != 0) return false;
+    for (usize i = 0; i < digits.size(); i += 2) {
+        char* end { nullptr };
+        auto  byte = digits.substr(i, 2);
+        out.push_back((uint8_t)std::strtoul(byte.c_str(), &end, 16));
+        if (end != byte.c_str() + 2) return false;
+    }
+    return true;
+}
+
+bool ParseArgs(int argc, char** argv, Args& args) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view key = argv[i];
+        const char*      val = argv[i + 1];
+        if (key == "--assets")
+            args.assets = val;
+        else if (key == "--workshop")
+            args.workshop = val;
+        else if (key == "--cache")
+            args.cache = val;
+        else if (key == "--quality")
+            args.quality = std::strcmp(val, "low") == 0 ? ShaderQuality::Low : ShaderQuality::Full;
+        else if (key == "--transcode")
+            args.transcode = std::strtol(val, nullptr, 10) != 0;
+        else if (key == "--max-texture-size")
+            args.max_texture_size = (u32)std::strtoul(val, nullptr, 10);
+        else if (key == "--pipelines")
+            args.pipelines = std::strtol(val, nullptr, 10) != 0;
+        else if (key == "--gpu") {
+            if (! ParseUuid(val, args.gpu)) {
+                LOG_ERROR("gpu uuid %s isn't hex", val);
+                return false;
+            }
+        } else {
+            LOG_ERROR("unknown option %s %s", argv[i], val);
+            return false;
+        }
+    }
+    if (argc % 2 == 0) {
+        LOG_ERROR("option %s has no value", argv[argc - 1]);
+        return false;
+    }
+    if (args.assets.empty() || args.workshop.empty() || args.cache.empty()) {
+        LOG_ERROR("--assets, --workshop and --cache are needed");
+        return false;
+    }
+    if (! args.gpu.empty() && ! args.pipelines) {
+        LOG_ERROR("--gpu is of --pipelines");
+        return false;
+    }
+    return true;
+}
+
+// the scene json of each scene wallpaper in the workshop folder, by project.json
+std::vector<sfs::path> FindScenes(const std::string& workshop) {
+    std::vector<sfs::path> scenes;
+    std::error_code        ec;
+    for (auto& entry : sfs::directory_iterator(workshop, ec)) {
+        if (! entry.is_directory()) continue;
+        std::ifstream file(entry.path() / "project.json");
+        if (! file) continue;
+        auto project = nlohmann::json::parse(file, nullptr, false);
+        if (project.is_discarded() || ! project.is_object()) {
+            LOG_ERROR("%s has a broken project.json", entry.path().c_str());
+            continue;
+        }
+        std::string type = project.value("type", "");
+        std::transform(type.begin(), type.end(), type.begin(), [](unsigned char c) {
+            return (char)std::tolower(c);
+        });
+        if (type != "scene") continue;
+        scenes.push_back(entry.path() / project.value("file", "scene.json"));
+    }
+    if (ec) LOG_ERROR("can't list %s: %s", workshop.c_str(), ec.message().c_str());
+    std::sort(scenes.begin(), scenes.end());
+    return scenes;
+}
+
+// mounted as SceneWallpaper does, the pkg or the directory it's in, with the cache folder
+std::unique_ptr<fs::VFS> MountScene(const Args& args, const sfs::path& scene, std::string& src) {
+    auto vfs = std::make_unique<fs::VFS>();
+    if (! vfs->Mount("/assets", fs::CreatePhysicalFs(args.assets), "assets")) {
+        LOG_ERROR("can't mount %s", args.assets.c_str());
+        return nullptr;
+    }
+    sfs::path pkg { scene };
+    pkg.replace_extension("pkg");
+    if (! vfs->Mount("/assets", fs::WPPkgFs::CreatePkgFs(pkg.native())) &&
+        ! vfs->Mount("/assets", fs::CreatePhysicalFs(pkg.parent_path().native()))) {
+        LOG_ERROR("can't load %s", scene.c_str());
+        return nullptr;
+    }
+    if (! vfs->Mount("/cache", fs::CreatePhysicalFs(args.cache, true), "cache")) {
+        LOG_ERROR("can't mount cache folder %s", args.cache.c_str());
+        return nullptr;
+    }
+    auto entry = "/assets/" + pkg.filename().replace_extension("json").native();
+    if (auto f = vfs->Open(entry)) src = f->ReadAllStr();
+    if (src.empty()) {
+        LOG_ERROR("no scene in %s", scene.c_str());
+        return nullptr;
+    }
+    return vfs;
+}
+
+// the render graph stays with the renderer till the next scene clears it
+struct Drawn {
+    std::shared_ptr<Scene>           scene;
+    std::unique_ptr<rg::RenderGraph> rg;
+};
+
+bool WarmScene(const Args& args, const sfs::path& path, vulkan::VulkanRender* render,
+               Drawn& drawn) {
+    std::string src;
+    auto        vfs = MountScene(args, path, src);
+    if (! vfs) return false;
+
+    auto                begin = clk::now();
+    audio::SoundManager sound;
+    WPSceneParser       parser;
+    parser.SetSounds(false);
+    parser.SetQuality(args.quality);
+    auto scene = parser.Parse(path.parent_path().filename().native(), src, *vfs, sound);
+    if (! scene) return false;
+    scene->vfs.swap(vfs);
+    const auto parsed = clk::now();
+    usize      compiled { 0 };
+    for (auto& load : parser.ShaderLoads()) compiled += load.cached ? 0 : 1;
+
+    // decoded as the wallpaper decodes them, the parser saves what it decoded to the cache
+    std::vector<std::string> tex_names;
+    for (auto& [name, _] : scene->textures) tex_names.push_back(name);
+    scene->imageParser->SetTranscode(args.transcode);
+    scene->imageParser->SetMaxSize(args.max_texture_size);
+    scene->imageParser->Preload(tex_names);
+    const auto decoded = clk::now();
+
+    if (render != nullptr) {
+        if (drawn.rg) render->clearLastRenderGraph();
+        drawn.rg    = sceneToRenderGraph(*scene);
+        drawn.scene = scene;
+        render->beginCompile(*scene, *drawn.rg);
+        while (! render->compileStep(std::chrono::milliseconds(16))) {
+        }
+        while (! render->pipelinesReady())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        // the pipeline cache is saved at the start of the frame after its jobs are done
+        (void)render->drawFrame(*scene);
+        if (auto* ex = render->exSwapchain()) (void)ex->eatFrame();
+    }
+    scene->imageParser->DropPreloaded();
+
+    LOG_INFO("%s: parse %.1f ms, %d of %d shaders compiled, %d textures %.1f ms, pipelines %.1f ms",
+             path.parent_path().filename().c_str(),
+             Ms(parsed - begin),
+             (int)compiled,
+             (int)parser.ShaderLoads().size(),
+             (int)tex_names.size(),
+             Ms(decoded - parsed),
+             Ms(clk::now() - decoded));
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Args args;
+    if (! ParseArgs(argc, argv, args)) return 1;
+
+    auto scenes = FindScenes(args.workshop);
+    if (scenes.empty()) {
+        LOG_ERROR("no scene wallpapers in %s", args.workshop.c_str());
+        return 1;
+    }
+
+    // one device for all scenes, their pipelines go to the one cache of its gpu
+    std::unique_ptr<vulkan::VulkanRender> render;
+    if (args.pipelines) {
+        render = std::make_unique<vulkan::VulkanRender>();
+        RenderInitInfo info;
+        info.offscreen  = true;
+        info.uuid       = args.gpu;
+        info.cache_path = args.cache;
+        if (! render->init(info)) {
+            LOG_ERROR("init vulkan failed");
+            return 1;
+        }
+        // scenes aren't switched back to
+        render->setTextureRetainBudget(0);
+    }
+
+    auto  begin = clk::now();
+    usize failed { 0 };
+    {
+        Drawn drawn;
+        for (auto& scene : scenes) {
+            if (! WarmScene(args, scene, render.get(), drawn)) {
+                LOG_ERROR("can't load %s", scene.c_str());
+                failed++;
+            }
+        }
+        if (render && drawn.rg) render->clearLastRenderGraph();
+    }
+    if (render) render->destroy();
+
+    LOG_INFO("warmed %d of %d scenes in %.1f s",
+             (int)(scenes.size() - failed),
+             (int)scenes.size(),
+             Ms(clk::now() - begin) / 1000.0);
+    return failed > 0 ? 2 : 0;
+}
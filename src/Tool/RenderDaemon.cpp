@@ -0,0 +1,393 @@
+// Draws scene wallpapers for other processes, so the desktop of each screen, the lock screen and
+// the greeter showing one wallpaper share its render. Clients connect with RenderClient and open
+// a scene by its assets, source, user properties and fill mode, clients asking for the same one
+// get the same frames. A scene is drawn at the size of its first client and dropped with its last.
+//
+//   wpRenderDaemon [--socket <path>] [--cache <dir>] [--images N] [--valid 0|1]
+//
+// The socket is in XDG_RUNTIME_DIR by default, the cache folder is the wallpaper's cache_path.
+// Frames are handed over drawn, as dma-bufs where the first client gave drm modifiers. Each
+// scene has --images images, a client holds two at most, the shown frame and the next one, a
+// frame that finds none free is dropped.
+
+#include "SceneWallpaper.hpp"
+#include "SceneWallpaperSurface.hpp"
+#include "Service/RenderProtocol.hpp"
+#include "Utils/Logging.h"
+#include "Utils/Platform.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace wallpaper;
+using namespace wallpaper::service;
+
+namespace
+{
+
+struct Args {
+    std::string socket { DefaultSocketPath() };
+    std::string cache { platform::GetCachePath("wescene-renderer").native() };
+    u32         images { 8 };
+    bool        valid { false };
+};
+
+bool ParseArgs(int argc, char** argv, Args& args) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view key = argv[i];
+        const char*      val = argv[i + 1];
+        if (key == "--socket")
+            args.socket = val;
+        else if (key == "--cache")
+            args.cache = val;
+        else if (key == "--images")
+            args.images = std::clamp<u32>((u32)std::strtoul(val, nullptr, 10), 3,
+                                          ExSwapchain::max_images);
+        else if (key == "--valid")
+            args.valid = std::strtol(val, nullptr, 10) != 0;
+        else {
+            LOG_ERROR("unknown option %s %s", argv[i], val);
+            return false;
+        }
+    }
+    if (argc % 2 == 0) {
+        LOG_ERROR("option %s has no value", argv[argc - 1]);
+        return false;
+    }
+    return true;
+}
+
+struct Scene;
+
+struct Client {
+    int    sock { -1 };
+    Scene* scene { nullptr };
+    // bits of images whose fd it got, and of those holding a frame it wasn't done with
+    u32  described { 0 };
+    u32  held { 0 };
+    bool visible { true };
+};
+
+// one SceneWallpaper, its frames taken from its ex swapchain and given back once no client
+// holds them and a newer one came
+struct Scene {
+    std::string                     key;
+    std::shared_ptr<SceneWallpaper> wallpaper;
+    // of the render init info, which points into them
+    std::vector<uint64_t> modifiers;
+    std::vector<uint8_t>  uuid;
+    u32                   width { 0 };
+    u32                   height { 0 };
+
+    // the one frames were taken from, it's made again when the renderer moves to another gpu
+    ExSwapchain*                                  swapchain { nullptr };
+    std::array<ExHandle*, ExSwapchain::max_images> taken {};
+    std::array<u32, ExSwapchain::max_images>       holders {};
+    i32                                           latest { -1 };
+    std::vector<Client*>                          clients;
+};
+
+class Daemon {
+public:
+    Daemon(const Args& args): m_args(args) {}
+    ~Daemon() {
+        while (! m_clients.empty()) drop(*m_clients.back());
+        if (m_listen >= 0) ::close(m_listen);
+        if (m_wake >= 0) ::close(m_wake);
+        ::unlink(m_args.socket.c_str());
+    }
+
+    bool init() {
+        m_wake = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_wake < 0) return false;
+        m_listen = Listen(m_args.socket);
+        if (m_listen < 0) return false;
+        LOG_INFO("render daemon listening on %s", m_args.socket.c_str());
+        return true;
+    }
+
+    // till a signal
+    void run(const volatile std::sig_atomic_t& stop) {
+        std::vector<pollfd> fds;
+        while (! stop) {
+            fds.clear();
+            fds.push_back({ m_listen, POLLIN, 0 });
+            fds.push_back({ m_wake, POLLIN, 0 });
+            for (auto& c : m_clients) fds.push_back({ c->sock, POLLIN, 0 });
+            if (::poll(fds.data(), fds.size(), -1) < 0) continue;
+
+            if (fds[1].revents & POLLIN) {
+                uint64_t n;
+                while (::read(m_wake, &n, sizeof(n)) > 0) {
+                }
+                // backwards, a scene whose clients were dropped is erased
+                for (usize i = m_scenes.size(); i-- > 0;) takeFrames(*m_scenes[i]);
+            }
+            // clients dropped meanwhile shift the ones after, matched by socket
+            for (usize i = 2; i < fds.size(); i++) {
+                if (fds[i].revents == 0) continue;
+                auto it = std::find_if(m_clients.begin(), m_clients.end(), [&](auto& c) {
+                    return c->sock == fds[i].fd;
+                });
+                if (it != m_clients.end()) receive(**it);
+            }
+            if (fds[0].revents & POLLIN) accept();
+        }
+    }
+
+private:
+    void accept() {
+        int sock = ::accept4(m_listen, nullptr, nullptr, SOCK_CLOEXEC);
+        if (sock < 0) return;
+        auto client  = std::make_unique<Client>();
+        client->sock = sock;
+        m_clients.push_back(std::move(client));
+    }
+
+    void receive(Client& client) {
+        MsgType              type;
+        std::vector<uint8_t> payload;
+        int                  fd { -1 };
+        if (! Receive(client.sock, type, payload, fd)) {
+            drop(client);
+            return;
+        }
+        if (fd >= 0) ::close(fd);
+        if (type == MsgType::Open && client.scene == nullptr) {
+            if (! open(client, payload)) drop(client);
+            return;
+        }
+        Scene* scene = client.scene;
+        if (scene == nullptr) return;
+        if (type == MsgType::Release) {
+            MsgImageId msg;
+            if (Read(payload, msg)) release(client, msg.id);
+        } else if (type == MsgType::Mouse) {
+            MsgMouse msg;
+            if (Read(payload, msg)) scene->wallpaper->mouseInput(msg.x, msg.y);
+        } else if (type == MsgType::Visible) {
+            MsgVisible msg;
+            if (! Read(payload, msg)) return;
+            client.visible = msg.visible != 0;
+            updateVisible(*scene);
+        }
+    }
+
+    bool open(Client& client, std::span<const uint8_t> payload) {
+        MsgOpen msg;
+        if (! Read(payload, msg)) return false;
+        payload = payload.subspan(sizeof(msg));
+        const usize mod_bytes = (usize)msg.modifier_count * sizeof(uint64_t);
+        if (payload.size() < mod_bytes || msg.uuid_size > sizeof(msg.uuid)) return false;
+        std::vector<uint64_t> modifiers(msg.modifier_count);
+        std::memcpy(modifiers.data(), payload.data(), mod_bytes);
+        payload = payload.subspan(mod_bytes);
+
+        std::array<std::string, 3> strs;
+        for (auto& str : strs) {
+            auto end = std::find(payload.begin(), payload.end(), 0);
+            if (end == payload.end()) return false;
+            str.assign(payload.begin(), end);
+            payload = payload.subspan((usize)(end - payload.begin()) + 1);
+        }
+        auto& [assets, source, user_props] = strs;
+        std::string key = assets + '\n' + source + '\n' + user_props + '\n' +
+                          std::to_string(msg.fillmode);
+
+        auto it = std::find_if(m_scenes.begin(), m_scenes.end(), [&](auto& s) {
+            return s->key == key;
+        });
+        Scene* scene { nullptr };
+        if (it != m_scenes.end()) {
+            scene = it->get();
+        } else {
+            auto made       = std::make_unique<Scene>();
+            made->key       = key;
+            made->modifiers = std::move(modifiers);
+            made->uuid.assign(msg.uuid, msg.uuid + msg.uuid_size);
+            made->width  = std::clamp<u32>(msg.width, 1, UINT16_MAX);
+            made->height = std::clamp<u32>(msg.height, 1, UINT16_MAX);
+            if (! start(*made, msg, assets, source, user_props)) return false;
+            scene = made.get();
+            m_scenes.push_back(std::move(made));
+        }
+        MsgOpened opened { .images = m_args.images,
+                           .width  = scene->width,
+                           .height = scene->height };
+        if (! Send(client.sock, MsgType::Opened, opened)) return false;
+        client.scene = scene;
+        scene->clients.push_back(&client);
+        LOG_INFO("client opened %s, %d on it", source.c_str(), (int)scene->clients.size());
+        updateVisible(*scene);
+        if (scene->latest >= 0) send(client, *scene->taken[(usize)scene->latest]);
+        return true;
+    }
+
+    bool start(Scene& scene, const MsgOpen& msg, const std::string& assets,
+               const std::string& source, const std::string& user_props) {
+        auto wp = std::make_shared<SceneWallpaper>();
+        if (! wp->init()) return false;
+        wp->setPropertyString(PROPERTY_CACHE_PATH, m_args.cache);
+        wp->setPropertyInt32(PROPERTY_FILLMODE, msg.fillmode);
+        wp->setPropertyInt32(PROPERTY_FPS, msg.fps);
+
+        RenderInitInfo info;
+        info.enable_valid_layer  = m_args.valid;
+        info.offscreen           = true;
+        info.offscreen_synced    = false;
+        info.offscreen_images    = (uint8_t)m_args.images;
+        info.offscreen_tiling    = msg.tiling == (u32)TexTiling::LINEAR ? TexTiling::LINEAR
+                                                                        : TexTiling::OPTIMAL;
+        info.offscreen_modifiers = scene.modifiers;
+        info.uuid                = scene.uuid;
+        info.width               = (uint16_t)scene.width;
+        info.height              = (uint16_t)scene.height;
+        info.frame_ready_callback = [wake = m_wake](const FrameReady&) {
+            uint64_t one { 1 };
+            (void)::write(wake, &one, sizeof(one));
+        };
+        wp->initVulkan(info);
+        // the assets last, the scene loads once it has all
+        wp->setPropertyString(PROPERTY_SOURCE, source);
+        wp->setPropertyString(PROPERTY_USER_PROPS, user_props);
+        wp->setPropertyString(PROPERTY_ASSETS, assets);
+        scene.wallpaper = std::move(wp);
+        LOG_INFO("drawing %s at %ux%u", source.c_str(), scene.width, scene.height);
+        return true;
+    }
+
+    void takeFrames(Scene& scene) {
+        ExSwapchain* swapchain = scene.wallpaper->exSwapchain();
+        if (swapchain == nullptr) return;
+        if (swapchain != scene.swapchain) {
+            if (scene.swapchain != nullptr) {
+                // its images are gone, clients open the scene again
+                LOG_INFO("renderer made again, clients of the scene dropped");
+                auto clients = scene.clients;
+                for (auto* c : clients) drop(*c);
+                return;
+            }
+            scene.swapchain = swapchain;
+        }
+        ExHandle* frame = swapchain->takeFrame();
+        if (frame == nullptr) return;
+        const i32 last = std::exchange(scene.latest, frame->id());
+        scene.taken[(usize)frame->id()] = frame;
+        for (auto* c : scene.clients) send(*c, *frame);
+        giveBack(scene, last);
+    }
+
+    void send(Client& client, const ExHandle& frame) {
+        const u32 bit = 1u << (u32)frame.id();
+        if ((client.described & bit) == 0) {
+            MsgImage msg { .id       = frame.id(),
+                           .width    = frame.width,
+                           .height   = frame.height,
+                           .dma_buf  = frame.dma_buf ? 1u : 0u,
+                           .size     = frame.size,
+                           .modifier = frame.modifier,
+                           .offset   = frame.offset,
+                           .stride   = frame.stride };
+            if (! Send(client.sock, MsgType::Image, msg, frame.fd)) return;
+            client.described |= bit;
+        }
+        // a client not done with the image can't take another frame in it
+        if ((client.held & bit) != 0) return;
+        if (! Send(client.sock,
+                   MsgType::Frame,
+                   MsgFrame { .id = frame.id(), .frame_id = frame.frame_id }))
+            return;
+        client.held |= bit;
+        client.scene->holders[(usize)frame.id()]++;
+    }
+
+    void release(Client& client, i32 id) {
+        if (id < 0 || id >= (i32)ExSwapchain::max_images) return;
+        const u32 bit = 1u << (u32)id;
+        if ((client.held & bit) == 0) return;
+        client.held &= ~bit;
+        client.scene->holders[(usize)id]--;
+        giveBack(*client.scene, id);
+    }
+
+    void giveBack(Scene& scene, i32 id) {
+        if (id < 0 || id == scene.latest || scene.holders[(usize)id] > 0) return;
+        if (auto* frame = std::exchange(scene.taken[(usize)id], nullptr))
+            scene.swapchain->giveBack(*frame);
+    }
+
+    // shown while any client shows it
+    void updateVisible(Scene& scene) {
+        bool visible = std::any_of(scene.clients.begin(), scene.clients.end(), [](auto* c) {
+            return c->visible;
+        });
+        scene.wallpaper->setVisible(visible);
+    }
+
+    void drop(Client& client) {
+        if (Scene* scene = client.scene) {
+            for (u32 held = client.held; held != 0; held &= held - 1) {
+                const i32 id = std::countr_zero(held);
+                client.held &= ~(1u << (u32)id);
+                scene->holders[(usize)id]--;
+                giveBack(*scene, id);
+            }
+            std::erase(scene->clients, &client);
+            if (scene->clients.empty()) {
+                LOG_INFO("last client of a scene gone, scene dropped");
+                std::erase_if(m_scenes, [scene](auto& s) {
+                    return s.get() == scene;
+                });
+            } else {
+                updateVisible(*scene);
+            }
+        }
+        ::close(client.sock);
+        std::erase_if(m_clients, [&client](auto& c) {
+            return c.get() == &client;
+        });
+    }
+
+    Args                                 m_args;
+    int                                  m_listen { -1 };
+    int                                  m_wake { -1 };
+    std::vector<std::unique_ptr<Client>> m_clients;
+    std::vector<std::unique_ptr<Scene>>  m_scenes;
+};
+
+volatile std::sig_atomic_t g_stop { 0 };
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Args args;
+    if (! ParseArgs(argc, argv, args)) return 1;
+
+    struct sigaction sa {};
+    sa.sa_handler = [](int) {
+        g_stop = 1;
+    };
+    ::sigaction(SIGINT, &sa, nullptr);
+    ::sigaction(SIGTERM, &sa, nullptr);
+
+    Daemon daemon(args);
+    if (! daemon.init()) {
+        LOG_ERROR("render daemon can't start");
+        return 1;
+    }
+    daemon.run(g_stop);
+    LOG_INFO("render daemon stopped");
+    return 0;
+}
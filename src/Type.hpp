@@ -69,7 +69,8 @@ enum class ShaderType
 {
     VERTEX,
     GEOMETRY,
-    FRAGMENT
+    FRAGMENT,
+    COMPUTE
 };
 
 enum class TextureType
@@ -118,7 +119,13 @@ enum class VertexType
     UINT1,
     UINT2,
     UINT3,
-    UINT4
+    UINT4,
+    // packed from floats, never padded: four half floats, four bytes of 0 to 1, two or four
+    // shorts of -1 to 1
+    HALF4,
+    UNORM8X4,
+    SNORM16X2,
+    SNORM16X4
 };
 
 } // namespace wallpaper
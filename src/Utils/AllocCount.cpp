@@ -0,0 +1,66 @@
+#include "AllocCount.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace wallpaper;
+
+#if ENABLE_ALLOC_COUNT
+namespace
+{
+std::atomic<u64> allocated { 0 };
+
+void* Allocate(std::size_t size) noexcept {
+    allocated.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+void* AllocateAligned(std::size_t size, std::align_val_t align) noexcept {
+    allocated.fetch_add(1, std::memory_order_relaxed);
+    // aligned_alloc wants a multiple of the alignment
+    const auto a = (std::size_t)align;
+    return std::aligned_alloc(a, (size + a - 1) / a * a);
+}
+} // namespace
+
+// every form, the deletes free what these got from malloc
+void* operator new(std::size_t size) {
+    if (void* p = Allocate(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+    if (void* p = Allocate(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new(std::size_t size, std::align_val_t align) {
+    if (void* p = AllocateAligned(size, align)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size, std::align_val_t align) {
+    if (void* p = AllocateAligned(size, align)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return AllocateAligned(size, align);
+}
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return AllocateAligned(size, align);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+u64  allocs::count() { return allocated.load(std::memory_order_relaxed); }
+bool allocs::counting() { return true; }
+#else
+u64  allocs::count() { return 0; }
+bool allocs::counting() { return false; }
+#endif
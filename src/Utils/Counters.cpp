@@ -0,0 +1,40 @@
+#include "Counters.hpp"
+
+using namespace wallpaper;
+using namespace wallpaper::counters;
+
+namespace
+{
+constexpr std::array<std::string_view, (usize)Counter::Count> names {
+    "shader_hits",
+    "shader_misses",
+    "shader_loaded_bytes",
+    "disk_evictions",
+    "disk_evicted_bytes",
+    "texture_hits",
+    "texture_retained_hits",
+    "texture_misses",
+    "texture_evictions",
+    "texture_evicted_bytes",
+    "target_hits",
+    "target_shared",
+    "target_misses",
+    "pipeline_hits",
+    "pipeline_misses",
+    "frames",
+    "upload_bytes",
+    "texture_upload_bytes",
+    "staging_grows",
+    "staging_grow_bytes",
+};
+} // namespace
+
+std::array<std::atomic<u64>, (usize)Counter::Count> counters::detail::values {};
+
+std::string_view counters::Name(Counter c) {
+    return (usize)c < names.size() ? names[(usize)c] : std::string_view {};
+}
+
+void counters::Reset() {
+    for (auto& v : detail::values) v.store(0, std::memory_order_relaxed);
+}
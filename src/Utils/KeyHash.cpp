@@ -0,0 +1,91 @@
+#include "KeyHash.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+// the primes and lane round of xxh64, four lanes of 32 bytes a stripe, hashed twice over with
+// different seeds for the two halves
+constexpr uint64_t P1 { 0x9E3779B185EBCA87ull };
+constexpr uint64_t P2 { 0xC2B2AE3D27D4EB4Full };
+constexpr uint64_t P3 { 0x165667B19E3779F9ull };
+constexpr uint64_t P4 { 0x85EBCA77C2B2AE63ull };
+constexpr uint64_t P5 { 0x27D4EB2F165667C5ull };
+
+inline uint64_t Read64(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    if constexpr (std::endian::native == std::endian::big) v = __builtin_bswap64(v);
+    return v;
+}
+
+inline uint64_t Round(uint64_t acc, uint64_t v) {
+    acc += v * P2;
+    acc = std::rotl(acc, 31);
+    return acc * P1;
+}
+
+inline uint64_t Avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+struct Lanes {
+    uint64_t v[4];
+
+    explicit Lanes(uint64_t seed): v { seed + P1 + P2, seed + P2, seed, seed - P1 } {}
+
+    void stripe(const char* p) {
+        for (int i = 0; i < 4; i++) v[i] = Round(v[i], Read64(p + i * 8));
+    }
+
+    uint64_t merge() const {
+        uint64_t h = std::rotl(v[0], 1) + std::rotl(v[1], 7) + std::rotl(v[2], 12) +
+                     std::rotl(v[3], 18);
+        for (auto x : v) h = (h ^ Round(0, x)) * P1 + P4;
+        return h;
+    }
+};
+
+// the tail and length go into both halves, crossed so they differ
+uint64_t Tail(uint64_t h, const char* p, size_t n) {
+    for (; n >= 8; n -= 8, p += 8) h = std::rotl(h ^ Round(0, Read64(p)), 27) * P1 + P4;
+    for (; n > 0; n--, p++) h = std::rotl(h ^ ((uint64_t)(unsigned char)*p * P5), 11) * P1;
+    return h;
+}
+} // namespace
+
+std::string utils::genKeyHash(std::span<const char> in) {
+    const char* p = in.data();
+    size_t      n = in.size();
+
+    uint64_t lo { P5 }, hi { P5 ^ P3 };
+    if (n >= 32) {
+        // the two halves share the reads, the lanes of each are independent so this pipelines
+        Lanes a(0), b(P4);
+        for (; n >= 32; n -= 32, p += 32) {
+            a.stripe(p);
+            b.stripe(p);
+            std::swap(b.v[0], b.v[3]);
+        }
+        lo = a.merge();
+        hi = b.merge();
+    }
+    lo = Avalanche(Tail(lo + in.size(), p, n));
+    hi = Avalanche(Tail(hi + in.size() * P2, p, n) ^ lo);
+
+    constexpr char digits[] { "0123456789abcdef" };
+    std::string    out(KEY_HASH_LEN, '0');
+    for (size_t i = 0; i < 16; i++) {
+        out[i]      = digits[(hi >> (60 - i * 4)) & 0xf];
+        out[16 + i] = digits[(lo >> (60 - i * 4)) & 0xf];
+    }
+    return out;
+}
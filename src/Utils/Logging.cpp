@@ -1,25 +1,274 @@
 #include "Logging.h"
 #include <cstdio>
 #include <cstdarg>
+#include <cstdlib>
 #include <filesystem>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+#include "Core/MpscRing.hpp"
+#include "Hash.h"
 #include "Sha.hpp"
 
+using namespace wallpaper;
+using namespace std::chrono;
+
+namespace
+{
 constexpr const char* level_names[] = { "INFO", "ERROR" };
 constexpr const char* level_fmt[]   = { "%-5s", "%-5s %s:%d " };
 
-void WallpaperLog(int level, const char* file, int line, const char* fmt, ...) {
+// longer lines are cut
+constexpr usize LineSize { 480 };
+// a call site writes this many lines a window, the others are counted and summed up after
+constexpr u32     SiteBudget { 10 };
+constexpr seconds SiteWindow { 5 };
+constexpr usize   NumSites { 512 };
+constexpr usize   SiteProbes { 8 };
+
+struct Line {
+    std::array<char, LineSize> text;
+    usize                      size { 0 };
+};
+
+struct Site {
+    // the key, a null fmt for a free one
+    const char* fmt { nullptr };
+    const char* file { nullptr };
+    int         line { 0 };
+    int         level { 0 };
+
+    steady_clock::time_point window;
+    u32                      logged { 0 };
+    u32                      suppressed { 0 };
+    // of the message last written
+    usize last_hash { 0 };
+    // fmt may not outlive the call
+    std::array<char, 48> what {};
+};
+
+// prefix, message and newline, returns where the message starts
+usize FormatV(Line& out, int level, const char* file, int line, const char* fmt,
+              std::va_list args) {
+    char* buf = out.text.data();
+    // room for the newline
+    usize cap  = out.text.size() - 1;
+    int   n    = std::snprintf(buf, cap, level_fmt[level], level_names[level], file, line);
+    usize head = std::min<usize>((usize)std::max(n, 0), cap - 1);
+    n          = std::vsnprintf(buf + head, cap - head, fmt, args);
+    out.size   = std::min<usize>(head + (usize)std::max(n, 0), cap - 1);
+    buf[out.size++] = '\n';
+    return head;
+}
+usize Format(Line& out, int level, const char* file, int line, const char* fmt, ...) {
     std::va_list args;
-    std::fprintf(stderr, level_fmt[level], level_names[level], file, line);
-    {
-        va_start(args, fmt);
-        std::vfprintf(stderr, fmt, args);
-        va_end(args);
+    va_start(args, fmt);
+    usize head = FormatV(out, level, file, line, fmt, args);
+    va_end(args);
+    return head;
+}
+
+// Lines are formatted on the calling thread and queued, a flusher thread writes them. Each call
+// site has a budget of lines a window, a line repeating the last one of its site counts against
+// nothing and is dropped, what was dropped is summed up once the window ended.
+// WP_LOG_SYNC set writes on the calling thread instead, the budget still holds.
+class Logger : NoCopy, NoMove {
+public:
+    // never destroyed, static destructors may log, what's queued is written at exit
+    static Logger& Shared();
+
+    void log(int level, const char* file, int line, const char* fmt, std::va_list);
+    void flush();
+
+private:
+    Logger();
+
+    void loop();
+    // false if the site used up its window or the line repeats its last one
+    bool  admit(int level, const char* file, int line, const char* fmt, usize hash);
+    Site* findSite(const char* fmt, const char* file, int line);
+    // under the sites mutex
+    void summarize(Site&, steady_clock::time_point now);
+    // all of them at exit, not only those whose window ended
+    void sweep(bool all = false);
+    void enqueue(Line&&);
+    void write(const Line&);
+
+    bool m_sync { false };
+
+    MpscRing<Line, 256> m_ring;
+    std::atomic<u64>    m_dropped { 0 };
+    // the ring has one consumer at a time, the flusher or a flush
+    std::mutex m_drain_mutex;
+
+    std::mutex                 m_sites_mutex;
+    std::array<Site, NumSites> m_sites;
+
+    std::mutex              m_wake_mutex;
+    std::condition_variable m_wake;
+    std::atomic<bool>       m_sleeping { false };
+};
+
+Logger& Logger::Shared() {
+    static Logger* logger = new Logger();
+    return *logger;
+}
+
+Logger::Logger() {
+    m_sync = std::getenv("WP_LOG_SYNC") != nullptr;
+    if (! m_sync) std::thread(&Logger::loop, this).detach();
+    std::atexit([]() {
+        Logger::Shared().sweep(true);
+        Logger::Shared().flush();
+    });
+}
+
+void Logger::log(int level, const char* file, int line, const char* fmt, std::va_list args) {
+    Line  out;
+    usize head = FormatV(out, level, file, line, fmt, args);
+    usize hash =
+        std::hash<std::string_view>()(std::string_view(out.text.data() + head, out.size - head));
+    if (admit(level, file, line, fmt, hash)) enqueue(std::move(out));
+}
+
+Site* Logger::findSite(const char* fmt, const char* file, int line) {
+    usize seed { 0 };
+    utils::hash_combine(seed, (const void*)fmt);
+    utils::hash_combine(seed, (const void*)file);
+    utils::hash_combine(seed, line);
+    for (usize i = 0; i < SiteProbes; i++) {
+        Site& site = m_sites[(seed + i) % NumSites];
+        if (site.fmt == nullptr || (site.fmt == fmt && site.file == file && site.line == line))
+            return &site;
     }
-    std::fprintf(stderr, "\n");
-    std::fflush(stderr);
+    // the table is crowded there, such sites go unlimited
+    return nullptr;
 }
 
+bool Logger::admit(int level, const char* file, int line, const char* fmt, usize hash) {
+    auto            now = steady_clock::now();
+    std::lock_guard lock(m_sites_mutex);
+    Site*           site = findSite(fmt, file, line);
+    if (site == nullptr) return true;
+    if (site->fmt == nullptr) {
+        site->fmt    = fmt;
+        site->file   = file;
+        site->line   = line;
+        site->level  = level;
+        site->window = now;
+        // a line of it, control characters would break the summary over lines
+        usize i = 0;
+        for (; i + 1 < site->what.size() && fmt[i] != '\0'; i++)
+            site->what[i] = (unsigned char)fmt[i] < ' ' ? ' ' : fmt[i];
+        site->what[i] = '\0';
+    }
+    if (now - site->window >= SiteWindow) summarize(*site, now);
+
+    if ((site->logged > 0 && hash == site->last_hash) || site->logged >= SiteBudget) {
+        site->suppressed++;
+        return false;
+    }
+    site->logged++;
+    site->last_hash = hash;
+    return true;
+}
+
+void Logger::summarize(Site& site, steady_clock::time_point now) {
+    if (site.suppressed > 0) {
+        Line out;
+        Format(out,
+               site.level,
+               site.file,
+               site.line,
+               "suppressed %u lines like \"%s\"",
+               site.suppressed,
+               site.what.data());
+        enqueue(std::move(out));
+    }
+    site.window     = now;
+    site.logged     = 0;
+    site.suppressed = 0;
+    site.last_hash  = 0;
+}
+
+void Logger::sweep(bool all) {
+    auto            now = steady_clock::now();
+    std::lock_guard lock(m_sites_mutex);
+    for (auto& site : m_sites) {
+        if (site.suppressed > 0 && (all || now - site.window >= SiteWindow)) summarize(site, now);
+    }
+}
+
+void Logger::enqueue(Line&& out) {
+    if (m_sync) {
+        std::lock_guard lock(m_drain_mutex);
+        write(out);
+        std::fflush(stderr);
+        return;
+    }
+    if (! m_ring.push(std::move(out))) {
+        m_dropped++;
+        return;
+    }
+    // pairs with the fence of the flusher going to sleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load()) {
+        std::lock_guard lock(m_wake_mutex);
+        m_wake.notify_one();
+    }
+}
+
+void Logger::write(const Line& out) { std::fwrite(out.text.data(), 1, out.size, stderr); }
+
+void Logger::flush() {
+    std::lock_guard lock(m_drain_mutex);
+    Line            out;
+    bool            any { false };
+    while (m_ring.pop(out)) {
+        write(out);
+        any = true;
+    }
+    if (u64 dropped = m_dropped.exchange(0); dropped > 0) {
+        std::fprintf(stderr, "ERROR log queue full, %lu lines dropped\n", (unsigned long)dropped);
+        any = true;
+    }
+    if (any) std::fflush(stderr);
+}
+
+void Logger::loop() {
+    for (;;) {
+        flush();
+        // summaries of sites that went quiet
+        sweep();
+
+        std::unique_lock lock(m_wake_mutex);
+        m_sleeping = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        m_wake.wait_for(lock, 1s, [this]() {
+            std::lock_guard drain(m_drain_mutex);
+            return ! m_ring.empty();
+        });
+        m_sleeping = false;
+    }
+}
+} // namespace
+
+void WallpaperLog(int level, const char* file, int line, const char* fmt, ...) {
+    std::va_list args;
+    va_start(args, fmt);
+    Logger::Shared().log(level, file, line, fmt, args);
+    va_end(args);
+}
+
+void WallpaperLogFlush() { Logger::Shared().flush(); }
+
 std::string logToTmpfileWithSha1(std::span<const char> in, const char* fmt, ...) {
     std::va_list          args;
     std::string           name   = utils::genSha1(in);
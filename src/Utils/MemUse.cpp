@@ -0,0 +1,46 @@
+#include "MemUse.hpp"
+
+#include <cstdio>
+#include <unistd.h>
+
+using namespace wallpaper;
+using namespace wallpaper::memuse;
+
+namespace
+{
+constexpr std::array<std::string_view, (usize)Pool::Count> names {
+    "json",
+    "scene_objects",
+    "images",
+    "geometry",
+    "particles",
+    "audio_decoders",
+    "audio_clips",
+    "spirv",
+    "shader_source",
+    "looper_messages",
+};
+} // namespace
+
+std::array<std::atomic<u64>, (usize)Pool::Count> memuse::detail::bytes {};
+std::array<std::atomic<u64>, (usize)Pool::Count> memuse::detail::peaks {};
+
+std::string_view memuse::Name(Pool p) {
+    return (usize)p < names.size() ? names[(usize)p] : std::string_view {};
+}
+
+void memuse::ResetPeaks() {
+    for (usize i = 0; i < (usize)Pool::Count; i++)
+        detail::peaks[i].store(detail::bytes[i].load(std::memory_order_relaxed),
+                               std::memory_order_relaxed);
+}
+
+u64 memuse::Resident() {
+    std::FILE* file = std::fopen("/proc/self/statm", "r");
+    if (file == nullptr) return 0;
+    unsigned long size { 0 }, resident { 0 };
+    const bool    read = std::fscanf(file, "%lu %lu", &size, &resident) == 2;
+    std::fclose(file);
+    const long page = ::sysconf(_SC_PAGESIZE);
+    return read && page > 0 ? (u64)resident * (u64)page : 0;
+}
@@ -0,0 +1,243 @@
+#include "ThreadCpu.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace wallpaper;
+using namespace wallpaper::thread_cpu;
+
+namespace
+{
+// distinct phases of a thread, more aren't counted
+constexpr u32 MaxPhases { 16 };
+// nesting of phases counted
+constexpr u32 MaxDepth { 8 };
+
+struct Totals {
+    u64 cpu_ns { 0 };
+    u64 voluntary { 0 };
+    u64 involuntary { 0 };
+
+    Totals& operator+=(const Totals& o) {
+        cpu_ns += o.cpu_ns;
+        voluntary += o.voluntary;
+        involuntary += o.involuntary;
+        return *this;
+    }
+};
+
+// added to by its thread alone, read by any, a reset may lose a racing add
+struct SharedPhase {
+    std::atomic<const char*> name { nullptr };
+    std::atomic<u64>         cpu_ns { 0 };
+    std::atomic<u64>         count { 0 };
+};
+
+// the fields but the phases under the registry mutex
+struct Entry {
+    std::string name;
+    pid_t       tid { 0 };
+    clockid_t   clock {};
+    bool        ended { false };
+    // what the thread had at the last reset
+    Totals base;
+    // an ended one's
+    Totals total;
+
+    SharedPhase      phases[MaxPhases];
+    std::atomic<u32> phase_count { 0 };
+
+    SharedPhase* phase(const char* name) {
+        u32 n = phase_count.load(std::memory_order_acquire);
+        for (u32 i = 0; i < n; i++) {
+            const char* p = phases[i].name.load(std::memory_order_relaxed);
+            if (p == name || std::strcmp(p, name) == 0) return &phases[i];
+        }
+        if (n == MaxPhases) return nullptr;
+        phases[n].name.store(name, std::memory_order_relaxed);
+        phase_count.store(n + 1, std::memory_order_release);
+        return &phases[n];
+    }
+};
+
+struct Registry {
+    std::mutex                          mutex;
+    std::vector<std::unique_ptr<Entry>> entries;
+};
+
+// never destroyed, threads may end after static destruction
+Registry& registry() {
+    static Registry* reg = new Registry();
+    return *reg;
+}
+
+u64 Ns(const timespec& ts) { return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec; }
+
+u64 ThreadCpuNs() {
+    timespec ts {};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return Ns(ts);
+}
+
+// of the calling thread
+Totals SelfTotals() {
+    Totals  t;
+    rusage  usage {};
+    t.cpu_ns = ThreadCpuNs();
+    if (::getrusage(RUSAGE_THREAD, &usage) == 0) {
+        t.voluntary   = (u64)usage.ru_nvcsw;
+        t.involuntary = (u64)usage.ru_nivcsw;
+    }
+    return t;
+}
+
+// of another live thread of the process, its cpu clock and the switches proc counts
+Totals LiveTotals(const Entry& entry) {
+    Totals   t;
+    timespec ts {};
+    if (::clock_gettime(entry.clock, &ts) == 0) t.cpu_ns = Ns(ts);
+
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/self/task/%d/status", (int)entry.tid);
+    std::FILE* file = std::fopen(path, "r");
+    if (file == nullptr) return t;
+    char line[256];
+    while (std::fgets(line, sizeof(line), file) != nullptr) {
+        unsigned long long n { 0 };
+        if (std::sscanf(line, "voluntary_ctxt_switches: %llu", &n) == 1) t.voluntary = n;
+        else if (std::sscanf(line, "nonvoluntary_ctxt_switches: %llu", &n) == 1)
+            t.involuntary = n;
+    }
+    std::fclose(file);
+    return t;
+}
+
+Totals Since(const Totals& now, const Totals& base) {
+    return { .cpu_ns      = now.cpu_ns - std::min(now.cpu_ns, base.cpu_ns),
+             .voluntary   = now.voluntary - std::min(now.voluntary, base.voluntary),
+             .involuntary = now.involuntary - std::min(now.involuntary, base.involuntary) };
+}
+
+struct Open {
+    const char* name;
+    u64         begin;
+    // of the phases inside
+    u64 inner;
+};
+
+// the thread's entry while it lives, on its end its numbers go to the ended ones of its name
+struct ThreadState {
+    Entry* entry { nullptr };
+    Open   open[MaxDepth];
+    u32    depth { 0 };
+
+    ~ThreadState() {
+        if (entry == nullptr) return;
+        const Totals    total = Since(SelfTotals(), entry->base);
+        auto&           reg   = registry();
+        std::lock_guard lock(reg.mutex);
+        auto            it = std::find_if(reg.entries.begin(), reg.entries.end(), [&](auto& e) {
+            return e->ended && e->name == entry->name;
+        });
+        if (it == reg.entries.end()) {
+            entry->ended = true;
+            entry->total = total;
+            return;
+        }
+        Entry& into = **it;
+        into.total += total;
+        for (u32 i = 0; i < entry->phase_count.load(std::memory_order_relaxed); i++) {
+            auto& from  = entry->phases[i];
+            auto* phase = into.phase(from.name.load(std::memory_order_relaxed));
+            if (phase == nullptr) continue;
+            phase->cpu_ns.fetch_add(from.cpu_ns.load(std::memory_order_relaxed),
+                                    std::memory_order_relaxed);
+            phase->count.fetch_add(from.count.load(std::memory_order_relaxed),
+                                   std::memory_order_relaxed);
+        }
+        std::erase_if(reg.entries, [this](auto& e) {
+            return e.get() == entry;
+        });
+    }
+};
+thread_local ThreadState t_state;
+} // namespace
+
+void thread_cpu::registerThread(std::string_view name) {
+    auto&           reg = registry();
+    std::lock_guard lock(reg.mutex);
+    if (t_state.entry != nullptr) {
+        t_state.entry->name = name;
+        return;
+    }
+    auto entry  = std::make_unique<Entry>();
+    entry->name = name;
+    entry->tid  = (pid_t)::syscall(SYS_gettid);
+    if (::pthread_getcpuclockid(::pthread_self(), &entry->clock) != 0)
+        entry->clock = CLOCK_THREAD_CPUTIME_ID;
+    t_state.entry = entry.get();
+    reg.entries.push_back(std::move(entry));
+}
+
+std::vector<Usage> thread_cpu::read(bool reset) {
+    auto&              reg = registry();
+    std::lock_guard    lock(reg.mutex);
+    std::vector<Usage> res;
+    res.reserve(reg.entries.size());
+    for (auto& entry : reg.entries) {
+        // a live one can't end meanwhile, its end takes the mutex
+        const Totals now   = entry->ended ? Totals {} : LiveTotals(*entry);
+        const Totals total = entry->ended ? entry->total : Since(now, entry->base);
+        Usage        usage { .name        = entry->name,
+                             .cpu_ns      = total.cpu_ns,
+                             .voluntary   = total.voluntary,
+                             .involuntary = total.involuntary,
+                             .ended       = entry->ended,
+                             .phases      = {} };
+        for (u32 i = 0; i < entry->phase_count.load(std::memory_order_acquire); i++) {
+            auto& phase = entry->phases[i];
+            usage.phases.push_back({ .name   = phase.name.load(std::memory_order_relaxed),
+                                     .cpu_ns = phase.cpu_ns.load(std::memory_order_relaxed),
+                                     .count  = phase.count.load(std::memory_order_relaxed) });
+            if (reset) {
+                phase.cpu_ns.store(0, std::memory_order_relaxed);
+                phase.count.store(0, std::memory_order_relaxed);
+            }
+        }
+        if (reset) entry->base = now;
+        res.push_back(std::move(usage));
+    }
+    if (reset) std::erase_if(reg.entries, [](auto& e) {
+        return e->ended;
+    });
+    return res;
+}
+
+void thread_cpu::phaseBegin(const char* name) {
+    if (t_state.entry == nullptr) return;
+    if (t_state.depth < MaxDepth) t_state.open[t_state.depth] = { name, ThreadCpuNs(), 0 };
+    t_state.depth++;
+}
+
+void thread_cpu::phaseEnd() {
+    if (t_state.entry == nullptr || t_state.depth == 0) return;
+    const u32 depth = --t_state.depth;
+    if (depth >= MaxDepth) return;
+    const Open& open = t_state.open[depth];
+    const u64   took = ThreadCpuNs() - open.begin;
+    if (depth > 0) t_state.open[depth - 1].inner += took;
+    if (auto* phase = t_state.entry->phase(open.name)) {
+        phase->cpu_ns.fetch_add(took - std::min(took, open.inner), std::memory_order_relaxed);
+        phase->count.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,178 @@
+#include "ThreadPolicy.hpp"
+#include "Logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace wallpaper::platform;
+
+namespace
+{
+// nice of frame threads where SCHED_RR is refused
+constexpr int frame_nice { -5 };
+
+std::mutex            g_mutex;
+ThreadPolicy          g_policy;
+std::atomic<unsigned> g_generation { 1 };
+
+struct Applied {
+    unsigned    generation { 0 };
+    ThreadClass cls { ThreadClass::Normal };
+    // what this thread changed, so it can be given back
+    bool rr { false };
+    bool niced { false };
+    bool idle { false };
+    bool pinned { false };
+};
+thread_local Applied t_applied;
+
+// "0-3,8,10-11" as in sysfs
+std::vector<int> ParseCpuList(const std::string& list) {
+    std::vector<int>   cpus;
+    std::istringstream in(list);
+    std::string        range;
+    while (std::getline(in, range, ',')) {
+        int first { -1 }, last { -1 };
+        if (std::sscanf(range.c_str(), "%d-%d", &first, &last) == 1) last = first;
+        for (int i = first; i >= 0 && i <= last; i++) cpus.push_back(i);
+    }
+    return cpus;
+}
+
+// the e-cores of hybrid intel cpus, or the arm cores below the largest capacity
+std::vector<int> FindEfficiencyCores() {
+    std::string list;
+    if (std::ifstream atom("/sys/devices/cpu_atom/cpus"); std::getline(atom, list))
+        return ParseCpuList(list);
+
+    std::vector<std::pair<int, long>> caps;
+    long                              max_cap { 0 };
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpu_capacity");
+        if (! file.is_open()) break;
+        long cap { 0 };
+        if (! (file >> cap)) continue;
+        caps.emplace_back(cpu, cap);
+        max_cap = std::max(max_cap, cap);
+    }
+    std::vector<int> cpus;
+    for (auto& [cpu, cap] : caps) {
+        if (cap < max_cap) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+const std::vector<int>& EfficiencyCores() {
+    static const std::vector<int> cores = []() {
+        auto found = FindEfficiencyCores();
+        if (found.empty())
+            LOG_INFO("no efficiency cores told apart, load threads run on all cores");
+        else
+            LOG_INFO("efficiency cores: %d", (int)found.size());
+        return found;
+    }();
+    return cores;
+}
+
+bool SetPolicy(int policy, int priority) {
+    sched_param param {};
+    param.sched_priority = priority;
+    return pthread_setschedparam(pthread_self(), policy, &param) == 0;
+}
+
+bool SetNice(int nice) { return setpriority(PRIO_PROCESS, (id_t)gettid(), nice) == 0; }
+
+bool SetAffinity(const std::vector<int>* cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpus != nullptr) {
+        for (int cpu : *cpus) {
+            // ids past the set or not parsed are skipped, the rest still bind
+            if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET((size_t)cpu, &set);
+        }
+    } else {
+        for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// back to SCHED_OTHER at nice 0 on every core, lowering always goes, what isn't allowed is
+// undoing SCHED_IDLE without nice limits
+void Restore(Applied& st) {
+    if ((st.rr || st.idle) && ! SetPolicy(SCHED_OTHER, 0))
+        LOG_ERROR("can't give a thread its default priority back: %s", std::strerror(errno));
+    if (st.niced) (void)SetNice(0);
+    if (st.pinned) (void)SetAffinity(nullptr);
+    st.rr = st.niced = st.idle = st.pinned = false;
+}
+
+void Boost(Applied& st) {
+    if (SetPolicy(SCHED_RR, 1)) {
+        st.rr = true;
+        return;
+    }
+    int rr_err = errno;
+    if (SetNice(frame_nice)) {
+        st.niced = true;
+        return;
+    }
+    static std::once_flag logged;
+    std::call_once(logged, [rr_err]() {
+        LOG_INFO("frame threads keep their priority, SCHED_RR: %s, nice %d: %s",
+                 std::strerror(rr_err),
+                 frame_nice,
+                 std::strerror(errno));
+    });
+}
+} // namespace
+
+void wallpaper::platform::SetThreadPolicy(const ThreadPolicy& policy) {
+    std::lock_guard lock(g_mutex);
+    if (policy == g_policy) return;
+    g_policy = policy;
+    g_generation++;
+    LOG_INFO("thread policy: boost frame %d, idle load %d, efficiency cores %d",
+             (int)policy.boost_frame,
+             (int)policy.idle_load,
+             (int)policy.efficiency_cores);
+}
+
+ThreadPolicy wallpaper::platform::GetThreadPolicy() {
+    std::lock_guard lock(g_mutex);
+    return g_policy;
+}
+
+void wallpaper::platform::ApplyThreadClass(ThreadClass cls) {
+    auto&    st         = t_applied;
+    unsigned generation = g_generation.load(std::memory_order_relaxed);
+    if (st.generation == generation && st.cls == cls) return;
+    st.generation = generation;
+    st.cls        = cls;
+
+    auto policy = GetThreadPolicy();
+    Restore(st);
+    switch (cls) {
+    case ThreadClass::Frame:
+        if (policy.boost_frame) Boost(st);
+        break;
+    case ThreadClass::Load:
+        if (policy.idle_load) st.idle = SetPolicy(SCHED_IDLE, 0);
+        if (policy.efficiency_cores && ! EfficiencyCores().empty())
+            st.pinned = SetAffinity(&EfficiencyCores());
+        break;
+    case ThreadClass::Normal: break;
+    }
+}
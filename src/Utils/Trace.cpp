@@ -0,0 +1,340 @@
+#include "Trace.h"
+#include "Logging.h"
+#include "ThreadCpu.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace wallpaper;
+using namespace wallpaper::trace;
+
+namespace
+{
+// a thread's events of a capture, more are dropped
+constexpr usize MaxEvents { 1 << 16 };
+// a thread's last zones kept by the flight recorder, seconds of frames with their phases
+constexpr usize FlightEvents { 1 << 12 };
+// open zones of a thread others can see, deeper ones are left out
+constexpr u32 MaxOpen { 16 };
+
+struct Event {
+    const char* name;
+    i64         begin;
+    i64         end;
+};
+
+// read while the thread writes, a torn one has fields of two zones but only ever valid names
+struct SharedEvent {
+    std::atomic<const char*> name { nullptr };
+    std::atomic<i64>         begin { 0 };
+    std::atomic<i64>         end { 0 };
+};
+
+// written by its thread alone, read once a capture stopped up to the published size
+struct ThreadBuffer {
+    std::unique_ptr<Event[]> events;
+    std::atomic<usize>       size { 0 };
+    // the events are of it
+    std::atomic<u32> capture { 0 };
+    u32              tid { 0 };
+    // under the registry mutex
+    std::string name;
+
+    // the flight ring, made by the thread the first time, never freed like the buffer itself
+    std::atomic<SharedEvent*> flight { nullptr };
+    std::atomic<u64>          flight_next { 0 };
+    SharedEvent               open[MaxOpen];
+    std::atomic<u32>          open_depth { 0 };
+};
+
+struct Registry {
+    // buffers, names, start and stop
+    std::mutex                                 mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+    std::atomic<bool> on { false };
+    std::atomic<u32>  capture { 0 };
+    std::atomic<i64>  origin { 0 };
+    // starts of the flight recorder not stopped yet
+    std::atomic<u32> flight { 0 };
+};
+
+// never destroyed, threads may record after static destruction
+Registry& registry() {
+    static Registry* reg = new Registry();
+    return *reg;
+}
+
+thread_local ThreadBuffer* t_buffer { nullptr };
+
+ThreadBuffer& threadBuffer() {
+    if (t_buffer == nullptr) {
+        auto&           reg = registry();
+        std::lock_guard lock(reg.mutex);
+        auto&           buf = reg.buffers.emplace_back(std::make_unique<ThreadBuffer>());
+        buf->tid            = (u32)reg.buffers.size();
+        t_buffer            = buf.get();
+    }
+    return *t_buffer;
+}
+
+i64 nowNs() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void record(const char* name, i64 begin, i64 end) {
+    auto& reg = registry();
+    if (! reg.on.load(std::memory_order_acquire)) return;
+    u32 capture = reg.capture.load(std::memory_order_acquire);
+    // begun in the capture before
+    if (begin < reg.origin.load(std::memory_order_relaxed)) return;
+
+    auto& buf = threadBuffer();
+    if (buf.capture.load(std::memory_order_relaxed) != capture) {
+        buf.size.store(0, std::memory_order_relaxed);
+        buf.capture.store(capture, std::memory_order_release);
+    }
+    if (! buf.events) buf.events = std::make_unique<Event[]>(MaxEvents);
+    usize n = buf.size.load(std::memory_order_relaxed);
+    if (n >= MaxEvents) return;
+    buf.events[n] = { name, begin, end };
+    buf.size.store(n + 1, std::memory_order_release);
+}
+
+void recordFlight(ThreadBuffer& buf, const char* name, i64 begin, i64 end) {
+    auto* ring = buf.flight.load(std::memory_order_relaxed);
+    if (ring == nullptr) {
+        ring = new SharedEvent[FlightEvents];
+        buf.flight.store(ring, std::memory_order_release);
+    }
+    u64   n  = buf.flight_next.load(std::memory_order_relaxed);
+    auto& ev = ring[n % FlightEvents];
+    ev.name.store(name, std::memory_order_relaxed);
+    ev.begin.store(begin, std::memory_order_relaxed);
+    ev.end.store(end, std::memory_order_relaxed);
+    buf.flight_next.store(n + 1, std::memory_order_release);
+}
+
+// names are ours but for thread names
+void writeString(std::FILE* file, std::string_view str) {
+    std::fputc('"', file);
+    for (char c : str) {
+        if (c == '"' || c == '\\') std::fputc('\\', file);
+        std::fputc((unsigned char)c < ' ' ? ' ' : c, file);
+    }
+    std::fputc('"', file);
+}
+} // namespace
+
+void trace::start() {
+    auto&           reg = registry();
+    std::lock_guard lock(reg.mutex);
+    if (reg.on) return;
+#if ! ENABLE_TRACE
+    LOG_INFO("trace capture started, but zones are only built with ENABLE_TRACE");
+#endif
+    reg.origin.store(nowNs(), std::memory_order_relaxed);
+    reg.capture.fetch_add(1, std::memory_order_release);
+    reg.on.store(true, std::memory_order_release);
+}
+
+bool trace::capturing() { return registry().on.load(std::memory_order_relaxed); }
+
+bool trace::stop(const std::string& path) {
+    auto&           reg = registry();
+    std::lock_guard lock(reg.mutex);
+    if (! reg.on) return false;
+    reg.on.store(false, std::memory_order_release);
+
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        LOG_ERROR("can't write trace to %s", path.c_str());
+        return false;
+    }
+    const u32 capture = reg.capture.load(std::memory_order_relaxed);
+    const i64 origin  = reg.origin.load(std::memory_order_relaxed);
+
+    usize total { 0 };
+    bool  first { true };
+    std::fputs("{\"traceEvents\":[\n", file);
+    for (auto& buf : reg.buffers) {
+        if (buf->capture.load(std::memory_order_acquire) != capture) continue;
+        usize size = buf->size.load(std::memory_order_acquire);
+        if (size == 0) continue;
+
+        if (! buf->name.empty()) {
+            std::fprintf(file,
+                         "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\","
+                         "\"args\":{\"name\":",
+                         first ? "" : ",\n",
+                         buf->tid);
+            writeString(file, buf->name);
+            std::fputs("}}", file);
+            first = false;
+        }
+        for (usize i = 0; i < size; i++) {
+            const Event& ev = buf->events[i];
+            std::fprintf(file, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":", first ? "" : ",\n",
+                         buf->tid);
+            writeString(file, ev.name);
+            std::fprintf(file,
+                         ",\"ts\":%.3f,\"dur\":%.3f}",
+                         (double)(ev.begin - origin) / 1000.0,
+                         (double)(ev.end - ev.begin) / 1000.0);
+            first = false;
+        }
+        total += size;
+    }
+    std::fputs("\n]}\n", file);
+    bool ok = std::fclose(file) == 0;
+    LOG_INFO("trace of %zu zones written to %s", total, path.c_str());
+    return ok;
+}
+
+void trace::setThreadName(std::string_view name) {
+    thread_cpu::registerThread(name);
+    auto&           buf = threadBuffer();
+    std::lock_guard lock(registry().mutex);
+    buf.name = name;
+}
+
+void trace::startFlight() {
+    if (registry().flight.fetch_add(1, std::memory_order_relaxed) == 0)
+        LOG_INFO("flight recorder on");
+}
+
+void trace::stopFlight() { registry().flight.fetch_sub(1, std::memory_order_relaxed); }
+
+bool trace::flying() { return registry().flight.load(std::memory_order_relaxed) > 0; }
+
+bool trace::dumpFlight(const std::string& path, std::chrono::nanoseconds window) {
+    auto&           reg = registry();
+    std::lock_guard lock(reg.mutex);
+    std::FILE*      file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        LOG_ERROR("can't write flight record to %s", path.c_str());
+        return false;
+    }
+    const i64 now    = nowNs();
+    const i64 origin = now - (i64)window.count();
+
+    usize total { 0 };
+    bool  first { true };
+    auto  write = [&](u32 tid, const char* name, i64 begin, i64 end, bool open) {
+        if (name == nullptr || end < origin) return;
+        std::fprintf(
+            file, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":", first ? "" : ",\n", tid);
+        writeString(file, name);
+        std::fprintf(file,
+                     ",\"ts\":%.3f,\"dur\":%.3f%s}",
+                     (double)(std::max(begin, origin) - origin) / 1000.0,
+                     (double)(end - std::max(begin, origin)) / 1000.0,
+                     open ? ",\"args\":{\"open\":true}" : "");
+        first = false;
+        total++;
+    };
+    std::fputs("{\"traceEvents\":[\n", file);
+    for (auto& buf : reg.buffers) {
+        auto* ring = buf->flight.load(std::memory_order_acquire);
+        u32   open = std::min(buf->open_depth.load(std::memory_order_acquire), MaxOpen);
+        if (ring == nullptr && open == 0) continue;
+        if (! buf->name.empty()) {
+            std::fprintf(file,
+                         "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\","
+                         "\"args\":{\"name\":",
+                         first ? "" : ",\n",
+                         buf->tid);
+            writeString(file, buf->name);
+            std::fputs("}}", file);
+            first = false;
+        }
+        if (ring != nullptr) {
+            u64 n = buf->flight_next.load(std::memory_order_acquire);
+            for (u64 i = n > FlightEvents ? n - FlightEvents : 0; i < n; i++) {
+                auto& ev = ring[i % FlightEvents];
+                write(buf->tid,
+                      ev.name.load(std::memory_order_relaxed),
+                      ev.begin.load(std::memory_order_relaxed),
+                      ev.end.load(std::memory_order_relaxed),
+                      false);
+            }
+        }
+        for (u32 i = 0; i < open; i++) {
+            auto& ev = buf->open[i];
+            write(buf->tid,
+                  ev.name.load(std::memory_order_relaxed),
+                  ev.begin.load(std::memory_order_relaxed),
+                  now,
+                  true);
+        }
+    }
+    std::fputs("\n]}\n", file);
+    bool ok = std::fclose(file) == 0;
+    LOG_INFO("flight record of %zu zones written to %s", total, path.c_str());
+    return ok;
+}
+
+std::string trace::openZones() {
+    auto&           reg = registry();
+    std::lock_guard lock(reg.mutex);
+    const i64       now = nowNs();
+    std::string     out;
+    for (auto& buf : reg.buffers) {
+        u32 open = std::min(buf->open_depth.load(std::memory_order_acquire), MaxOpen);
+        if (open == 0) continue;
+        out += buf->name.empty() ? "thread " + std::to_string(buf->tid) : buf->name;
+        out += ":";
+        for (u32 i = 0; i < open; i++) {
+            auto&       ev   = buf->open[i];
+            const char* name = ev.name.load(std::memory_order_relaxed);
+            char        ms[32];
+            std::snprintf(ms,
+                          sizeof(ms),
+                          " %.1f",
+                          (double)(now - ev.begin.load(std::memory_order_relaxed)) / 1e6);
+            out += i == 0 ? " " : " > ";
+            out += name != nullptr ? name : "?";
+            out += ms;
+        }
+        out += " ms\n";
+    }
+    return out;
+}
+
+Zone::Zone(const char* name, bool phase): m_name(name) {
+    auto&      reg    = registry();
+    const bool flight = reg.flight.load(std::memory_order_relaxed) > 0;
+    if (! flight && ! reg.on.load(std::memory_order_relaxed)) return;
+    if (phase) thread_cpu::phaseBegin(name);
+    m_phase = phase;
+    m_begin = nowNs();
+    if (! flight) return;
+
+    auto& buf   = threadBuffer();
+    u32   depth = buf.open_depth.load(std::memory_order_relaxed);
+    if (depth < MaxOpen) {
+        buf.open[depth].name.store(name, std::memory_order_relaxed);
+        buf.open[depth].begin.store(m_begin, std::memory_order_relaxed);
+    }
+    buf.open_depth.store(depth + 1, std::memory_order_release);
+    m_open = true;
+}
+
+Zone::~Zone() {
+    if (m_begin < 0) return;
+    const i64 end = nowNs();
+    if (m_phase) thread_cpu::phaseEnd();
+    record(m_name, m_begin, end);
+    if (! m_open) return;
+    auto& buf = threadBuffer();
+    buf.open_depth.store(buf.open_depth.load(std::memory_order_relaxed) - 1,
+                         std::memory_order_release);
+    recordFlight(buf, m_name, m_begin, end);
+}
@@ -73,6 +73,8 @@ constexpr double lerp(double t, double a, double b) noexcept { return a + t * (b
 
 constexpr double PerlinEase(double t) noexcept { return t * t * t * (t * (t * 6 - 15) + 10); };
 double           PerlinNoise(double x, double y, double z) noexcept;
+// the 512 entries PerlinNoise hashes with, the 256 permutation twice
+const u8* PerlinPermutation() noexcept;
 
 // curl need a vec
 inline Eigen::Vector3d PerlinNoiseVec3(Eigen::Vector3d p) noexcept {
@@ -0,0 +1,16 @@
+#pragma once
+#include "Core/Literals.hpp"
+
+namespace wallpaper
+{
+namespace allocs
+{
+
+// heap allocations of the process so far, all threads, global new counts them when built with
+// ENABLE_ALLOC_COUNT, the difference over a frame is what it allocated
+u64 count();
+// false without ENABLE_ALLOC_COUNT, count() stays 0 then
+bool counting();
+
+} // namespace allocs
+} // namespace wallpaper
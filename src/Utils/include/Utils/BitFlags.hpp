@@ -45,6 +45,8 @@ public:
 
     auto to_string() const { return bits_.to_string(); }
 
+    [[nodiscard]] UnderlyingT value() const noexcept { return (UnderlyingT)bits_.to_ullong(); }
+
 private:
     static constexpr UnderlyingT underlying(EnumT e) { return static_cast<UnderlyingT>(e); }
 
@@ -0,0 +1,64 @@
+#pragma once
+#include "Core/Literals.hpp"
+
+#include <array>
+#include <atomic>
+#include <string_view>
+
+namespace wallpaper
+{
+namespace counters
+{
+
+// what the caches and uploads did, process wide, from any thread
+enum class Counter : usize
+{
+    // spirv of WPShaderCache, on disk and shared by processes
+    ShaderHits,
+    ShaderMisses,
+    ShaderLoadedBytes,
+    // files WPCacheDir::Trim removed, of every cache directory
+    DiskEvictions,
+    DiskEvictedBytes,
+    // images of TextureCache::CreateTex, of the scene, retained from an earlier one, or made
+    TextureHits,
+    TextureRetainedHits,
+    TextureMisses,
+    TextureEvictions,
+    TextureEvictedBytes,
+    // render targets of TextureCache::Query, the key's own, a released one shared, or made
+    TargetHits,
+    TargetShared,
+    TargetMisses,
+    // pipelines of the PipelineRegistry, handed out again or made
+    PipelineHits,
+    PipelineMisses,
+    // frames drawn, the upload counts over it give them per frame
+    Frames,
+    // staging buffer ranges copied to the gpu, and texture pixels staged for their upload
+    UploadBytes,
+    TextureUploadBytes,
+    // StagingBuffer::increaseBuf, a reallocation and copy of the whole buffer each
+    StagingGrows,
+    StagingGrowBytes,
+    Count
+};
+
+namespace detail
+{
+extern std::array<std::atomic<u64>, (usize)Counter::Count> values;
+}
+
+// relaxed, cheap enough for every operation of a cache
+inline void Add(Counter c, u64 n = 1) {
+    detail::values[(usize)c].fetch_add(n, std::memory_order_relaxed);
+}
+inline u64 Read(Counter c) { return detail::values[(usize)c].load(std::memory_order_relaxed); }
+
+// snake case, for logs and reports
+std::string_view Name(Counter);
+// racing adds may be lost to it or counted after
+void Reset();
+
+} // namespace counters
+} // namespace wallpaper
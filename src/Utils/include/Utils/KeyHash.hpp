@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+#include <span>
+
+namespace utils
+{
+constexpr size_t KEY_HASH_LEN = 32;
+
+// 128 bits as hex, for cache keys of what's on disk already, not collision resistant against
+// anyone crafting inputs but many times faster than sha1 on large inputs
+std::string genKeyHash(std::span<const char>);
+} // namespace utils
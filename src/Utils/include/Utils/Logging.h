@@ -34,6 +34,9 @@ enum
 #define LOG_INFO(...)  WallpaperLog(LOGLEVEL_INFO, "", 0, __VA_ARGS__)
 #define LOG_ERROR(...) WallpaperLog(LOGLEVEL_ERROR, __SHORT_FILE__, __LINE__, __VA_ARGS__)
 
+// queued and written by a flusher thread, a call site spamming lines gets them summed up
 void WallpaperLog(int level, const char* file, int line, const char* fmt, ...);
+// writes what's queued on the caller, e.g. before aborting
+void WallpaperLogFlush();
 
 std::string logToTmpfileWithSha1(std::span<const char>, const char* fmt, ...);
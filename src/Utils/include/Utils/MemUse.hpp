@@ -0,0 +1,108 @@
+#pragma once
+#include "Core/Literals.hpp"
+
+#include <array>
+#include <atomic>
+#include <string_view>
+#include <utility>
+
+namespace wallpaper
+{
+namespace memuse
+{
+
+// cpu memory held by a part of the renderer, process wide, from any thread. Sizes are of the
+// buffers the parts allocate, small members and allocator overhead aren't counted
+enum class Pool : usize
+{
+    // parsed json of the scene and the files its objects read, only while a scene parses
+    Json,
+    // the wpscene objects read from it, only while a scene parses, not what they point to
+    SceneObjects,
+    // decoded mips of Image, until the renderer uploaded and dropped them
+    Images,
+    // SceneVertexArray and SceneIndexArray
+    Geometry,
+    // particle storage of every ParticleInstance
+    Particles,
+    // sound decoders, their read ahead buffers and the rings they decode into
+    AudioDecoders,
+    // short sounds kept decoded
+    AudioClips,
+    // spirv and reflection the scene's shaders keep
+    Spirv,
+    // expanded shader sources and includes, only while a scene parses
+    ShaderSource,
+    // looper messages, queued or pooled
+    LooperMessages,
+    Count
+};
+
+namespace detail
+{
+extern std::array<std::atomic<u64>, (usize)Pool::Count> bytes;
+extern std::array<std::atomic<u64>, (usize)Pool::Count> peaks;
+} // namespace detail
+
+// relaxed, the peak is raised with the bytes
+inline void Add(Pool p, u64 n) {
+    if (n == 0) return;
+    const u64 now  = detail::bytes[(usize)p].fetch_add(n, std::memory_order_relaxed) + n;
+    auto&     peak = detail::peaks[(usize)p];
+    u64       was  = peak.load(std::memory_order_relaxed);
+    while (was < now && ! peak.compare_exchange_weak(was, now, std::memory_order_relaxed)) {
+    }
+}
+inline void Sub(Pool p, u64 n) {
+    if (n != 0) detail::bytes[(usize)p].fetch_sub(n, std::memory_order_relaxed);
+}
+inline u64 Read(Pool p) { return detail::bytes[(usize)p].load(std::memory_order_relaxed); }
+inline u64 Peak(Pool p) { return detail::peaks[(usize)p].load(std::memory_order_relaxed); }
+
+// snake case, for logs and reports
+std::string_view Name(Pool);
+// peaks start over from what is held now
+void ResetPeaks();
+// of the whole process, from /proc, 0 where it can't be read
+u64 Resident();
+
+// bytes of a pool owned by a member of what holds them, set as its buffers change. A copy counts
+// them again, a move takes them along
+class Held {
+public:
+    explicit Held(Pool p, u64 n = 0): m_pool(p), m_bytes(n) { Add(m_pool, m_bytes); }
+    ~Held() { Sub(m_pool, m_bytes); }
+
+    Held(const Held& o): Held(o.m_pool, o.m_bytes) {}
+    Held(Held&& o) noexcept: m_pool(o.m_pool), m_bytes(std::exchange(o.m_bytes, 0)) {}
+    Held& operator=(const Held& o) {
+        if (this != &o) set(o.m_bytes);
+        return *this;
+    }
+    Held& operator=(Held&& o) noexcept {
+        if (this == &o) return *this;
+        Sub(m_pool, m_bytes);
+        m_bytes = std::exchange(o.m_bytes, 0);
+        if (m_pool != o.m_pool) {
+            Sub(o.m_pool, m_bytes);
+            Add(m_pool, m_bytes);
+        }
+        return *this;
+    }
+
+    void set(u64 n) {
+        if (n > m_bytes)
+            Add(m_pool, n - m_bytes);
+        else
+            Sub(m_pool, m_bytes - n);
+        m_bytes = n;
+    }
+    u64 bytes() const { return m_bytes; }
+
+private:
+    Pool m_pool;
+    u64  m_bytes { 0 };
+};
+
+} // namespace memuse
+} // namespace wallpaper
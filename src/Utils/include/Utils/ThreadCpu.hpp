@@ -0,0 +1,44 @@
+#pragma once
+#include "Core/Literals.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wallpaper
+{
+namespace thread_cpu
+{
+
+// cpu time of the phases a thread ran, the phases inside one aren't counted in it
+struct Phase {
+    std::string_view name;
+    u64              cpu_ns { 0 };
+    u64              count { 0 };
+};
+
+struct Usage {
+    std::string name;
+    u64         cpu_ns { 0 };
+    // context switches, a voluntary one is the thread blocking, each is a wakeup after
+    u64 voluntary { 0 };
+    u64 involuntary { 0 };
+    // the threads of the name that ended, summed, or the live one
+    bool ended { false };
+    std::vector<Phase> phases;
+};
+
+// the calling thread is accounted from now on under the name, a second call renames it. When
+// it ends its last numbers are kept, added to the ended threads of the name
+void registerThread(std::string_view name);
+
+// any thread, of the threads registered since the start or the last reset, which forgets the
+// ended ones and counts the live ones from then on
+std::vector<Usage> read(bool reset = false);
+
+// on a registered thread, the name a literal, phases nest a few deep, deeper ones aren't counted
+void phaseBegin(const char* name);
+void phaseEnd();
+
+} // namespace thread_cpu
+} // namespace wallpaper
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+
+namespace wallpaper
+{
+namespace platform
+{
+
+// what a thread does, the policy decides its priority and cores from it
+enum class ThreadClass : std::uint8_t
+{
+    // frames wait on it, the render looper and the frame timer
+    Frame,
+    // job workers kept for load jobs, nothing on screen waits on them right away
+    Load,
+    // the default priority on any core
+    Normal,
+};
+
+// Process wide, each thread applies it to itself with ApplyThreadClass. Raising a priority needs
+// rtprio or nice limits from the session, where they aren't given it's logged and left alone.
+struct ThreadPolicy {
+    // SCHED_RR for frame threads, or a lower nice if that's refused
+    bool boost_frame { false };
+    // job workers split off ones for load jobs, those run at SCHED_IDLE
+    bool idle_load { false };
+    // load threads only run on efficiency cores, if the cpus tell which those are
+    bool efficiency_cores { false };
+
+    bool operator==(const ThreadPolicy&) const = default;
+};
+
+void         SetThreadPolicy(const ThreadPolicy&);
+ThreadPolicy GetThreadPolicy();
+
+// the policy for the calling thread, cheap if it didn't change since the thread's last call
+void ApplyThreadClass(ThreadClass);
+
+} // namespace platform
+} // namespace wallpaper
@@ -0,0 +1,70 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+namespace wallpaper
+{
+namespace trace
+{
+
+// any thread, a capture runs from start to stop, a zone outside of one costs an atomic load
+void start();
+// writes the capture as chrome trace json, perfetto opens it too, false if none was running or
+// the file can't be written
+bool stop(const std::string& path);
+bool capturing();
+
+// of the calling thread in captures, its cpu time is accounted under it, see ThreadCpu.hpp
+void setThreadName(std::string_view);
+
+// The flight recorder, on while any caller started it and didn't stop it yet. The zones of every
+// thread then also go to a ring of the last ones of each thread, capture or not, and the zones
+// still open are known to other threads
+void startFlight();
+void stopFlight();
+bool flying();
+// the ring's zones that ended in the window before now and the open ones, up to now, as chrome
+// trace json, false if the file can't be written
+bool dumpFlight(const std::string& path, std::chrono::nanoseconds window);
+// a line for each thread in a zone, its name and the open zones outermost first with how long
+// each has been running, "render: frame 412.0 > drawFrame 411.8 > waitFence 411.5 ms"
+std::string openZones();
+
+// times its scope, the name must outlive the capture, a literal. A phase's cpu time is accounted
+// to its thread while a capture or the flight recorder runs
+class Zone : NoCopy, NoMove {
+public:
+    explicit Zone(const char* name, bool phase = false);
+    ~Zone();
+
+private:
+    const char* m_name;
+    bool        m_phase { false };
+    // ns, unset outside of a capture and the flight recorder
+    i64 m_begin { -1 };
+    // on the thread's open zones
+    bool m_open { false };
+};
+
+} // namespace trace
+} // namespace wallpaper
+
+#define WP_TRACE_CONCAT_(a, b) a##b
+#define WP_TRACE_CONCAT(a, b)  WP_TRACE_CONCAT_(a, b)
+// the few coarse zones a stall is told by, always built in
+#define TRACE_PHASE(name) \
+    const ::wallpaper::trace::Zone WP_TRACE_CONCAT(trace_phase_, __LINE__)(name, true)
+#define TRACE_THREAD(name) ::wallpaper::trace::setThreadName(name)
+
+// zones only exist with ENABLE_TRACE, without it they compile to nothing
+#if ENABLE_TRACE
+#    define TRACE_ZONE(name) \
+        const ::wallpaper::trace::Zone WP_TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#else
+#    define TRACE_ZONE(name) ((void)0)
+#endif
@@ -0,0 +1,358 @@
+#include "VideoDecoder.hpp"
+#include "Fs/IBinaryStream.h"
+#include "Utils/Logging.h"
+
+#if ENABLE_VIDEO
+extern "C" {
+#    include <libavcodec/avcodec.h>
+#    include <libavformat/avformat.h>
+#    include <libavutil/hwcontext.h>
+#    include <libavutil/hwcontext_drm.h>
+}
+
+#    include <algorithm>
+#    include <condition_variable>
+#    include <cstdio>
+#    include <deque>
+#    include <mutex>
+#    include <thread>
+#endif
+
+using namespace wallpaper::video;
+
+#if ENABLE_VIDEO
+namespace
+{
+using namespace wallpaper;
+
+// decoded ahead of the time asked for
+constexpr usize queue_size { 4 };
+// surfaces the decoder's pool has on top of the ones it decodes into, the queue, the frame shown
+// and the ones frames in flight sample
+constexpr int extra_surfaces { (int)queue_size + 4 };
+constexpr int io_buffer { 64 * 1024 };
+// of clips that don't tell their frame rate
+constexpr double default_frame_time { 1.0 / 30.0 };
+
+int ReadClip(void* opaque, uint8_t* buf, int size) {
+    auto& clip = *static_cast<fs::IBinaryStream*>(opaque);
+    usize n    = clip.Read(buf, (usize)size);
+    return n == 0 ? AVERROR_EOF : (int)n;
+}
+
+int64_t SeekClip(void* opaque, int64_t offset, int whence) {
+    auto& clip = *static_cast<fs::IBinaryStream*>(opaque);
+    bool  done { false };
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE: return clip.Size();
+    case SEEK_SET: done = clip.SeekSet((idx)offset); break;
+    case SEEK_CUR: done = clip.SeekCur((idx)offset); break;
+    case SEEK_END: done = clip.SeekEnd((idx)offset); break;
+    }
+    return done ? clip.Tell() : -1;
+}
+
+AVPixelFormat PickVaapi(AVCodecContext*, const AVPixelFormat* formats) {
+    for (auto* f = formats; *f != AV_PIX_FMT_NONE; f++) {
+        if (*f == AV_PIX_FMT_VAAPI) return *f;
+    }
+    LOG_ERROR("video decoder offers no va-api surfaces");
+    return AV_PIX_FMT_NONE;
+}
+
+bool DecodesWithVaapi(const AVCodec* codec) {
+    for (int i = 0;; i++) {
+        const AVCodecHWConfig* config = avcodec_get_hw_config(codec, i);
+        if (config == nullptr) return false;
+        if (config->device_type == AV_HWDEVICE_TYPE_VAAPI &&
+            (config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX))
+            return true;
+    }
+}
+
+// the frames stay with the dma-bufs, their surface goes back to the pool with them
+struct HeldFrame : DmaBufFrame {
+    AVFrame* hw { nullptr };
+    AVFrame* drm { nullptr };
+
+    ~HeldFrame() {
+        av_frame_free(&drm);
+        av_frame_free(&hw);
+    }
+};
+
+class VaapiDecoder : public VideoDecoder {
+public:
+    ~VaapiDecoder() override;
+
+    bool open(std::shared_ptr<fs::IBinaryStream>);
+
+    u32 width() const override { return m_width; }
+    u32 height() const override { return m_height; }
+    std::shared_ptr<const DmaBufFrame> frameAt(double time) override;
+
+private:
+    void run();
+    // the next packet of the stream to the decoder, at the end it's drained instead
+    bool feed();
+    // back to the first frame, the next loop's times go on from the end of this one
+    bool restart();
+    std::shared_ptr<const DmaBufFrame> map(const AVFrame&);
+
+    std::shared_ptr<fs::IBinaryStream> m_clip;
+    AVIOContext*                       m_io { nullptr };
+    AVFormatContext*                   m_format { nullptr };
+    AVCodecContext*                    m_codec { nullptr };
+    AVBufferRef*                       m_device { nullptr };
+    AVPacket*                          m_packet { nullptr };
+
+    int     m_stream { -1 };
+    u32     m_width { 0 };
+    u32     m_height { 0 };
+    double  m_time_base { 0.0 };
+    double  m_frame_time { default_frame_time };
+    int64_t m_start { 0 };
+    // of the decoding thread, where the loop started and the end of its latest frame, seconds
+    double m_loop_start { 0.0 };
+    double m_loop_end { 0.0 };
+
+    std::mutex                                     m_mutex;
+    std::condition_variable                        m_cv;
+    std::deque<std::shared_ptr<const DmaBufFrame>> m_queue;
+    std::shared_ptr<const DmaBufFrame>             m_current;
+    bool                                           m_stop { false };
+    std::thread                                    m_thread;
+};
+
+VaapiDecoder::~VaapiDecoder() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) m_thread.join();
+    // held frames keep the pool and the device by reference
+    m_queue.clear();
+    m_current.reset();
+    av_packet_free(&m_packet);
+    avcodec_free_context(&m_codec);
+    av_buffer_unref(&m_device);
+    avformat_close_input(&m_format);
+    if (m_io != nullptr) {
+        av_freep(&m_io->buffer);
+        avio_context_free(&m_io);
+    }
+}
+
+bool VaapiDecoder::open(std::shared_ptr<fs::IBinaryStream> clip) {
+    m_clip   = std::move(clip);
+    auto buf = static_cast<uint8_t*>(av_malloc(io_buffer));
+    if (buf == nullptr) return false;
+    m_io = avio_alloc_context(buf, io_buffer, 0, m_clip.get(), ReadClip, nullptr, SeekClip);
+    if (m_io == nullptr) {
+        av_free(buf);
+        return false;
+    }
+    m_format = avformat_alloc_context();
+    if (m_format == nullptr) return false;
+    m_format->pb = m_io;
+    m_format->flags |= AVFMT_FLAG_CUSTOM_IO;
+    // frees the context if it fails
+    if (avformat_open_input(&m_format, nullptr, nullptr, nullptr) < 0) {
+        LOG_ERROR("video clip can't be opened");
+        return false;
+    }
+    if (avformat_find_stream_info(m_format, nullptr) < 0) return false;
+
+    const AVCodec* codec { nullptr };
+    m_stream = av_find_best_stream(m_format, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (m_stream < 0 || codec == nullptr) {
+        LOG_ERROR("video clip has no stream that can be decoded");
+        return false;
+    }
+    if (! DecodesWithVaapi(codec)) {
+        LOG_INFO("no va-api decoding of %s video", codec->name);
+        return false;
+    }
+    if (av_hwdevice_ctx_create(&m_device, AV_HWDEVICE_TYPE_VAAPI, nullptr, nullptr, 0) < 0) {
+        LOG_INFO("no va-api device for video decoding");
+        return false;
+    }
+
+    const AVStream* stream = m_format->streams[m_stream];
+    m_codec                = avcodec_alloc_context3(codec);
+    if (m_codec == nullptr || avcodec_parameters_to_context(m_codec, stream->codecpar) < 0)
+        return false;
+    m_codec->hw_device_ctx   = av_buffer_ref(m_device);
+    m_codec->get_format      = PickVaapi;
+    m_codec->extra_hw_frames = extra_surfaces;
+    if (avcodec_open2(m_codec, codec, nullptr) < 0) {
+        LOG_ERROR("open %s video decoder failed", codec->name);
+        return false;
+    }
+    m_packet = av_packet_alloc();
+    if (m_packet == nullptr) return false;
+
+    m_width     = (u32)stream->codecpar->width;
+    m_height    = (u32)stream->codecpar->height;
+    m_time_base = av_q2d(stream->time_base);
+    m_start     = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    if (stream->avg_frame_rate.num > 0 && stream->avg_frame_rate.den > 0)
+        m_frame_time = av_q2d(av_inv_q(stream->avg_frame_rate));
+    LOG_INFO("video clip %ux%u of %s decoded with va-api", m_width, m_height, codec->name);
+
+    m_thread = std::thread([this]() {
+        run();
+    });
+    return true;
+}
+
+std::shared_ptr<const DmaBufFrame> VaapiDecoder::frameAt(double time) {
+    std::lock_guard lock(m_mutex);
+    bool            taken { false };
+    while (! m_queue.empty() && m_queue.front()->time <= time) {
+        m_current = std::move(m_queue.front());
+        m_queue.pop_front();
+        taken = true;
+    }
+    if (taken) m_cv.notify_one();
+    // the first frame shows until the second is due
+    if (! m_current && ! m_queue.empty()) return m_queue.front();
+    return m_current;
+}
+
+void VaapiDecoder::run() {
+    AVFrame* frame = av_frame_alloc();
+    usize    loop_frames { 0 };
+    while (frame != nullptr) {
+        {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [this]() {
+                return m_stop || m_queue.size() < queue_size;
+            });
+            if (m_stop) break;
+        }
+        int res = avcodec_receive_frame(m_codec, frame);
+        if (res == AVERROR(EAGAIN)) {
+            if (! feed()) break;
+            continue;
+        }
+        if (res == AVERROR_EOF) {
+            if (loop_frames == 0) {
+                LOG_ERROR("video clip decoded to no frame");
+                break;
+            }
+            loop_frames = 0;
+            if (! restart()) break;
+            continue;
+        }
+        if (res < 0) {
+            LOG_ERROR("decode video frame failed: %d", res);
+            break;
+        }
+        loop_frames++;
+        auto out = map(*frame);
+        av_frame_unref(frame);
+        if (! out) break;
+
+        std::lock_guard lock(m_mutex);
+        m_queue.push_back(std::move(out));
+    }
+    av_frame_free(&frame);
+}
+
+bool VaapiDecoder::feed() {
+    while (true) {
+        if (av_read_frame(m_format, m_packet) < 0) {
+            int res = avcodec_send_packet(m_codec, nullptr);
+            return res >= 0 || res == AVERROR_EOF;
+        }
+        if (m_packet->stream_index != m_stream) {
+            av_packet_unref(m_packet);
+            continue;
+        }
+        int res = avcodec_send_packet(m_codec, m_packet);
+        av_packet_unref(m_packet);
+        if (res < 0 && res != AVERROR(EAGAIN)) {
+            LOG_ERROR("send video packet failed: %d", res);
+            return false;
+        }
+        return true;
+    }
+}
+
+bool VaapiDecoder::restart() {
+    m_loop_start = m_loop_end;
+    if (av_seek_frame(m_format, m_stream, m_start, AVSEEK_FLAG_BACKWARD) < 0) {
+        LOG_ERROR("seek video clip back failed, it stops");
+        return false;
+    }
+    avcodec_flush_buffers(m_codec);
+    return true;
+}
+
+std::shared_ptr<const DmaBufFrame> VaapiDecoder::map(const AVFrame& frame) {
+    double time = m_loop_end;
+    if (frame.best_effort_timestamp != AV_NOPTS_VALUE)
+        time = m_loop_start + (double)(frame.best_effort_timestamp - m_start) * m_time_base;
+#    if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 30, 100)
+    const int64_t duration = frame.duration;
+#    else
+    const int64_t duration = frame.pkt_duration;
+#    endif
+    m_loop_end = std::max(m_loop_end,
+                          time + (duration > 0 ? (double)duration * m_time_base : m_frame_time));
+
+    auto out = std::make_shared<HeldFrame>();
+    out->hw  = av_frame_clone(&frame);
+    out->drm = av_frame_alloc();
+    if (out->hw == nullptr || out->drm == nullptr) return nullptr;
+    out->drm->format = AV_PIX_FMT_DRM_PRIME;
+    // waits for the surface, what the fds point to is decoded
+    if (int res = av_hwframe_map(out->drm, out->hw, AV_HWFRAME_MAP_READ); res < 0) {
+        LOG_ERROR("video frame can't be handed out as a dma-buf: %d", res);
+        return nullptr;
+    }
+    auto* desc = reinterpret_cast<const AVDRMFrameDescriptor*>(out->drm->data[0]);
+    // va-api exports separate layers, one plane each, composed ones need a ycbcr sampler
+    if (desc->nb_layers != (int)out->planes.size()) {
+        LOG_ERROR("video frames of %d layers can't be sampled", desc->nb_layers);
+        return nullptr;
+    }
+    for (usize i = 0; i < out->planes.size(); i++) {
+        auto& layer = desc->layers[i];
+        if (layer.nb_planes != 1) return nullptr;
+        auto& plane    = layer.planes[0];
+        auto& object   = desc->objects[plane.object_index];
+        out->planes[i] = DmaBufFrame::Plane {
+            .drm_format  = layer.format,
+            .fd          = object.fd,
+            .modifier    = object.format_modifier,
+            .offset      = (usize)plane.offset,
+            .pitch       = (usize)plane.pitch,
+            .object_size = object.size,
+        };
+    }
+    out->width      = (u32)frame.width;
+    out->height     = (u32)frame.height;
+    out->bt709      = frame.colorspace == AVCOL_SPC_BT709 ||
+                 (frame.colorspace == AVCOL_SPC_UNSPECIFIED && frame.height > 576);
+    out->full_range = frame.color_range == AVCOL_RANGE_JPEG;
+    out->time       = time;
+    return out;
+}
+} // namespace
+#endif
+
+std::unique_ptr<VideoDecoder>
+wallpaper::video::CreateVideoDecoder(std::shared_ptr<fs::IBinaryStream> clip) {
+#if ENABLE_VIDEO
+    if (! clip) return nullptr;
+    auto decoder = std::make_unique<VaapiDecoder>();
+    if (! decoder->open(std::move(clip))) return nullptr;
+    return decoder;
+#else
+    (void)clip;
+    return nullptr;
+#endif
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <memory>
+
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+namespace wallpaper
+{
+namespace fs
+{
+class IBinaryStream;
+}
+namespace video
+{
+
+// A decoded frame as dma-bufs of the decoder's memory, good while the frame is held. Each plane
+// is a layer of its own, luma and the interleaved chroma of nv12 or p010.
+struct DmaBufFrame {
+    struct Plane {
+        // of the layer, DRM_FORMAT_R8, GR88, R16 or GR1616
+        u32   drm_format { 0 };
+        int   fd { -1 };
+        u64   modifier { 0 };
+        usize offset { 0 };
+        usize pitch { 0 };
+        // of the whole dma-buf the plane is in, 0 if not known
+        usize object_size { 0 };
+    };
+    u32                  width { 0 };
+    u32                  height { 0 };
+    std::array<Plane, 2> planes {};
+    // bt.709 rather than bt.601 colors, full rather than limited range
+    bool bt709 { false };
+    bool full_range { false };
+    // seconds since the start of the first loop
+    double time { 0.0 };
+};
+
+// Plays a clip in a loop with a va-api decoder, on a thread of its own that stays a few frames
+// ahead of the time asked for. Frames are handed out as dma-bufs, no pixel goes through the cpu.
+class VideoDecoder : NoCopy, NoMove {
+public:
+    virtual ~VideoDecoder() = default;
+
+    virtual u32 width() const  = 0;
+    virtual u32 height() const = 0;
+    // the last frame due at time seconds, null if none is decoded yet. Frames that are past are
+    // given back to the decoder once nobody holds them
+    virtual std::shared_ptr<const DmaBufFrame> frameAt(double time) = 0;
+
+protected:
+    VideoDecoder() = default;
+};
+
+// null if the clip can't be opened or no va-api device decodes its codec, always without
+// ENABLE_VIDEO
+std::unique_ptr<VideoDecoder> CreateVideoDecoder(std::shared_ptr<fs::IBinaryStream> clip);
+
+} // namespace video
+} // namespace wallpaper
@@ -1,8 +1,15 @@
 #include "Device.hpp"
+#include "DeviceCache.hpp"
 
 #include "Utils/Logging.h"
 #include "GraphicsPipeline.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <optional>
+
 using namespace wallpaper::vulkan;
 
 namespace
@@ -16,9 +23,27 @@ void EnumateDeviceExts(const vvk::PhysicalDevice& gpu, wallpaper::Set<std::strin
     }
 }
 
+// the lowest of the limits on combined image samplers in update after bind sets
+u32 UpdateAfterBindImages(const vvk::PhysicalDevice& gpu) {
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT,
+        .pNext = nullptr
+    };
+    VkPhysicalDeviceProperties2KHR props {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR, .pNext = &indexing
+    };
+    gpu.GetProperties2KHR(props);
+    return std::min({ indexing.maxPerStageDescriptorUpdateAfterBindSamplers,
+                      indexing.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                      indexing.maxPerStageUpdateAfterBindResources,
+                      indexing.maxDescriptorSetUpdateAfterBindSamplers,
+                      indexing.maxDescriptorSetUpdateAfterBindSampledImages });
+}
+
 } // namespace
 
-bool Device::CheckGPU(vvk::PhysicalDevice gpu, std::span<const Extension> exts, VkSurfaceKHR surface) {
+bool Device::CheckGPU(vvk::PhysicalDevice gpu, std::span<const Extension> exts,
+                      VkSurfaceKHR surface, const Set<std::string>* known_exts) {
     std::vector<VkDeviceQueueCreateInfo> queues;
     auto                                 props = gpu.GetQueueFamilyProperties();
 
@@ -40,10 +65,10 @@ bool Device::CheckGPU(vvk::PhysicalDevice gpu, std::span<const Extension> exts,
 
     // check exts
     Set<std::string> extensions;
-    EnumateDeviceExts(gpu, extensions);
+    if (known_exts == nullptr) EnumateDeviceExts(gpu, extensions);
     for (auto& ext : exts) {
         if (ext.required) {
-            if (! exists(extensions, ext.name)) return false;
+            if (! exists(known_exts ? *known_exts : extensions, ext.name)) return false;
         }
     }
     return true;
@@ -52,7 +77,7 @@ bool Device::CheckGPU(vvk::PhysicalDevice gpu, std::span<const Extension> exts,
 std::vector<VkDeviceQueueCreateInfo> Device::ChooseDeviceQueue(VkSurfaceKHR surface) {
     std::vector<VkDeviceQueueCreateInfo> queues;
 
-    auto props = m_gpu.GetQueueFamilyProperties();
+    auto props = m_core->gpu.GetQueueFamilyProperties();
 
     std::vector<uint32_t> graphic_indexs, present_indexs;
     uint32_t              index = 0;
@@ -60,51 +85,114 @@ std::vector<VkDeviceQueueCreateInfo> Device::ChooseDeviceQueue(VkSurfaceKHR surf
         if (prop.queueFlags & VK_QUEUE_GRAPHICS_BIT) graphic_indexs.push_back(index);
         index++;
     };
-    m_graphics_queue.family_index           = graphic_indexs.front();
+    m_core->graphics_queue.family_index     = graphic_indexs.front();
     const static float defaultQueuePriority = 0.0f;
     {
         VkDeviceQueueCreateInfo info {
             .sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-            .queueFamilyIndex = m_graphics_queue.family_index,
+            .queueFamilyIndex = m_core->graphics_queue.family_index,
             .queueCount       = 1,
             .pQueuePriorities = &defaultQueuePriority,
         };
         queues.push_back(info);
     }
-    m_present_queue.family_index = graphic_indexs.front();
+    m_core->transfer_queue.family_index = graphic_indexs.front();
+    {
+        // prefer a transfer only family, usually the copy engine
+        std::optional<uint32_t> transfer_index;
+        index = 0;
+        for (auto& prop : props) {
+            if ((prop.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                ! (prop.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                if (! transfer_index || ! (prop.queueFlags & VK_QUEUE_COMPUTE_BIT))
+                    transfer_index = index;
+            }
+            index++;
+        };
+        if (transfer_index) {
+            m_core->transfer_queue.family_index = transfer_index.value();
+            VkDeviceQueueCreateInfo info {
+                .sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .queueFamilyIndex = m_core->transfer_queue.family_index,
+                .queueCount       = 1,
+                .pQueuePriorities = &defaultQueuePriority,
+            };
+            queues.push_back(info);
+        }
+    }
+    m_core->compute_queue.family_index = graphic_indexs.front();
+    {
+        // a compute family without graphics runs beside it, one apart from uploads if there is
+        std::optional<uint32_t> compute_index;
+        index = 0;
+        for (auto& prop : props) {
+            if ((prop.queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+                ! (prop.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                if (! compute_index ||
+                    (compute_index == m_core->transfer_queue.family_index &&
+                     index != m_core->transfer_queue.family_index))
+                    compute_index = index;
+            }
+            index++;
+        };
+        if (compute_index) {
+            m_core->compute_queue.family_index = compute_index.value();
+            VkDeviceQueueCreateInfo info {
+                .sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .queueFamilyIndex = m_core->compute_queue.family_index,
+                .queueCount       = 1,
+                .pQueuePriorities = &defaultQueuePriority,
+            };
+            // the upload queue is shared then
+            if (m_core->compute_queue.family_index != m_core->transfer_queue.family_index)
+                queues.push_back(info);
+        }
+    }
+    m_core->present_queue.family_index = graphic_indexs.front();
     if (surface) {
         index = 0;
         for (auto& prop : props) {
             bool ok { false };
-            VVK_CHECK(m_gpu.GetSurfaceSupportKHR(index, surface, ok))
+            VVK_CHECK(m_core->gpu.GetSurfaceSupportKHR(index, surface, ok))
             if (ok) present_indexs.push_back(index);
             index++;
         };
         if (present_indexs.empty()) {
             LOG_ERROR("not find present queue");
         } else if (graphic_indexs.front() != present_indexs.front()) {
-            m_present_queue.family_index = present_indexs.front();
+            m_core->present_queue.family_index = present_indexs.front();
             VkDeviceQueueCreateInfo info {
                 .sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-                .queueFamilyIndex = m_present_queue.family_index,
+                .queueFamilyIndex = m_core->present_queue.family_index,
                 .queueCount       = 1,
                 .pQueuePriorities = &defaultQueuePriority,
             };
-            queues.push_back(info);
+            // one create info per family
+            if (m_core->present_queue.family_index != m_core->transfer_queue.family_index &&
+                m_core->present_queue.family_index != m_core->compute_queue.family_index)
+                queues.push_back(info);
         }
     }
     return queues;
 }
 
-bool Device::Create(Instance& inst, std::span<const Extension> exts, VkExtent2D extent, Device& device) {
-    device.dld      = vvk::DeviceDispatch { inst.inst().Dispatch() };
-    device.m_gpu    = inst.gpu();
-    device.m_limits = inst.gpu().GetProperties().limits;
+bool Device::Create(std::shared_ptr<Instance> pinst, std::span<const Extension> exts,
+                    VkExtent2D extent, const Swapchain::Options& swap_options, Device& device,
+                    const DeviceCache* cached) {
+    auto& inst    = *pinst;
+    auto& core    = *device.m_core;
+    core.instance = std::move(pinst);
+    core.dld      = vvk::DeviceDispatch { inst.inst().Dispatch() };
+    core.gpu      = inst.gpu();
+    core.limits   = inst.gpu().GetProperties().limits;
     device.set_out_extent(extent);
 
     Set<std::string> tested_exts;
     {
-        EnumateDeviceExts(inst.gpu(), device.m_extensions);
+        if (cached != nullptr)
+            core.extensions = cached->device_exts;
+        else
+            EnumateDeviceExts(inst.gpu(), core.extensions);
         for (auto& ext : exts) {
             bool ok = device.supportExt(ext.name);
             if (ok) tested_exts.insert(std::string(ext.name));
@@ -121,53 +209,274 @@ bool Device::Create(Instance& inst, std::span<const Extension> exts, VkExtent2D
             return s.c_str();
         });
     bool rq_surface = ! inst.offscreen();
-    VVK_CHECK_BOOL_RE(vvk::Device::Create(device.m_device,
-                                          *device.m_gpu,
+
+    // ids on presents and waits for them, frames are paced from when they were shown
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR, .pNext = nullptr
+    };
+    VkPhysicalDevicePresentIdFeaturesKHR present_id {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR, .pNext = &present_wait
+    };
+    // passes render to image views, no render pass or framebuffer objects
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+        .pNext = nullptr,
+    };
+    // a sampler array indexed by a uniform, written while frames using it are in flight
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+        .pNext = nullptr,
+    };
+    // and the core feature it takes, chained too as the device is made without pEnabledFeatures
+    VkPhysicalDeviceFeatures2KHR indexing_core {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR, .pNext = nullptr
+    };
+    const bool ask_present_wait = rq_surface &&
+                                  exists(tested_exts, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+                                  exists(tested_exts, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    // the extensions it needs on 1.1
+    const bool ask_dynamic_rendering =
+        exists(tested_exts, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+        exists(tested_exts, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) &&
+        exists(tested_exts, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+    const bool ask_descriptor_indexing =
+        exists(tested_exts, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+        exists(tested_exts, VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+    if (cached != nullptr) {
+        core.present_wait                  = ask_present_wait && cached->present_wait;
+        core.dynamic_rendering             = ask_dynamic_rendering && cached->dynamic_rendering;
+        present_id.presentId               = VK_TRUE;
+        present_wait.presentWait           = VK_TRUE;
+        dynamic_rendering.dynamicRendering = VK_TRUE;
+
+        core.descriptor_indexing = ask_descriptor_indexing && cached->descriptor_indexing;
+    } else if (ask_present_wait || ask_dynamic_rendering || ask_descriptor_indexing) {
+        VkPhysicalDeviceFeatures2KHR features {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR, .pNext = nullptr
+        };
+        if (ask_dynamic_rendering) features.pNext = &dynamic_rendering;
+        if (ask_descriptor_indexing) {
+            descriptor_indexing.pNext = features.pNext;
+            features.pNext            = &descriptor_indexing;
+        }
+        if (ask_present_wait) {
+            present_wait.pNext = features.pNext;
+            features.pNext     = &present_id;
+        }
+        core.gpu.GetFeatures2KHR(features);
+        core.present_wait =
+            ask_present_wait && present_id.presentId && present_wait.presentWait;
+        core.dynamic_rendering = ask_dynamic_rendering && dynamic_rendering.dynamicRendering;
+        core.descriptor_indexing =
+            ask_descriptor_indexing && features.features.shaderSampledImageArrayDynamicIndexing &&
+            descriptor_indexing.descriptorBindingPartiallyBound &&
+            descriptor_indexing.descriptorBindingSampledImageUpdateAfterBind &&
+            descriptor_indexing.descriptorBindingUpdateUnusedWhilePending;
+    }
+    if (core.descriptor_indexing) {
+        // the features of it used, the rest stay off
+        descriptor_indexing = VkPhysicalDeviceDescriptorIndexingFeaturesEXT {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+            .pNext = nullptr,
+            .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+            .descriptorBindingUpdateUnusedWhilePending    = VK_TRUE,
+            .descriptorBindingPartiallyBound              = VK_TRUE,
+        };
+        indexing_core.features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+        core.update_after_bind_images = UpdateAfterBindImages(core.gpu);
+    }
+    // only what is used, chained the same way
+    void* features_next { nullptr };
+    dynamic_rendering.pNext = nullptr;
+    if (core.dynamic_rendering) features_next = &dynamic_rendering;
+    if (core.descriptor_indexing) {
+        descriptor_indexing.pNext = features_next;
+        indexing_core.pNext       = &descriptor_indexing;
+        features_next             = &indexing_core;
+    }
+    if (core.present_wait) {
+        present_wait.pNext = features_next;
+        features_next      = &present_id;
+    }
+    VVK_CHECK_BOOL_RE(vvk::Device::Create(core.device,
+                                          *core.gpu,
                                           device.ChooseDeviceQueue(*inst.surface()),
                                           tested_exts_c,
-                                          nullptr,
-                                          device.dld));
-
-    // VK_CHECK_RESULT_BOOL_RE(CreateDevice(inst, device.ChooseDeviceQueue(inst.surface()),
-    // tested_exts_c, &device.m_device));
+                                          features_next,
+                                          core.dld));
+    if (core.present_wait) LOG_INFO("present wait enabled");
+    if (core.dynamic_rendering) LOG_INFO("dynamic rendering enabled");
+    if (core.descriptor_indexing)
+        LOG_INFO("descriptor indexing enabled, %u images after bind",
+                 core.update_after_bind_images);
+    core.dma_buf = exists(tested_exts, VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME) &&
+                   exists(tested_exts, VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME) &&
+                   exists(tested_exts, VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME);
+    if (core.dma_buf) LOG_INFO("dma-buf export enabled");
 
-    device.m_graphics_queue.handle = device.m_device.GetQueue(device.m_graphics_queue.family_index);
-    device.m_present_queue.handle  = device.m_device.GetQueue(device.m_present_queue.family_index);
+    core.graphics_queue.handle = core.device.GetQueue(core.graphics_queue.family_index);
+    core.present_queue.handle  = core.device.GetQueue(core.present_queue.family_index);
+    core.transfer_queue.handle = core.device.GetQueue(core.transfer_queue.family_index);
+    if (core.transfer_queue.family_index != core.graphics_queue.family_index) {
+        LOG_INFO("use transfer queue family %d for uploads", core.transfer_queue.family_index);
+    }
+    core.compute_queue.handle = core.device.GetQueue(core.compute_queue.family_index);
+    if (core.compute_queue.family_index != core.graphics_queue.family_index) {
+        LOG_INFO("use compute queue family %d for async compute", core.compute_queue.family_index);
+    }
 
     if (rq_surface) {
-        if (! Swapchain::Create(device, *inst.surface(), extent, device.m_swapchain)) {
+        device.m_swap_options = swap_options;
+        if (! Swapchain::Create(
+                device, *inst.surface(), extent, swap_options, device.m_swapchain)) {
             LOG_ERROR("create swapchain failed");
             return false;
         }
     }
+    if (! device.CreatePools()) return false;
     {
-        VkCommandPoolCreateInfo info { .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-                                       .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
-                                                VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-                                       .queueFamilyIndex = device.m_graphics_queue.family_index };
-        VVK_CHECK_BOOL_RE(device.m_device.CreateCommandPool(info, device.m_command_pool));
+        // empty, filled by MergePipelineCache once a cache dir is known
+        VkPipelineCacheCreateInfo info { .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                                         .pNext = nullptr,
+                                         .flags = 0,
+                                         .initialDataSize = 0,
+                                         .pInitialData    = nullptr };
+        VVK_CHECK_BOOL_RE(core.device.CreatePipelineCache(info, core.pipeline_cache));
     }
     {
         VmaAllocatorCreateInfo allocatorInfo = {};
         allocatorInfo.vulkanApiVersion       = WP_VULKAN_VERSION;
-        allocatorInfo.physicalDevice         = *device.m_gpu;
-        allocatorInfo.device                 = *device.m_device;
+        allocatorInfo.physicalDevice         = *core.gpu;
+        allocatorInfo.device                 = *core.device;
         allocatorInfo.instance               = *inst.inst();
-        VVK_CHECK_BOOL_RE(vvk::CreateVmaAllocator(allocatorInfo, device.m_allocator));
+        if (exists(tested_exts, std::string_view(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)))
+            allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+        VVK_CHECK_BOOL_RE(vvk::CreateVmaAllocator(allocatorInfo, core.allocator));
     }
     device.m_tex_cache = std::make_unique<TextureCache>(device);
     return true;
 }
 
+bool Device::CreateShared(std::shared_ptr<Core> core, VkExtent2D extent, Device& device) {
+    // an offscreen device, there's no swapchain to make
+    assert(core && core->device);
+    device.m_core = std::move(core);
+    device.set_out_extent(extent);
+    if (! device.CreatePools()) return false;
+    device.m_tex_cache = std::make_unique<TextureCache>(device);
+    return true;
+}
+
+bool Device::CreatePools() {
+    VkCommandPoolCreateInfo info { .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                                   .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                                            VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                                   .queueFamilyIndex = m_core->graphics_queue.family_index };
+    VVK_CHECK_BOOL_RE(m_core->device.CreateCommandPool(info, m_command_pool));
+
+    info.queueFamilyIndex = m_core->transfer_queue.family_index;
+    VVK_CHECK_BOOL_RE(m_core->device.CreateCommandPool(info, m_transfer_command_pool));
+
+    info.queueFamilyIndex = m_core->compute_queue.family_index;
+    VVK_CHECK_BOOL_RE(m_core->device.CreateCommandPool(info, m_compute_command_pool));
+    return true;
+}
+
+VkResult Device::Submit(const QueueParameters& queue, vvk::Span<const VkSubmitInfo> infos,
+                        VkFence fence) const {
+    std::lock_guard lock(m_core->queue_lock);
+    return queue.handle.Submit(infos, fence);
+}
+
+VkResult Device::WaitIdle() const {
+    std::lock_guard lock(m_core->queue_lock);
+    return m_core->device.WaitIdle();
+}
+
 VkDeviceSize Device::GetUsage() const {
     VmaBudget budget;
-    vmaGetHeapBudgets(*m_allocator, &budget);
+    vmaGetHeapBudgets(*m_core->allocator, &budget);
     return budget.usage;
 }
 
-void Device::Destroy() { VVK_CHECK(m_device.WaitIdle()); }
+VkDeviceSize Device::GetBudget() const {
+    const VkPhysicalDeviceMemoryProperties* props { nullptr };
+    vmaGetMemoryProperties(*m_core->allocator, &props);
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets {};
+    vmaGetHeapBudgets(*m_core->allocator, budgets.data());
+
+    VkDeviceSize left { 0 };
+    for (u32 i = 0; i < props->memoryHeapCount; i++) {
+        if (! (props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) continue;
+        if (budgets[i].budget > budgets[i].usage) left += budgets[i].budget - budgets[i].usage;
+    }
+    return left;
+}
+
+void Device::GetHeapBudget(VkDeviceSize& usage, VkDeviceSize& budget) const {
+    const VkPhysicalDeviceMemoryProperties* props { nullptr };
+    vmaGetMemoryProperties(*m_core->allocator, &props);
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets {};
+    vmaGetHeapBudgets(*m_core->allocator, budgets.data());
+
+    usage  = 0;
+    budget = 0;
+    for (u32 i = 0; i < props->memoryHeapCount; i++) {
+        if (! (props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) continue;
+        usage += budgets[i].usage;
+        budget += budgets[i].budget;
+    }
+}
+
+void Device::SetFrameIndex(u32 index) const { vmaSetCurrentFrameIndex(*m_core->allocator, index); }
+
+bool Device::MergePipelineCache(std::span<const uint8_t> data) const {
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header)) return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    auto props = m_core->gpu.GetProperties();
+    if (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        header.vendorID != props.vendorID || header.deviceID != props.deviceID ||
+        std::memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        LOG_INFO("pipeline cache is from another driver, ignored");
+        return false;
+    }
+
+    vvk::PipelineCache        cache;
+    VkPipelineCacheCreateInfo info { .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                                     .pNext = nullptr,
+                                     .flags = 0,
+                                     .initialDataSize = data.size(),
+                                     .pInitialData    = data.data() };
+    VVK_CHECK_BOOL_RE(m_core->device.CreatePipelineCache(info, cache));
+    VVK_CHECK_BOOL_RE(m_core->pipeline_cache.Merge(*cache));
+    return true;
+}
+
+bool Device::GetPipelineCacheData(std::vector<uint8_t>& data) const {
+    VVK_CHECK_BOOL_RE(m_core->pipeline_cache.GetData(data));
+    return true;
+}
+
+void Device::Destroy() { VVK_CHECK(WaitIdle()); }
+
+bool Device::RecreateSwapchain(VkSurfaceKHR surface, VkExtent2D extent) {
+    Swapchain swap;
+    if (! Swapchain::Create(*this, surface, extent, m_swap_options, swap, *m_swapchain.handle())) {
+        LOG_ERROR("recreate swapchain failed");
+        return false;
+    }
+    m_swapchain = std::move(swap);
+    // the surface may clamp it
+    set_out_extent(m_swapchain.extent());
+    return true;
+}
 
-Device::Device(): m_tex_cache(std::make_unique<TextureCache>(*this)) {}
+Device::Device()
+    : m_core(std::make_shared<Core>()),
+      m_tex_cache(std::make_unique<TextureCache>(*this)),
+      m_pipelines(std::make_unique<PipelineRegistry>()) {}
 Device::~Device() {};
 
-bool Device::supportExt(std::string_view name) const { return exists(m_extensions, name); }
+bool Device::supportExt(std::string_view name) const { return exists(m_core->extensions, name); }
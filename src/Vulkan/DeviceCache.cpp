@@ -0,0 +1,125 @@
+#include "DeviceCache.hpp"
+#include "Device.hpp"
+
+#include "Utils/Logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace wallpaper::vulkan;
+namespace sfs = std::filesystem;
+
+namespace
+{
+constexpr std::string_view cache_version { "VKD2" };
+
+void WriteSet(std::ostream& out, std::string_view name, const wallpaper::Set<std::string>& set) {
+    out << name;
+    for (auto& s : set) out << ' ' << s;
+    out << '\n';
+}
+
+bool ReadSet(std::istream& in, std::string_view name, wallpaper::Set<std::string>& set) {
+    std::string line;
+    if (! std::getline(in, line)) return false;
+    std::istringstream words(line);
+    std::string        word;
+    if (! (words >> word) || word != name) return false;
+    set.clear();
+    while (words >> word) set.insert(word);
+    return true;
+}
+} // namespace
+
+DeviceCache DeviceCache::Of(const Device& device, std::string key) {
+    DeviceCache cache;
+    cache.key = std::move(key);
+
+    auto& inst        = *device.core()->instance;
+    cache.inst_exts   = inst.extensions();
+    cache.inst_layers = inst.layers();
+
+    VkPhysicalDeviceIDProperties id_props {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES, .pNext = nullptr
+    };
+    VkPhysicalDeviceProperties2 props2 { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+                                         .pNext = &id_props };
+    device.gpu().GetProperties2KHR(props2);
+    std::copy_n(id_props.deviceUUID, VK_UUID_SIZE, cache.gpu_uuid.begin());
+    cache.driver_version = props2.properties.driverVersion;
+
+    cache.device_exts         = device.core()->extensions;
+    cache.present_wait        = device.present_wait();
+    cache.dynamic_rendering   = device.dynamic_rendering();
+    cache.descriptor_indexing = device.descriptor_indexing();
+    return cache;
+}
+
+bool DeviceCache::matches(std::span<const u8> uuid, u32 version) const {
+    return version == driver_version && std::equal(uuid.begin(), uuid.end(), gpu_uuid.begin(),
+                                                   gpu_uuid.end());
+}
+
+bool DeviceCache::Load(const sfs::path& path, std::string_view want_key) {
+    std::ifstream file(path);
+    if (! file.is_open()) return false;
+
+    // version, key, the sets of a line each, then the gpu and what its device got
+    std::string line;
+    if (! std::getline(file, line) || line != cache_version) return false;
+    if (! std::getline(file, key) || key != want_key) return false;
+    if (! ReadSet(file, "inst_exts", inst_exts) || ! ReadSet(file, "inst_layers", inst_layers) ||
+        ! ReadSet(file, "device_exts", device_exts))
+        return false;
+
+    std::string name, uuid;
+    int         wait { 0 }, dynamic { 0 }, indexing { 0 };
+    if (! (file >> name >> uuid >> driver_version >> wait >> dynamic >> indexing) ||
+        name != "gpu" || uuid.size() != gpu_uuid.size() * 2)
+        return false;
+    for (usize i = 0; i < gpu_uuid.size(); i++) {
+        unsigned byte { 0 };
+        if (std::sscanf(uuid.c_str() + i * 2, "%2x", &byte) != 1) return false;
+        gpu_uuid[i] = (u8)byte;
+    }
+    present_wait        = wait != 0;
+    dynamic_rendering   = dynamic != 0;
+    descriptor_indexing = indexing != 0;
+    return true;
+}
+
+bool DeviceCache::Save(const sfs::path& path) const {
+    static std::atomic<u32> counter { 0 };
+
+    auto tmp = path;
+    tmp += "." + std::to_string(::getpid()) + "." + std::to_string(counter++) + ".tmp";
+    bool written { false };
+    {
+        std::ofstream file(tmp, std::fstream::out | std::fstream::trunc);
+        if (! file.is_open()) return false;
+        file << cache_version << '\n' << key << '\n';
+        WriteSet(file, "inst_exts", inst_exts);
+        WriteSet(file, "inst_layers", inst_layers);
+        WriteSet(file, "device_exts", device_exts);
+
+        char uuid[VK_UUID_SIZE * 2 + 1] { '\0' };
+        for (usize i = 0; i < gpu_uuid.size(); i++)
+            std::snprintf(uuid + i * 2, 3, "%02x", gpu_uuid[i]);
+        file << "gpu " << uuid << ' ' << driver_version << ' ' << (int)present_wait << ' '
+             << (int)dynamic_rendering << ' ' << (int)descriptor_indexing << '\n';
+        file.flush();
+        written = file.good();
+    }
+    std::error_code ec;
+    if (written) sfs::rename(tmp, path, ec);
+    if (! written || ec) {
+        LOG_ERROR("can't write vulkan device cache \'%s\'", path.c_str());
+        sfs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
@@ -4,8 +4,11 @@
 #include "TextureCache.hpp"
 #include "Utils/Logging.h"
 #include "Utils/AutoDeletor.hpp"
+#include "Utils/Counters.hpp"
 #include "vvk/vulkan_wrapper.hpp"
 #include <cstdint>
+#include <string_view>
+#include <type_traits>
 
 using namespace wallpaper::vulkan;
 
@@ -18,6 +21,7 @@ inline VkShaderStageFlagBits ToVkType(wallpaper::ShaderType stage) {
     case ShaderType::VERTEX: return VK_SHADER_STAGE_VERTEX_BIT;
     case ShaderType::FRAGMENT: return VK_SHADER_STAGE_FRAGMENT_BIT;
     case ShaderType::GEOMETRY: return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case ShaderType::COMPUTE: return VK_SHADER_STAGE_COMPUTE_BIT;
     default: assert(false); return VK_SHADER_STAGE_VERTEX_BIT;
     }
 }
@@ -36,8 +40,34 @@ inline std::optional<vvk::ShaderModule> CreateShaderModule(const vvk::Device& de
     return sm;
 }
 
+template<typename T>
+void Append(std::string& key, const T& v) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    key.append((const char*)&v, sizeof(T));
+}
 } // namespace
 
+std::shared_ptr<PipelineRegistry::Entry> PipelineRegistry::acquire(const std::string& key,
+                                                                   bool&              made) {
+    std::unique_lock lock(m_lock);
+    if (auto it = m_entries.find(key); it != m_entries.end()) {
+        if (auto entry = it->second.lock(); entry) {
+            made = false;
+            m_shared++;
+            counters::Add(counters::Counter::PipelineHits);
+            return entry;
+        }
+    }
+    std::erase_if(m_entries, [](const auto& item) {
+        return item.second.expired();
+    });
+    auto entry     = std::make_shared<Entry>();
+    m_entries[key] = entry;
+    made           = true;
+    counters::Add(counters::Counter::PipelineMisses);
+    return entry;
+}
+
 GraphicsPipeline::GraphicsPipeline() { toDefault(); }
 GraphicsPipeline::~GraphicsPipeline() {}
 
@@ -115,6 +145,11 @@ GraphicsPipeline& GraphicsPipeline::setLogicOp(bool enable, VkLogicOp op) {
     return *this;
 }
 
+GraphicsPipeline& GraphicsPipeline::setColorFormat(VkFormat format) {
+    m_color_format = format;
+    return *this;
+}
+
 GraphicsPipeline& GraphicsPipeline::setRenderPass(vvk::RenderPass pass) {
     m_pass = std::move(pass);
     return *this;
@@ -126,6 +161,21 @@ GraphicsPipeline& GraphicsPipeline::addStage(Uni_ShaderSpv&& spv) {
     return *this;
 }
 
+GraphicsPipeline&
+GraphicsPipeline::setSpecialization(std::span<const std::pair<u32, i32>> constants) {
+    m_spec_entries.clear();
+    m_spec_data.clear();
+    for (auto& [id, value] : constants) {
+        m_spec_entries.push_back({
+            .constantID = id,
+            .offset     = (u32)(m_spec_data.size() * sizeof(i32)),
+            .size       = sizeof(i32),
+        });
+        m_spec_data.push_back(value);
+    }
+    return *this;
+}
+
 GraphicsPipeline& GraphicsPipeline::addDescriptorSetInfo(std::span<const DescriptorSetInfo> info) {
     for (auto& i : info) {
         m_descriptor_set_infos.push_back(i);
@@ -152,26 +202,106 @@ GraphicsPipeline& GraphicsPipeline::setTopology(VkPrimitiveTopology topology) {
     return *this;
 }
 
+std::string GraphicsPipeline::key(bool render_pass) const {
+    std::string key;
+    for (auto& [stage, spv] : m_stage_spv_map) {
+        std::string_view code { (const char*)spv->spirv.data(),
+                                spv->spirv.size() * sizeof(spv->spirv.front()) };
+        Append(key, stage);
+        Append(key, std::hash<std::string_view>()(code));
+        Append(key, code.size());
+        key.append(spv->entry_point).push_back('\0');
+    }
+    for (auto& e : m_spec_entries) Append(key, e.constantID);
+    for (auto& v : m_spec_data) Append(key, v);
+    key.push_back('|');
+    for (auto& b : m_input_bind_descriptions) Append(key, b);
+    for (auto& a : m_input_attr_descriptions) Append(key, a);
+    Append(key, m_input_assembly.topology);
+    Append(key, m_input_assembly.primitiveRestartEnable);
+    key.push_back('|');
+    for (auto& c : m_color_attachments) Append(key, c);
+    Append(key, m_color.logicOpEnable);
+    Append(key, m_color.logicOp);
+    Append(key, m_color.blendConstants);
+    for (auto& d : m_dynamic_states) Append(key, d);
+    key.push_back('|');
+    Append(key, raster.polygonMode);
+    Append(key, raster.cullMode);
+    Append(key, raster.frontFace);
+    Append(key, raster.depthBiasEnable);
+    Append(key, raster.lineWidth);
+    Append(key, multisample.rasterizationSamples);
+    Append(key, depth.depthTestEnable);
+    Append(key, depth.depthWriteEnable);
+    Append(key, depth.depthCompareOp);
+    key.push_back('|');
+    for (auto& info : m_descriptor_set_infos) {
+        Append(key, info.push_descriptor);
+        Append(key, info.update_after_bind);
+        for (auto& b : info.bindings) {
+            Append(key, b.binding);
+            Append(key, b.descriptorType);
+            Append(key, b.descriptorCount);
+            Append(key, b.stageFlags);
+        }
+        key.push_back(';');
+    }
+    Append(key, render_pass);
+    Append(key, m_color_format);
+    return key;
+}
+
+std::shared_ptr<PipelineRegistry::Entry>
+GraphicsPipeline::share(const Device& device, bool render_pass, bool& made) const {
+    return device.pipelines().acquire(key(render_pass), made);
+}
+
 bool GraphicsPipeline::create(const Device& device, vvk::RenderPass& pass,
                               PipelineParameters& pipeline) {
-    VkPipelineDynamicStateCreateInfo dynamic_info {
-        .sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-        .pNext             = nullptr,
-        .dynamicStateCount = (uint32_t)m_dynamic_states.size(),
-        .pDynamicStates    = m_dynamic_states.data()
+    if (! createLayouts(device, pipeline) || ! createPipeline(device, *pass, pipeline))
+        return false;
+    pipeline.pass = std::move(pass);
+    return true;
+}
+
+bool wallpaper::vulkan::CreateDescriptorSetLayout(const Device&             device,
+                                                  const DescriptorSetInfo&  info,
+                                                  vvk::DescriptorSetLayout& layout) {
+    VkDescriptorSetLayoutCreateInfo create_info {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, .pNext = nullptr
     };
-    for (auto& info : m_descriptor_set_infos) {
-        VkDescriptorSetLayoutCreateInfo create_info {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, .pNext = nullptr
-        };
-        VkDescriptorSetLayoutCreateFlags flags {};
-        if (info.push_descriptor) flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+    VkDescriptorSetLayoutCreateFlags flags {};
+    if (info.push_descriptor) flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
 
-        create_info.bindingCount = (u32)info.bindings.size();
-        create_info.pBindings    = info.bindings.data();
-        create_info.flags        = flags;
+    // the same flags for every binding
+    std::vector<VkDescriptorBindingFlagsEXT>       binding_flags;
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+        .pNext = nullptr,
+    };
+    if (info.update_after_bind) {
+        flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        binding_flags.assign(info.bindings.size(),
+                             VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                 VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+                                 VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT);
+        binding_flags_info.bindingCount  = (u32)binding_flags.size();
+        binding_flags_info.pBindingFlags = binding_flags.data();
+        create_info.pNext                = &binding_flags_info;
+    }
+
+    create_info.bindingCount = (u32)info.bindings.size();
+    create_info.pBindings    = info.bindings.data();
+    create_info.flags        = flags;
+    VVK_CHECK_BOOL_RE(device.handle().CreateDescriptorSetLayout(create_info, layout));
+    return true;
+}
+
+bool GraphicsPipeline::createLayouts(const Device& device, PipelineParameters& pipeline) {
+    for (auto& info : m_descriptor_set_infos) {
         vvk::DescriptorSetLayout layout;
-        VVK_CHECK(device.handle().CreateDescriptorSetLayout(create_info, layout));
+        (void)CreateDescriptorSetLayout(device, info, layout);
         pipeline.descriptor_layouts.emplace_back(std::move(layout));
     }
     {
@@ -184,18 +314,36 @@ bool GraphicsPipeline::create(const Device& device, vvk::RenderPass& pass,
             .setLayoutCount = (uint32_t)layouts.size(),
             .pSetLayouts    = layouts.data(),
         };
-        VVK_CHECK(device.handle().CreatePipelineLayout(ci, pipeline.layout));
+        VVK_CHECK_BOOL_RE(device.handle().CreatePipelineLayout(ci, pipeline.layout));
     }
+    return true;
+}
+
+bool GraphicsPipeline::createPipeline(const Device& device, VkRenderPass pass,
+                                      PipelineParameters& pipeline) {
+    VkPipelineDynamicStateCreateInfo dynamic_info {
+        .sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .pNext             = nullptr,
+        .dynamicStateCount = (uint32_t)m_dynamic_states.size(),
+        .pDynamicStates    = m_dynamic_states.data()
+    };
+    VkSpecializationInfo spec_info {
+        .mapEntryCount = (u32)m_spec_entries.size(),
+        .pMapEntries   = m_spec_entries.data(),
+        .dataSize      = m_spec_data.size() * sizeof(i32),
+        .pData         = m_spec_data.data(),
+    };
 
     std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
     std::vector<vvk::ShaderModule>               shader_modules;
     for (auto& item : m_stage_spv_map) {
         auto&                           spv = item.second;
         VkPipelineShaderStageCreateInfo info {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .pNext = nullptr,
-            .stage = ::ToVkType(spv->stage),
-            .pName = spv->entry_point.c_str()
+            .sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext               = nullptr,
+            .stage               = ::ToVkType(spv->stage),
+            .pName               = spv->entry_point.c_str(),
+            .pSpecializationInfo = m_spec_entries.empty() ? nullptr : &spec_info,
         };
         if (auto opt = CreateShaderModule(device.handle(), *spv); opt.has_value()) {
             shader_modules.emplace_back(std::move(opt.value()));
@@ -221,9 +369,19 @@ bool GraphicsPipeline::create(const Device& device, vvk::RenderPass& pass,
         .pVertexAttributeDescriptions    = m_input_attr_descriptions.data()
     };
 
+    VkPipelineRenderingCreateInfoKHR rendering {
+        .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+        .pNext                   = nullptr,
+        .viewMask                = 0,
+        .colorAttachmentCount    = 1,
+        .pColorAttachmentFormats = &m_color_format,
+        .depthAttachmentFormat   = VK_FORMAT_UNDEFINED,
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+    };
+
     VkGraphicsPipelineCreateInfo create {
         .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .pNext               = nullptr,
+        .pNext               = pass != VK_NULL_HANDLE ? nullptr : &rendering,
         .stageCount          = (uint32_t)shaderStages.size(),
         .pStages             = shaderStages.data(),
         .pVertexInputState   = &input,
@@ -235,9 +393,9 @@ bool GraphicsPipeline::create(const Device& device, vvk::RenderPass& pass,
         .pColorBlendState    = &m_color,
         .pDynamicState       = &dynamic_info,
         .layout              = *pipeline.layout,
-        .renderPass          = *pass,
+        .renderPass          = pass,
     };
-    VVK_CHECK_BOOL_RE(device.handle().CreateGraphicsPipeline(create, pipeline.handle));
-    pipeline.pass = std::move(pass);
+    VVK_CHECK_BOOL_RE(device.handle().CreateGraphicsPipeline(
+        create, pipeline.handle, *device.pipeline_cache()));
     return true;
 }
@@ -1,5 +1,6 @@
 #include "Instance.hpp"
 #include "Device.hpp"
+#include "DeviceCache.hpp"
 
 #include <cstdio>
 #include "Utils/Logging.h"
@@ -85,45 +86,72 @@ void EnumateLayers(wallpaper::Set<std::string>& set, const vvk::InstanceDispatch
 }
 } // namespace
 
-bool Instance::ChoosePhysicalDevice(const CheckGpuOp&             checkgpu,
-                                    std::span<const std::uint8_t> uuid) {
+bool Instance::ChoosePhysicalDevice(const CheckGpuOp& checkgpu, std::span<const std::uint8_t> uuid,
+                                    const DeviceCache* cached, GpuPreference prefer) {
     auto deviceList = m_vinst.EnumeratePhysicalDevices();
 
     VkInstanceCreateInfo crea;
     auto                 logGpu = [](const VkPhysicalDeviceProperties& props) {
-        LOG_INFO("vulkan device: %s", props.deviceName);
+        const char* type = props.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ? "integrated"
+                           : props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU ? "discrete"
+                                                                                      : "other";
+        LOG_INFO("vulkan device: %s, %s", props.deviceName, type);
+    };
+    auto preferred = [prefer](const VkPhysicalDeviceProperties& props) {
+        switch (prefer) {
+        case GpuPreference::Integrated:
+            return props.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU;
+        case GpuPreference::Discrete:
+            return props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+        default: return true;
+        }
     };
 
     vvk::PhysicalDevice        final_gpu;
     VkPhysicalDeviceProperties final_props;
-
-    // choose deiscrete device
-    for (const auto& d : deviceList) {
-        VkPhysicalDeviceIDProperties device_id_props {
-            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES, .pNext = NULL
-        };
-        VkPhysicalDeviceProperties2 props2 { .sType =
-                                                 VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
-                                             .pNext = &device_id_props };
-        d.GetProperties2KHR(props2);
-        auto& props = props2.properties;
-        if (uuid.size() > 0) {
-            decltype(uuid) device_uuid { device_id_props.deviceUUID };
-            if (std::equal(uuid.begin(), uuid.end(), device_uuid.begin(), device_uuid.end())) {
-                /*
-                for(const auto& p:device_uuid) {
-                    printf("%02x ", p);
-                }
-                */
-                final_props = props;
-                final_gpu   = d;
-                break;
+    m_gpu_cached = false;
+
+    auto choose = [&](const auto& pick) {
+        for (const auto& d : deviceList) {
+            VkPhysicalDeviceIDProperties device_id_props {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES, .pNext = NULL
+            };
+            VkPhysicalDeviceProperties2 props2 {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &device_id_props
+            };
+            d.GetProperties2KHR(props2);
+            auto&                         props = props2.properties;
+            std::span<const std::uint8_t> device_uuid { device_id_props.deviceUUID };
+            bool                          cached_gpu =
+                cached != nullptr && cached->matches(device_uuid, props.driverVersion);
+            if (pick(d, props, device_uuid, cached_gpu)) {
+                final_props  = props;
+                final_gpu    = d;
+                m_gpu_cached = cached_gpu;
+                return true;
+            }
+        }
+        return false;
+    };
+    if (uuid.size() > 0) {
+        choose([uuid](const vvk::PhysicalDevice&, const auto&, auto device_uuid, bool) {
+            return std::equal(uuid.begin(), uuid.end(), device_uuid.begin(), device_uuid.end());
+        });
+    } else {
+        // the cached gpu with the extensions it had, then the first one good enough, of the kind
+        // preferred before any other
+        for (bool of_kind : { true, false }) {
+            if (final_gpu || (! of_kind && prefer == GpuPreference::Any)) break;
+            if (cached != nullptr) {
+                choose([&](const vvk::PhysicalDevice& d, const auto& props, auto, bool cached_gpu) {
+                    return cached_gpu && (! of_kind || preferred(props)) &&
+                           checkgpu(d, &cached->device_exts);
+                });
             }
-        } else {
-            if (checkgpu(d)) {
-                final_props = props;
-                final_gpu   = d;
-                break;
+            if (! final_gpu) {
+                choose([&](const vvk::PhysicalDevice& d, const auto& props, auto, bool) {
+                    return (! of_kind || preferred(props)) && checkgpu(d, nullptr);
+                });
             }
         }
     }
@@ -153,11 +181,14 @@ bool Instance::supportLayer(std::string_view name) const { return exists(m_layer
 void Instance::Destroy() {}
 
 bool Instance::Create(Instance& inst, std::span<const Extension> instExts,
-                      std::span<const InstanceLayer> instLayers) {
+                      std::span<const InstanceLayer> instLayers, const DeviceCache* cached) {
     vvk::LoadLibrary(inst.m_vklib, inst.m_dld);
     vvk::Load(inst.m_dld);
 
-    EnumateExts(inst.m_extensions, inst.m_dld);
+    if (cached != nullptr)
+        inst.m_extensions = cached->inst_exts;
+    else
+        EnumateExts(inst.m_extensions, inst.m_dld);
     Set<std::string> exts, layers;
     std::array       test_exts_array { std::span<const Extension>(base_inst_exts), instExts };
     for (auto& test_exts : test_exts_array) {
@@ -172,7 +203,10 @@ bool Instance::Create(Instance& inst, std::span<const Extension> instExts,
         }
     }
 
-    EnumateLayers(inst.m_layers, inst.m_dld);
+    if (cached != nullptr)
+        inst.m_layers = cached->inst_layers;
+    else
+        EnumateLayers(inst.m_layers, inst.m_dld);
     std::array test_layers_array { std::span<const InstanceLayer>(base_inst_layers), instLayers };
     for (auto& test_layers : test_layers_array) {
         for (auto& layer : test_layers) {
@@ -20,15 +20,17 @@ VmaImageParameters::~VmaImageParameters() = default;
 VmaImageParameters::VmaImageParameters(VmaImageParameters&& o) noexcept
     : handle(std::move(o.handle)),
       view(std::move(o.view)),
-      sampler(std::move(o.sampler)),
+      sampler(std::exchange(o.sampler, VK_NULL_HANDLE)),
       extent(o.extent),
-      mipmap_level(o.mipmap_level) {}
+      mipmap_level(o.mipmap_level),
+      usage(o.usage) {}
 VmaImageParameters& VmaImageParameters::operator=(VmaImageParameters&& o) noexcept {
     handle       = std::move(o.handle);
     view         = std::move(o.view);
-    sampler      = std::move(o.sampler);
+    sampler      = std::exchange(o.sampler, VK_NULL_HANDLE);
     extent       = o.extent;
     mipmap_level = o.mipmap_level;
+    usage        = o.usage;
     return *this;
 }
 
@@ -42,7 +44,11 @@ ExImageParameters::ExImageParameters(ExImageParameters&& o) noexcept
       sampler(std::move(o.sampler)),
       extent(o.extent),
       mipmap_level(o.mipmap_level),
-      fd(std::exchange(o.fd, 0)) {}
+      fd(std::exchange(o.fd, 0)),
+      dma_buf(o.dma_buf),
+      drm_modifier(o.drm_modifier),
+      offset(o.offset),
+      row_pitch(o.row_pitch) {}
 ExImageParameters& ExImageParameters::operator=(ExImageParameters&& o) noexcept {
     mem          = std::move(o.mem);
     mem_reqs     = o.mem_reqs;
@@ -52,6 +58,10 @@ ExImageParameters& ExImageParameters::operator=(ExImageParameters&& o) noexcept
     extent       = o.extent;
     mipmap_level = o.mipmap_level;
     fd           = std::exchange(o.fd, 0);
+    dma_buf      = o.dma_buf;
+    drm_modifier = o.drm_modifier;
+    offset       = o.offset;
+    row_pitch    = o.row_pitch;
     return *this;
 }
 
@@ -1,6 +1,7 @@
 #include "Shader.hpp"
 
 #include <cassert>
+#include <cstring>
 #include <glslang/Include/Types.h>
 #include <glslang/MachineIndependent/localintermediate.h>
 #include <glslang/MachineIndependent/iomapper.h>
@@ -10,6 +11,7 @@
 #include "Utils/Logging.h"
 #include <cstdlib>
 #include <memory>
+#include <mutex>
 #include <string>
 #include "Core/StringHelper.hpp"
 #include "Utils/Sha.hpp"
@@ -32,6 +34,7 @@ inline wallpaper::ShaderType ToGeneType(VkShaderStageFlagBits stage) {
     switch (stage) {
     case VK_SHADER_STAGE_VERTEX_BIT: return wallpaper::ShaderType::VERTEX;
     case VK_SHADER_STAGE_FRAGMENT_BIT: return wallpaper::ShaderType::FRAGMENT;
+    case VK_SHADER_STAGE_COMPUTE_BIT: return wallpaper::ShaderType::COMPUTE;
     default: assert(false); return wallpaper::ShaderType::VERTEX;
     }
 }
@@ -40,6 +43,7 @@ inline VkShaderStageFlagBits ToVkType(EShLanguage lan) {
     switch (lan) {
     case EShLangVertex: return VK_SHADER_STAGE_VERTEX_BIT;
     case EShLangFragment: return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case EShLangCompute: return VK_SHADER_STAGE_COMPUTE_BIT;
     default: assert(false); return VK_SHADER_STAGE_VERTEX_BIT;
     }
 }
@@ -50,6 +54,7 @@ inline VkShaderStageFlagBits ToVkType(SpvReflectShaderStageFlagBits s) {
     switch (s) {
     case SPV_REFLECT_SHADER_STAGE_VERTEX_BIT: return VK_SHADER_STAGE_VERTEX_BIT;
     case SPV_REFLECT_SHADER_STAGE_FRAGMENT_BIT: return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case SPV_REFLECT_SHADER_STAGE_COMPUTE_BIT: return VK_SHADER_STAGE_COMPUTE_BIT;
     default: assert(false); return VK_SHADER_STAGE_VERTEX_BIT;
     }
 }
@@ -350,13 +355,13 @@ bool wallpaper::vulkan::GenReflect(std::span<const std::vector<uint>> codes,
                 continue;
             }
             if (b.descriptor_type == SPV_REFLECT_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
-                auto& block      = b.block;
-                auto  block_name = std::string(block.name).empty() ? bind_name : block.name;
+                auto& block = b.block;
+                // named as in binding_map, the shared globals block is told apart by it
                 ref.blocks.push_back(ShaderReflected::Block { //.index = i,
                                                               .size       = block.size,
-                                                              .name       = block.name,
+                                                              .name       = bind_name,
                                                               .member_map = {} });
-                auto& ref_block = ref.blocks.front();
+                auto& ref_block = ref.blocks.back();
 
                 vkbinding.binding         = b.binding;
                 vkbinding.descriptorCount = 1;
@@ -372,6 +377,12 @@ bool wallpaper::vulkan::GenReflect(std::span<const std::vector<uint>> codes,
                     }
                     ref_block.member_map[unif.name] = bunif;
                 }
+            } else if (b.descriptor_type == SPV_REFLECT_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+                vkbinding.binding         = b.binding;
+                vkbinding.descriptorCount = 1;
+                vkbinding.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+                ref.buffer_sizes[bind_name] = b.block.size;
             } else if (b.descriptor_type == SPV_REFLECT_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
                 vkbinding.binding         = b.binding;
                 vkbinding.descriptorCount = 1;
@@ -408,9 +419,162 @@ bool wallpaper::vulkan::GenReflect(std::span<const std::vector<uint>> codes,
     return true;
 }
 
+void wallpaper::vulkan::InitGlslang() {
+    static std::once_flag inited;
+    std::call_once(inited, []() {
+        glslang::InitializeProcess();
+    });
+}
+
+namespace
+{
+constexpr u32 reflect_version { 1 };
+
+class ReflectWriter {
+public:
+    void u32s(u32 x) { m_out.append(reinterpret_cast<const char*>(&x), sizeof(x)); }
+    void str(std::string_view s) {
+        u32s((u32)s.size());
+        m_out.append(s);
+    }
+    std::string take() { return std::move(m_out); }
+
+private:
+    std::string m_out;
+};
+
+class ReflectReader {
+public:
+    explicit ReflectReader(std::string_view in): m_in(in) {}
+    bool u32s(u32& x) {
+        if (m_in.size() < sizeof(x)) return false;
+        std::memcpy(&x, m_in.data(), sizeof(x));
+        m_in.remove_prefix(sizeof(x));
+        return true;
+    }
+    template<typename T>
+    bool as(T& x) {
+        u32 v;
+        if (! u32s(v)) return false;
+        x = (T)v;
+        return true;
+    }
+    bool str(std::string& s) {
+        u32 size;
+        if (! u32s(size) || m_in.size() < size) return false;
+        s.assign(m_in.substr(0, size));
+        m_in.remove_prefix(size);
+        return true;
+    }
+    bool done() const { return m_in.empty(); }
+
+private:
+    std::string_view m_in;
+};
+} // namespace
+
+std::string wallpaper::vulkan::PackReflect(const ShaderReflected&          ref,
+                                           std::span<const Uni_ShaderSpv> spvs) {
+    ReflectWriter w;
+    w.u32s(reflect_version);
+    w.u32s((u32)spvs.size());
+    for (auto& spv : spvs) w.u32s((u32)spv->stage);
+
+    w.u32s((u32)ref.blocks.size());
+    for (auto& block : ref.blocks) {
+        w.u32s((u32)block.index);
+        w.u32s(block.size);
+        w.str(block.name);
+        w.u32s((u32)block.member_map.size());
+        for (auto& [name, unif] : block.member_map) {
+            w.str(name);
+            w.u32s((u32)unif.block_index);
+            w.u32s(unif.offset);
+            w.u32s((u32)unif.size);
+            w.u32s((u32)unif.num);
+        }
+    }
+    w.u32s((u32)ref.buffer_sizes.size());
+    for (auto& [name, size] : ref.buffer_sizes) {
+        w.str(name);
+        w.u32s(size);
+    }
+    w.u32s((u32)ref.binding_map.size());
+    for (auto& [name, bind] : ref.binding_map) {
+        w.str(name);
+        w.u32s(bind.binding);
+        w.u32s((u32)bind.descriptorType);
+        w.u32s(bind.descriptorCount);
+        w.u32s(bind.stageFlags);
+    }
+    w.u32s((u32)ref.input_location_map.size());
+    for (auto& [name, input] : ref.input_location_map) {
+        w.str(name);
+        w.u32s(input.location);
+        w.u32s((u32)input.format);
+    }
+    return w.take();
+}
+
+bool wallpaper::vulkan::UnpackReflect(std::string_view                   bytes,
+                                      std::span<const std::vector<uint>> codes,
+                                      std::vector<Uni_ShaderSpv>& spvs, ShaderReflected& ref) {
+    ReflectReader r(bytes);
+    u32           version, num;
+    if (! r.u32s(version) || version != reflect_version) return false;
+    if (! r.u32s(num) || num != codes.size()) return false;
+
+    spvs.clear();
+    ref = {};
+    for (auto& code : codes) {
+        Uni_ShaderSpv spv = std::make_unique<ShaderSpv>();
+        if (! r.as(spv->stage)) return false;
+        spv->spirv = code;
+        spvs.emplace_back(std::move(spv));
+    }
+
+    std::string name;
+    if (! r.u32s(num)) return false;
+    for (u32 i = 0; i < num; i++) {
+        auto& block = ref.blocks.emplace_back();
+        u32   members;
+        if (! (r.as(block.index) && r.u32s(block.size) && r.str(block.name) && r.u32s(members)))
+            return false;
+        for (u32 j = 0; j < members; j++) {
+            ShaderReflected::BlockedUniform unif {};
+            if (! (r.str(name) && r.as(unif.block_index) && r.u32s(unif.offset) &&
+                   r.as(unif.size) && r.as(unif.num)))
+                return false;
+            block.member_map[name] = unif;
+        }
+    }
+    if (! r.u32s(num)) return false;
+    for (u32 i = 0; i < num; i++) {
+        u32 size;
+        if (! (r.str(name) && r.u32s(size))) return false;
+        ref.buffer_sizes[name] = size;
+    }
+    if (! r.u32s(num)) return false;
+    for (u32 i = 0; i < num; i++) {
+        VkDescriptorSetLayoutBinding bind {};
+        if (! (r.str(name) && r.u32s(bind.binding) && r.as(bind.descriptorType) &&
+               r.u32s(bind.descriptorCount) && r.as(bind.stageFlags)))
+            return false;
+        ref.binding_map[name] = bind;
+    }
+    if (! r.u32s(num)) return false;
+    for (u32 i = 0; i < num; i++) {
+        ShaderReflected::Input input {};
+        if (! (r.str(name) && r.u32s(input.location) && r.as(input.format))) return false;
+        ref.input_location_map[name] = input;
+    }
+    return r.done();
+}
+
 bool wallpaper::vulkan::CompileAndLinkShaderUnits(std::span<const ShaderCompUnit>  compUnits,
                                                   const ShaderCompOpt&        opt,
                                                   std::vector<Uni_ShaderSpv>& spvs) {
+    InitGlslang();
     glslang::TProgram program;
     EShMessages       emsg;
     SetMessageOptions(opt, emsg);
@@ -443,6 +607,7 @@ bool wallpaper::vulkan::CompileAndLinkShaderUnits(std::span<const ShaderCompUnit
     glslang::SpvOptions spvOptions;
     spvOptions.validate          = true;
     spvOptions.generateDebugInfo = false;
+    spvOptions.disableOptimizer  = ! opt.optimize;
 
     spvs.clear();
     for (auto& unit : compUnits) {
@@ -3,6 +3,7 @@
 #include <cstring>
 #include "Util.hpp"
 #include "Device.hpp"
+#include "Utils/Counters.hpp"
 
 using namespace wallpaper::vulkan;
 
@@ -12,12 +13,86 @@ using namespace wallpaper::vulkan;
         { act; }                                                             \
     }
 
-StagingBuffer::StagingBuffer(const Device& d, VkDeviceSize size, VkBufferUsageFlags usage)
-    : m_device(d), m_size_step(size), m_usage(usage) {}
+StagingBuffer::StagingBuffer(const Device& d, VkDeviceSize size, VkBufferUsageFlags usage,
+                             usize frame_num)
+    : m_device(d), m_size_step(size), m_usage(usage), m_frame_num(std::max<usize>(frame_num, 1)) {}
 StagingBuffer::~StagingBuffer() {}
 
 namespace
 {
+// ranges closer than this are copied as one, fewer regions beat a few extra bytes
+constexpr VkDeviceSize merge_gap { 256 };
+// bar heaps this small are usually the legacy 256mb window, keep them for the driver
+constexpr VkDeviceSize min_direct_heap { 256 * 1024 * 1024 + 1 };
+
+template<typename TRange>
+void MergeRanges(std::vector<TRange>& ranges) {
+    if (ranges.size() < 2) return;
+    std::sort(ranges.begin(), ranges.end(), [](const auto& a, const auto& b) {
+        return a.begin < b.begin;
+    });
+    usize last = 0;
+    for (usize i = 1; i < ranges.size(); i++) {
+        if (ranges[i].begin <= ranges[last].end + merge_gap)
+            ranges[last].end = std::max(ranges[last].end, ranges[i].end);
+        else
+            ranges[++last] = ranges[i];
+    }
+    ranges.resize(last + 1);
+}
+
+// cut [begin, end) out of the ranges, a range around it splits in two
+template<typename TRange>
+void EraseRange(std::vector<TRange>& ranges, VkDeviceSize begin, VkDeviceSize end) {
+    const usize num = ranges.size();
+    for (usize i = 0; i < num; i++) {
+        const TRange r = ranges[i];
+        if (r.end <= begin || r.begin >= end) continue;
+        if (r.begin < begin) {
+            ranges[i].end = begin;
+            if (r.end > end) ranges.push_back({ end, r.end });
+        } else {
+            ranges[i].begin = std::min(r.end, end);
+        }
+    }
+    std::erase_if(ranges, [](const TRange& r) { return r.begin >= r.end; });
+}
+
+// moves the ranges into copies at the same offsets
+template<typename TRange>
+void ToCopies(std::vector<TRange>& ranges, std::vector<VkBufferCopy>& copies) {
+    MergeRanges(ranges);
+    copies.clear();
+    VkDeviceSize bytes { 0 };
+    for (auto& r : ranges) {
+        copies.push_back({ .srcOffset = r.begin, .dstOffset = r.begin, .size = r.end - r.begin });
+        bytes += r.end - r.begin;
+    }
+    ranges.clear();
+    counters::Add(counters::Counter::UploadBytes, bytes);
+}
+
+std::optional<VmaBufferParameters> CreateDirectBuffer(VmaAllocator allocator,
+                                                      VkBufferUsageFlags usage, std::size_t size) {
+    do {
+        VmaBufferParameters buffer;
+        VkBufferCreateInfo  ci {
+             .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+             .pNext = nullptr,
+             .size  = size,
+             .usage = usage,
+        };
+        buffer.req_size                  = ci.size;
+        VmaAllocationCreateInfo vma_info = {};
+        vma_info.usage                   = VMA_MEMORY_USAGE_GPU_ONLY;
+        vma_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        VVK_CHECK_ACT(break, vvk::CreateBuffer(allocator, ci, vma_info, buffer.handle));
+        return buffer;
+    } while (false);
+    return std::nullopt;
+}
+
 std::optional<VmaBufferParameters> CreateGpuBuffer(VmaAllocator allocator, VkBufferUsageFlags usage,
                                                    std::size_t size) {
     do {
@@ -37,14 +112,29 @@ std::optional<VmaBufferParameters> CreateGpuBuffer(VmaAllocator allocator, VkBuf
     return std::nullopt;
 }
 
+// shared, previous frames may still read dst_buf and the copy waits for them
 void RecordCopyBuffer(const BufferParameters& dst_buf, const BufferParameters& src_buf,
-                      vvk::CommandBuffer& cmd) {
-    VkBufferCopy copy {
-        .srcOffset = 0,
-        .dstOffset = 0,
-        .size      = src_buf.req_size,
-    };
-    cmd.CopyBuffer(src_buf.handle, dst_buf.handle, copy);
+                      std::span<const VkBufferCopy> copies, vvk::CommandBuffer& cmd,
+                      bool shared) {
+    if (shared) {
+        VkBufferMemoryBarrier out_bar {
+            .sType         = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .pNext         = nullptr,
+            .srcAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .buffer        = dst_buf.handle,
+            .offset        = 0,
+            .size          = VK_WHOLE_SIZE,
+        };
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            0,
+                            out_bar);
+    }
+
+    cmd.CopyBuffer(src_buf.handle, dst_buf.handle, copies);
 
     VkBufferMemoryBarrier in_bar {
         .sType         = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
@@ -94,10 +184,20 @@ StagingBuffer::VirtualBlock* StagingBuffer::newVirtualBlock(VkDeviceSize nsize)
     return &block;
 }
 bool StagingBuffer::increaseBuf(VkDeviceSize nsize) {
+    auto newsize = stageSize() + nsize;
+    counters::Add(counters::Counter::StagingGrows);
+    counters::Add(counters::Counter::StagingGrowBytes, nsize);
+    if (m_frame_num > 1) {
+        m_host_buf.resize(newsize);
+        m_stage_raw = m_host_buf.data();
+        if (! createFrameBufs(newsize)) return false;
+        LOG_INFO("increase buffer size: %d", nsize);
+        return true;
+    }
+
     if (m_stage_raw == nullptr) {
         VVK_CHECK_BOOL_RE(mapStageBuf());
     }
-    auto newsize = m_stage_buf.req_size + nsize;
     // do double copy
     std::vector<uint8_t> tmp;
     tmp.resize(newsize);
@@ -116,17 +216,99 @@ bool StagingBuffer::increaseBuf(VkDeviceSize nsize) {
     return true;
 }
 
+bool StagingBuffer::createFrameBufs(VkDeviceSize size) {
+    destroyFrameBufs();
+    m_generation++;
+    m_frame_bufs.resize(m_frame_num);
+    for (auto& frame : m_frame_bufs) {
+        if (m_direct) {
+            auto opt = CreateDirectBuffer(m_device.vma_allocator(), m_usage, size);
+            if (! opt.has_value()) return false;
+            frame.buf = std::move(opt.value());
+        } else {
+            if (! CreateStagingBuffer(m_device.vma_allocator(), size, frame.buf)) return false;
+            auto opt = CreateGpuBuffer(m_device.vma_allocator(), m_usage, size);
+            if (! opt.has_value()) return false;
+            frame.gpu = std::move(opt.value());
+        }
+        // new memory, the whole buffer goes in with the frame's first commit or upload
+        frame.dirty.push_back({ 0, size });
+        VVK_CHECK_BOOL_RE(frame.buf.handle.MapMemory(&frame.raw));
+    }
+    return true;
+}
+
+bool StagingBuffer::useDirect() const {
+    const VkPhysicalDeviceProperties*       props;
+    const VkPhysicalDeviceMemoryProperties* mem;
+    vmaGetPhysicalDeviceProperties(m_device.vma_allocator(), &props);
+    vmaGetMemoryProperties(m_device.vma_allocator(), &mem);
+
+    const bool unified = props->deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU;
+    const auto flags   = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    for (u32 i = 0; i < mem->memoryTypeCount; i++) {
+        auto& type = mem->memoryTypes[i];
+        if ((type.propertyFlags & flags) != flags) continue;
+        if (unified || mem->memoryHeaps[type.heapIndex].size >= min_direct_heap) return true;
+    }
+    return false;
+}
+
+void StagingBuffer::markDirty(VkDeviceSize offset, VkDeviceSize size) {
+    if (size == 0) return;
+    auto add = [offset, size](std::vector<Range>& ranges) {
+        ranges.push_back({ offset, offset + size });
+        // many small writes between two uploads, keep the list short
+        if (ranges.size() >= 1024) MergeRanges(ranges);
+    };
+    if (m_frame_num > 1) {
+        for (auto& frame : m_frame_bufs) add(frame.dirty);
+    } else {
+        add(m_dirty);
+    }
+}
+
+void StagingBuffer::destroyFrameBufs() {
+    for (auto& frame : m_frame_bufs) {
+        if (frame.raw != nullptr) frame.buf.handle.UnMapMemory();
+    }
+    m_frame_bufs.clear();
+}
+
+VkDeviceSize StagingBuffer::stageSize() const {
+    return m_frame_num > 1 ? m_host_buf.size() : m_stage_buf.req_size;
+}
+
 bool StagingBuffer::allocate() {
-    if (! CreateStagingBuffer(m_device.vma_allocator(), m_size_step, m_stage_buf)) return false;
-    VVK_CHECK_BOOL_RE(m_stage_buf.handle.MapMemory(&m_stage_raw));
+    if (m_frame_num > 1) {
+        m_host_buf.assign(m_size_step, 0);
+        m_stage_raw = m_host_buf.data();
+
+        m_direct = useDirect();
+        if (m_direct && ! createFrameBufs(m_size_step)) {
+            LOG_INFO("direct buffer not available, upload through staging");
+            m_direct = false;
+        }
+        if (! m_direct && ! createFrameBufs(m_size_step)) return false;
+        if (m_direct) LOG_INFO("host visible device local buffer(%p), no staging copy", this);
+    } else {
+        if (! CreateStagingBuffer(m_device.vma_allocator(), m_size_step, m_stage_buf))
+            return false;
+        VVK_CHECK_BOOL_RE(m_stage_buf.handle.MapMemory(&m_stage_raw));
+    }
     auto* block = newVirtualBlock(m_size_step);
     return block != nullptr;
 }
 
 void StagingBuffer::destroy() {
-    if (m_stage_raw != nullptr) {
+    if (m_stage_raw != nullptr && m_frame_num == 1) {
         m_stage_buf.handle.UnMapMemory();
     }
+    m_stage_raw = nullptr;
+    m_host_buf.clear();
+    m_dirty.clear();
+    m_copies.clear();
+    destroyFrameBufs();
     for (auto& block : m_virtual_blocks) {
         if (block.enabled) {
             vmaClearVirtualBlock(block.handle);
@@ -213,9 +395,33 @@ bool StagingBuffer::writeToBuf(const StagingBufferRef& ref, std::span<uint8_t> d
     VkDeviceSize size = std::min(ref.size - offset, data.size());
     uint8_t*     raw  = (uint8_t*)m_stage_raw;
     std::copy(data.begin(), data.begin() + size, raw + ref.offset + offset);
+    markDirty(ref.offset + offset, size);
+    return true;
+}
+
+bool StagingBuffer::writeToFrame(const StagingBufferRef& ref, std::span<const uint8_t> data) {
+    CHECK_REF(ref, return false);
+    if (! m_direct) return false;
+
+    auto& frame_buf = m_frame_bufs.at(m_frame);
+    if (frame_buf.raw == nullptr) return false;
+
+    VkDeviceSize size = std::min<VkDeviceSize>(ref.size, data.size());
+    if (size == 0) return true;
+    memcpy((uint8_t*)frame_buf.raw + ref.offset, data.data(), size);
+    // the host copy of the range is stale, commitFrame must not put it back
+    EraseRange(frame_buf.dirty, ref.offset, ref.offset + size);
+    VVK_CHECK_BOOL_RE(vmaFlushAllocation(
+        m_device.vma_allocator(), frame_buf.buf.handle.Allocation(), ref.offset, size));
     return true;
 }
 
+std::span<const uint8_t> StagingBuffer::bufData(const StagingBufferRef& ref) const {
+    CHECK_REF(ref, return {});
+    if (m_stage_raw == nullptr) return {};
+    return { (const uint8_t*)m_stage_raw + ref.offset, (usize)ref.size };
+}
+
 bool StagingBuffer::fillBuf(const StagingBufferRef& ref, size_t offset, size_t size, uint8_t c) {
     CHECK_REF(ref, return false);
 
@@ -226,25 +432,79 @@ bool StagingBuffer::fillBuf(const StagingBufferRef& ref, size_t offset, size_t s
     uint8_t*     raw       = (uint8_t*)m_stage_raw;
     uint8_t*     raw_begin = raw + ref.offset + offset;
     std::fill(raw_begin, raw_begin + size_, c);
+    markDirty(ref.offset + offset, size_);
     return true;
 }
 
-bool StagingBuffer::recordUpload(vvk::CommandBuffer& cmd) {
+bool StagingBuffer::recordUpload(vvk::CommandBuffer& cmd, usize frame) {
+    // the frame's buffer is written in place by commitFrame
+    if (m_direct) return true;
+
+    if (m_frame_num > 1) {
+        // the fence of frame signaled, nothing else reads its gpu buffer
+        auto& frame_buf = m_frame_bufs.at(frame % m_frame_num);
+        ToCopies(frame_buf.dirty, m_copies);
+        if (! m_copies.empty())
+            RecordCopyBuffer(frame_buf.gpu, frame_buf.buf, m_copies, cmd, false);
+        return true;
+    }
+
     if (! m_gpu_buf.handle) {
-        if (auto opt = CreateGpuBuffer(m_device.vma_allocator(), m_usage, m_stage_buf.req_size);
+        if (auto opt = CreateGpuBuffer(m_device.vma_allocator(), m_usage, stageSize());
             opt.has_value()) {
             m_gpu_buf = std::move(opt.value());
         } else
             return false;
+        m_dirty.clear();
+        markDirty(0, stageSize());
     }
+
+    ToCopies(m_dirty, m_copies);
+
     if (m_stage_raw != nullptr) {
         m_stage_buf.handle.UnMapMemory();
         m_stage_raw = nullptr;
     }
+    if (m_copies.empty()) return true;
     VVK_CHECK_BOOL_RE(vmaFlushAllocation(
         m_device.vma_allocator(), m_stage_buf.handle.Allocation(), 0, VK_WHOLE_SIZE));
-    RecordCopyBuffer(m_gpu_buf, m_stage_buf, cmd);
+    RecordCopyBuffer(m_gpu_buf, m_stage_buf, m_copies, cmd, true);
     return true;
 }
 
-VkBuffer StagingBuffer::gpuBuf() const { return *m_gpu_buf.handle; }
+bool StagingBuffer::commitFrame(usize frame) {
+    if (m_frame_num == 1) return true;
+
+    auto& frame_buf = m_frame_bufs.at(frame % m_frame_num);
+    if (frame_buf.raw == nullptr) return false;
+
+    auto* dst = (uint8_t*)frame_buf.raw;
+    auto* src = m_host_buf.data();
+    if (m_direct) {
+        // the fence of frame signaled, its buffer is no longer read
+        MergeRanges(frame_buf.dirty);
+        for (auto& r : frame_buf.dirty) {
+            counters::Add(counters::Counter::UploadBytes, r.end - r.begin);
+            memcpy(dst + r.begin, src + r.begin, r.end - r.begin);
+            VVK_CHECK_BOOL_RE(vmaFlushAllocation(m_device.vma_allocator(),
+                                                 frame_buf.buf.handle.Allocation(),
+                                                 r.begin,
+                                                 r.end - r.begin));
+        }
+        frame_buf.dirty.clear();
+        return true;
+    }
+
+    if (m_copies.empty()) return true;
+    for (auto& c : m_copies) memcpy(dst + c.srcOffset, src + c.srcOffset, c.size);
+    m_copies.clear();
+    VVK_CHECK_BOOL_RE(vmaFlushAllocation(
+        m_device.vma_allocator(), frame_buf.buf.handle.Allocation(), 0, VK_WHOLE_SIZE));
+    return true;
+}
+
+VkBuffer StagingBuffer::gpuBuf(usize frame) const {
+    if (m_frame_num == 1) return *m_gpu_buf.handle;
+    auto& frame_buf = m_frame_bufs.at(frame % m_frame_num);
+    return m_direct ? *frame_buf.buf.handle : *frame_buf.gpu.handle;
+}
@@ -2,6 +2,8 @@
 
 #include "Device.hpp"
 
+#include <algorithm>
+
 using namespace wallpaper::vulkan;
 
 struct SwapChainSupportDetails {
@@ -36,6 +38,15 @@ VkSurfaceFormatKHR chooseSwapSurfaceFormat(std::span<const VkSurfaceFormatKHR> a
     return format;
 }
 
+VkPresentModeKHR ChoosePresentMode(std::span<const VkPresentModeKHR> modes,
+                                   VkPresentModeKHR                  want) {
+    // fifo is there on every surface
+    if (want == VK_PRESENT_MODE_FIFO_KHR || std::ranges::find(modes, want) != modes.end())
+        return want;
+    LOG_INFO("present mode %s not supported, use fifo", vvk::ToString(want));
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
 VkExtent2D GetSwapChainExtent(VkSurfaceCapabilitiesKHR& surface_capabilities, VkExtent2D ext) {
     auto min = surface_capabilities.minImageExtent;
     auto max = surface_capabilities.maxImageExtent;
@@ -97,7 +108,8 @@ std::span<const ImageParameters> Swapchain::images() const { return m_images; }
 
 VkPresentModeKHR Swapchain::presentMode() const { return m_present_mode; };
 
-bool Swapchain::Create(Device& device, VkSurfaceKHR surface, VkExtent2D extent, Swapchain& swap) {
+bool Swapchain::Create(Device& device, VkSurfaceKHR surface, VkExtent2D extent,
+                       const Options& options, Swapchain& swap, VkSwapchainKHR old) {
     SwapChainSupportDetails swap_details;
     if (! querySwapChainSupport(device.gpu(), surface, swap_details)) return false;
 
@@ -105,15 +117,17 @@ bool Swapchain::Create(Device& device, VkSurfaceKHR surface, VkExtent2D extent,
 
     auto& surfaceCapabilities = swap_details.capabilities;
 
-    // triple
-    uint32_t image_count = surfaceCapabilities.minImageCount + 1;
+    // triple by default
+    uint32_t image_count = options.image_count != 0 ? options.image_count
+                                                    : surfaceCapabilities.minImageCount + 1;
+    image_count          = std::max(image_count, surfaceCapabilities.minImageCount);
     if (surfaceCapabilities.maxImageCount > 0 && image_count > surfaceCapabilities.maxImageCount)
         image_count = surfaceCapabilities.maxImageCount;
     surfaceCapabilities.currentExtent = swap.m_extent;
     
     swap.m_extent = GetSwapChainExtent(surfaceCapabilities, extent);
 
-    swap.m_present_mode                          = VK_PRESENT_MODE_FIFO_KHR;
+    swap.m_present_mode = ChoosePresentMode(swap_details.presentModes, options.present_mode);
     VkSurfaceTransformFlagBitsKHR preTransform   = surfaceCapabilities.currentTransform;
     VkCompositeAlphaFlagBitsKHR   compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 
@@ -132,10 +146,14 @@ bool Swapchain::Create(Device& device, VkSurfaceKHR surface, VkExtent2D extent,
         .compositeAlpha   = compositeAlpha,
         .presentMode      = swap.m_present_mode,
         .clipped          = true,
-        .oldSwapchain     = nullptr,
+        .oldSwapchain     = old,
     };
 
     VVK_CHECK_BOOL_RE(device.device().CreateSwapchainKHR(sci, swap.m_handle));
+    if (old == VK_NULL_HANDLE)
+        LOG_INFO("swapchain present mode: %s, images: %d",
+                 vvk::ToString(swap.m_present_mode),
+                 (int)image_count);
     {
         std::vector<VkImage> images;
         VVK_CHECK_BOOL_RE(swap.m_handle.GetImages(images));
@@ -9,10 +9,14 @@
 #include "Core/MapSet.hpp"
 #include "Core/ArrayHelper.hpp"
 #include "Utils/AutoDeletor.hpp"
+#include "Utils/Counters.hpp"
 #include "Utils/Hash.h"
+#include "Utils/Trace.h"
 #include "include/Vulkan/Parameters.hpp"
 #include "vvk/vulkan_wrapper.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cstdio>
 #include <optional>
 
@@ -79,8 +83,8 @@ VkSamplerCreateInfo GenSamplerInfo(TextureKey key) {
     return sampler_info;
 }
 
-VkResult TransImgLayout(const vvk::Queue& queue, vvk::CommandBuffer& cmd,
-                        const ImageParameters& image, VkImageLayout layout) {
+VkResult TransImgLayout(const Device& device, vvk::CommandBuffer& cmd, const ImageParameters& image,
+                        VkImageLayout layout) {
     VkResult result;
     do {
         result = cmd.Begin(VkCommandBufferBeginInfo {
@@ -122,7 +126,7 @@ VkResult TransImgLayout(const vvk::Queue& queue, vvk::CommandBuffer& cmd,
             .commandBufferCount = 1,
             .pCommandBuffers    = cmd.address(),
         };
-        result = queue.Submit(sub_info);
+        result = device.Submit(device.graphics_queue(), sub_info);
     } while (false);
     return result;
 }
@@ -153,23 +157,66 @@ std::optional<vvk::DeviceMemory> AllocateMemory(const vvk::Device& device, vvk::
     return std::nullopt;
 }
 
+// modifiers of wanted the gpu renders and samples format with, in one plane
+std::vector<uint64_t> RenderableModifiers(const vvk::PhysicalDevice& gpu, VkFormat format,
+                                          std::span<const uint64_t> wanted) {
+    VkDrmFormatModifierPropertiesListEXT list {
+        .sType = VK_STRUCTURE_TYPE_DRM_FORMAT_MODIFIER_PROPERTIES_LIST_EXT, .pNext = nullptr
+    };
+    VkFormatProperties2 props { .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2, .pNext = &list };
+    gpu.GetFormatProperties2(format, props);
+    std::vector<VkDrmFormatModifierPropertiesEXT> mods(list.drmFormatModifierCount);
+    list.pDrmFormatModifierProperties = mods.data();
+    gpu.GetFormatProperties2(format, props);
+
+    const VkFormatFeatureFlags need = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+                                      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    std::vector<uint64_t> usable;
+    for (auto& mod : mods) {
+        if (mod.drmFormatModifierPlaneCount != 1) continue;
+        if ((mod.drmFormatModifierTilingFeatures & need) != need) continue;
+        if (std::find(wanted.begin(), wanted.end(), mod.drmFormatModifier) == wanted.end())
+            continue;
+        usable.push_back(mod.drmFormatModifier);
+    }
+    return usable;
+}
+
+// with modifiers a dma-buf the driver picks one of them for, tiling is ignored then
 std::optional<ExImageParameters> CreateExImage(uint32_t width, uint32_t height, VkFormat format,
                                                VkImageTiling       tiling,
                                                VkSamplerCreateInfo sampler_info,
                                                VkImageUsageFlags usage, const vvk::Device& device,
-                                               const vvk::PhysicalDevice& gpu) {
+                                               const vvk::PhysicalDevice& gpu,
+                                               std::span<const uint64_t> modifiers = {}) {
     ExImageParameters image;
+    image.dma_buf = ! modifiers.empty();
+    const VkExternalMemoryHandleTypeFlagBits handle_type =
+        image.dma_buf ? VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT
+                      : VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
     do {
+        VkImageDrmFormatModifierListCreateInfoEXT mod_info {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_LIST_CREATE_INFO_EXT,
+            .pNext = nullptr,
+            .drmFormatModifierCount = (uint32_t)modifiers.size(),
+            .pDrmFormatModifiers    = modifiers.data(),
+        };
         VkExternalMemoryImageCreateInfo ex_info {
             .sType       = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
-            .pNext       = NULL,
-            .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT
+            .pNext       = image.dma_buf ? &mod_info : NULL,
+            .handleTypes = (VkExternalMemoryHandleTypeFlags)handle_type
+        };
+        // dma-bufs get memory of their own, importers expect the image at its start
+        VkMemoryDedicatedAllocateInfo dedicated {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .image = VK_NULL_HANDLE,
+        };
+        VkExportMemoryAllocateInfo ex_mem_info {
+            .sType       = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO,
+            .pNext       = image.dma_buf ? &dedicated : NULL,
+            .handleTypes = (VkExternalMemoryHandleTypeFlags)handle_type,
         };
-        VkExportMemoryAllocateInfo ex_mem_info { .sType =
-                                                     VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO,
-                                                 .pNext = NULL,
-                                                 .handleTypes =
-                                                     VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT };
         VkImageCreateInfo          info {
                      .sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
                      .pNext       = &ex_info,
@@ -179,7 +226,7 @@ std::optional<ExImageParameters> CreateExImage(uint32_t width, uint32_t height,
                      .mipLevels   = 1,
                      .arrayLayers = 1,
                      .samples     = VK_SAMPLE_COUNT_1_BIT,
-                     .tiling      = tiling,
+                     .tiling = image.dma_buf ? VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT : tiling,
                      .usage       = usage,
                      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
                      .queueFamilyIndexCount = 0,
@@ -189,7 +236,8 @@ std::optional<ExImageParameters> CreateExImage(uint32_t width, uint32_t height,
 
         VVK_CHECK_ACT(break, device.CreateImage(info, image.handle));
 
-        image.mem_reqs = device.GetImageMemoryRequirements(*image.handle);
+        image.mem_reqs  = device.GetImageMemoryRequirements(*image.handle);
+        dedicated.image = *image.handle;
 
         if (auto opt = AllocateMemory(
                 device, gpu, image.mem_reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &ex_mem_info);
@@ -218,7 +266,16 @@ std::optional<ExImageParameters> CreateExImage(uint32_t width, uint32_t height,
             VVK_CHECK_ACT(break, device.CreateImageView(createinfo, image.view));
         }
         VVK_CHECK_ACT(break, device.CreateSampler(sampler_info, image.sampler));
-        VVK_CHECK_ACT(break, image.mem.GetMemoryFdKHR(&image.fd));
+        VVK_CHECK_ACT(break, image.mem.GetMemoryFdKHR(&image.fd, handle_type));
+        if (image.dma_buf) {
+            VVK_CHECK_ACT(break, image.handle.GetDrmFormatModifierEXT(&image.drm_modifier));
+            auto layout = image.handle.GetSubresourceLayout(
+                VkImageSubresource { .aspectMask = VK_IMAGE_ASPECT_MEMORY_PLANE_0_BIT_EXT,
+                                     .mipLevel   = 0,
+                                     .arrayLayer = 0 });
+            image.offset    = layout.offset;
+            image.row_pitch = layout.rowPitch;
+        }
 
         return image;
 
@@ -226,53 +283,79 @@ std::optional<ExImageParameters> CreateExImage(uint32_t width, uint32_t height,
     return std::nullopt;
 }
 
+inline VkImageCreateInfo GenImageInfo(VkExtent3D extent, u32 miplevel, VkFormat format,
+                                      VkImageUsageFlags         usage,
+                                      std::span<const uint32_t> queue_families, u32 layers = 1) {
+    // concurrent only when shared across families, avoids ownership transfers
+    return VkImageCreateInfo {
+        .sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext                 = nullptr,
+        .imageType             = VK_IMAGE_TYPE_2D,
+        .format                = format,
+        .extent                = extent,
+        .mipLevels             = miplevel,
+        .arrayLayers           = layers,
+        .samples               = VK_SAMPLE_COUNT_1_BIT,
+        .tiling                = VK_IMAGE_TILING_OPTIMAL,
+        .usage                 = usage,
+        .sharingMode           = queue_families.size() > 1 ? VK_SHARING_MODE_CONCURRENT
+                                                           : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = (u32)queue_families.size(),
+        .pQueueFamilyIndices   = queue_families.data(),
+        .initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+}
+
+// levels from base_level to the last, an array view if there is more than one layer
+inline bool CreateView(const Device& device, const VmaImageParameters& image, VkFormat format,
+                       u32 base_level, vvk::ImageView& view, u32 layers = 1) {
+    VkImageViewCreateInfo createinfo {
+        .sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext    = nullptr,
+        .image    = *image.handle,
+        .viewType = layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D,
+        .format   = format,
+        .subresourceRange =
+            VkImageSubresourceRange {
+                .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel   = base_level,
+                .levelCount     = image.mipmap_level - base_level,
+                .baseArrayLayer = 0,
+                .layerCount     = layers,
+            },
+    };
+    VVK_CHECK_BOOL_RE(device.handle().CreateImageView(createinfo, view));
+    return true;
+}
+
+inline bool CreateViewSampler(const Device& device, VmaImageParameters& image, VkFormat format,
+                              VkSampler sampler, u32 layers = 1) {
+    if (sampler == VK_NULL_HANDLE) return false;
+    if (! CreateView(device, image, format, 0, image.view, layers)) return false;
+    image.sampler = sampler;
+    return true;
+}
+
 inline std::optional<VmaImageParameters>
 CreateImage(const Device& device, VkExtent3D extent, u32 miplevel, VkFormat format,
-            VkSamplerCreateInfo sampler_info, VkImageUsageFlags usage,
-            VmaMemoryUsage mem_usage = VMA_MEMORY_USAGE_GPU_ONLY) {
+            VkSampler sampler, VkImageUsageFlags usage,
+            std::span<const uint32_t> queue_families = {},
+            VmaMemoryUsage mem_usage = VMA_MEMORY_USAGE_GPU_ONLY, u32 layers = 1,
+            VmaPool pool = VK_NULL_HANDLE) {
     VmaImageParameters image;
     do {
-        VkImageCreateInfo info {
-            .sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-            .pNext                 = nullptr,
-            .imageType             = VK_IMAGE_TYPE_2D,
-            .format                = format,
-            .extent                = extent,
-            .mipLevels             = miplevel,
-            .arrayLayers           = 1,
-            .samples               = VK_SAMPLE_COUNT_1_BIT,
-            .tiling                = VK_IMAGE_TILING_OPTIMAL,
-            .usage                 = usage,
-            .sharingMode           = VK_SHARING_MODE_EXCLUSIVE,
-            .queueFamilyIndexCount = 0,
-            .initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED,
-        };
-        image.extent = info.extent;
+        VkImageCreateInfo info =
+            GenImageInfo(extent, miplevel, format, usage, queue_families, layers);
+        image.extent           = info.extent;
         VmaAllocationCreateInfo vma_info {};
         vma_info.usage = mem_usage;
+        vma_info.pool  = pool;
         VVK_CHECK_ACT(break,
                       vvk::CreateImage(device.vma_allocator(), info, vma_info, image.handle));
 
         image.mipmap_level = miplevel;
-        {
-            VkImageViewCreateInfo createinfo {
-                .sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-                .pNext    = nullptr,
-                .image    = *image.handle,
-                .viewType = VK_IMAGE_VIEW_TYPE_2D,
-                .format   = format,
-                .subresourceRange =
-                    VkImageSubresourceRange {
-                        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-                        .baseMipLevel   = 0,
-                        .levelCount     = miplevel,
-                        .baseArrayLayer = 0,
-                        .layerCount     = 1,
-                    },
-            };
-            VVK_CHECK_ACT(break, device.handle().CreateImageView(createinfo, image.view));
-        }
-        VVK_CHECK_ACT(break, device.handle().CreateSampler(sampler_info, image.sampler));
+        image.usage        = usage;
+        if (! CreateViewSampler(device, image, format, sampler, layers)) break;
         return image;
     } while (false);
     /*
@@ -283,84 +366,59 @@ CreateImage(const Device& device, VkExtent3D extent, u32 miplevel, VkFormat form
     return std::nullopt;
 }
 
-inline VkResult CopyImageData(std::span<const BufferParameters> in_bufs,
-                              std::span<const VkExtent3D> in_exts, const vvk::Queue& queue,
-                              vvk::CommandBuffer& cmd, const ImageParameters& image) {
-    VkResult result;
-    do {
-        result = cmd.Begin(VkCommandBufferBeginInfo {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .pNext = nullptr,
-            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-        });
-        if (result != VK_SUCCESS) break;
+// the first level an image keeps and the first one uploaded with the scene, level n of the
+// chain is max(w >> n, 1) by max(h >> n, 1)
+// an output sized level has a texel per pixel over the whole screen, the larger ones are never
+// sampled, and levels bigger than the tail wait for RecordStream
+void PickLevels(i32 w, i32 h, usize levels, VkExtent2D out, u32 bias, usize& base,
+                usize& tail) {
+    auto size = [](i32 v, usize n) { return std::max(v >> n, 1); };
+    base      = 0;
+    while (base + 1 < levels && size(w, base + 1) >= (i32)out.width &&
+           size(h, base + 1) >= (i32)out.height)
+        base++;
+    base = std::min(base + bias, levels > 0 ? levels - 1 : 0);
+    tail = base;
+    while (tail + 1 < levels &&
+           std::max(size(w, tail), size(h, tail)) > TextureCache::StreamTailSize)
+        tail++;
+}
 
-        VkImageSubresourceRange subresourceRange {
-            .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel   = 0,
-            .levelCount     = (uint32_t)in_bufs.size(),
-            .baseArrayLayer = 0,
-            .layerCount     = 1,
-        };
-        {
-            VkImageMemoryBarrier in_bar {
-                .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                .pNext            = nullptr,
-                .srcAccessMask    = VK_ACCESS_MEMORY_WRITE_BIT,
-                .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
-                .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
-                .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                .image            = image.handle,
-                .subresourceRange = subresourceRange,
-            };
-            cmd.PipelineBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_DEPENDENCY_BY_REGION_BIT,
-                                in_bar);
-        }
-        VkBufferImageCopy copy {
-            .imageSubresource =
-                VkImageSubresourceLayers {
-                    .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .baseArrayLayer = 0,
-                    .layerCount     = 1,
-                },
-        };
-        for (usize i = 0; i < in_bufs.size(); i++) {
-            copy.imageSubresource.mipLevel = (u32)i;
-            copy.imageExtent               = in_exts[i];
-            cmd.CopyBufferToImage(
-                in_bufs[i].handle, image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy);
-        }
-        {
-            VkImageMemoryBarrier out_bar {
-                .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                .pNext            = nullptr,
-                .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
-                .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT,
-                .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                .image            = image.handle,
-                .subresourceRange = subresourceRange,
-            };
-            cmd.PipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                VK_DEPENDENCY_BY_REGION_BIT,
-                                out_bar);
-        }
-        result = cmd.End();
-        if (result != VK_SUCCESS) break;
+// bytes of a w x h level, compressed formats take whole 4x4 blocks
+VkDeviceSize LevelSize(TextureFormat format, i32 w, i32 h) {
+    VkDeviceSize texels = (VkDeviceSize)w * (VkDeviceSize)h;
+    VkDeviceSize blocks = (VkDeviceSize)((w + 3) / 4) * (VkDeviceSize)((h + 3) / 4);
+    switch (format) {
+    case TextureFormat::BC1: return blocks * 8;
+    case TextureFormat::BC2:
+    case TextureFormat::BC3: return blocks * 16;
+    case TextureFormat::R8: return texels;
+    case TextureFormat::RG8: return texels * 2;
+    case TextureFormat::RGB8: return texels * 3;
+    case TextureFormat::RGBA8:
+    default: return texels * 4;
+    }
+}
 
-        VkSubmitInfo sub_info {
-            .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .pNext              = nullptr,
-            .commandBufferCount = 1,
-            .pCommandBuffers    = cmd.address(),
-        };
-        result = queue.Submit(sub_info);
-    } while (false);
-    return result;
+// writes a mip to upload memory, zeros if it can't be read
+inline void FillStaging(const Image& image, const ImageData& data, void* raw, std::string_view key,
+                        usize level) {
+    if (data.fill) {
+        std::span<uint8_t> dst { (uint8_t*)raw, (usize)data.size };
+        if (! data.fill(dst)) {
+            LOG_ERROR("can't read mipmap %d of \"%.*s\"", (int)level, (int)key.size(), key.data());
+            std::memset(raw, 0, dst.size());
+        }
+    } else {
+        memcpy(raw, image.data(data), (usize)data.size);
+    }
 }
+
+// copy offsets must be a multiple of 4 and of the texel block size (3 for rgb8, 16 for bc3)
+constexpr VkDeviceSize staging_align { 48 };
+constexpr VkDeviceSize staging_chunk_size { 32 * 1024 * 1024 };
+constexpr uint64_t     vk_wait_time { 10u * 1000u * 1000000u };
+
 } // namespace
 
 std::size_t TextureKey::HashValue(const TextureKey& k) {
@@ -378,7 +436,8 @@ std::size_t TextureKey::HashValue(const TextureKey& k) {
 }
 
 std::optional<ExImageParameters> TextureCache::CreateExTex(uint32_t width, uint32_t height,
-                                                           VkFormat format, VkImageTiling tiling) {
+                                                           VkFormat format, VkImageTiling tiling,
+                                                           std::span<const uint64_t> modifiers) {
     VkSamplerCreateInfo sampler_info {
         .sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
         .pNext                   = nullptr,
@@ -398,45 +457,99 @@ std::optional<ExImageParameters> TextureCache::CreateExTex(uint32_t width, uint3
         .unnormalizedCoordinates = false,
     };
 
-    auto opt = CreateExImage(width,
-                             height,
-                             format,
-                             tiling,
-                             sampler_info,
-                             VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-                                 VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-                             m_device.device(),
-                             m_device.gpu());
+    std::vector<uint64_t> usable;
+    if (! modifiers.empty() && m_device.dma_buf()) {
+        usable = RenderableModifiers(m_device.gpu(), format, modifiers);
+        if (usable.empty()) LOG_INFO("the gpu renders to no drm format modifier the host imports");
+    }
+    const VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT |
+                                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                    VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    const auto& gpu = m_device.gpu();
+    auto        opt = CreateExImage(
+        width, height, format, tiling, sampler_info, usage, m_device.device(), gpu, usable);
+    if (! opt.has_value() && ! usable.empty()) {
+        LOG_ERROR("dma-buf export failed, exporting an opaque fd");
+        opt = CreateExImage(
+            width, height, format, tiling, sampler_info, usage, m_device.device(), gpu);
+    }
     if (opt.has_value()) {
         const auto& eximg = opt.value();
 
         if (! m_tex_cmd) allocateCmd();
-        TransImgLayout(m_device.graphics_queue().handle, m_tex_cmd, eximg, VK_IMAGE_LAYOUT_GENERAL);
-        VVK_CHECK(m_device.handle().WaitIdle());
+        TransImgLayout(m_device, m_tex_cmd, eximg, VK_IMAGE_LAYOUT_GENERAL);
+        VVK_CHECK(m_device.WaitIdle());
     }
     return opt;
 }
 
-ImageSlotsRef TextureCache::CreateTex(Image& image) {
-    if (exists(m_tex_map, image.key)) {
-        return m_tex_map.at(image.key);
+ImageSlotsRef TextureCache::CreateTex(const std::shared_ptr<Image>& pimage, bool layered) {
+    TRACE_ZONE("TextureCache::CreateTex");
+    auto&       image = *pimage;
+    std::string key   = image.key;
+    if (layered) key.append(LayeredKeySuffix);
+    if (exists(m_tex_map, key)) {
+        counters::Add(counters::Counter::TextureHits);
+        return m_tex_map.at(key);
+    }
+    const TexHash retain_key = RetainKey(image, layered);
+    if (auto it = m_retained.find(retain_key); retain_key != 0 && it != m_retained.end()) {
+        counters::Add(counters::Counter::TextureRetainedHits);
+        m_retained_bytes -= it->second.bytes;
+        m_tex_map[key] = std::move(it->second.slots);
+        m_retained.erase(it);
+        m_retain_keys[key] = retain_key;
+        return m_tex_map[key];
     }
 
-    ImageSlots img_slots;
+    counters::Add(counters::Counter::TextureMisses);
+
+    // layers must match in size and mips, the header promised it
+    const u32 layers = layered ? (u32)image.slots.size() : 1;
+    if (layered && ! image.slots.empty()) {
+        auto& first = image.slots[0];
+        for (auto& slot : image.slots) {
+            if (slot.width != first.width || slot.height != first.height ||
+                slot.mipmaps.size() != first.mipmaps.size()) {
+                LOG_ERROR("sprite images of \"%s\" differ in size, can't be layers", key.c_str());
+                return {};
+            }
+        }
+    }
 
-    if (! m_tex_cmd) allocateCmd();
+    ImageSlots img_slots;
 
-    img_slots.slots.resize(image.slots.size());
+    img_slots.slots.resize(layered ? 1 : image.slots.size());
 
     auto& sam = image.header.sample;
 
+    std::array<uint32_t, 2> families { m_device.graphics_queue().family_index,
+                                       m_device.transfer_queue().family_index };
+    std::span<const uint32_t> share_families;
+    if (families[0] != families[1]) share_families = families;
+
     for (usize i = 0; i < image.slots.size(); i++) {
-        auto& image_paras   = img_slots.slots[i];
-        auto& image_slot    = image.slots[i];
-        auto  mipmap_levels = image_slot.mipmaps.size();
+        auto& image_paras = img_slots.slots[layered ? 0 : i];
+        auto& image_slot  = image.slots[i];
+        // the layer of a layered image, the first slot creates it
+        const u32 layer = layered ? (u32)i : 0;
 
         // check data
         if (! image_slot) return {};
+
+        const auto& mips = image_slot.mipmaps;
+        usize       base { 0 }, tail { 0 };
+        if (! layered) {
+            PickLevels(mips[0].width,
+                       mips[0].height,
+                       mips.size(),
+                       m_device.out_extent(),
+                       m_level_bias,
+                       base,
+                       tail);
+        }
+        auto mipmap_levels = mips.size() - base;
+
         VkSamplerCreateInfo sampler_info {
             .sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
             .pNext                   = nullptr,
@@ -457,48 +570,446 @@ ImageSlotsRef TextureCache::CreateTex(Image& image) {
         };
         VkFormat   format = ToVkType(image.header.format);
         VkExtent3D ext { (u32)image_slot.width, (u32)image_slot.height, 1 };
+        if (base > 0) ext = { (u32)mips[base].width, (u32)mips[base].height, 1 };
 
-        if (auto opt = CreateImage(m_device,
+        if (layer == 0) {
+            auto opt = CreateImage(m_device,
                                    ext,
                                    (u32)mipmap_levels,
                                    format,
-                                   sampler_info,
-                                   VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-            opt.has_value()) {
+                                   sampler(sampler_info),
+                                   VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                   share_families,
+                                   VMA_MEMORY_USAGE_GPU_ONLY,
+                                   layers);
+            if (! opt.has_value()) break;
             image_paras = std::move(opt.value());
-        } else
-            break;
+        }
 
-        std::vector<VmaBufferParameters> stage_bufs;
-        std::vector<VkExtent3D>          extents;
-
-        for (usize j = 0; j < image_slot.mipmaps.size(); j++) {
-            auto&               image_data = image_slot.mipmaps[j];
-            VmaBufferParameters buf;
-            (void)CreateStagingBuffer(m_device.vma_allocator(), (u32)image_data.size, buf);
-            {
-                void* v_data;
-                VVK_CHECK(buf.handle.MapMemory(&v_data));
-                memcpy(v_data, image_data.data.get(), (u32)image_data.size);
-                buf.handle.UnMapMemory();
+        // the levels not uploaded yet are never sampled through this view
+        if (tail > base) {
+            vvk::ImageView view;
+            if (! CreateView(m_device, image_paras, format, (u32)(tail - base), view)) break;
+            image_paras.view = std::move(view);
+            m_streams.push_back(StreamTex {
+                .key      = image.key,
+                .slot     = i,
+                .format   = format,
+                .image    = pimage,
+                .base     = base,
+                .resident = (u32)(tail - base),
+            });
+        }
+
+        for (usize j = tail; j < mips.size(); j++) {
+            auto&        image_data = mips[j];
+            VkBuffer     src;
+            VkDeviceSize offset;
+            void*        raw;
+            if (! allocateStaging((VkDeviceSize)image_data.size, src, offset, raw)) return {};
+            FillStaging(image, image_data, raw, image.key, j);
+
+            m_pending_copies.push_back(PendingCopy {
+                .src = src,
+                .dst = *image_paras.handle,
+                .region =
+                    VkBufferImageCopy {
+                        .bufferOffset = offset,
+                        .imageSubresource =
+                            VkImageSubresourceLayers {
+                                .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+                                .mipLevel       = (u32)(j - base),
+                                .baseArrayLayer = layer,
+                                .layerCount     = 1,
+                            },
+                        .imageExtent = { (u32)image_data.width, (u32)image_data.height, 1 },
+                    },
+            });
+        }
+        if (layer > 0) continue;
+        m_pending_uploads.push_back(VkImageMemoryBarrier {
+            .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext               = nullptr,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = *image_paras.handle,
+            .subresourceRange =
+                VkImageSubresourceRange {
+                    .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel   = 0,
+                    .levelCount     = (u32)mipmap_levels,
+                    .baseArrayLayer = 0,
+                    .layerCount     = layers,
+                },
+        });
+    }
+    if (retain_key != 0) m_retain_keys[key] = retain_key;
+    m_tex_map[key] = std::move(img_slots);
+    return m_tex_map[key];
+}
+
+TexHash TextureCache::RetainKey(const Image& image, bool layered) const {
+    if (image.content == 0) return 0;
+    // what else the levels and sampler come from
+    auto&       sam = image.header.sample;
+    std::size_t seed { image.content };
+    utils::hash_combine(seed, layered);
+    utils::hash_combine(seed, m_device.out_extent().width);
+    utils::hash_combine(seed, m_device.out_extent().height);
+    utils::hash_combine(seed, m_level_bias);
+    utils::hash_combine(seed, sam.magFilter);
+    utils::hash_combine(seed, sam.minFilter);
+    utils::hash_combine(seed, sam.wrapS);
+    utils::hash_combine(seed, sam.wrapT);
+    return seed != 0 ? seed : 1;
+}
+
+void TextureCache::retain() {
+    Set<VkImage> pending;
+    for (auto& b : m_pending_uploads) pending.insert(b.image);
+
+    usize kept { 0 };
+    for (auto& item : m_tex_map) {
+        auto& key   = item.first;
+        auto& slots = item.second;
+        auto  rk    = m_retain_keys.find(key);
+        if (rk == m_retain_keys.end() || exists(m_retained, rk->second)) continue;
+        // only whole images, not those waiting for their upload or levels still streaming in
+        bool streaming = std::any_of(m_streams.begin(), m_streams.end(), [&key](auto& st) {
+            return st.key == key;
+        });
+        bool         whole = ! streaming && ! slots.slots.empty();
+        VkDeviceSize bytes { 0 };
+        for (auto& slot : slots.slots) {
+            if (! whole) break;
+            if (! slot.handle || exists(pending, *slot.handle)) {
+                whole = false;
+                break;
             }
-            stage_bufs.emplace_back(std::move(buf));
-            extents.push_back(VkExtent3D { (u32)image_data.width, (u32)image_data.height, 1 });
+            VmaAllocationInfo info {};
+            vmaGetAllocationInfo(m_device.vma_allocator(), slot.handle.Allocation(), &info);
+            bytes += info.size;
         }
+        if (! whole || bytes > m_retain_budget) continue;
+        m_retained_bytes += bytes;
+        m_retained[rk->second] = RetainedTex {
+            .slots = std::move(slots),
+            .bytes = bytes,
+            .stamp = ++m_retain_stamp,
+        };
+        kept++;
+    }
+    m_retain_keys.clear();
+    if (m_retained_bytes > m_retain_budget) TrimRetained(m_retained_bytes - m_retain_budget);
+    if (kept > 0) {
+        LOG_INFO("retained %d textures, %d in all, %.1fm",
+                 (int)kept,
+                 (int)m_retained.size(),
+                 (double)m_retained_bytes / (1024.0 * 1024.0));
+    }
+}
+
+void TextureCache::SetRetainBudget(VkDeviceSize v) {
+    m_retain_budget = v;
+    if (m_retained_bytes > m_retain_budget) TrimRetained(m_retained_bytes - m_retain_budget);
+}
+
+void TextureCache::TrimRetained(VkDeviceSize bytes) {
+    VkDeviceSize freed { 0 };
+    while (freed < bytes && ! m_retained.empty()) {
+        auto oldest = std::min_element(m_retained.begin(), m_retained.end(), [](auto& a, auto& b) {
+            return a.second.stamp < b.second.stamp;
+        });
+        freed += oldest->second.bytes;
+        m_retained_bytes -= oldest->second.bytes;
+        m_retained.erase(oldest);
+        counters::Add(counters::Counter::TextureEvictions);
+    }
+    counters::Add(counters::Counter::TextureEvictedBytes, freed);
+}
+
+bool TextureCache::allocateStaging(VkDeviceSize size, VkBuffer& buf, VkDeviceSize& offset,
+                                   void*& raw) {
+    // chunks still read by the gpu can't be refilled
+    if (m_upload_inflight) waitUploads();
+
+    StagingChunk* chunk { nullptr };
+    if (! m_staging_chunks.empty()) {
+        auto&        last  = m_staging_chunks.back();
+        VkDeviceSize begin = (last.used + staging_align - 1) / staging_align * staging_align;
+        if (begin + size <= last.buf.req_size) {
+            chunk  = &last;
+            offset = begin;
+        }
+    }
+    if (chunk == nullptr) {
+        StagingChunk new_chunk;
+        if (! CreateStagingBuffer(
+                m_device.vma_allocator(), std::max(size, staging_chunk_size), new_chunk.buf))
+            return false;
+        VVK_CHECK_BOOL_RE(new_chunk.buf.handle.MapMemory(&new_chunk.raw));
+        m_staging_chunks.emplace_back(std::move(new_chunk));
+        chunk  = &m_staging_chunks.back();
+        offset = 0;
+    }
+    chunk->used = offset + size;
+    buf         = *chunk->buf.handle;
+    raw         = (uint8_t*)chunk->raw + offset;
+    counters::Add(counters::Counter::TextureUploadBytes, size);
+    return true;
+}
 
-        CopyImageData(transform<VmaBufferParameters>(stage_bufs,
-                                                     [](BufferParameters e) {
-                                                         return e;
-                                                     }),
-                      extents,
-                      m_device.graphics_queue().handle,
-                      m_tex_cmd,
-                      image_paras);
+VkSemaphore TextureCache::SubmitUploads() {
+    if (m_pending_uploads.empty()) return VK_NULL_HANDLE;
+
+    if (! m_upload_cmd) {
+        const auto& pool = m_device.transfer_cmd_pool();
+        VVK_CHECK_ACT(return VK_NULL_HANDLE,
+                      pool.Allocate(1, VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_upload_cmds));
+        m_upload_cmd = vvk::CommandBuffer(m_upload_cmds[0], m_device.handle().Dispatch());
+
+        VVK_CHECK_ACT(return VK_NULL_HANDLE,
+                      m_device.handle().CreateFence(
+                          VkFenceCreateInfo {
+                              .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                              .pNext = nullptr,
+                              .flags = 0,
+                          },
+                          m_upload_fence));
+        VkSemaphoreCreateInfo ci { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+                                   .pNext = nullptr,
+                                   .flags = 0 };
+        VVK_CHECK_ACT(return VK_NULL_HANDLE,
+                      m_device.handle().CreateSemaphore(ci, m_upload_sem));
+    }
+    waitUploads();
+    VVK_CHECK_ACT(return VK_NULL_HANDLE, m_upload_fence.Reset());
+
+    auto& cmd = m_upload_cmd;
+    VVK_CHECK_ACT(return VK_NULL_HANDLE,
+                  cmd.Begin(VkCommandBufferBeginInfo {
+                      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                      .pNext = nullptr,
+                      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                  }));
+    for (auto& bar : m_pending_uploads) {
+        bar.srcAccessMask = 0;
+        bar.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bar.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+        bar.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    }
+    cmd.PipelineBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        0,
+                        {},
+                        {},
+                        m_pending_uploads);
+    for (auto& copy : m_pending_copies) {
+        cmd.CopyBufferToImage(
+            copy.src, copy.dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.region);
+    }
+    // a transfer queue has no shader stages, the semaphore wait carries the dependency
+    for (auto& bar : m_pending_uploads) {
+        bar.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bar.dstAccessMask = 0;
+        bar.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        bar.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    cmd.PipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        0,
+                        {},
+                        {},
+                        m_pending_uploads);
+    VVK_CHECK_ACT(return VK_NULL_HANDLE, cmd.End());
+
+    VkSubmitInfo sub_info {
+        .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext                = nullptr,
+        .commandBufferCount   = 1,
+        .pCommandBuffers      = cmd.address(),
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores    = m_upload_sem.address(),
+    };
+    VVK_CHECK_ACT(return VK_NULL_HANDLE,
+                  m_device.Submit(m_device.transfer_queue(), sub_info, *m_upload_fence));
+    LOG_INFO("upload %d textures, %d copies", m_pending_uploads.size(), m_pending_copies.size());
+
+    m_upload_inflight = true;
+    m_pending_copies.clear();
+    m_pending_uploads.clear();
+    return *m_upload_sem;
+}
 
-        m_device.handle().WaitIdle();
+void TextureCache::RecordPendingTransitions(vvk::CommandBuffer& cmd) {
+    if (m_pending_transitions.empty()) return;
+    cmd.PipelineBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        0,
+                        {},
+                        {},
+                        m_pending_transitions);
+    m_pending_transitions.clear();
+}
+
+TextureCache::TexEstimate TextureCache::EstimateTex(const ImageHeader& header) const {
+    TexEstimate est;
+    i32         w = header.mipWidth, h = header.mipHeight;
+    if (w <= 0 || h <= 0 || header.count <= 0) return est;
+    // sprites come with one level
+    usize levels = (usize)std::max(header.mipCount, 1);
+    usize base { 0 }, tail { 0 };
+    PickLevels(w, h, levels, m_device.out_extent(), m_level_bias, base, tail);
+    for (usize n = base; n < levels; n++) {
+        VkDeviceSize size =
+            LevelSize(header.format, std::max(w >> n, 1), std::max(h >> n, 1)) * (u32)header.count;
+        est.device += size;
+        if (n >= tail) est.staging += size;
     }
-    m_tex_map[image.key] = std::move(img_slots);
-    return m_tex_map[image.key];
+    return est;
+}
+
+const ImageSlots* TextureCache::Find(std::string_view key) const {
+    auto it = m_tex_map.find(key);
+    return it != m_tex_map.end() ? &it->second : nullptr;
+}
+
+void TextureCache::RecordStream(vvk::CommandBuffer& cmd, usize frames_in_flight) {
+    m_stream_frame++;
+    // the frame that copied from it was waited for before its slot was reused
+    std::erase_if(m_stream_staging, [this, frames_in_flight](const StreamStaging& st) {
+        return st.frame + frames_in_flight <= m_stream_frame;
+    });
+    if (m_streams.empty()) return;
+
+    auto& st = m_streams.front();
+    auto  it = m_tex_map.find(st.key);
+    if (it == m_tex_map.end() || st.slot >= it->second.slots.size() || st.resident == 0) {
+        m_streams.pop_front();
+        return;
+    }
+    auto&       paras = it->second.slots[st.slot];
+    const u32   level = st.resident - 1;
+    const auto& data  = st.image->slots[st.slot].mipmaps[st.base + level];
+
+    // on failure the image keeps sampling the levels it has
+    StreamStaging staging { .frame = m_stream_frame };
+    void*         raw { nullptr };
+    if (! CreateStagingBuffer(m_device.vma_allocator(), (usize)data.size, staging.buf) ||
+        staging.buf.handle.MapMemory(&raw) != VK_SUCCESS) {
+        LOG_ERROR("can't stream mipmap %d of \"%s\"", (int)level, st.key.c_str());
+        m_streams.pop_front();
+        return;
+    }
+    FillStaging(*st.image, data, raw, st.key, st.base + level);
+    staging.buf.handle.UnMapMemory();
+    counters::Add(counters::Counter::TextureUploadBytes, (u64)data.size);
+
+    vvk::ImageView view;
+    if (! CreateView(m_device, paras, st.format, level, view)) {
+        m_streams.pop_front();
+        return;
+    }
+
+    VkImageMemoryBarrier bar {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext               = nullptr,
+        .srcAccessMask       = 0,
+        .dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = *paras.handle,
+        .subresourceRange =
+            VkImageSubresourceRange {
+                .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel   = level,
+                .levelCount     = 1,
+                .baseArrayLayer = 0,
+                .layerCount     = 1,
+            },
+    };
+    // the level was never sampled, its content is discarded
+    cmd.PipelineBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, bar);
+    cmd.CopyBufferToImage(*staging.buf.handle,
+                          *paras.handle,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          VkBufferImageCopy {
+                              .bufferOffset = 0,
+                              .imageSubresource =
+                                  VkImageSubresourceLayers {
+                                      .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+                                      .mipLevel       = level,
+                                      .baseArrayLayer = 0,
+                                      .layerCount     = 1,
+                                  },
+                              .imageExtent = { (u32)data.width, (u32)data.height, 1 },
+                          });
+    bar.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bar.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    bar.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    bar.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    cmd.PipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        0,
+                        bar);
+
+    m_retired_views.push_back(std::move(paras.view));
+    paras.view = std::move(view);
+    m_stream_staging.push_back(std::move(staging));
+    m_stream_generation++;
+
+    st.resident = level;
+    if (level == 0) {
+        LOG_INFO("streamed \"%s\", %dx%d", st.key.c_str(), data.width, data.height);
+        m_streams.pop_front();
+    }
+}
+
+void TextureCache::ReleaseFinishedUploads() {
+    if (! m_upload_inflight || m_upload_fence.GetStatus() != VK_SUCCESS) return;
+    m_upload_inflight = false;
+
+    // keep one chunk for the next batch
+    if (! m_staging_chunks.empty()) {
+        auto it = std::find_if(m_staging_chunks.begin(), m_staging_chunks.end(), [](auto& c) {
+            return c.buf.req_size == staging_chunk_size;
+        });
+        if (it != m_staging_chunks.end()) {
+            StagingChunk keep = std::move(*it);
+            keep.used         = 0;
+            m_staging_chunks.erase(it);
+            for (auto& c : m_staging_chunks) c.buf.handle.UnMapMemory();
+            m_staging_chunks.clear();
+            m_staging_chunks.emplace_back(std::move(keep));
+            return;
+        }
+    }
+    for (auto& c : m_staging_chunks) c.buf.handle.UnMapMemory();
+    m_staging_chunks.clear();
+}
+
+void TextureCache::waitUploads() {
+    if (! m_upload_inflight) return;
+    VVK_CHECK(m_upload_fence.Wait(vk_wait_time));
+    ReleaseFinishedUploads();
+}
+
+VkSampler TextureCache::sampler(const VkSamplerCreateInfo& info) {
+    SamplerKey key { .mag_filter  = info.magFilter,
+                     .min_filter  = info.minFilter,
+                     .mipmap_mode = info.mipmapMode,
+                     .address_u   = info.addressModeU,
+                     .address_v   = info.addressModeV,
+                     .address_w   = info.addressModeW,
+                     .max_lod     = info.maxLod };
+    if (auto it = m_samplers.find(key); it != m_samplers.end()) return *it->second;
+
+    vvk::Sampler made;
+    VVK_CHECK_ACT(return VK_NULL_HANDLE, m_device.handle().CreateSampler(info, made));
+    return *m_samplers.emplace(key, std::move(made)).first->second;
 }
 
 void TextureCache::allocateCmd() {
@@ -507,33 +1018,82 @@ void TextureCache::allocateCmd() {
     m_tex_cmd = vvk::CommandBuffer(m_tex_cmds[0], m_device.handle().Dispatch());
 }
 
-std::optional<VmaImageParameters> TextureCache::CreateTex(TextureKey tex_key) {
+std::optional<VmaImageParameters> TextureCache::CreateTex(TextureKey tex_key, QueryTex* alias) {
     VmaImageParameters image_paras;
     do {
         VkSamplerCreateInfo sam_info = GenSamplerInfo(tex_key);
         VkFormat            format   = ToVkType(tex_key.format);
         VkExtent3D          ext { (u32)tex_key.width, (u32)tex_key.height, 1 };
-
-        if (auto opt =
-                CreateImage(m_device,
-                            ext,
-                            tex_key.mipmap_level,
-                            format,
-                            sam_info,
-                            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-                                VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
-            opt.has_value()) {
+        VkImageUsageFlags   usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                  VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        // mips of rgba8 targets may be made in a compute shader, see MipCompute
+        if (tex_key.mipmap_level > 1 && format == VK_FORMAT_R8G8B8A8_UNORM)
+            usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+
+        if (alias != nullptr) {
+            auto& dld  = m_device.handle().Dispatch();
+            auto  info = GenImageInfo(ext, tex_key.mipmap_level, format, usage, {});
+            // no allocation in the owner, destroying the image leaves the block alone
+            vvk::VmaOwner owner;
+            owner.allocator = m_device.vma_allocator();
+            VkImage object;
+            VVK_CHECK_ACT(break, dld.vkCreateImage(*m_device.handle(), &info, nullptr, &object));
+            image_paras.handle       = vvk::VmaImage(object, owner, vvk::empty_int);
+            image_paras.extent       = ext;
+            image_paras.mipmap_level = tex_key.mipmap_level;
+            image_paras.usage        = usage;
+
+            auto reqs = m_device.handle().GetImageMemoryRequirements(object);
+            if (! placeAlias(*alias, reqs)) break;
+            VVK_CHECK_ACT(break,
+                          vmaBindImageMemory2(m_device.vma_allocator(),
+                                              m_alias_blocks[(usize)alias->block].allocation,
+                                              alias->offset,
+                                              object,
+                                              nullptr));
+            if (! CreateViewSampler(m_device, image_paras, format, sampler(sam_info))) break;
+        } else {
+            auto info = GenImageInfo(ext, tex_key.mipmap_level, format, usage, {});
+            auto make = [&](VmaPool pool) {
+                return CreateImage(m_device,
+                                   ext,
+                                   tex_key.mipmap_level,
+                                   format,
+                                   sampler(sam_info),
+                                   usage,
+                                   {},
+                                   VMA_MEMORY_USAGE_GPU_ONLY,
+                                   1,
+                                   pool);
+            };
+            // images the pool has no room for get memory of their own
+            auto opt = make(targetPool(info));
+            if (! opt.has_value() && m_target_pool != VK_NULL_HANDLE) opt = make(VK_NULL_HANDLE);
+            if (! opt.has_value()) break;
             image_paras = std::move(opt.value());
-        } else
-            break;
-
-        if (! m_tex_cmd) allocateCmd();
-        TransImgLayout(m_device.graphics_queue().handle,
-                       m_tex_cmd,
-                       image_paras,
-                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        }
 
-        VVK_CHECK_ACT(break, m_device.handle().WaitIdle());
+        // recorded in the next graphics upload instead of a blocking submit per target
+        m_pending_transitions.push_back(VkImageMemoryBarrier {
+            .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext               = nullptr,
+            .srcAccessMask       = 0,
+            .dstAccessMask       = VK_ACCESS_SHADER_READ_BIT,
+            .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = *image_paras.handle,
+            .subresourceRange =
+                VkImageSubresourceRange {
+                    .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel   = 0,
+                    .levelCount     = VK_REMAINING_MIP_LEVELS,
+                    .baseArrayLayer = 0,
+                    .layerCount     = VK_REMAINING_ARRAY_LAYERS,
+                },
+        });
         return image_paras;
     } while (false);
     return std::nullopt;
@@ -541,38 +1101,141 @@ std::optional<VmaImageParameters> TextureCache::CreateTex(TextureKey tex_key) {
 
 TextureCache::TextureCache(const Device& device): m_device(device) {}
 
-TextureCache::~TextureCache() {};
+TextureCache::~TextureCache() {
+    waitUploads();
+    for (auto& c : m_staging_chunks) c.buf.handle.UnMapMemory();
+    m_query_texs.clear();
+    freeAliasBlocks();
+    freeTargetPool();
+};
+
+struct TextureCache::Retired : NoCopy, NoMove {
+    VmaAllocator allocator { VK_NULL_HANDLE };
+
+    std::deque<StreamTex>                  streams;
+    std::vector<StreamStaging>             stream_staging;
+    std::vector<vvk::ImageView>            views;
+    Map<std::string, ImageSlots>           tex_map;
+    Map<std::string, ImageParameters>      aliased_images;
+    std::vector<std::unique_ptr<QueryTex>> query_texs;
+    std::vector<AliasBlock>                alias_blocks;
+    VmaPool                                target_pool { VK_NULL_HANDLE };
+
+    Retired() = default;
+    ~Retired() {
+        TRACE_ZONE("freeRetiredTextures");
+        // images before the memory they are placed in
+        streams.clear();
+        stream_staging.clear();
+        views.clear();
+        tex_map.clear();
+        aliased_images.clear();
+        query_texs.clear();
+        for (auto& block : alias_blocks) vmaFreeMemory(allocator, block.allocation);
+        if (target_pool != VK_NULL_HANDLE) vmaDestroyPool(allocator, target_pool);
+    }
+};
+
+void TextureCache::Clear() { Retire(); }
+
+std::shared_ptr<TextureCache::Retired> TextureCache::Retire() {
+    waitUploads();
+    retain();
+    for (auto& c : m_staging_chunks) c.used = 0;
+    m_pending_copies.clear();
+    m_pending_uploads.clear();
+    m_pending_transitions.clear();
+
+    auto old       = std::make_shared<Retired>();
+    old->allocator = m_device.vma_allocator();
+    old->streams.swap(m_streams);
+    old->stream_staging.swap(m_stream_staging);
+    old->views.swap(m_retired_views);
+    old->tex_map.swap(m_tex_map);
+    old->aliased_images.swap(m_aliased_images);
+    old->query_texs.swap(m_query_texs);
+    old->alias_blocks.swap(m_alias_blocks);
+    old->target_pool = std::exchange(m_target_pool, VK_NULL_HANDLE);
+    m_query_map.clear();
+    m_persist_keys.clear();
+    return old;
+}
 
-void TextureCache::Clear() {
-    m_tex_map.clear();
+void TextureCache::ClearTargets() {
+    m_pending_transitions.clear();
     m_query_texs.clear();
     m_query_map.clear();
+    m_persist_keys.clear();
+    m_aliased_images.clear();
+    freeAliasBlocks();
+    freeTargetPool();
+}
+
+void TextureCache::PlanTargets(VkDeviceSize bytes) { m_target_bytes = bytes; }
+
+VmaPool TextureCache::targetPool(const VkImageCreateInfo& image_info) {
+    constexpr VkDeviceSize min_block { 8ull * 1024 * 1024 };
+    constexpr VkDeviceSize max_block { 256ull * 1024 * 1024 };
+    if (m_target_bytes == 0) return VK_NULL_HANDLE;
+
+    VmaAllocationCreateInfo vma_info {};
+    vma_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    u32 type { 0 };
+    if (vmaFindMemoryTypeIndexForImageInfo(
+            m_device.vma_allocator(), &image_info, &vma_info, &type) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+    if (m_target_pool != VK_NULL_HANDLE)
+        return type == m_target_pool_type ? m_target_pool : VK_NULL_HANDLE;
+
+    // an eighth more for alignment between the targets
+    VmaPoolCreateInfo info {};
+    info.memoryTypeIndex = type;
+    info.blockSize       = std::clamp(m_target_bytes + m_target_bytes / 8, min_block, max_block);
+    VVK_CHECK_ACT(return VK_NULL_HANDLE,
+                  vmaCreatePool(m_device.vma_allocator(), &info, &m_target_pool));
+    m_target_pool_type = type;
+    LOG_INFO("render target pool: %.1f MB blocks", (double)info.blockSize / (1024.0 * 1024.0));
+    return m_target_pool;
+}
+
+void TextureCache::freeTargetPool() {
+    if (m_target_pool == VK_NULL_HANDLE) return;
+    vmaDestroyPool(m_device.vma_allocator(), m_target_pool);
+    m_target_pool = VK_NULL_HANDLE;
 }
 
 std::optional<ImageParameters> TextureCache::Query(std::string_view key, TextureKey content_hash,
                                                    bool persist) {
+    if (exists(m_persist_keys, key)) persist = true;
     if (exists(m_query_map, key)) {
         auto& query = *(m_query_map.find(key)->second);
 
         query.share_ready = false;
         query.persist     = persist;
 
+        counters::Add(counters::Counter::TargetHits);
         return query.image;
     };
 
     TexHash tex_hash = TextureKey::HashValue(content_hash);
     for (auto& query : m_query_texs) {
+        // a released image is written again by its old keys next frame
+        if (persist) break;
         if (! (query->share_ready)) continue;
         if (query->content_hash != tex_hash) continue;
+        if (! aliasFree(*query)) continue;
 
         query->share_ready = false;
         query->persist     = persist;
         query->query_keys.insert(std::string(key));
 
         m_query_map[std::string(key)] = &(*query);
+        if (query->block >= 0) m_aliased_images[std::string(key)] = query->image;
 
+        counters::Add(counters::Counter::TargetShared);
         return query->image;
     }
+    counters::Add(counters::Counter::TargetMisses);
 
     m_query_texs.emplace_back(std::make_unique<QueryTex>());
     auto& query                   = *m_query_texs.back();
@@ -580,24 +1243,108 @@ std::optional<ImageParameters> TextureCache::Query(std::string_view key, Texture
 
     query.index        = (idx)m_query_texs.size() - 1;
     query.content_hash = tex_hash;
+    query.format       = content_hash.format;
     query.query_keys.insert(std::string(key));
     query.persist = persist;
-    if (auto opt = CreateTex(content_hash); opt.has_value()) {
+    if (auto opt = CreateTex(content_hash, persist ? nullptr : &query); opt.has_value()) {
         query.image = std::move(opt.value());
+        if (query.block >= 0) m_aliased_images[std::string(key)] = query.image;
         return query.image;
     }
     return std::nullopt;
 }
 
-void TextureCache::MarkShareReady(std::string_view key) {
-    if (exists(m_query_map, key)) {
-        auto& query = m_query_map.find(key)->second;
-        if (query->persist) return;
-        query->share_ready = true;
-        m_query_map.erase(key.data());
+std::optional<TextureCache::TargetInfo> TextureCache::QueryInfo(std::string_view key) const {
+    auto it = m_query_map.find(key);
+    if (it == m_query_map.end()) return std::nullopt;
+    auto& query = *it->second;
+    // aliased ones know their size, the others are asked
+    VkDeviceSize bytes = query.size;
+    if (query.block < 0 && *query.image.handle != VK_NULL_HANDLE)
+        bytes = m_device.handle().GetImageMemoryRequirements(*query.image.handle).size;
+    return TargetInfo {
+        .extent       = query.image.extent,
+        .format       = query.format,
+        .mipmap_level = query.image.mipmap_level,
+        .bytes        = bytes,
+        .image        = query.index,
+        .block        = query.block,
+        .offset       = query.offset,
+    };
+}
+
+bool TextureCache::aliasFree(const QueryTex& query) const {
+    if (query.block < 0) return true;
+    return std::none_of(m_query_texs.begin(), m_query_texs.end(), [&query](auto& q) {
+        return q.get() != &query && q->block == query.block && ! q->share_ready &&
+               q->offset < query.offset + query.size && query.offset < q->offset + q->size;
+    });
+}
+
+bool TextureCache::placeAlias(QueryTex& query, const VkMemoryRequirements& reqs) {
+    auto align = [&reqs](VkDeviceSize v) {
+        return (v + reqs.alignment - 1) / reqs.alignment * reqs.alignment;
+    };
+
+    // first fit between the images still in use, prepare order is the graph order, so a
+    // released target is past its last read for the rest of the frame
+    std::vector<std::pair<VkDeviceSize, VkDeviceSize>> busy;
+    for (usize b = 0; b < m_alias_blocks.size(); b++) {
+        auto& block = m_alias_blocks[b];
+        if (! (reqs.memoryTypeBits & (1u << block.info.memoryType))) continue;
+
+        busy.clear();
+        for (auto& q : m_query_texs) {
+            if (q.get() == &query || q->block != (idx)b || q->share_ready) continue;
+            busy.emplace_back(q->offset, q->offset + q->size);
+        }
+        std::sort(busy.begin(), busy.end());
+
+        VkDeviceSize offset = 0;
+        for (auto& [first, last] : busy) {
+            if (align(offset) + reqs.size <= first) break;
+            offset = std::max(offset, last);
+        }
+        offset = align(offset);
+        if (offset + reqs.size > block.info.size) continue;
+
+        query.block  = (idx)b;
+        query.offset = offset;
+        query.size   = reqs.size;
+        return true;
     }
+
+    AliasBlock              block;
+    VmaAllocationCreateInfo vma_info {};
+    vma_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    vma_info.flags = VMA_ALLOCATION_CREATE_CAN_ALIAS_BIT;
+    VVK_CHECK_BOOL_RE(vmaAllocateMemory(
+        m_device.vma_allocator(), &reqs, &vma_info, &block.allocation, &block.info));
+    m_alias_blocks.push_back(block);
+    LOG_INFO("render target block %d: %.1f MB",
+             m_alias_blocks.size() - 1,
+             (double)reqs.size / (1024.0 * 1024.0));
+
+    query.block  = (idx)m_alias_blocks.size() - 1;
+    query.offset = 0;
+    query.size   = reqs.size;
+    return true;
+}
+
+void TextureCache::freeAliasBlocks() {
+    for (auto& block : m_alias_blocks) vmaFreeMemory(m_device.vma_allocator(), block.allocation);
+    m_alias_blocks.clear();
 }
 
+void TextureCache::MarkShareReady(std::string_view key) {
+    auto it = m_query_map.find(key);
+    if (it == m_query_map.end() || it->second->persist) return;
+    it->second->share_ready = true;
+    m_query_map.erase(it);
+}
+
+void TextureCache::MarkPersist(std::string_view key) { m_persist_keys.insert(std::string(key)); }
+
 void TextureCache::RecGenerateMipmaps(vvk::CommandBuffer& cmd, const ImageParameters& image) const {
     VkImageMemoryBarrier barrier {
         .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -0,0 +1,110 @@
+#include "UniformRing.hpp"
+#include "Device.hpp"
+#include "Utils/Logging.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace wallpaper::vulkan;
+
+namespace
+{
+constexpr VkDeviceSize AlignUp(VkDeviceSize v, VkDeviceSize align) {
+    return (v + align - 1) / align * align;
+}
+} // namespace
+
+UniformRing::UniformRing(const Device& d, VkDeviceSize region_size, usize frame_num,
+                         VkBufferUsageFlags usage)
+    : m_device(d),
+      m_frame_num(std::max<usize>(frame_num, 1)),
+      m_usage(usage),
+      m_region_size(region_size) {}
+UniformRing::~UniformRing() {}
+
+bool UniformRing::allocate() {
+    m_alignment = std::max<VkDeviceSize>(m_device.limits().minUniformBufferOffsetAlignment, 1);
+    if (m_usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+        m_alignment = std::max(m_alignment, m_device.limits().minStorageBufferOffsetAlignment);
+    m_region_size = AlignUp(m_region_size, m_alignment);
+    m_head        = 0;
+    m_live        = 0;
+    return createBuf(m_region_size);
+}
+
+void UniformRing::destroy() {
+    m_raw  = nullptr;
+    m_buf  = {};
+    m_head = 0;
+    m_live = 0;
+}
+
+bool UniformRing::createBuf(VkDeviceSize region_size) {
+    m_raw = nullptr;
+    m_buf = {};
+
+    VkBufferCreateInfo ci {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = nullptr,
+        .size  = region_size * m_frame_num,
+        .usage = m_usage,
+    };
+    m_buf.req_size = ci.size;
+
+    // host visible, device local where available, written in place every frame
+    VmaAllocationCreateInfo vma_info = {};
+    vma_info.usage                   = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    vma_info.flags                   = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    VVK_CHECK_BOOL_RE(vvk::CreateBuffer(m_device.vma_allocator(), ci, vma_info, m_buf.handle));
+
+    VkMemoryPropertyFlags props {};
+    vmaGetAllocationMemoryProperties(
+        m_device.vma_allocator(), m_buf.handle.Allocation(), &props);
+    m_coherent    = props & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    m_raw         = (uint8_t*)m_buf.handle.MappedData();
+    m_region_size = region_size;
+    m_generation++;
+    if (m_raw == nullptr) {
+        LOG_ERROR("uniform ring not mapped");
+        return false;
+    }
+    LOG_INFO("uniform ring size: %d x %d", region_size, m_frame_num);
+    return true;
+}
+
+bool UniformRing::allocateSubRef(VkDeviceSize size, UniformRingRef& ref) {
+    VkDeviceSize offset = AlignUp(m_head, m_alignment);
+    if (offset + size > m_region_size) {
+        if (! createBuf(AlignUp(std::max(m_region_size * 2, offset + size), m_alignment)))
+            return false;
+    }
+    ref.offset = offset;
+    ref.size   = size;
+    m_head     = offset + size;
+    m_live++;
+    return true;
+}
+
+void UniformRing::unallocateSubRef(UniformRingRef& ref) {
+    if (! ref) return;
+    ref = {};
+    if (m_live > 0 && --m_live == 0) m_head = 0;
+}
+
+bool UniformRing::write(const UniformRingRef& ref, usize frame, std::span<const uint8_t> data) {
+    if (! ref || m_raw == nullptr) return false;
+    VkDeviceSize offset = (frame % m_frame_num) * m_region_size + ref.offset;
+    VkDeviceSize size   = std::min<VkDeviceSize>(ref.size, data.size());
+    std::memcpy(m_raw + offset, data.data(), size);
+    if (! m_coherent) {
+        VVK_CHECK_BOOL_RE(
+            vmaFlushAllocation(m_device.vma_allocator(), m_buf.handle.Allocation(), offset, size));
+    }
+    return true;
+}
+
+u32 UniformRing::dynamicOffset(const UniformRingRef& ref, usize frame) const {
+    return (u32)((frame % m_frame_num) * m_region_size + ref.offset);
+}
+
+VkBuffer UniformRing::gpuBuf() const { return *m_buf.handle; }
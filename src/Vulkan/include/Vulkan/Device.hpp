@@ -5,63 +5,141 @@
 #include "Parameters.hpp"
 #include "TextureCache.hpp"
 
+#include <memory>
+#include <mutex>
+
 namespace wallpaper
 {
 namespace vulkan
 {
 
 class PipelineParameters;
+class PipelineRegistry;
 
 class Device : NoCopy, NoMove {
 public:
+    // the vulkan device, its queues and what lives as long as it, several Devices may share one,
+    // each with its own pools, swapchain and texture cache
+    struct Core : NoCopy, NoMove {
+        std::shared_ptr<Instance> instance;
+
+        vvk::DeviceDispatch     dld;
+        vvk::Device             device;
+        vvk::PhysicalDevice     gpu;
+        vvk::VmaAllocatorHandle allocator;
+        vvk::PipelineCache      pipeline_cache;
+
+        VkPhysicalDeviceLimits limits;
+        Set<std::string>       extensions;
+
+        QueueParameters graphics_queue;
+        QueueParameters present_queue;
+        QueueParameters transfer_queue;
+        QueueParameters compute_queue;
+
+        bool present_wait { false };
+        bool dma_buf { false };
+        bool dynamic_rendering { false };
+        bool descriptor_indexing { false };
+        // combined image samplers a stage may read from update after bind sets, 0 without
+        // descriptor indexing
+        u32 update_after_bind_images { 0 };
+
+        // vulkan queues aren't thread safe, held around every submit and wait idle
+        std::mutex queue_lock;
+    };
+
     Device();
     ~Device();
 
-    static bool Create(Instance&, std::span<const Extension> exts, VkExtent2D extent, Device&);
-    static bool CheckGPU(vvk::PhysicalDevice gpu, std::span<const Extension> exts, VkSurfaceKHR surface);
+    // with a cache of the instance's gpu its extensions and features aren't queried
+    static bool Create(std::shared_ptr<Instance>, std::span<const Extension> exts,
+                       VkExtent2D extent, const Swapchain::Options&, Device&,
+                       const DeviceCache* = nullptr);
+    // on the core of another device, which stays alive as long as this one
+    static bool CreateShared(std::shared_ptr<Core>, VkExtent2D extent, Device&);
+    static bool CheckGPU(vvk::PhysicalDevice gpu, std::span<const Extension> exts,
+                         VkSurfaceKHR surface, const Set<std::string>* known_exts = nullptr);
 
     void Destroy();
-
-    const auto& graphics_queue() const { return m_graphics_queue; }
-    const auto& present_queue() const { return m_present_queue; }
-    const auto& device() const { return m_device; }
-    const auto& handle() const { return m_device; }
-    const auto& gpu() const { return m_gpu; }
-    const auto& limits() const { return m_limits; }
-    const auto& vma_allocator() const { return *m_allocator; }
+    // through the core's lock, use these rather than the queue and device handles
+    VkResult Submit(const QueueParameters&, vvk::Span<const VkSubmitInfo>,
+                    VkFence = VK_NULL_HANDLE) const;
+    VkResult WaitIdle() const;
+    // the output got another size, nothing may use the old swapchain
+    bool RecreateSwapchain(VkSurfaceKHR, VkExtent2D);
+
+    const auto& core() const { return m_core; }
+    const auto& graphics_queue() const { return m_core->graphics_queue; }
+    const auto& present_queue() const { return m_core->present_queue; }
+    // dedicated transfer family when the gpu has one, otherwise the graphics queue
+    const auto& transfer_queue() const { return m_core->transfer_queue; }
+    // a compute family without graphics when the gpu has one, otherwise the graphics queue
+    const auto& compute_queue() const { return m_core->compute_queue; }
+    bool        async_compute() const {
+        return m_core->compute_queue.family_index != m_core->graphics_queue.family_index;
+    }
+    const auto& device() const { return m_core->device; }
+    const auto& handle() const { return m_core->device; }
+    const auto& gpu() const { return m_core->gpu; }
+    const auto& limits() const { return m_core->limits; }
+    const auto& vma_allocator() const { return *m_core->allocator; }
     const auto& cmd_pool() const { return m_command_pool; }
+    const auto& transfer_cmd_pool() const { return m_transfer_command_pool; }
+    const auto& compute_cmd_pool() const { return m_compute_command_pool; }
+    const auto& pipeline_cache() const { return m_core->pipeline_cache; }
     const auto& swapchain() const { return m_swapchain; }
     const auto& out_extent() const { return m_extent; }
     void        set_out_extent(VkExtent2D v) { m_extent = v; }
 
     bool supportExt(std::string_view) const;
+    // presents carry ids the swapchain can be waited on for
+    bool present_wait() const { return m_core->present_wait; }
+    // images can be exported as dma-bufs with a drm format modifier, or imported from them, and
+    // handed between a foreign queue and ours
+    bool dma_buf() const { return m_core->dma_buf; }
+    // passes begin rendering on their target's view, without render pass and framebuffer
+    bool dynamic_rendering() const { return m_core->dynamic_rendering; }
+    // sampler arrays are indexed by a uniform and partly written while bound, see
+    // update_after_bind_images for how many elements they may have
+    bool descriptor_indexing() const { return m_core->descriptor_indexing; }
+    u32  update_after_bind_images() const { return m_core->update_after_bind_images; }
 
     TextureCache& tex_cache() const { return *m_tex_cache; }
+    PipelineRegistry& pipelines() const { return *m_pipelines; }
 
     VkDeviceSize GetUsage() const;
+    // device local bytes left to allocate, from VK_EXT_memory_budget if enabled, vma guesses
+    // from the heap sizes otherwise
+    VkDeviceSize GetBudget() const;
+    // what's used and the budget of the device local heaps, summed
+    void GetHeapBudget(VkDeviceSize& usage, VkDeviceSize& budget) const;
+    // vma fetches the budget from the driver when the frame index changes
+    void SetFrameIndex(u32) const;
+
+    // merge data saved by an earlier run, data from another driver or gpu is ignored
+    bool MergePipelineCache(std::span<const uint8_t>) const;
+    bool GetPipelineCacheData(std::vector<uint8_t>&) const;
 
 private:
     std::vector<VkDeviceQueueCreateInfo> ChooseDeviceQueue(VkSurfaceKHR = {});
+    bool                                 CreatePools();
 
-    vvk::DeviceDispatch     dld;
-    vvk::Device             m_device;
-    vvk::PhysicalDevice     m_gpu;
-    vvk::VmaAllocatorHandle m_allocator;
+    // first, outlives everything made on it
+    std::shared_ptr<Core> m_core;
 
-    VkPhysicalDeviceLimits m_limits;
-    Set<std::string>       m_extensions;
-
-    Swapchain m_swapchain;
+    Swapchain          m_swapchain;
+    Swapchain::Options m_swap_options;
 
     vvk::CommandPool m_command_pool;
-
-    QueueParameters m_graphics_queue;
-    QueueParameters m_present_queue;
+    vvk::CommandPool m_transfer_command_pool;
+    vvk::CommandPool m_compute_command_pool;
 
     // output extent
     VkExtent2D m_extent { 1, 1 };
 
-    std::unique_ptr<TextureCache> m_tex_cache;
+    std::unique_ptr<TextureCache>     m_tex_cache;
+    std::unique_ptr<PipelineRegistry> m_pipelines;
 };
 
 } // namespace vulkan
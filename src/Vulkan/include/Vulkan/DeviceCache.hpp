@@ -0,0 +1,47 @@
+#pragma once
+#include "Instance.hpp"
+
+#include <array>
+#include <filesystem>
+#include <span>
+#include <string>
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+class Device;
+
+// What bringing up vulkan found out on an earlier start, so a start asking for the same skips
+// enumerating instance extensions and layers and checking every gpu. The gpu is known by its
+// uuid and driver version, after a driver update the gpus are looked at again.
+struct DeviceCache {
+    // the extensions, layers and gpu asked for, a cache of other asks isn't used
+    std::string key;
+
+    Set<std::string> inst_exts;
+    Set<std::string> inst_layers;
+
+    std::array<u8, VK_UUID_SIZE> gpu_uuid {};
+    u32                          driver_version { 0 };
+    Set<std::string>             device_exts;
+    bool                         present_wait { false };
+    bool                         dynamic_rendering { false };
+    bool                         descriptor_indexing { false };
+
+    // what the device was made with
+    static DeviceCache Of(const Device&, std::string key);
+
+    bool matches(std::span<const u8> uuid, u32 driver_version) const;
+
+    // false if there is none, it's broken or of another key
+    bool Load(const std::filesystem::path&, std::string_view key);
+    // to a temporary file renamed into place, renderers of other processes may read it meanwhile
+    bool Save(const std::filesystem::path&) const;
+
+    bool operator==(const DeviceCache&) const = default;
+};
+
+} // namespace vulkan
+} // namespace wallpaper
@@ -3,6 +3,11 @@
 #include "Core/MapSet.hpp"
 #include "Spv.hpp"
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
 namespace wallpaper
 {
 namespace vulkan
@@ -11,26 +16,83 @@ namespace vulkan
 struct PipelineParameters {
     vvk::Pipeline       handle;
     vvk::PipelineLayout layout;
-    vvk::RenderPass     pass;
+    // null with dynamic rendering
+    vvk::RenderPass pass;
 
     std::vector<vvk::DescriptorSetLayout> descriptor_layouts;
 };
 
 struct DescriptorSetInfo {
     bool push_descriptor { false };
+    // elements may be written while sets of it are bound, and left unwritten if not read
+    bool update_after_bind { false };
 
     std::vector<VkDescriptorSetLayoutBinding> bindings;
 };
 
 class Device;
 
+// sets allocated of another layout of the same info are compatible with it
+bool CreateDescriptorSetLayout(const Device&, const DescriptorSetInfo&, vvk::DescriptorSetLayout&);
+
+// Pipelines of passes with the same shaders and state, the first pass makes one and later ones
+// share it. It goes with the last pass holding it.
+class PipelineRegistry : NoCopy, NoMove {
+public:
+    // the layouts are there once acquire returns, the pipeline may still be made on a job
+    struct Entry : NoCopy, NoMove {
+        PipelineParameters params;
+
+        bool ready() const { return m_state.load(std::memory_order_acquire) == State::Ready; }
+        bool failed() const { return m_state.load(std::memory_order_acquire) == State::Failed; }
+        // by whoever made the entry, params aren't written after
+        void finish(bool ok) {
+            m_state.store(ok ? State::Ready : State::Failed, std::memory_order_release);
+        }
+
+    private:
+        enum class State
+        {
+            Pending,
+            Ready,
+            Failed
+        };
+        std::atomic<State> m_state { State::Pending };
+    };
+
+    // made is true for a new entry, the caller fills it in then
+    std::shared_ptr<Entry> acquire(const std::string& key, bool& made);
+
+    // pipelines handed out again
+    usize shared() const { return m_shared; }
+
+private:
+    std::mutex                             m_lock;
+    Map<std::string, std::weak_ptr<Entry>> m_entries;
+    std::atomic<usize>                     m_shared { 0 };
+};
+
 class GraphicsPipeline : NoCopy, NoMove {
 public:
     GraphicsPipeline();
     ~GraphicsPipeline();
 
     void toDefault();
+    // a null pass for dynamic rendering, to one attachment of the color format
+    // the pass is kept in the parameters
     bool create(const Device&, vvk::RenderPass&, PipelineParameters&);
+    // the device's registry entry of this pipeline's key, if made it's new and the caller
+    // creates the layouts and then the pipeline in it
+    // render passes of the color format are compatible with a pipeline made for one of them
+    std::shared_ptr<PipelineRegistry::Entry> share(const Device&, bool render_pass,
+                                                   bool& made) const;
+    bool createLayouts(const Device&, PipelineParameters&);
+    // takes no state of the device's but the pipeline cache, may run on any thread while the
+    // builder isn't touched elsewhere
+    bool createPipeline(const Device&, VkRenderPass, PipelineParameters&);
+
+    // the shaders, state and layouts, a pass only by being one and its color format
+    std::string key(bool render_pass) const;
 
     VkPipelineMultisampleStateCreateInfo   multisample {};
     VkPipelineRasterizationStateCreateInfo raster {};
@@ -41,6 +103,7 @@ public:
 
     GraphicsPipeline& setColorBlendStates(std::span<const VkPipelineColorBlendAttachmentState>);
     GraphicsPipeline& setLogicOp(bool enable, VkLogicOp);
+    GraphicsPipeline& setColorFormat(VkFormat);
 
     // required after default
     GraphicsPipeline& setRenderPass(vvk::RenderPass);
@@ -49,9 +112,12 @@ public:
     GraphicsPipeline& addInputAttributeDescription(std::span<const VkVertexInputAttributeDescription>);
     GraphicsPipeline& addInputBindingDescription(std::span<const VkVertexInputBindingDescription>);
     GraphicsPipeline& setTopology(VkPrimitiveTopology);
+    // int constants by id, given to every stage, ids a stage doesn't declare are ignored
+    GraphicsPipeline& setSpecialization(std::span<const std::pair<u32, i32>>);
 
 private:
     vvk::RenderPass m_pass;
+    VkFormat        m_color_format { VK_FORMAT_R8G8B8A8_UNORM };
 
     VkPipelineInputAssemblyStateCreateInfo         m_input_assembly {};
     std::vector<VkVertexInputBindingDescription>   m_input_bind_descriptions;
@@ -63,6 +129,8 @@ private:
     std::vector<VkPipelineColorBlendAttachmentState> m_color_attachments;
     std::vector<DescriptorSetInfo>                   m_descriptor_set_infos;
     Map<VkShaderStageFlagBits, Uni_ShaderSpv>        m_stage_spv_map;
+    std::vector<VkSpecializationMapEntry>            m_spec_entries;
+    std::vector<i32>                                 m_spec_data;
 };
 
 } // namespace vulkan
@@ -25,7 +25,16 @@ struct Extension {
 
 using InstanceLayer = Extension;
 
-using CheckGpuOp = std::function<bool(vvk::PhysicalDevice)>;
+// the extensions of the gpu if a cache knows them, null to enumerate them
+using CheckGpuOp = std::function<bool(vvk::PhysicalDevice, const Set<std::string>* exts)>;
+
+// the kind of gpu looked at first, another good enough one is taken if there's none of it
+enum class GpuPreference
+{
+    Any,
+    Integrated,
+    Discrete
+};
 
 constexpr std::string_view VALIDATION_LAYER_NAME = "VK_LAYER_KHRONOS_validation";
 
@@ -33,6 +42,7 @@ constexpr uint32_t    WP_VULKAN_VERSION { VK_API_VERSION_1_1 };
 constexpr const char* WP_APPLICATION_NAME { "scene render" };
 
 class Device;
+struct DeviceCache;
 class Instance {
 public:
     Instance()  = default;
@@ -40,17 +50,28 @@ public:
 
     void Destroy();
 
-    static bool Create(Instance&, std::span<const Extension>, std::span<const InstanceLayer>);
-    bool ChoosePhysicalDevice(const CheckGpuOp& checkgpu, std::span<const std::uint8_t> uuid = {});
+    // the extensions and layers there are from the cache if given, enumerated otherwise
+    static bool Create(Instance&, std::span<const Extension>, std::span<const InstanceLayer>,
+                       const DeviceCache* = nullptr);
+    // the cache's gpu is checked first if it's still there with the same driver, a uuid given
+    // picks that gpu whatever the preference
+    bool ChoosePhysicalDevice(const CheckGpuOp& checkgpu, std::span<const std::uint8_t> uuid = {},
+                              const DeviceCache* = nullptr,
+                              GpuPreference      prefer = GpuPreference::Any);
 
     const vvk::Instance&       inst() const;
     const vvk::PhysicalDevice& gpu() const;
     const vvk::SurfaceKHR&     surface() const;
 
+    // the gpu chosen is the one of the cache given to ChoosePhysicalDevice
+    bool gpuCached() const { return m_gpu_cached; }
+
     bool offscreen() const;
     void setSurface(VkSurfaceKHR);
     bool supportExt(std::string_view) const;
     bool supportLayer(std::string_view) const;
+    const Set<std::string>& extensions() const { return m_extensions; }
+    const Set<std::string>& layers() const { return m_layers; }
 
 private:
     utils::DynamicLibrary m_vklib;
@@ -59,6 +80,7 @@ private:
 
     vvk::DebugUtilsMessenger m_debug_utils;
     vvk::PhysicalDevice      m_gpu {};
+    bool                     m_gpu_cached { false };
 
     vvk::SurfaceKHR  m_surface {};
     Set<std::string> m_extensions;
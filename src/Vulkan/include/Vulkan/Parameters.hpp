@@ -36,11 +36,13 @@ struct BufferParameters {
 };
 
 struct VmaImageParameters : NoCopy {
-    vvk::VmaImage  handle;
-    vvk::ImageView view;
-    vvk::Sampler   sampler;
-    VkExtent3D     extent;
-    uint           mipmap_level { 1 };
+    vvk::VmaImage     handle;
+    vvk::ImageView    view;
+    // shared with other images, the TextureCache has it
+    VkSampler         sampler { VK_NULL_HANDLE };
+    VkExtent3D        extent;
+    uint              mipmap_level { 1 };
+    VkImageUsageFlags usage { 0 };
 
     VmaImageParameters();
     ~VmaImageParameters();
@@ -58,6 +60,11 @@ struct ExImageParameters : NoCopy {
     VkExtent3D     extent;
     uint           mipmap_level { 1 };
     int            fd { 0 };
+    // exported as a dma-buf with a drm format modifier, its one plane at offset, row_pitch apart
+    bool         dma_buf { false };
+    uint64_t     drm_modifier { 0 };
+    VkDeviceSize offset { 0 };
+    VkDeviceSize row_pitch { 0 };
 
     ExImageParameters();
     ~ExImageParameters();
@@ -66,20 +73,22 @@ struct ExImageParameters : NoCopy {
 };
 
 struct ImageParameters {
-    VkImage     handle;
-    VkImageView view;
-    VkSampler   sampler;
-    VkExtent3D  extent;
-    uint        mipmap_level { 1 };
+    VkImage           handle;
+    VkImageView       view;
+    VkSampler         sampler;
+    VkExtent3D        extent;
+    uint              mipmap_level { 1 };
+    VkImageUsageFlags usage { 0 };
 
     ImageParameters()  = default;
     ~ImageParameters() = default;
     ImageParameters(const VmaImageParameters& o) noexcept
         : handle(*o.handle),
           view(*o.view),
-          sampler(*o.sampler),
+          sampler(o.sampler),
           extent(o.extent),
-          mipmap_level(o.mipmap_level) {}
+          mipmap_level(o.mipmap_level),
+          usage(o.usage) {}
     ImageParameters(const ExImageParameters& o) noexcept
         : handle(*o.handle),
           view(*o.view),
@@ -3,6 +3,9 @@
 #include "ShaderComp.hpp"
 #include <glslang/Include/BaseTypes.h>
 
+#include <string>
+#include <string_view>
+
 namespace wallpaper
 {
 namespace vulkan
@@ -25,6 +28,8 @@ struct ShaderReflected {
         Map<std::string, BlockedUniform> member_map;
     };
     std::vector<Block> blocks;
+    // storage blocks by binding name, their size
+    Map<std::string, uint> buffer_sizes;
 
     Map<std::string, VkDescriptorSetLayoutBinding> binding_map;
 
@@ -37,5 +42,11 @@ struct ShaderReflected {
 
 bool GenReflect(std::span<const std::vector<uint>> codes, std::vector<Uni_ShaderSpv>& spvs,
                 ShaderReflected& ref);
+
+// what GenReflect found as bytes, kept beside the spirv in a cache
+std::string PackReflect(const ShaderReflected&, std::span<const Uni_ShaderSpv>);
+// GenReflect without looking at the codes, false if the bytes are broken or for other codes
+bool UnpackReflect(std::string_view, std::span<const std::vector<uint>> codes,
+                   std::vector<Uni_ShaderSpv>& spvs, ShaderReflected& ref);
 } // namespace vulkan
 } // namespace wallpaper
@@ -30,12 +30,19 @@ struct ShaderCompOpt {
     bool relaxed_rules_vulkan { false };
     // for global unifom block
     uint global_uniform_binding { 0 };
+    // spirv-tools dead code elimination, constant folding and inlining, glslang has to be built
+    // with it (ENABLE_SHADER_OPT)
+    bool optimize { false };
 
     // relfect:
     bool reflect_all_io_var { true };
     bool reflect_all_block_var { false };
 };
 
+// glslang's process state, made on the first call and kept, so a load whose shaders all come
+// from a cache never makes it, thread safe
+void InitGlslang();
+
 bool CompileAndLinkShaderUnits(std::span<const ShaderCompUnit> compUnits, const ShaderCompOpt& opt,
                                std::vector<Uni_ShaderSpv>& spvs);
 } // namespace vulkan
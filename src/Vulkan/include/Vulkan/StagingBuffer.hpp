@@ -27,7 +27,12 @@ private:
 
 class StagingBuffer : NoCopy, NoMove {
 public:
-    StagingBuffer(const Device&, VkDeviceSize size, VkBufferUsageFlags);
+    // frame_num > 1 keeps cpu writes in host memory and uploads through one staging buffer and
+    // into one gpu buffer per frame, so writes for the next frame never race a copy or a read
+    // that is still in flight
+    // where device local memory is host visible (resizable bar, unified memory) each frame gets
+    // its own gpu buffer written in place instead, no copy is recorded
+    StagingBuffer(const Device&, VkDeviceSize size, VkBufferUsageFlags, usize frame_num = 1);
     ~StagingBuffer();
 
     bool allocate();
@@ -37,10 +42,28 @@ public:
     void unallocateSubRef(const StagingBufferRef&);
     bool writeToBuf(const StagingBufferRef&, std::span<uint8_t>, size_t offset = 0);
     bool fillBuf(const StagingBufferRef& ref, size_t offset, size_t size, uint8_t c);
-
-    bool recordUpload(vvk::CommandBuffer&);
-
-    VkBuffer gpuBuf() const;
+    // host side view of the data, invalid once the buffer grows
+    std::span<const uint8_t> bufData(const StagingBufferRef&) const;
+
+    // direct mode only, writes the buffer of the frame set by setFrame and nothing else, false
+    // otherwise. Skips the host copy, the writer has to write each frame's buffer itself and
+    // again after the buffer grew, see generation. Don't mix with writeToBuf on one ref.
+    bool writeToFrame(const StagingBufferRef&, std::span<const uint8_t>);
+    // the frame whose fence signaled and that pass updates write for
+    void  setFrame(usize frame) { m_frame = frame % m_frame_num; }
+    usize frame() const { return m_frame; }
+    usize frameNum() const { return m_frame_num; }
+    bool  direct() const { return m_direct; }
+    // changes when the buffers are made anew, data written to frames before is gone
+    u64 generation() const { return m_generation; }
+
+    // copies only byte ranges written since the last upload of frame, nothing when none were
+    bool recordUpload(vvk::CommandBuffer&, usize frame = 0);
+    // copy written host data to the staging buffer of frame, call after all writes and before
+    // submit
+    bool commitFrame(usize frame);
+
+    VkBuffer gpuBuf(usize frame = 0) const;
 
 private:
     struct VirtualBlock {
@@ -51,20 +74,50 @@ private:
         VkDeviceSize    size { 0 };
     };
 
+    struct Range {
+        VkDeviceSize begin;
+        VkDeviceSize end;
+    };
+
+    struct FrameBuffer {
+        VmaBufferParameters buf;
+        // staging mode, device local, read by this frame only
+        VmaBufferParameters gpu;
+        void*               raw { nullptr };
+        // written since this frame's last commit, or its last upload in staging mode
+        std::vector<Range> dirty;
+    };
+
     VkResult      mapStageBuf();
     VirtualBlock* newVirtualBlock(VkDeviceSize);
     bool          increaseBuf(VkDeviceSize);
+    bool          createFrameBufs(VkDeviceSize);
+    void          destroyFrameBufs();
+    VkDeviceSize  stageSize() const;
+    void          markDirty(VkDeviceSize offset, VkDeviceSize size);
+    bool          useDirect() const;
 
     const Device& m_device;
     VkDeviceSize  m_size_step;
 
     VkBufferUsageFlags m_usage;
+    usize              m_frame_num;
+    bool               m_direct { false };
+    usize              m_frame { 0 };
+    u64                m_generation { 0 };
 
     void*                     m_stage_raw { nullptr };
     std::vector<VirtualBlock> m_virtual_blocks {};
 
-    VmaBufferParameters m_stage_buf;
-    VmaBufferParameters m_gpu_buf;
+    VmaBufferParameters      m_stage_buf;
+    // frame_num == 1 only
+    VmaBufferParameters      m_gpu_buf;
+    std::vector<uint8_t>     m_host_buf;
+    std::vector<FrameBuffer> m_frame_bufs;
+
+    // frame_num == 1, written since the last recordUpload, and what an upload copies
+    std::vector<Range>        m_dirty;
+    std::vector<VkBufferCopy> m_copies;
 };
 
 } // namespace vulkan
@@ -12,7 +12,16 @@ struct VmaImageParameters;
 class Device;
 class Swapchain {
 public:
-    static bool                      Create(Device&, VkSurfaceKHR, VkExtent2D, Swapchain&);
+    struct Options {
+        // fifo if the surface doesn't support it
+        VkPresentModeKHR present_mode { VK_PRESENT_MODE_FIFO_KHR };
+        // clamped to what the surface allows, 0 for one more than its minimum
+        uint32_t image_count { 0 };
+    };
+
+    // old is retired by the new one, its images may still be presenting
+    static bool Create(Device&, VkSurfaceKHR, VkExtent2D, const Options&, Swapchain&,
+                       VkSwapchainKHR old = VK_NULL_HANDLE);
     const vvk::SwapchainKHR&         handle() const;
     VkFormat                         format() const;
     VkExtent2D                       extent() const;
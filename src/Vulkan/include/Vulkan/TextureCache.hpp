@@ -5,10 +5,15 @@
 #include "Core/NoCopyMove.hpp"
 #include "Core/MapSet.hpp"
 
+#include <deque>
+#include <span>
+#include <memory>
+
 namespace wallpaper
 {
 
 class Image;
+struct ImageHeader;
 
 namespace vulkan
 {
@@ -38,41 +43,225 @@ struct TextureKey {
 
 class TextureCache : NoCopy, NoMove {
 public:
+    // the largest side of the levels uploaded with the scene
+    constexpr static i32              StreamTailSize { 1024 };
+    constexpr static std::string_view LayeredKeySuffix { "#layers" };
+    constexpr static VkDeviceSize     DefaultRetainBudget { 256ull * 1024 * 1024 };
+
     TextureCache(const Device&);
     ~TextureCache();
 
+    // images from CreateTex that know their content are retained for a later CreateTex of the
+    // same pixels, sampler and levels, up to the retain budget
     void Clear();
+    // what Clear frees goes with the returned object, which may be dropped on another thread once
+    // the gpu is done with it, the cache makes new images meanwhile
+    struct Retired;
+    std::shared_ptr<Retired> Retire();
+    // only the render targets, for outputs changing size, images from CreateTex stay
+    void ClearTargets();
+    // bytes of the render targets the scene plans that aren't aliased. Those are suballocated
+    // from a pool of blocks about that large, made again after ClearTargets for the new sizes
+    // so targets of a resize or the next scene don't fill holes left by old ones
+    void PlanTargets(VkDeviceSize bytes);
 
+    // bytes of retained images kept at most, least recently retained go first, 0 keeps none
+    void         SetRetainBudget(VkDeviceSize);
+    VkDeviceSize RetainedBytes() const { return m_retained_bytes; }
+    // frees retained images until bytes are freed or none is left
+    void TrimRetained(VkDeviceSize bytes);
+
+    // a dma-buf with one of modifiers the gpu renders to if the device exports them, an image
+    // with tiling exported as opaque fd otherwise
     std::optional<ExImageParameters> CreateExTex(uint32_t witdh, uint32_t height, VkFormat,
-                                                 VkImageTiling);
-    ImageSlotsRef                    CreateTex(Image&);
+                                                 VkImageTiling,
+                                                 std::span<const uint64_t> modifiers = {});
+    // levels above what the output needs are left out, and of oversized images only the levels
+    // up to StreamTailSize are uploaded, the rest stream in one per frame by RecordStream.
+    // layered makes one array image of a sprite's images, its key gets LayeredKeySuffix
+    ImageSlotsRef CreateTex(const std::shared_ptr<Image>&, bool layered = false);
+    // device bytes of the image CreateTex would make for a header, and the part of it uploaded
+    // with the scene
+    struct TexEstimate {
+        VkDeviceSize device { 0 };
+        VkDeviceSize staging { 0 };
+    };
+    TexEstimate EstimateTex(const ImageHeader&) const;
+    // levels dropped on top of what the output needs, from images with mips, for scenes that
+    // don't fit the memory budget otherwise
+    void SetLevelBias(u32 v) { m_level_bias = v; }
+    // the image slots of a key from CreateTex, null if there are none
+    const ImageSlots* Find(std::string_view key) const;
 
     std::optional<ImageParameters> Query(std::string_view key, TextureKey content_hash,
                                          bool persist = false);
 
     void MarkShareReady(std::string_view key);
+    // the key gets its own image, never shared with other keys, until Clear
+    void MarkPersist(std::string_view key);
 
     void RecGenerateMipmaps(vvk::CommandBuffer& cmd, const ImageParameters& image) const;
 
+    // images from CreateTex(Image) are only filled once submitted, in one batch on the transfer
+    // queue, the returned semaphore must be waited before sampling, null if nothing pending
+    VkSemaphore SubmitUploads();
+    // render targets are moved to shader read layout by the caller's graphics command
+    void RecordPendingTransitions(vvk::CommandBuffer&);
+    // drop staging memory of a finished batch, cheap to call every frame
+    void ReleaseFinishedUploads();
+
+    // levels left to stream, a frame has to be recorded for them to land
+    bool StreamPending() const { return ! m_streams.empty(); }
+    // records the copy of the next streamed level, outside a render pass and before the draws
+    // of the frame, its staging is kept for frames_in_flight frames
+    void RecordStream(vvk::CommandBuffer&, usize frames_in_flight);
+    // bumped whenever a streamed image gets a view over more levels, refs copied from
+    // ImageSlots before that still sample the smaller view
+    u64 StreamGeneration() const { return m_stream_generation; }
+
+    // render targets sharing memory with other targets, by key. Their content is lost between
+    // the last read and the next write, so the first write of a frame must discard it
+    const Map<std::string, ImageParameters>& AliasedImages() const { return m_aliased_images; }
+
+    // what a render target key got, for dumps
+    struct TargetInfo {
+        VkExtent3D    extent;
+        TextureFormat format;
+        uint          mipmap_level { 1 };
+        VkDeviceSize  bytes { 0 };
+        // keys of the same image share it
+        idx image { -1 };
+        // the alias block the image is placed in, -1 for memory of its own
+        idx          block { -1 };
+        VkDeviceSize offset { 0 };
+    };
+    std::optional<TargetInfo> QueryInfo(std::string_view key) const;
+
 private:
-    std::optional<VmaImageParameters> CreateTex(TextureKey);
+    struct QueryTex;
+
+    // alias places the image in memory shared with targets already released
+    std::optional<VmaImageParameters> CreateTex(TextureKey, QueryTex* alias = nullptr);
+    bool placeAlias(QueryTex&, const VkMemoryRequirements&);
+    bool aliasFree(const QueryTex&) const;
+    void freeAliasBlocks();
+    // null if there is no plan or no pool could be made, images go to vma's own blocks then
+    VmaPool targetPool(const VkImageCreateInfo&);
+    void    freeTargetPool();
     void                              allocateCmd();
-    vvk::CommandBuffers               m_tex_cmds;
-    vvk::CommandBuffer                m_tex_cmd;
+    bool allocateStaging(VkDeviceSize size, VkBuffer& buf, VkDeviceSize& offset, void*& raw);
+    void waitUploads();
+    // one of the shared samplers, made on first use, null if that fails
+    VkSampler sampler(const VkSamplerCreateInfo&);
+    // 0 for images not known by content
+    TexHash RetainKey(const Image&, bool layered) const;
+    void    retain();
+
+    vvk::CommandBuffers m_tex_cmds;
+    vvk::CommandBuffer  m_tex_cmd;
+
+    struct StagingChunk {
+        VmaBufferParameters buf;
+        void*               raw { nullptr };
+        VkDeviceSize        used { 0 };
+    };
+    struct PendingCopy {
+        VkBuffer          src;
+        VkImage           dst;
+        VkBufferImageCopy region;
+    };
+    vvk::CommandBuffers       m_upload_cmds;
+    vvk::CommandBuffer        m_upload_cmd;
+    vvk::Fence                m_upload_fence;
+    vvk::Semaphore            m_upload_sem;
+    bool                      m_upload_inflight { false };
+    std::vector<StagingChunk> m_staging_chunks;
+
+    std::vector<PendingCopy>          m_pending_copies;
+    std::vector<VkImageMemoryBarrier> m_pending_uploads;
+    std::vector<VkImageMemoryBarrier> m_pending_transitions;
+
+    const Device& m_device;
+
+    // the fields of sampler create infos that differ, images of a scene use a handful of these
+    struct SamplerKey {
+        VkFilter             mag_filter;
+        VkFilter             min_filter;
+        VkSamplerMipmapMode  mipmap_mode;
+        VkSamplerAddressMode address_u;
+        VkSamplerAddressMode address_v;
+        VkSamplerAddressMode address_w;
+        float                max_lod;
+
+        auto operator<=>(const SamplerKey&) const = default;
+    };
+    // kept until the cache goes, after every image using them
+    Map<SamplerKey, vvk::Sampler> m_samplers;
 
-    const Device&                m_device;
     Map<std::string, ImageSlots> m_tex_map;
 
+    // images of cleared scenes by RetainKey, and the retain keys of m_tex_map
+    struct RetainedTex {
+        ImageSlots   slots;
+        VkDeviceSize bytes { 0 };
+        u64          stamp { 0 };
+    };
+    Map<TexHash, RetainedTex> m_retained;
+    Map<std::string, TexHash> m_retain_keys;
+    VkDeviceSize              m_retain_budget { DefaultRetainBudget };
+    VkDeviceSize              m_retained_bytes { 0 };
+    u64                       m_retain_stamp { 0 };
+
     struct QueryTex {
         idx                index { 0 };
         bool               share_ready { false };
         bool               persist { false };
         TexHash            content_hash;
+        TextureFormat      format { TextureFormat::RGBA8 };
         VmaImageParameters image;
         Set<std::string>   query_keys;
+
+        // range in m_alias_blocks, no block for a dedicated allocation
+        idx          block { -1 };
+        VkDeviceSize offset { 0 };
+        VkDeviceSize size { 0 };
     };
     std::vector<std::unique_ptr<QueryTex>> m_query_texs;
     Map<std::string, QueryTex*>            m_query_map;
+    Set<std::string>                       m_persist_keys;
+
+    struct StreamTex {
+        std::string key;
+        usize       slot { 0 };
+        VkFormat    format { VK_FORMAT_UNDEFINED };
+        // image level n is mipmaps[base + n], levels below resident are not uploaded yet
+        std::shared_ptr<Image> image;
+        usize                  base { 0 };
+        u32                    resident { 0 };
+    };
+    struct StreamStaging {
+        VmaBufferParameters buf;
+        u64                 frame { 0 };
+    };
+    std::deque<StreamTex>       m_streams;
+    std::vector<StreamStaging>  m_stream_staging;
+    // views replaced by a wider one, frames in flight may still sample them
+    std::vector<vvk::ImageView> m_retired_views;
+    u64                         m_stream_frame { 0 };
+    u64                         m_stream_generation { 0 };
+    u32                         m_level_bias { 0 };
+
+    struct AliasBlock {
+        VmaAllocation     allocation {};
+        VmaAllocationInfo info {};
+    };
+    std::vector<AliasBlock>           m_alias_blocks;
+    Map<std::string, ImageParameters> m_aliased_images;
+
+    VkDeviceSize m_target_bytes { 0 };
+    VmaPool      m_target_pool { VK_NULL_HANDLE };
+    // the pool's memory type, images that can't use it aren't pooled
+    u32 m_target_pool_type { 0 };
 };
 
 } // namespace vulkan
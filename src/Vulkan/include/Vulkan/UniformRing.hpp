@@ -0,0 +1,69 @@
+#pragma once
+#include "Core/NoCopyMove.hpp"
+#include "Instance.hpp"
+#include "Parameters.hpp"
+#include "vk_mem_alloc.h"
+
+#include <span>
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+class Device;
+
+class UniformRingRef {
+public:
+    VkDeviceSize size { 0 };
+    // inside a frame region
+    VkDeviceSize offset { 0 };
+
+    operator bool() const { return size != 0; }
+};
+
+// Persistently mapped uniform buffer split into one region per frame in flight.
+// Every ref has the same offset in each region, a frame writes and binds its own region through
+// a dynamic offset, so uniforms the gpu still reads for an earlier frame are never overwritten.
+// With storage usage the same works for storage buffers.
+class UniformRing : NoCopy, NoMove {
+public:
+    UniformRing(const Device&, VkDeviceSize region_size, usize frame_num,
+                VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    ~UniformRing();
+
+    bool allocate();
+    void destroy();
+
+    // grows the buffer when full, only while no frame is in flight
+    // descriptors written before then need rewriting, see generation()
+    bool allocateSubRef(VkDeviceSize size, UniformRingRef&);
+    // space is reclaimed once every ref is given back
+    void unallocateSubRef(UniformRingRef&);
+
+    bool     write(const UniformRingRef&, usize frame, std::span<const uint8_t>);
+    u32      dynamicOffset(const UniformRingRef&, usize frame) const;
+    VkBuffer gpuBuf() const;
+    usize    frameNum() const { return m_frame_num; }
+    // bumped when the buffer is recreated
+    u64 generation() const { return m_generation; }
+
+private:
+    bool createBuf(VkDeviceSize region_size);
+
+    const Device&      m_device;
+    usize              m_frame_num;
+    VkBufferUsageFlags m_usage;
+    VkDeviceSize       m_alignment { 1 };
+
+    VmaBufferParameters m_buf;
+    uint8_t*            m_raw { nullptr };
+    bool                m_coherent { false };
+    VkDeviceSize        m_region_size;
+    VkDeviceSize        m_head { 0 };
+    usize               m_live { 0 };
+    u64                 m_generation { 0 };
+};
+
+} // namespace vulkan
+} // namespace wallpaper
@@ -2,7 +2,12 @@
 
 #include "Swapchain/ExSwapchain.hpp"
 #include "Device.hpp"
+#include <algorithm>
 #include <cstdio>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include "Utils/Logging.h"
 
 namespace wallpaper
 {
@@ -12,27 +17,30 @@ namespace vulkan
 struct VulkanExHandle : NoCopy {
     ExHandle          handle;
     ExImageParameters image;
+    // signaled by the submit drawing into image, exported as sem_fd
+    vvk::Semaphore semaphore;
+    int            sem_fd { -1 };
 
     VulkanExHandle()  = default;
     ~VulkanExHandle() = default;
-    VulkanExHandle(VulkanExHandle&& o) noexcept: handle(o.handle), image(std::move(o.image)) {}
+    VulkanExHandle(VulkanExHandle&& o) noexcept
+        : handle(o.handle),
+          image(std::move(o.image)),
+          semaphore(std::move(o.semaphore)),
+          sem_fd(std::exchange(o.sem_fd, -1)) {}
     VulkanExHandle& operator=(VulkanExHandle&& o) noexcept {
-        handle = o.handle;
-        image  = std::move(o.image);
+        handle    = o.handle;
+        image     = std::move(o.image);
+        semaphore = std::move(o.semaphore);
+        sem_fd    = std::exchange(o.sem_fd, -1);
         return *this;
     }
 };
-struct VulkanExHandleSemaphore {
-    ExHandle    handle;
-    VkSemaphore semaphore;
-};
 
 class VulkanExSwapchain : public ExSwapchain {
-    using atomic_ = std::atomic<ExHandle*>;
-
 public:
-    VulkanExSwapchain(std::array<VulkanExHandle, 3> handles, VkExtent2D ext)
-        : m_handles(std::move(handles)), m_extent(ext) {
+    VulkanExSwapchain(std::vector<VulkanExHandle> handles, VkExtent2D ext, bool synced)
+        : m_handles(std::move(handles)), m_extent(ext), m_synced(synced) {
         int index = 0;
         for (auto& h : m_handles) {
             auto& handle  = h.handle;
@@ -41,60 +49,102 @@ public:
             handle.height = (i32)h.image.extent.height;
             handle.fd     = h.image.fd;
             handle.size   = h.image.mem_reqs.size;
+            handle.sem_fd = h.sem_fd;
+
+            handle.dma_buf  = h.image.dma_buf;
+            handle.modifier = h.image.drm_modifier;
+            handle.offset   = (uint32_t)h.image.offset;
+            handle.stride   = (uint32_t)h.image.row_pitch;
         }
-        m_presented  = &m_handles[0].handle;
-        m_ready      = &m_handles[1].handle;
-        m_inprogress = &m_handles[2].handle;
+        initImages();
     }
     virtual ~VulkanExSwapchain() = default;
 
-    uint width() const override { return m_extent.width; }
-    uint height() const override { return m_extent.height; }
+    uint     width() const override { return m_extent.width; }
+    uint     height() const override { return m_extent.height; }
+    uint32_t count() const override { return (uint32_t)m_handles.size(); }
 
     const auto& handles() const { return m_handles; }
 
-    ExImageParameters& GetInprogressImage() {
-        return m_handles.at((usize)(*inprogress()).id()).image;
-    }
+    // the drawing side of an acquired frame
+    VulkanExHandle& get(const ExHandle& h) { return m_handles.at((usize)h.id()); }
+
+    // frames are handed over with a semaphore to wait on, not once drawn
+    bool synced() const { return m_synced; }
+    // images are dma-bufs, they go to the foreign queue family after a frame
+    bool dma_buf() const { return m_handles[0].image.dma_buf; }
 
     constexpr VkFormat format() const { return VK_FORMAT_R8G8B8A8_UNORM; };
 
 protected:
-    atomic_& presented() override { return m_presented; };
-    atomic_& ready() override { return m_ready; };
-    atomic_& inprogress() override { return m_inprogress; };
+    ExHandle& image(uint32_t i) override { return m_handles.at(i).handle; }
+    uint32_t  indexOf(const ExHandle& h) const override { return (uint32_t)h.id(); }
 
 private:
-    std::array<VulkanExHandle, 3> m_handles;
-    atomic_                       m_presented { nullptr };
-    atomic_                       m_ready { nullptr };
-    atomic_                       m_inprogress { nullptr };
-    VkExtent2D                    m_extent;
+    std::vector<VulkanExHandle> m_handles;
+    VkExtent2D                  m_extent;
+    bool                        m_synced;
 };
 
-inline std::unique_ptr<VulkanExSwapchain> CreateExSwapchain(const Device& device, uint w, uint h,
-                                                            VkImageTiling tiling) {
-    std::array<VulkanExHandle, 3> handles;
+// count images, the eater holds one, one waits to be eaten and the rest are drawn into, more
+// let frames be drawn while earlier ones are still on the gpu or held by the eater
+// modifiers are the drm format modifiers the eater imports dma-bufs with, without sync frames are
+// handed over once drawn
+inline std::unique_ptr<VulkanExSwapchain>
+CreateExSwapchain(const Device& device, uint w, uint h, VkImageTiling tiling, uint32_t count,
+                  std::span<const uint64_t> modifiers = {}, bool sync = true) {
+    count = std::clamp<uint32_t>(count, 3, ExSwapchain::max_images);
+    std::vector<VulkanExHandle> handles(count);
     for (auto& handle : handles) {
-        if (auto rv = device.tex_cache().CreateExTex(w, h, VK_FORMAT_R8G8B8A8_UNORM, tiling);
+        if (auto rv =
+                device.tex_cache().CreateExTex(w, h, VK_FORMAT_R8G8B8A8_UNORM, tiling, modifiers);
             rv.has_value())
             handle.image = std::move(rv.value());
         else
             return nullptr;
+        // all the same kind, the driver may pick another modifier for each
+        if (handle.image.dma_buf != handles[0].image.dma_buf) {
+            LOG_ERROR("ex swapchain images exported differently");
+            return nullptr;
+        }
+    }
+    if (handles[0].image.dma_buf)
+        LOG_INFO("ex swapchain images are dma-bufs, modifier 0x%llx",
+                 (unsigned long long)handles[0].image.drm_modifier);
+    // all images get a semaphore or none, without the frames are handed over once drawn
+    bool synced = sync;
+    for (auto& handle : handles) {
+        if (! sync) break;
+        VkExportSemaphoreCreateInfo esci {
+            .sType       = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,
+            .pNext       = nullptr,
+            .handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT,
+        };
+        VkSemaphoreCreateInfo ci {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = &esci, .flags = 0
+        };
+        VVK_CHECK_ACT(
+            {
+                synced = false;
+                break;
+            },
+            device.handle().CreateSemaphore(ci, handle.semaphore));
+        VVK_CHECK_ACT(
+            {
+                synced = false;
+                break;
+            },
+            handle.semaphore.GetFdKHR(&handle.sem_fd));
+    }
+    if (sync && ! synced) {
+        LOG_ERROR("can't export ex swapchain semaphores, frames are handed over once drawn");
+        for (auto& handle : handles) {
+            if (handle.sem_fd >= 0) close(handle.sem_fd);
+            handle.sem_fd    = -1;
+            handle.semaphore = {};
+        }
     }
-    /*
-    VulkanExHandleSemaphore handle_sem;
-    {
-        vk::SemaphoreCreateInfo info;
-        vk::ExportSemaphoreCreateInfo esci { vk::ExternalSemaphoreHandleTypeFlagBits::eOpaqueFd };
-        info.setPNext(&esci);
-        VK_CHECK_RESULT_ACT(return nullptr, device.handle().createSemaphore(&info, nullptr,
-    &handle_sem.semaphore)); vk::SemaphoreGetFdInfoKHR fd_info; fd_info.semaphore =
-    handle_sem.semaphore; fd_info.handleType = vk::ExternalSemaphoreHandleTypeFlagBits::eOpaqueFd;
-        VK_CHECK_RESULT_ACT(return nullptr, device.handle().getSemaphoreFdKHR(&fd_info,
-    &handle_sem.handle.fd));
-    }*/
-    return std::make_unique<VulkanExSwapchain>(std::move(handles), VkExtent2D { w, h });
+    return std::make_unique<VulkanExSwapchain>(std::move(handles), VkExtent2D { w, h }, synced);
 }
 
 } // namespace vulkan
@@ -64,6 +64,8 @@ class VmaBuffer : public Handle<VkBuffer, VmaOwner, int> {
 
 public:
     VmaAllocation Allocation() const noexcept { return owner.allocation; }
+    // only set for allocations created mapped
+    void* MappedData() const noexcept { return owner.allocationInfo.pMappedData; }
 
     VkResult MapMemory(void** data) const {
         return vmaMapMemory(owner.allocator, owner.allocation, data);
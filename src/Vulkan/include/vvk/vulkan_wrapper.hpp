@@ -27,6 +27,8 @@ const char* ToString(VkFormat format) noexcept;
 
 const char* ToString(VkColorSpaceKHR color) noexcept;
 
+const char* ToString(VkPresentModeKHR mode) noexcept;
+
 } // namespace vvk
 
 #define VVK_CHECK(f)         VVK_CHECK_ACT(, f)
@@ -65,6 +67,7 @@ struct InstanceDispatch {
     PFN_vkGetDeviceProcAddr                       vkGetDeviceProcAddr {};
     PFN_vkGetPhysicalDeviceFeatures2KHR           vkGetPhysicalDeviceFeatures2KHR {};
     PFN_vkGetPhysicalDeviceFormatProperties       vkGetPhysicalDeviceFormatProperties {};
+    PFN_vkGetPhysicalDeviceFormatProperties2      vkGetPhysicalDeviceFormatProperties2 {};
     PFN_vkGetPhysicalDeviceMemoryProperties       vkGetPhysicalDeviceMemoryProperties {};
     PFN_vkGetPhysicalDeviceMemoryProperties2      vkGetPhysicalDeviceMemoryProperties2 {};
     PFN_vkGetPhysicalDeviceProperties             vkGetPhysicalDeviceProperties {};
@@ -89,6 +92,7 @@ struct DeviceDispatch : InstanceDispatch {
     PFN_vkCmdBeginDebugUtilsLabelEXT          vkCmdBeginDebugUtilsLabelEXT {};
     PFN_vkCmdBeginQuery                       vkCmdBeginQuery {};
     PFN_vkCmdBeginRenderPass                  vkCmdBeginRenderPass {};
+    PFN_vkCmdBeginRenderingKHR                vkCmdBeginRenderingKHR {};
     PFN_vkCmdBindDescriptorSets               vkCmdBindDescriptorSets {};
     PFN_vkCmdBindIndexBuffer                  vkCmdBindIndexBuffer {};
     PFN_vkCmdBindPipeline                     vkCmdBindPipeline {};
@@ -106,11 +110,14 @@ struct DeviceDispatch : InstanceDispatch {
     PFN_vkCmdEndDebugUtilsLabelEXT            vkCmdEndDebugUtilsLabelEXT {};
     PFN_vkCmdEndQuery                         vkCmdEndQuery {};
     PFN_vkCmdEndRenderPass                    vkCmdEndRenderPass {};
+    PFN_vkCmdEndRenderingKHR                  vkCmdEndRenderingKHR {};
+    PFN_vkCmdExecuteCommands                  vkCmdExecuteCommands {};
     PFN_vkCmdFillBuffer                       vkCmdFillBuffer {};
     PFN_vkCmdPipelineBarrier                  vkCmdPipelineBarrier {};
     PFN_vkCmdPushConstants                    vkCmdPushConstants {};
     PFN_vkCmdPushDescriptorSetKHR             vkCmdPushDescriptorSetKHR {};
     PFN_vkCmdPushDescriptorSetWithTemplateKHR vkCmdPushDescriptorSetWithTemplateKHR {};
+    PFN_vkCmdResetQueryPool                   vkCmdResetQueryPool {};
     PFN_vkCmdResolveImage                     vkCmdResolveImage {};
     PFN_vkCmdSetBlendConstants                vkCmdSetBlendConstants {};
     PFN_vkCmdSetDepthBias                     vkCmdSetDepthBias {};
@@ -123,6 +130,7 @@ struct DeviceDispatch : InstanceDispatch {
     PFN_vkCmdSetStencilWriteMask              vkCmdSetStencilWriteMask {};
     PFN_vkCmdSetViewport                      vkCmdSetViewport {};
     PFN_vkCmdWaitEvents                       vkCmdWaitEvents {};
+    PFN_vkCmdWriteTimestamp                   vkCmdWriteTimestamp {};
     PFN_vkCreateBuffer                        vkCreateBuffer {};
     PFN_vkCreateBufferView                    vkCreateBufferView {};
     PFN_vkCreateCommandPool                   vkCreateCommandPool {};
@@ -136,6 +144,7 @@ struct DeviceDispatch : InstanceDispatch {
     PFN_vkCreateGraphicsPipelines             vkCreateGraphicsPipelines {};
     PFN_vkCreateImage                         vkCreateImage {};
     PFN_vkCreateImageView                     vkCreateImageView {};
+    PFN_vkCreatePipelineCache                 vkCreatePipelineCache {};
     PFN_vkCreatePipelineLayout                vkCreatePipelineLayout {};
     PFN_vkCreateQueryPool                     vkCreateQueryPool {};
     PFN_vkCreateRenderPass                    vkCreateRenderPass {};
@@ -155,6 +164,7 @@ struct DeviceDispatch : InstanceDispatch {
     PFN_vkDestroyImage                        vkDestroyImage {};
     PFN_vkDestroyImageView                    vkDestroyImageView {};
     PFN_vkDestroyPipeline                     vkDestroyPipeline {};
+    PFN_vkDestroyPipelineCache                vkDestroyPipelineCache {};
     PFN_vkDestroyPipelineLayout               vkDestroyPipelineLayout {};
     PFN_vkDestroyQueryPool                    vkDestroyQueryPool {};
     PFN_vkDestroyRenderPass                   vkDestroyRenderPass {};
@@ -172,22 +182,31 @@ struct DeviceDispatch : InstanceDispatch {
     PFN_vkGetEventStatus                      vkGetEventStatus {};
     PFN_vkGetFenceStatus                      vkGetFenceStatus {};
     PFN_vkGetImageMemoryRequirements          vkGetImageMemoryRequirements {};
+    PFN_vkGetImageSubresourceLayout           vkGetImageSubresourceLayout {};
     PFN_vkGetMemoryFdKHR                      vkGetMemoryFdKHR {};
+    PFN_vkGetMemoryFdPropertiesKHR            vkGetMemoryFdPropertiesKHR {};
+    PFN_vkGetPipelineCacheData                vkGetPipelineCacheData {};
     PFN_vkGetPipelineExecutablePropertiesKHR  vkGetPipelineExecutablePropertiesKHR {};
     PFN_vkGetPipelineExecutableStatisticsKHR  vkGetPipelineExecutableStatisticsKHR {};
     PFN_vkGetQueryPoolResults                 vkGetQueryPoolResults {};
     PFN_vkGetSemaphoreCounterValueKHR         vkGetSemaphoreCounterValueKHR {};
+    PFN_vkGetSemaphoreFdKHR                   vkGetSemaphoreFdKHR {};
     PFN_vkMapMemory                           vkMapMemory {};
+    PFN_vkMergePipelineCaches                 vkMergePipelineCaches {};
     PFN_vkQueueSubmit                         vkQueueSubmit {};
+    PFN_vkResetCommandPool                    vkResetCommandPool {};
     PFN_vkResetFences                         vkResetFences {};
     PFN_vkUnmapMemory                         vkUnmapMemory {};
     PFN_vkUpdateDescriptorSetWithTemplateKHR  vkUpdateDescriptorSetWithTemplateKHR {};
     PFN_vkUpdateDescriptorSets                vkUpdateDescriptorSets {};
     PFN_vkWaitForFences                       vkWaitForFences {};
+    PFN_vkWaitForPresentKHR                   vkWaitForPresentKHR {};
     PFN_vkWaitSemaphoresKHR                   vkWaitSemaphoresKHR {};
 
     PFN_vkSetDebugUtilsObjectNameEXT vkSetDebugUtilsObjectNameEXT {};
     PFN_vkSetDebugUtilsObjectTagEXT  vkSetDebugUtilsObjectTagEXT {};
+
+    PFN_vkGetImageDrmFormatModifierPropertiesEXT vkGetImageDrmFormatModifierPropertiesEXT {};
 };
 
 template<typename THandle, typename Type = typename THandle::handle_type>
@@ -287,9 +306,11 @@ void Destroy(VkInstance, VkDebugUtilsMessengerEXT, const InstanceDispatch&) noex
 void Destroy(VkInstance, VkSurfaceKHR, const InstanceDispatch&) noexcept;
 void Destroy(VkDevice, VkCommandPool, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkPipeline, const DeviceDispatch&) noexcept;
+void Destroy(VkDevice, VkPipelineCache, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkPipelineLayout, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkRenderPass, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkDescriptorSetLayout, const DeviceDispatch&) noexcept;
+void Destroy(VkDevice, VkDescriptorPool, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkImage, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkImageView, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkDeviceMemory, const DeviceDispatch&) noexcept;
@@ -299,6 +320,7 @@ void Destroy(VkDevice, VkSampler, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkSemaphore, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkFence, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkFramebuffer, const DeviceDispatch&) noexcept;
+void Destroy(VkDevice, VkQueryPool, const DeviceDispatch&) noexcept;
 
 VkResult Free(VkDevice, VkCommandPool, Span<VkCommandBuffer>, const DeviceDispatch&) noexcept;
 
@@ -342,6 +364,11 @@ class Image : public Handle<VkImage, VkDevice, DeviceDispatch> {
 
 public:
     VkResult BindMemory(VkDeviceMemory memory, VkDeviceSize offset) const noexcept;
+
+    // created with drm format modifier tiling
+    VkResult GetDrmFormatModifierEXT(uint64_t*) const noexcept;
+
+    VkSubresourceLayout GetSubresourceLayout(const VkImageSubresource&) const noexcept;
 };
 
 class ImageView : public Handle<VkImageView, VkDevice, DeviceDispatch> {
@@ -352,7 +379,7 @@ class Queue : public Handle<VkQueue, NoOwnerLife, DeviceDispatch> {
     using Handle<VkQueue, NoOwnerLife, DeviceDispatch>::Handle;
 
 public:
-    VkResult Submit(Span<VkSubmitInfo> submit_infos,
+    VkResult Submit(Span<const VkSubmitInfo> submit_infos,
                     VkFence            fence = VK_NULL_HANDLE) const noexcept {
         return dld->vkQueueSubmit(
             handle, (uint32_t)submit_infos.size(), submit_infos.data(), fence);
@@ -384,6 +411,8 @@ public:
 
     VkFormatProperties GetFormatProperties(VkFormat) const noexcept;
 
+    void GetFormatProperties2(VkFormat, VkFormatProperties2&) const noexcept;
+
     VkResult EnumerateDeviceExtensionProperties(std::vector<VkExtensionProperties>&) const;
 
     std::vector<VkQueueFamilyProperties> GetQueueFamilyProperties() const;
@@ -405,13 +434,18 @@ class CommandPool : public Handle<VkCommandPool, VkDevice, DeviceDispatch> {
 
 public:
     VkResult Allocate(std::size_t num_buffers, VkCommandBufferLevel level, CommandBuffers&) const;
+
+    VkResult Reset(VkCommandPoolResetFlags flags = 0) const {
+        return dld->vkResetCommandPool(owner, handle, flags);
+    }
 };
 
 class DeviceMemory : public Handle<VkDeviceMemory, VkDevice, DeviceDispatch> {
     using Handle<VkDeviceMemory, VkDevice, DeviceDispatch>::Handle;
 
 public:
-    VkResult GetMemoryFdKHR(int*) const;
+    VkResult GetMemoryFdKHR(int*, VkExternalMemoryHandleTypeFlagBits =
+                                      VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT) const;
 
     VkResult Map(VkDeviceSize offset, VkDeviceSize size, uint8_t** data) const {
         return (dld->vkMapMemory(owner, handle, offset, size, 0, (void**)data));
@@ -432,6 +466,53 @@ class ShaderModule : public Handle<VkShaderModule, VkDevice, DeviceDispatch> {
 public:
 };
 
+class PipelineCache : public Handle<VkPipelineCache, VkDevice, DeviceDispatch> {
+    using Handle<VkPipelineCache, VkDevice, DeviceDispatch>::Handle;
+
+public:
+    VkResult GetData(std::vector<uint8_t>&) const;
+
+    VkResult Merge(Span<const VkPipelineCache> src_caches) const noexcept {
+        return dld->vkMergePipelineCaches(owner, handle, src_caches.size(), src_caches.data());
+    }
+};
+
+// sets are freed with the pool
+class DescriptorPool : public Handle<VkDescriptorPool, VkDevice, DeviceDispatch> {
+    using Handle<VkDescriptorPool, VkDevice, DeviceDispatch>::Handle;
+
+public:
+    VkResult Allocate(Span<const VkDescriptorSetLayout> layouts,
+                      VkDescriptorSet*                  sets) const noexcept {
+        VkDescriptorSetAllocateInfo ai {
+            .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext              = nullptr,
+            .descriptorPool     = handle,
+            .descriptorSetCount = layouts.size(),
+            .pSetLayouts        = layouts.data(),
+        };
+        return dld->vkAllocateDescriptorSets(owner, &ai, sets);
+    }
+};
+
+class QueryPool : public Handle<VkQueryPool, VkDevice, DeviceDispatch> {
+    using Handle<VkQueryPool, VkDevice, DeviceDispatch>::Handle;
+
+public:
+    // VK_NOT_READY
+    VkResult GetResults(uint32_t first, uint32_t count, Span<uint64_t> data, VkDeviceSize stride,
+                        VkQueryResultFlags flags) const noexcept {
+        return dld->vkGetQueryPoolResults(owner,
+                                          handle,
+                                          first,
+                                          count,
+                                          data.size() * sizeof(uint64_t),
+                                          data.data(),
+                                          stride,
+                                          flags | VK_QUERY_RESULT_64_BIT);
+    }
+};
+
 class Fence : public Handle<VkFence, VkDevice, DeviceDispatch> {
     using Handle<VkFence, VkDevice, DeviceDispatch>::Handle;
 
@@ -453,6 +534,9 @@ public:
         return dld->vkGetSemaphoreCounterValueKHR(owner, handle, value);
     }
 
+    // created with an opaque fd export
+    VkResult GetFdKHR(int*) const;
+
     // VK_TIMEOUT
     VkResult Wait(uint64_t value, uint64_t timeout = std::numeric_limits<uint64_t>::max()) const {
         const VkSemaphoreWaitInfoKHR wait_info {
@@ -482,11 +566,22 @@ public:
 
     VkResult AllocateMemory(const VkMemoryAllocateInfo& ai, DeviceMemory&) const noexcept;
 
+    // the memory types an fd of another api can be imported as
+    VkResult GetMemoryFdPropertiesKHR(VkExternalMemoryHandleTypeFlagBits, int fd,
+                                      VkMemoryFdPropertiesKHR&) const noexcept;
+
     VkResult CreateCommandPool(const VkCommandPoolCreateInfo& ci, CommandPool&) const;
     VkResult CreateDescriptorSetLayout(const VkDescriptorSetLayoutCreateInfo& ci,
                                        DescriptorSetLayout&) const noexcept;
-    VkResult CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& ci,
-                                    Pipeline&) const noexcept;
+    VkResult CreateDescriptorPool(const VkDescriptorPoolCreateInfo& ci,
+                                  DescriptorPool&) const noexcept;
+    VkResult CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& ci, Pipeline&,
+                                    VkPipelineCache cache = VK_NULL_HANDLE) const noexcept;
+    VkResult CreateComputePipeline(const VkComputePipelineCreateInfo& ci, Pipeline&,
+                                   VkPipelineCache cache = VK_NULL_HANDLE) const noexcept;
+
+    VkResult CreatePipelineCache(const VkPipelineCacheCreateInfo& ci,
+                                 PipelineCache&) const noexcept;
 
     VkResult CreateRenderPass(const VkRenderPassCreateInfo& ci, RenderPass&) const noexcept;
 
@@ -507,16 +602,28 @@ public:
 
     VkResult CreateFence(const VkFenceCreateInfo& ci, Fence&) const noexcept;
 
+    VkResult CreateQueryPool(const VkQueryPoolCreateInfo& ci, QueryPool&) const noexcept;
+
     VkResult CreateSampler(const VkSamplerCreateInfo& ci, Sampler&) const noexcept;
 
     VkResult WaitIdle() const noexcept { return dld->vkDeviceWaitIdle(handle); }
 
+    void UpdateDescriptorSets(Span<const VkWriteDescriptorSet> writes) const noexcept {
+        dld->vkUpdateDescriptorSets(handle, writes.size(), writes.data(), 0, nullptr);
+    }
+
     VkResult AcquireNextImageKHR(VkSwapchainKHR swapchain, uint64_t timeout, VkSemaphore semaphore,
                                  VkFence fence, uint32_t* image_index) const noexcept {
         return dld->vkAcquireNextImageKHR(
             handle, swapchain, timeout, semaphore, fence, image_index);
     }
 
+    // VK_TIMEOUT, needs VK_KHR_present_wait
+    VkResult WaitForPresentKHR(VkSwapchainKHR swapchain, uint64_t present_id,
+                               uint64_t timeout) const noexcept {
+        return dld->vkWaitForPresentKHR(handle, swapchain, present_id, timeout);
+    }
+
     const DeviceDispatch& Dispatch() const noexcept { return *dld; }
 
 private:
@@ -539,6 +646,16 @@ public:
 
     void EndRenderPass() const noexcept { dld->vkCmdEndRenderPass(handle); }
 
+    void BeginRenderingKHR(const VkRenderingInfoKHR& rendering_info) const noexcept {
+        dld->vkCmdBeginRenderingKHR(handle, &rendering_info);
+    }
+
+    void EndRenderingKHR() const noexcept { dld->vkCmdEndRenderingKHR(handle); }
+
+    void ExecuteCommands(Span<const VkCommandBuffer> secondaries) const noexcept {
+        dld->vkCmdExecuteCommands(handle, secondaries.size(), secondaries.data());
+    }
+
     void BeginQuery(VkQueryPool query_pool, uint32_t query,
                     VkQueryControlFlags flags) const noexcept {
         dld->vkCmdBeginQuery(handle, query_pool, query, flags);
@@ -548,6 +665,15 @@ public:
         dld->vkCmdEndQuery(handle, query_pool, query);
     }
 
+    void ResetQueryPool(VkQueryPool query_pool, uint32_t first, uint32_t count) const noexcept {
+        dld->vkCmdResetQueryPool(handle, query_pool, first, count);
+    }
+
+    void WriteTimestamp(VkPipelineStageFlagBits stage, VkQueryPool query_pool,
+                        uint32_t query) const noexcept {
+        dld->vkCmdWriteTimestamp(handle, stage, query_pool, query);
+    }
+
     void BindDescriptorSets(VkPipelineBindPoint bind_point, VkPipelineLayout layout, uint32_t first,
                             Span<VkDescriptorSet> sets,
                             Span<uint32_t>        dynamic_offsets) const noexcept {
@@ -43,6 +43,7 @@ bool Load(VkInstance instance, InstanceDispatch& dld) noexcept {
     X(vkDestroyDebugUtilsMessengerEXT);
     X(vkDestroySurfaceKHR);
     X(vkGetPhysicalDeviceFeatures2KHR);
+    X(vkGetPhysicalDeviceFormatProperties2);
     X(vkGetPhysicalDeviceProperties2KHR);
     X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR);
     X(vkGetPhysicalDeviceSurfaceFormatsKHR);
@@ -70,6 +71,7 @@ bool Load(VkDevice device, DeviceDispatch& dld) noexcept {
     X(vkBindImageMemory);
     X(vkCmdBeginQuery);
     X(vkCmdBeginRenderPass);
+    X(vkCmdBeginRenderingKHR);
     X(vkCmdBindDescriptorSets);
     X(vkCmdBindIndexBuffer);
     X(vkCmdBindPipeline);
@@ -86,12 +88,15 @@ bool Load(VkDevice device, DeviceDispatch& dld) noexcept {
     X(vkCmdDrawIndexed);
     X(vkCmdEndQuery);
     X(vkCmdEndRenderPass);
+    X(vkCmdEndRenderingKHR);
     X(vkCmdEndDebugUtilsLabelEXT);
+    X(vkCmdExecuteCommands);
     X(vkCmdFillBuffer);
     X(vkCmdPipelineBarrier);
     X(vkCmdPushConstants);
     X(vkCmdPushDescriptorSetKHR);
     X(vkCmdPushDescriptorSetWithTemplateKHR);
+    X(vkCmdResetQueryPool);
     X(vkCmdSetBlendConstants);
     X(vkCmdSetDepthBias);
     X(vkCmdSetDepthBounds);
@@ -102,6 +107,7 @@ bool Load(VkDevice device, DeviceDispatch& dld) noexcept {
     X(vkCmdSetStencilWriteMask);
     X(vkCmdSetViewport);
     X(vkCmdWaitEvents);
+    X(vkCmdWriteTimestamp);
     X(vkCmdSetLineWidth);
     X(vkCmdResolveImage);
     X(vkCreateBuffer);
@@ -117,6 +123,7 @@ bool Load(VkDevice device, DeviceDispatch& dld) noexcept {
     X(vkCreateGraphicsPipelines);
     X(vkCreateImage);
     X(vkCreateImageView);
+    X(vkCreatePipelineCache);
     X(vkCreatePipelineLayout);
     X(vkCreateQueryPool);
     X(vkCreateRenderPass);
@@ -136,6 +143,7 @@ bool Load(VkDevice device, DeviceDispatch& dld) noexcept {
     X(vkDestroyImage);
     X(vkDestroyImageView);
     X(vkDestroyPipeline);
+    X(vkDestroyPipelineCache);
     X(vkDestroyPipelineLayout);
     X(vkDestroyQueryPool);
     X(vkDestroyRenderPass);
@@ -152,14 +160,21 @@ bool Load(VkDevice device, DeviceDispatch& dld) noexcept {
     X(vkGetDeviceQueue);
     X(vkGetEventStatus);
     X(vkGetFenceStatus);
+    X(vkGetImageDrmFormatModifierPropertiesEXT);
     X(vkGetImageMemoryRequirements);
+    X(vkGetImageSubresourceLayout);
     X(vkGetMemoryFdKHR);
+    X(vkGetMemoryFdPropertiesKHR);
+    X(vkGetPipelineCacheData);
     X(vkGetQueryPoolResults);
     X(vkGetPipelineExecutablePropertiesKHR);
     X(vkGetPipelineExecutableStatisticsKHR);
     X(vkGetSemaphoreCounterValueKHR);
+    X(vkGetSemaphoreFdKHR);
     X(vkMapMemory);
+    X(vkMergePipelineCaches);
     X(vkQueueSubmit);
+    X(vkResetCommandPool);
     X(vkResetFences);
     X(vkSetDebugUtilsObjectNameEXT);
     X(vkSetDebugUtilsObjectTagEXT);
@@ -167,6 +182,7 @@ bool Load(VkDevice device, DeviceDispatch& dld) noexcept {
     X(vkUpdateDescriptorSetWithTemplateKHR);
     X(vkUpdateDescriptorSets);
     X(vkWaitForFences);
+    X(vkWaitForPresentKHR);
     X(vkWaitSemaphoresKHR);
 #undef X
     return true;
@@ -191,6 +207,9 @@ void Destroy(VkDevice device, VkCommandPool handle, const DeviceDispatch& dld) n
 void Destroy(VkDevice device, VkPipeline handle, const DeviceDispatch& dld) noexcept {
     dld.vkDestroyPipeline(device, handle, nullptr);
 }
+void Destroy(VkDevice device, VkPipelineCache handle, const DeviceDispatch& dld) noexcept {
+    dld.vkDestroyPipelineCache(device, handle, nullptr);
+}
 void Destroy(VkDevice device, VkPipelineLayout handle, const DeviceDispatch& dld) noexcept {
     dld.vkDestroyPipelineLayout(device, handle, nullptr);
 }
@@ -203,6 +222,10 @@ void Destroy(VkDevice device, VkDescriptorSetLayout handle, const DeviceDispatch
     dld.vkDestroyDescriptorSetLayout(device, handle, nullptr);
 }
 
+void Destroy(VkDevice device, VkDescriptorPool handle, const DeviceDispatch& dld) noexcept {
+    dld.vkDestroyDescriptorPool(device, handle, nullptr);
+}
+
 void Destroy(VkDevice device, VkImage handle, const DeviceDispatch& dld) noexcept {
     dld.vkDestroyImage(device, handle, nullptr);
 }
@@ -239,6 +262,10 @@ void Destroy(VkDevice device, VkFramebuffer handle, const DeviceDispatch& dld) n
     dld.vkDestroyFramebuffer(device, handle, nullptr);
 }
 
+void Destroy(VkDevice device, VkQueryPool handle, const DeviceDispatch& dld) noexcept {
+    dld.vkDestroyQueryPool(device, handle, nullptr);
+}
+
 void Destroy(VkInstance instance, VkSurfaceKHR handle, const InstanceDispatch& dld) noexcept {
     dld.vkDestroySurfaceKHR(instance, handle, nullptr);
 }
@@ -339,6 +366,12 @@ VkResult Device::AllocateMemory(const VkMemoryAllocateInfo& ai, DeviceMemory& me
     return res;
 }
 
+VkResult Device::GetMemoryFdPropertiesKHR(VkExternalMemoryHandleTypeFlagBits type, int fd,
+                                          VkMemoryFdPropertiesKHR& props) const noexcept {
+    props.sType = VK_STRUCTURE_TYPE_MEMORY_FD_PROPERTIES_KHR;
+    return dld->vkGetMemoryFdPropertiesKHR(handle, type, fd, &props);
+}
+
 VkResult Device::CreateCommandPool(const VkCommandPoolCreateInfo& ci, CommandPool& pool) const {
     VkCommandPool vkpool;
     VkResult      res = dld->vkCreateCommandPool(handle, &ci, nullptr, &vkpool);
@@ -423,6 +456,21 @@ VkResult Device::CreateFence(const VkFenceCreateInfo& ci, Fence& fe) const noexc
     return res;
 }
 
+VkResult Device::CreateDescriptorPool(const VkDescriptorPoolCreateInfo& ci,
+                                      DescriptorPool&                   pool) const noexcept {
+    VkDescriptorPool object;
+    VkResult         res = dld->vkCreateDescriptorPool(handle, &ci, nullptr, &object);
+    if (res == VK_SUCCESS) pool = DescriptorPool(object, handle, *dld);
+    return res;
+}
+
+VkResult Device::CreateQueryPool(const VkQueryPoolCreateInfo& ci, QueryPool& pool) const noexcept {
+    VkQueryPool object;
+    VkResult    res = dld->vkCreateQueryPool(handle, &ci, nullptr, &object);
+    if (res == VK_SUCCESS) pool = QueryPool(object, handle, *dld);
+    return res;
+}
+
 VkResult Device::CreateSampler(const VkSamplerCreateInfo& ci, Sampler& sam) const noexcept {
     VkSampler object;
     VkResult  res = dld->vkCreateSampler(handle, &ci, nullptr, &object);
@@ -430,14 +478,30 @@ VkResult Device::CreateSampler(const VkSamplerCreateInfo& ci, Sampler& sam) cons
     return res;
 }
 
-VkResult Device::CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& ci,
-                                        Pipeline& pipeline) const noexcept {
+VkResult Device::CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& ci, Pipeline& pipeline,
+                                        VkPipelineCache cache) const noexcept {
+    VkPipeline object;
+    VkResult   res = dld->vkCreateGraphicsPipelines(handle, cache, 1, &ci, nullptr, &object);
+    if (res == VK_SUCCESS) pipeline = Pipeline(object, handle, *dld);
+    return res;
+}
+
+VkResult Device::CreateComputePipeline(const VkComputePipelineCreateInfo& ci, Pipeline& pipeline,
+                                       VkPipelineCache cache) const noexcept {
     VkPipeline object;
-    VkResult res = dld->vkCreateGraphicsPipelines(handle, VK_NULL_HANDLE, 1, &ci, nullptr, &object);
+    VkResult   res = dld->vkCreateComputePipelines(handle, cache, 1, &ci, nullptr, &object);
     if (res == VK_SUCCESS) pipeline = Pipeline(object, handle, *dld);
     return res;
 }
 
+VkResult Device::CreatePipelineCache(const VkPipelineCacheCreateInfo& ci,
+                                     PipelineCache&                   cache) const noexcept {
+    VkPipelineCache object;
+    VkResult        res = dld->vkCreatePipelineCache(handle, &ci, nullptr, &object);
+    if (res == VK_SUCCESS) cache = PipelineCache(object, handle, *dld);
+    return res;
+}
+
 VkResult Buffer::BindMemory(VkDeviceMemory memory, VkDeviceSize offset) const noexcept {
     return dld->vkBindBufferMemory(owner, handle, memory, offset);
 }
@@ -446,6 +510,31 @@ VkResult Image::BindMemory(VkDeviceMemory memory, VkDeviceSize offset) const noe
     return dld->vkBindImageMemory(owner, handle, memory, offset);
 }
 
+VkResult Image::GetDrmFormatModifierEXT(uint64_t* modifier) const noexcept {
+    VkImageDrmFormatModifierPropertiesEXT props {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_PROPERTIES_EXT,
+        .pNext = nullptr,
+    };
+    VkResult res = dld->vkGetImageDrmFormatModifierPropertiesEXT(owner, handle, &props);
+    if (res == VK_SUCCESS) *modifier = props.drmFormatModifier;
+    return res;
+}
+
+VkSubresourceLayout
+Image::GetSubresourceLayout(const VkImageSubresource& subresource) const noexcept {
+    VkSubresourceLayout layout {};
+    dld->vkGetImageSubresourceLayout(owner, handle, &subresource, &layout);
+    return layout;
+}
+
+VkResult PipelineCache::GetData(std::vector<uint8_t>& data) const {
+    std::size_t size;
+    if (auto res = dld->vkGetPipelineCacheData(owner, handle, &size, nullptr); res != VK_SUCCESS)
+        return res;
+    data.resize(size);
+    return dld->vkGetPipelineCacheData(owner, handle, &size, data.data());
+}
+
 VkResult SwapchainKHR::GetImages(std::vector<VkImage>& images) const {
     uint32_t num;
     if (auto res = dld->vkGetSwapchainImagesKHR(owner, handle, &num, nullptr); res != VK_SUCCESS)
@@ -464,6 +553,21 @@ void PhysicalDevice::GetProperties2KHR(VkPhysicalDeviceProperties2KHR& props) co
     dld->vkGetPhysicalDeviceProperties2KHR(handle, &props);
 }
 
+void PhysicalDevice::GetFeatures2KHR(VkPhysicalDeviceFeatures2KHR& features) const noexcept {
+    dld->vkGetPhysicalDeviceFeatures2KHR(handle, &features);
+}
+
+VkFormatProperties PhysicalDevice::GetFormatProperties(VkFormat format) const noexcept {
+    VkFormatProperties props {};
+    dld->vkGetPhysicalDeviceFormatProperties(handle, format, &props);
+    return props;
+}
+
+void PhysicalDevice::GetFormatProperties2(VkFormat format,
+                                          VkFormatProperties2& props) const noexcept {
+    dld->vkGetPhysicalDeviceFormatProperties2(handle, format, &props);
+}
+
 VkResult PhysicalDevice::EnumerateDeviceExtensionProperties(
     std::vector<VkExtensionProperties>& properties) const {
     uint32_t num;
@@ -545,16 +649,26 @@ VkResult CommandPool::Allocate(std::size_t num_buffers, VkCommandBufferLevel lev
     return res;
 }
 
-VkResult DeviceMemory::GetMemoryFdKHR(int* fd) const {
+VkResult DeviceMemory::GetMemoryFdKHR(int* fd, VkExternalMemoryHandleTypeFlagBits type) const {
     const VkMemoryGetFdInfoKHR get_fd_info {
         .sType      = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR,
         .pNext      = nullptr,
         .memory     = handle,
-        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT_KHR,
+        .handleType = type,
     };
     return dld->vkGetMemoryFdKHR(owner, &get_fd_info, fd);
 }
 
+VkResult Semaphore::GetFdKHR(int* fd) const {
+    const VkSemaphoreGetFdInfoKHR get_fd_info {
+        .sType      = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
+        .pNext      = nullptr,
+        .semaphore  = handle,
+        .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT,
+    };
+    return dld->vkGetSemaphoreFdKHR(owner, &get_fd_info, fd);
+}
+
 std::optional<std::vector<VkExtensionProperties>>
 EnumerateInstanceExtensionProperties(const InstanceDispatch& dld) {
     uint32_t num;
@@ -807,6 +921,20 @@ const char* ToString(VkColorSpaceKHR o) noexcept {
     }
     #undef X
 }
+
+const char* ToString(VkPresentModeKHR o) noexcept {
+    #define X(str) case VkPresentModeKHR::VK_##str: return "VK_" #str;
+    switch (o) {
+        X(PRESENT_MODE_IMMEDIATE_KHR);
+        X(PRESENT_MODE_MAILBOX_KHR);
+        X(PRESENT_MODE_FIFO_KHR);
+        X(PRESENT_MODE_FIFO_RELAXED_KHR);
+
+        default:
+        return "VK_PRESENT_MODE_UNKNOWN";
+    }
+    #undef X
+}
 // cX(lang-format on
 
 } //X( namespace vvk
@@ -0,0 +1,117 @@
+#include "AsyncCompute.hpp"
+#include "Utils/Logging.h"
+
+#include <array>
+#include <cassert>
+#include <utility>
+
+using namespace wallpaper::vulkan;
+
+namespace
+{
+// of the info given to submit, the compute's is added
+constexpr usize MaxWaits { 4 };
+
+constexpr VkCommandBufferBeginInfo OneTime {
+    .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .pNext            = nullptr,
+    .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    .pInheritanceInfo = nullptr,
+};
+} // namespace
+
+AsyncCompute::AsyncCompute()  = default;
+AsyncCompute::~AsyncCompute() = default;
+
+bool AsyncCompute::init(const Device& device, usize frame_num) {
+    if (! device.async_compute()) return false;
+    VVK_CHECK_BOOL_RE(device.compute_cmd_pool().Allocate(
+        frame_num, VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_compute_cmds));
+    VVK_CHECK_BOOL_RE(
+        device.cmd_pool().Allocate(frame_num, VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_graphics_cmds));
+
+    m_slots.resize(frame_num);
+    VkSemaphoreCreateInfo ci { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = nullptr };
+    for (usize i = 0; i < frame_num; i++) {
+        auto& slot    = m_slots[i];
+        slot.compute  = vvk::CommandBuffer(m_compute_cmds[i], device.handle().Dispatch());
+        slot.graphics = vvk::CommandBuffer(m_graphics_cmds[i], device.handle().Dispatch());
+        VVK_CHECK_BOOL_RE(device.handle().CreateSemaphore(ci, slot.done));
+    }
+    LOG_INFO("particles simulated on the async compute queue");
+    return true;
+}
+
+void AsyncCompute::destroy() {
+    m_slots.clear();
+    m_compute_cmds  = {};
+    m_graphics_cmds = {};
+}
+
+const vvk::CommandBuffer& AsyncCompute::begin(RenderingResources& rr) {
+    auto& slot = m_slots[rr.index];
+    if (slot.split) return slot.compute;
+    slot.split = true;
+    (void)slot.compute.Begin(OneTime);
+
+    // the slot's fence covers both graphics buffers, they only swap roles
+    (void)rr.command.End();
+    std::swap(rr.command, slot.graphics);
+    (void)rr.command.Begin(OneTime);
+    return slot.compute;
+}
+
+VkResult AsyncCompute::submit(const Device& device, const QueueParameters& queue,
+                              RenderingResources& rr, const VkSubmitInfo& info, VkFence fence) {
+    auto& slot = m_slots[rr.index];
+    if (! slot.split) return device.Submit(queue, info, fence);
+    slot.split = false;
+
+    (void)slot.compute.End();
+    VkSubmitInfo compute_info {
+        .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext                = nullptr,
+        .waitSemaphoreCount   = 0,
+        .pWaitSemaphores      = nullptr,
+        .pWaitDstStageMask    = nullptr,
+        .commandBufferCount   = 1,
+        .pCommandBuffers      = slot.compute.address(),
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores    = slot.done.address(),
+    };
+    if (VkResult res = device.Submit(device.compute_queue(), compute_info); res != VK_SUCCESS)
+        return res;
+
+    assert(info.waitSemaphoreCount < MaxWaits);
+    std::array<VkSemaphore, MaxWaits>          waits;
+    std::array<VkPipelineStageFlags, MaxWaits> stages;
+    u32                                        wait_num = 0;
+    for (; wait_num < info.waitSemaphoreCount && wait_num + 1 < MaxWaits; wait_num++) {
+        waits[wait_num]  = info.pWaitSemaphores[wait_num];
+        stages[wait_num] = info.pWaitDstStageMask[wait_num];
+    }
+    waits[wait_num]  = *slot.done;
+    stages[wait_num] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    wait_num++;
+
+    std::array batches {
+        VkSubmitInfo {
+            .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext                = nullptr,
+            .waitSemaphoreCount   = 0,
+            .pWaitSemaphores      = nullptr,
+            .pWaitDstStageMask    = nullptr,
+            .commandBufferCount   = 1,
+            .pCommandBuffers      = slot.graphics.address(),
+            .signalSemaphoreCount = 0,
+            .pSignalSemaphores    = nullptr,
+        },
+        info,
+    };
+    batches[1].waitSemaphoreCount = wait_num;
+    batches[1].pWaitSemaphores    = waits.data();
+    batches[1].pWaitDstStageMask  = stages.data();
+    batches[1].commandBufferCount = 1;
+    batches[1].pCommandBuffers    = rr.command.address();
+    return device.Submit(queue, batches, fence);
+}
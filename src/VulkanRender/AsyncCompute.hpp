@@ -0,0 +1,52 @@
+#pragma once
+#include "Core/NoCopyMove.hpp"
+#include "Vulkan/Device.hpp"
+#include "Resource.hpp"
+
+#include <vector>
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+// Compute work of a frame on the gpu's compute queue, when it has a family without graphics.
+// The frame's graphics commands are split before the first pass that asks for compute, the one
+// drawing what the compute writes. The part before is submitted as it is, the part after waits
+// on the compute at vertex input, so the compute runs beside the passes before it.
+// Nothing waits the other way, what the compute writes has a copy per frame in flight and the
+// frame that last read one is done before the slot is used again, see ParticleCompute.
+class AsyncCompute : NoCopy, NoMove {
+public:
+    AsyncCompute();
+    ~AsyncCompute();
+
+    // false without a compute family of its own, compute work stays in the graphics commands
+    bool init(const Device&, usize frame_num);
+    void destroy();
+
+    // the frame's compute commands, begun on the first call of a frame, which ends the graphics
+    // commands recorded so far and begins rr.command anew, so never inside a render pass
+    const vvk::CommandBuffer& begin(RenderingResources&);
+    // the frame's compute first if it has any, then its graphics batches, the last one is info
+    // waiting on the compute too
+    VkResult submit(const Device&, const QueueParameters&, RenderingResources&,
+                    const VkSubmitInfo& info, VkFence);
+
+private:
+    struct Slot {
+        vvk::CommandBuffer compute;
+        // the other graphics commands of the slot, the ones before the split once it is
+        vvk::CommandBuffer graphics;
+        // signaled by the compute, waited on by the graphics after the split
+        vvk::Semaphore done;
+        bool           split { false };
+    };
+
+    vvk::CommandBuffers m_compute_cmds;
+    vvk::CommandBuffers m_graphics_cmds;
+    std::vector<Slot>   m_slots;
+};
+
+} // namespace vulkan
+} // namespace wallpaper
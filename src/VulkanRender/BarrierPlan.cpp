@@ -0,0 +1,181 @@
+#include "BarrierPlan.hpp"
+#include "Utils/Logging.h"
+#include "Core/MapSet.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <string_view>
+
+using namespace wallpaper;
+using namespace wallpaper::vulkan;
+
+namespace
+{
+struct Access {
+    VkPipelineStageFlags stage { 0 };
+    // made available when waited on as a write
+    VkAccessFlags src_access { 0 };
+    // made visible when it waits
+    VkAccessFlags dst_access { 0 };
+};
+
+constexpr VkPipelineStageFlags sample_stages {
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+};
+// every stage a pass touches a target in
+constexpr VkPipelineStageFlags pass_stages { sample_stages |
+                                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                             VK_PIPELINE_STAGE_TRANSFER_BIT };
+constexpr VkAccessFlags pass_writes { VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                      VK_ACCESS_TRANSFER_WRITE_BIT };
+
+Access ReadOf(VulkanPass::Use use) {
+    if (use == VulkanPass::Use::Transfer)
+        return { VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_READ_BIT };
+    return { sample_stages, 0, VK_ACCESS_SHADER_READ_BIT };
+}
+
+Access WriteOf(VulkanPass::Use use) {
+    if (use == VulkanPass::Use::Transfer)
+        return { VK_PIPELINE_STAGE_TRANSFER_BIT,
+                 VK_ACCESS_TRANSFER_WRITE_BIT,
+                 VK_ACCESS_TRANSFER_WRITE_BIT };
+    // blending and load ops read the attachment too
+    return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+             VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+}
+
+bool Covers(VkFlags flags, VkFlags what) { return (flags & what) == what; }
+
+// a target going through the frame
+struct State {
+    // the last write, and the stages and accesses it's visible to
+    Access               write;
+    VkPipelineStageFlags visible_stages { 0 };
+    VkAccessFlags        visible_access { 0 };
+    // stages read in since, and the stages the reads are ordered before
+    VkPipelineStageFlags reads { 0 };
+    VkPipelineStageFlags reads_before { 0 };
+
+    bool visibleTo(const Access& a) const {
+        return Covers(visible_stages, a.stage) && Covers(visible_access, a.dst_access);
+    }
+    void apply(const BarrierPlan::Barrier& b) {
+        if (write.stage != 0 && Covers(b.src_stage, write.stage) &&
+            Covers(b.src_access, write.src_access)) {
+            visible_stages |= b.dst_stage;
+            visible_access |= b.dst_access;
+        }
+        if (Covers(b.src_stage, reads)) reads_before |= b.dst_stage;
+    }
+};
+} // namespace
+
+BarrierPlan::Barrier& BarrierPlan::Barrier::operator|=(const Barrier& o) {
+    src_stage |= o.src_stage;
+    dst_stage |= o.dst_stage;
+    src_access |= o.src_access;
+    dst_access |= o.dst_access;
+    return *this;
+}
+
+void BarrierPlan::build(std::span<VulkanPass* const> passes, std::span<const PassCache::PassIO> io,
+                        const Set<std::string>& shared, const std::vector<bool>& joined) {
+    clear();
+    assert(passes.size() == io.size());
+    const usize num = passes.size();
+    m_barriers.resize(num);
+
+    Map<std::string_view, State> states;
+    // the first round leaves what the frame before did, the second is what every frame waits on
+    for (int round = 0; round < 2; round++) {
+        Set<std::string_view> touched;
+        for (usize first = 0; first < num;) {
+            // no barrier inside a render pass, a run waits for all of its passes at once
+            usize end = first + 1;
+            while (end < num && end < joined.size() && joined[end]) end++;
+
+            Barrier b;
+            for (usize i = first; i < end; i++) {
+                const Access read  = ReadOf(passes[i]->readUse());
+                const Access write = WriteOf(passes[i]->writeUse());
+                for (auto& key : io[i].reads) {
+                    auto& s = states[key];
+                    touched.insert(key);
+                    if (s.write.stage != 0 && ! s.visibleTo(read))
+                        b |= { s.write.stage, read.stage, s.write.src_access, read.dst_access };
+                    // copies move what they read out of the shader layout, after the other reads
+                    if (read.stage == VK_PIPELINE_STAGE_TRANSFER_BIT && s.reads != 0 &&
+                        ! Covers(s.reads_before, read.stage))
+                        b |= { s.reads, read.stage, 0, 0 };
+                }
+                for (auto& key : io[i].writes) {
+                    auto& s = states[key];
+                    // a shared image changes hands at the first write, after all use of the others
+                    if (touched.insert(key).second && exists(shared, key))
+                        b |= { pass_stages, write.stage, pass_writes, write.dst_access };
+                    if (s.reads != 0 && ! Covers(s.reads_before, write.stage))
+                        b |= { s.reads, write.stage, 0, 0 };
+                    if (s.write.stage != 0 && ! s.visibleTo(write))
+                        b |= { s.write.stage, write.stage, s.write.src_access, write.dst_access };
+                }
+            }
+            if (! b.empty()) {
+                for (auto& [key, s] : states) s.apply(b);
+            }
+            m_barriers[first] = b;
+
+            for (usize i = first; i < end; i++) {
+                const Access read  = ReadOf(passes[i]->readUse());
+                const Access write = WriteOf(passes[i]->writeUse());
+                for (auto& key : io[i].reads) {
+                    auto& s = states[key];
+                    s.reads |= read.stage;
+                    s.reads_before = 0;
+                }
+                for (auto& key : io[i].writes) states[key] = State { .write = write };
+            }
+            first = end;
+        }
+    }
+    m_count = (usize)std::count_if(m_barriers.begin(), m_barriers.end(), [](auto& b) {
+        return ! b.empty();
+    });
+    LOG_INFO("pass barriers: %d for %d passes", (int)m_count, (int)num);
+}
+
+void BarrierPlan::clear() {
+    m_barriers.clear();
+    m_pending = {};
+    m_count   = 0;
+}
+
+void BarrierPlan::skip(usize pass) {
+    if (pass < m_barriers.size()) m_pending |= m_barriers[pass];
+}
+
+void BarrierPlan::record(usize pass, const vvk::CommandBuffer& cmd,
+                         std::span<const VkImageMemoryBarrier> images) {
+    Barrier b = m_pending;
+    m_pending = {};
+    if (pass < m_barriers.size()) b |= m_barriers[pass];
+    // the discards of aliased targets, after everything that used their memory
+    if (! images.empty())
+        b |= { pass_stages, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0 };
+    if (b.empty()) return;
+
+    VkMemoryBarrier memory {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext         = nullptr,
+        .srcAccessMask = b.src_access,
+        .dstAccessMask = b.dst_access,
+    };
+    bool with_memory = b.src_access != 0 || b.dst_access != 0;
+    cmd.PipelineBarrier(b.src_stage,
+                        b.dst_stage,
+                        0,
+                        with_memory ? vvk::Span<const VkMemoryBarrier>(memory) : nullptr,
+                        {},
+                        images);
+}
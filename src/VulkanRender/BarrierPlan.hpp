@@ -0,0 +1,62 @@
+#pragma once
+#include "Vulkan/Instance.hpp"
+#include "VulkanPass.hpp"
+#include "PassCache.hpp"
+#include "Core/Literals.hpp"
+#include "Core/MapSet.hpp"
+
+#include <span>
+#include <string>
+#include <vector>
+
+namespace vvk
+{
+class CommandBuffer;
+}
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+// The barriers between passes, worked out from what each pass reads and writes.
+// Targets are in shader read only layout between passes, render and copy passes move them out and
+// back themselves, so a pass boundary only needs a memory barrier, one for everything the pass
+// waits on. Imported textures are never written by a pass and never wait.
+// Targets sharing an image change hands at their first write in a frame, which waits on all use
+// before it.
+class BarrierPlan {
+public:
+    struct Barrier {
+        VkPipelineStageFlags src_stage { 0 };
+        VkPipelineStageFlags dst_stage { 0 };
+        VkAccessFlags        src_access { 0 };
+        VkAccessFlags        dst_access { 0 };
+
+        bool     empty() const { return src_stage == 0; }
+        Barrier& operator|=(const Barrier&);
+    };
+
+    // passes and io in execution order, the frame before ran the same passes
+    // shared are the targets that may get an image another one used
+    // joined are the passes drawing inside the render pass of the one before, a run of them waits
+    // once before its first
+    void build(std::span<VulkanPass* const>, std::span<const PassCache::PassIO>,
+               const Set<std::string>& shared, const std::vector<bool>& joined);
+    void clear();
+
+    // before a pass runs, with what skipped passes left and the pass's own image barriers
+    void record(usize pass, const vvk::CommandBuffer&, std::span<const VkImageMemoryBarrier>);
+    // the pass doesn't run this frame, what it waits on goes to the next one that does
+    void skip(usize pass);
+
+    usize count() const { return m_count; }
+
+private:
+    std::vector<Barrier> m_barriers;
+    Barrier              m_pending;
+    usize                m_count { 0 };
+};
+
+} // namespace vulkan
+} // namespace wallpaper
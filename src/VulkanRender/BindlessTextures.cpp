@@ -0,0 +1,108 @@
+#include "BindlessTextures.hpp"
+#include "Vulkan/Device.hpp"
+#include "SpecTexs.hpp"
+
+using namespace wallpaper::vulkan;
+
+DescriptorSetInfo BindlessTextures::Info() {
+    return DescriptorSetInfo {
+        .update_after_bind = true,
+        .bindings          = { VkDescriptorSetLayoutBinding {
+                     .binding            = 0,
+                     .descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                     .descriptorCount    = WE_BINDLESS_CAPACITY,
+                     .stageFlags         = VK_SHADER_STAGE_ALL_GRAPHICS,
+                     .pImmutableSamplers = nullptr,
+        } },
+    };
+}
+
+bool BindlessTextures::init(const Device& device, usize frame_num) {
+    m_device    = &device;
+    m_frame_num = frame_num;
+    if (! CreateDescriptorSetLayout(device, Info(), m_layout)) return false;
+
+    VkDescriptorPoolSize       size { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                WE_BINDLESS_CAPACITY };
+    VkDescriptorPoolCreateInfo ci {
+        .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext         = nullptr,
+        .flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+        .maxSets       = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes    = &size,
+    };
+    VVK_CHECK_BOOL_RE(device.handle().CreateDescriptorPool(ci, m_pool));
+    VkDescriptorSetLayout layout = *m_layout;
+    VVK_CHECK_BOOL_RE(m_pool.Allocate(layout, &m_set));
+    return true;
+}
+
+void BindlessTextures::destroy() {
+    clear();
+    m_set    = VK_NULL_HANDLE;
+    m_pool   = {};
+    m_layout = {};
+    m_device = nullptr;
+}
+
+std::optional<u32> BindlessTextures::acquire(VkImageView view, VkSampler sampler) {
+    const Key key { view, sampler };
+    if (auto it = m_by_key.find(key); it != m_by_key.end()) {
+        m_by_slot.at(it->second).users++;
+        return it->second;
+    }
+
+    u32 slot { 0 };
+    if (! m_free.empty()) {
+        slot = m_free.back();
+        m_free.pop_back();
+    } else if (m_next < WE_BINDLESS_CAPACITY) {
+        slot = m_next++;
+    } else {
+        return std::nullopt;
+    }
+    m_by_key[key]   = slot;
+    m_by_slot[slot] = Entry { .key = key, .users = 1 };
+
+    // no frame in flight reads the slot, others are written meanwhile
+    VkDescriptorImageInfo image { sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    VkWriteDescriptorSet  write {
+         .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .pNext           = nullptr,
+         .dstSet          = m_set,
+         .dstBinding      = 0,
+         .dstArrayElement = slot,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .pImageInfo      = &image,
+    };
+    m_device->handle().UpdateDescriptorSets(write);
+    return slot;
+}
+
+void BindlessTextures::release(u32 slot) {
+    auto it = m_by_slot.find(slot);
+    if (it == m_by_slot.end()) return;
+    if (--it->second.users > 0) return;
+    m_by_key.erase(it->second.key);
+    m_by_slot.erase(it);
+    m_retired.push_back({ slot, m_frame });
+}
+
+void BindlessTextures::beginFrame() {
+    m_frame++;
+    // the frame a round before this one is done, so is every frame before the release
+    while (! m_retired.empty() && m_retired.front().second + m_frame_num <= m_frame) {
+        m_free.push_back(m_retired.front().first);
+        m_retired.pop_front();
+    }
+}
+
+void BindlessTextures::clear() {
+    m_by_key.clear();
+    m_by_slot.clear();
+    m_retired.clear();
+    m_free.clear();
+    m_next = 0;
+}
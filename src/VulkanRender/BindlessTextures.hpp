@@ -0,0 +1,71 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/MapSet.hpp"
+#include "Core/NoCopyMove.hpp"
+#include "Vulkan/GraphicsPipeline.hpp"
+
+#include <deque>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+class Device;
+
+// The texture views of the passes in one sampler array, WE_BINDLESS_ARRAY, with descriptor
+// indexing. A shader translated for it samples a texture at the index in a uniform, a pass writes
+// that index to its block where it would write a descriptor, and the set is bound for all of them.
+// A view and sampler get one slot however many passes use it. Slots are written while frames are
+// in flight, one released is written again only once the frames that may read it are done.
+class BindlessTextures : NoCopy, NoMove {
+public:
+    bool init(const Device&, usize frame_num);
+    void destroy();
+
+    // what the pipelines of passes reading it declare at set 1
+    static DescriptorSetInfo Info();
+
+    VkDescriptorSet set() const { return m_set; }
+
+    // the slot of the view with the sampler, nullopt if the array is full
+    std::optional<u32> acquire(VkImageView, VkSampler);
+    // the last user of a slot gives it back
+    void release(u32 slot);
+    // a frame is drawn in the slot just waited on, slots released a round before are free again
+    void beginFrame();
+    // no frame is in flight, every slot is free
+    void clear();
+
+    // slots in use
+    usize used() const { return m_by_slot.size(); }
+
+private:
+    using Key = std::pair<VkImageView, VkSampler>;
+    struct Entry {
+        Key key;
+        u32 users { 0 };
+    };
+
+    const Device*            m_device { nullptr };
+    vvk::DescriptorSetLayout m_layout;
+    vvk::DescriptorPool      m_pool;
+    VkDescriptorSet          m_set { VK_NULL_HANDLE };
+
+    usize m_frame_num { 1 };
+    u64   m_frame { 0 };
+
+    Map<Key, u32>   m_by_key;
+    Map<u32, Entry> m_by_slot;
+    // slots never written are from here on
+    u32 m_next { 0 };
+    // released with the frame they were released in, oldest first, then free to write
+    std::deque<std::pair<u32, u64>> m_retired;
+    std::vector<u32>                m_free;
+};
+
+} // namespace vulkan
+} // namespace wallpaper
@@ -3,6 +3,7 @@
 #include "Utils/Logging.h"
 #include "Utils/AutoDeletor.hpp"
 #include "Resource.hpp"
+#include "MipCompute.hpp"
 #include "PassCommon.hpp"
 
 using namespace wallpaper::vulkan;
@@ -42,6 +43,8 @@ void CopyPass::prepare(Scene& scene, const Device& device, RenderingResources& r
         }
         *vk_textures[i] = img;
     }
+    m_desc.blit = scene.renderTargets.at(m_desc.src).format !=
+                  scene.renderTargets.at(m_desc.dst).format;
 
     for (auto& tex : releaseTexs()) {
         device.tex_cache().MarkShareReady(tex);
@@ -84,11 +87,13 @@ void CopyPass::execute(const Device& device, RenderingResources& rr) {
             },
         .extent = { src.extent.width, src.extent.height, 1 },
     };
+    // what was done to both before is waited on by the barrier before the pass, these only move
+    // the layouts and chain with it
     {
         VkImageMemoryBarrier in_bar {
             .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
             .pNext            = nullptr,
-            .srcAccessMask    = VK_ACCESS_MEMORY_READ_BIT,
+            .srcAccessMask    = {},
             .dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT,
             .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
             .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
@@ -98,7 +103,7 @@ void CopyPass::execute(const Device& device, RenderingResources& rr) {
         VkImageMemoryBarrier out_bar {
             .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
             .pNext            = nullptr,
-            .srcAccessMask    = VK_ACCESS_MEMORY_READ_BIT,
+            .srcAccessMask    = {},
             .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
             .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
             .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
@@ -106,18 +111,33 @@ void CopyPass::execute(const Device& device, RenderingResources& rr) {
             .subresourceRange = srang,
         };
 
-        cmd.PipelineBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
                             VK_PIPELINE_STAGE_TRANSFER_BIT,
                             VK_DEPENDENCY_BY_REGION_BIT,
                             {},
                             {},
                             std::array { in_bar, out_bar });
     }
-    cmd.CopyImage(src.handle,
-                  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                  dst.handle,
-                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                  copy);
+    if (m_desc.blit) {
+        VkImageBlit blit {
+            .srcSubresource = copy.srcSubresource,
+            .srcOffsets     = { {}, { (i32)src.extent.width, (i32)src.extent.height, 1 } },
+            .dstSubresource = copy.dstSubresource,
+            .dstOffsets     = { {}, { (i32)dst.extent.width, (i32)dst.extent.height, 1 } },
+        };
+        cmd.BlitImage(src.handle,
+                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                      dst.handle,
+                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                      blit,
+                      VK_FILTER_NEAREST);
+    } else {
+        cmd.CopyImage(src.handle,
+                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                      dst.handle,
+                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                      copy);
+    }
     {
         VkImageMemoryBarrier in_bar {
             .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -140,8 +160,11 @@ void CopyPass::execute(const Device& device, RenderingResources& rr) {
             .subresourceRange = srang,
         };
 
+        // the source is only read, readers after get no barrier and wait for its layout here
         cmd.PipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
-                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                VK_PIPELINE_STAGE_TRANSFER_BIT,
                             VK_DEPENDENCY_BY_REGION_BIT,
                             {},
                             {},
@@ -149,7 +172,8 @@ void CopyPass::execute(const Device& device, RenderingResources& rr) {
     }
 
     if (dst.mipmap_level > 1) {
-        device.tex_cache().RecGenerateMipmaps(cmd, dst);
+        if (rr.mip_compute == nullptr || ! rr.mip_compute->record(device, cmd, dst, rr.index))
+            device.tex_cache().RecGenerateMipmaps(cmd, dst);
     }
 };
 void CopyPass::destory(const Device&, RenderingResources&) {}
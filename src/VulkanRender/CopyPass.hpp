@@ -18,6 +18,8 @@ public:
 
         ImageParameters vk_src;
         ImageParameters vk_dst;
+        // formats differ, a fbo of fewer channels takes the first ones
+        bool blit { false };
     };
 
     CopyPass(const Desc&);
@@ -27,6 +29,11 @@ public:
     void execute(const Device&, RenderingResources&) override;
     void destory(const Device&, RenderingResources&) override;
 
+    Use  readUse() const override { return Use::Transfer; }
+    Use  writeUse() const override { return Use::Transfer; }
+    bool isCacheable() const override { return true; }
+    bool update() override { return false; }
+
 private:
     Desc m_desc;
 };
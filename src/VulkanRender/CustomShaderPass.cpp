@@ -7,20 +7,106 @@
 #include "Utils/Logging.h"
 #include "Utils/AutoDeletor.hpp"
 #include "Resource.hpp"
+#include "BindlessTextures.hpp"
+#include "VideoTextures.hpp"
+#include "StaticGeometry.hpp"
 #include "PassCommon.hpp"
 #include "Interface/IImageParser.h"
 
 #include "Core/ArrayHelper.hpp"
+#include "Looper/JobSystem.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
 
 using namespace wallpaper::vulkan;
 
+// the node's own uniform block or the shared globals one, null if the shader has none
+// from what the shader cache kept if it has it
+static bool Reflect(const SceneShader& shader, std::vector<Uni_ShaderSpv>& spvs,
+                    ShaderReflected& ref) {
+    if (! shader.reflection.empty() && UnpackReflect(shader.reflection, shader.codes, spvs, ref))
+        return true;
+    ref = {};
+    return GenReflect(shader.codes, spvs, ref);
+}
+
+static const ShaderReflected::Block* FindBlock(const ShaderReflected& ref, bool shared) {
+    for (auto& block : ref.blocks) {
+        if ((block.name == wallpaper::WE_GLOBAL_BLOCK) == shared) return &block;
+    }
+    return nullptr;
+}
+
+static bool UsesUniforms(const ShaderReflected&                  ref,
+                         std::initializer_list<std::string_view> names) {
+    return std::any_of(ref.blocks.begin(), ref.blocks.end(), [names](auto& block) {
+        return std::any_of(names.begin(), names.end(), [&block](std::string_view name) {
+            return exists(block.member_map, name);
+        });
+    });
+}
+
+// the mouse and the audio, a layer following them keeps the full rate
+static bool UsesLiveUniforms(const ShaderReflected& ref) {
+    using namespace wallpaper;
+    return UsesUniforms(ref,
+                        { G_POINTERPOSITION,
+                          G_AUDIOSPECTRUM16LEFT,
+                          G_AUDIOSPECTRUM16RIGHT,
+                          G_AUDIOSPECTRUM32LEFT,
+                          G_AUDIOSPECTRUM32RIGHT,
+                          G_AUDIOSPECTRUM64LEFT,
+                          G_AUDIOSPECTRUM64RIGHT });
+}
+
+static bool UsesTimeUniforms(const ShaderReflected& ref) {
+    using namespace wallpaper;
+    return UsesUniforms(ref, { G_TIME, G_DAYTIME }) || UsesLiveUniforms(ref);
+}
+
+// packed attributes are read as floats of any width, the rest as the shader declares them
+static VkFormat PackedFormat(wallpaper::VertexType type, VkFormat declared) {
+    using wallpaper::VertexType;
+    switch (type) {
+    case VertexType::HALF4: return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case VertexType::UNORM8X4: return VK_FORMAT_R8G8B8A8_UNORM;
+    case VertexType::SNORM16X2: return VK_FORMAT_R16G16_SNORM;
+    case VertexType::SNORM16X4: return VK_FORMAT_R16G16B16A16_SNORM;
+    default: return declared;
+    }
+}
+
 CustomShaderPass::CustomShaderPass(const Desc& desc) {
     m_desc.node        = desc.node;
     m_desc.textures    = desc.textures;
     m_desc.output      = desc.output;
     m_desc.sprites_map = desc.sprites_map;
+    m_desc.update_rate = desc.update_rate;
+    m_desc.time_rate   = desc.time_rate;
+
+    // cacheability is needed before prepare, to keep cached targets out of image sharing
+    if (auto* mesh = m_desc.node->Mesh(); mesh != nullptr && mesh->Material() != nullptr) {
+        m_desc.dyn_vertex = mesh->Dynamic();
+
+        std::vector<Uni_ShaderSpv> spvs;
+        ShaderReflected            ref;
+        if (Reflect(*mesh->Material()->customShader.shader, spvs, ref)) {
+            m_uses_time_uniforms = UsesTimeUniforms(ref);
+            m_uses_live_uniforms = UsesLiveUniforms(ref);
+        }
+        u32 rate = m_desc.update_rate.value_or(
+            m_uses_time_uniforms && ! m_uses_live_uniforms ? m_desc.time_rate : 0u);
+        if (rate > 0 && isStatic())
+            m_tick = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(1.0 / rate));
+    }
 };
 CustomShaderPass::~CustomShaderPass() {}
 
@@ -53,13 +139,26 @@ std::optional<vvk::RenderPass> CreateRenderPass(const vvk::Device& device, VkFor
         .pColorAttachments    = &attachment_ref,
     };
 
-    VkSubpassDependency dependency {
-        .srcSubpass    = VK_SUBPASS_EXTERNAL,
-        .dstSubpass    = 0,
-        .srcStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-        .dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .srcAccessMask = {},
-        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+    // the layout transitions chain with the barriers between passes, which carry the memory
+    std::array dependencies {
+        VkSubpassDependency {
+            .srcSubpass    = VK_SUBPASS_EXTERNAL,
+            .dstSubpass    = 0,
+            .srcStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .srcAccessMask = {},
+            .dstAccessMask =
+                VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        },
+        VkSubpassDependency {
+            .srcSubpass    = 0,
+            .dstSubpass    = VK_SUBPASS_EXTERNAL,
+            .srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = {},
+        },
     };
 
     VkRenderPassCreateInfo creatinfo {
@@ -68,8 +167,8 @@ std::optional<vvk::RenderPass> CreateRenderPass(const vvk::Device& device, VkFor
         .pAttachments    = &attachment,
         .subpassCount    = 1,
         .pSubpasses      = &subpass,
-        .dependencyCount = 1,
-        .pDependencies   = &dependency,
+        .dependencyCount = (uint32_t)dependencies.size(),
+        .pDependencies   = dependencies.data(),
     };
     vvk::RenderPass pass;
     if (auto res = device.CreateRenderPass(creatinfo, pass); res == VK_SUCCESS) {
@@ -80,50 +179,45 @@ std::optional<vvk::RenderPass> CreateRenderPass(const vvk::Device& device, VkFor
     }
 }
 
-static void UpdateUniform(StagingBuffer* buf, const StagingBufferRef& bufref,
-                          const ShaderReflected::Block& block, std::string_view name,
+static VkImageSubresourceRange OutputRange() {
+    return VkImageSubresourceRange {
+        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel   = 0,
+        .levelCount     = 1,
+        .baseArrayLayer = 0,
+        .layerCount     = 1,
+    };
+}
+
+static void UpdateUniform(std::span<uint8_t> ubo, size_t offset, std::span<const float> value) {
+    std::span<const uint8_t> value_u8 { (const uint8_t*)value.data(), value.size_bytes() };
+    if (offset >= ubo.size()) return;
+    usize size = std::min(ubo.size() - offset, value_u8.size());
+    std::copy(value_u8.begin(), value_u8.begin() + size, ubo.begin() + offset);
+}
+
+static void UpdateUniform(std::span<uint8_t> ubo, size_t offset, size_t num,
                           const wallpaper::ShaderValue& value) {
-    using namespace wallpaper;
-    std::span<uint8_t> value_u8 { (uint8_t*)value.data(),
-                                  value.size() * sizeof(ShaderValue::value_type) };
-    auto               uni = block.member_map.find(name);
+    size_t type_size = sizeof(float) * num;
+    if (type_size != value.size() * sizeof(float)) {
+        // assert(type_size == value_u8.size());
+        ; // to do
+    }
+    UpdateUniform(ubo, offset, std::span { value.data(), value.size() });
+}
+
+static void UpdateUniform(std::span<uint8_t> ubo, const ShaderReflected::Block& block,
+                          std::string_view name, const wallpaper::ShaderValue& value) {
+    auto uni = block.member_map.find(name);
     if (uni == block.member_map.end()) {
         // log
         return;
     }
-
-    size_t offset    = uni->second.offset;
-    size_t type_size = sizeof(float) * uni->second.num;
-    if (type_size != value_u8.size()) {
-        // assert(type_size == value_u8.size());
-        ; // to do
-    }
-    buf->writeToBuf(bufref, value_u8, offset);
+    UpdateUniform(ubo, uni->second.offset, uni->second.num, value);
 }
 
 void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingResources& rr) {
     m_desc.vk_textures.resize(m_desc.textures.size());
-    for (usize i = 0; i < m_desc.textures.size(); i++) {
-        auto& tex_name = m_desc.textures[i];
-        if (tex_name.empty()) continue;
-
-        ImageSlotsRef img_slots;
-        if (IsSpecTex(tex_name)) {
-            if (scene.renderTargets.count(tex_name) == 0) continue;
-            auto& rt  = scene.renderTargets.at(tex_name);
-            auto  opt = device.tex_cache().Query(tex_name, ToTexKey(rt), ! rt.allowReuse);
-            if (! opt.has_value()) continue;
-            img_slots.slots = { opt.value() };
-        } else {
-            auto image = scene.imageParser->Parse(tex_name);
-            if (image) {
-                img_slots = device.tex_cache().CreateTex(*image);
-            } else {
-                LOG_ERROR("parse tex \"%s\" failed", tex_name.c_str());
-            }
-        }
-        m_desc.vk_textures[i] = img_slots;
-    }
     {
         auto& tex_name = m_desc.output;
         assert(IsSpecTex(tex_name));
@@ -131,7 +225,8 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
         auto& rt = scene.renderTargets.at(tex_name);
         if (auto opt = device.tex_cache().Query(tex_name, ToTexKey(rt), ! rt.allowReuse);
             opt.has_value()) {
-            m_desc.vk_output = opt.value();
+            m_desc.vk_output        = opt.value();
+            m_desc.vk_output_format = ToVkType(rt.format);
         } else
             return;
     }
@@ -141,24 +236,25 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
     std::vector<Uni_ShaderSpv> spvs;
     DescriptorSetInfo          descriptor_info;
     ShaderReflected            ref;
+    bool                       bindless { false };
     {
         SceneShader& shader = *(mesh.Material()->customShader.shader);
 
-        if (! GenReflect(shader.codes, spvs, ref)) {
+        if (! Reflect(shader, spvs, ref)) {
             LOG_ERROR("gen spv reflect failed, %s", shader.name.c_str());
             return;
         }
 
-        // Check if shader uses time-based uniforms (for caching optimization)
-        if (!ref.blocks.empty()) {
-            auto& block = ref.blocks.front();
-            m_uses_time_uniforms = exists(block.member_map, G_TIME) ||
-                                   exists(block.member_map, G_DAYTIME) ||
-                                   exists(block.member_map, G_POINTERPOSITION);
+        m_uses_time_uniforms = UsesTimeUniforms(ref);
+        m_uses_live_uniforms = UsesLiveUniforms(ref);
+
+        bindless = exists(ref.binding_map, WE_BINDLESS_ARRAY);
+        if (bindless && rr.bindless == nullptr) {
+            LOG_ERROR("no texture array for %s", shader.name.c_str());
+            return;
         }
 
         auto& bindings = descriptor_info.bindings;
-        bindings.resize(ref.binding_map.size());
 
         /*
         LOG_INFO("----shader------");
@@ -170,11 +266,12 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
         LOG_INFO("--bindings:");
         */
 
-        std::transform(
-            ref.binding_map.begin(), ref.binding_map.end(), bindings.begin(), [](auto& item) {
-                // LOG_INFO("%d %s", item.second.binding, item.first.c_str());
-                return item.second;
-            });
+        for (auto& [name, binding] : ref.binding_map) {
+            // LOG_INFO("%d %s", binding.binding, name.c_str());
+            // set 1, laid out the same for every pass
+            if (name == WE_BINDLESS_ARRAY) continue;
+            bindings.push_back(binding);
+        }
 
         for (usize i = 0; i < m_desc.vk_textures.size(); i++) {
             i32 binding { -1 };
@@ -184,6 +281,56 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
         }
     }
 
+    const auto* node_block = FindBlock(ref, false);
+    m_tex_layers.clear();
+    m_videos.clear();
+    for (usize i = 0; i < m_desc.textures.size(); i++) {
+        auto& tex_name = m_desc.textures[i];
+        if (tex_name.empty()) continue;
+
+        ImageSlotsRef img_slots;
+        if (IsSpecTex(tex_name)) {
+            if (scene.renderTargets.count(tex_name) == 0) continue;
+            auto& rt  = scene.renderTargets.at(tex_name);
+            auto  opt = device.tex_cache().Query(tex_name, ToTexKey(rt), ! rt.allowReuse);
+            if (! opt.has_value()) continue;
+            img_slots.slots = { opt.value() };
+        } else {
+            // the shader samples the sprite frames as layers at the uniform
+            const ShaderReflected::BlockedUniform* layer { nullptr };
+            if (node_block != nullptr && i < WE_GLTEX_LAYER_NAMES.size()) {
+                auto it = node_block->member_map.find(WE_GLTEX_LAYER_NAMES[i]);
+                if (it != node_block->member_map.end()) layer = &it->second;
+            }
+            // a texture another pass uploaded isn't decoded again, the pixels were dropped
+            // after its upload and a pass made later decodes them from the pkg
+            std::string key = tex_name;
+            if (layer != nullptr) key.append(TextureCache::LayeredKeySuffix);
+            std::shared_ptr<Image> image;
+            const ImageSlots*      made = device.tex_cache().Find(key);
+            if (made == nullptr) image = scene.imageParser->Parse(tex_name);
+            // the clip's frames are drawn to an image of its own, the slot is left unused
+            std::optional<ImageSlotsRef> video;
+            usize                        clip { 0 };
+            if (image && image->video && rr.video != nullptr)
+                video = rr.video->add(device, *image, clip);
+            if (video.has_value()) {
+                img_slots = std::move(video.value());
+                m_video   = rr.video;
+                m_videos.push_back({ clip, m_video->serial(clip) });
+            } else if (made != nullptr || image) {
+                img_slots = made != nullptr ? ImageSlotsRef(*made)
+                                            : device.tex_cache().CreateTex(image, layer != nullptr);
+                m_tex_cache      = &device.tex_cache();
+                m_tex_generation = m_tex_cache->StreamGeneration();
+                if (layer != nullptr) m_tex_layers.push_back({ i, layer->offset });
+            } else {
+                LOG_ERROR("parse tex \"%s\" failed", tex_name.c_str());
+            }
+        }
+        m_desc.vk_textures[i] = img_slots;
+    }
+
     m_desc.draw_count = 0;
     std::vector<VkVertexInputBindingDescription>   bind_descriptions;
     std::vector<VkVertexInputAttributeDescription> attr_descriptions;
@@ -192,25 +339,26 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
         m_desc.vertex_bufs.resize(mesh.VertexCount());
 
         for (uint i = 0; i < mesh.VertexCount(); i++) {
-            const auto& vertex    = mesh.GetVertexArray(i);
-            auto        attrs_map = vertex.GetAttrOffsetMap();
+            const auto& vertex = mesh.GetVertexArray(i);
 
             VkVertexInputBindingDescription bind_desc {
                 .binding   = i,
                 .stride    = (uint32_t)vertex.OneSizeOf(),
-                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+                .inputRate = vertex.PerInstance() ? VK_VERTEX_INPUT_RATE_INSTANCE
+                                                  : VK_VERTEX_INPUT_RATE_VERTEX,
             };
             bind_descriptions.push_back(bind_desc);
 
             for (auto& item : ref.input_location_map) {
                 auto& name   = item.first;
                 auto& input  = item.second;
-                usize offset = exists(attrs_map, name) ? attrs_map[name].offset : 0;
+                auto  attr   = vertex.FindAttr(name);
+                usize offset = attr.offset * sizeof(float);
 
                 VkVertexInputAttributeDescription attr_desc {
                     .location = input.location,
                     .binding  = i,
-                    .format   = input.format,
+                    .format   = attr.valid() ? PackedFormat(attr.type, input.format) : input.format,
                     .offset   = (u32)offset,
                 };
                 attr_descriptions.push_back(attr_desc);
@@ -218,28 +366,38 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
             {
                 auto& buf = m_desc.vertex_bufs[i];
                 if (! m_desc.dyn_vertex) {
-                    if (! rr.vertex_buf->allocateSubRef(vertex.CapacitySizeOf(), buf)) return;
-                    if (! rr.vertex_buf->writeToBuf(buf, { (uint8_t*)vertex.Data(), buf.size }))
-                        return;
+                    std::span<const uint8_t> data { (const uint8_t*)vertex.Data(),
+                                                    vertex.CapacitySizeOf() };
+                    if (! rr.static_geometry->acquire(data, buf)) return;
                 } else {
                     if (! rr.dyn_buf->allocateSubRef(vertex.CapacitySizeOf(), buf)) return;
                 }
             }
             m_desc.draw_count += (u32)(vertex.DataSize() / vertex.OneSize());
         }
+        m_desc.instance_count = 1;
+        if (mesh.InstanceVertexCount() > 0) {
+            m_desc.draw_count     = mesh.InstanceVertexCount();
+            m_desc.instance_count = mesh.InstanceCount();
+        }
 
         if (mesh.IndexCount() > 0) {
-            auto&  indice     = mesh.GetIndexArray(0);
-            size_t count      = (indice.DataCount() * 2) / 3;
-            m_desc.draw_count = (u32)count * 3;
+            auto& indice      = mesh.GetIndexArray(0);
+            m_desc.draw_count = (u32)(indice.IndexCount() / 3) * 3;
+            m_desc.index_type = indice.Wide() ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
             auto& buf         = m_desc.index_buf;
             if (! m_desc.dyn_vertex) {
-                if (! rr.vertex_buf->allocateSubRef(indice.CapacitySizeof(), buf)) return;
-                if (! rr.vertex_buf->writeToBuf(buf, { (uint8_t*)indice.Data(), buf.size })) return;
+                std::span<const uint8_t> data { (const uint8_t*)indice.Data(),
+                                                indice.CapacitySizeof() };
+                if (! rr.static_geometry->acquire(data, buf)) return;
             } else {
                 if (! rr.dyn_buf->allocateSubRef(indice.CapacitySizeof(), buf)) return;
             }
         }
+        if (mesh.ParticleSim() != nullptr && rr.particle_compute != nullptr) {
+            auto sim = std::make_unique<ParticleCompute::Sim>();
+            if (rr.particle_compute->createSim(device, mesh, *sim)) m_particle = std::move(sim);
+        }
     }
     {
         VkPipelineColorBlendAttachmentState color_blend;
@@ -258,130 +416,237 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
             m_desc.blending = color_blend.blendEnable;
 
             SetAttachmentLoadOp(blendmode, loadOp);
+            m_desc.load_op = loadOp;
+        }
+        vvk::RenderPass pass;
+        if (! device.dynamic_rendering()) {
+            auto opt = CreateRenderPass(device.handle(),
+                                        m_desc.vk_output_format,
+                                        loadOp,
+                                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            if (! opt.has_value()) return;
+            pass = std::move(opt.value());
         }
-        auto opt = CreateRenderPass(device.handle(),
-                                    VK_FORMAT_R8G8B8A8_UNORM,
-                                    loadOp,
-                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        if (! opt.has_value()) return;
-        auto& pass = opt.value();
 
-        descriptor_info.push_descriptor = true;
-        GraphicsPipeline pipeline;
+        // the uniform block moves with the frame's ring region, the set itself stays bound
+        for (auto& b : descriptor_info.bindings) {
+            if (b.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+                b.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            else if (b.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        }
+        std::array set_infos { descriptor_info, BindlessTextures::Info() };
+        auto       builder  = std::make_shared<GraphicsPipeline>();
+        auto&      pipeline = *builder;
         pipeline.toDefault();
-        pipeline.addDescriptorSetInfo(spanone { descriptor_info })
+        pipeline.addDescriptorSetInfo(std::span(set_infos.data(), bindless ? 2u : 1u))
             .setColorBlendStates(spanone { color_blend })
             .setTopology(m_desc.index_buf ? VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST
                                           : VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP)
             .addInputBindingDescription(bind_descriptions)
-            .addInputAttributeDescription(attr_descriptions);
+            .addInputAttributeDescription(attr_descriptions)
+            .setSpecialization(mesh.Material()->customShader.shader->spec_constants)
+            .setColorFormat(m_desc.vk_output_format);
         for (auto& spv : spvs) pipeline.addStage(std::move(spv));
 
-        if (! pipeline.create(device, pass, m_desc.pipeline)) return;
+        bool made { false };
+        auto entry = pipeline.share(device, (bool)pass, made);
+        if (made) {
+            if (! pipeline.createLayouts(device, entry->params)) {
+                entry->finish(false);
+                return;
+            }
+            // the render pass lives as long as this pass, the renderer waits for the jobs
+            // before destroying passes
+            auto build = [builder, entry, &device, vk_pass = *pass]() {
+                entry->finish(builder->createPipeline(device, vk_pass, entry->params));
+            };
+            if (rr.pipeline_jobs != nullptr)
+                looper::JobSystem::Shared().run(*rr.pipeline_jobs, build);
+            else
+                build();
+        }
+        if (entry->failed()) return;
+        m_desc.pipeline = std::shared_ptr<const PipelineParameters>(entry, &entry->params);
+        m_desc.pass     = std::move(pass);
+        if (! entry->ready()) m_pipeline_pending = std::move(entry);
     }
 
-    {
-        VkFramebufferCreateInfo info {
-            .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-            .pNext           = nullptr,
-            .renderPass      = *m_desc.pipeline.pass,
-            .attachmentCount = 1,
-            .pAttachments    = &m_desc.vk_output.view,
-            .width           = m_desc.vk_output.extent.width,
-            .height          = m_desc.vk_output.extent.height,
-            .layers          = 1,
-        };
-        VVK_CHECK_VOID_RE(device.handle().CreateFramebuffer(info, m_desc.fb));
+    if (! createFramebuffer(device)) return;
+
+    if (node_block != nullptr) {
+        auto& block = *node_block;
+        if (! rr.ubo_ring->allocateSubRef(block.size, m_desc.ubo_buf)) return;
+        m_ubo_data.assign(block.size, 0);
+        m_block_members.clear();
+        for (auto& [name, uni] : block.member_map)
+            m_block_members[name] = { .offset = uni.offset, .num = uni.num };
+        if (exists(ref.binding_map, block.name))
+            m_ubo_binding = ref.binding_map.at(block.name).binding;
     }
+    m_ubo_last.clear();
 
-    if (! ref.blocks.empty()) {
-        auto& block = ref.blocks.front();
-        rr.dyn_buf->allocateSubRef(
-            block.size, m_desc.ubo_buf, device.limits().minUniformBufferOffsetAlignment);
+    m_shared = nullptr;
+    m_shared_ranges.clear();
+    m_shared_last.clear();
+    if (const auto* block = FindBlock(ref, true); block != nullptr) {
+        auto* shared = rr.shared_uniforms;
+        if (shared == nullptr || shared->ref.size < block->size) {
+            LOG_ERROR("no shared uniforms for %s", m_desc.node->Mesh()->Material()->name.c_str());
+            return;
+        }
+        m_shared         = shared;
+        m_shared_binding = ref.binding_map.at(block->name).binding;
+        for (auto& [name, uni] : block->member_map)
+            m_shared_ranges.push_back({ uni.offset, (u32)uni.size });
     }
 
-    if (! ref.blocks.empty()) {
+    m_palettes = nullptr;
+    if (auto bones = ref.buffer_sizes.find(WE_BONE_BLOCK); bones != ref.buffer_sizes.end()) {
+        auto* palettes = rr.bone_palettes;
+        if (palettes == nullptr || ! palettes->ring->allocateSubRef(bones->second, m_bones_ref)) {
+            LOG_ERROR("no bone palette for %s", m_desc.node->Mesh()->Material()->name.c_str());
+            return;
+        }
+        m_palettes      = palettes;
+        m_bones_binding = ref.binding_map.at(bones->first).binding;
+        m_bones_bound   = m_bones_ref;
+    }
+
+    m_bindless_texs.clear();
+    m_bindless = bindless ? rr.bindless : nullptr;
+    if (bindless && node_block != nullptr) {
+        for (usize i = 0; i < m_desc.vk_textures.size() && i < WE_GLTEX_INDEX_NAMES.size(); i++) {
+            auto it = node_block->member_map.find(WE_GLTEX_INDEX_NAMES[i]);
+            if (it == node_block->member_map.end()) continue;
+            m_bindless_texs.push_back({ .tex = i, .offset = it->second.offset });
+        }
+        if (! acquireBindless()) return;
+    }
+    if (! createDescriptorSets(device, rr, descriptor_info.bindings)) return;
+
+    if (! ref.blocks.empty() || m_palettes != nullptr) {
         std::function<void()> update_dyn_buf_op;
         if (m_desc.dyn_vertex) {
             auto& mesh        = *m_desc.node->Mesh();
             auto* dyn_buf     = rr.dyn_buf;
-            auto& vertex_bufs = m_desc.vertex_bufs;
-            auto& draw_count  = m_desc.draw_count;
-            auto& index_buf   = m_desc.index_buf;
-            update_dyn_buf_op = [&mesh, &vertex_bufs, &draw_count, &index_buf, dyn_buf]() {
-                if (mesh.Dirty().exchange(false)) {
-                    for (usize i = 0; i < mesh.VertexCount(); i++) {
-                        const auto& vertex = mesh.GetVertexArray(i);
-                        auto&       buf    = vertex_bufs[i];
-                        if (! dyn_buf->writeToBuf(buf,
-                                                  { (uint8_t*)vertex.Data(), vertex.DataSizeOf() }))
-                            return;
-                    }
-                    if (mesh.IndexCount() > 0) {
-                        auto& indice = mesh.GetIndexArray(0);
-                        u32   count  = (u32)((indice.RenderDataCount() * 2) / 3);
-                        draw_count   = count * 3;
-                        auto& buf = index_buf;
-                        if (! dyn_buf->writeToBuf(buf,
-                                                  { (uint8_t*)indice.Data(), indice.DataSizeOf() }))
-                            return;
-                    }
+            auto& desc        = m_desc;
+            update_dyn_buf_op = [&mesh, &desc, dyn_buf]() {
+                // where the frame's buffer is host visible the mesh goes straight into it, with
+                // no host copy in between. The mesh is only stable until the next simulation
+                // starts, so each frame's buffer is caught up while it's updated
+                const bool direct = dyn_buf->direct();
+                const bool dirty  = mesh.Dirty().exchange(false);
+                if (dirty) desc.dyn_serial++;
+                if (direct && desc.dyn_generation != dyn_buf->generation()) {
+                    desc.dyn_generation = dyn_buf->generation();
+                    desc.dyn_written.assign(dyn_buf->frameNum(), 0);
+                }
+                u64* written = direct ? &desc.dyn_written.at(dyn_buf->frame()) : nullptr;
+                if (direct ? *written == desc.dyn_serial : ! dirty) return;
+
+                auto write = [dyn_buf, direct](const StagingBufferRef& buf, const void* data,
+                                               usize size) {
+                    std::span<const uint8_t> bytes { (const uint8_t*)data, size };
+                    if (direct) return dyn_buf->writeToFrame(buf, bytes);
+                    return dyn_buf->writeToBuf(buf, { (uint8_t*)data, size });
+                };
+                if (mesh.InstanceVertexCount() > 0) desc.instance_count = mesh.InstanceCount();
+                for (usize i = 0; i < mesh.VertexCount(); i++) {
+                    const auto& vertex = mesh.GetVertexArray(i);
+                    auto&       buf    = desc.vertex_bufs[i];
+                    // only the live instances, the rest of the array is stale
+                    usize size = vertex.DataSizeOf();
+                    if (vertex.PerInstance())
+                        size = std::min(size, desc.instance_count * vertex.OneSizeOf());
+                    if (size == 0) continue;
+                    if (! write(buf, vertex.Data(), size)) return;
+                }
+                if (mesh.IndexCount() > 0) {
+                    auto& indice    = mesh.GetIndexArray(0);
+                    desc.draw_count = (u32)(indice.RenderIndexCount() / 3) * 3;
+                    if (! write(desc.index_buf, indice.Data(), indice.DataSizeOf())) return;
                 }
+                if (written != nullptr) *written = desc.dyn_serial;
             };
         }
 
-        auto  block  = ref.blocks.front();
-        auto* buf    = rr.dyn_buf;
-        auto* bufref = &m_desc.ubo_buf;
+        auto* block = node_block;
+        auto* slots = &m_uniform_slots;
 
         auto* node           = m_desc.node;
         auto* shader_updater = scene.shaderValueUpdater.get();
         auto& sprites        = m_desc.sprites_map;
         auto& vk_textures    = m_desc.vk_textures;
 
-        m_desc.update_op = [shader_updater,
-                            block,
-                            buf,
-                            bufref,
+        m_desc.update_op = [this,
+                            shader_updater,
                             node,
                             &sprites,
-                            &vk_textures,
-                            update_dyn_buf_op]() {
-            auto update_unf_op = [&block, buf, bufref](std::string_view       name,
-                                                       wallpaper::ShaderValue value) {
-                UpdateUniform(buf, *bufref, block, name, value);
+                            &vk_textures]() {
+            // a pointer each, small enough to keep std::function off the heap every frame
+            auto update_unf_op = [this](UniformSlot slot, wallpaper::ShaderValue value) {
+                if (slot < 0 || (usize)slot >= m_uniform_slots.size()) return;
+                const auto& uni = m_uniform_slots[(usize)slot];
+                UpdateUniform(m_ubo_data, uni.offset, uni.num, value);
             };
-            shader_updater->UpdateUniforms(node, sprites, update_unf_op);
-            // update image slot for sprites
+            auto update_span_op = [this](UniformSlot slot, std::span<const float> value) {
+                if (slot < 0 || (usize)slot >= m_uniform_slots.size()) return;
+                const auto& uni = m_uniform_slots[(usize)slot];
+                if (uni.palette)
+                    m_palette_pending = value;
+                else
+                    UpdateUniform(m_ubo_data, uni.offset, value);
+            };
+            shader_updater->UpdateUniforms(node, sprites, update_unf_op, update_span_op);
+            // update image slot for sprites, or the layer of ones packed into one image
             {
                 for (auto& [i, sp] : sprites) {
                     if (i >= vk_textures.size()) continue;
+                    auto layer = std::find_if(m_tex_layers.begin(),
+                                              m_tex_layers.end(),
+                                              [i](auto& l) { return l.first == i; });
+                    if (layer != m_tex_layers.end()) {
+                        float frame = (float)sp.GetCurFrame().imageId;
+                        UpdateUniform(m_ubo_data, layer->second, std::array { frame });
+                        continue;
+                    }
                     vk_textures.at(i).active = sp.GetCurFrame().imageId;
                 }
             }
-            if (update_dyn_buf_op) update_dyn_buf_op();
+            writeTexIndices();
         };
+        m_desc.upload_op = std::move(update_dyn_buf_op);
 
-        auto exists_unf_op = [&block](std::string_view name) {
-            return exists(block.member_map, name);
+        // names resolve once here, the per frame updates index the table
+        m_uniform_slots.clear();
+        auto resolve_unf_op = [block, slots, bones = m_palettes != nullptr](std::string_view name) {
+            if (bones && name == wallpaper::G_BONES) {
+                slots->push_back({ .palette = true });
+                return (UniformSlot)(slots->size() - 1);
+            }
+            if (block == nullptr) return NoUniformSlot;
+            auto uni = block->member_map.find(name);
+            if (uni == block->member_map.end()) return NoUniformSlot;
+            slots->push_back({ .offset = uni->second.offset, .num = uni->second.num });
+            return (UniformSlot)(slots->size() - 1);
         };
-        shader_updater->InitUniforms(node, exists_unf_op);
+        shader_updater->InitUniforms(node, resolve_unf_op);
 
-        // memset uniform buf
-        buf->fillBuf(*bufref, 0, bufref->size, 0);
         {
             auto&      default_values = mesh.Material()->customShader.shader->default_uniforms;
             auto&      const_values   = mesh.Material()->customShader.constValues;
             std::array values_array   = { &default_values, &const_values };
             for (auto& values : values_array) {
                 for (auto& v : *values) {
-                    if (exists(block.member_map, v.first)) {
-                        UpdateUniform(buf, *bufref, block, v.first, v.second);
+                    if (block != nullptr && exists(block->member_map, v.first)) {
+                        UpdateUniform(m_ubo_data, *block, v.first, v.second);
                     }
                 }
             }
         }
         m_desc.update_op();
+        uploadValues();
     }
 
     {
@@ -393,103 +658,622 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
     for (auto& tex : releaseTexs()) {
         device.tex_cache().MarkShareReady(tex);
     }
+
+    // vertices move by the mvp alone, the bones may be in the block too
+    m_mvp_offset.reset();
+    {
+        SceneVertexArray::AttrHandle pos;
+        if (mesh.VertexCount() > 0) pos = mesh.GetVertexArray(0).FindAttr(WE_IN_POSITION);
+        auto mvp   = m_block_members.find(std::string(G_MVP));
+        bool moved = m_particle || m_palettes != nullptr || m_desc.dyn_vertex ||
+                     exists(m_block_members, std::string(G_BONES));
+        if (! moved && mvp != m_block_members.end() && pos.valid()) {
+            m_mvp_offset      = mvp->second.offset;
+            m_position_offset = pos.offset;
+        }
+    }
+    m_culled = false;
+    if (m_mvp_offset) {
+        auto&           vertexs = mesh.GetVertexArray(0);
+        const usize     stride  = vertexs.OneSize();
+        constexpr float inf     = std::numeric_limits<float>::infinity();
+        m_box                   = { { { inf, inf, inf }, { -inf, -inf, -inf } } };
+        for (usize v = 0; v < vertexs.VertexCount(); v++) {
+            const float* p = vertexs.Data() + v * stride + m_position_offset;
+            for (usize i = 0; i < 3; i++) {
+                m_box[0][i] = std::min(m_box[0][i], p[i]);
+                m_box[1][i] = std::max(m_box[1][i], p[i]);
+            }
+        }
+        if (vertexs.VertexCount() == 0) m_mvp_offset.reset();
+    }
+    // a pass made again draws with the next update
+    m_next_tick = {};
     setPrepared();
 }
 
-void CustomShaderPass::execute(const Device&, RenderingResources& rr) {
-    // NOTE: Pass caching disabled - output textures are not preserved between frames
-    // in current render graph implementation. Would need persistent render targets.
-    // if (isCacheable() && m_cached) { return; }
+void CustomShaderPass::reloadConstants() {
+    if (! prepared() || m_desc.node == nullptr) return;
+    for (auto& [name, value] : m_desc.node->Mesh()->Material()->customShader.constValues) {
+        auto uni = m_block_members.find(name);
+        if (uni == m_block_members.end()) continue;
+        UpdateUniform(m_ubo_data, uni->second.offset, uni->second.num, value);
+    }
+}
+
+bool CustomShaderPass::acquireBindless() {
+    for (auto& tex : m_bindless_texs) {
+        // a view it already has keeps its slot
+        std::vector<u32> slots;
+        for (auto& img : m_desc.vk_textures[tex.tex].slots) {
+            auto slot = m_bindless->acquire(img.view, img.sampler);
+            if (! slot) {
+                LOG_ERROR("texture array full at %zu textures", m_bindless->used());
+                for (u32 s : slots) m_bindless->release(s);
+                return false;
+            }
+            slots.push_back(*slot);
+        }
+        for (u32 s : tex.slots) m_bindless->release(s);
+        tex.slots = std::move(slots);
+    }
+    writeTexIndices();
+    return true;
+}
+
+void CustomShaderPass::writeTexIndices() {
+    for (auto& tex : m_bindless_texs) {
+        if (tex.slots.empty() || tex.offset + sizeof(u32) > m_ubo_data.size()) continue;
+        // as getActive picks
+        idx active = m_desc.vk_textures[tex.tex].active;
+        u32 slot   = tex.slots[active > 0 && active < std::ssize(tex.slots) ? (usize)active : 0];
+        std::memcpy(m_ubo_data.data() + tex.offset, &slot, sizeof(slot));
+    }
+}
+
+bool CustomShaderPass::refreshStreamedTextures() {
+    bool changed = false;
+    for (usize i = 0; i < m_desc.vk_textures.size(); i++) {
+        auto& tex_name = m_desc.textures[i];
+        if (tex_name.empty() || IsSpecTex(tex_name)) continue;
+        const ImageSlots* slots = m_tex_cache->Find(tex_name);
+        if (slots == nullptr) continue;
+
+        auto& vk_tex = m_desc.vk_textures[i];
+        if (vk_tex.slots.size() != slots->slots.size()) continue;
+        bool same = true;
+        for (usize s = 0; s < vk_tex.slots.size(); s++) {
+            if (vk_tex.slots[s].view != *slots->slots[s].view) same = false;
+        }
+        if (same) continue;
+
+        idx active    = vk_tex.active;
+        vk_tex        = ImageSlotsRef(*slots);
+        vk_tex.active = active;
+        // every frame's set still points to the old view
+        for (auto& set : m_sets) set.actives[i] = -1;
+        changed = true;
+    }
+    if (changed && m_bindless != nullptr) (void)acquireBindless();
+    return changed;
+}
 
+void CustomShaderPass::updateValues() {
+    m_values_due = true;
+    if (throttled()) {
+        // between ticks the uniforms stay as they were and the target holds its last output
+        auto now = std::chrono::steady_clock::now();
+        if (now < m_next_tick) {
+            m_values_due = false;
+            return;
+        }
+        m_next_tick += m_tick;
+        if (m_next_tick <= now) m_next_tick = now + m_tick;
+    }
+    m_sprite_last.clear();
+    for (auto& [i, sp] : m_desc.sprites_map) {
+        if (i < m_desc.vk_textures.size()) m_sprite_last.push_back(m_desc.vk_textures[i].active);
+    }
     if (m_desc.update_op) m_desc.update_op();
+}
 
-    auto&                   cmd    = rr.command;
-    auto&                   outext = m_desc.vk_output.extent;
-    VkImageSubresourceRange base_srang {
-        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-        .baseMipLevel   = 0,
-        .levelCount     = VK_REMAINING_ARRAY_LAYERS,
-        .baseArrayLayer = 0,
-        .layerCount     = VK_REMAINING_MIP_LEVELS,
+void CustomShaderPass::uploadValues() {
+    if (! m_palette_pending.empty()) {
+        bindPalette(m_palette_pending);
+        m_palette_pending = {};
+    }
+    if (m_desc.upload_op) m_desc.upload_op();
+}
+
+bool CustomShaderPass::update() {
+    // a clip's new frame shows even between ticks
+    bool video { false };
+    for (auto& [clip, serial] : m_videos) {
+        if (m_video->serial(clip) == serial) continue;
+        serial = m_video->serial(clip);
+        video  = true;
+    }
+    if (! m_values_due) return video;
+    // the upload consumes the mesh dirty flag
+    bool changed = video || (m_desc.dyn_vertex && m_desc.node->Mesh()->Dirty().load());
+    if (m_pipeline_pending && m_pipeline_pending->ready()) {
+        // drawn for the first time
+        m_pipeline_pending.reset();
+        changed = true;
+    } else if (m_pipeline_pending && m_pipeline_pending->failed() && ! m_pipeline_failed) {
+        LOG_ERROR("create pipeline failed, the layer stays hidden");
+        m_pipeline_failed = true;
+    }
+    if (m_particle && m_particle->scene->pending) {
+        ParticleCompute::stage(*m_particle);
+        changed = true;
+    }
+    if (m_tex_cache != nullptr && m_tex_generation != m_tex_cache->StreamGeneration()) {
+        m_tex_generation = m_tex_cache->StreamGeneration();
+        if (refreshStreamedTextures()) changed = true;
+    }
+
+    uploadValues();
+    {
+        usize n = 0;
+        for (auto& [i, sp] : m_desc.sprites_map) {
+            if (i >= m_desc.vk_textures.size()) continue;
+            if (m_desc.vk_textures[i].active != m_sprite_last[n++]) changed = true;
+        }
+    }
+    if (m_shared != nullptr) {
+        // only the members this shader reads, most passes don't take the time
+        auto& data = m_shared->data;
+        usize n    = 0;
+        for (auto [offset, size] : m_shared_ranges) {
+            if (offset + size > data.size()) continue;
+            m_shared_last.resize(std::max(m_shared_last.size(), n + size));
+            if (! std::equal(data.begin() + offset,
+                             data.begin() + offset + size,
+                             m_shared_last.begin() + n)) {
+                std::copy(data.begin() + offset, data.begin() + offset + size,
+                          m_shared_last.begin() + n);
+                changed = true;
+            }
+            n += size;
+        }
+    }
+    if (m_palettes != nullptr && m_bones_changed) changed = true;
+
+    // time, mouse, camera and property changes only show up as different uniform values
+    if (m_desc.ubo_buf && m_ubo_data != m_ubo_last) {
+        m_ubo_last = m_ubo_data;
+        changed    = true;
+    }
+
+    // off the view it draws nothing however it changed, going in or out of it is a change
+    const bool was_culled = m_culled;
+    m_culled              = viewCulled();
+    if (m_culled && was_culled) return false;
+    return changed || m_culled != was_culled;
+}
+
+bool CustomShaderPass::viewCulled() const {
+    if (! m_mvp_offset || *m_mvp_offset + 16 * sizeof(float) > m_ubo_data.size()) return false;
+    std::array<float, 16> m;
+    std::memcpy(m.data(), m_ubo_data.data() + *m_mvp_offset, sizeof(m));
+
+    // in clip space the view is -w <= x, y <= w, a point behind the eye is outside too
+    std::array<bool, 4> outside { true, true, true, true };
+    for (usize c = 0; c < 8; c++) {
+        const float x = m_box[c & 1][0], y = m_box[(c >> 1) & 1][1], z = m_box[c >> 2][2];
+        double      w = m[3] * x + m[7] * y + m[11] * z + m[15];
+        for (usize i = 0; i < 2; i++) {
+            double v = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i];
+            if (v <= w) outside[i * 2] = false;
+            if (v >= -w) outside[i * 2 + 1] = false;
+        }
+    }
+    return std::find(outside.begin(), outside.end(), true) != outside.end();
+}
+
+void CustomShaderPass::execute(const Device& device, RenderingResources& rr) {
+    auto& cmd = rr.command;
+    // inputs are synced before the pass by the barrier plan, see BarrierPlan
+
+    // alone in its render pass and keeping the target, a culled pass leaves it as it was
+    if (m_culled && m_run_prev == nullptr && m_run_next == nullptr && ! m_scissor_clear &&
+        m_desc.load_op == VK_ATTACHMENT_LOAD_OP_LOAD) {
+        m_secondary = VK_NULL_HANDLE;
+        return;
+    }
+    if (m_run_prev == nullptr) {
+        // on an async compute queue this splits the frame's commands, cmd is the new one after
+        if (m_particle) rr.particle_compute->record(rr, *m_particle);
+
+        // one kind of contents for the whole run, inline if any pass has no secondary
+        bool secondary = true;
+        for (auto* p = this; p != nullptr; p = p->m_run_next)
+            secondary = secondary && p->m_secondary != VK_NULL_HANDLE;
+        // passes of the run skipped this frame leave a state of an older one
+        static std::atomic<u64> run_serials { 0 };
+        const u64               serial = ++run_serials;
+        for (auto* p = this; p != nullptr; p = p->m_run_next) {
+            p->m_run_secondary = secondary;
+            p->m_run_serial    = serial;
+        }
+
+        auto& outext = m_desc.vk_output.extent;
+        // a run's passes share the scissor
+        VkRect2D area = m_scissor.value_or(VkRect2D {
+            .offset = { 0, 0 },
+            .extent = { outext.width, outext.height },
+        });
+        if (! m_desc.pass) {
+            beginRendering(cmd, area, secondary);
+        } else {
+            VkRenderPassBeginInfo pass_begin_info {
+                .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                .pNext           = nullptr,
+                .renderPass      = *m_desc.pass,
+                .framebuffer     = *m_desc.fb,
+                .renderArea      = area,
+                .clearValueCount = 1,
+                .pClearValues    = &m_desc.clear_value,
+            };
+            cmd.BeginRenderPass(pass_begin_info,
+                                secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                          : VK_SUBPASS_CONTENTS_INLINE);
+        }
+    }
+    if (m_run_secondary)
+        cmd.ExecuteCommands(m_secondary);
+    else
+        recordDraw(device, cmd, rr, m_run_prev != nullptr);
+    m_secondary = VK_NULL_HANDLE;
+    if (m_run_next == nullptr) {
+        if (! m_desc.pass)
+            endRendering(cmd);
+        else
+            cmd.EndRenderPass();
+    }
+}
+
+// the layout transitions and dependencies CreateRenderPass gives the render pass
+void CustomShaderPass::beginRendering(const vvk::CommandBuffer& cmd, VkRect2D area,
+                                      bool secondary) {
+    auto&                load = m_desc.load_op;
+    VkImageMemoryBarrier bar {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext               = nullptr,
+        .srcAccessMask       = {},
+        .dstAccessMask =
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .oldLayout           = load == VK_ATTACHMENT_LOAD_OP_LOAD
+                                   ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                                   : VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = m_desc.vk_output.handle,
+        .subresourceRange    = OutputRange(),
+    };
+    cmd.PipelineBarrier(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        0,
+                        bar);
+
+    VkRenderingAttachmentInfoKHR attachment {
+        .sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+        .pNext       = nullptr,
+        .imageView   = m_desc.vk_output.view,
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .resolveMode = VK_RESOLVE_MODE_NONE_KHR,
+        .loadOp      = load,
+        .storeOp     = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue  = m_desc.clear_value,
+    };
+    const VkRenderingFlagsKHR flags =
+        secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0u;
+    VkRenderingInfoKHR info {
+        .sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+        .pNext                = nullptr,
+        .flags                = flags,
+        .renderArea           = area,
+        .layerCount           = 1,
+        .viewMask             = 0,
+        .colorAttachmentCount = 1,
+        .pColorAttachments    = &attachment,
+    };
+    cmd.BeginRenderingKHR(info);
+}
+
+void CustomShaderPass::endRendering(const vvk::CommandBuffer& cmd) {
+    cmd.EndRenderingKHR();
+    VkImageMemoryBarrier bar {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext               = nullptr,
+        .srcAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask       = {},
+        .oldLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = m_desc.vk_output.handle,
+        .subresourceRange    = OutputRange(),
+    };
+    cmd.PipelineBarrier(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        0,
+                        bar);
+}
+
+bool CustomShaderPass::joinRenderPass(CustomShaderPass& prev) {
+    // particles dispatch compute before the render pass begins
+    if (m_particle) return false;
+    auto& out      = m_desc.vk_output;
+    auto& prev_out = prev.m_desc.vk_output;
+    if (out.handle != prev_out.handle || out.extent.width != prev_out.extent.width ||
+        out.extent.height != prev_out.extent.height)
+        return false;
+    // render passes of one format and sample count are compatible, the load op of the first holds
+    prev.m_run_next = this;
+    m_run_prev      = &prev;
+    return true;
+}
+
+std::optional<VkRect2D> CustomShaderPass::drawBounds() const {
+    if (! m_mvp_offset || m_desc.node == nullptr || m_desc.node->Mesh() == nullptr) return {};
+    if (*m_mvp_offset + 16 * sizeof(float) > m_ubo_data.size()) return {};
+    auto& mesh = *m_desc.node->Mesh();
+    if (mesh.VertexCount() == 0) return {};
+    auto& vertexs = mesh.GetVertexArray(0);
+
+    // column major, as std140 keeps it
+    std::array<float, 16> m;
+    std::memcpy(m.data(), m_ubo_data.data() + *m_mvp_offset, sizeof(m));
+    constexpr double      inf = std::numeric_limits<double>::infinity();
+    std::array<double, 2> lo { inf, inf }, hi { -inf, -inf };
+    const usize           stride = vertexs.OneSize();
+    for (usize v = 0; v < vertexs.VertexCount(); v++) {
+        const float* p = vertexs.Data() + v * stride + m_position_offset;
+        double       w = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+        // crossing the near plane, the projection spans anything
+        if (w <= 0.0) return {};
+        for (usize i = 0; i < 2; i++) {
+            double ndc = (m[i] * p[0] + m[4 + i] * p[1] + m[8 + i] * p[2] + m[12 + i]) / w;
+            lo[i]      = std::min(lo[i], ndc);
+            hi[i]      = std::max(hi[i], ndc);
+        }
+    }
+
+    // the viewport flips y, a pixel more around for rounding
+    const auto&  ext = m_desc.vk_output.extent;
+    const double w = ext.width, h = ext.height;
+    double       x0 = std::clamp(std::floor((lo[0] + 1.0) * 0.5 * w) - 1.0, 0.0, w);
+    double       x1 = std::clamp(std::ceil((hi[0] + 1.0) * 0.5 * w) + 1.0, 0.0, w);
+    double       y0 = std::clamp(std::floor((1.0 - hi[1]) * 0.5 * h) - 1.0, 0.0, h);
+    double       y1 = std::clamp(std::ceil((1.0 - lo[1]) * 0.5 * h) + 1.0, 0.0, h);
+    if (x1 <= x0 || y1 <= y0) return VkRect2D {};
+    return VkRect2D { { (i32)x0, (i32)y0 }, { (u32)(x1 - x0), (u32)(y1 - y0) } };
+}
+
+bool CustomShaderPass::recordSecondary(const Device& device, RenderingResources& rr,
+                                       const vvk::CommandBuffer& cmd) {
+    // with dynamic rendering no render pass says what it's recorded for
+    const VkFormat                             format = m_desc.vk_output_format;
+    VkCommandBufferInheritanceRenderingInfoKHR rendering {
+        .sType                   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR,
+        .pNext                   = nullptr,
+        .flags                   = 0,
+        .viewMask                = 0,
+        .colorAttachmentCount    = 1,
+        .pColorAttachmentFormats = &format,
+        .depthAttachmentFormat   = VK_FORMAT_UNDEFINED,
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+        .rasterizationSamples    = VK_SAMPLE_COUNT_1_BIT,
+    };
+    const bool                     dynamic = ! m_desc.pass;
+    VkCommandBufferInheritanceInfo inheritance {
+        .sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext       = dynamic ? &rendering : nullptr,
+        .renderPass  = *m_desc.pass,
+        .subpass     = 0,
+        // replayed in the framebuffer of the run's first pass
+        .framebuffer = m_run_prev == nullptr ? *m_desc.fb : VK_NULL_HANDLE,
+    };
+    VkCommandBufferBeginInfo begin_info {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = &inheritance,
+    };
+    begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    VVK_CHECK_BOOL_RE(cmd.Begin(begin_info));
+    recordDraw(device, cmd, rr, false);
+    VVK_CHECK_BOOL_RE(cmd.End());
+    m_secondary = *cmd;
+    return true;
+}
+
+bool CustomShaderPass::createFramebuffer(const Device& device) {
+    // rendering begins on the view itself
+    if (! m_desc.pass) return true;
+    VkFramebufferCreateInfo info {
+        .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .pNext           = nullptr,
+        .renderPass      = *m_desc.pass,
+        .attachmentCount = 1,
+        .pAttachments    = &m_desc.vk_output.view,
+        .width           = m_desc.vk_output.extent.width,
+        .height          = m_desc.vk_output.extent.height,
+        .layers          = 1,
+    };
+    VVK_CHECK_BOOL_RE(device.handle().CreateFramebuffer(info, m_desc.fb));
+    return true;
+}
+
+bool CustomShaderPass::createDescriptorSets(
+    const Device& device, RenderingResources& rr,
+    std::span<const VkDescriptorSetLayoutBinding> bindings) {
+    const u32 frame_num = (u32)rr.ubo_ring->frameNum();
+
+    Map<VkDescriptorType, u32> type_counts;
+    for (auto& b : bindings) type_counts[b.descriptorType] += b.descriptorCount * frame_num;
+    std::vector<VkDescriptorPoolSize> sizes;
+    for (auto& [type, count] : type_counts) sizes.push_back({ type, count });
+
+    m_sets.clear();
+    m_desc_pool = nullptr;
+    if (sizes.empty()) return true;
+
+    VkDescriptorPoolCreateInfo ci {
+        .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext         = nullptr,
+        .maxSets       = frame_num,
+        .poolSizeCount = (u32)sizes.size(),
+        .pPoolSizes    = sizes.data(),
     };
-    // Batch image barriers for better performance
-    std::vector<VkImageMemoryBarrier> image_barriers;
-    image_barriers.reserve(m_desc.vk_textures.size());
+    VVK_CHECK_BOOL_RE(device.handle().CreateDescriptorPool(ci, m_desc_pool));
 
+    std::vector<VkDescriptorSetLayout> layouts(frame_num, *m_desc.pipeline->descriptor_layouts[0]);
+    std::vector<VkDescriptorSet>       handles(frame_num);
+    VVK_CHECK_BOOL_RE(m_desc_pool.Allocate(layouts, handles.data()));
+
+    m_sets.resize(frame_num);
+    for (usize i = 0; i < frame_num; i++) {
+        m_sets[i].handle = handles[i];
+        // nothing written yet, the first refresh writes every binding
+        m_sets[i].actives.assign(m_desc.vk_textures.size(), -1);
+        m_sets[i].ubo_generation = 0;
+    }
+    return true;
+}
+
+void CustomShaderPass::refreshDescriptorSet(const Device& device, RenderingResources& rr) {
+    auto& set = m_sets[rr.index];
+
+    // kept between frames, most frames write nothing and shouldn't allocate for it
+    auto& imgs  = m_write_imgs;
+    auto& wsets = m_write_sets;
+    imgs.clear();
+    wsets.clear();
+    // the writes point into it
+    imgs.reserve(m_desc.vk_textures.size());
     for (usize i = 0; i < m_desc.vk_textures.size(); i++) {
         auto& slot    = m_desc.vk_textures[i];
         int   binding = m_desc.vk_tex_binding[i];
         if (binding < 0) continue;
         if (slot.slots.empty()) continue;
-        auto&                 img = slot.getActive();
-        VkDescriptorImageInfo desc_img { img.sampler,
-                                         img.view,
-                                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-        VkWriteDescriptorSet  wset {
-             .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-             .pNext           = nullptr,
-             .dstSet          = {},
-             .dstBinding      = (uint32_t)binding,
-             .descriptorCount = 1,
-             .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-             .pImageInfo      = &desc_img,
-        };
-        cmd.PushDescriptorSetKHR(VK_PIPELINE_BIND_POINT_GRAPHICS, *m_desc.pipeline.layout, 0, wset);
-
-        image_barriers.push_back(VkImageMemoryBarrier {
-            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            .pNext            = nullptr,
-            .srcAccessMask    = VK_ACCESS_MEMORY_READ_BIT,
-            .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT,
-            .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            .image            = img.handle,
-            .subresourceRange = base_srang,
-        });
-    }
+        if (set.actives[i] == slot.active) continue;
+        set.actives[i] = slot.active;
 
-    // Single batched barrier call instead of one per texture
-    if (!image_barriers.empty()) {
-        cmd.PipelineBarrier(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                            VK_DEPENDENCY_BY_REGION_BIT,
-                            {}, {}, image_barriers);
+        auto& img = slot.getActive();
+        imgs.push_back({ img.sampler, img.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+        wsets.push_back(VkWriteDescriptorSet {
+            .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext           = nullptr,
+            .dstSet          = set.handle,
+            .dstBinding      = (uint32_t)binding,
+            .descriptorCount = 1,
+            .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo      = &imgs.back(),
+        });
     }
 
-    if (m_desc.ubo_buf) {
-        VkDescriptorBufferInfo desc_buf {
-            rr.dyn_buf->gpuBuf(),
-            m_desc.ubo_buf.offset,
-            m_desc.ubo_buf.size,
+    VkDescriptorBufferInfo desc_buf {
+        rr.ubo_ring->gpuBuf(),
+        0,
+        m_desc.ubo_buf.size,
+    };
+    VkDescriptorBufferInfo shared_buf {
+        rr.ubo_ring->gpuBuf(),
+        0,
+        m_shared != nullptr ? m_shared->ref.size : 0,
+    };
+    if ((m_desc.ubo_buf || m_shared != nullptr) &&
+        set.ubo_generation != rr.ubo_ring->generation()) {
+        set.ubo_generation = rr.ubo_ring->generation();
+        auto write_ubo     = [&wsets, &set](u32 binding, const VkDescriptorBufferInfo& info) {
+            wsets.push_back(VkWriteDescriptorSet {
+                .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext           = nullptr,
+                .dstSet          = set.handle,
+                .dstBinding      = binding,
+                .descriptorCount = 1,
+                .descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                .pBufferInfo     = &info,
+            });
         };
-        VkWriteDescriptorSet wset {
+        if (m_desc.ubo_buf) write_ubo(m_ubo_binding, desc_buf);
+        if (m_shared != nullptr) write_ubo(m_shared_binding, shared_buf);
+    }
+    VkDescriptorBufferInfo bones_buf {
+        m_palettes != nullptr ? m_palettes->ring->gpuBuf() : VK_NULL_HANDLE,
+        0,
+        m_bones_ref.size,
+    };
+    if (m_palettes != nullptr && set.bones_generation != m_palettes->ring->generation()) {
+        set.bones_generation = m_palettes->ring->generation();
+        wsets.push_back(VkWriteDescriptorSet {
             .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
             .pNext           = nullptr,
-            .dstSet          = {},
-            .dstBinding      = 0,
+            .dstSet          = set.handle,
+            .dstBinding      = m_bones_binding,
             .descriptorCount = 1,
-            .descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .pBufferInfo     = &desc_buf,
-        };
-        cmd.PushDescriptorSetKHR(VK_PIPELINE_BIND_POINT_GRAPHICS, *m_desc.pipeline.layout, 0, wset);
+            .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+            .pBufferInfo     = &bones_buf,
+        });
     }
+    // the frame's fence signaled, the set is not in use
+    if (! wsets.empty()) device.handle().UpdateDescriptorSets(wsets);
+}
 
-    VkRenderPassBeginInfo pass_begin_info {
-        .sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .pNext       = nullptr,
-        .renderPass  = *m_desc.pipeline.pass,
-        .framebuffer = *m_desc.fb,
-        .renderArea =
-            VkRect2D {
-                .offset = { 0, 0 },
-                .extent = { outext.width, outext.height },
-            },
-        .clearValueCount = 1,
-        .pClearValues    = &m_desc.clear_value,
-    };
-    cmd.BeginRenderPass(pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+void CustomShaderPass::recordDraw(const Device& device, const vvk::CommandBuffer& cmd,
+                                  RenderingResources& rr, bool after_prev) {
+    auto& outext = m_desc.vk_output.extent;
+    // hidden until the pipeline is made or while culled, a clear still happens
+    const bool ready = pipelineReady() && ! m_culled;
+    auto&      bound = m_bound;
+    after_prev       = after_prev && m_run_prev->m_bound.serial == m_run_serial;
+    bound            = after_prev ? m_run_prev->m_bound : BoundState {};
+    bound.serial     = m_run_serial;
+
+    if (ready && ! m_sets.empty()) {
+        refreshDescriptorSet(device, rr);
+
+        VkDescriptorSet set = m_sets[rr.index].handle;
+        // binding order, as vulkan takes dynamic offsets
+        std::array<std::pair<u32, u32>, 3> dyn_offsets;
+        usize                              dyn_count { 0 };
+        if (m_desc.ubo_buf) {
+            (void)rr.ubo_ring->write(m_desc.ubo_buf, rr.index, m_ubo_data);
+            dyn_offsets[dyn_count++] = { m_ubo_binding,
+                                         rr.ubo_ring->dynamicOffset(m_desc.ubo_buf, rr.index) };
+        }
+        if (m_shared != nullptr) {
+            dyn_offsets[dyn_count++] = { m_shared_binding,
+                                         rr.ubo_ring->dynamicOffset(m_shared->ref, rr.index) };
+        }
+        if (m_palettes != nullptr) {
+            dyn_offsets[dyn_count++] = {
+                m_bones_binding, m_palettes->ring->dynamicOffset(m_bones_bound, rr.index)
+            };
+        }
+        std::sort(dyn_offsets.begin(), dyn_offsets.begin() + dyn_count);
+        std::array<uint32_t, 3> offsets {};
+        for (usize i = 0; i < dyn_count; i++) offsets[i] = dyn_offsets[i].second;
+        // in one call, binding set 0 alone with another layout would disturb set 1
+        std::array<VkDescriptorSet, 2> sets { set, VK_NULL_HANDLE };
+        u32                            set_count { 1 };
+        if (m_bindless != nullptr) sets[set_count++] = m_bindless->set();
+        cmd.BindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS,
+                               *m_desc.pipeline->layout,
+                               0,
+                               vvk::Span<VkDescriptorSet>(sets.data(), set_count),
+                               vvk::Span<uint32_t>(offsets.data(), dyn_count));
+    }
 
-    cmd.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, *m_desc.pipeline.handle);
+    if (ready && bound.pipeline != *m_desc.pipeline->handle) {
+        bound.pipeline = *m_desc.pipeline->handle;
+        cmd.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, bound.pipeline);
+    }
     VkViewport viewport {
         .x        = 0,
         .y        = (float)outext.height,
@@ -498,36 +1282,158 @@ void CustomShaderPass::execute(const Device&, RenderingResources& rr) {
         .minDepth = 0.0f,
         .maxDepth = 1.0f,
     };
-    VkRect2D scissor { { 0, 0 }, { outext.width, outext.height } };
+    VkRect2D scissor = m_scissor.value_or(VkRect2D { { 0, 0 }, { outext.width, outext.height } });
 
-    cmd.SetViewport(0, viewport);
-    cmd.SetScissor(0, scissor);
+    if (! bound.viewport || bound.extent.width != outext.width ||
+        bound.extent.height != outext.height) {
+        bound.viewport = true;
+        bound.extent   = { outext.width, outext.height };
+        cmd.SetViewport(0, viewport);
+    }
+    if (! bound.scissor || std::memcmp(&*bound.scissor, &scissor, sizeof(scissor)) != 0) {
+        bound.scissor = scissor;
+        cmd.SetScissor(0, scissor);
+    }
+    if (m_scissor_clear) {
+        VkClearAttachment attachment {
+            .aspectMask      = VK_IMAGE_ASPECT_COLOR_BIT,
+            .colorAttachment = 0,
+            .clearValue      = m_desc.clear_value,
+        };
+        VkClearRect rect { .rect = scissor, .baseArrayLayer = 0, .layerCount = 1 };
+        cmd.ClearAttachments(attachment, rect);
+    }
+    if (! ready) return;
 
-    auto gpu_buf = m_desc.dyn_vertex ? rr.dyn_buf->gpuBuf() : rr.vertex_buf->gpuBuf();
+    if (m_particle) {
+        VkBuffer     mesh_buf = *m_particle->mesh.handle;
+        VkDeviceSize offset   = ParticleCompute::vertexOffset(*m_particle);
+        bound.bindVertex(cmd, 0, mesh_buf, offset);
+        if (m_particle->instanced) {
+            cmd.Draw(m_particle->draw_count, m_particle->instance_count, 0, 0);
+        } else {
+            bound.bindIndex(cmd, mesh_buf, m_particle->index_offset, VK_INDEX_TYPE_UINT16);
+            cmd.DrawIndexed(m_particle->draw_count, 1, 0, 0, 0);
+        }
+        return;
+    }
+
+    // a dynamic mesh emptied, as when all particles died
+    if (m_desc.dyn_vertex && (m_desc.draw_count == 0 || m_desc.instance_count == 0)) return;
+
+    auto gpu_buf = m_desc.dyn_vertex ? rr.dyn_buf->gpuBuf(rr.index) : rr.vertex_buf->gpuBuf();
 
     for (usize i = 0; i < m_desc.vertex_bufs.size(); i++) {
-        auto& buf = m_desc.vertex_bufs[i];
-        cmd.BindVertexBuffers((u32)i, 1, &gpu_buf, &buf.offset);
+        bound.bindVertex(cmd, (u32)i, gpu_buf, m_desc.vertex_bufs[i].offset);
     }
     if (m_desc.index_buf) {
-        cmd.BindIndexBuffer(gpu_buf, m_desc.index_buf.offset, VK_INDEX_TYPE_UINT16);
+        bound.bindIndex(cmd, gpu_buf, m_desc.index_buf.offset, m_desc.index_type);
         cmd.DrawIndexed(m_desc.draw_count, 1, 0, 0, 0);
     } else {
-        cmd.Draw(m_desc.draw_count, 1, 0, 0);
+        cmd.Draw(m_desc.draw_count, m_desc.instance_count, 0, 0);
+    }
+}
+
+void CustomShaderPass::BoundState::bindVertex(const vvk::CommandBuffer& cmd, u32 binding,
+                                              VkBuffer buf, VkDeviceSize offset) {
+    if (binding < vertex.size()) {
+        auto& slot = vertex[binding];
+        if (slot.first == buf && slot.second == offset) return;
+        slot = { buf, offset };
     }
+    cmd.BindVertexBuffers(binding, 1, &buf, &offset);
+}
 
-    cmd.EndRenderPass();
+void CustomShaderPass::BoundState::bindIndex(const vvk::CommandBuffer& cmd, VkBuffer buf,
+                                             VkDeviceSize offset, VkIndexType type) {
+    if (index == buf && index_offset == offset && index_type == type) return;
+    index        = buf;
+    index_offset = offset;
+    index_type   = type;
+    cmd.BindIndexBuffer(buf, offset, type);
+}
+
+void CustomShaderPass::bindPalette(std::span<const float> data) {
+    auto&                    palettes = *m_palettes;
+    std::span<const uint8_t> bytes { (const uint8_t*)data.data(), data.size_bytes() };
+
+    auto [it, first] = palettes.written.try_emplace(data.data());
+    auto& written    = it->second;
+    if (first) {
+        auto& last      = palettes.last[data.data()];
+        written.ref     = m_bones_ref;
+        written.changed = ! std::equal(bytes.begin(), bytes.end(), last.begin(), last.end());
+        if (written.changed) last.assign(bytes.begin(), bytes.end());
+        (void)palettes.ring->write(m_bones_ref, palettes.frame, bytes);
+    }
+    m_bones_changed = written.changed || written.ref.offset != m_bones_bound.offset;
+    m_bones_bound   = written.ref;
 }
 
 void CustomShaderPass::destory(const Device&, RenderingResources& rr) {
     m_desc.update_op = {};
+    m_desc.upload_op = {};
+    if (m_desc.dyn_vertex) {
+        for (auto& bufref : m_desc.vertex_bufs) rr.dyn_buf->unallocateSubRef(bufref);
+    } else {
+        for (auto& bufref : m_desc.vertex_bufs) rr.static_geometry->release(bufref);
+        rr.static_geometry->release(m_desc.index_buf);
+    }
+    // shared copies may go to other content after this
+    m_desc.vertex_bufs.clear();
+    m_desc.index_buf = {};
+    rr.ubo_ring->unallocateSubRef(m_desc.ubo_buf);
+    if (m_particle) {
+        rr.particle_compute->destroySim(*m_particle);
+        m_particle.reset();
+    }
+    m_ubo_data.clear();
+    m_ubo_last.clear();
+    m_shared = nullptr;
+    if (m_palettes != nullptr) m_palettes->ring->unallocateSubRef(m_bones_ref);
+    m_palettes = nullptr;
+    for (auto& tex : m_bindless_texs) {
+        for (u32 slot : tex.slots) m_bindless->release(slot);
+    }
+    m_bindless_texs.clear();
+    m_bindless = nullptr;
+    m_videos.clear();
+    m_video = nullptr;
+    m_sets.clear();
+    m_desc_pool = nullptr;
+    m_run_prev  = nullptr;
+    m_run_next  = nullptr;
+    m_pipeline_pending.reset();
+    m_pipeline_failed = false;
+}
+
+bool CustomShaderPass::resizeTargets(Scene& scene, const Device& device, RenderingResources&) {
+    if (! prepared()) return false;
+    // queried in the order prepare did, so targets share images the same way
+    auto& cache = device.tex_cache();
     {
-        auto& buf = m_desc.dyn_vertex ? rr.dyn_buf : rr.vertex_buf;
-        for (auto& bufref : m_desc.vertex_bufs) {
-            buf->unallocateSubRef(bufref);
-        }
+        auto& rt  = scene.renderTargets.at(m_desc.output);
+        auto  opt = cache.Query(m_desc.output, ToTexKey(rt), ! rt.allowReuse);
+        if (! opt.has_value()) return false;
+        m_desc.vk_output = opt.value();
     }
-    rr.dyn_buf->unallocateSubRef(m_desc.ubo_buf);
+    for (usize i = 0; i < m_desc.textures.size(); i++) {
+        auto& tex_name = m_desc.textures[i];
+        if (tex_name.empty() || ! IsSpecTex(tex_name)) continue;
+        if (scene.renderTargets.count(tex_name) == 0) continue;
+        auto& rt  = scene.renderTargets.at(tex_name);
+        auto  opt = cache.Query(tex_name, ToTexKey(rt), ! rt.allowReuse);
+        if (! opt.has_value()) return false;
+        m_desc.vk_textures[i].slots = { opt.value() };
+        // every frame's set still points to the old view
+        for (auto& set : m_sets) set.actives[i] = -1;
+    }
+    if (m_bindless != nullptr && ! acquireBindless()) return false;
+    if (! createFramebuffer(device)) return false;
+    m_secondary = VK_NULL_HANDLE;
+
+    for (auto& tex : releaseTexs()) cache.MarkShareReady(tex);
+    return true;
 }
 
 void CustomShaderPass::setDescTex(u32 index, std::string_view tex_key) {
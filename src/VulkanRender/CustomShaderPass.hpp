@@ -1,13 +1,19 @@
 #pragma once
 #include "VulkanPass.hpp"
+#include <array>
+#include <chrono>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "Vulkan/Device.hpp"
 #include "Scene/Scene.h"
 #include "Vulkan/StagingBuffer.hpp"
+#include "Vulkan/UniformRing.hpp"
 #include "Vulkan/GraphicsPipeline.hpp"
 #include "SpriteAnimation.hpp"
+#include "ParticleCompute.hpp"
+#include "Resource.hpp"
 #include "Interface/IShaderValueUpdater.h"
 
 namespace wallpaper
@@ -24,28 +30,45 @@ public:
         std::vector<std::string> textures;
         std::string              output;
         sprite_map_t             sprites_map;
+        // hz to re-render at instead of every frame, the layer's own if set, else time_rate if
+        // only time moves the shader, 0 for every frame
+        std::optional<u32> update_rate;
+        u32                time_rate { 0 };
 
         // -----prepared
         // vulkan texs
         std::vector<ImageSlotsRef> vk_textures;
         std::vector<i32>           vk_tex_binding;
         ImageParameters            vk_output;
+        VkFormat                   vk_output_format { VK_FORMAT_R8G8B8A8_UNORM };
 
         // bufs
         bool                          dyn_vertex { false };
         std::vector<StagingBufferRef> vertex_bufs;
         StagingBufferRef              index_buf;
-        StagingBufferRef              ubo_buf;
+        // bumped when the mesh changed, and what each frame's buffer holds if written in place
+        u64              dyn_serial { 0 };
+        u64              dyn_generation { 0 };
+        std::vector<u64> dyn_written;
+        VkIndexType                   index_type { VK_INDEX_TYPE_UINT16 };
+        UniformRingRef                ubo_buf;
 
         // pipeline
         VkClearValue       clear_value;
+        VkAttachmentLoadOp load_op { VK_ATTACHMENT_LOAD_OP_DONT_CARE };
         bool               blending { false };
+        // null with dynamic rendering
+        vvk::RenderPass    pass;
         vvk::Framebuffer   fb;
-        PipelineParameters pipeline;
-        u32                draw_count { 0 };
+        // may be shared with passes of the same shaders and state, see PipelineRegistry
+        std::shared_ptr<const PipelineParameters> pipeline;
+        u32                                       draw_count { 0 };
+        u32                                       instance_count { 1 };
 
-        // uniforms
+        // uniforms, written to the pass alone, and then what of them goes to buffers shared
+        // with other passes, one pass at a time
         std::function<void()> update_op;
+        std::function<void()> upload_op;
     };
 
     CustomShaderPass(const Desc&);
@@ -56,6 +79,7 @@ public:
     void prepare(Scene&, const Device&, RenderingResources&) override;
     void execute(const Device&, RenderingResources&) override;
     void destory(const Device&, RenderingResources&) override;
+    bool resizeTargets(Scene&, const Device&, RenderingResources&) override;
 
     // Returns true if this pass has no dynamic elements (vertices, sprites)
     bool isStatic() const override {
@@ -63,20 +87,195 @@ public:
     }
 
     // Returns true if shader uses time-based uniforms (g_Time, g_PointerPosition, etc.)
-    bool usesTimeUniforms() const { return m_uses_time_uniforms; }
+    bool usesTimeUniforms() const override { return m_uses_time_uniforms; }
+    bool usesLiveUniforms() const override { return m_uses_live_uniforms; }
 
-    // Pass is cacheable if static and doesn't use time-based uniforms
-    bool isCacheable() const { return isStatic() && !m_uses_time_uniforms; }
+    // Pass is cacheable if static and doesn't use time-based uniforms, or re-renders at its rate
+    bool isCacheable() const override {
+        return isStatic() && (! m_uses_time_uniforms || throttled());
+    }
+    // re-renders only at the rate of its layer, the target holds the last tick in between
+    bool throttled() const { return m_tick.count() > 0; }
+
+    // Runs the uniform update unless throttled till a later tick, on a job
+    void updateValues() override;
+    // Uploads what updateValues() wrote, changed if the uniform block, a sprite frame or the
+    // dynamic mesh differs from last frame
+    bool update() override;
+    void reloadConstants() override;
+
+    bool canRecordSecondary() const override { return true; }
+    bool recordSecondary(const Device&, RenderingResources&, const vvk::CommandBuffer&) override;
+
+    // Draws inside the render pass of prev, which runs right before on the same target, the first
+    // of such a run begins the render pass and the last ends it. Both prepared, false if it can't
+    bool joinRenderPass(CustomShaderPass& prev);
 
-    // Check if output is already cached and valid
-    bool isCached() const { return m_cached; }
-    void invalidateCache() { m_cached = false; }
-    void markCached() { m_cached = true; }
+    // Where in the output the mesh draws with the uniforms of the last update(), unset if bones,
+    // particles or the cpu move its vertices or the shader takes no mvp. Empty if off the target
+    std::optional<VkRect2D> drawBounds() const;
+    // the mesh's box was outside the view with the uniforms of the last update(), the draw is
+    // skipped, only for meshes drawBounds can tell
+    bool culled() const { return m_culled; }
+    // false while the pipeline is made on a job, the pass draws nothing meanwhile
+    bool pipelineReady() const { return ! m_pipeline_pending || m_pipeline_pending->ready(); }
+
+    // Draws only inside the rect until unset, after clearing it to the clear color if clear
+    void setScissor(std::optional<VkRect2D> rect, bool clear = false) {
+        m_scissor       = rect;
+        m_scissor_clear = clear && rect.has_value();
+    }
 
 private:
+    // one long-lived set per frame in flight, rewritten only where it went stale
+    struct FrameSet {
+        VkDescriptorSet  handle { VK_NULL_HANDLE };
+        std::vector<idx> actives;
+        u64              ubo_generation { 0 };
+        u64              bones_generation { 0 };
+    };
+
+    bool createFramebuffer(const Device&);
+    // dynamic rendering on the output, the pass has no render pass then
+    void beginRendering(const vvk::CommandBuffer&, VkRect2D area, bool secondary);
+    void endRendering(const vvk::CommandBuffer&);
+    bool createDescriptorSets(const Device&, RenderingResources&,
+                              std::span<const VkDescriptorSetLayoutBinding>);
+    // sprite frames and a regrown uniform ring change what a set points to
+    void refreshDescriptorSet(const Device&, RenderingResources&);
+    // takes the wider views of textures the cache streamed more levels of
+    bool refreshStreamedTextures();
+    // the images of the textures sampled out of rr.bindless into it, then the slots they had
+    // are released, false if it's full
+    bool acquireBindless();
+    // the slots of the active images to the index uniforms
+    void writeTexIndices();
+    // descriptors, pipeline and draw, anything valid inside the render pass
+    // after_prev records right after the run's previous pass in the same buffer, what that bound
+    // and set is bound again only where it differs
+    void recordDraw(const Device&, const vvk::CommandBuffer&, RenderingResources&,
+                    bool after_prev);
+    // writes the palette unless another pass did this frame, and binds that copy
+    void bindPalette(std::span<const float>);
+    // the palette and the dynamic mesh of the last update_op
+    void uploadValues();
+    // every corner of the box past one side of the mvp's clip volume
+    bool viewCulled() const;
+
     Desc m_desc;
-    bool m_cached { false };
     bool m_uses_time_uniforms { false };
+    bool m_uses_live_uniforms { false };
+
+    // set if throttled, update() runs the uniforms only once the next tick is due
+    std::chrono::steady_clock::duration   m_tick {};
+    std::chrono::steady_clock::time_point m_next_tick {};
+    // the values ran this frame, not yet a tick if throttled
+    bool m_values_due { true };
+    // the frame's bones from the updater, bound by uploadValues
+    std::span<const float> m_palette_pending;
+
+    // uniforms as written by update, copied to the frame's ring region when recorded
+    std::vector<uint8_t> m_ubo_data;
+    std::vector<uint8_t> m_ubo_last;
+    u32                  m_ubo_binding { 0 };
+    // the uniforms the updater writes, indexed by the slots it resolved at prepare
+    struct UniformSlotDesc {
+        u32   offset { 0 };
+        usize num { 1 };
+        // the bones, in m_palettes instead of the block
+        bool palette { false };
+    };
+    std::vector<UniformSlotDesc> m_uniform_slots;
+    // every member of the block by name, the material's const values go there again on reload
+    Map<std::string, UniformSlotDesc> m_block_members;
+
+    // set if the shader reads the shared globals, the offset and size of each member it has and
+    // their values when last updated
+    SharedUniforms*                  m_shared { nullptr };
+    u32                              m_shared_binding { 0 };
+    std::vector<std::pair<u32, u32>> m_shared_ranges;
+    std::vector<uint8_t>             m_shared_last;
+
+    // set if the shader reads its bones from a storage buffer, the room for this pass's palette,
+    // the copy bound this frame and whether it changed since the last
+    BonePalettes*  m_palettes { nullptr };
+    u32            m_bones_binding { 0 };
+    UniformRingRef m_bones_ref;
+    UniformRingRef m_bones_bound;
+    bool           m_bones_changed { false };
+
+    // sprite textures packed into layers, by texture index, and where their layer uniform is
+    std::vector<std::pair<usize, u32>> m_tex_layers;
+
+    // set if the shader samples its textures out of the array of rr.bindless, by texture index
+    // where the index uniform is and the slot of each image
+    struct BindlessTex {
+        usize            tex { 0 };
+        u32              offset { 0 };
+        std::vector<u32> slots;
+    };
+    BindlessTextures*        m_bindless { nullptr };
+    std::vector<BindlessTex> m_bindless_texs;
+
+    // set if a texture is a clip of it, the clips and their serials when last looked at
+    VideoTextures*                     m_video { nullptr };
+    std::vector<std::pair<usize, u64>> m_videos;
+
+    // set if an image texture came from it, and its stream generation when last looked at
+    const TextureCache* m_tex_cache { nullptr };
+    u64                 m_tex_generation { 0 };
+
+    vvk::DescriptorPool   m_desc_pool;
+    std::vector<FrameSet> m_sets;
+    // scratch of refreshDescriptorSet
+    std::vector<VkDescriptorImageInfo> m_write_imgs;
+    std::vector<VkWriteDescriptorSet>  m_write_sets;
+    std::vector<idx>     m_sprite_last;
+
+    // set when the mesh's particles are simulated by rr.particle_compute
+    std::unique_ptr<ParticleCompute::Sim> m_particle;
+
+    // recorded for this frame, replayed by the next execute()
+    VkCommandBuffer m_secondary { VK_NULL_HANDLE };
+
+    // the registry entry until its pipeline was made
+    std::shared_ptr<const PipelineRegistry::Entry> m_pipeline_pending;
+    bool                                           m_pipeline_failed { false };
+
+    // in the uniform block and the first vertex array, in floats, set if drawBounds can tell
+    std::optional<u32> m_mvp_offset;
+    usize              m_position_offset { 0 };
+    // the mesh's box in model space, lowest and highest corner, with the mvp the view sees it in
+    std::array<std::array<float, 3>, 2> m_box {};
+    bool                                m_culled { false };
+    std::optional<VkRect2D> m_scissor;
+    bool                    m_scissor_clear { false };
+
+    // the passes sharing this one's render pass instance, and whether it replays secondaries
+    CustomShaderPass* m_run_prev { nullptr };
+    CustomShaderPass* m_run_next { nullptr };
+    bool              m_run_secondary { false };
+    u64               m_run_serial { 0 };
+
+    // the command buffer state the last recordDraw left, cards of a run drawing the shared quad
+    // with a shared pipeline only bind their descriptors
+    struct BoundState {
+        // of the run recording that left it
+        u64                     serial { 0 };
+        VkPipeline              pipeline { VK_NULL_HANDLE };
+        bool                    viewport { false };
+        VkExtent2D              extent {};
+        std::optional<VkRect2D> scissor;
+        // of the first bindings, more are bound every time
+        std::array<std::pair<VkBuffer, VkDeviceSize>, 4> vertex {};
+        VkBuffer                                         index { VK_NULL_HANDLE };
+        VkDeviceSize                                     index_offset { 0 };
+        VkIndexType                                      index_type { VK_INDEX_TYPE_UINT16 };
+
+        void bindVertex(const vvk::CommandBuffer&, u32 binding, VkBuffer, VkDeviceSize);
+        void bindIndex(const vvk::CommandBuffer&, VkBuffer, VkDeviceSize, VkIndexType);
+    };
+    BoundState m_bound;
 };
 
 } // namespace vulkan
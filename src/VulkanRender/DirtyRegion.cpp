@@ -0,0 +1,134 @@
+#include "DirtyRegion.hpp"
+#include "CustomShaderPass.hpp"
+#include "Utils/Logging.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string_view>
+
+using namespace wallpaper;
+using namespace wallpaper::vulkan;
+
+namespace
+{
+bool Contains(const std::vector<std::string>& keys, std::string_view key) {
+    return std::find(keys.begin(), keys.end(), key) != keys.end();
+}
+
+VkRect2D Union(const VkRect2D& a, const VkRect2D& b) {
+    if (a.extent.width == 0 || a.extent.height == 0) return b;
+    if (b.extent.width == 0 || b.extent.height == 0) return a;
+    i64 x0 = std::min<i64>(a.offset.x, b.offset.x);
+    i64 y0 = std::min<i64>(a.offset.y, b.offset.y);
+    i64 x1 = std::max<i64>(a.offset.x + a.extent.width, b.offset.x + b.extent.width);
+    i64 y1 = std::max<i64>(a.offset.y + a.extent.height, b.offset.y + b.extent.height);
+    return { { (i32)x0, (i32)y0 }, { (u32)(x1 - x0), (u32)(y1 - y0) } };
+}
+} // namespace
+
+void DirtyRegion::build(std::span<VulkanPass* const> passes,
+                        std::span<const PassCache::PassIO> io, const std::vector<bool>& composites,
+                        const Set<std::string>& shared, std::string_view target) {
+    clear();
+    assert(passes.size() == io.size());
+    const usize num = passes.size();
+
+    const char* reason { nullptr };
+    usize       layers { 0 };
+    if (exists(shared, target)) reason = "its image is shared";
+    if (composites.size() != num) reason = "the layers aren't known";
+    for (usize i = 0; i < num && reason == nullptr; i++) {
+        bool reads  = Contains(io[i].reads, target);
+        bool writes = Contains(io[i].writes, target);
+        if (reads && i + 1 != num) reason = "a pass before the last reads it";
+        if (! writes) continue;
+        if (composites[i])
+            layers++;
+        else if (io[i].reads.empty() && io[i].writes.size() == 1)
+            m_clears.push_back(i);
+        else
+            reason = "a pass but the layers writes it";
+    }
+    if (reason == nullptr && layers == 0) reason = "no layer draws on it";
+    if (reason != nullptr) {
+        m_clears.clear();
+        LOG_INFO("drawn in full every frame, %s", reason);
+        return;
+    }
+
+    m_enabled    = true;
+    m_composites = composites;
+    m_io.assign(io.begin(), io.end());
+    m_last.assign(num, std::nullopt);
+    LOG_INFO("layers drawn in the part that changed: %d", (int)layers);
+}
+
+void DirtyRegion::clear() {
+    m_enabled = false;
+    m_valid   = false;
+    m_changed.reset();
+    m_io.clear();
+    m_composites.clear();
+    m_last.clear();
+    m_clears.clear();
+}
+
+void DirtyRegion::schedule(std::span<VulkanPass* const> passes, const PassCache& cache) {
+    m_changed.reset();
+    if (! m_enabled) return;
+    assert(passes.size() == m_io.size());
+
+    // targets of the passes running this frame
+    Set<std::string_view> written;
+    bool                  full = ! m_valid;
+    VkRect2D              rect {};
+    for (usize i = 0; i < passes.size(); i++) {
+        if (! m_composites[i]) {
+            if (passes[i]->needsExecute()) {
+                for (auto& key : m_io[i].writes) written.insert(key);
+            }
+            continue;
+        }
+        auto* pass    = static_cast<CustomShaderPass*>(passes[i]);
+        auto  now     = pass->prepared() ? pass->drawBounds() : std::nullopt;
+        auto& reads   = m_io[i].reads;
+        bool  touched = cache.changed(i) || std::any_of(reads.begin(), reads.end(), [&](auto& k) {
+                           return exists(written, k);
+                       });
+        if (touched) {
+            if (now && m_last[i])
+                rect = Union(rect, Union(*now, *m_last[i]));
+            else
+                full = true;
+        }
+        m_last[i] = now;
+    }
+    m_valid = true;
+
+    // the first to run clears what the skipped clear would have
+    const bool empty = rect.extent.width == 0 || rect.extent.height == 0;
+    usize      first = passes.size();
+    for (usize i = 0; i < passes.size() && ! full && ! empty; i++) {
+        if (m_composites[i] && passes[i]->prepared() && passes[i]->needsExecute()) {
+            first = i;
+            break;
+        }
+    }
+    if (! empty && first == passes.size()) full = true;
+
+    for (usize i = 0; i < passes.size(); i++) {
+        if (! m_composites[i]) continue;
+        auto* pass = static_cast<CustomShaderPass*>(passes[i]);
+        if (full)
+            pass->setScissor(std::nullopt);
+        else if (empty)
+            // nothing moved, the target holds the last frame
+            pass->markClean();
+        else
+            pass->setScissor(rect, i == first);
+    }
+    if (! full) {
+        for (auto i : m_clears) passes[i]->markClean();
+        m_changed = empty ? VkRect2D {} : rect;
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "Vulkan/Instance.hpp"
+#include "VulkanPass.hpp"
+#include "PassCache.hpp"
+#include "Core/Literals.hpp"
+#include "Core/MapSet.hpp"
+
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+// The part of the target layers compose on that changed since the last frame.
+// A layer changed if its pass saw a change or reads a target written this frame, the region
+// covers where it draws now and where it drew last frame. Layers then draw only there, with a
+// scissor, the first clears it, and the pass clearing the whole target is skipped.
+// Only if the target keeps its image between frames, the layers' passes and that clear write it,
+// the last pass alone reads it, and every changed layer knows where it draws, else it's drawn
+// in full.
+class DirtyRegion {
+public:
+    // passes and io in execution order, composites are the shader passes drawing on the target
+    // and nothing else, shared are the targets that may get an image another one used
+    void build(std::span<VulkanPass* const>, std::span<const PassCache::PassIO>,
+               const std::vector<bool>& composites, const Set<std::string>& shared,
+               std::string_view target);
+    void clear();
+    // the target lost what it held, the next frame draws it all
+    void invalidate() { m_valid = false; }
+
+    // after the pass cache scheduled the frame
+    void schedule(std::span<VulkanPass* const>, const PassCache&);
+
+    bool enabled() const { return m_enabled; }
+    // what of the target the last scheduled frame changes, empty if nothing, all of it if null
+    const std::optional<VkRect2D>& changed() const { return m_changed; }
+
+private:
+    bool m_enabled { false };
+    bool m_valid { false };
+
+    std::optional<VkRect2D> m_changed;
+
+    std::vector<PassCache::PassIO> m_io;
+    std::vector<bool>              m_composites;
+    // where each composite drew last frame
+    std::vector<std::optional<VkRect2D>> m_last;
+    // passes but the composites writing the target, the clear
+    std::vector<usize> m_clears;
+};
+
+} // namespace vulkan
+} // namespace wallpaper
@@ -3,6 +3,8 @@
 #include "Resource.hpp"
 #include "PassCommon.hpp"
 
+#include <utility>
+
 using namespace wallpaper::vulkan;
 
 constexpr std::string_view vert_code = R"(#version 320 es
@@ -46,16 +48,17 @@ FinPass::FinPass(const Desc&) {}
 FinPass::~FinPass() {}
 namespace
 {
+// load keeps what the image holds, it must be in finalLayout then
 std::optional<vvk::RenderPass> CreateRenderPass(const vvk::Device& device, VkFormat format,
-                                                VkImageLayout finalLayout) {
+                                                VkImageLayout finalLayout, bool load = false) {
     VkAttachmentDescription attachment {
         .format         = format,
         .samples        = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .loadOp         = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR,
         .storeOp        = VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+        .initialLayout  = load ? finalLayout : VK_IMAGE_LAYOUT_UNDEFINED,
         .finalLayout    = finalLayout,
     };
     VkAttachmentReference attachment_ref {
@@ -84,6 +87,24 @@ std::optional<vvk::RenderPass> CreateRenderPass(const vvk::Device& device, VkFor
         return std::nullopt;
     }
 }
+
+VkRect2D Union(const VkRect2D& a, const VkRect2D& b) {
+    if (a.extent.width == 0 || a.extent.height == 0) return b;
+    if (b.extent.width == 0 || b.extent.height == 0) return a;
+    i64 x0 = std::min<i64>(a.offset.x, b.offset.x);
+    i64 y0 = std::min<i64>(a.offset.y, b.offset.y);
+    i64 x1 = std::max<i64>(a.offset.x + a.extent.width, b.offset.x + b.extent.width);
+    i64 y1 = std::max<i64>(a.offset.y + a.extent.height, b.offset.y + b.extent.height);
+    return { { (i32)x0, (i32)y0 }, { (u32)(x1 - x0), (u32)(y1 - y0) } };
+}
+
+VkRect2D Clamp(const VkRect2D& r, VkExtent2D ext) {
+    i64 x0 = std::clamp<i64>(r.offset.x, 0, ext.width);
+    i64 y0 = std::clamp<i64>(r.offset.y, 0, ext.height);
+    i64 x1 = std::clamp<i64>((i64)r.offset.x + r.extent.width, 0, ext.width);
+    i64 y1 = std::clamp<i64>((i64)r.offset.y + r.extent.height, 0, ext.height);
+    return { { (i32)x0, (i32)y0 }, { (u32)(x1 - x0), (u32)(y1 - y0) } };
+}
 } // namespace
 
 void FinPass::setPresent(ImageParameters img) { m_desc.vk_present = img; }
@@ -91,6 +112,22 @@ void FinPass::setPresentLayout(VkImageLayout layout) { m_desc.present_layout = l
 void FinPass::setPresentFormat(VkFormat format) { m_desc.present_format = format; }
 void FinPass::setPresentQueueIndex(uint32_t i) { m_desc.present_queue_index = i; }
 
+void FinPass::addChanged(const std::optional<VkRect2D>& rect) {
+    for (auto& [view, present] : m_desc.presents) {
+        if (! present.stale) continue;
+        if (rect)
+            present.stale = Union(*present.stale, *rect);
+        else
+            present.stale.reset();
+    }
+}
+
+void FinPass::invalidatePresents() {
+    for (auto& [view, present] : m_desc.presents) present.stale.reset();
+}
+
+void FinPass::setCapture(VkBuffer buf) { m_desc.capture = buf; }
+
 void FinPass::prepare(Scene& scene, const Device& device, RenderingResources& rr) {
     {
         auto tex_name = std::string(m_desc.result);
@@ -165,6 +202,12 @@ void FinPass::prepare(Scene& scene, const Device& device, RenderingResources& rr
         for (auto& spv : spvs) pipeline.addStage(std::move(spv));
 
         if (! pipeline.create(device, pass, m_desc.pipeline)) return;
+
+        // compatible with the first, framebuffers and the pipeline work with both
+        auto load =
+            CreateRenderPass(device.handle(), m_desc.present_format, m_desc.present_layout, true);
+        if (! load.has_value()) return;
+        m_desc.load_pass = std::move(load.value());
     }
     /*
     if(m_desc.present_layout == vk::ImageLayout::ePresentSrcKHR || m_desc.present_layout ==
@@ -193,8 +236,8 @@ void FinPass::execute(const Device& device, RenderingResources& rr) {
         .layerCount     = VK_REMAINING_MIP_LEVELS,
 
     };
-    {
-        m_desc.fb = {};
+    if (! exists(m_desc.presents, m_desc.vk_present.view)) {
+        vvk::Framebuffer        fb;
         VkFramebufferCreateInfo info {
             .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
             .pNext           = nullptr,
@@ -205,8 +248,18 @@ void FinPass::execute(const Device& device, RenderingResources& rr) {
             .height          = m_desc.vk_present.extent.height,
             .layers          = 1,
         };
-        (void)device.handle().CreateFramebuffer(info, m_desc.fb);
+        VVK_CHECK_VOID_RE(device.handle().CreateFramebuffer(info, fb));
+        m_desc.presents[m_desc.vk_present.view].fb = std::move(fb);
     }
+    auto& present = m_desc.presents.at(m_desc.vk_present.view);
+    // the image holds an older frame, only what changed since is drawn again
+    const auto& res_ext = m_desc.vk_result.extent;
+    const bool  partial = present.stale.has_value() && res_ext.width == outext.width &&
+                         res_ext.height == outext.height;
+    VkRect2D area { { 0, 0 }, { outext.width, outext.height } };
+    if (partial) area = Clamp(*present.stale, outext);
+    present.stale = VkRect2D {};
+    const bool draw = area.extent.width > 0 && area.extent.height > 0;
     {
         VkDescriptorImageInfo desc_img {
             .sampler     = m_desc.vk_result.sampler,
@@ -246,21 +299,14 @@ void FinPass::execute(const Device& device, RenderingResources& rr) {
                             imb);
     }
     VkRenderPassBeginInfo pass_begin_info {
-        .sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .pNext       = nullptr,
-        .renderPass  = *m_desc.pipeline.pass,
-        .framebuffer = *m_desc.fb,
-        .renderArea =
-            VkRect2D {
-                .offset = { 0, 0 },
-                .extent = { outext.width, outext.height },
-            },
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .pNext           = nullptr,
+        .renderPass      = partial ? *m_desc.load_pass : *m_desc.pipeline.pass,
+        .framebuffer     = *present.fb,
+        .renderArea      = area,
         .clearValueCount = 1,
         .pClearValues    = &m_desc.clear_value,
     };
-    cmd.BeginRenderPass(pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-
-    cmd.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, *m_desc.pipeline.handle);
     VkViewport viewport {
         .x        = 0,
         .y        = (float)outext.height,
@@ -269,14 +315,18 @@ void FinPass::execute(const Device& device, RenderingResources& rr) {
         .minDepth = 0.0f,
         .maxDepth = 1.0f,
     };
-    VkRect2D scissor { { 0, 0 }, { outext.width, outext.height } };
-    cmd.SetViewport(0, viewport);
-    cmd.SetScissor(0, scissor);
+    // nothing changed, the image holds the frame already
+    if (draw) {
+        cmd.BeginRenderPass(pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        cmd.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, *m_desc.pipeline.handle);
+        cmd.SetViewport(0, viewport);
+        cmd.SetScissor(0, area);
 
-    cmd.BindVertexBuffers(
-        0, 1, std::array { rr.vertex_buf->gpuBuf() }.data(), &m_desc.vertex_buf.offset);
-    cmd.Draw(4, 1, 0, 0);
-    cmd.EndRenderPass();
+        cmd.BindVertexBuffers(
+            0, 1, std::array { rr.vertex_buf->gpuBuf() }.data(), &m_desc.vertex_buf.offset);
+        cmd.Draw(4, 1, 0, 0);
+        cmd.EndRenderPass();
+    }
 
     // do queue family transfer operation
     if (m_desc.present_queue_index != device.graphics_queue().family_index) {
@@ -298,9 +348,63 @@ void FinPass::execute(const Device& device, RenderingResources& rr) {
                             VK_DEPENDENCY_BY_REGION_BIT,
                             imb);
     }
+
+    // the result goes back to shader reads after, where the barrier plan left it
+    if (m_desc.capture != VK_NULL_HANDLE) {
+        const VkBuffer      buf = std::exchange(m_desc.capture, VK_NULL_HANDLE);
+        const auto&         res = m_desc.vk_result;
+        VkImageMemoryBarrier imb {
+            .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext               = nullptr,
+            .srcAccessMask       = VK_ACCESS_SHADER_READ_BIT,
+            .dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT,
+            .oldLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .newLayout           = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = res.handle,
+            .subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+        };
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            0,
+                            imb);
+        VkBufferImageCopy region {
+            .bufferOffset      = 0,
+            .bufferRowLength   = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource  = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+            .imageOffset       = { 0, 0, 0 },
+            .imageExtent       = { res.extent.width, res.extent.height, 1 },
+        };
+        cmd.CopyImageToBuffer(res.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buf, region);
+
+        std::swap(imb.oldLayout, imb.newLayout);
+        imb.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        imb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        VkBufferMemoryBarrier bmb {
+            .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .pNext               = nullptr,
+            .srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask       = VK_ACCESS_HOST_READ_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer              = buf,
+            .offset              = 0,
+            .size                = VK_WHOLE_SIZE,
+        };
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                            0,
+                            {},
+                            bmb,
+                            imb);
+    }
 }
 void FinPass::destory(const Device&, RenderingResources& rr) {
     setPrepared(false);
+    m_desc.presents.clear();
     clearReleaseTexs();
     rr.vertex_buf->unallocateSubRef(m_desc.vertex_buf);
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "VulkanPass.hpp"
+#include <optional>
 #include <string>
 
 #include "Vulkan/Device.hpp"
@@ -14,8 +15,15 @@ namespace wallpaper
 namespace vulkan
 {
 
+// Draws the scene's result on the present image. A present image keeps what it was drawn with,
+// when the result has its size only the part that changed since is drawn again.
 class FinPass : public VulkanPass {
 public:
+    struct PresentImage {
+        vvk::Framebuffer fb;
+        // what of the result it lacks, all of it if null
+        std::optional<VkRect2D> stale;
+    };
     struct Desc {
         // in
         const std::string_view result { SpecTex_Default };
@@ -30,8 +38,14 @@ public:
         VkClearValue    clear_value;
 
         StagingBufferRef   vertex_buf;
-        vvk::Framebuffer   fb;
         PipelineParameters pipeline;
+        // loads what the present image holds, for drawing a part of it
+        vvk::RenderPass load_pass;
+
+        // per present image, frames in flight may still use older ones
+        Map<VkImageView, PresentImage> presents;
+        // the result is copied into it by the next execute, see setCapture
+        VkBuffer capture { VK_NULL_HANDLE };
     };
 
     FinPass(const Desc&);
@@ -41,11 +55,22 @@ public:
     void setPresentLayout(VkImageLayout);
     void setPresentFormat(VkFormat);
     void setPresentQueueIndex(uint32_t);
+    // the part of the result that changed this frame, all of it if null, see DirtyRegion
+    void addChanged(const std::optional<VkRect2D>&);
+    // the present images are new or lost what they held
+    void invalidatePresents();
+    // the next execute copies the result into the buffer, tightly packed, once it's drawn, the
+    // buffer holds its extent in texels of its format and stays alive till the frame is done
+    void setCapture(VkBuffer);
+    const ImageParameters& result() const { return m_desc.vk_result; }
 
     void prepare(Scene&, const Device&, RenderingResources&) override;
     void execute(const Device&, RenderingResources&) override;
     void destory(const Device&, RenderingResources&) override;
 
+    // presents the same way every frame
+    bool update() override { return false; }
+
 private:
     Desc m_desc;
 };
@@ -0,0 +1,104 @@
+#include "GpuProfiler.hpp"
+#include "Resource.hpp"
+#include "Utils/Logging.h"
+
+using namespace wallpaper::vulkan;
+
+bool GpuProfiler::init(const Device& device, usize frame_num) {
+    destroy();
+    m_slots.resize(frame_num);
+
+    auto props = device.gpu().GetQueueFamilyProperties();
+    u32  bits  = props[device.graphics_queue().family_index].timestampValidBits;
+
+    m_supported  = bits > 0 && device.limits().timestampPeriod > 0.0f;
+    m_period     = device.limits().timestampPeriod;
+    m_valid_mask = bits >= 64 ? ~0ull : (1ull << bits) - 1ull;
+    if (! m_supported) {
+        LOG_INFO("gpu timestamps not supported on graphics queue, profiler disabled");
+    }
+    return m_supported;
+}
+
+void GpuProfiler::destroy() {
+    m_slots.clear();
+    m_results.clear();
+    m_times.clear();
+    m_pass_num = 0;
+}
+
+void GpuProfiler::setPassNum(usize num) {
+    for (auto& slot : m_slots) slot = Slot {};
+    m_times.clear();
+    m_frame_time = 0.0;
+    m_pass_num   = num;
+}
+
+void GpuProfiler::beginFrame(const Device& device, RenderingResources& rr) {
+    m_frame_time = 0.0;
+    if (! enabled() || m_pass_num == 0) return;
+    auto& slot  = m_slots[rr.index];
+    u32   count = (u32)(m_pass_num * 2);
+
+    if (! slot.pool) {
+        VVK_CHECK_VOID_RE(device.handle().CreateQueryPool(
+            VkQueryPoolCreateInfo {
+                .sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                .pNext      = nullptr,
+                .queryType  = VK_QUERY_TYPE_TIMESTAMP,
+                .queryCount = count,
+            },
+            slot.pool));
+        slot.pending = false;
+    }
+
+    if (slot.pending) {
+        // value and availability per query, skipped passes wrote nothing and stay unavailable
+        m_results.resize(count * 2);
+        VkResult res = slot.pool.GetResults(
+            0, count, m_results, sizeof(u64) * 2, VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (res == VK_SUCCESS || res == VK_NOT_READY) {
+            m_times.resize(m_pass_num);
+            // passes run in order on the one queue
+            const u64* first { nullptr };
+            const u64* last { nullptr };
+            for (usize i = 0; i < m_pass_num; i++) {
+                const u64* begin = &m_results[i * 4];
+                const u64* end   = &m_results[i * 4 + 2];
+                if (begin[1] == 0 || end[1] == 0) {
+                    m_times[i] = 0.0;
+                    continue;
+                }
+                u64 ticks  = (end[0] - begin[0]) & m_valid_mask;
+                m_times[i] = (double)ticks * m_period / 1e6;
+                if (! first) first = begin;
+                last = end;
+            }
+            if (first) {
+                u64 ticks    = (last[0] - first[0]) & m_valid_mask;
+                m_frame_time = (double)ticks * m_period / 1e6;
+            }
+        } else {
+            VVK_CHECK(res);
+        }
+    }
+
+    rr.command.ResetQueryPool(*slot.pool, 0, count);
+    slot.pending = true;
+}
+
+bool GpuProfiler::active(const RenderingResources& rr) const {
+    return enabled() && m_pass_num > 0 && m_slots[rr.index].pending;
+}
+
+void GpuProfiler::beginPass(RenderingResources& rr, usize index) const {
+    if (! active(rr)) return;
+    rr.command.WriteTimestamp(
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, *m_slots[rr.index].pool, (u32)(index * 2));
+}
+
+void GpuProfiler::endPass(RenderingResources& rr, usize index) const {
+    if (! active(rr)) return;
+    rr.command.WriteTimestamp(
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, *m_slots[rr.index].pool, (u32)(index * 2 + 1));
+}
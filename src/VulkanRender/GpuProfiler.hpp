@@ -0,0 +1,69 @@
+#pragma once
+#include "Vulkan/Device.hpp"
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+#include <span>
+#include <vector>
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+struct RenderingResources;
+
+// Brackets each pass with timestamps, one query pool per frame in flight.
+// A slot is read back when its frame comes around again, the fence already signaled by then, so
+// results are frame_num frames old and reading them never stalls.
+class GpuProfiler : NoCopy, NoMove {
+public:
+    GpuProfiler() = default;
+
+    // false if the graphics queue has no timestamps, the profiler then stays off
+    bool init(const Device&, usize frame_num);
+    void destroy();
+
+    // may be set before init, takes effect once timestamps are known to work
+    void setEnabled(bool v) { m_enabled = v; }
+    bool enabled() const { return m_enabled && m_supported; }
+
+    // drops pools and results of the last graph, frames in flight must be done
+    void setPassNum(usize);
+
+    // after the slot's fence wait and the command buffer begin
+    void beginFrame(const Device&, RenderingResources&);
+    void beginPass(RenderingResources&, usize index) const;
+    void endPass(RenderingResources&, usize index) const;
+
+    // gpu milliseconds per pass of the latest read back frame, 0 for passes that did not run
+    // empty until the first frame came back
+    std::span<const double> passTimes() const { return m_times; }
+    // gpu milliseconds from the first pass begin to the last pass end of the frame the last
+    // beginFrame read back, 0 if it read none
+    double frameTime() const { return m_frame_time; }
+
+private:
+    struct Slot {
+        vvk::QueryPool pool;
+        bool           pending { false };
+    };
+
+    // pool of the frame exists and was reset this frame
+    bool active(const RenderingResources&) const;
+
+    bool  m_supported { false };
+    bool  m_enabled { false };
+    usize m_pass_num { 0 };
+    // nanoseconds per tick
+    double m_period { 1.0 };
+    u64    m_valid_mask { 0 };
+
+    std::vector<Slot>   m_slots;
+    std::vector<u64>    m_results;
+    std::vector<double> m_times;
+    double              m_frame_time { 0.0 };
+};
+
+} // namespace vulkan
+} // namespace wallpaper
@@ -0,0 +1,46 @@
+#include "MemoryWatch.hpp"
+#include "Utils/Logging.h"
+
+#include <algorithm>
+
+using namespace wallpaper::vulkan;
+
+MemoryWatch::Result MemoryWatch::check(std::uint64_t usage, std::uint64_t budget,
+                                       std::uint64_t retained) {
+    m_usage  = usage;
+    m_budget = budget;
+
+    Result result;
+    if (budget == 0) return result;
+
+    constexpr double mib = 1024.0 * 1024.0;
+    const double     low = (double)budget * LowMark;
+    if (over(usage, budget)) {
+        if (! m_pressure) {
+            LOG_INFO("memory pressure, %.1fm used of %.1fm",
+                     (double)usage / mib,
+                     (double)budget / mib);
+        }
+        m_pressure = true;
+        if (retained > 0) {
+            result.action = Action::TRIM;
+            result.trim   = (std::uint64_t)((double)usage - low);
+        } else if (m_cap > MinCap) {
+            m_cap         = std::max(m_cap - Step, MinCap);
+            result.action = Action::CAP;
+            LOG_INFO("targets capped at scale %.3f for memory", m_cap);
+        }
+        return result;
+    }
+    m_pressure = false;
+    if (m_cap < 1.0f) {
+        const float  up   = std::min(m_cap + Step, 1.0f);
+        const double grow = (double)(up * up) / (double)(m_cap * m_cap);
+        if ((double)usage * grow <= low) {
+            m_cap         = up;
+            result.action = Action::CAP;
+            LOG_INFO("targets capped at scale %.3f for memory", m_cap);
+        }
+    }
+    return result;
+}
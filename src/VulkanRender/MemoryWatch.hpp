@@ -0,0 +1,59 @@
+#pragma once
+#include "Core/Literals.hpp"
+
+#include <cstdint>
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+// Device local memory use against the budget, looked at every Interval drawn frames.
+// Over HighMark of the budget a step is taken per look, the textures retained from earlier scenes
+// are given back first, then the cap on the scale of screen sized targets steps down. It steps
+// back up once usage is below LowMark, as if all of it grew with the pixels.
+class MemoryWatch {
+public:
+    constexpr static usize  Interval { 60 };
+    constexpr static double HighMark { 0.9 };
+    constexpr static double LowMark { 0.75 };
+    constexpr static float  MinCap { 0.5f };
+    constexpr static float  Step { 0.125f };
+
+    enum class Action
+    {
+        NONE,
+        // free retained textures, what over LowMark is to free
+        TRIM,
+        // the resolution cap changed
+        CAP,
+    };
+    struct Result {
+        Action        action { Action::NONE };
+        std::uint64_t trim { 0 };
+    };
+
+    // a drawn frame, true if it's time to look
+    bool  frame() { return ++m_frames % Interval == 0; }
+    usize frames() const { return m_frames; }
+    static bool over(std::uint64_t usage, std::uint64_t budget) {
+        return budget > 0 && (double)usage > (double)budget * HighMark;
+    }
+    // how usage stands now, budget 0 if unknown
+    Result check(std::uint64_t usage, std::uint64_t budget, std::uint64_t retained);
+
+    bool          pressure() const { return m_pressure; }
+    float         cap() const { return m_cap; }
+    std::uint64_t usage() const { return m_usage; }
+    std::uint64_t budget() const { return m_budget; }
+
+private:
+    usize         m_frames { 0 };
+    bool          m_pressure { false };
+    float         m_cap { 1.0f };
+    std::uint64_t m_usage { 0 };
+    std::uint64_t m_budget { 0 };
+};
+
+} // namespace vulkan
+} // namespace wallpaper
@@ -0,0 +1,388 @@
+#include "MipCompute.hpp"
+#include "Vulkan/Shader.hpp"
+#include "Utils/Logging.h"
+
+#include <algorithm>
+#include <array>
+
+using namespace wallpaper::vulkan;
+
+namespace
+{
+// levels past the last bound again to the last one, stores with constant indices don't need
+// dynamic indexing of storage images
+constexpr std::string_view comp_code = R"(#version 450
+layout(local_size_x = 256) in;
+
+layout(binding = 0, rgba8) uniform coherent image2D u_levels[13];
+layout(std430, binding = 1) coherent buffer Counter { uint u_counter; };
+
+layout(push_constant) uniform Push {
+    ivec2 u_size;
+    uint  u_last;
+    uint  u_groups;
+};
+
+shared vec4 s_tile[32][32];
+shared bool s_final;
+
+ivec2 levelSize(uint n) { return max(u_size >> ivec2(n), ivec2(1)); }
+
+// a tile starts from level 0 or from level 6
+vec4 load(uint level, ivec2 p) {
+    return level == 0u ? imageLoad(u_levels[0], p) : imageLoad(u_levels[6], p);
+}
+
+void store(uint level, ivec2 p, vec4 v) {
+    if (any(greaterThanEqual(p, levelSize(level)))) return;
+    switch (level) {
+    case 1u: imageStore(u_levels[1], p, v); break;
+    case 2u: imageStore(u_levels[2], p, v); break;
+    case 3u: imageStore(u_levels[3], p, v); break;
+    case 4u: imageStore(u_levels[4], p, v); break;
+    case 5u: imageStore(u_levels[5], p, v); break;
+    case 6u: imageStore(u_levels[6], p, v); break;
+    case 7u: imageStore(u_levels[7], p, v); break;
+    case 8u: imageStore(u_levels[8], p, v); break;
+    case 9u: imageStore(u_levels[9], p, v); break;
+    case 10u: imageStore(u_levels[10], p, v); break;
+    case 11u: imageStore(u_levels[11], p, v); break;
+    case 12u: imageStore(u_levels[12], p, v); break;
+    }
+}
+
+// the 64x64 tile of level base at origin, down to base + 6 or the last level
+// odd sizes drop their last row or column, like a blit does
+void downsample(uint base, ivec2 origin) {
+    uint  i   = gl_LocalInvocationIndex;
+    ivec2 src = levelSize(base) - 1;
+    for (uint k = 0u; k < 4u; k++) {
+        uint  j = i + k * 256u;
+        ivec2 q = ivec2(j % 32u, j / 32u);
+        ivec2 p = (origin >> 1) + q;
+        vec4  v = load(base, min(p * 2, src)) + load(base, min(p * 2 + ivec2(1, 0), src)) +
+                 load(base, min(p * 2 + ivec2(0, 1), src)) + load(base, min(p * 2 + 1, src));
+        v *= 0.25;
+        s_tile[q.y][q.x] = v;
+        store(base + 1u, p, v);
+    }
+    uint end = min(base + 6u, u_last);
+    for (uint level = base + 2u; level <= end; level++) {
+        barrier();
+        uint  n     = level - base;
+        int   side  = 64 >> n;
+        ivec2 q     = ivec2(int(i) % side, int(i) / side);
+        ivec2 p     = (origin >> n) + q;
+        bool  owner = int(i) < side * side && all(lessThan(p, levelSize(level)));
+        vec4  v     = vec4(0.0);
+        if (owner) {
+            ivec2 last = levelSize(level - 1u) - 1;
+            ivec2 from = origin >> (n - 1u);
+            for (int d = 0; d < 4; d++) {
+                ivec2 t = min(p * 2 + ivec2(d & 1, d >> 1), last) - from;
+                v += s_tile[t.y][t.x];
+            }
+            v *= 0.25;
+            store(level, p, v);
+        }
+        barrier();
+        if (owner) s_tile[q.y][q.x] = v;
+    }
+}
+
+void main() {
+    downsample(0u, ivec2(gl_WorkGroupID.xy) * 64);
+    if (u_last <= 6u) return;
+
+    // level 6 is written, the last workgroup here sees all of it
+    memoryBarrierImage();
+    barrier();
+    if (gl_LocalInvocationIndex == 0u) s_final = atomicAdd(u_counter, 1u) == u_groups - 1u;
+    barrier();
+    if (! s_final) return;
+    if (gl_LocalInvocationIndex == 0u) u_counter = 0u;
+    downsample(6u, ivec2(0));
+}
+)";
+
+constexpr u32 tile_size { 64 };
+
+struct Push {
+    i32 width;
+    i32 height;
+    u32 last;
+    u32 groups;
+};
+static_assert(sizeof(Push) == 16);
+
+constexpr u32 Groups(u32 n) { return (n + tile_size - 1) / tile_size; }
+
+VkImageSubresourceRange Levels(u32 base, u32 count) {
+    return VkImageSubresourceRange {
+        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel   = base,
+        .levelCount     = count,
+        .baseArrayLayer = 0,
+        .layerCount     = 1,
+    };
+}
+} // namespace
+
+MipCompute::MipCompute()  = default;
+MipCompute::~MipCompute() = default;
+
+bool MipCompute::init(const Device& device, usize frame_num) {
+    m_frame_num = std::max<usize>(frame_num, 1);
+    m_views.resize(m_frame_num);
+
+    std::vector<Uni_ShaderSpv> spvs;
+    {
+        ShaderCompOpt opt;
+        opt.client_ver             = glslang::EShTargetVulkan_1_1;
+        opt.suppress_warnings_glsl = true;
+
+        std::array<ShaderCompUnit, 1> units;
+        units[0] = ShaderCompUnit { .stage = EShLangCompute, .src = std::string(comp_code) };
+        if (! CompileAndLinkShaderUnits(units, opt, spvs) || spvs.empty()) {
+            LOG_ERROR("compile mipmap compute shader failed");
+            return false;
+        }
+    }
+
+    {
+        std::array bindings {
+            VkDescriptorSetLayoutBinding {
+                .binding         = 0,
+                .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = MaxLevels,
+                .stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT,
+            },
+            VkDescriptorSetLayoutBinding {
+                .binding         = 1,
+                .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT,
+            },
+        };
+        VkDescriptorSetLayoutCreateInfo ci {
+            .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext        = nullptr,
+            .flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+            .bindingCount = (u32)bindings.size(),
+            .pBindings    = bindings.data(),
+        };
+        vvk::DescriptorSetLayout layout;
+        VVK_CHECK_BOOL_RE(device.handle().CreateDescriptorSetLayout(ci, layout));
+        m_pipeline.descriptor_layouts.emplace_back(std::move(layout));
+    }
+    {
+        VkDescriptorSetLayout layout = *m_pipeline.descriptor_layouts.front();
+        VkPushConstantRange   range {
+              .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+              .offset     = 0,
+              .size       = sizeof(Push),
+        };
+        VkPipelineLayoutCreateInfo ci {
+            .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext                  = nullptr,
+            .setLayoutCount         = 1,
+            .pSetLayouts            = &layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges    = &range,
+        };
+        VVK_CHECK_BOOL_RE(device.handle().CreatePipelineLayout(ci, m_pipeline.layout));
+    }
+    {
+        auto&                    code = spvs.front()->spirv;
+        VkShaderModuleCreateInfo ci {
+            .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .pNext    = nullptr,
+            .codeSize = code.size() * sizeof(decltype(code.back())),
+            .pCode    = code.data(),
+        };
+        vvk::ShaderModule module;
+        VVK_CHECK_BOOL_RE(device.handle().CreateShaderModule(ci, module));
+
+        VkComputePipelineCreateInfo pci {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = nullptr,
+            .stage =
+                VkPipelineShaderStageCreateInfo {
+                    .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .pNext  = nullptr,
+                    .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = *module,
+                    .pName  = spvs.front()->entry_point.c_str(),
+                },
+            .layout = *m_pipeline.layout,
+        };
+        VVK_CHECK_BOOL_RE(device.handle().CreateComputePipeline(
+            pci, m_pipeline.handle, *device.pipeline_cache()));
+    }
+    {
+        VkBufferCreateInfo ci {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .size  = sizeof(u32),
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        };
+        m_counter.req_size               = ci.size;
+        VmaAllocationCreateInfo vma_info = {};
+        vma_info.usage                   = VMA_MEMORY_USAGE_GPU_ONLY;
+        VVK_CHECK_BOOL_RE(
+            vvk::CreateBuffer(device.vma_allocator(), ci, vma_info, m_counter.handle));
+    }
+    LOG_INFO("mipmaps of render targets made in compute");
+    return true;
+}
+
+void MipCompute::destroy() {
+    m_views.clear();
+    m_counter  = {};
+    m_pipeline = {};
+}
+
+void MipCompute::beginFrame(usize frame) {
+    if (! m_views.empty()) m_views[frame % m_frame_num].clear();
+}
+
+bool MipCompute::supports(const ImageParameters& image) const {
+    return m_pipeline.handle && (image.usage & VK_IMAGE_USAGE_STORAGE_BIT) &&
+           image.mipmap_level > 1 && image.mipmap_level <= MaxLevels &&
+           image.extent.width <= MaxSize && image.extent.height <= MaxSize;
+}
+
+bool MipCompute::record(const Device& device, const vvk::CommandBuffer& cmd,
+                        const ImageParameters& image, usize frame) {
+    if (! supports(image)) return false;
+    const u32 levels = image.mipmap_level;
+
+    // a view per level, the layout binds them as one array
+    auto&                                        views = m_views[frame % m_frame_num];
+    std::array<VkDescriptorImageInfo, MaxLevels> infos;
+    for (u32 i = 0; i < levels; i++) {
+        VkImageViewCreateInfo ci {
+            .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .pNext            = nullptr,
+            .image            = image.handle,
+            .viewType         = VK_IMAGE_VIEW_TYPE_2D,
+            .format           = VK_FORMAT_R8G8B8A8_UNORM,
+            .subresourceRange = Levels(i, 1),
+        };
+        vvk::ImageView view;
+        VVK_CHECK_ACT(return false, device.handle().CreateImageView(ci, view));
+        infos[i] = VkDescriptorImageInfo {
+            .sampler     = VK_NULL_HANDLE,
+            .imageView   = *view,
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+        };
+        views.emplace_back(std::move(view));
+    }
+    std::fill(infos.begin() + levels, infos.end(), infos[levels - 1]);
+
+    if (! m_counter_zeroed) {
+        cmd.FillBuffer(*m_counter.handle, 0, VK_WHOLE_SIZE, 0);
+        m_counter_zeroed = true;
+    }
+    {
+        // the copy wrote level 0, the others are made anew, the counter was last set by the
+        // dispatch before
+        VkMemoryBarrier counter_bar {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext         = nullptr,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        };
+        std::array bars {
+            VkImageMemoryBarrier {
+                .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext               = nullptr,
+                .srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask       = VK_ACCESS_SHADER_READ_BIT,
+                .oldLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .newLayout           = VK_IMAGE_LAYOUT_GENERAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image               = image.handle,
+                .subresourceRange    = Levels(0, 1),
+            },
+            VkImageMemoryBarrier {
+                .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext               = nullptr,
+                .srcAccessMask       = {},
+                .dstAccessMask       = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
+                .newLayout           = VK_IMAGE_LAYOUT_GENERAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image               = image.handle,
+                .subresourceRange    = Levels(1, levels - 1),
+            },
+        };
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            0,
+                            counter_bar,
+                            {},
+                            bars);
+    }
+
+    cmd.BindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, *m_pipeline.handle);
+    {
+        VkDescriptorBufferInfo buf { *m_counter.handle, 0, VK_WHOLE_SIZE };
+        std::array wsets {
+            VkWriteDescriptorSet {
+                .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext           = nullptr,
+                .dstSet          = VK_NULL_HANDLE,
+                .dstBinding      = 0,
+                .descriptorCount = MaxLevels,
+                .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .pImageInfo      = infos.data(),
+            },
+            VkWriteDescriptorSet {
+                .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext           = nullptr,
+                .dstSet          = VK_NULL_HANDLE,
+                .dstBinding      = 1,
+                .descriptorCount = 1,
+                .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo     = &buf,
+            },
+        };
+        cmd.PushDescriptorSetKHR(VK_PIPELINE_BIND_POINT_COMPUTE, *m_pipeline.layout, 0, wsets);
+    }
+    const u32 gx = Groups(image.extent.width);
+    const u32 gy = Groups(image.extent.height);
+    cmd.PushConstants(*m_pipeline.layout,
+                      VK_SHADER_STAGE_COMPUTE_BIT,
+                      Push {
+                          .width  = (i32)image.extent.width,
+                          .height = (i32)image.extent.height,
+                          .last   = levels - 1,
+                          .groups = gx * gy,
+                      });
+    cmd.Dispatch(gx, gy, 1);
+
+    {
+        VkImageMemoryBarrier bar {
+            .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext               = nullptr,
+            .srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask       = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+            .oldLayout           = VK_IMAGE_LAYOUT_GENERAL,
+            .newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = image.handle,
+            .subresourceRange    = Levels(0, levels),
+        };
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            0,
+                            bar);
+    }
+    return true;
+}
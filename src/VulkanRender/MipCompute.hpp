@@ -0,0 +1,47 @@
+#pragma once
+#include "Core/NoCopyMove.hpp"
+#include "Vulkan/Device.hpp"
+#include "Vulkan/GraphicsPipeline.hpp"
+
+#include <vector>
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+// Makes the mips of a render target in one compute dispatch instead of a blit and two barriers
+// per level. Every workgroup box filters a 64x64 tile of level 0 down to level 6 in shared
+// memory, the last one to finish goes on from level 6 to the end.
+// Only for rgba8 images with storage usage up to MaxSize, CopyPass blits the others.
+class MipCompute : NoCopy, NoMove {
+public:
+    constexpr static u32 MaxSize { 4096 };
+    constexpr static u32 MaxLevels { 13 };
+
+    MipCompute();
+    ~MipCompute();
+
+    bool init(const Device&, usize frame_num);
+    void destroy();
+
+    // the frame in the slot is done, its views go
+    void beginFrame(usize frame);
+
+    bool supports(const ImageParameters&) const;
+    // level 0 was just written by a transfer and is in shader read only layout, so are the
+    // others after, false if nothing was recorded
+    bool record(const Device&, const vvk::CommandBuffer&, const ImageParameters&, usize frame);
+
+private:
+    usize              m_frame_num { 1 };
+    PipelineParameters m_pipeline;
+    // the workgroups done, the last one sets it back to 0
+    VmaBufferParameters m_counter;
+    bool                m_counter_zeroed { false };
+    // image views of the dispatches recorded in each slot
+    std::vector<std::vector<vvk::ImageView>> m_views;
+};
+
+} // namespace vulkan
+} // namespace wallpaper
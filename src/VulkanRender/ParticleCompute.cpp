@@ -0,0 +1,696 @@
+#include "ParticleCompute.hpp"
+#include "AsyncCompute.hpp"
+#include "SpecTexs.hpp"
+#include "Vulkan/Shader.hpp"
+#include "Utils/Logging.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <optional>
+#include <span>
+
+using namespace wallpaper::vulkan;
+
+namespace
+{
+// the operators mirror ParticleKernels and ParticleOperator, curl noise takes a float sized
+// epsilon
+constexpr std::string_view comp_code = R"(#version 450
+layout(local_size_x = 64) in;
+
+struct Op {
+    uvec4 info;
+    vec4  v[3];
+};
+struct Spawn {
+    vec4  state[5];
+    uvec4 slot;
+};
+// pos lifetime, velocity init lifetime, rotation init size, angular init alpha, init color
+struct Particle {
+    vec4 s[5];
+};
+
+layout(std430, binding = 0) buffer State { Particle particles[]; };
+layout(std430, binding = 1) readonly buffer Frame {
+    float u_time;
+    float u_time_pass;
+    uint  u_spawn_count;
+    uint  u_op_count;
+    uint  u_capacity;
+    uint  u_vertex_words;
+    uint  u_anim_mode;
+    float u_anim_multiplier;
+    uint  u_thick;
+    uint  u_instanced;
+    uint  u_pad1;
+    uint  u_pad2;
+    vec4  u_controlpoints[8];
+    Op    u_ops[16];
+    Spawn u_spawns[];
+};
+layout(std430, binding = 2) writeonly buffer Vertices { uint vertices[]; };
+layout(std430, binding = 3) writeonly buffer Indices { uint indices[]; };
+
+// 0 spawn, 1 simulate, 2 indices
+layout(push_constant) uniform Push { uint u_mode; };
+
+const int perm[256] = int[](
+    151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225,
+    140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148,
+    247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32,
+    57, 177, 33, 88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175,
+    74, 165, 71, 134, 139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122,
+    60, 211, 133, 230, 220, 105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54,
+    65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89, 18, 169,
+    200, 196, 135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64,
+    52, 217, 226, 250, 124, 123, 5, 202, 38, 147, 118, 126, 255, 82, 85, 212,
+    207, 206, 59, 227, 47, 16, 58, 17, 182, 189, 28, 42, 223, 183, 170, 213,
+    119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,
+    129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104,
+    218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12, 191, 179, 162, 241,
+    81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181, 199, 106, 157,
+    184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236, 205, 93,
+    222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180);
+
+int P(int i) { return perm[i & 255]; }
+
+float grad(int hash, float x, float y, float z) {
+    switch (hash & 0xF) {
+    case 0x0: return x + y;
+    case 0x1: return -x + y;
+    case 0x2: return x - y;
+    case 0x3: return -x - y;
+    case 0x4: return x + z;
+    case 0x5: return -x + z;
+    case 0x6: return x - z;
+    case 0x7: return -x - z;
+    case 0x8: return y + z;
+    case 0x9: return -y + z;
+    case 0xA: return y - z;
+    case 0xB: return -y - z;
+    case 0xC: return y + x;
+    case 0xD: return -y + z;
+    case 0xE: return y - x;
+    default: return -y - z;
+    }
+}
+
+float ease(float t) { return t * t * t * (t * (t * 6.0 - 15.0) + 10.0); }
+
+float perlin(vec3 p) {
+    ivec3 c = ivec3(floor(p)) & 255;
+    vec3  f = p - floor(p);
+    float x = f.x, y = f.y, z = f.z;
+    float u = ease(x), v = ease(y), w = ease(z);
+
+    int A = P(c.x) + c.y, AA = P(A) + c.z, AB = P(A + 1) + c.z;
+    int B = P(c.x + 1) + c.y, BA = P(B) + c.z, BB = P(B + 1) + c.z;
+
+    return mix(mix(mix(grad(P(AA), x, y, z), grad(P(BA), x - 1.0, y, z), u),
+                   mix(grad(P(AB), x, y - 1.0, z), grad(P(BB), x - 1.0, y - 1.0, z), u),
+                   v),
+               mix(mix(grad(P(AA + 1), x, y, z - 1.0), grad(P(BA + 1), x - 1.0, y, z - 1.0), u),
+                   mix(grad(P(AB + 1), x, y - 1.0, z - 1.0),
+                       grad(P(BB + 1), x - 1.0, y - 1.0, z - 1.0),
+                       u),
+                   v),
+               w);
+}
+
+vec3 perlin3(vec3 p) {
+    return vec3(perlin(p),
+                perlin(p + vec3(89.2, 33.1, 57.3)),
+                perlin(p + vec3(100.3, 120.1, 142.2)));
+}
+
+vec3 curl(vec3 p) {
+    const float e = 1e-3;
+    vec3 dx = vec3(e, 0.0, 0.0), dy = vec3(0.0, e, 0.0), dz = vec3(0.0, 0.0, e);
+    vec3 x0 = perlin3(p - dx), x1 = perlin3(p + dx);
+    vec3 y0 = perlin3(p - dy), y1 = perlin3(p + dy);
+    vec3 z0 = perlin3(p - dz), z1 = perlin3(p + dz);
+    return vec3(y1.z - y0.z - z1.y + z0.y,
+                z1.x - z0.x - x1.z + x0.z,
+                x1.y - x0.y - y1.x + y0.x) / (2.0 * e);
+}
+
+// zero stays zero, like Eigen
+vec3 safeNormalize(vec3 v) {
+    float l = length(v);
+    return l > 0.0 ? v / l : v;
+}
+
+float lifetimePos(float life, float init) { return life < 0.0 ? 1.0 : 1.0 - life / init; }
+
+// start end start_value end_value
+float fade(float life, vec4 c) {
+    float inv = c.y > c.x ? 1.0 / (c.y - c.x) : 1e30;
+    float t   = clamp((life - c.x) * inv, 0.0, 1.0);
+    return c.z + t * (c.w - c.z);
+}
+
+void spawn(uint i) {
+    if (i >= u_spawn_count) return;
+    uint slot = u_spawns[i].slot.x;
+    if (slot >= u_capacity) return;
+    for (int k = 0; k < 5; k++) particles[slot].s[k] = u_spawns[i].state[k];
+}
+
+void writeIndices(uint i) {
+    if (i >= u_capacity) return;
+    // 0 1 3, 1 2 3
+    uint cv              = i * 4u;
+    indices[i * 3u]      = cv | ((cv + 1u) << 16);
+    indices[i * 3u + 1u] = (cv + 3u) | ((cv + 1u) << 16);
+    indices[i * 3u + 2u] = (cv + 2u) | ((cv + 3u) << 16);
+}
+
+void simulate(uint i) {
+    if (i >= u_capacity) return;
+    Particle p = particles[i];
+
+    vec3  pos       = p.s[0].xyz;
+    float life      = p.s[0].w;
+    vec3  vel       = p.s[1].xyz;
+    float init_life = p.s[1].w;
+    vec3  rot       = p.s[2].xyz;
+    float size      = p.s[2].w;
+    vec3  angular   = p.s[3].xyz;
+    float alpha     = p.s[3].w;
+    vec3  color     = p.s[4].rgb;
+    float t         = u_time_pass;
+
+    bool alive = life > 0.0;
+    if (alive) {
+        life -= t;
+        alive = life > 0.0;
+    }
+    if (alive) {
+        float lpos = lifetimePos(life, init_life);
+        for (uint n = 0u; n < u_op_count; n++) {
+            uint type = u_ops[n].info.x;
+            uint arg  = u_ops[n].info.y;
+            vec4 v0   = u_ops[n].v[0];
+            vec4 v1   = u_ops[n].v[1];
+            vec4 v2   = u_ops[n].v[2];
+            if (type == 0u) {
+                // drag speed, gravity
+                vel = vel * (1.0 - 2.0 * v0.y * v0.x * t) + v0.y * v1.xyz * t;
+                pos += vel * t;
+            } else if (type == 1u) {
+                // drag, force
+                angular += (v1.xyz - 2.0 * v0.x * rot) * t;
+                rot += angular * t;
+            } else if (type == 2u) {
+                float f = fade(lpos, v0);
+                if (arg == 0u) alpha *= f;
+                else if (arg == 1u) size *= f;
+                else if (arg == 2u) color.r *= f;
+                else if (arg == 3u) color.g *= f;
+                else color.b *= f;
+            } else if (type == 3u) {
+                // fadein fadeout
+                float f = 1.0;
+                if (lpos <= v0.x) f = fade(lpos, vec4(0.0, v0.x, 0.0, 1.0));
+                else if (lpos > v0.y) f = fade(lpos, vec4(v0.y, 1.0, 1.0, 0.0));
+                alpha *= f;
+            } else if (type == 4u) {
+                // timescale scale phase speed, mask bits
+                vec3 q = pos;
+                q.x += v0.z + v0.x * u_time;
+                vec3 r = v0.w * safeNormalize(curl(q * v0.y * 2.0));
+                r *= vec3((arg & 1u) != 0u ? 1.0 : 0.0,
+                          (arg & 2u) != 0u ? 1.0 : 0.0,
+                          (arg & 4u) != 0u ? 1.0 : 0.0);
+                vel += r * t;
+            } else if (type == 5u) {
+                // distance inner outer, speed inner outer, offset, axis
+                vec3  center   = u_controlpoints[arg & 7u].xyz + v1.xyz;
+                vec3  direct   = -safeNormalize(cross(v2.xyz, pos));
+                float distance = length(pos - center);
+                float dis_mid  = v0.y - v0.x + 0.1;
+                if (dis_mid < 0.0 || distance < v0.x) vel += direct * v0.z * t;
+                if (distance > v0.y) vel += direct * v0.w * t;
+                else if (distance > v0.x)
+                    vel += direct * mix(v0.z, v0.w, (distance - v0.x) / dis_mid) * t;
+            } else if (type == 6u) {
+                // scale threshold, origin
+                vec3  diff     = u_controlpoints[arg & 7u].xyz + v1.xyz - pos;
+                float distance = length(diff);
+                if (distance < v0.y) vel += safeNormalize(diff) * v0.x * t;
+            }
+        }
+    }
+    particles[i].s[0] = vec4(pos, life);
+    particles[i].s[1] = vec4(vel, init_life);
+    particles[i].s[2].xyz = rot;
+    particles[i].s[3].xyz = angular;
+
+    float half_size = alive ? size / 2.0 : 0.0;
+    float spec_life = 0.0;
+    if (alive) {
+        spec_life = u_anim_mode == 1u ? floor(init_life)
+                                      : (1.0 - life / init_life) * u_anim_multiplier;
+    }
+    // instanced meshes take one element per particle, the vertex shader adds the corner
+    // the packed layout of SetParticleMesh, the angle kept close to 0 for its half float
+    const vec2 uvs[4] = vec2[](vec2(0.0, 1.0), vec2(1.0, 1.0), vec2(1.0, 0.0), vec2(0.0, 0.0));
+    const float two_pi = 6.28318531;
+    uint  num     = u_instanced != 0u ? 1u : 4u;
+    uint  rz_size = packHalf2x16(vec2(rot.z - two_pi * round(rot.z / two_pi), half_size));
+    uint  rgba    = packUnorm4x8(vec4(color, alive ? alpha : 0.0));
+    for (uint k = 0u; k < num; k++) {
+        uint base           = (i * num + k) * u_vertex_words;
+        vertices[base]      = floatBitsToUint(pos.x);
+        vertices[base + 1u] = floatBitsToUint(pos.y);
+        vertices[base + 2u] = floatBitsToUint(pos.z);
+        vertices[base + 3u] = packHalf2x16(u_instanced != 0u ? vec2(0.0) : uvs[k]);
+        vertices[base + 4u] = rz_size;
+        vertices[base + 5u] = rgba;
+        uint last           = 6u;
+        if (u_thick != 0u) {
+            vertices[base + 6u] = floatBitsToUint(vel.x);
+            vertices[base + 7u] = floatBitsToUint(vel.y);
+            vertices[base + 8u] = floatBitsToUint(vel.z);
+            vertices[base + 9u] = floatBitsToUint(spec_life);
+            last                = 10u;
+        }
+        vertices[base + last]      = floatBitsToUint(rot.x);
+        vertices[base + last + 1u] = floatBitsToUint(rot.y);
+    }
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (u_mode == 0u) spawn(i);
+    else if (u_mode == 1u) simulate(i);
+    else writeIndices(i);
+}
+)";
+
+constexpr u32 group_size { 64 };
+
+enum class Mode : u32
+{
+    SPAWN    = 0,
+    SIMULATE = 1,
+    INDICES  = 2,
+};
+
+// the Frame block before its spawns
+struct FrameHeader {
+    float time;
+    float time_pass;
+    u32   spawn_count;
+    u32   op_count;
+    u32   capacity;
+    u32   vertex_words;
+    u32   anim_mode;
+    float anim_multiplier;
+    u32   thick;
+    u32   instanced;
+    u32   pad[2];
+
+    std::array<std::array<float, 4>, wallpaper::SceneParticleSim::MaxControlpoints> controlpoints;
+    std::array<wallpaper::SceneParticleSim::Op, wallpaper::SceneParticleSim::MaxOps> ops;
+};
+static_assert(sizeof(wallpaper::SceneParticleSim::Op) == 64);
+static_assert(sizeof(wallpaper::SceneParticleSim::Spawn) == 96);
+static_assert(sizeof(FrameHeader) == 1200);
+
+constexpr VkDeviceSize state_one_size { 5 * 4 * sizeof(float) };
+
+constexpr VkDeviceSize AlignUp(VkDeviceSize v, VkDeviceSize align) {
+    return (v + align - 1) / align * align;
+}
+
+constexpr u32 Groups(u32 n) { return (n + group_size - 1) / group_size; }
+
+// the words the shader writes, the layout SetParticleMesh makes
+bool PackedQuad(const wallpaper::SceneVertexArray& sv, bool thick) {
+    using wallpaper::VertexType;
+    auto at = [&sv](std::string_view name, u32 offset, VertexType type) {
+        auto attr = sv.FindAttr(name);
+        return attr.valid() && attr.offset == offset && attr.type == type;
+    };
+    return sv.OneSize() == (thick ? 12u : 8u) &&
+           at(wallpaper::WE_IN_POSITION, 0, VertexType::FLOAT3) &&
+           at(wallpaper::WE_IN_TEXCOORDVEC4, 3, VertexType::HALF4) &&
+           at(wallpaper::WE_IN_COLOR, 5, VertexType::UNORM8X4) &&
+           (! thick || at(wallpaper::WE_IN_TEXCOORDVEC4C1, 6, VertexType::FLOAT4)) &&
+           at(wallpaper::WE_IN_TEXCOORDC2, thick ? 10 : 6, VertexType::FLOAT2);
+}
+
+std::optional<VmaBufferParameters> CreateBuf(const Device& device, VkDeviceSize size,
+                                             VkBufferUsageFlags usage, VmaMemoryUsage mem,
+                                             VmaAllocationCreateFlags     flags    = 0,
+                                             std::span<const uint32_t> families = {}) {
+    VmaBufferParameters buf;
+    VkBufferCreateInfo  ci {
+         .sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+         .pNext       = nullptr,
+         .size        = size,
+         .usage       = usage,
+         .sharingMode = families.size() > 1 ? VK_SHARING_MODE_CONCURRENT
+                                            : VK_SHARING_MODE_EXCLUSIVE,
+         .queueFamilyIndexCount = (u32)families.size(),
+         .pQueueFamilyIndices   = families.data(),
+    };
+    buf.req_size                     = size;
+    VmaAllocationCreateInfo vma_info = {};
+    vma_info.usage                   = mem;
+    vma_info.flags                   = flags;
+    VVK_CHECK_ACT(return std::nullopt,
+                  vvk::CreateBuffer(device.vma_allocator(), ci, vma_info, buf.handle));
+    return buf;
+}
+
+VkDescriptorBufferInfo BufInfo(const VmaBufferParameters& buf, VkDeviceSize offset,
+                               VkDeviceSize size) {
+    return { *buf.handle, offset, size };
+}
+} // namespace
+
+ParticleCompute::ParticleCompute()  = default;
+ParticleCompute::~ParticleCompute() = default;
+
+bool ParticleCompute::init(const Device& device, usize frame_num, bool async) {
+    m_allocator     = device.vma_allocator();
+    m_frame_num     = std::max<usize>(frame_num, 1);
+    m_storage_align = std::max<VkDeviceSize>(device.limits().minStorageBufferOffsetAlignment, 4);
+    m_async         = async;
+    m_families.clear();
+    if (async)
+        m_families = { device.graphics_queue().family_index, device.compute_queue().family_index };
+
+    std::vector<Uni_ShaderSpv> spvs;
+    {
+        ShaderCompOpt opt;
+        opt.client_ver             = glslang::EShTargetVulkan_1_1;
+        opt.suppress_warnings_glsl = true;
+
+        std::array<ShaderCompUnit, 1> units;
+        units[0] = ShaderCompUnit { .stage = EShLangCompute, .src = std::string(comp_code) };
+        if (! CompileAndLinkShaderUnits(units, opt, spvs) || spvs.empty()) {
+            LOG_ERROR("compile particle compute shader failed");
+            return false;
+        }
+    }
+
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings;
+    for (u32 i = 0; i < bindings.size(); i++) {
+        bindings[i] = VkDescriptorSetLayoutBinding {
+            .binding         = i,
+            .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT,
+        };
+    }
+    {
+        VkDescriptorSetLayoutCreateInfo ci {
+            .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext        = nullptr,
+            .flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+            .bindingCount = (u32)bindings.size(),
+            .pBindings    = bindings.data(),
+        };
+        vvk::DescriptorSetLayout layout;
+        VVK_CHECK_BOOL_RE(device.handle().CreateDescriptorSetLayout(ci, layout));
+        m_pipeline.descriptor_layouts.emplace_back(std::move(layout));
+    }
+    {
+        VkDescriptorSetLayout layout = *m_pipeline.descriptor_layouts.front();
+        VkPushConstantRange   range {
+              .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+              .offset     = 0,
+              .size       = sizeof(u32),
+        };
+        VkPipelineLayoutCreateInfo ci {
+            .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext                  = nullptr,
+            .setLayoutCount         = 1,
+            .pSetLayouts            = &layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges    = &range,
+        };
+        VVK_CHECK_BOOL_RE(device.handle().CreatePipelineLayout(ci, m_pipeline.layout));
+    }
+    {
+        auto&                    code = spvs.front()->spirv;
+        VkShaderModuleCreateInfo ci {
+            .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .pNext    = nullptr,
+            .codeSize = code.size() * sizeof(decltype(code.back())),
+            .pCode    = code.data(),
+        };
+        vvk::ShaderModule module;
+        VVK_CHECK_BOOL_RE(device.handle().CreateShaderModule(ci, module));
+
+        VkComputePipelineCreateInfo pci {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = nullptr,
+            .stage =
+                VkPipelineShaderStageCreateInfo {
+                    .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .pNext  = nullptr,
+                    .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = *module,
+                    .pName  = spvs.front()->entry_point.c_str(),
+                },
+            .layout = *m_pipeline.layout,
+        };
+        VVK_CHECK_BOOL_RE(device.handle().CreateComputePipeline(
+            pci, m_pipeline.handle, *device.pipeline_cache()));
+    }
+    LOG_INFO("particle compute ready");
+    return true;
+}
+
+void ParticleCompute::destroy() { m_pipeline = {}; }
+
+bool ParticleCompute::createSim(const Device& device, SceneMesh& mesh, Sim& sim) {
+    auto* scene = mesh.ParticleSim();
+    if (scene == nullptr || ! m_pipeline.handle || mesh.VertexCount() == 0) return false;
+    const auto& sv = mesh.GetVertexArray(0);
+    if (! PackedQuad(sv, scene->thick_format) || scene->capacity == 0) return false;
+
+    const u32    capacity     = scene->capacity;
+    const bool   instanced    = sv.PerInstance();
+    const u32    copies       = m_async ? (u32)m_frame_num : 1u;
+    VkDeviceSize vertex_size  = (VkDeviceSize)capacity * (instanced ? 1 : 4) * sv.OneSizeOf();
+    VkDeviceSize copy_size    = AlignUp(vertex_size, m_storage_align);
+    VkDeviceSize index_offset = copy_size * copies;
+    // instanced draws have no indices, the binding still wants a range
+    VkDeviceSize index_size =
+        instanced ? sizeof(u32) : (VkDeviceSize)capacity * 6 * sizeof(u16);
+
+    auto mesh_buf = CreateBuf(device,
+                              index_offset + index_size,
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                              VMA_MEMORY_USAGE_GPU_ONLY,
+                              0,
+                              m_families);
+    auto state_buf =
+        CreateBuf(device,
+                  capacity * state_one_size,
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                  VMA_MEMORY_USAGE_GPU_ONLY);
+    // a resync sends every slot at once
+    VkDeviceSize region =
+        AlignUp(sizeof(FrameHeader) + capacity * sizeof(SceneParticleSim::Spawn), m_storage_align);
+    auto frame_buf = CreateBuf(device,
+                               region * m_frame_num,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                               VMA_MEMORY_USAGE_CPU_TO_GPU,
+                               VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    if (! mesh_buf || ! state_buf || ! frame_buf) return false;
+
+    sim.scene          = scene;
+    sim.mesh           = std::move(mesh_buf.value());
+    sim.state          = std::move(state_buf.value());
+    sim.frame          = std::move(frame_buf.value());
+    sim.index_offset   = index_offset;
+    sim.copy_size      = copy_size;
+    sim.copies         = copies;
+    sim.copy           = 0;
+    sim.instanced      = instanced;
+    sim.draw_count     = instanced ? mesh.InstanceVertexCount() : capacity * 6;
+    sim.instance_count = instanced ? capacity : 1;
+    sim.frame_region   = region;
+    sim.vertex_words   = (u32)sv.OneSize();
+    sim.frame_raw      = (uint8_t*)sim.frame.handle.MappedData();
+    sim.initialized    = false;
+    sim.slot_stamps.assign(capacity, 0);
+    sim.stamp = 0;
+
+    VkMemoryPropertyFlags props {};
+    vmaGetAllocationMemoryProperties(device.vma_allocator(), sim.frame.handle.Allocation(), &props);
+    sim.coherent = props & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if (sim.frame_raw == nullptr) {
+        LOG_ERROR("particle frame buffer not mapped");
+        destroySim(sim);
+        return false;
+    }
+
+    // spawns from now on go to the gpu
+    scene->spawns.clear();
+    scene->pending = false;
+    scene->active  = true;
+    return true;
+}
+
+void ParticleCompute::destroySim(Sim& sim) {
+    // the cpu picks the particles up again, positions as of when it stopped
+    if (sim.scene != nullptr) sim.scene->active = false;
+    sim = {};
+}
+
+void ParticleCompute::stage(Sim& sim) {
+    auto& scene = *sim.scene;
+    if (! scene.pending) return;
+    sim.time          = scene.time;
+    sim.time_pass     = scene.time_pass + (sim.staged ? sim.time_pass : 0.0f);
+    sim.controlpoints = scene.controlpoints;
+    sim.spawns.insert(sim.spawns.end(), scene.spawns.begin(), scene.spawns.end());
+    sim.staged = true;
+    scene.spawns.clear();
+    scene.pending = false;
+}
+
+VkDeviceSize ParticleCompute::vertexOffset(const Sim& sim) {
+    const bool steps = ! sim.initialized || sim.staged;
+    return ((sim.copy + (steps ? 1 : 0)) % sim.copies) * sim.copy_size;
+}
+
+void ParticleCompute::record(RenderingResources& rr, Sim& sim) {
+    // ops and the load time values don't change once the sim is created
+    auto& scene = *sim.scene;
+    if (sim.initialized && ! sim.staged) return;
+    const usize               frame  = rr.index;
+    const u32                 next   = (sim.copy + 1) % sim.copies;
+    const VkDeviceSize        vertex = next * sim.copy_size;
+    const vvk::CommandBuffer& cmd    = m_async ? rr.async_compute->begin(rr) : rr.command;
+
+    const u32 capacity = scene.capacity;
+    u32       spawn_num { 0 };
+    {
+        VkDeviceSize offset = (frame % m_frame_num) * sim.frame_region;
+        uint8_t*     raw    = sim.frame_raw + offset;
+
+        FrameHeader header {};
+        header.time            = sim.time;
+        header.time_pass       = sim.staged ? sim.time_pass : 0.0f;
+        header.op_count        = (u32)std::min(scene.ops.size(), header.ops.size());
+        header.capacity        = capacity;
+        header.vertex_words    = sim.vertex_words;
+        header.anim_mode       = scene.anim_mode;
+        header.anim_multiplier = scene.anim_multiplier;
+        header.thick           = scene.thick_format ? 1 : 0;
+        header.instanced       = sim.instanced ? 1 : 0;
+        header.controlpoints   = sim.controlpoints;
+        std::copy_n(scene.ops.begin(), header.op_count, header.ops.begin());
+
+        // steps the render missed may respawn a slot, the last one wins
+        auto* spawns = (SceneParticleSim::Spawn*)(raw + sizeof(FrameHeader));
+        sim.stamp++;
+        for (auto it = sim.spawns.rbegin(); it != sim.spawns.rend(); it++) {
+            if (it->slot >= capacity || sim.slot_stamps[it->slot] == sim.stamp) continue;
+            sim.slot_stamps[it->slot] = sim.stamp;
+            spawns[spawn_num++]       = *it;
+        }
+        header.spawn_count = spawn_num;
+        std::memcpy(raw, &header, sizeof(header));
+
+        if (! sim.coherent) {
+            VVK_CHECK(vmaFlushAllocation(
+                m_allocator, sim.frame.handle.Allocation(), offset, sim.frame_region));
+        }
+        sim.spawns.clear();
+        sim.staged = false;
+    }
+
+    if (! sim.initialized) {
+        cmd.FillBuffer(*sim.state.handle, 0, VK_WHOLE_SIZE, 0);
+        VkMemoryBarrier bar {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext         = nullptr,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        };
+        cmd.PipelineBarrier(
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, bar);
+    }
+    {
+        // the last frame's draw reads the mesh, its dispatch wrote the state, a compute queue
+        // writes a copy no draw on the gpu reads
+        VkMemoryBarrier bar {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext         = nullptr,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        };
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                (m_async ? 0u : VK_PIPELINE_STAGE_VERTEX_INPUT_BIT),
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            0,
+                            bar);
+    }
+
+    cmd.BindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, *m_pipeline.handle);
+    {
+        VkDeviceSize           offset = (frame % m_frame_num) * sim.frame_region;
+        std::array             infos  = { BufInfo(sim.state, 0, VK_WHOLE_SIZE),
+                                          BufInfo(sim.frame, offset, sim.frame_region),
+                                          BufInfo(sim.mesh, vertex, sim.copy_size),
+                                          BufInfo(sim.mesh, sim.index_offset, VK_WHOLE_SIZE) };
+        std::array<VkWriteDescriptorSet, 4> wsets;
+        for (u32 i = 0; i < wsets.size(); i++) {
+            wsets[i] = VkWriteDescriptorSet {
+                .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext           = nullptr,
+                .dstSet          = VK_NULL_HANDLE,
+                .dstBinding      = i,
+                .descriptorCount = 1,
+                .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo     = &infos[i],
+            };
+        }
+        cmd.PushDescriptorSetKHR(VK_PIPELINE_BIND_POINT_COMPUTE, *m_pipeline.layout, 0, wsets);
+    }
+
+    auto dispatch = [&cmd, this](Mode mode, u32 num) {
+        cmd.PushConstants(*m_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, (u32)mode);
+        cmd.Dispatch(Groups(num), 1, 1);
+    };
+    if (! sim.initialized && ! sim.instanced) dispatch(Mode::INDICES, capacity);
+    if (spawn_num > 0) {
+        dispatch(Mode::SPAWN, spawn_num);
+        VkMemoryBarrier bar {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext         = nullptr,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        };
+        cmd.PipelineBarrier(
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, bar);
+    }
+    dispatch(Mode::SIMULATE, capacity);
+    sim.initialized = true;
+    sim.copy        = next;
+    // the graphics commands wait on the compute queue's semaphore instead
+    if (m_async) return;
+    {
+        VkMemoryBarrier bar {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext         = nullptr,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+        };
+        cmd.PipelineBarrier(
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, bar);
+    }
+}
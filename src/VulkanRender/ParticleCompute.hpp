@@ -0,0 +1,92 @@
+#pragma once
+#include "Core/NoCopyMove.hpp"
+#include "Vulkan/Device.hpp"
+#include "Vulkan/GraphicsPipeline.hpp"
+#include "Scene/SceneMesh.h"
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+struct RenderingResources;
+
+// Runs the particle operators of meshes linked to a SceneParticleSim in a compute shader and
+// writes their vertices, the draw then reads them in place.
+// The pipeline is shared, every mesh gets its own Sim.
+// On an async compute queue a mesh has a copy of its vertices per frame in flight, a step writes
+// the one after the last, which no frame still on the gpu reads, see AsyncCompute.
+class ParticleCompute : NoCopy, NoMove {
+public:
+    struct Sim {
+        SceneParticleSim* scene { nullptr };
+
+        // particle state, device local
+        VmaBufferParameters state;
+        // vertices then u16 indices for every slot, dead slots are zero sized quads
+        // instanced meshes get one element per slot and no indices
+        // the vertices are there once per copy, the indices once
+        VmaBufferParameters mesh;
+        VkDeviceSize        index_offset { 0 };
+        VkDeviceSize        copy_size { 0 };
+        u32                 copies { 1 };
+        // the last step wrote it
+        u32 copy { 0 };
+        bool                instanced { false };
+        u32                 draw_count { 0 };
+        u32                 instance_count { 1 };
+
+        // one region per frame in flight: header, operators and the frame's spawns
+        VmaBufferParameters frame;
+        uint8_t*            frame_raw { nullptr };
+        VkDeviceSize        frame_region { 0 };
+        bool                coherent { false };
+
+        u32  vertex_words { 0 };
+        bool initialized { false };
+
+        // drops repeated spawns of a slot
+        std::vector<u32> slot_stamps;
+        u32              stamp { 0 };
+
+        // the steps taken from the scene and not recorded yet, the particle system runs the
+        // next frame while this one records
+        bool                                                                 staged { false };
+        float                                                                time { 0.0f };
+        float                                                                time_pass { 0.0f };
+        std::array<std::array<float, 4>, SceneParticleSim::MaxControlpoints> controlpoints {};
+        std::vector<SceneParticleSim::Spawn>                                 spawns;
+    };
+
+    ParticleCompute();
+    ~ParticleCompute();
+
+    // async puts the steps on the compute queue, recorded through rr.async_compute
+    bool init(const Device&, usize frame_num, bool async);
+    void destroy();
+
+    // false if the mesh can't be simulated here, it stays on cpu
+    bool createSim(const Device&, SceneMesh&, Sim&);
+    void destroySim(Sim&);
+
+    // takes the step the particle system left, with the pass update
+    static void stage(Sim&);
+    // consumes the staged steps, nothing if there are none
+    // records outside a render pass, the mesh is ready for vertex input after
+    void record(RenderingResources&, Sim&);
+    // of the vertices the frame's draw reads, the copy its step writes if it has one, the same
+    // before and after record
+    static VkDeviceSize vertexOffset(const Sim&);
+
+private:
+    VmaAllocator       m_allocator { VK_NULL_HANDLE };
+    usize              m_frame_num { 1 };
+    VkDeviceSize       m_storage_align { 1 };
+    bool               m_async { false };
+    // the mesh is shared with the compute family, empty without async
+    std::vector<uint32_t> m_families;
+    PipelineParameters m_pipeline;
+};
+
+} // namespace vulkan
+} // namespace wallpaper
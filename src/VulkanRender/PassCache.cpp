@@ -0,0 +1,178 @@
+#include "PassCache.hpp"
+#include "Utils/Logging.h"
+#include "Looper/JobSystem.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <string_view>
+
+using namespace wallpaper::vulkan;
+
+namespace
+{
+// passes a job, the values of one are too little work to hand out alone
+constexpr wallpaper::usize values_grain { 8 };
+} // namespace
+
+void PassCache::build(std::span<VulkanPass* const> passes, std::vector<PassIO> io) {
+    clear();
+    m_io = std::move(io);
+    assert(m_io.size() == passes.size());
+
+    const usize       num = passes.size();
+    std::vector<bool> cached(num);
+    for (usize i = 0; i < num; i++) cached[i] = passes[i]->isCacheable();
+
+    Map<std::string, std::vector<usize>> writers, readers;
+    for (usize i = 0; i < num; i++) {
+        for (auto& key : m_io[i].writes) writers[key].push_back(i);
+        for (auto& key : m_io[i].reads) readers[key].push_back(i);
+    }
+
+    std::vector<usize> parent(num);
+    auto               find = [&parent](usize i) {
+        while (parent[i] != i) i = parent[i] = parent[parent[i]];
+        return i;
+    };
+
+    bool changed = true;
+    auto demote  = [&cached, &changed](usize i) {
+        if (! cached[i]) return;
+        cached[i] = false;
+        changed   = true;
+    };
+    while (changed) {
+        changed = false;
+
+        // a target with an uncached writer changes every frame, so do its readers
+        for (auto& [key, ws] : writers) {
+            if (std::all_of(ws.begin(), ws.end(), [&cached](usize w) {
+                    return cached[w];
+                }))
+                continue;
+            for (auto w : ws) demote(w);
+            if (exists(readers, key))
+                for (auto r : readers.at(key)) demote(r);
+        }
+        if (changed) continue;
+
+        std::iota(parent.begin(), parent.end(), 0);
+        for (auto& [key, ws] : writers) {
+            for (auto w : ws) parent[find(w)] = find(ws.front());
+            if (! exists(readers, key)) continue;
+            for (auto r : readers.at(key))
+                if (cached[r]) parent[find(r)] = find(ws.front());
+        }
+
+        // while skipped a target holds the last version of the frame, readers of an earlier
+        // version, or of the last frame inside the group, need the whole chain to run
+        for (auto& [key, ws] : writers) {
+            if (! exists(readers, key)) continue;
+            auto  range = std::minmax_element(ws.begin(), ws.end());
+            usize first = *range.first;
+            usize last  = *range.second;
+            usize group = find(ws.front());
+
+            auto& rs     = readers.at(key);
+            bool  broken = std::any_of(rs.begin(), rs.end(), [&](usize r) {
+                bool member = cached[r] && find(r) == group;
+                return member ? r <= first : (r > first && r < last);
+            });
+            if (! broken) continue;
+            for (usize i = 0; i < num; i++) {
+                if (cached[i] && find(i) == group) demote(i);
+            }
+        }
+    }
+
+    Map<usize, usize> root_groups;
+    m_pass_group.assign(num, no_group);
+    for (usize i = 0; i < num; i++) {
+        if (! cached[i]) continue;
+        usize root = find(i);
+        if (! exists(root_groups, root)) {
+            root_groups[root] = m_groups.size();
+            m_groups.emplace_back();
+        }
+        m_pass_group[i] = root_groups.at(root);
+        m_groups[m_pass_group[i]].members.push_back(i);
+    }
+    for (auto& [key, ws] : writers) {
+        if (cached[ws.front()]) m_persist_texs.insert(key);
+    }
+    LOG_INFO("cacheable passes: %d of %d, in %d groups",
+             std::count(cached.begin(), cached.end(), true),
+             num,
+             m_groups.size());
+}
+
+void PassCache::clear() {
+    m_io.clear();
+    m_pass_group.clear();
+    m_groups.clear();
+    m_persist_texs.clear();
+}
+
+void PassCache::invalidate() {
+    for (auto& group : m_groups) group.valid = false;
+}
+
+bool PassCache::schedule(std::span<VulkanPass* const> passes) {
+    assert(passes.size() == m_pass_group.size());
+
+    m_changed.resize(passes.size());
+    looper::JobSystem::Shared().parallelFor(
+        passes.size(),
+        [passes](usize i) {
+            if (passes[i]->prepared()) passes[i]->updateValues();
+        },
+        looper::JobPriority::Frame,
+        values_grain);
+    for (usize i = 0; i < passes.size(); i++) {
+        m_changed[i] = passes[i]->prepared() && passes[i]->update();
+    }
+
+    for (auto& group : m_groups) group.dirty = ! group.valid;
+    for (usize i = 0; i < passes.size(); i++) {
+        auto g = m_pass_group[i];
+        if (g != no_group && m_changed[i]) m_groups[g].dirty = true;
+    }
+
+    // a group also runs when a target it reads was written this frame, a group turning dirty
+    // late invalidates what earlier passes saw, so repeat until stable
+    Set<std::string_view> written;
+    bool                  again = true;
+    while (again) {
+        again = false;
+        written.clear();
+        for (usize i = 0; i < passes.size(); i++) {
+            auto g = m_pass_group[i];
+            if (g != no_group && ! m_groups[g].dirty) {
+                auto& reads = m_io[i].reads;
+                if (std::none_of(reads.begin(), reads.end(), [&written](auto& key) {
+                        return exists(written, key);
+                    }))
+                    continue;
+                m_groups[g].dirty = true;
+                again             = true;
+            }
+            for (auto& key : m_io[i].writes) written.insert(key);
+        }
+    }
+
+    for (usize i = 0; i < passes.size(); i++) {
+        auto g = m_pass_group[i];
+        if (g == no_group || m_groups[g].dirty)
+            passes[i]->markDirty();
+        else
+            passes[i]->markClean();
+    }
+    bool frame_changed = std::find(m_changed.begin(), m_changed.end(), true) != m_changed.end();
+    for (auto& group : m_groups) {
+        if (! group.dirty) continue;
+        group.valid   = true;
+        frame_changed = true;
+    }
+    return frame_changed;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "VulkanPass.hpp"
+#include "Core/Literals.hpp"
+#include "Core/MapSet.hpp"
+
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+// Skips cacheable passes on frames where nothing they depend on changed.
+// Passes sharing render targets form a group that runs as a whole or not at all. The group's
+// targets are kept out of image sharing, so a skipped group still holds its last output.
+class PassCache {
+public:
+    struct PassIO {
+        std::vector<std::string> reads;
+        std::vector<std::string> writes;
+    };
+
+    // passes and io in execution order
+    void build(std::span<VulkanPass* const>, std::vector<PassIO>);
+    void clear();
+    // targets content is lost, all groups run next frame
+    void invalidate();
+
+    // targets needing their own image, mark them in the texture cache before prepare
+    const Set<std::string>& persistTexs() const { return m_persist_texs; }
+
+    // runs updateValues() of every pass on jobs, then update() of each and markDirty or
+    // markClean each for this frame
+    // returns false when no pass changed and no group runs, the frame equals the last one
+    bool schedule(std::span<VulkanPass* const>);
+    // update() of the pass saw a change in the last schedule
+    bool changed(usize pass) const { return pass < m_changed.size() && m_changed[pass]; }
+
+private:
+    static constexpr usize no_group { std::numeric_limits<usize>::max() };
+
+    struct Group {
+        std::vector<usize> members;
+        bool               valid { false };
+        bool               dirty { true };
+    };
+
+    std::vector<PassIO> m_io;
+    std::vector<usize>  m_pass_group;
+    std::vector<Group>  m_groups;
+    std::vector<bool>   m_changed;
+    Set<std::string>    m_persist_texs;
+};
+
+} // namespace vulkan
+} // namespace wallpaper
@@ -48,7 +48,7 @@ inline TextureKey ToTexKey(wallpaper::SceneRenderTarget rt) {
         .width        = rt.width,
         .height       = rt.height,
         .usage        = {},
-        .format       = wallpaper::TextureFormat::RGBA8,
+        .format       = rt.format,
         .sample       = rt.sample,
         .mipmap_level = rt.mipmap_level,
     };
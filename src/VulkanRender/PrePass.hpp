@@ -32,6 +32,11 @@ public:
     void execute(const Device&, RenderingResources&) override;
     void destory(const Device&, RenderingResources&) override;
 
+    // clears the same way every frame
+    bool update() override { return false; }
+    // clears the default target
+    Use writeUse() const override { return Use::Transfer; }
+
 private:
     Desc m_desc;
 };
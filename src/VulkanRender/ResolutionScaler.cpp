@@ -0,0 +1,57 @@
+#include "ResolutionScaler.hpp"
+#include "Utils/Logging.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace wallpaper::vulkan;
+
+bool ResolutionScaler::setBudget(double ms) {
+    ms = std::max(ms, 0.0);
+    if (ms == m_budget) return false;
+    m_budget = ms;
+    m_sum    = 0.0;
+    m_count  = 0;
+    if (enabled() || m_scale == 1.0f) return false;
+    reset();
+    return true;
+}
+
+void ResolutionScaler::reset(float start) {
+    // on the steps, so stepping back up reaches native size
+    const float steps = std::round((1.0f - std::clamp(start, MinScale, 1.0f)) / Step);
+    m_scale = enabled() ? 1.0f - steps * Step : 1.0f;
+    m_sum   = 0.0;
+    m_count = 0;
+}
+
+bool ResolutionScaler::setCap(float cap) {
+    cap = std::clamp(cap, MinScale, 1.0f);
+    if (cap == m_cap) return false;
+    const float last = scale();
+    m_cap            = cap;
+    return scale() != last;
+}
+
+bool ResolutionScaler::frame(double gpu_ms) {
+    if (! enabled() || gpu_ms <= 0.0) return false;
+    m_sum += gpu_ms;
+    if (++m_count < Window) return false;
+    const double avg = m_sum / (double)m_count;
+    m_sum            = 0.0;
+    m_count          = 0;
+
+    float scale = m_scale;
+    if (avg > m_budget * HighMark) {
+        scale = std::max(m_scale - Step, MinScale);
+    } else if (m_scale < 1.0f) {
+        // as if all of the frame grew with the pixels, the step up must not land over again
+        const float  up   = std::min(m_scale + Step, 1.0f);
+        const double grow = (double)(up * up) / (double)(m_scale * m_scale);
+        if (avg * grow <= m_budget * HighMark) scale = up;
+    }
+    if (scale == m_scale) return false;
+    LOG_INFO("resolution scale %.3f, gpu %.2fms of %.2fms", scale, avg, m_budget);
+    m_scale = scale;
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "Core/Literals.hpp"
+
+#include <algorithm>
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+// Picks the scale of screen sized intermediate targets from the gpu time of profiled frames.
+// A window of frames over the budget steps it down, one with room for the next step up steps it
+// back. Every step makes the targets again, so it's taken on whole windows and fixed steps only.
+class ResolutionScaler {
+public:
+    constexpr static float  MinScale { 0.5f };
+    constexpr static float  Step { 0.125f };
+    constexpr static usize  Window { 30 };
+    constexpr static double HighMark { 0.95 };
+
+    // gpu milliseconds a frame may take, 0 turns scaling off
+    // true if the scale changed, off goes back to native size
+    bool setBudget(double ms);
+    bool enabled() const { return m_budget > 0.0; }
+
+    // a profiled frame, true if the scale changed
+    bool frame(double gpu_ms);
+    // native size, for a new graph, the cap stays
+    // with scaling on it starts at start instead, a scale an earlier run settled on
+    void reset(float start = 1.0f);
+    // the scale is at most this with scaling on or off, for memory, true if the scale changed
+    bool setCap(float);
+    float cap() const { return m_cap; }
+
+    float scale() const { return std::min(m_scale, m_cap); }
+
+private:
+    double m_budget { 0.0 };
+    float  m_scale { 1.0f };
+    float  m_cap { 1.0f };
+    double m_sum { 0.0 };
+    usize  m_count { 0 };
+};
+
+} // namespace vulkan
+} // namespace wallpaper
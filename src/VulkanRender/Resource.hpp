@@ -1,22 +1,80 @@
 #pragma once
 #include "Core/NoCopyMove.hpp"
+#include "Core/MapSet.hpp"
 #include "Vulkan/StagingBuffer.hpp"
+#include "Vulkan/UniformRing.hpp"
 #include <memory>
+#include <vector>
 
 namespace wallpaper
 {
+namespace looper
+{
+class JobGroup;
+}
+
 namespace vulkan
 {
 
+class ParticleCompute;
+class MipCompute;
+class AsyncCompute;
+class StaticGeometry;
+class BindlessTextures;
+class VideoTextures;
+
+// the uniforms every node shares, filled by the scene's updater once a frame and written to each
+// frame's ring region, passes bind it next to their own block
+struct SharedUniforms {
+    UniformRingRef       ref;
+    std::vector<uint8_t> data;
+};
+
+// puppet bone palettes in a storage ring, see WE_BONE_BLOCK. Every skinned pass has room for its
+// palette, the first one drawing a palette in a frame writes it there and passes drawing the same
+// one bind that copy.
+struct BonePalettes {
+    UniformRing* ring { nullptr };
+    // the frame being updated
+    usize frame { 0 };
+
+    struct Written {
+        UniformRingRef ref;
+        // differs from the last frame's palette at that address
+        bool changed { true };
+    };
+    // by the palette's data, cleared every frame
+    Map<const void*, Written> written;
+    // last content by the palette's data, tells whether a palette changed
+    Map<const void*, std::vector<uint8_t>> last;
+};
+
+// one set per frame in flight
 struct RenderingResources {
+    usize              index { 0 };
     vvk::CommandBuffer command;
 
     vvk::Semaphore sem_swap_wait_image;
-    vvk::Semaphore sem_swap_finish;
     vvk::Fence     fence_frame;
 
-    StagingBuffer* vertex_buf;
-    StagingBuffer* dyn_buf;
+    StagingBuffer*   vertex_buf;
+    StaticGeometry*  static_geometry { nullptr };
+    StagingBuffer*   dyn_buf;
+    UniformRing*     ubo_ring;
+    SharedUniforms*  shared_uniforms { nullptr };
+    BonePalettes*    bone_palettes { nullptr };
+    // null unless particles may be simulated on the gpu
+    ParticleCompute* particle_compute { nullptr };
+    // null if compute work is recorded with the graphics commands
+    AsyncCompute* async_compute { nullptr };
+    // null if render target mips are blitted
+    MipCompute* mip_compute { nullptr };
+    // null without descriptor indexing, each pass writes its textures to its own set then
+    BindlessTextures* bindless { nullptr };
+    // null unless video textures can be decoded and imported, they stay transparent then
+    VideoTextures* video { nullptr };
+    // pipelines of passes are made there, null makes them in prepare
+    looper::JobGroup* pipeline_jobs { nullptr };
 };
 } // namespace vulkan
 } // namespace wallpaper
@@ -6,6 +6,8 @@
 #include "Utils/Logging.h"
 #include "Core/MapSet.hpp"
 
+#include <algorithm>
+
 #include "VulkanRender/AllPasses.hpp"
 
 using namespace wallpaper;
@@ -64,11 +66,6 @@ static TexNode::Desc createTexDesc(std::string path) {
 }
 } // namespace wallpaper::rg
 
-static void TraverseNode(const std::function<void(SceneNode*)>& func, SceneNode* node) {
-    func(node);
-    for (auto& child : node->GetChildren()) TraverseNode(func, child.get());
-}
-
 static void CheckAndSetSprite(Scene& scene, vulkan::CustomShaderPass::Desc& desc,
                               std::span<const std::string> texs) {
     for (usize i = 0; i < texs.size(); i++) {
@@ -94,8 +91,40 @@ struct ExtraInfo {
     rg::RenderGraph*           rgraph { nullptr };
     Scene*                     scene { nullptr };
     bool                       use_mipmap_framebuffer { false };
+    bool                       occlude { true };
+    // layers hiding all drawn before them
+    usize occluders { 0 };
+    // targets drawn in ping-pong, the key holding what the target has now
+    Map<std::string, std::string> pingpong {};
 };
 
+static std::string_view Resolve(const ExtraInfo& extra, std::string_view key) {
+    auto iter = extra.pingpong.find(key);
+    return iter == extra.pingpong.end() ? key : std::string_view(iter->second);
+}
+
+static std::string PingPongOf(std::string_view key) { return std::string(key) + "_pingpong"; }
+
+// A pass sampling its own target reads a copy of it. When the pass drops what the target held,
+// the load op of such a blend, it reads the target and draws to the other of a pair instead.
+// Not for targets with mipmaps, copies make those.
+static bool CanPingPong(const Scene& scene, const SceneMaterial& material,
+                        std::string_view output) {
+    if (material.blenmode != BlendMode::Normal && material.blenmode != BlendMode::Disable)
+        return false;
+    if (std::none_of(material.textures.begin(), material.textures.end(), [output](auto& t) {
+            return t == output;
+        }))
+        return false;
+    auto rt = scene.renderTargets.find(std::string(output));
+    return rt != scene.renderTargets.end() && ! rt->second.has_mipmap;
+}
+
+// writes every pixel of the view, alpha doesn't matter with blending off
+static bool Occludes(const SceneMaterial& material) {
+    return material.covers_view && material.blenmode == BlendMode::Disable && ! material.discards;
+}
+
 static void ToGraphPass(SceneNode* node, std::string_view output, i32 imgId, ExtraInfo& extra) {
     auto& rgraph = *extra.rgraph;
     auto& scene  = *extra.scene;
@@ -112,8 +141,9 @@ static void ToGraphPass(SceneNode* node, std::string_view output, i32 imgId, Ext
                 if (cmdItor != cmdEnd && nodePos == cmdItor->afterpos) {
                     // both copy and swap use copy pass;
                     // true swap would need temp FBO support in render graph
-                    rg::addCopyPass(
-                        rgraph, rg::createTexDesc(cmdItor->src), rg::createTexDesc(cmdItor->dst));
+                    rg::addCopyPass(rgraph,
+                                    rg::createTexDesc(std::string(Resolve(extra, cmdItor->src))),
+                                    rg::createTexDesc(std::string(Resolve(extra, cmdItor->dst))));
                     cmdItor++;
                 }
                 auto& name = n.output;
@@ -146,8 +176,16 @@ static void ToGraphPass(SceneNode* node, std::string_view output, i32 imgId, Ext
         [material, node, &output, &imgId, &rgraph, &scene, &extra](
             rg::RenderGraphBuilder& builder, vulkan::CustomShaderPass::Desc& pdesc) {
             const auto& pass = builder.workPassNode();
-            pdesc.node       = node;
-            pdesc.output     = output;
+            // the key drawn to, the other of the pair when ping-ponging
+            std::string target { Resolve(extra, output) };
+            const bool  pingpong = CanPingPong(scene, *material, output);
+            if (pingpong) target = target == output ? PingPongOf(output) : std::string(output);
+
+            pdesc.node   = node;
+            pdesc.output = target;
+            if (auto rate = scene.layerRates.find(imgId); rate != scene.layerRates.end())
+                pdesc.update_rate = rate->second;
+            pdesc.time_rate = scene.timeLayerRate;
             CheckAndSetSprite(scene, pdesc, material->textures);
             for (usize i = 0; i < material->textures.size(); i++) {
                 const auto&  url = material->textures[i];
@@ -163,8 +201,8 @@ static void ToGraphPass(SceneNode* node, std::string_view output, i32 imgId, Ext
                     continue;
                 } else {
                     rg::TexNode::Desc desc;
-                    desc.key  = url;
-                    desc.name = url;
+                    desc.key  = IsSpecTex(url) ? Resolve(extra, url) : url;
+                    desc.name = desc.key;
                     desc.type = ! IsSpecTex(url) ? rg::TexNode::TexType::Imported
                                                  : rg::TexNode::TexType::Temp;
                     input     = builder.createTexNode(desc);
@@ -173,7 +211,7 @@ static void ToGraphPass(SceneNode* node, std::string_view output, i32 imgId, Ext
                         extra.use_mipmap_framebuffer = true;
                 }
 
-                if (url == output) {
+                if (url == output && ! pingpong) {
                     builder.markSelfWrite(input);
                     input = rg::addCopyPass(rgraph, input);
                 }
@@ -183,11 +221,26 @@ static void ToGraphPass(SceneNode* node, std::string_view output, i32 imgId, Ext
 
             rg::TexNode* output_node { nullptr };
             output_node =
-                builder.createTexNode(rg::TexNode::Desc { .name = output.data(),
-                                                          .key  = output.data(),
+                builder.createTexNode(rg::TexNode::Desc { .name = target,
+                                                          .key  = target,
                                                           .type = rg::TexNode::TexType::Temp },
                                       true);
             builder.write(output_node);
+            // what's beneath is culled unless the pass or a link reads it
+            if (extra.occlude && output_node->version() > 0 && Occludes(*material)) {
+                output_node->setCoversPreVer(true);
+                extra.occluders++;
+            }
+            if (pingpong) {
+                auto other = PingPongOf(output);
+                if (scene.renderTargets.count(other) == 0) {
+                    // bound like the target, sized with it
+                    auto& rt      = scene.renderTargets[other];
+                    rt            = scene.renderTargets.at(std::string(output));
+                    rt.allowReuse = true;
+                }
+                extra.pingpong[std::string(output)] = target;
+            }
             if (output == SpecTex_Default) {
                 extra.id_link_map[(usize)imgId] = output_node;
             }
@@ -197,14 +250,14 @@ static void ToGraphPass(SceneNode* node, std::string_view output, i32 imgId, Ext
     if (imgeff != nullptr) loadEffect(imgeff);
 }
 
-std::unique_ptr<rg::RenderGraph> wallpaper::sceneToRenderGraph(Scene& scene) {
+std::unique_ptr<rg::RenderGraph> wallpaper::sceneToRenderGraph(Scene& scene, bool occlude) {
     std::unique_ptr<rg::RenderGraph> rgraph = std::make_unique<rg::RenderGraph>();
-    ExtraInfo                        extra { .rgraph = rgraph.get(), .scene = &scene };
-    TraverseNode(
-        [&extra](SceneNode* node) {
-            ToGraphPass(node, SpecTex_Default, node->ID(), extra);
-        },
-        scene.sceneGraph.get());
+    ExtraInfo extra { .rgraph = rgraph.get(), .scene = &scene, .occlude = occlude };
+    // depth first, as the layers are drawn
+    if (! scene.nodeTable.Built()) scene.nodeTable.Build(*scene.sceneGraph);
+    for (auto* node : scene.nodeTable.Nodes()) {
+        ToGraphPass(node, SpecTex_Default, node->ID(), extra);
+    }
 
     for (auto& info : extra.link_info) {
         if (! exists(extra.id_link_map, info.link_id)) {
@@ -227,6 +280,19 @@ std::unique_ptr<rg::RenderGraph> wallpaper::sceneToRenderGraph(Scene& scene) {
             });
     }
 
+    // what's read after the graph, or next frame before it's drawn, goes back to its own key
+    for (auto& [key, held] : extra.pingpong) {
+        if (held == key) continue;
+        auto* first = rgraph->findTexNode(key);
+        while (first != nullptr && first->preVer() != nullptr) first = first->preVer();
+        bool kept = key == SpecTex_Default ||
+                    (first != nullptr && first->writer() != nullptr &&
+                     first->writer()->type() == rg::PassNode::Type::Virtual);
+        if (! kept) continue;
+        auto desc = rg::createTexDesc(key);
+        rg::addCopyPass(*rgraph, rgraph->findTexNode(held), &desc);
+    }
+
     if (extra.use_mipmap_framebuffer) {
         rg::addCopyPass(*rgraph,
                         rg::TexNode::Desc { .name = SpecTex_Default.data(),
@@ -237,5 +303,15 @@ std::unique_ptr<rg::RenderGraph> wallpaper::sceneToRenderGraph(Scene& scene) {
                                             .type = rg::TexNode::TexType::Temp });
     }
 
+    // finpass presents the default target, layers and effects it doesn't draw from are dropped
+    {
+        std::string_view outputs[] { SpecTex_Default };
+        usize            culled = rgraph->cull(outputs);
+        if (culled > 0) LOG_INFO("culled %d passes not reaching the screen", (int)culled);
+        if (extra.occluders > 0)
+            LOG_INFO("%d layers cover the view, what's beneath them is culled",
+                     (int)extra.occluders);
+    }
+
     return rgraph;
 }
@@ -0,0 +1,139 @@
+#include "SecondaryRecorder.hpp"
+#include "Resource.hpp"
+#include "Utils/Logging.h"
+
+#include <algorithm>
+
+using namespace wallpaper::vulkan;
+
+namespace
+{
+constexpr usize max_workers { 4 };
+// below this recording inline is faster than waking the workers
+constexpr usize min_parallel_passes { 32 };
+constexpr usize cmd_batch_size { 16 };
+} // namespace
+
+SecondaryRecorder::~SecondaryRecorder() { destroy(); }
+
+bool SecondaryRecorder::init(const Device& device, usize frame_num) {
+    destroy();
+
+    // leave cores for the looper threads and the driver
+    m_worker_num = std::clamp<usize>(std::thread::hardware_concurrency() / 2, 1, max_workers);
+
+    m_slots.resize(frame_num);
+    for (auto& slots : m_slots) {
+        slots.resize(m_worker_num);
+        for (auto& slot : slots) {
+            VkCommandPoolCreateInfo info { .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                                           .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                                           .queueFamilyIndex =
+                                               device.graphics_queue().family_index };
+            VVK_CHECK_BOOL_RE(device.handle().CreateCommandPool(info, slot.pool));
+        }
+    }
+
+    m_stop = false;
+    for (usize i = 1; i < m_worker_num; i++) {
+        m_threads.emplace_back(&SecondaryRecorder::loop, this, i);
+    }
+    LOG_INFO("command recording workers: %d", m_worker_num);
+    return true;
+}
+
+void SecondaryRecorder::destroy() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond_start.notify_all();
+    for (auto& t : m_threads) t.join();
+    m_threads.clear();
+    m_slots.clear();
+    m_jobs.clear();
+}
+
+void SecondaryRecorder::record(const Device& device, RenderingResources& rr,
+                               std::span<VulkanPass* const> passes) {
+    m_jobs.clear();
+    for (auto* p : passes) {
+        if (p->prepared() && p->needsExecute() && p->canRecordSecondary()) m_jobs.push_back(p);
+    }
+    if (m_threads.empty() || m_jobs.size() < min_parallel_passes) {
+        m_jobs.clear();
+        return;
+    }
+
+    // the frame's fence signaled, nothing from these pools is pending
+    for (auto& slot : m_slots[rr.index]) {
+        VVK_CHECK(slot.pool.Reset());
+        slot.used = 0;
+    }
+    {
+        std::lock_guard lock(m_mutex);
+        m_device  = &device;
+        m_rr      = &rr;
+        m_pending = m_threads.size();
+        m_generation++;
+    }
+    m_cond_start.notify_all();
+
+    work(0);
+
+    std::unique_lock lock(m_mutex);
+    m_cond_done.wait(lock, [this]() {
+        return m_pending == 0;
+    });
+}
+
+VkCommandBuffer SecondaryRecorder::acquire(Slot& slot) {
+    usize i = slot.used;
+    for (auto& batch : slot.batches) {
+        if (i < batch.size()) {
+            slot.used++;
+            return batch[i];
+        }
+        i -= batch.size();
+    }
+    vvk::CommandBuffers batch;
+    VVK_CHECK_ACT(return VK_NULL_HANDLE,
+                  slot.pool.Allocate(cmd_batch_size, VK_COMMAND_BUFFER_LEVEL_SECONDARY, batch));
+    slot.batches.push_back(std::move(batch));
+    slot.used++;
+    return slot.batches.back()[0];
+}
+
+void SecondaryRecorder::work(usize worker) {
+    // contiguous ranges, neighbouring passes tend to share pipelines and textures
+    usize first = m_jobs.size() * worker / m_worker_num;
+    usize last  = m_jobs.size() * (worker + 1) / m_worker_num;
+    auto& slot  = m_slots[m_rr->index][worker];
+
+    for (usize i = first; i < last; i++) {
+        VkCommandBuffer handle = acquire(slot);
+        // left to inline recording in execute()
+        if (handle == VK_NULL_HANDLE) continue;
+        vvk::CommandBuffer cmd(handle, m_device->handle().Dispatch());
+        (void)m_jobs[i]->recordSecondary(*m_device, *m_rr, cmd);
+    }
+}
+
+void SecondaryRecorder::loop(usize worker) {
+    u64 seen = 0;
+    while (true) {
+        {
+            std::unique_lock lock(m_mutex);
+            m_cond_start.wait(lock, [this, seen]() {
+                return m_stop || m_generation != seen;
+            });
+            if (m_stop) return;
+            seen = m_generation;
+        }
+        work(worker);
+        {
+            std::lock_guard lock(m_mutex);
+            if (--m_pending == 0) m_cond_done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "VulkanPass.hpp"
+#include "Vulkan/Device.hpp"
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+// Records pass draw commands into secondary buffers on worker threads.
+// Each worker owns a command pool per frame in flight, so pools are reset without locking once
+// the frame's fence signaled. The primary buffer still begins every render pass in graph order
+// and replays the secondaries there, which keeps barriers and pass order untouched.
+class SecondaryRecorder : NoCopy, NoMove {
+public:
+    SecondaryRecorder() = default;
+    ~SecondaryRecorder();
+
+    bool init(const Device&, usize frame_num);
+    void destroy();
+
+    // records every pass about to execute that supports it, blocks until done
+    // small frames are left to inline recording, threads cost more than they save there
+    void record(const Device&, RenderingResources&, std::span<VulkanPass* const>);
+
+private:
+    struct Slot {
+        vvk::CommandPool                 pool;
+        std::vector<vvk::CommandBuffers> batches;
+        usize                            used { 0 };
+    };
+
+    VkCommandBuffer acquire(Slot&);
+    void            work(usize worker);
+    void            loop(usize worker);
+
+    usize m_worker_num { 1 };
+    // [frame][worker]
+    std::vector<std::vector<Slot>> m_slots;
+
+    std::vector<std::thread> m_threads;
+    std::mutex               m_mutex;
+    std::condition_variable  m_cond_start;
+    std::condition_variable  m_cond_done;
+    u64                      m_generation { 0 };
+    usize                    m_pending { 0 };
+    bool                     m_stop { false };
+
+    // current frame, only written while workers are idle
+    const Device*            m_device { nullptr };
+    RenderingResources*      m_rr { nullptr };
+    std::vector<VulkanPass*> m_jobs;
+};
+
+} // namespace vulkan
+} // namespace wallpaper
@@ -0,0 +1,50 @@
+#include "StaticGeometry.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <string_view>
+
+using namespace wallpaper::vulkan;
+
+bool StaticGeometry::acquire(std::span<const uint8_t> data, StagingBufferRef& ref) {
+    const std::size_t hash =
+        std::hash<std::string_view>()({ (const char*)data.data(), data.size() });
+    if (auto it = m_by_hash.find(hash); it != m_by_hash.end()) {
+        auto& entry = m_by_offset.at(it->second);
+        auto  bytes = m_buf.bufData(entry.ref);
+        if (std::equal(bytes.begin(), bytes.end(), data.begin(), data.end())) {
+            entry.users++;
+            m_shared++;
+            ref = entry.ref;
+            return true;
+        }
+    }
+
+    if (! m_buf.allocateSubRef(data.size(), ref)) return false;
+    if (! m_buf.writeToBuf(ref, { (uint8_t*)data.data(), data.size() })) {
+        m_buf.unallocateSubRef(ref);
+        ref = {};
+        return false;
+    }
+    // taken hashes are left to their first bytes
+    const bool owns = m_by_hash.try_emplace(hash, ref.offset).second;
+    m_by_offset[ref.offset] = Entry { .ref = ref, .hash = owns ? hash : 0, .users = 1 };
+    return true;
+}
+
+void StaticGeometry::release(const StagingBufferRef& ref) {
+    if (! ref) return;
+    auto it = m_by_offset.find(ref.offset);
+    if (it == m_by_offset.end()) return;
+    if (--it->second.users > 0) return;
+    if (auto h = m_by_hash.find(it->second.hash); h != m_by_hash.end() && h->second == ref.offset)
+        m_by_hash.erase(h);
+    m_buf.unallocateSubRef(it->second.ref);
+    m_by_offset.erase(it);
+}
+
+void StaticGeometry::clear() {
+    m_by_hash.clear();
+    m_by_offset.clear();
+    m_shared = 0;
+}
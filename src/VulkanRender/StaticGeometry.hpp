@@ -0,0 +1,46 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/MapSet.hpp"
+#include "Core/NoCopyMove.hpp"
+#include "Vulkan/StagingBuffer.hpp"
+
+#include <span>
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+// Static vertex and index data of the passes in one buffer, by content. Image cards of one size
+// and the effect passes drawing the default effect mesh get the same quad, so they share one
+// copy at one offset instead of each uploading its own.
+class StaticGeometry : NoCopy, NoMove {
+public:
+    explicit StaticGeometry(StagingBuffer& buf): m_buf(buf) {}
+
+    // a ref to data in the buffer, one already there with the same bytes is shared
+    bool acquire(std::span<const uint8_t> data, StagingBufferRef&);
+    // the last user of a shared copy frees it
+    void release(const StagingBufferRef&);
+    // the buffer was made again, every ref is gone
+    void clear();
+
+    // acquires served by a copy already there, since the last clear
+    usize shared() const { return m_shared; }
+
+private:
+    struct Entry {
+        StagingBufferRef ref;
+        std::size_t      hash { 0 };
+        u32              users { 0 };
+    };
+
+    StagingBuffer& m_buf;
+    // by the hash of the bytes, a hash held by other bytes gets a copy of its own outside of it
+    Map<std::size_t, VkDeviceSize> m_by_hash;
+    Map<VkDeviceSize, Entry>       m_by_offset;
+    usize                          m_shared { 0 };
+};
+
+} // namespace vulkan
+} // namespace wallpaper
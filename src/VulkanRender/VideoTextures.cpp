@@ -0,0 +1,593 @@
+#include "VideoTextures.hpp"
+#include "Vulkan/Shader.hpp"
+#include "Vulkan/TextureCache.hpp"
+#include "Utils/Logging.h"
+#include "Image.hpp"
+
+#include <algorithm>
+#include <unistd.h>
+
+using namespace wallpaper::vulkan;
+
+namespace
+{
+using wallpaper::video::DmaBufFrame;
+
+// limited range is expanded before the matrix, chroma is upsampled by the sampler
+constexpr std::string_view comp_code = R"(#version 450
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler2D u_luma;
+layout(binding = 1) uniform sampler2D u_chroma;
+layout(binding = 2, rgba8) uniform writeonly image2D u_out;
+
+layout(push_constant) uniform Push {
+    ivec2 u_size;
+    uint  u_bt709;
+    uint  u_full;
+};
+
+void main() {
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(p, u_size))) return;
+
+    float y  = texelFetch(u_luma, min(p, textureSize(u_luma, 0) - 1), 0).r;
+    vec2  uv = texture(u_chroma, (vec2(p) + 0.5) / vec2(u_size)).rg;
+    if (u_full == 0u) {
+        y  = (y - 16.0 / 255.0) * (255.0 / 219.0);
+        uv = (uv - 16.0 / 255.0) * (255.0 / 224.0);
+    }
+    uv -= 0.5;
+    vec3 rgb = u_bt709 != 0u
+                   ? vec3(y + 1.5748 * uv.y, y - 0.1873 * uv.x - 0.4681 * uv.y, y + 1.8556 * uv.x)
+                   : vec3(y + 1.402 * uv.y, y - 0.3441 * uv.x - 0.7141 * uv.y, y + 1.772 * uv.x);
+    imageStore(u_out, p, vec4(clamp(rgb, 0.0, 1.0), 1.0));
+}
+)";
+
+constexpr u32 group_size { 8 };
+
+struct Push {
+    i32 width;
+    i32 height;
+    u32 bt709;
+    u32 full;
+};
+static_assert(sizeof(Push) == 16);
+
+constexpr u32 Fourcc(char a, char b, char c, char d) {
+    return (u32)a | ((u32)b << 8) | ((u32)c << 16) | ((u32)d << 24);
+}
+
+// the layers va-api exports of nv12 and p010
+VkFormat ToVkFormat(u32 drm_format) {
+    switch (drm_format) {
+    case Fourcc('R', '8', ' ', ' '): return VK_FORMAT_R8_UNORM;
+    case Fourcc('G', 'R', '8', '8'): return VK_FORMAT_R8G8_UNORM;
+    case Fourcc('R', '1', '6', ' '): return VK_FORMAT_R16_UNORM;
+    case Fourcc('G', 'R', '3', '2'): return VK_FORMAT_R16G16_UNORM;
+    default: return VK_FORMAT_UNDEFINED;
+    }
+}
+
+constexpr VkImageSubresourceRange color_range {
+    .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+    .baseMipLevel   = 0,
+    .levelCount     = 1,
+    .baseArrayLayer = 0,
+    .layerCount     = 1,
+};
+
+VkImageMemoryBarrier Barrier(VkImage image, VkAccessFlags src, VkAccessFlags dst,
+                             VkImageLayout from, VkImageLayout to,
+                             u32 src_family = VK_QUEUE_FAMILY_IGNORED,
+                             u32 dst_family = VK_QUEUE_FAMILY_IGNORED) {
+    return VkImageMemoryBarrier {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext               = nullptr,
+        .srcAccessMask       = src,
+        .dstAccessMask       = dst,
+        .oldLayout           = from,
+        .newLayout           = to,
+        .srcQueueFamilyIndex = src_family,
+        .dstQueueFamilyIndex = dst_family,
+        .image               = image,
+        .subresourceRange    = color_range,
+    };
+}
+} // namespace
+
+VideoTextures::VideoTextures()  = default;
+VideoTextures::~VideoTextures() = default;
+
+bool VideoTextures::init(const Device& device, usize frame_num) {
+    m_frame_num       = std::max<usize>(frame_num, 1);
+    m_graphics_family = device.graphics_queue().family_index;
+    m_imports.resize(m_frame_num);
+
+    std::vector<Uni_ShaderSpv> spvs;
+    {
+        ShaderCompOpt opt;
+        opt.client_ver             = glslang::EShTargetVulkan_1_1;
+        opt.suppress_warnings_glsl = true;
+
+        std::array<ShaderCompUnit, 1> units;
+        units[0] = ShaderCompUnit { .stage = EShLangCompute, .src = std::string(comp_code) };
+        if (! CompileAndLinkShaderUnits(units, opt, spvs) || spvs.empty()) {
+            LOG_ERROR("compile video conversion shader failed");
+            return false;
+        }
+    }
+
+    {
+        auto sampled = [](u32 binding) {
+            return VkDescriptorSetLayoutBinding {
+                .binding         = binding,
+                .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 1,
+                .stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT,
+            };
+        };
+        std::array bindings {
+            sampled(0),
+            sampled(1),
+            VkDescriptorSetLayoutBinding {
+                .binding         = 2,
+                .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT,
+            },
+        };
+        VkDescriptorSetLayoutCreateInfo ci {
+            .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext        = nullptr,
+            .flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+            .bindingCount = (u32)bindings.size(),
+            .pBindings    = bindings.data(),
+        };
+        vvk::DescriptorSetLayout layout;
+        VVK_CHECK_BOOL_RE(device.handle().CreateDescriptorSetLayout(ci, layout));
+        m_pipeline.descriptor_layouts.emplace_back(std::move(layout));
+    }
+    {
+        VkDescriptorSetLayout layout = *m_pipeline.descriptor_layouts.front();
+        VkPushConstantRange   range {
+              .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+              .offset     = 0,
+              .size       = sizeof(Push),
+        };
+        VkPipelineLayoutCreateInfo ci {
+            .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext                  = nullptr,
+            .setLayoutCount         = 1,
+            .pSetLayouts            = &layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges    = &range,
+        };
+        VVK_CHECK_BOOL_RE(device.handle().CreatePipelineLayout(ci, m_pipeline.layout));
+    }
+    {
+        auto&                    code = spvs.front()->spirv;
+        VkShaderModuleCreateInfo ci {
+            .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .pNext    = nullptr,
+            .codeSize = code.size() * sizeof(decltype(code.back())),
+            .pCode    = code.data(),
+        };
+        vvk::ShaderModule module;
+        VVK_CHECK_BOOL_RE(device.handle().CreateShaderModule(ci, module));
+
+        VkComputePipelineCreateInfo pci {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = nullptr,
+            .stage =
+                VkPipelineShaderStageCreateInfo {
+                    .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .pNext  = nullptr,
+                    .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = *module,
+                    .pName  = spvs.front()->entry_point.c_str(),
+                },
+            .layout = *m_pipeline.layout,
+        };
+        VVK_CHECK_BOOL_RE(device.handle().CreateComputePipeline(
+            pci, m_pipeline.handle, *device.pipeline_cache()));
+    }
+    {
+        VkSamplerCreateInfo ci {
+            .sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .pNext                   = nullptr,
+            .magFilter               = VK_FILTER_LINEAR,
+            .minFilter               = VK_FILTER_LINEAR,
+            .mipmapMode              = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            .addressModeU            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeV            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeW            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .anisotropyEnable        = false,
+            .maxAnisotropy           = 1.0f,
+            .compareEnable           = false,
+            .compareOp               = VK_COMPARE_OP_NEVER,
+            .minLod                  = 0.0f,
+            .maxLod                  = 0.0f,
+            .borderColor             = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+            .unnormalizedCoordinates = false,
+        };
+        VVK_CHECK_BOOL_RE(device.handle().CreateSampler(ci, m_plane_sampler));
+    }
+    LOG_INFO("video textures decoded with va-api and imported as dma-bufs");
+    return true;
+}
+
+void VideoTextures::destroy() {
+    clear();
+    m_plane_sampler = {};
+    m_pipeline      = {};
+}
+
+void VideoTextures::clear() {
+    for (auto& imports : m_imports) imports.clear();
+    // decoders join their threads, the frames they handed out are dropped before
+    m_clips.clear();
+    m_import_failed = false;
+}
+
+std::optional<ImageSlotsRef> VideoTextures::add(const Device& device, const Image& image,
+                                                usize& clip) {
+    if (! m_pipeline.handle || ! image.video) return std::nullopt;
+    auto it = std::find_if(m_clips.begin(), m_clips.end(), [&image](const Clip& c) {
+        return c.key == image.key;
+    });
+    if (it == m_clips.end()) {
+        auto decoder = video::CreateVideoDecoder(image.video);
+        if (! decoder || decoder->width() == 0 || decoder->height() == 0) return std::nullopt;
+
+        Clip c;
+        c.key     = image.key;
+        auto& out = c.image;
+        out.extent       = VkExtent3D { decoder->width(), decoder->height(), 1 };
+        out.mipmap_level = 1;
+        out.usage        = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        VkImageCreateInfo ci {
+            .sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext         = nullptr,
+            .imageType     = VK_IMAGE_TYPE_2D,
+            .format        = VK_FORMAT_R8G8B8A8_UNORM,
+            .extent        = out.extent,
+            .mipLevels     = 1,
+            .arrayLayers   = 1,
+            .samples       = VK_SAMPLE_COUNT_1_BIT,
+            .tiling        = VK_IMAGE_TILING_OPTIMAL,
+            .usage         = out.usage,
+            .sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        VmaAllocationCreateInfo vma_info {};
+        vma_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        VVK_CHECK_ACT(return std::nullopt,
+                      vvk::CreateImage(device.vma_allocator(), ci, vma_info, out.handle));
+        VkImageViewCreateInfo view_ci {
+            .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .pNext            = nullptr,
+            .image            = *out.handle,
+            .viewType         = VK_IMAGE_VIEW_TYPE_2D,
+            .format           = ci.format,
+            .subresourceRange = color_range,
+        };
+        VVK_CHECK_ACT(return std::nullopt, device.handle().CreateImageView(view_ci, out.view));
+
+        const auto&         sample = image.header.sample;
+        VkSamplerCreateInfo sampler_ci {
+            .sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .pNext                   = nullptr,
+            .magFilter               = ToVkType(sample.magFilter),
+            .minFilter               = ToVkType(sample.minFilter),
+            .mipmapMode              = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            .addressModeU            = ToVkType(sample.wrapS),
+            .addressModeV            = ToVkType(sample.wrapT),
+            .addressModeW            = ToVkType(sample.wrapT),
+            .anisotropyEnable        = false,
+            .maxAnisotropy           = 1.0f,
+            .compareEnable           = false,
+            .compareOp               = VK_COMPARE_OP_NEVER,
+            .minLod                  = 0.0f,
+            .maxLod                  = 0.0f,
+            .borderColor             = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
+            .unnormalizedCoordinates = false,
+        };
+        VVK_CHECK_ACT(return std::nullopt, device.handle().CreateSampler(sampler_ci, c.sampler));
+        out.sampler = *c.sampler;
+        c.decoder   = std::move(decoder);
+
+        m_clips.push_back(std::move(c));
+        it = m_clips.end() - 1;
+    }
+    clip = (usize)(it - m_clips.begin());
+
+    ImageSlotsRef slots;
+    slots.slots = { ImageParameters(it->image) };
+    return slots;
+}
+
+void VideoTextures::beginFrame(usize frame) {
+    if (! m_imports.empty()) m_imports[frame % m_frame_num].clear();
+}
+
+bool VideoTextures::pick(double time) {
+    bool changed { false };
+    for (auto& clip : m_clips) {
+        auto frame = clip.decoder->frameAt(time);
+        if (! frame || frame == clip.shown || frame == clip.next) continue;
+        clip.next = std::move(frame);
+        clip.serial++;
+        changed = true;
+    }
+    return changed;
+}
+
+void VideoTextures::record(const Device& device, const vvk::CommandBuffer& cmd, usize frame) {
+    auto& imports = m_imports[frame % m_frame_num];
+    for (auto& clip : m_clips) {
+        if (clip.next) {
+            Import in;
+            if (importFrame(device, *clip.next, in)) {
+                draw(cmd, clip, in);
+                clip.shown = std::move(clip.next);
+                clip.ready = true;
+                in.frame   = clip.shown;
+                imports.push_back(std::move(in));
+                continue;
+            }
+            if (! m_import_failed) LOG_ERROR("video frame can't be imported, not drawn");
+            m_import_failed = true;
+            clip.next.reset();
+        }
+        if (clip.ready) continue;
+        // nothing decoded yet, nothing else was drawn to it
+        VkImage image = *clip.image.handle;
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            0,
+                            Barrier(image,
+                                    {},
+                                    VK_ACCESS_TRANSFER_WRITE_BIT,
+                                    VK_IMAGE_LAYOUT_UNDEFINED,
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+        VkClearColorValue transparent {};
+        cmd.ClearColorImage(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &transparent, color_range);
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                            0,
+                            Barrier(image,
+                                    VK_ACCESS_TRANSFER_WRITE_BIT,
+                                    VK_ACCESS_SHADER_READ_BIT,
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+        clip.ready = true;
+    }
+}
+
+u64 VideoTextures::serial(usize clip) const {
+    return clip < m_clips.size() ? m_clips[clip].serial : 0;
+}
+
+bool VideoTextures::importFrame(const Device& device, const DmaBufFrame& frame,
+                                Import& out) const {
+    const auto& dev = device.handle();
+    const auto  mem_props = device.gpu().GetMemoryProperties().memoryProperties;
+    for (usize i = 0; i < out.planes.size(); i++) {
+        const auto&    src    = frame.planes[i];
+        auto&          plane  = out.planes[i];
+        const VkFormat format = ToVkFormat(src.drm_format);
+        if (format == VK_FORMAT_UNDEFINED || src.fd < 0) return false;
+        // chroma is subsampled in both directions
+        const u32 w = i == 0 ? frame.width : (frame.width + 1) / 2;
+        const u32 h = i == 0 ? frame.height : (frame.height + 1) / 2;
+
+        VkSubresourceLayout layout {
+            .offset     = src.offset,
+            .size       = 0,
+            .rowPitch   = src.pitch,
+            .arrayPitch = 0,
+            .depthPitch = 0,
+        };
+        VkImageDrmFormatModifierExplicitCreateInfoEXT mod_info {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_EXPLICIT_CREATE_INFO_EXT,
+            .pNext = nullptr,
+            .drmFormatModifier           = src.modifier,
+            .drmFormatModifierPlaneCount = 1,
+            .pPlaneLayouts               = &layout,
+        };
+        VkExternalMemoryImageCreateInfo ex_info {
+            .sType       = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+            .pNext       = &mod_info,
+            .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT,
+        };
+        VkImageCreateInfo ci {
+            .sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext         = &ex_info,
+            .imageType     = VK_IMAGE_TYPE_2D,
+            .format        = format,
+            .extent        = VkExtent3D { w, h, 1 },
+            .mipLevels     = 1,
+            .arrayLayers   = 1,
+            .samples       = VK_SAMPLE_COUNT_1_BIT,
+            .tiling        = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT,
+            .usage         = VK_IMAGE_USAGE_SAMPLED_BIT,
+            .sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        VVK_CHECK_ACT(return false, dev.CreateImage(ci, plane.image));
+
+        // the decoder keeps its fd, the imported memory owns a dup of it
+        VkMemoryFdPropertiesKHR fd_props {};
+        VVK_CHECK_ACT(return false,
+                      dev.GetMemoryFdPropertiesKHR(
+                          VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT, src.fd, fd_props));
+        const auto reqs  = dev.GetImageMemoryRequirements(*plane.image);
+        const u32  types = reqs.memoryTypeBits & fd_props.memoryTypeBits;
+        u32        type  = 0;
+        while (type < mem_props.memoryTypeCount && ! (types & (1u << type))) type++;
+        if (type == mem_props.memoryTypeCount) return false;
+
+        int fd = dup(src.fd);
+        if (fd < 0) return false;
+        VkMemoryDedicatedAllocateInfo dedicated {
+            .sType  = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+            .pNext  = nullptr,
+            .image  = *plane.image,
+            .buffer = VK_NULL_HANDLE,
+        };
+        VkImportMemoryFdInfoKHR fd_info {
+            .sType      = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,
+            .pNext      = &dedicated,
+            .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT,
+            .fd         = fd,
+        };
+        VkMemoryAllocateInfo ai {
+            .sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .pNext           = &fd_info,
+            .allocationSize  = std::max<VkDeviceSize>(reqs.size, src.object_size),
+            .memoryTypeIndex = type,
+        };
+        // on success the fd belongs to the memory
+        if (VkResult res = dev.AllocateMemory(ai, plane.mem); res != VK_SUCCESS) {
+            close(fd);
+            VVK_CHECK(res);
+            return false;
+        }
+        VVK_CHECK_ACT(return false, plane.image.BindMemory(*plane.mem, 0));
+
+        VkImageViewCreateInfo view_ci {
+            .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .pNext            = nullptr,
+            .image            = *plane.image,
+            .viewType         = VK_IMAGE_VIEW_TYPE_2D,
+            .format           = format,
+            .subresourceRange = color_range,
+        };
+        VVK_CHECK_ACT(return false, dev.CreateImageView(view_ci, plane.view));
+    }
+    return true;
+}
+
+void VideoTextures::draw(const vvk::CommandBuffer& cmd, Clip& clip, Import& in) const {
+    VkImage out = *clip.image.handle;
+    // the planes come from the decoder's queue, the image was last sampled by an earlier frame
+    {
+        std::array bars {
+            Barrier(*in.planes[0].image,
+                    {},
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_QUEUE_FAMILY_FOREIGN_EXT,
+                    m_graphics_family),
+            Barrier(*in.planes[1].image,
+                    {},
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_QUEUE_FAMILY_FOREIGN_EXT,
+                    m_graphics_family),
+            Barrier(out,
+                    {},
+                    VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED,
+                    VK_IMAGE_LAYOUT_GENERAL),
+        };
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT |
+                                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            0,
+                            {},
+                            {},
+                            bars);
+    }
+
+    cmd.BindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, *m_pipeline.handle);
+    {
+        std::array infos {
+            VkDescriptorImageInfo {
+                .sampler     = *m_plane_sampler,
+                .imageView   = *in.planes[0].view,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            },
+            VkDescriptorImageInfo {
+                .sampler     = *m_plane_sampler,
+                .imageView   = *in.planes[1].view,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            },
+            VkDescriptorImageInfo {
+                .sampler     = VK_NULL_HANDLE,
+                .imageView   = *clip.image.view,
+                .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+            },
+        };
+        auto write = [&infos](u32 binding, VkDescriptorType type) {
+            return VkWriteDescriptorSet {
+                .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext           = nullptr,
+                .dstSet          = VK_NULL_HANDLE,
+                .dstBinding      = binding,
+                .descriptorCount = 1,
+                .descriptorType  = type,
+                .pImageInfo      = &infos[binding],
+            };
+        };
+        std::array wsets {
+            write(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+            write(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+            write(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE),
+        };
+        cmd.PushDescriptorSetKHR(VK_PIPELINE_BIND_POINT_COMPUTE, *m_pipeline.layout, 0, wsets);
+    }
+    const auto& frame  = *clip.next;
+    const auto& extent = clip.image.extent;
+    cmd.PushConstants(*m_pipeline.layout,
+                      VK_SHADER_STAGE_COMPUTE_BIT,
+                      Push {
+                          .width  = (i32)extent.width,
+                          .height = (i32)extent.height,
+                          .bt709  = frame.bt709 ? 1u : 0u,
+                          .full   = frame.full_range ? 1u : 0u,
+                      });
+    cmd.Dispatch((extent.width + group_size - 1) / group_size,
+                 (extent.height + group_size - 1) / group_size,
+                 1);
+
+    {
+        // the planes go back to the decoder, which writes the surfaces again
+        std::array bars {
+            Barrier(*in.planes[0].image,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    {},
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    m_graphics_family,
+                    VK_QUEUE_FAMILY_FOREIGN_EXT),
+            Barrier(*in.planes[1].image,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    {},
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    m_graphics_family,
+                    VK_QUEUE_FAMILY_FOREIGN_EXT),
+            Barrier(out,
+                    VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+        };
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                            0,
+                            {},
+                            {},
+                            bars);
+    }
+}
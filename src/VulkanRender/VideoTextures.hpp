@@ -0,0 +1,87 @@
+#pragma once
+#include "Core/NoCopyMove.hpp"
+#include "Vulkan/Device.hpp"
+#include "Vulkan/GraphicsPipeline.hpp"
+#include "Video/VideoDecoder.hpp"
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace wallpaper
+{
+struct Image;
+
+namespace vulkan
+{
+
+// Video textures played by the scene clock. Each clip is decoded by va-api, the planes of the
+// frame due are imported as dma-bufs and a compute dispatch converts them into the clip's rgba
+// image, which passes sample like any other texture. Clips are shared by their texture's key.
+class VideoTextures : NoCopy, NoMove {
+public:
+    VideoTextures();
+    ~VideoTextures();
+
+    bool init(const Device&, usize frame_num);
+    void destroy();
+    // the clips of the cleared graph, no frame samples them any more
+    void clear();
+
+    // the image the clip of the video texture is drawn to, nullopt if the clip can't be decoded,
+    // clip is set to pass to serial()
+    std::optional<ImageSlotsRef> add(const Device&, const Image&, usize& clip);
+
+    // the frame in the slot is done, its imports go and their frames back to the decoders
+    void beginFrame(usize frame);
+    // the frame due at time seconds of every clip, true if one got a new one
+    bool pick(double time);
+    // draws the picked frames into the clips' images before the passes sample them
+    void record(const Device&, const vvk::CommandBuffer&, usize frame);
+
+    // bumped each time the clip's image gets another frame
+    u64 serial(usize clip) const;
+
+private:
+    struct Clip {
+        std::string                               key;
+        std::unique_ptr<video::VideoDecoder>      decoder;
+        VmaImageParameters                        image;
+        vvk::Sampler                              sampler;
+        std::shared_ptr<const video::DmaBufFrame> shown;
+        // picked, drawn by the next record
+        std::shared_ptr<const video::DmaBufFrame> next;
+        // out of the undefined layout, transparent until the first frame
+        bool ready { false };
+        u64  serial { 0 };
+    };
+    // a plane of a frame as an image on its dma-buf
+    struct Plane {
+        vvk::Image        image;
+        vvk::DeviceMemory mem;
+        vvk::ImageView    view;
+    };
+    struct Import {
+        std::shared_ptr<const video::DmaBufFrame> frame;
+        std::array<Plane, 2>                      planes;
+    };
+
+    bool importFrame(const Device&, const video::DmaBufFrame&, Import&) const;
+    void draw(const vvk::CommandBuffer&, Clip&, Import&) const;
+
+    usize              m_frame_num { 1 };
+    u32                m_graphics_family { 0 };
+    PipelineParameters m_pipeline;
+    // the planes of a frame, chroma is sampled at half size
+    vvk::Sampler      m_plane_sampler;
+    std::vector<Clip> m_clips;
+    // imported in each slot, they live until its frame is done
+    std::vector<std::vector<Import>> m_imports;
+    // a clip whose frames can't be imported logs it once
+    bool m_import_failed { false };
+};
+
+} // namespace vulkan
+} // namespace wallpaper
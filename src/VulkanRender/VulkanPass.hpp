@@ -5,6 +5,12 @@
 #include <string>
 #include <string_view>
 #include <algorithm>
+#include <cstdint>
+
+namespace vvk
+{
+class CommandBuffer;
+}
 
 namespace wallpaper
 {
@@ -20,11 +26,22 @@ class Resource;
 
 class VulkanPass : public rg::Pass {
 public:
+    // how a pass touches the targets it reads and writes, barriers between passes follow from it
+    enum class Use : uint8_t
+    {
+        Sample,
+        Attachment,
+        Transfer
+    };
+
     VulkanPass()                                                     = default;
     virtual ~VulkanPass()                                            = default;
     virtual void prepare(Scene&, const Device&, RenderingResources&) = 0;
     virtual void execute(const Device&, RenderingResources&)         = 0;
     virtual void destory(const Device&, RenderingResources&)         = 0;
+    // The output changed size and the targets were made again, take their new images and keep
+    // the pipelines. false if the pass has to be destroyed and prepared again instead
+    virtual bool resizeTargets(Scene&, const Device&, RenderingResources&) { return false; }
 
     void addReleaseTexs(std::span<const std::string_view> texs) {
         m_release_texs.clear();
@@ -41,9 +58,39 @@ public:
     void markDirty() { m_needs_execute = true; }
     void markClean() { m_needs_execute = false; }
 
+    virtual Use readUse() const { return Use::Sample; }
+    virtual Use writeUse() const { return Use::Attachment; }
+
     // Override in subclasses to indicate if pass can be cached
     virtual bool isStatic() const { return false; }
 
+    // Output only depends on input textures and uniforms, may be skipped while none of them
+    // changes, known before prepare
+    virtual bool isCacheable() const { return false; }
+
+    // Reads the time, the mouse or the audio, what it draws changes without the scene changing
+    virtual bool usesTimeUniforms() const { return false; }
+    // Reads the mouse or the audio
+    virtual bool usesLiveUniforms() const { return false; }
+
+    // The part of the frame's update that only writes the pass itself, its uniform values. Run
+    // for all passes at once on jobs, before update() of each in order takes it from there
+    virtual void updateValues() {}
+    // Per frame state update, run before execute even if the pass is skipped
+    // returns true if anything the output depends on changed since the last call
+    virtual bool update() { return true; }
+
+    // The const uniforms of the scene changed in place, write them again, update() then sees
+    // the change
+    virtual void reloadConstants() {}
+
+    // Draw commands can go to a secondary buffer inside the pass's render pass, which execute()
+    // then replays. Recording runs on worker threads and may only touch the pass itself
+    virtual bool canRecordSecondary() const { return false; }
+    virtual bool recordSecondary(const Device&, RenderingResources&, const vvk::CommandBuffer&) {
+        return false;
+    }
+
 protected:
     void setPrepared(bool v = true) { m_prepared = v; }
 
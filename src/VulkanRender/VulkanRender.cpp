@@ -1,15 +1,20 @@
 #include "VulkanRender.hpp"
 
 #include "Utils/Logging.h"
+#include "Utils/Trace.h"
+#include "Utils/Counters.hpp"
 #include "RenderGraph/RenderGraph.hpp"
 #include "Scene/Scene.h"
 #include "Interface/IShaderValueUpdater.h"
+#include "Interface/IImageParser.h"
+#include "Fs/VFS.h"
 
 #include "Utils/Algorism.h"
+#include "Utils/Hash.h"
 
-#include <glslang/Public/ShaderLang.h>
 
 #include "Vulkan/Device.hpp"
+#include "Vulkan/DeviceCache.hpp"
 #include "Vulkan/TextureCache.hpp"
 #include "Vulkan/Swapchain.hpp"
 #include "Vulkan/VulkanExSwapchain.hpp"
@@ -17,13 +22,35 @@
 #include "VulkanPass.hpp"
 #include "PrePass.hpp"
 #include "FinPass.hpp"
+#include "PassCache.hpp"
+#include "BarrierPlan.hpp"
+#include "DirtyRegion.hpp"
+#include "CustomShaderPass.hpp"
+#include "SecondaryRecorder.hpp"
+#include "GpuProfiler.hpp"
+#include "ResolutionScaler.hpp"
+#include "MemoryWatch.hpp"
+#include "ParticleCompute.hpp"
+#include "MipCompute.hpp"
+#include "AsyncCompute.hpp"
+#include "StaticGeometry.hpp"
+#include "BindlessTextures.hpp"
+#include "VideoTextures.hpp"
 #include "Resource.hpp"
+#include "SpecTexs.hpp"
 
 #include "Core/ArrayHelper.hpp"
+#include "Looper/JobSystem.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <vector>
 #include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <span>
 
 #if ENABLE_RENDERDOC_API
 #    include "RenderDoc.h"
@@ -32,13 +59,28 @@
 using namespace wallpaper::vulkan;
 
 constexpr uint64_t vk_wait_time { 10u * 1000u * 1000000u };
-constexpr uint32_t vk_command_num { 2 };
+// a frame not given an image by then is skipped, the next one tries again
+constexpr uint64_t vk_acquire_wait_time { 1000u * 1000000u };
+// a present not shown by then gives no pacing feedback for its frame
+constexpr uint64_t vk_present_wait_time { 100u * 1000000u };
+constexpr usize    vk_max_frames_in_flight { 3 };
+// levels textures may be cut by to fit the budget, each quarters the big ones
+constexpr u32 vk_max_level_bias { 2 };
+
+constexpr std::string_view pipeline_cache_path { "/cache/vk_pipeline.cache" };
+// in the cache folder, read before anything is mounted
+constexpr std::string_view device_cache_name { "vk_device.cache" };
 
 constexpr std::array base_inst_exts {
     Extension { false, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME },
 };
 constexpr std::array base_device_exts {
     Extension { false, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME },
+    Extension { false, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME },
+    Extension { false, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME },
+    Extension { false, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME },
+    Extension { false, VK_KHR_MAINTENANCE3_EXTENSION_NAME },
+    Extension { false, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME },
     Extension { true, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME },
     Extension { true, VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME },
     Extension { true, VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME },
@@ -46,51 +88,271 @@ constexpr std::array base_device_exts {
     Extension { true, VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME }
 };
 
+namespace
+{
+// offscreen renderers of a process share one device per gpu, layers and extensions asked for,
+// each monitor's scene then pays for one instance, allocator and pipeline cache
+std::mutex                                               shared_cores_lock;
+wallpaper::Map<std::string, std::weak_ptr<Device::Core>> shared_cores;
+
+std::string SharedCoreKey(const wallpaper::RenderInitInfo& info) {
+    std::string key(info.uuid.begin(), info.uuid.end());
+    key += (char)('0' + info.gpu_policy);
+    key += info.enable_valid_layer ? 'v' : '-';
+    key += info.offscreen_modifiers.empty() ? '-' : 'm';
+    return key;
+}
+
+// what a device cache is good for, another loader or driver is caught when the device is made
+std::string DeviceCacheKey(std::span<const Extension>       inst_exts,
+                           std::span<const InstanceLayer>   inst_layers,
+                           std::span<const Extension>       device_exts,
+                           const wallpaper::RenderInitInfo& info) {
+    std::string key = std::to_string(WP_VULKAN_VERSION);
+    for (auto exts : { inst_exts, inst_layers, device_exts }) {
+        key += " |";
+        for (auto& ext : exts) {
+            key += ext.required ? " +" : " ?";
+            key += ext.name;
+        }
+    }
+    key += " | ";
+    for (auto byte : info.uuid) {
+        char hex[3] { '\0' };
+        std::snprintf(hex, sizeof(hex), "%02x", byte);
+        key += hex;
+    }
+    key += " policy " + std::to_string(info.gpu_policy);
+    key += info.offscreen ? " offscreen" : " surface";
+    return key;
+}
+
+GpuPreference PreferenceOf(int32_t policy) {
+    switch (policy) {
+    case wallpaper::GPU_POLICY_INTEGRATED: return GpuPreference::Integrated;
+    case wallpaper::GPU_POLICY_DISCRETE: return GpuPreference::Discrete;
+    default: return GpuPreference::Any;
+    }
+}
+
+// of the first level
+VkDeviceSize TargetBytes(const wallpaper::SceneRenderTarget& rt) {
+    using wallpaper::TextureFormat;
+    const VkDeviceSize texel = rt.format == TextureFormat::R8    ? 1
+                               : rt.format == TextureFormat::RG8 ? 2
+                                                                 : 4;
+    return (VkDeviceSize)std::max(rt.width, 0) * (VkDeviceSize)std::max(rt.height, 0) * texel;
+}
+} // namespace
+
 struct VulkanRender::Impl {
     Impl()  = default;
     ~Impl() = default;
 
     bool init(RenderInitInfo);
+    // a new instance and device, from what the cache knows if given
+    bool createDevice(const RenderInitInfo&, std::span<const Extension> inst_exts,
+                      std::span<const InstanceLayer> inst_layers,
+                      std::span<const Extension> device_exts, VkExtent2D, const DeviceCache*);
     void destroy();
 
-    void drawFrame(Scene&);
+    bool drawFrame(Scene&, const std::function<void()>& updated);
 
     bool CreateRenderingResource(RenderingResources&);
     void DestroyRenderingResource(RenderingResources&);
+    void waitFramesInFlight();
+    // before passes go, a job may be making a pipeline for one
+    void waitPipelineJobs();
+    void loadPipelineCache(fs::VFS&);
+    void savePipelineCache(fs::VFS&);
 
     void clearLastRenderGraph();
     void compileRenderGraph(Scene&, rg::RenderGraph&);
+    void beginCompile(Scene&, rg::RenderGraph&);
+    bool compileStep(std::chrono::microseconds budget);
+    // the discards and uploads once every pass is prepared
+    void finishCompile();
+    bool resize(Scene*, rg::RenderGraph*, VkExtent2D);
+    // targets made again at the new size, the passes take their images
+    void resizePasses(Scene&, rg::RenderGraph&);
+    void setGpuBudget(double ms);
+    // the compiled graph's targets at the scaler's scale
+    void applyResolutionScale(Scene&);
     void UpdateCameraFillMode(Scene&, wallpaper::FillMode);
+    bool passTimes(std::vector<PassTime>&);
+    void annotateGraph(rg::RenderGraph&) const;
+
+    bool                initRes();
+    RenderingResources* beginFrame();
+    bool                drawFrameSwapchain();
+    // lets the slot's frame go without drawing, its fence is signaled by an empty submit
+    void                skipFrame(RenderingResources&);
+    bool                createSwapSemaphores();
+    bool                drawFrameOffscreen();
+    // the frame's commands, with the compute queue's first if the frame has any
+    VkResult            submitFrame(const QueueParameters&, RenderingResources&,
+                                    const VkSubmitInfo&);
+    // before the finpass of a frame, it copies its result into the capture buffer
+    void                prepareCapture(RenderingResources&);
+    // after the frame's submit, waits for it and hands the texels to the callback
+    void                finishCapture();
+    // pending frames the gpu finished go to the ex swapchain in order, the one drawn in slot is
+    // waited for, all are if slot is null
+    void                presentExFrames(const RenderingResources* slot);
+    void                presentEx(ExHandle&);
+    void                waitPresented();
+    // usage against the budget, what MemoryWatch says to do about it
+    void                watchMemory();
+    MemoryStatus        memoryStatus() const;
+    void                setRenderTargetSize(Scene&, rg::RenderGraph&);
+    // what compiling a graph works out before the passes, kept for graphs of the same structure
+    struct GraphPlan {
+        usize                                 structure { 0 };
+        std::vector<rg::NodeID>               order;
+        std::vector<std::vector<std::string>> release_texs;
+        // with prepass and finpass
+        std::vector<PassCache::PassIO>        io;
+        std::vector<std::vector<std::string>> first_writes;
+        std::vector<bool>                     joinable;
+        // per pass, a shader pass drawing on the default target only
+        std::vector<bool> composites;
+
+        // of the target sizes and textures it was last planned for, the level bias and memory
+        usize        memory { 0 };
+        u32          level_bias { 0 };
+        VkDeviceSize memory_needed { 0 };
+    };
+    // the plan of a graph of that structure, made if none is kept
+    GraphPlan&          graphPlan(rg::RenderGraph&);
+    // sizes up textures from their headers and targets before anything is allocated, and cuts
+    // texture levels if they don't fit the memory budget
+    void                planMemory(Scene&, GraphPlan&);
+    void                executePass(usize index, RenderingResources&);
 
-    bool initRes();
-    void drawFrameSwapchain();
-    void drawFrameOffscreen();
-    void setRenderTargetSize(Scene&, rg::RenderGraph&);
-
-    Instance                m_instance;
-    std::unique_ptr<Device> m_device;
+    std::shared_ptr<Instance> m_instance;
+    std::unique_ptr<Device>   m_device;
 
     std::unique_ptr<PrePass> m_prepass { nullptr };
     std::unique_ptr<FinPass> m_finpass { nullptr };
 
     std::unique_ptr<FinPass> m_testpass { nullptr };
     ReDrawCB                 m_redraw_cb;
+    FrameReadyCB             m_frame_ready_cb;
+    PresentedCB              m_presented_cb;
+    // id of the last present, with present wait
+    uint64_t                 m_present_id { 0 };
+    // for the texture cache once the device is made
+    VkDeviceSize m_tex_retain { TextureCache::DefaultRetainBudget };
+    // levels every graph compiled next cuts at least, the budget may cut more
+    u32 m_min_level_bias { 0 };
+
+    // of the frame drawn, see drawFrame
+    const std::function<void()>* m_updated_cb { nullptr };
 
     std::unique_ptr<StagingBuffer> m_vertex_buf { nullptr };
-    std::unique_ptr<StagingBuffer> m_dyn_buf { nullptr };
+    // the passes' static meshes in m_vertex_buf
+    std::unique_ptr<StaticGeometry> m_static_geometry { nullptr };
+    std::unique_ptr<StagingBuffer>  m_dyn_buf { nullptr };
+    std::unique_ptr<UniformRing>   m_ubo_ring { nullptr };
+    // allocated with the passes of a render graph, so the ring empties between scenes
+    SharedUniforms m_shared_uniforms;
+    // storage ring of the bone palettes, see BonePalettes
+    std::unique_ptr<UniformRing> m_palette_ring { nullptr };
+    BonePalettes                 m_bone_palettes;
+    // only with RenderInitInfo::gpu_particles
+    std::unique_ptr<ParticleCompute> m_particle_compute { nullptr };
+    std::unique_ptr<MipCompute>      m_mip_compute { nullptr };
+    // only with descriptor indexing, scenes are parsed for it then
+    std::unique_ptr<BindlessTextures> m_bindless { nullptr };
+    // only if the device imports dma-bufs, and the scene time its clips play at
+    std::unique_ptr<VideoTextures> m_video { nullptr };
+    double                         m_video_time { 0.0 };
+    // particle steps on the compute queue, null if the gpu has none apart from graphics
+    std::unique_ptr<AsyncCompute> m_async_compute { nullptr };
+    // pipelines of shader passes, layers draw once theirs is made
+    looper::JobGroup m_pipeline_jobs;
+    // textures of cleared graphs being freed
+    looper::JobGroup m_retire_jobs;
 
     vvk::CommandBuffers m_cmds;
     vvk::CommandBuffer  m_upload_cmd;
-    vvk::CommandBuffer  m_render_cmd;
+    vvk::Fence          m_upload_fence;
+
+    std::vector<uint8_t> m_gpu_uuid;
 
     bool m_with_surface { false };
     bool m_inited { false };
     bool m_pass_loaded { false };
+    bool m_pipeline_cache_loaded { false };
+    // saved once the pipelines of the compiled graph are made
+    bool m_pipeline_cache_dirty { false };
+
+    // per swapchain image, a present may still wait on one when its frame slot comes round again
+    std::vector<vvk::Semaphore> m_swap_finish;
+    // out of date, made again before the next frame
+    bool m_swapchain_stale { false };
 
     std::unique_ptr<VulkanExSwapchain> m_ex_swapchain;
-    RenderingResources                 m_rendering_resources;
+    // offscreen frames submitted but not yet handed to the ex swapchain, oldest first, only if
+    // it can't hand over a semaphore with them
+    struct ExPending {
+        ExHandle*           frame;
+        RenderingResources* rr;
+    };
+    std::deque<ExPending> m_ex_pending;
+    // of the last frame given an ex image
+    uint64_t m_ex_frame_id { 0 };
+    // draw the next frame even if no pass changed
+    bool m_force_frame { true };
+    // of the next frame drawn, see captureNextFrame
+    CaptureCB           m_capture_cb;
+    VmaBufferParameters m_capture_buf;
+    // the slot of the frame copying into the buffer, null while none does
+    RenderingResources* m_capture_rr { nullptr };
+
+    usize                           m_frame_num { 2 };
+    usize                           m_frame_index { 0 };
+    std::vector<RenderingResources> m_rendering_resources;
 
     std::vector<VulkanPass*> m_passes;
+    // per pass, layout discards of aliased targets it writes first
+    std::vector<std::vector<VkImageMemoryBarrier>> m_discards;
+    PassCache                                      m_pass_cache;
+    BarrierPlan                                    m_barrier_plan;
+    DirtyRegion                                    m_dirty_region;
+    SecondaryRecorder        m_recorder;
+
+    GpuProfiler      m_profiler;
+    ResolutionScaler m_res_scaler;
+    // where the scaler starts for a new graph
+    float            m_start_scale { 1.0f };
+    bool             m_res_scale_changed { false };
+    MemoryWatch      m_mem_watch;
+    MemoryPressureCB m_pressure_cb;
+    // per pass, what the profiler reports it as
+    std::vector<PassTime> m_pass_times;
+
+    // a graph compiled in steps, passes before prepared are
+    struct Compile {
+        Scene*           scene { nullptr };
+        rg::RenderGraph* rg { nullptr };
+        // per pass, targets it writes before anything else in the frame touches them
+        std::vector<std::vector<std::string>> first_writes;
+        // what each pass touches and the targets that may share an image, for the barrier plan
+        std::vector<PassCache::PassIO> io;
+        Set<std::string>               shared;
+        // per pass, a shader pass drawing on to the target of the shader pass before
+        std::vector<bool> joinable;
+        std::vector<bool> composites;
+        usize             prepared { 0 };
+    };
+    std::optional<Compile> m_compile;
+    // the one the passes came from, finished again by a resize
+    std::optional<Compile> m_compiled;
+
+    // most recent first, a reload or resize of one of the last scenes finds its plan
+    std::vector<GraphPlan> m_graph_plans;
+    static constexpr usize max_graph_plans { 4 };
 };
 
 VulkanRender::VulkanRender(): pImpl(std::make_unique<Impl>()) {}
@@ -100,11 +362,79 @@ bool VulkanRender::inited() const { return pImpl->m_inited; }
 
 bool VulkanRender::init(RenderInitInfo info) { return pImpl->init(info); }
 void VulkanRender::destroy() { pImpl->destroy(); }
-void VulkanRender::drawFrame(Scene& scene) { pImpl->drawFrame(scene); };
+bool VulkanRender::reinit(RenderInitInfo info) {
+    auto next = std::make_unique<Impl>();
+    next->m_presented_cb   = std::move(pImpl->m_presented_cb);
+    next->m_pressure_cb    = std::move(pImpl->m_pressure_cb);
+    next->m_tex_retain     = pImpl->m_tex_retain;
+    next->m_min_level_bias = pImpl->m_min_level_bias;
+    next->m_start_scale    = pImpl->m_res_scaler.scale();
+    pImpl->destroy();
+    pImpl = std::move(next);
+    return pImpl->init(info);
+}
+bool VulkanRender::drawFrame(Scene& scene, const std::function<void()>& updated) {
+    return pImpl->drawFrame(scene, updated);
+};
 void VulkanRender::clearLastRenderGraph() { pImpl->clearLastRenderGraph(); };
+void VulkanRender::beginCompile(Scene& scene, rg::RenderGraph& rg) {
+    pImpl->beginCompile(scene, rg);
+}
+bool VulkanRender::compileStep(std::chrono::microseconds budget) {
+    return pImpl->compileStep(budget);
+}
+bool VulkanRender::pipelinesReady() const { return pImpl->m_pipeline_jobs.done(); }
+bool VulkanRender::texturesComplete() const {
+    return ! pImpl->m_device || ! pImpl->m_device->tex_cache().StreamPending();
+}
+void VulkanRender::setTextureLevelBias(uint32_t levels) { pImpl->m_min_level_bias = levels; }
+GraphMotion VulkanRender::graphMotion() const {
+    GraphMotion motion;
+    for (const auto* p : pImpl->m_passes) {
+        motion.time |= p->usesTimeUniforms();
+        motion.live |= p->usesLiveUniforms();
+    }
+    return motion;
+}
+void VulkanRender::captureNextFrame(CaptureCB cb) {
+    pImpl->m_capture_cb  = std::move(cb);
+    pImpl->m_force_frame = true;
+}
 void VulkanRender::compileRenderGraph(Scene& scene, rg::RenderGraph& rg) {
     pImpl->compileRenderGraph(scene, rg);
 };
+bool VulkanRender::resize(Scene* scene, rg::RenderGraph* rg, uint32_t width, uint32_t height) {
+    return pImpl->resize(scene, rg, VkExtent2D { width, height });
+}
+void VulkanRender::setProfiling(bool v) { pImpl->m_profiler.setEnabled(v); };
+void VulkanRender::setGpuBudget(double ms) { pImpl->setGpuBudget(ms); };
+void VulkanRender::setStartScale(float scale) { pImpl->m_start_scale = scale; };
+float VulkanRender::resolutionScale() const { return pImpl->m_res_scaler.scale(); };
+std::span<const std::uint8_t> VulkanRender::gpuUuid() const { return pImpl->m_gpu_uuid; };
+bool VulkanRender::bindlessTextures() const { return pImpl->m_bindless != nullptr; }
+void VulkanRender::setPresentedCallback(PresentedCB cb) { pImpl->m_presented_cb = std::move(cb); };
+void VulkanRender::setMemoryPressureCallback(MemoryPressureCB cb) {
+    pImpl->m_pressure_cb = std::move(cb);
+};
+bool VulkanRender::memoryStatus(MemoryStatus& status) const {
+    if (! pImpl->m_inited) return false;
+    status = pImpl->memoryStatus();
+    return status.budget > 0;
+};
+void VulkanRender::setTextureRetainBudget(std::uint64_t bytes) {
+    pImpl->m_tex_retain = bytes;
+    if (pImpl->m_device) pImpl->m_device->tex_cache().SetRetainBudget(bytes);
+};
+void VulkanRender::reloadConstants() {
+    for (auto& p : pImpl->m_passes) p->reloadConstants();
+};
+bool VulkanRender::passTimes(std::vector<PassTime>& times) { return pImpl->passTimes(times); };
+void VulkanRender::annotateGraph(rg::RenderGraph& rg) const { pImpl->annotateGraph(rg); };
+bool VulkanRender::gpuFrameTime(double& ms) const {
+    if (! pImpl->m_profiler.enabled() || pImpl->m_profiler.frameTime() <= 0.0) return false;
+    ms = pImpl->m_profiler.frameTime();
+    return true;
+};
 void VulkanRender::UpdateCameraFillMode(Scene& scene, wallpaper::FillMode fill) {
     pImpl->UpdateCameraFillMode(scene, fill);
 };
@@ -114,7 +444,9 @@ wallpaper::ExSwapchain* VulkanRender::exSwapchain() const { return pImpl->m_ex_s
 bool VulkanRender::Impl::init(RenderInitInfo info) {
     if (m_inited) return true;
 
-    m_redraw_cb = info.redraw_callback;
+    m_redraw_cb      = info.redraw_callback;
+    m_frame_ready_cb = info.frame_ready_callback;
+    m_frame_num = std::clamp<usize>(info.frames_in_flight, 1, vk_max_frames_in_flight);
     VkExtent2D extent { info.width, info.height };
     if (extent.width * extent.height < 500 * 500) {
         LOG_ERROR("too small swapchain image size: %dx%d", extent.width, extent.height);
@@ -133,6 +465,19 @@ bool VulkanRender::Impl::init(RenderInitInfo info) {
                            return Extension { true, s.c_str() };
                        });
         device_exts.push_back({ true, VK_KHR_SWAPCHAIN_EXTENSION_NAME });
+        device_exts.push_back({ false, VK_KHR_PRESENT_ID_EXTENSION_NAME });
+        device_exts.push_back({ false, VK_KHR_PRESENT_WAIT_EXTENSION_NAME });
+    }
+    bool dma_buf = info.offscreen && ! info.offscreen_modifiers.empty();
+#if ENABLE_VIDEO
+    // video frames are imported from the decoder's dma-bufs
+    dma_buf = true;
+#endif
+    if (dma_buf) {
+        device_exts.push_back({ false, VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME });
+        device_exts.push_back({ false, VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME });
+        device_exts.push_back({ false, VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME });
+        device_exts.push_back({ false, VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME });
     }
 
     std::vector<InstanceLayer> inst_layers;
@@ -142,10 +487,155 @@ bool VulkanRender::Impl::init(RenderInitInfo info) {
         LOG_INFO("vulkan valid layer \"%s\" enabled", VALIDATION_LAYER_NAME.data());
     }
 
-    if (! Instance::Create(m_instance, inst_exts, inst_layers)) {
+    // held while the device is made, a renderer starting meanwhile waits for it to share
+    std::unique_lock<std::mutex>  shared_lock;
+    std::shared_ptr<Device::Core> shared_core;
+    const std::string             core_key = info.offscreen ? SharedCoreKey(info) : std::string {};
+    if (info.offscreen) {
+        shared_lock = std::unique_lock(shared_cores_lock);
+        if (auto it = shared_cores.find(core_key); it != shared_cores.end())
+            shared_core = it->second.lock();
+    }
+
+    m_device = std::make_unique<Device>();
+    if (shared_core) {
+        m_instance = shared_core->instance;
+        if (! Device::CreateShared(shared_core, extent, *m_device)) {
+            LOG_ERROR("init vulkan device failed");
+            return false;
+        }
+        LOG_INFO("vulkan device shared with another offscreen renderer");
+    } else {
+        const std::filesystem::path cache_file =
+            info.cache_path.empty() ? std::filesystem::path {}
+                                    : std::filesystem::path(info.cache_path) / device_cache_name;
+        const std::string cache_key = DeviceCacheKey(inst_exts, inst_layers, device_exts, info);
+
+        DeviceCache cached;
+        bool        use_cache = ! cache_file.empty() && cached.Load(cache_file, cache_key);
+        bool        created   = createDevice(info,
+                                         inst_exts,
+                                         inst_layers,
+                                         device_exts,
+                                         extent,
+                                         use_cache ? &cached : nullptr);
+        if (! created && use_cache) {
+            LOG_INFO("vulkan changed since the device was cached, looking again");
+            use_cache = false;
+            created   = createDevice(info, inst_exts, inst_layers, device_exts, extent, nullptr);
+        }
+        if (! created) return false;
+        if (! cache_file.empty()) {
+            auto now = DeviceCache::Of(*m_device, cache_key);
+            if (! use_cache || ! (now == cached)) now.Save(cache_file);
+        }
+        if (info.offscreen) shared_cores[core_key] = m_device->core();
+    }
+    if (shared_lock) shared_lock.unlock();
+    m_device->tex_cache().SetRetainBudget(m_tex_retain);
+    {
+        VkPhysicalDeviceIDProperties id_props {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES, .pNext = nullptr
+        };
+        VkPhysicalDeviceProperties2 props2 {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &id_props
+        };
+        m_device->gpu().GetProperties2KHR(props2);
+        m_gpu_uuid.assign(id_props.deviceUUID, id_props.deviceUUID + VK_UUID_SIZE);
+    }
+
+    if (info.offscreen) {
+        uint32_t images = info.offscreen_images != 0 ? info.offscreen_images : m_frame_num + 2;
+        m_ex_swapchain  = CreateExSwapchain(*m_device,
+                                            extent.width,
+                                            extent.height,
+                                            (info.offscreen_tiling == TexTiling::OPTIMAL
+                                                 ? VK_IMAGE_TILING_OPTIMAL
+                                                 : VK_IMAGE_TILING_LINEAR),
+                                            images,
+                                            info.offscreen_modifiers,
+                                            info.offscreen_synced);
+        if (! m_ex_swapchain) {
+            LOG_ERROR("create ex swapchain failed");
+            return false;
+        }
+        LOG_INFO("ex swapchain with %u images", m_ex_swapchain->count());
+        m_with_surface = false;
+        if (m_presented_cb) m_ex_swapchain->setEatenCallback(m_presented_cb);
+    }
+
+    if (! initRes()) return false;
+
+    if (info.gpu_particles) {
+        auto async = std::make_unique<AsyncCompute>();
+        if (! async->init(*m_device, m_frame_num)) {
+            async->destroy();
+            async.reset();
+        }
+        auto compute = std::make_unique<ParticleCompute>();
+        if (compute->init(*m_device, m_frame_num, async != nullptr)) {
+            m_particle_compute = std::move(compute);
+            m_async_compute    = std::move(async);
+            for (auto& rr : m_rendering_resources) {
+                rr.particle_compute = m_particle_compute.get();
+                rr.async_compute    = m_async_compute.get();
+            }
+        } else {
+            LOG_INFO("particles stay on cpu");
+            if (async) async->destroy();
+        }
+    }
+    {
+        auto compute = std::make_unique<MipCompute>();
+        if (compute->init(*m_device, m_frame_num)) {
+            m_mip_compute = std::move(compute);
+            for (auto& rr : m_rendering_resources) rr.mip_compute = m_mip_compute.get();
+        } else {
+            LOG_INFO("mipmaps are blitted");
+        }
+    }
+    // the array and a pass's own samplers next to it
+    if (m_device->descriptor_indexing() &&
+        m_device->update_after_bind_images() >= WE_BINDLESS_CAPACITY + WE_GLTEX_NAMES.size()) {
+        auto bindless = std::make_unique<BindlessTextures>();
+        if (bindless->init(*m_device, m_frame_num)) {
+            m_bindless = std::move(bindless);
+            for (auto& rr : m_rendering_resources) rr.bindless = m_bindless.get();
+        } else {
+            bindless->destroy();
+        }
+    }
+    if (! m_bindless) LOG_INFO("textures are bound per pass");
+#if ENABLE_VIDEO
+    if (m_device->dma_buf()) {
+        auto video = std::make_unique<VideoTextures>();
+        if (video->init(*m_device, m_frame_num)) {
+            m_video = std::move(video);
+            for (auto& rr : m_rendering_resources) rr.video = m_video.get();
+        } else {
+            video->destroy();
+        }
+    }
+#endif
+    if (! m_video) LOG_INFO("video textures are not drawn");
+
+    m_inited = true;
+    return m_inited;
+}
+
+bool VulkanRender::Impl::createDevice(const RenderInitInfo&           info,
+                                      std::span<const Extension>     inst_exts,
+                                      std::span<const InstanceLayer> inst_layers,
+                                      std::span<const Extension>     device_exts,
+                                      VkExtent2D                     extent,
+                                      const DeviceCache*             cached) {
+    m_device   = std::make_unique<Device>();
+    m_instance = std::make_shared<Instance>();
+    if (! Instance::Create(*m_instance, inst_exts, inst_layers, cached)) {
         LOG_ERROR("init vulkan failed");
         return false;
     }
+    m_with_surface = false;
     if (! info.offscreen) {
         VkSurfaceKHR surface;
         VVK_CHECK_ACT(
@@ -153,43 +643,35 @@ bool VulkanRender::Impl::init(RenderInitInfo info) {
                 LOG_ERROR("create vulkan surface failed");
                 return false;
             },
-            info.surface_info.createSurfaceOp(*m_instance.inst(), &surface));
-        m_instance.setSurface(VkSurfaceKHR(surface));
+            info.surface_info.createSurfaceOp(*m_instance->inst(), &surface));
+        m_instance->setSurface(VkSurfaceKHR(surface));
         m_with_surface = true;
     }
     {
-        auto surface   = *m_instance.surface();
-        auto check_gpu = [&device_exts, surface](const vvk::PhysicalDevice& gpu) {
-            return Device::CheckGPU(gpu, device_exts, surface);
+        auto surface   = *m_instance->surface();
+        auto check_gpu = [device_exts, surface](const vvk::PhysicalDevice& gpu,
+                                                const Set<std::string>*    exts) {
+            return Device::CheckGPU(gpu, device_exts, surface, exts);
         };
-        if (! m_instance.ChoosePhysicalDevice(check_gpu, info.uuid)) return false;
-    }
-
-    {
-        m_device = std::make_unique<Device>();
-        if (! Device::Create(m_instance, device_exts, extent, *m_device)) {
-            LOG_ERROR("init vulkan device failed");
+        const bool match_uuid = info.gpu_policy == GPU_POLICY_COMPOSITOR;
+        if (! m_instance->ChoosePhysicalDevice(check_gpu,
+                                               match_uuid ? info.uuid
+                                                          : std::span<const std::uint8_t> {},
+                                               cached,
+                                               PreferenceOf(info.gpu_policy)))
             return false;
-        }
     }
-
-    if (info.offscreen) {
-        m_ex_swapchain = CreateExSwapchain(*m_device,
-                                           extent.width,
-                                           extent.height,
-                                           (info.offscreen_tiling == TexTiling::OPTIMAL
-                                                ? VK_IMAGE_TILING_OPTIMAL
-                                                : VK_IMAGE_TILING_LINEAR));
-        m_with_surface = false;
+    if (! Device::Create(m_instance,
+                         device_exts,
+                         extent,
+                         Swapchain::Options { .present_mode = info.present_mode,
+                                              .image_count  = info.swapchain_images },
+                         *m_device,
+                         m_instance->gpuCached() ? cached : nullptr)) {
+        LOG_ERROR("init vulkan device failed");
+        return false;
     }
-
-    if (! initRes()) return false;
-
-    // Initialize glslang once at startup
-    glslang::InitializeProcess();
-
-    m_inited = true;
-    return m_inited;
+    return true;
 }
 
 bool VulkanRender::Impl::initRes() {
@@ -202,7 +684,8 @@ bool VulkanRender::Impl::initRes() {
     } else {
         m_finpass->setPresentFormat(m_ex_swapchain->format());
         m_finpass->setPresentLayout(VK_IMAGE_LAYOUT_GENERAL);
-        m_finpass->setPresentQueueIndex(VK_QUEUE_FAMILY_EXTERNAL);
+        m_finpass->setPresentQueueIndex(m_ex_swapchain->dma_buf() ? VK_QUEUE_FAMILY_FOREIGN_EXT
+                                                                  : VK_QUEUE_FAMILY_EXTERNAL);
     }
     /*
     m_testpass = std::make_unique<FinPass>(FinPass::Desc{});
@@ -218,17 +701,43 @@ bool VulkanRender::Impl::initRes() {
     m_dyn_buf    = std::make_unique<StagingBuffer>(*m_device,
                                                 2 * 1024 * 1024,
                                                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                                                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                                                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+                                                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                                m_frame_num);
+    m_ubo_ring   = std::make_unique<UniformRing>(*m_device, 256 * 1024, m_frame_num);
     if (! m_vertex_buf->allocate()) return false;
+    m_static_geometry = std::make_unique<StaticGeometry>(*m_vertex_buf);
     if (! m_dyn_buf->allocate()) return false;
+    if (! m_ubo_ring->allocate()) return false;
+    m_palette_ring = std::make_unique<UniformRing>(
+        *m_device, 64 * 1024, m_frame_num, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    if (! m_palette_ring->allocate()) return false;
+    m_bone_palettes.ring = m_palette_ring.get();
     {
+        // one upload command, then one render command per frame
         auto& pool = m_device->cmd_pool();
-        VVK_CHECK_BOOL_RE(pool.Allocate(vk_command_num, VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_cmds));
+        VVK_CHECK_BOOL_RE(pool.Allocate(1 + m_frame_num, VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_cmds));
         m_upload_cmd = vvk::CommandBuffer(m_cmds[0], m_device->handle().Dispatch());
-        m_render_cmd = vvk::CommandBuffer(m_cmds[1], m_device->handle().Dispatch());
+
+        VVK_CHECK_BOOL_RE(m_device->handle().CreateFence(
+            VkFenceCreateInfo {
+                .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+            },
+            m_upload_fence));
+    }
+    m_rendering_resources.resize(m_frame_num);
+    for (usize i = 0; i < m_frame_num; i++) {
+        auto& rr   = m_rendering_resources[i];
+        rr.index   = i;
+        rr.command = vvk::CommandBuffer(m_cmds[1 + i], m_device->handle().Dispatch());
+        rr.pipeline_jobs = &m_pipeline_jobs;
+        if (! CreateRenderingResource(rr)) return false;
     }
-    if (! CreateRenderingResource(m_rendering_resources)) return false;
+    LOG_INFO("frames in flight: %d", m_frame_num);
+    if (m_with_surface && ! createSwapSemaphores()) return false;
+    if (! m_recorder.init(*m_device, m_frame_num)) return false;
+    (void)m_profiler.init(*m_device, m_frame_num);
 
 #if ENABLE_RENDERDOC_API
     load_renderdoc_api();
@@ -239,26 +748,36 @@ bool VulkanRender::Impl::initRes() {
 void VulkanRender::Impl::destroy() {
     if (! m_inited) return;
 
-    // Finalize glslang (paired with InitializeProcess in init)
-    glslang::FinalizeProcess();
-
     if (m_device && m_device->handle()) {
-        VVK_CHECK(m_device->handle().WaitIdle());
+        VVK_CHECK(m_device->WaitIdle());
+        waitPipelineJobs();
+        looper::JobSystem::Shared().wait(m_retire_jobs);
 
         // res
         for (auto& p : m_passes) {
-            p->destory(*m_device, m_rendering_resources);
+            p->destory(*m_device, m_rendering_resources.front());
         }
         m_vertex_buf->destroy();
         m_dyn_buf->destroy();
+        m_ubo_ring->destroy();
+        m_palette_ring->destroy();
+        if (m_particle_compute) m_particle_compute->destroy();
+        if (m_mip_compute) m_mip_compute->destroy();
+        if (m_async_compute) m_async_compute->destroy();
+        if (m_bindless) m_bindless->destroy();
+        if (m_video) m_video->destroy();
+        m_capture_buf = {};
+        m_rendering_resources.clear();
+        m_recorder.destroy();
+        m_profiler.destroy();
 
         m_device->Destroy();
     }
-    m_instance.Destroy();
+    if (m_instance) m_instance->Destroy();
 }
 
 bool VulkanRender::Impl::CreateRenderingResource(RenderingResources& rr) {
-    rr.command = m_render_cmd;
+    // signaled, the first wait of each frame returns at once
     VVK_CHECK_BOOL_RE(m_device->handle().CreateFence(
         VkFenceCreateInfo {
             .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
@@ -267,64 +786,194 @@ bool VulkanRender::Impl::CreateRenderingResource(RenderingResources& rr) {
         },
         rr.fence_frame));
 
-    rr.fence_frame.Reset();
-
     if (m_with_surface) {
         VkSemaphoreCreateInfo ci { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
                                    .pNext = nullptr };
-        VVK_CHECK_BOOL_RE(m_device->handle().CreateSemaphore(ci, rr.sem_swap_finish));
         VVK_CHECK_BOOL_RE(m_device->handle().CreateSemaphore(ci, rr.sem_swap_wait_image));
     }
 
-    rr.vertex_buf = m_vertex_buf.get();
-    rr.dyn_buf    = m_dyn_buf.get();
+    rr.vertex_buf      = m_vertex_buf.get();
+    rr.static_geometry = m_static_geometry.get();
+    rr.dyn_buf         = m_dyn_buf.get();
+    rr.ubo_ring        = m_ubo_ring.get();
+    rr.shared_uniforms = &m_shared_uniforms;
+    rr.bone_palettes   = &m_bone_palettes;
     return true;
 }
 
 void VulkanRender::Impl::DestroyRenderingResource(RenderingResources& rr) {}
 
-// VulkanExSwapchain* VulkanRender::exSwapchain() const { return m_ex_swapchain.get(); }
+void VulkanRender::Impl::waitFramesInFlight() {
+    if (m_upload_fence) VVK_CHECK(m_upload_fence.Wait(vk_wait_time));
+    for (auto& rr : m_rendering_resources) {
+        VVK_CHECK(rr.fence_frame.Wait(vk_wait_time));
+    }
+    presentExFrames(nullptr);
+}
+
+void VulkanRender::Impl::waitPipelineJobs() {
+    if (m_pipeline_jobs.done()) return;
+    TRACE_PHASE("waitPipelineJobs");
+    looper::JobSystem::Shared().wait(m_pipeline_jobs);
+}
+
+void VulkanRender::Impl::loadPipelineCache(fs::VFS& vfs) {
+    if (m_pipeline_cache_loaded || ! vfs.IsMounted("cache")) return;
+    m_pipeline_cache_loaded = true;
+
+    const std::string path { pipeline_cache_path };
+    if (! vfs.Contains(path)) return;
+    auto file = vfs.Open(path);
+    if (! file) return;
+
+    std::vector<uint8_t> data(file->Usize());
+    if (file->Read(data.data(), data.size()) != data.size()) return;
+    if (m_device->MergePipelineCache(data)) {
+        LOG_INFO("load pipeline cache: %d bytes", data.size());
+    }
+}
+
+void VulkanRender::Impl::savePipelineCache(fs::VFS& vfs) {
+    if (! vfs.IsMounted("cache")) return;
+
+    std::vector<uint8_t> data;
+    if (! m_device->GetPipelineCacheData(data) || data.empty()) return;
+    if (auto file = vfs.OpenW(std::string(pipeline_cache_path)); file) {
+        file->Write(data.data(), data.size());
+    }
+}
+
+RenderingResources* VulkanRender::Impl::beginFrame() {
+    RenderingResources& rr = m_rendering_resources[m_frame_index];
+
+    // only wait for the frame that used this slot, later frames keep running
+    {
+        TRACE_PHASE("waitFence");
+        VVK_CHECK_ACT(return nullptr, rr.fence_frame.Wait(vk_wait_time));
+    }
+    if (m_mip_compute) m_mip_compute->beginFrame(rr.index);
+    // a new video frame is drawn even if no pass would be
+    if (m_video) {
+        m_video->beginFrame(rr.index);
+        if (m_video->pick(m_video_time)) m_force_frame = true;
+    }
 
-void VulkanRender::Impl::drawFrame(Scene& scene) {
-    if (! (m_inited && m_pass_loaded)) return;
+    // pass updates write staging memory, only safe once the slot's frame is done
+    m_bone_palettes.frame = rr.index;
+    m_bone_palettes.written.clear();
+    m_dyn_buf->setFrame(rr.index);
+    bool changed = m_pass_cache.schedule(m_passes);
+    m_dirty_region.schedule(m_passes, m_pass_cache);
+    m_finpass->addChanged(m_dirty_region.changed());
+    if (m_updated_cb && *m_updated_cb) (*m_updated_cb)();
+    // streamed mips are copied by frames, even if nothing else changed
+    if (! changed && ! m_force_frame && ! m_device->tex_cache().StreamPending()) return nullptr;
+    m_force_frame = false;
+
+    if (m_shared_uniforms.ref)
+        (void)m_ubo_ring->write(m_shared_uniforms.ref, rr.index, m_shared_uniforms.data);
+
+    // an idle frame leaves the fence signaled, so the slot stays free
+    VVK_CHECK_ACT(return nullptr, rr.fence_frame.Reset());
+    if (m_bindless) m_bindless->beginFrame();
+    m_frame_index = (m_frame_index + 1) % m_frame_num;
+    return &rr;
+}
+
+// VulkanExSwapchain* VulkanRender::exSwapchain() const { return m_ex_swapchain.get(); }
 
-        // LOG_INFO("used ram: %fm", (m_device->GetUsage()/1024.0f)/1024.0f);
+bool VulkanRender::Impl::drawFrame(Scene& scene, const std::function<void()>& updated) {
+    if (! (m_inited && m_pass_loaded)) return false;
+    TRACE_PHASE("drawFrame");
 
 #if ENABLE_RENDERDOC_API
     if (rdoc_api)
         rdoc_api->StartFrameCapture(
-            RENDERDOC_DEVICEPOINTER_FROM_VKINSTANCE((VkInstance)m_instance.inst()), NULL);
+            RENDERDOC_DEVICEPOINTER_FROM_VKINSTANCE((VkInstance)m_instance->inst()), NULL);
 #endif
 
-    if (m_instance.offscreen()) {
-        drawFrameOffscreen();
-    } else {
-        drawFrameSwapchain();
+    m_device->tex_cache().ReleaseFinishedUploads();
+    if (m_pipeline_cache_dirty && m_pipeline_jobs.done()) {
+        m_pipeline_cache_dirty = false;
+        if (scene.vfs) savePipelineCache(*scene.vfs);
+    }
+    if (m_res_scale_changed) {
+        m_res_scale_changed = false;
+        applyResolutionScale(scene);
     }
 
-    if (m_redraw_cb) m_redraw_cb();
+    // before the passes update, they compare the parts of it they read
+    scene.shaderValueUpdater->UpdateSharedUniforms(m_shared_uniforms.data);
+
+    m_updated_cb = &updated;
+    m_video_time = scene.elapsingTime;
+    bool drawn   = m_instance->offscreen() ? drawFrameOffscreen() : drawFrameSwapchain();
+    m_updated_cb = nullptr;
+    finishCapture();
+
+    if (drawn) counters::Add(counters::Counter::Frames);
+    if (drawn && m_redraw_cb) m_redraw_cb();
+    if (drawn && ! m_instance->offscreen()) waitPresented();
+    // the scene may be simulated on by now, the targets change before the next frame
+    if (drawn && m_res_scaler.frame(m_profiler.frameTime())) m_res_scale_changed = true;
+    if (drawn && m_mem_watch.frame()) watchMemory();
 
 #if ENABLE_RENDERDOC_API
     if (rdoc_api)
         rdoc_api->EndFrameCapture(
-            RENDERDOC_DEVICEPOINTER_FROM_VKINSTANCE((VkInstance)m_instance.inst()), NULL);
+            RENDERDOC_DEVICEPOINTER_FROM_VKINSTANCE((VkInstance)m_instance->inst()), NULL);
 #endif
+    return drawn;
 }
 
-void VulkanRender::Impl::drawFrameSwapchain() {
-    static size_t resource_index = 0;
+bool VulkanRender::Impl::createSwapSemaphores() {
+    m_swap_finish.clear();
+    m_swap_finish.resize(m_device->swapchain().images().size());
+    VkSemaphoreCreateInfo ci { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = nullptr };
+    for (auto& sem : m_swap_finish) VVK_CHECK_BOOL_RE(m_device->handle().CreateSemaphore(ci, sem));
+    return true;
+}
 
-    RenderingResources& rr = m_rendering_resources;
-    resource_index         = (resource_index + 1) % 3;
-    uint32_t image_index   = 0;
+void VulkanRender::Impl::skipFrame(RenderingResources& rr) {
+    VkSubmitInfo sub_info { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO, .pNext = nullptr };
+    VVK_CHECK(m_device->Submit(m_device->present_queue(), sub_info, *rr.fence_frame));
+    m_force_frame = true;
+}
+
+bool VulkanRender::Impl::drawFrameSwapchain() {
+    if (m_swapchain_stale) {
+        TRACE_PHASE("recreateSwapchain");
+        waitFramesInFlight();
+        VVK_CHECK_BOOL_RE(m_device->WaitIdle());
+        if (! m_device->RecreateSwapchain(*m_instance->surface(), m_device->out_extent()) ||
+            ! createSwapSemaphores())
+            return false;
+        m_swapchain_stale = false;
+        m_present_id      = 0;
+        m_finpass->invalidatePresents();
+    }
+    RenderingResources* prr = beginFrame();
+    if (prr == nullptr) return false;
+    RenderingResources& rr = *prr;
+
+    uint32_t image_index = 0;
     {
-        VVK_CHECK_VOID_RE(m_device->handle().AcquireNextImageKHR(*m_device->swapchain().handle(),
-                                                                 vk_wait_time,
-                                                                 *rr.sem_swap_wait_image,
-                                                                 {},
-                                                                 &image_index));
+        TRACE_PHASE("Acquire");
+        VkResult res = m_device->handle().AcquireNextImageKHR(*m_device->swapchain().handle(),
+                                                              vk_acquire_wait_time,
+                                                              *rr.sem_swap_wait_image,
+                                                              {},
+                                                              &image_index);
+        if (res == VK_ERROR_OUT_OF_DATE_KHR) m_swapchain_stale = true;
+        if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
+            if (res != VK_ERROR_OUT_OF_DATE_KHR && res != VK_TIMEOUT)
+                LOG_ERROR("acquire swapchain image failed: %s", vvk::ToString(res));
+            skipFrame(rr);
+            return false;
+        }
     }
-    const auto& image = m_device->swapchain().images()[image_index];
+    const auto& image       = m_device->swapchain().images()[image_index];
+    auto&       swap_finish = m_swap_finish[image_index];
 
     m_finpass->setPresent(image);
 
@@ -333,13 +982,15 @@ void VulkanRender::Impl::drawFrameSwapchain() {
         .pNext = nullptr,
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     });
-    m_dyn_buf->recordUpload(rr.command);
-    for (auto* p : m_passes) {
-        if (p->prepared()) {
-            p->execute(*m_device, rr);
-        }
-    }
+    m_profiler.beginFrame(*m_device, rr);
+    m_dyn_buf->recordUpload(rr.command, rr.index);
+    m_device->tex_cache().RecordStream(rr.command, m_frame_num);
+    if (m_video) m_video->record(*m_device, rr.command, rr.index);
+    m_recorder.record(*m_device, rr, m_passes);
+    prepareCapture(rr);
+    for (usize i = 0; i < m_passes.size(); i++) executePass(i, rr);
     (void)rr.command.End();
+    m_dyn_buf->commitFrame(rr.index);
 
     VkPipelineStageFlags wait_dst_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     VkSubmitInfo         sub_info {
@@ -351,56 +1002,243 @@ void VulkanRender::Impl::drawFrameSwapchain() {
                 .commandBufferCount   = 1,
                 .pCommandBuffers      = rr.command.address(),
                 .signalSemaphoreCount = 1,
-                .pSignalSemaphores    = rr.sem_swap_finish.address(),
+                .pSignalSemaphores    = swap_finish.address(),
     };
 
-    VVK_CHECK_VOID_RE(m_device->present_queue().handle.Submit(sub_info, *rr.fence_frame));
+    {
+        TRACE_PHASE("Submit");
+        VVK_CHECK_BOOL_RE(submitFrame(m_device->present_queue(), rr, sub_info));
+    }
     VkPresentInfoKHR present_info {
         .sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
         .pNext              = nullptr,
         .waitSemaphoreCount = 1,
-        .pWaitSemaphores    = rr.sem_swap_finish.address(),
+        .pWaitSemaphores    = swap_finish.address(),
         .swapchainCount     = 1,
         .pSwapchains        = m_device->swapchain().handle().address(),
         .pImageIndices      = &image_index,
     };
-    VVK_CHECK_VOID_RE(m_device->present_queue().handle.Present(present_info));
+    VkPresentIdKHR present_id { .sType          = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+                                .pNext          = nullptr,
+                                .swapchainCount = 1,
+                                .pPresentIds    = &m_present_id };
+    if (m_device->present_wait()) {
+        m_present_id++;
+        present_info.pNext = &present_id;
+    }
+    TRACE_PHASE("Present");
+    VkResult res = m_device->present_queue().handle.Present(present_info);
+    // the frame was submitted, its fence is signaled either way
+    if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR)
+        m_swapchain_stale = true;
+    else
+        VVK_CHECK(res);
+    return true;
+}
 
-    VVK_CHECK_VOID_RE(rr.fence_frame.Wait(vk_wait_time));
-    VVK_CHECK_VOID_RE(rr.fence_frame.Reset());
+void VulkanRender::Impl::waitPresented() {
+    if (! (m_presented_cb && m_device->present_wait())) return;
+    TRACE_PHASE("waitPresented");
+    // the swapchain is only touched from the render thread
+    VkResult res = m_device->handle().WaitForPresentKHR(
+        *m_device->swapchain().handle(), m_present_id, vk_present_wait_time);
+    if (res == VK_SUCCESS) m_presented_cb();
 }
-void VulkanRender::Impl::drawFrameOffscreen() {
-    RenderingResources& rr    = m_rendering_resources;
-    ImageParameters     image = m_ex_swapchain->GetInprogressImage();
 
-    m_finpass->setPresent(image);
+void VulkanRender::Impl::presentExFrames(const RenderingResources* slot) {
+    while (! m_ex_pending.empty()) {
+        auto& pending = m_ex_pending.front();
+        if (slot == nullptr || pending.rr == slot)
+            VVK_CHECK(pending.rr->fence_frame.Wait(vk_wait_time));
+        else if (pending.rr->fence_frame.GetStatus() != VK_SUCCESS)
+            break;
+        presentEx(*pending.frame);
+        m_ex_pending.pop_front();
+    }
+}
+
+void VulkanRender::Impl::presentEx(ExHandle& frame) {
+    // read before the eater may take the image
+    FrameReady ready { .frame_id  = frame.frame_id,
+                       .image     = frame.id(),
+                       .presented = std::chrono::steady_clock::now() };
+    m_ex_swapchain->presentFrame(frame);
+    if (m_frame_ready_cb) m_frame_ready_cb(ready);
+}
+
+bool VulkanRender::Impl::drawFrameOffscreen() {
+    // the slot's frame is waited for by beginFrame anyway, hand it over before its fence resets
+    presentExFrames(&m_rendering_resources[m_frame_index]);
+    RenderingResources* prr = beginFrame();
+    if (prr == nullptr) {
+        // nothing new, hand over what's left and leave the ex swapchain alone after
+        if (! m_ex_pending.empty()) {
+            presentExFrames(nullptr);
+            if (m_redraw_cb) m_redraw_cb();
+        }
+        return false;
+    }
+    RenderingResources& rr = *prr;
 
     (void)rr.command.Begin(VkCommandBufferBeginInfo {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .pNext = nullptr,
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     });
-    m_dyn_buf->recordUpload(rr.command);
-
-    for (auto* p : m_passes) {
-        if (p->prepared()) {
-            p->execute(*m_device, rr);
-        }
+    m_profiler.beginFrame(*m_device, rr);
+    m_dyn_buf->recordUpload(rr.command, rr.index);
+    m_device->tex_cache().RecordStream(rr.command, m_frame_num);
+    if (m_video) m_video->record(*m_device, rr.command, rr.index);
+    m_recorder.record(*m_device, rr, m_passes);
+
+    // record everything but the present, the previous frame keeps the gpu busy meanwhile
+    for (usize i = 0; i + 1 < m_passes.size(); i++) executePass(i, rr);
+
+    // frames still on the gpu hold their images, only waited for if no other is free
+    ExHandle* frame = m_ex_swapchain->acquireFrame();
+    if (frame == nullptr && ! m_ex_pending.empty()) {
+        presentExFrames(nullptr);
+        frame = m_ex_swapchain->acquireFrame();
+    }
+    if (frame != nullptr) frame->frame_id = ++m_ex_frame_id;
+    VulkanExHandle* ex = frame != nullptr ? &m_ex_swapchain->get(*frame) : nullptr;
+    if (ex != nullptr) {
+        m_finpass->setPresent(ex->image);
+        prepareCapture(rr);
+        executePass(m_passes.size() - 1, rr);
+    } else {
+        LOG_ERROR("no free ex swapchain image, frame dropped");
+        m_barrier_plan.skip(m_passes.size() - 1);
     }
 
     (void)rr.command.End();
+    m_dyn_buf->commitFrame(rr.index);
 
+    const bool           synced     = ex != nullptr && m_ex_swapchain->synced();
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // a frame dropped before it was eaten left its semaphore signaled, wait it off first
+    const bool dropped = synced && ex->handle.signaled;
     VkSubmitInfo sub_info {
-        .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext              = nullptr,
-        .commandBufferCount = 1,
-        .pCommandBuffers    = rr.command.address(),
+        .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext                = nullptr,
+        .waitSemaphoreCount   = dropped ? 1u : 0u,
+        .pWaitSemaphores      = synced ? ex->semaphore.address() : nullptr,
+        .pWaitDstStageMask    = &wait_stage,
+        .commandBufferCount   = 1,
+        .pCommandBuffers      = rr.command.address(),
+        .signalSemaphoreCount = synced ? 1u : 0u,
+        .pSignalSemaphores    = synced ? ex->semaphore.address() : nullptr,
     };
-    VVK_CHECK_VOID_RE(m_device->graphics_queue().handle.Submit(sub_info, *rr.fence_frame));
+    {
+        TRACE_PHASE("Submit");
+        VVK_CHECK_ACT(
+            {
+                if (frame != nullptr) m_ex_swapchain->releaseFrame(*frame);
+                return false;
+            },
+            submitFrame(m_device->graphics_queue(), rr, sub_info));
+    }
+    if (synced) {
+        // the eater waits on the semaphore, the frame is handed over without waiting for it here
+        ex->handle.signaled = true;
+        presentEx(*frame);
+    } else if (frame != nullptr) {
+        m_ex_pending.push_back({ frame, &rr });
+    }
+    return true;
+}
+
+VkResult VulkanRender::Impl::submitFrame(const QueueParameters& queue, RenderingResources& rr,
+                                         const VkSubmitInfo& info) {
+    if (m_async_compute)
+        return m_async_compute->submit(*m_device, queue, rr, info, *rr.fence_frame);
+    return m_device->Submit(queue, info, *rr.fence_frame);
+}
+
+void VulkanRender::Impl::prepareCapture(RenderingResources& rr) {
+    if (! m_capture_cb) return;
+    const auto& extent = m_finpass->result().extent;
+    // the default target is rgba8
+    const usize size = (usize)extent.width * extent.height * 4;
+    if (size == 0) return;
+    if (! m_capture_buf.handle || m_capture_buf.req_size != size) {
+        m_capture_buf = {};
+        VkBufferCreateInfo ci {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .size  = size,
+            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        };
+        VmaAllocationCreateInfo vma_info {};
+        vma_info.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+        VVK_CHECK_VOID_RE(
+            vvk::CreateBuffer(m_device->vma_allocator(), ci, vma_info, m_capture_buf.handle));
+        m_capture_buf.req_size = size;
+    }
+    m_finpass->setCapture(*m_capture_buf.handle);
+    m_capture_rr = &rr;
+}
 
+void VulkanRender::Impl::finishCapture() {
+    if (m_capture_rr == nullptr) return;
+    RenderingResources& rr = *std::exchange(m_capture_rr, nullptr);
+    TRACE_PHASE("capture");
     VVK_CHECK_VOID_RE(rr.fence_frame.Wait(vk_wait_time));
-    VVK_CHECK_VOID_RE(rr.fence_frame.Reset());
-    m_ex_swapchain->renderFrame();
+
+    void* data { nullptr };
+    VVK_CHECK_VOID_RE(m_capture_buf.handle.MapMemory(&data));
+    (void)vmaInvalidateAllocation(
+        m_device->vma_allocator(), m_capture_buf.handle.Allocation(), 0, VK_WHOLE_SIZE);
+    const auto& extent = m_finpass->result().extent;
+    auto        cb     = std::exchange(m_capture_cb, {});
+    cb({ (const uint8_t*)data, m_capture_buf.req_size }, extent.width, extent.height);
+    m_capture_buf.handle.UnMapMemory();
+}
+
+void VulkanRender::Impl::executePass(usize index, RenderingResources& rr) {
+    auto* p = m_passes[index];
+    if (! (p->prepared() && p->needsExecute())) {
+        m_barrier_plan.skip(index);
+        return;
+    }
+    m_barrier_plan.record(index, rr.command, m_discards[index]);
+    TRACE_ZONE("executePass");
+    m_profiler.beginPass(rr, index);
+    if (m_profiler.enabled() && index < m_pass_times.size()) {
+        auto start = std::chrono::steady_clock::now();
+        p->execute(*m_device, rr);
+        m_pass_times[index].cpu_ms = std::chrono::duration<double, std::milli>(
+                                         std::chrono::steady_clock::now() - start)
+                                         .count();
+    } else {
+        p->execute(*m_device, rr);
+    }
+    m_profiler.endPass(rr, index);
+}
+
+bool VulkanRender::Impl::passTimes(std::vector<PassTime>& times) {
+    auto gpu_ms = m_profiler.passTimes();
+    if (! m_profiler.enabled() || gpu_ms.size() != m_pass_times.size()) return false;
+    times = m_pass_times;
+    for (usize i = 0; i < times.size(); i++) times[i].gpu_ms = gpu_ms[i];
+    return true;
+}
+
+void VulkanRender::Impl::annotateGraph(rg::RenderGraph& rg) const {
+    if (! m_device) return;
+    auto& cache = m_device->tex_cache();
+    for (auto* node : rg.texNodes()) {
+        auto info = cache.QueryInfo(node->key());
+        if (! info) continue;
+        node->setInfo({
+            .width       = (i32)info->extent.width,
+            .height      = (i32)info->extent.height,
+            .format      = vvk::ToString(ToVkType(info->format)),
+            .bytes       = (u64)info->bytes,
+            .image       = (i64)info->image,
+            .alias_group = (i64)info->block,
+        });
+    }
 }
 
 void VulkanRender::Impl::setRenderTargetSize(Scene& scene, rg::RenderGraph& rg) {
@@ -408,8 +1246,11 @@ void VulkanRender::Impl::setRenderTargetSize(Scene& scene, rg::RenderGraph& rg)
     for (auto& item : scene.renderTargets) {
         auto& rt = item.second;
         if (rt.bind.enable && rt.bind.screen) {
-            rt.width  = (i32)(rt.bind.scale * ext.width);
-            rt.height = (i32)(rt.bind.scale * ext.height);
+            // what the layers compose on stays at native size, targets bound to the others follow
+            double scale = rt.bind.scale;
+            if (item.first != SpecTex_Default) scale *= m_res_scaler.scale();
+            rt.width  = (i32)(scale * rt.bind.axis_scale[0] * ext.width);
+            rt.height = (i32)(scale * rt.bind.axis_scale[1] * ext.height);
         }
     }
     for (auto& item : scene.renderTargets) {
@@ -420,8 +1261,8 @@ void VulkanRender::Impl::setRenderTargetSize(Scene& scene, rg::RenderGraph& rg)
             LOG_ERROR("unknonw render target bind: %s", rt.bind.name.c_str());
             continue;
         }
-        rt.width  = (i32)(rt.bind.scale * bind_rt->second.width);
-        rt.height = (i32)(rt.bind.scale * bind_rt->second.height);
+        rt.width  = (i32)(rt.bind.scale * rt.bind.axis_scale[0] * bind_rt->second.width);
+        rt.height = (i32)(rt.bind.scale * rt.bind.axis_scale[1] * bind_rt->second.height);
     }
     for (auto& item : scene.renderTargets) {
         auto& rt = item.second;
@@ -437,6 +1278,148 @@ void VulkanRender::Impl::setRenderTargetSize(Scene& scene, rg::RenderGraph& rg)
     scene.shaderValueUpdater->SetScreenSize((i32)ext.width, (i32)ext.height);
 }
 
+VulkanRender::Impl::GraphPlan& VulkanRender::Impl::graphPlan(rg::RenderGraph& rg) {
+    const usize structure = rg.structureHash();
+    auto        it = std::find_if(m_graph_plans.begin(), m_graph_plans.end(), [structure](auto& p) {
+        return p.structure == structure;
+    });
+    if (it != m_graph_plans.end()) {
+        std::rotate(m_graph_plans.begin(), it, it + 1);
+        LOG_INFO("render graph plan reused, %d passes", (int)m_graph_plans.front().order.size());
+        return m_graph_plans.front();
+    }
+    if (m_graph_plans.size() >= max_graph_plans) m_graph_plans.pop_back();
+    auto& plan     = *m_graph_plans.insert(m_graph_plans.begin(), GraphPlan {});
+    plan.structure = structure;
+
+    plan.order = rg.topologicalOrder();
+    for (auto& texs : rg.getLastReadTexs(plan.order)) {
+        auto& keys = plan.release_texs.emplace_back();
+        for (auto* tex : texs) keys.emplace_back(tex->key());
+    }
+
+    // targets each pass touches, prepass clears and finpass presents the default target
+    auto& io = plan.io;
+    io.push_back({ .reads = {}, .writes = { std::string(SpecTex_Default) } });
+    for (auto& id : plan.order) {
+        auto& pio = io.emplace_back();
+        for (auto* tex : rg.getPassReadTexs(id)) pio.reads.emplace_back(tex->key());
+        for (auto* tex : rg.getPassWriteTexs(id)) pio.writes.emplace_back(tex->key());
+    }
+    io.push_back({ .reads = { std::string(SpecTex_Default) }, .writes = {} });
+
+    // per pass, targets it writes before anything else in the frame touches them
+    plan.first_writes.resize(io.size());
+    Set<std::string_view> touched;
+    for (usize i = 0; i < io.size(); i++) {
+        for (auto& key : io[i].reads) touched.insert(key);
+        for (auto& key : io[i].writes) {
+            if (touched.insert(key).second) plan.first_writes[i].push_back(key);
+        }
+    }
+
+    // writers of one target are cached together, so such neighbours run or skip together
+    plan.joinable.assign(io.size(), false);
+    for (usize i = 2; i + 1 < io.size(); i++) {
+        auto type      = rg.getPassNode(plan.order[i - 1])->type();
+        auto prev_type = rg.getPassNode(plan.order[i - 2])->type();
+        if (type != rg::PassNode::Type::CustomShader ||
+            prev_type != rg::PassNode::Type::CustomShader)
+            continue;
+        auto& writes = io[i].writes;
+        if (writes.size() != 1 || io[i - 1].writes != writes) continue;
+        auto& reads      = io[i].reads;
+        plan.joinable[i] = std::find(reads.begin(), reads.end(), writes.front()) == reads.end();
+    }
+    plan.composites.assign(io.size(), false);
+    for (usize i = 1; i + 1 < io.size(); i++) {
+        if (rg.getPassNode(plan.order[i - 1])->type() != rg::PassNode::Type::CustomShader) continue;
+        auto& writes       = io[i].writes;
+        plan.composites[i] = writes.size() == 1 && writes.front() == SpecTex_Default;
+    }
+    return plan;
+}
+
+void VulkanRender::Impl::planMemory(Scene& scene, GraphPlan& plan) {
+    auto&     cache    = m_device->tex_cache();
+    const u32 min_bias = m_min_level_bias;
+    const u32 max_bias = std::max(vk_max_level_bias, min_bias);
+    cache.SetLevelBias(min_bias);
+
+    // of the target sizes and the textures, in whatever order the maps hold them
+    usize memory { 0 };
+    for (auto& item : scene.renderTargets) {
+        usize seed { 0 };
+        utils::hash_combine(seed, item.first);
+        utils::hash_combine(seed, item.second.width);
+        utils::hash_combine(seed, item.second.height);
+        utils::hash_combine(seed, item.second.mipmap_level);
+        utils::hash_combine(seed, (int)item.second.format);
+        memory += seed;
+    }
+    for (auto& item : scene.textures) memory += std::hash<std::string>()(item.first) * 31;
+
+    // as the headers below, ones that can't be aliased are pooled
+    VkDeviceSize fixed { 0 };
+    for (auto& item : scene.renderTargets) {
+        auto&        rt   = item.second;
+        VkDeviceSize size = TargetBytes(rt);
+        if (! rt.allowReuse) fixed += rt.mipmap_level > 1 ? size * 4 / 3 : size;
+    }
+    cache.PlanTargets(fixed);
+
+    // textures retained from earlier scenes give way to this one
+    const VkDeviceSize left   = m_device->GetBudget();
+    const VkDeviceSize budget = left > 0 ? left + cache.RetainedBytes() : 0;
+
+    // headers aren't parsed again while nothing was cut, a cut one is planned again as the
+    // budget may have grown since
+    if (plan.memory == memory && plan.level_bias == min_bias && plan.memory_needed > 0 &&
+        (budget == 0 || plan.memory_needed <= budget)) {
+        if (budget > 0 && plan.memory_needed > left) cache.TrimRetained(plan.memory_needed - left);
+        LOG_INFO("memory plan reused");
+        return;
+    }
+
+    std::vector<ImageHeader> headers;
+    if (scene.imageParser) {
+        headers.reserve(scene.textures.size());
+        for (auto& item : scene.textures)
+            headers.push_back(scene.imageParser->ParseHeader(item.first));
+    }
+    VkDeviceSize targets { 0 };
+    for (auto& item : scene.renderTargets) {
+        auto&        rt   = item.second;
+        VkDeviceSize size = TargetBytes(rt);
+        targets += rt.mipmap_level > 1 ? size * 4 / 3 : size;
+    }
+
+    TextureCache::TexEstimate texs;
+    u32                       bias { min_bias };
+    for (;; bias++) {
+        cache.SetLevelBias(bias);
+        texs = {};
+        for (auto& header : headers) {
+            auto est = cache.EstimateTex(header);
+            texs.device += est.device;
+            texs.staging += est.staging;
+        }
+        if (budget == 0 || texs.device + targets <= budget || bias >= max_bias) break;
+    }
+    plan.memory        = memory;
+    plan.level_bias    = bias;
+    plan.memory_needed = std::max<VkDeviceSize>(texs.device + targets, 1);
+    if (budget > 0 && plan.memory_needed > left) cache.TrimRetained(plan.memory_needed - left);
+
+    constexpr double mib = 1024.0 * 1024.0;
+    LOG_INFO("memory plan: textures %.1fm, targets %.1fm, staging %.1fm, budget %.1fm",
+             texs.device / mib,
+             targets / mib,
+             texs.staging / mib,
+             budget / mib);
+    if (bias > min_bias) LOG_INFO("textures cut by %u levels to fit the budget", bias);
+}
+
 void VulkanRender::Impl::UpdateCameraFillMode(wallpaper::Scene&   scene,
                                               wallpaper::FillMode fillmode) {
     using namespace wallpaper;
@@ -488,13 +1471,34 @@ void VulkanRender::Impl::UpdateCameraFillMode(wallpaper::Scene&   scene,
 }
 
 void VulkanRender::Impl::clearLastRenderGraph() {
+    m_compile.reset();
+    m_compiled.reset();
+    waitFramesInFlight();
+    waitPipelineJobs();
+    m_pipeline_cache_dirty = false;
     for (auto& p : m_passes) {
-        p->destory(*m_device, m_rendering_resources);
+        p->destory(*m_device, m_rendering_resources.front());
     }
     m_passes.clear();
-    m_device->tex_cache().Clear();
+    m_discards.clear();
+    m_pass_cache.clear();
+    m_barrier_plan.clear();
+    m_dirty_region.clear();
+    m_ubo_ring->unallocateSubRef(m_shared_uniforms.ref);
+    m_bone_palettes.written.clear();
+    m_bone_palettes.last.clear();
+    if (m_bindless) m_bindless->clear();
+    if (m_video) m_video->clear();
+    m_pass_times.clear();
+    m_profiler.setPassNum(0);
+    // no frame in flight samples them any more, freeing thousands of images is left to a job
+    looper::JobSystem::Shared().run(m_retire_jobs,
+                                    [retired = m_device->tex_cache().Retire()]() mutable {
+                                        retired.reset();
+                                    });
 
     m_vertex_buf->destroy();
+    m_static_geometry->clear();
     m_dyn_buf->destroy();
 
     m_vertex_buf->allocate();
@@ -502,68 +1506,302 @@ void VulkanRender::Impl::clearLastRenderGraph() {
 }
 
 void VulkanRender::Impl::compileRenderGraph(Scene& scene, rg::RenderGraph& rg) {
+    beginCompile(scene, rg);
+    while (! compileStep(std::chrono::microseconds::max())) {
+    }
+}
+
+void VulkanRender::Impl::beginCompile(Scene& scene, rg::RenderGraph& rg) {
+    m_compile.reset();
+    m_compiled.reset();
     if (! m_inited) return;
+    TRACE_PHASE("compileRenderGraph");
+    // a new graph costs what it costs, scaling starts over
+    m_res_scaler.reset(m_start_scale);
+    m_res_scale_changed = false;
     m_pass_loaded = false;
+    // buffers may grow while preparing
+    waitFramesInFlight();
 
-    auto nodes             = rg.topologicalOrder();
-    auto node_release_texs = rg.getLastReadTexs(nodes);
+    auto& plan  = graphPlan(rg);
+    auto& nodes = plan.order;
 
     m_passes.clear();
     m_passes.resize(nodes.size());
-
-    std::transform(nodes.begin(),
-                   nodes.end(),
-                   node_release_texs.begin(),
-                   m_passes.begin(),
-                   [&rg](auto& id, auto& texs) {
-                       auto* pass = rg.getPass(id);
-                       assert(pass != nullptr);
-                       VulkanPass* vpass = static_cast<VulkanPass*>(pass);
-                       // LOG_INFO("----release tex");
-                       for (auto& tex : texs) {
-                           vpass->addReleaseTexs(spanone<const std::string_view> { tex->key() });
-                           //    LOG_INFO("%s", tex->key().data());
-                       }
-                       return vpass;
-                   });
+    for (usize i = 0; i < nodes.size(); i++) {
+        auto* pass = rg.getPass(nodes[i]);
+        assert(pass != nullptr);
+        VulkanPass* vpass = static_cast<VulkanPass*>(pass);
+        for (auto& key : plan.release_texs[i]) {
+            vpass->addReleaseTexs(spanone<const std::string_view> { key });
+        }
+        m_passes[i] = vpass;
+    }
 
     m_passes.insert(m_passes.begin(), m_prepass.get());
     m_passes.push_back(m_finpass.get());
 
+    m_pass_times.clear();
+    m_pass_times.push_back({ .name = "prepass" });
+    for (auto& id : nodes) {
+        m_pass_times.push_back({ .name = std::string(rg.getPassNode(id)->name()), .node = id });
+    }
+    m_pass_times.push_back({ .name = "finpass" });
+    m_profiler.setPassNum(m_passes.size());
+
     setRenderTargetSize(scene, rg);
+    planMemory(scene, plan);
+
+    m_pass_cache.build(m_passes, plan.io);
+    for (auto& key : m_pass_cache.persistTexs()) m_device->tex_cache().MarkPersist(key);
+
+    // targets get their own image unless reusable, those made by copies are
+    Set<std::string> shared;
+    for (auto& pio : plan.io) {
+        for (auto& key : pio.writes) {
+            auto rt = scene.renderTargets.find(key);
+            if (rt != scene.renderTargets.end() && ! rt->second.allowReuse) continue;
+            if (! exists(m_pass_cache.persistTexs(), key)) shared.insert(key);
+        }
+    }
 
+    scene.shaderValueUpdater->UpdateSharedUniforms(m_shared_uniforms.data);
+    if (! m_shared_uniforms.ref && ! m_shared_uniforms.data.empty()) {
+        if (! m_ubo_ring->allocateSubRef(m_shared_uniforms.data.size(), m_shared_uniforms.ref))
+            LOG_ERROR("can't allocate shared uniforms");
+    }
+
+    if (scene.vfs) loadPipelineCache(*scene.vfs);
+    m_compile = Compile {
+        .scene        = &scene,
+        .rg           = &rg,
+        .first_writes = plan.first_writes,
+        .io           = plan.io,
+        .shared       = std::move(shared),
+        .joinable     = plan.joinable,
+        .composites   = plan.composites,
+    };
+}
+
+bool VulkanRender::Impl::compileStep(std::chrono::microseconds budget) {
+    if (! m_compile) return true;
+    TRACE_PHASE("compileStep");
+    auto&  scene = *m_compile->scene;
+    auto   start = std::chrono::steady_clock::now();
+    usize& next  = m_compile->prepared;
+    // one pass at least, pipelines are made there
+    do {
+        auto* p = m_passes[next++];
+        if (! p->prepared()) p->prepare(scene, *m_device, m_rendering_resources.front());
+    } while (next < m_passes.size() && std::chrono::steady_clock::now() - start < budget);
+    if (next < m_passes.size()) return false;
+
+    m_pipeline_cache_dirty = true;
+    finishCompile();
+    m_compiled = std::move(m_compile);
+    m_compile.reset();
+    return true;
+}
+
+bool VulkanRender::Impl::resize(Scene* scene, rg::RenderGraph* rg, VkExtent2D extent) {
+    if (! m_inited) return false;
+    if (! m_with_surface) {
+        // the host imported the ex swapchain images, they keep their size
+        LOG_ERROR("offscreen output can't be resized");
+        return false;
+    }
+    auto& out = m_device->out_extent();
+    if (extent.width == out.width && extent.height == out.height) return true;
+    TRACE_PHASE("resize");
+
+    waitFramesInFlight();
+    VVK_CHECK_BOOL_RE(m_device->WaitIdle());
+    if (! m_device->RecreateSwapchain(*m_instance->surface(), extent) || ! createSwapSemaphores())
+        return false;
+    // ids count per swapchain
+    m_present_id      = 0;
+    m_swapchain_stale = false;
+    m_finpass->invalidatePresents();
+    LOG_INFO("swapchain resized to %dx%d", (int)extent.width, (int)extent.height);
+
+    if (scene == nullptr || rg == nullptr) return true;
+    if (m_compile) {
+        // targets are sized as a compile begins
+        beginCompile(*scene, *rg);
+    } else if (m_compiled && m_pass_loaded) {
+        resizePasses(*scene, *rg);
+    }
+    return true;
+}
+
+void VulkanRender::Impl::resizePasses(Scene& scene, rg::RenderGraph& rg) {
+    TRACE_ZONE("resizePasses");
+    setRenderTargetSize(scene, rg);
+    planMemory(scene, graphPlan(rg));
+
+    waitPipelineJobs();
+    // aliased targets share blocks with fixed size ones, all of them are made again
+    auto& cache = m_device->tex_cache();
+    cache.ClearTargets();
+    for (auto& key : m_pass_cache.persistTexs()) cache.MarkPersist(key);
+
+    usize kept { 0 };
     for (auto* p : m_passes) {
-        if (! p->prepared()) {
-            p->prepare(scene, *m_device, m_rendering_resources);
+        if (! p->prepared()) continue;
+        if (p->resizeTargets(scene, *m_device, m_rendering_resources.front())) {
+            kept++;
+            continue;
+        }
+        p->destory(*m_device, m_rendering_resources.front());
+        p->prepare(scene, *m_device, m_rendering_resources.front());
+    }
+    LOG_INFO("%d of %d passes kept their pipelines", (int)kept, (int)m_passes.size());
+
+    m_compile        = std::move(m_compiled);
+    m_compile->scene = &scene;
+    m_compile->rg    = &rg;
+    finishCompile();
+    m_compiled = std::move(m_compile);
+    m_compile.reset();
+    // cached passes hold what they drew at the old size, frames in flight were timed at it
+    m_pass_cache.invalidate();
+    m_dirty_region.invalidate();
+    m_profiler.setPassNum(m_passes.size());
+}
+
+void VulkanRender::Impl::watchMemory() {
+    TRACE_ZONE("watchMemory");
+    auto&        cache = m_device->tex_cache();
+    VkDeviceSize usage { 0 }, budget { 0 };
+    m_device->SetFrameIndex((u32)m_mem_watch.frames());
+    m_device->GetHeapBudget(usage, budget);
+
+    if (MemoryWatch::over(usage, budget) && m_pressure_cb) {
+        MemoryStatus status {
+            .usage    = usage,
+            .budget   = budget,
+            .retained = cache.RetainedBytes(),
+            .cap      = m_mem_watch.cap(),
+            .pressure = true,
+        };
+        if (m_pressure_cb(status)) return;
+    }
+    auto result = m_mem_watch.check(usage, budget, cache.RetainedBytes());
+    switch (result.action) {
+    case MemoryWatch::Action::TRIM: cache.TrimRetained(result.trim); break;
+    case MemoryWatch::Action::CAP:
+        if (m_res_scaler.setCap(m_mem_watch.cap())) m_res_scale_changed = true;
+        break;
+    case MemoryWatch::Action::NONE: break;
+    }
+}
+
+MemoryStatus VulkanRender::Impl::memoryStatus() const {
+    return MemoryStatus {
+        .usage    = m_mem_watch.usage(),
+        .budget   = m_mem_watch.budget(),
+        .retained = m_device->tex_cache().RetainedBytes(),
+        .cap      = m_mem_watch.cap(),
+        .pressure = m_mem_watch.pressure(),
+    };
+}
+
+void VulkanRender::Impl::setGpuBudget(double ms) {
+    if (m_res_scaler.setBudget(ms)) m_res_scale_changed = true;
+}
+
+void VulkanRender::Impl::applyResolutionScale(Scene& scene) {
+    if (! (m_inited && m_pass_loaded && m_compiled && m_compiled->rg != nullptr)) return;
+    TRACE_ZONE("applyResolutionScale");
+    waitFramesInFlight();
+    resizePasses(scene, *m_compiled->rg);
+}
+
+void VulkanRender::Impl::finishCompile() {
+    auto& first_writes = m_compile->first_writes;
+    // every pass took its textures, what they didn't only holds memory
+    m_compile->scene->imageParser->DropPreloaded();
+
+    // layers drawn on to one target share a render pass, loads and stores of it between them
+    // cost most on tiled gpus
+    std::vector<bool> joined(m_passes.size(), false);
+    for (usize i = 1; i < m_passes.size(); i++) {
+        if (! m_compile->joinable[i]) continue;
+        if (! (m_passes[i - 1]->prepared() && m_passes[i]->prepared())) continue;
+        auto* prev = static_cast<CustomShaderPass*>(m_passes[i - 1]);
+        joined[i]  = static_cast<CustomShaderPass*>(m_passes[i])->joinRenderPass(*prev);
+    }
+    LOG_INFO("passes sharing the render pass of the one before: %d",
+             (int)std::count(joined.begin(), joined.end(), true));
+    LOG_INFO("pipelines shared by passes so far: %d", (int)m_device->pipelines().shared());
+    LOG_INFO("static meshes shared by passes so far: %d", (int)m_static_geometry->shared());
+    m_barrier_plan.build(m_passes, m_compile->io, m_compile->shared, joined);
+    m_dirty_region.build(
+        m_passes, m_compile->io, m_compile->composites, m_compile->shared, SpecTex_Default);
+
+    // aliased targets hold whatever shared their memory last, start them from undefined
+    m_discards.assign(m_passes.size(), {});
+    {
+        auto& aliased = m_device->tex_cache().AliasedImages();
+        for (usize i = 0; i < m_passes.size(); i++) {
+            for (auto& key : first_writes[i]) {
+                if (! exists(aliased, key)) continue;
+                m_discards[i].push_back(VkImageMemoryBarrier {
+                    .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                    .pNext               = nullptr,
+                    .srcAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    .dstAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                     VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
+                    .newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .image               = aliased.find(key)->second.handle,
+                    .subresourceRange =
+                        VkImageSubresourceRange {
+                            .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+                            .baseMipLevel   = 0,
+                            .levelCount     = VK_REMAINING_MIP_LEVELS,
+                            .baseArrayLayer = 0,
+                            .layerCount     = VK_REMAINING_ARRAY_LAYERS,
+                        },
+                });
+            }
         }
     }
 
+    // textures copy on the transfer queue while the rest is recorded
+    VkSemaphore tex_sem = m_device->tex_cache().SubmitUploads();
+
     VVK_CHECK_VOID_RE(m_upload_cmd.Begin(VkCommandBufferBeginInfo {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .pNext = nullptr,
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     }));
+    m_device->tex_cache().RecordPendingTransitions(m_upload_cmd);
     m_vertex_buf->recordUpload(m_upload_cmd);
     VVK_CHECK_VOID_RE(m_upload_cmd.End());
     {
-        // Use fence instead of WaitIdle for better performance
-        vvk::Fence upload_fence;
-        VVK_CHECK_VOID_RE(m_device->handle().CreateFence(
-            VkFenceCreateInfo {
-                .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-                .pNext = nullptr,
-                .flags = 0,
-            },
-            upload_fence));
-
-        VkSubmitInfo sub_info {
-            .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .pNext              = nullptr,
-            .commandBufferCount = 1,
-            .pCommandBuffers    = m_upload_cmd.address(),
+        // the semaphore wait also covers every later submit on this queue, so the first frame
+        // samples finished textures without the cpu waiting for them
+        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo         sub_info {
+                    .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                    .pNext              = nullptr,
+                    .waitSemaphoreCount = tex_sem != VK_NULL_HANDLE ? 1u : 0u,
+                    .pWaitSemaphores    = &tex_sem,
+                    .pWaitDstStageMask  = &wait_stage,
+                    .commandBufferCount = 1,
+                    .pCommandBuffers    = m_upload_cmd.address(),
         };
-        VVK_CHECK_VOID_RE(m_device->graphics_queue().handle.Submit(sub_info, *upload_fence));
-        VVK_CHECK_VOID_RE(upload_fence.Wait(vk_wait_time));
+        VVK_CHECK_VOID_RE(m_upload_fence.Reset());
+        VVK_CHECK_VOID_RE(m_device->Submit(m_device->graphics_queue(), sub_info, *m_upload_fence));
+
+        // frames go to another queue, no submission order to rely on
+        if (m_device->present_queue().family_index != m_device->graphics_queue().family_index) {
+            VVK_CHECK_VOID_RE(m_upload_fence.Wait(vk_wait_time));
+        }
     }
     m_pass_loaded = true;
-};
+    m_force_frame = true;
+}
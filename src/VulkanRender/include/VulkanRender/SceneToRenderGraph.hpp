@@ -10,5 +10,7 @@ namespace rg
 class RenderGraph;
 }
 
-std::unique_ptr<rg::RenderGraph> sceneToRenderGraph(Scene&);
+// occlude drops the layers beneath one covering all the camera sees with blending off, the view
+// has to stay within the scene's ortho size for that, it grows past it when fitting
+std::unique_ptr<rg::RenderGraph> sceneToRenderGraph(Scene&, bool occlude = true);
 } // namespace wallpaper
@@ -5,8 +5,15 @@
 #include "Swapchain/ExSwapchain.hpp"
 #include "Type.hpp"
 
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
 
 namespace wallpaper
 {
@@ -16,23 +23,119 @@ namespace vulkan
 {
 class FinPass;
 
+// a drawn frame got on screen, or was eaten from the ex swapchain
+using PresentedCB = std::function<void()>;
+
+struct PassTime {
+    std::string name;
+    // unset for the passes around the graph
+    std::optional<rg::NodeID> node;
+    double                    gpu_ms { 0.0 };
+    // recording it on the render thread, passes recorded ahead on jobs only submit there
+    double cpu_ms { 0.0 };
+};
+
+// device local memory, from VK_EXT_memory_budget if enabled, vma guesses from the heap sizes
+// otherwise, a budget of 0 isn't known
+struct MemoryStatus {
+    std::uint64_t usage { 0 };
+    std::uint64_t budget { 0 };
+    // of usage, textures kept from earlier scenes, see setTextureRetainBudget
+    std::uint64_t retained { 0 };
+    // the scale screen sized targets are held under for memory
+    float cap { 1.0f };
+    bool  pressure { false };
+};
+// on the render thread when usage is over the high mark, true if the host took care of it, the
+// renderer gives back retained textures and caps the target scale otherwise
+using MemoryPressureCB = std::function<bool(const MemoryStatus&)>;
+
+// what the passes of the compiled graph read besides the scene
+struct GraphMotion {
+    // a pass draws differently as time goes on
+    bool time { false };
+    // a pass follows the mouse or the audio
+    bool live { false };
+};
+
 class VulkanRender {
 public:
+    // tightly packed rgba8 texels of the frame as composed, before the present
+    using CaptureCB =
+        std::function<void(std::span<const std::uint8_t> rgba, uint32_t width, uint32_t height)>;
+
     VulkanRender();
     ~VulkanRender();
 
     bool init(RenderInitInfo);
 
     void destroy();
+    // the device destroyed and made again from the info, e.g. on another gpu, the graph must be
+    // cleared before. Callbacks, the texture settings and the resolution scale carry over
+    bool reinit(RenderInitInfo);
 
-    void drawFrame(Scene&);
+    // false if nothing was submitted, e.g. no pass changed since the last frame
+    // updated runs once the passes took the frame's values from the scene, recording and
+    // submission follow without reading it, so the scene may move on meanwhile
+    bool drawFrame(Scene&, const std::function<void()>& updated = {});
 
     void clearLastRenderGraph();
     void compileRenderGraph(Scene&, rg::RenderGraph&);
+    // the same in steps, a step prepares passes for about the budget, one at least, and is true
+    // once the graph is drawable or nothing was begun, clearLastRenderGraph drops the compile
+    void beginCompile(Scene&, rg::RenderGraph&);
+    bool compileStep(std::chrono::microseconds budget);
+    // false while pipelines of the compiled graph are still made on jobs, layers waiting for one
+    // draw nothing
+    bool pipelinesReady() const;
+    // false while levels of textures still stream in, a frame drawn meanwhile is blurrier
+    bool texturesComplete() const;
+    // of the passes of the compiled graph
+    GraphMotion graphMotion() const;
+    // the next frame is drawn even if nothing changed and read back, the callback runs on the
+    // render thread inside that drawFrame, once the gpu finished it
+    void captureNextFrame(CaptureCB);
+    // levels cut off every texture on top of what the output needs, from graphs compiled next
+    void setTextureLevelBias(uint32_t levels);
+    // the swapchain and targets at a new size, passes keep pipelines, textures and buffers
+    // false with offscreen output, the host holds its images
+    bool resize(Scene*, rg::RenderGraph*, uint32_t width, uint32_t height);
     void UpdateCameraFillMode(Scene&, wallpaper::FillMode);
+    // the scene's const uniforms were patched in place, the passes take them next frame
+    void reloadConstants();
+
+    // gpu timestamps around every pass, a few frames behind
+    void setProfiling(bool);
+    // gpu milliseconds a frame may take, screen sized targets but the one layers compose on are
+    // drawn smaller while profiled frames take longer, 0 keeps them at native size
+    void setGpuBudget(double ms);
+    // graphs compiled next start their scale there rather than at native size, with a budget
+    void  setStartScale(float);
+    // of the screen sized targets now
+    float resolutionScale() const;
+    // false until profiled frames of the current graph came back
+    bool passTimes(std::vector<PassTime>&);
+    // gpu milliseconds of a whole profiled frame, false if the last drawFrame read none back
+    bool gpuFrameTime(double&) const;
+    // tex nodes of the compiled graph get the size, format and memory of their targets
+    void annotateGraph(rg::RenderGraph&) const;
+
+    // before init, called from the render thread after a present was shown if the device can
+    // wait for presents, from the thread eating the ex swapchain otherwise
+    void setPresentedCallback(PresentedCB);
+    // bytes of textures kept from scenes cleared for later ones with the same images
+    void setTextureRetainBudget(std::uint64_t bytes);
+    // looked at every few drawn frames, the status is from the last look
+    void setMemoryPressureCallback(MemoryPressureCB);
+    bool memoryStatus(MemoryStatus&) const;
 
     ExSwapchain* exSwapchain() const;
     bool inited() const;
+    // of the device's gpu, empty before init
+    std::span<const std::uint8_t> gpuUuid() const;
+    // shaders may sample textures out of one descriptor array, scenes parsed next are translated
+    // for it, see WPShaderInfo::bindless. False before init
+    bool bindlessTextures() const;
 
 private:
     struct Impl;
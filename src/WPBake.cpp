@@ -0,0 +1,179 @@
+#include "WPBake.hpp"
+
+#include "Fs/MemBinaryStream.h"
+#include "Utils/Logging.h"
+#include "Utils/Sha.hpp"
+#include "BcEncode.hpp"
+#include "Image.hpp"
+#include "WPBundleFs.hpp"
+#include "WPTexImageParser.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include <nlohmann/json.hpp>
+
+#define BAKE_DIR "bake01"
+
+using namespace wallpaper;
+namespace sfs = std::filesystem;
+
+namespace
+{
+// a bundle, without the dot
+constexpr std::string_view bake_suffix { fs::WPBundleFs::Extension.substr(1) };
+
+std::string Vec3(double x, double y, double z) {
+    return std::to_string(x) + " " + std::to_string(y) + " " + std::to_string(z);
+}
+
+std::shared_ptr<fs::IBinaryStream> Text(const nlohmann::json& json) {
+    auto text = json.dump();
+    return std::make_shared<fs::MemBinaryStream>(std::vector<uint8_t>(text.begin(), text.end()));
+}
+
+// the view is the frame, one image of its size in the middle of an ortho camera
+std::shared_ptr<fs::IBinaryStream> SceneJson(u32 width, u32 height) {
+    nlohmann::json scene;
+    scene["camera"] = { { "center", Vec3(0, 0, -1) },
+                        { "eye", Vec3(0, 0, 0) },
+                        { "up", Vec3(0, 1, 0) } };
+    scene["general"] = {
+        { "ambientcolor", Vec3(0, 0, 0) },
+        { "skylightcolor", Vec3(0, 0, 0) },
+        { "clearcolor", Vec3(0, 0, 0) },
+        { "cameraparallax", false },
+        { "cameraparallaxamount", 0.0 },
+        { "cameraparallaxdelay", 0.0 },
+        { "cameraparallaxmouseinfluence", 0.0 },
+        { "orthogonalprojection", { { "width", width }, { "height", height } } },
+    };
+    scene["objects"] = nlohmann::json::array({ {
+        { "id", 1 },
+        { "name", "bake" },
+        { "image", "models/bake.json" },
+        { "origin", Vec3(width / 2.0, height / 2.0, 0) },
+        { "angles", Vec3(0, 0, 0) },
+        { "scale", Vec3(1, 1, 1) },
+        { "visible", true },
+    } });
+    return Text(scene);
+}
+
+std::shared_ptr<fs::IBinaryStream> ModelJson(u32 width, u32 height) {
+    return Text(
+        { { "material", "materials/bake.json" }, { "width", width }, { "height", height } });
+}
+
+std::shared_ptr<fs::IBinaryStream> MaterialJson(const std::string& tex) {
+    nlohmann::json pass = { { "blending", "normal" },
+                            { "cullmode", "nocull" },
+                            { "depthtest", "disabled" },
+                            { "depthwrite", "disabled" },
+                            { "shader", "genericimage2" },
+                            { "textures", nlohmann::json::array({ tex }) } };
+    return Text({ { "passes", nlohmann::json::array({ pass }) } });
+}
+
+// a sprite of one full frame per image, all of one size, so it's sampled as layers
+std::shared_ptr<fs::IBinaryStream> SpriteTex(u32 width, u32 height, double frame_time,
+                                             std::span<const std::vector<uint8_t>> frames) {
+    Image img;
+    auto& header     = img.header;
+    header.fromTex   = true;
+    header.texv      = 5;
+    header.texi      = 1;
+    header.format    = TextureFormat::BC1;
+    header.isSprite  = true;
+    header.width     = (i32)width;
+    header.height    = (i32)height;
+    header.mapWidth  = (i32)width;
+    header.mapHeight = (i32)height;
+    header.count     = (i32)frames.size();
+    header.sample.wrapS = header.sample.wrapT = TextureWrap::CLAMP_TO_EDGE;
+
+    const usize size = MipDataSize(TextureFormat::BC1, (i32)width, (i32)height);
+    for (usize i = 0; i < frames.size(); i++) {
+        if (frames[i].size() != size) return nullptr;
+        auto& slot  = img.slots.emplace_back();
+        slot.width  = (i32)width;
+        slot.height = (i32)height;
+        auto& mip   = slot.mipmaps.emplace_back();
+        mip.width   = slot.width;
+        mip.height  = slot.height;
+        mip.size    = (isize)size;
+        mip.fill    = [&frame = frames[i]](std::span<uint8_t> dst) {
+            if (dst.size() != frame.size()) return false;
+            std::memcpy(dst.data(), frame.data(), dst.size());
+            return true;
+        };
+        header.spriteAnim.AppendFrame(SpriteFrame {
+            .imageId = (i32)i, .frametime = (float)frame_time, .width = 1, .height = 1 });
+    }
+
+    fs::MemBinaryStreamW out;
+    if (! WPTexImageParser::WriteRaw(out, img)) return nullptr;
+    return std::make_shared<fs::MemBinaryStream>(out.Take());
+}
+} // namespace
+
+WPBake::WPBake(sfs::path dir, u64 max_bytes): m_dir(std::move(dir), max_bytes) {}
+
+std::shared_ptr<WPBake> WPBake::FromCachePath(const std::string& cache_path) {
+    if (cache_path.empty()) return nullptr;
+    const auto      dir = sfs::path(cache_path) / BAKE_DIR;
+    std::error_code ec;
+    sfs::create_directories(dir, ec);
+    if (ec) {
+        LOG_ERROR("can't create cache \'%s\': %s", dir.c_str(), ec.message().c_str());
+        return nullptr;
+    }
+    return std::make_shared<WPBake>(dir);
+}
+
+std::string WPBake::Key(std::string_view salt) { return utils::genSha1(salt); }
+
+double WPBake::CommonPeriod(std::span<const double> periods, double max) {
+    const u64 limit = (u64)std::llround(max * 1000.0);
+    u64       ms { 1 };
+    for (double p : periods) {
+        const u64 v = (u64)std::llround(p * 1000.0);
+        if (v == 0) continue;
+        ms = std::lcm(ms, v);
+        if (ms > limit) return 0.0;
+    }
+    return ms / 1000.0;
+}
+
+std::string WPBake::Find(std::string_view key) {
+    auto path = m_dir.FilePath(key, bake_suffix);
+    if (! m_dir.Open(path)) return {};
+    return path.replace_extension("json").native();
+}
+
+bool WPBake::Write(std::string_view key, u32 width, u32 height, double frame_time,
+                   std::span<const std::vector<uint8_t>> frames) {
+    const std::string tex = "baked_" + std::string(key);
+    auto              texture = SpriteTex(width, height, frame_time, frames);
+    if (! texture) return false;
+
+    std::vector<fs::WPBundleFs::Entry> entries {
+        { "/" + std::string(key) + ".json", SceneJson(width, height) },
+        { "/models/bake.json", ModelJson(width, height) },
+        { "/materials/bake.json", MaterialJson(tex) },
+        { "/materials/" + tex + ".tex", std::move(texture) },
+    };
+    if (! fs::WPBundleFs::Write(m_dir.FilePath(key, bake_suffix), entries, key)) {
+        LOG_ERROR("can't write bake \'%s\'", std::string(key).c_str());
+        return false;
+    }
+    m_dir.MarkWritten();
+    m_dir.Trim();
+    LOG_INFO("scene baked, %d frames of %ux%u, %.2fs",
+             (int)frames.size(),
+             width,
+             height,
+             frame_time * (double)frames.size());
+    return true;
+}
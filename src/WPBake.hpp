@@ -0,0 +1,45 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+#include "WPCacheDir.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wallpaper
+{
+
+// Scenes whose every motion repeats, captured over one period and played back as a loop in their
+// place. A bake is a bundle in the cache folder holding a scene of one image covering the view,
+// its material sampling a sprite tex with a bc1 layer per frame, so drawing it is one textured
+// quad. It's loaded as the source <dir>/<key>.json, MountSource finds the bundle of that name.
+class WPBake : NoCopy, NoMove {
+public:
+    constexpr static u64 DefaultMaxBytes { 2ull << 30 };
+
+    explicit WPBake(std::filesystem::path dir, u64 max_bytes = DefaultMaxBytes);
+
+    // in the cache folder, null without one
+    static std::shared_ptr<WPBake> FromCachePath(const std::string& cache_path);
+
+    // of everything the drawn scene depends on
+    static std::string Key(std::string_view salt);
+    // the least common multiple of the periods to a millisecond, 0 if it's longer than max
+    static double CommonPeriod(std::span<const double> periods, double max);
+
+    // the source to load in place of the scene, empty on a miss
+    std::string Find(std::string_view key);
+    // frames are bc1 of width x height, each shown frame_time seconds, thread safe
+    bool Write(std::string_view key, u32 width, u32 height, double frame_time,
+               std::span<const std::vector<uint8_t>> frames);
+
+private:
+    WPCacheDir m_dir;
+};
+
+} // namespace wallpaper
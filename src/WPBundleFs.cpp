@@ -0,0 +1,243 @@
+#include "WPBundleFs.hpp"
+#include "Utils/Logging.h"
+#include "Fs/CBinaryStream.h"
+#include "Fs/SpanBinaryStream.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace wallpaper;
+using namespace wallpaper::fs;
+namespace sfs = std::filesystem;
+
+namespace
+{
+constexpr std::string_view bundle_magic { "WPBUNDL1" };
+// entries start on these, 4k pages and the larger ones of some arm systems
+constexpr u64 entry_align { 16 * 1024 };
+constexpr usize head_size { 8 + 4 * 4 };
+constexpr usize entry_size { 8 * 3 + 4 * 2 };
+// copied in pieces this large
+constexpr usize copy_chunk { 1024 * 1024 };
+
+// fnv-1a, the same on every build
+u64 PathHash(std::string_view path) {
+    u64 hash { 0xcbf29ce484222325ull };
+    for (char c : path) {
+        hash ^= (u8)c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+u64 AlignUp(u64 x) { return (x + entry_align - 1) / entry_align * entry_align; }
+
+// a few slots free for every file, probes stay short
+u32 SlotCount(usize files) { return std::bit_ceil((u32)std::max<usize>(files * 2, 2)); }
+} // namespace
+
+std::unique_ptr<WPBundleFs> WPBundleFs::CreateBundleFs(std::string_view path) {
+    std::error_code ec;
+    if (! sfs::is_regular_file(path, ec)) return nullptr;
+    auto file = fs::CreateCBinaryStream(path);
+    if (! file) return nullptr;
+    auto data = file->TryMapView(0, file->Usize());
+    if (data.size() < head_size) {
+        LOG_ERROR("can't map bundle \"%s\"", path.data());
+        return nullptr;
+    }
+
+    std::unique_ptr<WPBundleFs> bundle { new WPBundleFs() };
+    bundle->m_file = file;
+    bundle->m_data = data;
+    SpanBinaryStream toc(nullptr, data);
+    char             magic[8] {};
+    toc.Read(magic, sizeof(magic));
+    const u32 file_count = toc.ReadUint32();
+    const u32 slot_count = toc.ReadUint32();
+    const u32 names_size = toc.ReadUint32();
+    const u32 stamp_size = toc.ReadUint32();
+    const u64 toc_size   = head_size + (u64)file_count * entry_size + (u64)slot_count * 4 +
+                         names_size + stamp_size;
+    if (std::string_view(magic, sizeof(magic)) != bundle_magic || slot_count == 0 ||
+        ! std::has_single_bit(slot_count) || slot_count < file_count || toc_size > data.size()) {
+        LOG_ERROR("broken bundle toc \"%s\"", path.data());
+        return nullptr;
+    }
+
+    auto& files = bundle->m_files;
+    files.resize(file_count);
+    for (auto& f : files) {
+        f.hash        = toc.ReadUint64();
+        f.offset      = toc.ReadUint64();
+        f.length      = toc.ReadUint64();
+        f.name_offset = toc.ReadUint32();
+        f.name_length = toc.ReadUint32();
+        if (f.offset > data.size() || f.length > data.size() - f.offset ||
+            (u64)f.name_offset + f.name_length > names_size) {
+            LOG_ERROR("bundle \"%s\" has an entry out of the file", path.data());
+            return nullptr;
+        }
+    }
+    bundle->m_slots.resize(slot_count);
+    if (! toc.ReadInts(bundle->m_slots.data(), slot_count) ||
+        std::any_of(bundle->m_slots.begin(), bundle->m_slots.end(), [file_count](u32 s) {
+            return s > file_count;
+        })) {
+        LOG_ERROR("broken bundle toc \"%s\"", path.data());
+        return nullptr;
+    }
+    auto names      = data.subspan((usize)toc.Tell(), names_size);
+    bundle->m_names = { (const char*)names.data(), names.size() };
+    auto stamp      = data.subspan((usize)toc.Tell() + names_size, stamp_size);
+    bundle->m_stamp.assign((const char*)stamp.data(), stamp.size());
+    return bundle;
+}
+
+bool WPBundleFs::Write(const sfs::path& out, std::span<const Entry> entries,
+                       std::string_view stamp) {
+    const u32         slot_count = SlotCount(entries.size());
+    std::vector<u32>  slots(slot_count, 0);
+    std::vector<File> files(entries.size());
+    std::string       names;
+
+    u64 toc_size = head_size + (u64)entries.size() * entry_size + (u64)slot_count * 4;
+    for (usize i = 0; i < entries.size(); i++) {
+        auto& e = entries[i];
+        auto& f = files[i];
+        f.hash        = PathHash(e.path);
+        f.length      = e.file ? (u64)e.file->Size() : 0;
+        f.name_offset = (u32)names.size();
+        f.name_length = (u32)e.path.size();
+        names += e.path;
+
+        u32 slot = (u32)f.hash & (slot_count - 1);
+        while (slots[slot] != 0) slot = (slot + 1) & (slot_count - 1);
+        slots[slot] = (u32)i + 1;
+    }
+    toc_size += names.size() + stamp.size();
+    u64 offset = AlignUp(toc_size);
+    for (auto& f : files) {
+        f.offset = offset;
+        offset   = AlignUp(offset + f.length);
+    }
+
+    auto tmp = out;
+    tmp += ".tmp";
+    bool read { true };
+    {
+        auto file = fs::CreateCBinaryStreamW(tmp.native());
+        if (! file) return false;
+        file->Write(bundle_magic.data(), bundle_magic.size());
+        file->WriteUint32((u32)files.size());
+        file->WriteUint32(slot_count);
+        file->WriteUint32((u32)names.size());
+        file->WriteUint32((u32)stamp.size());
+        for (auto& f : files) {
+            file->WriteUint64(f.hash);
+            file->WriteUint64(f.offset);
+            file->WriteUint64(f.length);
+            file->WriteUint32(f.name_offset);
+            file->WriteUint32(f.name_length);
+        }
+        for (u32 s : slots) file->WriteUint32(s);
+        file->Write(names.data(), names.size());
+        file->Write(stamp.data(), stamp.size());
+
+        std::vector<char> buf(copy_chunk);
+        u64               pos { toc_size };
+        for (usize i = 0; i < files.size() && read; i++) {
+            std::fill(buf.begin(), buf.end(), 0);
+            file->Write(buf.data(), (usize)(files[i].offset - pos));
+            pos = files[i].offset;
+
+            auto& in = entries[i].file;
+            if (in) in->SeekSet(0);
+            for (u64 left = files[i].length; left > 0 && read;) {
+                usize n = (usize)std::min<u64>(left, buf.size());
+                if (in->Read(buf.data(), n) != n) {
+                    LOG_ERROR("can't read \"%s\" for the bundle", entries[i].path.c_str());
+                    read = false;
+                    break;
+                }
+                file->Write(buf.data(), n);
+                left -= n;
+            }
+            pos += files[i].length;
+        }
+    }
+
+    // the whole of it made it to disk, the last entry ends it
+    std::error_code ec;
+    const u64       expect = files.empty() ? toc_size : files.back().offset + files.back().length;
+    if (! read || sfs::file_size(tmp, ec) != expect || ec) {
+        LOG_ERROR("can't write bundle \"%s\"", out.c_str());
+        sfs::remove(tmp, ec);
+        return false;
+    }
+    sfs::rename(tmp, out, ec);
+    if (ec) {
+        LOG_ERROR("can't write bundle \"%s\": %s", out.c_str(), ec.message().c_str());
+        sfs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+const WPBundleFs::File* WPBundleFs::find(std::string_view p) const {
+    const u32 mask = (u32)m_slots.size() - 1;
+    const u64 hash = PathHash(p);
+    // a slot left empty ends the probe, every file has one ahead of it
+    for (u32 slot = (u32)hash & mask, n = 0; n < m_slots.size(); slot = (slot + 1) & mask, n++) {
+        const u32 index = m_slots[slot];
+        if (index == 0) return nullptr;
+        const auto& f = m_files[index - 1];
+        if (f.hash == hash && path(f) == p) return &f;
+    }
+    return nullptr;
+}
+
+bool WPBundleFs::Contains(std::string_view path) const { return find(path) != nullptr; }
+
+std::shared_ptr<IBinaryStream> WPBundleFs::Open(std::string_view path) {
+    auto* f = find(path);
+    if (f == nullptr) return nullptr;
+    return std::make_shared<SpanBinaryStream>(m_file,
+                                              m_data.subspan((usize)f->offset, (usize)f->length));
+}
+
+std::shared_ptr<IBinaryStreamW> WPBundleFs::OpenW(std::string_view) { return nullptr; }
+
+std::vector<std::string_view> WPBundleFs::Files() const {
+    std::vector<std::string_view> files;
+    files.reserve(m_files.size());
+    for (auto& f : m_files) files.push_back(path(f));
+    return files;
+}
+
+std::string WPBundleFs::Stamp() const { return m_stamp; }
+
+void WPBundleFs::ReadAsync(std::string_view path, idx offset, usize size, ReadDone done) {
+    auto* f = find(path);
+    if (f == nullptr || offset < 0 || (u64)offset > f->length) return done(nullptr);
+    if (size == AsyncReader::ToEnd) size = (usize)(f->length - (u64)offset);
+    if ((u64)size > f->length - (u64)offset) return done(nullptr);
+    done(std::make_shared<SpanBinaryStream>(
+        m_file, m_data.subspan((usize)(f->offset + (u64)offset), size)));
+}
+
+void WPBundleFs::Prefetch() {
+    // the entries are back to back, one range but the toc
+    if (m_files.empty()) return;
+    const usize page = (usize)::sysconf(_SC_PAGESIZE);
+    const usize from = (usize)m_files.front().offset / page * page;
+    ::madvise(const_cast<uint8_t*>(m_data.data() + from), m_data.size() - from, MADV_WILLNEED);
+    LOG_INFO("prefetch the bundle, %lld KB", (long long)((m_data.size() - from) / 1024));
+}
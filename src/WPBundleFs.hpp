@@ -0,0 +1,73 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <vector>
+#include "Fs/Fs.h"
+#include "Core/Literals.hpp"
+
+namespace wallpaper
+{
+namespace fs
+{
+// A wallpaper repacked for loading by wpBundle, in place of its pkg. Entries start on a page of
+// their own, so the mapped bundle hands out views fit for mapped reads and uploads, the toc is a
+// hash table used as is. Its tex files hold decoded mips, bc where transcoded, and the scene and
+// shader caches of a load come along under WPCacheDir::BundledDir.
+//
+// Little endian: the magic, file, slot, names and stamp sizes as u32, per file its path hash,
+// offset and length as u64 and its name offset and length as u32, the slots as u32, a file index
+// plus one or 0, probed linearly from the path hash, then the names, the stamp and the entries.
+class WPBundleFs : public Fs {
+public:
+    constexpr static std::string_view Extension { ".wpb" };
+
+    virtual ~WPBundleFs() = default;
+    // null if there is none or it's broken, bundles are only read mapped
+    static std::unique_ptr<WPBundleFs> CreateBundleFs(std::string_view path);
+
+    struct Entry {
+        // with the leading slash
+        std::string                    path;
+        std::shared_ptr<IBinaryStream> file;
+    };
+    // to a temporary file renamed into place, the stamp stands for the content, it's what the
+    // caches of the bundle's loads keep
+    static bool Write(const std::filesystem::path&, std::span<const Entry>, std::string_view stamp);
+
+private:
+    WPBundleFs() = default;
+
+public:
+    bool                            Contains(std::string_view path) const override;
+    std::shared_ptr<IBinaryStream>  Open(std::string_view path) override;
+    std::shared_ptr<IBinaryStreamW> OpenW(std::string_view path) override;
+    std::vector<std::string_view>   Files() const override;
+    std::string                     Stamp() const override;
+    void                            Prefetch() override;
+    // a view right away
+    void ReadAsync(std::string_view path, idx offset, usize size, ReadDone done) override;
+
+private:
+    struct File {
+        u64 hash { 0 };
+        u64 offset { 0 };
+        u64 length { 0 };
+        u32 name_offset { 0 };
+        u32 name_length { 0 };
+    };
+    const File* find(std::string_view path) const;
+    std::string_view path(const File& f) const {
+        return m_names.substr(f.name_offset, f.name_length);
+    }
+
+    // owns the mapping
+    std::shared_ptr<IBinaryStream> m_file;
+    std::span<const uint8_t>       m_data;
+    std::vector<File>              m_files;
+    std::vector<u32>               m_slots;
+    std::string_view               m_names;
+    std::string                    m_stamp;
+};
+} // namespace fs
+} // namespace wallpaper
@@ -0,0 +1,144 @@
+#include "WPCacheDir.hpp"
+
+#include "Fs/VFS.h"
+#include "Fs/CBinaryStream.h"
+#include "Utils/Logging.h"
+#include "Utils/Counters.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace wallpaper;
+namespace sfs = std::filesystem;
+
+namespace
+{
+// what a crashed writer leaves behind, younger ones may still be written
+constexpr auto stale_tmp_age = std::chrono::hours(1);
+// trim below the limit, so the next loads don't trim again
+constexpr u64 trim_to_percent { 75 };
+
+// unique among the processes and threads writing the directory
+std::string TmpSuffix() {
+    static std::atomic<u32> counter { 0 };
+    return "." + std::to_string(::getpid()) + "." + std::to_string(counter++) + ".tmp";
+}
+} // namespace
+
+WPCacheDir::WPCacheDir(sfs::path dir, u64 max_bytes)
+    : m_dir(std::move(dir)), m_max_bytes(max_bytes) {}
+
+sfs::path WPCacheDir::FromVfs(fs::VFS& vfs, std::string_view sub) {
+    if (! vfs.IsMounted("cache")) return {};
+    auto dir = vfs.NativePath("/cache/" + std::string(sub));
+    if (dir.empty()) return {};
+
+    std::error_code ec;
+    sfs::create_directories(dir, ec);
+    if (ec) {
+        LOG_ERROR("can't create cache \'%s\': %s", dir.c_str(), ec.message().c_str());
+        return {};
+    }
+    return dir;
+}
+
+fs::VFS* WPCacheDir::Bundled(fs::VFS& vfs) {
+    return vfs.Contains("/assets" + std::string(BundledMark)) ? &vfs : nullptr;
+}
+
+void WPCacheDir::SetBundled(fs::VFS* vfs, std::string_view sub) {
+    m_bundled     = vfs;
+    m_bundled_dir = "/assets" + std::string(BundledDir) + std::string(sub) + "/";
+}
+
+sfs::path WPCacheDir::FilePath(std::string_view key, std::string_view suffix) const {
+    return m_dir / (std::string(key) + "." + std::string(suffix));
+}
+
+std::shared_ptr<fs::IBinaryStream> WPCacheDir::Open(const sfs::path& path) {
+    if (m_bundled != nullptr) {
+        auto bundled = m_bundled_dir + path.filename().native();
+        if (m_bundled->Contains(bundled)) return m_bundled->Open(bundled);
+    }
+    if (m_dir.empty()) return nullptr;
+    std::error_code ec;
+    if (! sfs::exists(path, ec)) return nullptr;
+    auto file = fs::CreateCBinaryStream(path.native());
+    if (file) sfs::last_write_time(path, sfs::file_time_type::clock::now(), ec);
+    return file;
+}
+
+bool WPCacheDir::WriteFile(const sfs::path&                                path,
+                           const std::function<void(fs::IBinaryStreamW&)>& write) {
+    if (m_dir.empty()) return false;
+    auto tmp = path;
+    tmp += TmpSuffix();
+    {
+        auto file = fs::CreateCBinaryStreamW(tmp.native());
+        if (! file) return false;
+        write(*file);
+    }
+    // replaces atomically, a reader sees the old file or the new one
+    std::error_code ec;
+    sfs::rename(tmp, path, ec);
+    if (ec) {
+        LOG_ERROR("can't write cache \'%s\': %s", path.c_str(), ec.message().c_str());
+        sfs::remove(tmp, ec);
+        return false;
+    }
+    m_saved = true;
+    return true;
+}
+
+void WPCacheDir::Trim() {
+    if (! m_saved.exchange(false)) return;
+
+    struct Entry {
+        sfs::path           path;
+        sfs::file_time_type time;
+        u64                 size;
+    };
+    std::vector<Entry> entries;
+    u64                total { 0 };
+
+    const auto      now = sfs::file_time_type::clock::now();
+    std::error_code ec;
+    for (auto it = sfs::directory_iterator(m_dir, ec); ! ec && it != sfs::directory_iterator();
+         it.increment(ec)) {
+        Entry e { it->path(), it->last_write_time(ec), 0 };
+        if (ec) continue;
+        if (e.path.extension() == ".tmp") {
+            if (now - e.time > stale_tmp_age) sfs::remove(e.path, ec);
+            continue;
+        }
+        e.size = it->file_size(ec);
+        if (ec) continue;
+        total += e.size;
+        entries.push_back(std::move(e));
+    }
+    ec.clear();
+    if (total <= m_max_bytes) return;
+
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+        return a.time < b.time;
+    });
+    const u64 target  = m_max_bytes / 100 * trim_to_percent;
+    usize     removed = 0;
+    const u64 before  = total;
+    for (auto& e : entries) {
+        if (total <= target) break;
+        // may be gone already, trimmed by another process
+        sfs::remove(e.path, ec);
+        total -= e.size;
+        removed++;
+    }
+    counters::Add(counters::Counter::DiskEvictions, removed);
+    counters::Add(counters::Counter::DiskEvictedBytes, before - total);
+    LOG_INFO("cache \'%s\' trimmed %d files, %d KiB left",
+             m_dir.filename().c_str(),
+             removed,
+             total >> 10);
+}
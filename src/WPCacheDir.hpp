@@ -0,0 +1,62 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace wallpaper
+{
+namespace fs
+{
+class VFS;
+class IBinaryStream;
+class IBinaryStreamW;
+} // namespace fs
+
+// A directory of the cache folder shared by renderer processes. Files are written under a
+// temporary name and renamed into place, a hit refreshes the file time and Trim removes the
+// least recently used files when the directory grows past its limit.
+// A bundle mounted at /assets may carry files of the directory, which are read before it, a
+// directory of an empty path only reads those.
+class WPCacheDir : NoCopy, NoMove {
+public:
+    // where a bundle keeps them, directories as in the cache folder, and the file telling it does
+    constexpr static std::string_view BundledDir { "/.cache/" };
+    constexpr static std::string_view BundledMark { "/.cache/bundled" };
+
+    WPCacheDir(std::filesystem::path dir, u64 max_bytes);
+
+    // sub in the mounted cache folder, created, empty when there is none or it's not on disk
+    static std::filesystem::path FromVfs(fs::VFS&, std::string_view sub);
+    // the vfs if a bundle with cache files is mounted at its /assets, null otherwise
+    static fs::VFS* Bundled(fs::VFS&);
+    // files of sub the bundle carries are read from it, the vfs must outlive this
+    void SetBundled(fs::VFS*, std::string_view sub);
+
+    std::filesystem::path FilePath(std::string_view key, std::string_view suffix) const;
+
+    // null on a miss, another process may trim the file meanwhile
+    std::shared_ptr<fs::IBinaryStream> Open(const std::filesystem::path&);
+    // to a temporary file renamed into place, thread safe
+    bool WriteFile(const std::filesystem::path&, const std::function<void(fs::IBinaryStreamW&)>&);
+
+    // a file was put into the directory some other way, Trim looks at it
+    void MarkWritten() { m_saved = true; }
+    // after something was written, cheap otherwise
+    void Trim();
+
+private:
+    std::filesystem::path m_dir;
+    u64                   m_max_bytes;
+    std::atomic<bool>     m_saved { false };
+
+    fs::VFS*    m_bundled { nullptr };
+    std::string m_bundled_dir;
+};
+
+} // namespace wallpaper
@@ -1,6 +1,7 @@
 #include "WPJson.hpp"
 #include <nlohmann/json.hpp>
 
+#include "Fs/VFS.h"
 #include "Utils/Identity.hpp"
 #include "Utils/String.h"
 #include "WPUserProperties.hpp"
@@ -8,25 +9,70 @@
 namespace wallpaper
 {
 
+namespace
+{
+thread_local JsonFileCache* t_json_cache { nullptr };
+
+// of a string's heap, short ones are kept inside it
+usize StringHeap(const std::string& str) {
+    return str.capacity() > std::string().capacity() ? str.capacity() + 1 : 0;
+}
+} // namespace
+
+usize JsonBytes(const nlohmann::json& json) {
+    using value_t = nlohmann::json::value_t;
+    // the tree node of an object's member, its colour and three links
+    constexpr usize node { 4 * sizeof(void*) };
+    usize           bytes { sizeof(nlohmann::json) };
+    switch (json.type()) {
+    case value_t::object:
+        bytes += sizeof(nlohmann::json::object_t);
+        for (auto& [key, value] : json.get_ref<const nlohmann::json::object_t&>())
+            bytes += node + sizeof(std::string) + StringHeap(key) + JsonBytes(value);
+        break;
+    case value_t::array: {
+        auto& array = json.get_ref<const nlohmann::json::array_t&>();
+        bytes += sizeof(array) + (array.capacity() - array.size()) * sizeof(nlohmann::json);
+        for (auto& value : array) bytes += JsonBytes(value);
+        break;
+    }
+    case value_t::string: {
+        auto& str = json.get_ref<const std::string&>();
+        bytes += sizeof(str) + StringHeap(str);
+        break;
+    }
+    case value_t::binary:
+        bytes += sizeof(nlohmann::json::binary_t) +
+                 json.get_ref<const nlohmann::json::binary_t&>().capacity();
+        break;
+    default: break;
+    }
+    return bytes;
+}
+
 // Resolve user property reference if present
-// Returns the resolved JSON value (either from user properties or default value)
-static nlohmann::json ResolveUserProperty(const nlohmann::json& json) {
-    if (!json.is_object() || !json.contains("user")) {
+// Returns the json a value is read from, holder keeps a value resolved from user properties,
+// anything else is returned in place without a copy
+static const nlohmann::json& ResolveUserProperty(const nlohmann::json& json,
+                                                 nlohmann::json&       holder) {
+    if (! json.is_object() || ! json.contains("user")) {
         return json;
     }
 
     if (g_currentUserProperties != nullptr) {
-        return g_currentUserProperties->ResolveValue(json);
+        holder = g_currentUserProperties->ResolveValue(json);
+        return holder;
     }
 
     // No user properties context, use default value
-    if (json.contains("value")) {
-        return json["value"];
+    auto value = json.find("value");
+    if (value != json.end()) {
+        return *value;
     }
     return json;
 }
 
-bool ParseJson(const char* file, const char* func, int line, const std::string& source,
+bool ParseJson(const char* file, const char* func, int line, std::string_view source,
                nlohmann::json& result) {
     try {
         result = nlohmann::json::parse(source);
@@ -37,16 +83,82 @@ bool ParseJson(const char* file, const char* func, int line, const std::string&
     return true;
 }
 
+bool ParseJsonFile(const char* file, const char* func, int line, fs::VFS& vfs,
+                   std::string_view path, nlohmann::json& result) {
+    auto f = vfs.Open(path);
+    if (! f) {
+        WallpaperLog(LOGLEVEL_ERROR, file, line, "parse json(%s), can't open %s", func,
+                     std::string(path).c_str());
+        return false;
+    }
+    auto view = f->View();
+    if (view.empty()) return ParseJson(file, func, line, f->ReadAllStr(), result);
+    return ParseJson(
+        file, func, line, { reinterpret_cast<const char*>(view.data()), view.size() }, result);
+}
+
+std::shared_ptr<const nlohmann::json> ParseJsonFileShared(const char* file, const char* func,
+                                                          int line, fs::VFS& vfs,
+                                                          std::string_view path) {
+    auto* cache = JsonFileCache::Current();
+    if (cache != nullptr) {
+        if (auto json = cache->Find(path)) return json;
+    }
+    auto json = std::make_shared<nlohmann::json>();
+    if (! ParseJsonFile(file, func, line, vfs, path, *json)) return nullptr;
+    if (cache != nullptr) cache->Insert(path, json);
+    return json;
+}
+
+JsonFileCache* JsonFileCache::Current() { return t_json_cache; }
+
+std::shared_ptr<const nlohmann::json> JsonFileCache::Find(std::string_view path) const {
+    std::lock_guard lock(m_lock);
+    auto            it = m_files.find(path);
+    if (it == m_files.end()) return nullptr;
+    m_hits++;
+    return it->second;
+}
+
+void JsonFileCache::Insert(std::string_view path, std::shared_ptr<const nlohmann::json> json) {
+    const usize     bytes = json ? JsonBytes(*json) : 0;
+    std::lock_guard lock(m_lock);
+    auto&           slot = m_files[std::string(path)];
+    m_held.set(m_held.bytes() + bytes - (slot ? JsonBytes(*slot) : 0));
+    slot = std::move(json);
+}
+
+usize JsonFileCache::hits() const {
+    std::lock_guard lock(m_lock);
+    return m_hits;
+}
+
+usize JsonFileCache::size() const {
+    std::lock_guard lock(m_lock);
+    return m_files.size();
+}
+
+std::vector<JsonFileCache::File> JsonFileCache::Files() const {
+    std::lock_guard lock(m_lock);
+    return { m_files.begin(), m_files.end() };
+}
+
+JsonFileCache::Scope::Scope(JsonFileCache* cache): m_previous(t_json_cache) {
+    t_json_cache = cache;
+}
+JsonFileCache::Scope::~Scope() { t_json_cache = m_previous; }
+
 template<typename T>
 inline bool _GetJsonValue(const nlohmann::json&                  json,
                           typename utils::is_std_array<T>::type& value) {
     using Tv = typename T::value_type;
 
     // Resolve user property reference first
-    nlohmann::json resolved = ResolveUserProperty(json);
+    nlohmann::json holder;
+    const auto&    resolved = ResolveUserProperty(json, holder);
 
     const auto* pjson = &resolved;
-    if (resolved.contains("value")) pjson = &resolved.at("value");
+    if (auto it = resolved.find("value"); it != resolved.end()) pjson = &*it;
     const auto& njson = *pjson;
     if (njson.is_number()) {
         value = { njson.get<Tv>() };
@@ -61,10 +173,11 @@ inline bool _GetJsonValue(const nlohmann::json&                  json,
 template<typename T>
 inline bool _GetJsonValue(const nlohmann::json& json, T& value) {
     // Resolve user property reference first
-    nlohmann::json resolved = ResolveUserProperty(json);
+    nlohmann::json holder;
+    const auto&    resolved = ResolveUserProperty(json, holder);
 
-    if (resolved.contains("value"))
-        value = resolved.at("value").get<T>();
+    if (auto it = resolved.find("value"); it != resolved.end())
+        value = it->get<T>();
     else
         value = resolved.get<T>();
     return true;
@@ -104,8 +217,10 @@ typename JsonTemplateTypeCheck<T>::type
 GetJsonValue(const char* file, const char* func, int line, const nlohmann::json& json, T& value,
              bool has_name, std::string_view name_view, bool warn) {
     std::string name { name_view };
+    // one lookup, the key is looked at three times otherwise
+    auto it = has_name ? json.find(name) : json.end();
     if (has_name) {
-        if (! json.contains(name)) {
+        if (it == json.end()) {
             if (warn)
                 WallpaperLog(LOGLEVEL_INFO,
                              "",
@@ -116,7 +231,7 @@ GetJsonValue(const char* file, const char* func, int line, const nlohmann::json&
                              file,
                              line);
             return false;
-        } else if (json.at(name).is_null()) {
+        } else if (it->is_null()) {
             if (warn)
                 WallpaperLog(LOGLEVEL_INFO,
                              "",
@@ -132,7 +247,7 @@ GetJsonValue(const char* file, const char* func, int line, const nlohmann::json&
     return _GetJsonValue<T>(file,
                             func,
                             line,
-                            has_name ? json.at(name) : json,
+                            has_name ? *it : json,
                             value,
                             warn,
                             name.empty() ? nullptr : name.c_str());
@@ -1,10 +1,19 @@
 #pragma once
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <nlohmann/json_fwd.hpp>
+#include <string>
 #include <string_view>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
+#include "Core/Literals.hpp"
+#include "Core/MapSet.hpp"
+#include "Core/NoCopyMove.hpp"
 #include "Utils/Logging.h"
+#include "Utils/MemUse.hpp"
 
 #define GET_JSON_VALUE(json, value) \
     wallpaper::GetJsonValue(        \
@@ -22,9 +31,17 @@
 
 #define PARSE_JSON(source, result) \
     wallpaper::ParseJson(__SHORT_FILE__, __FUNCTION__, __LINE__, (source), (result))
+#define PARSE_JSON_FILE(vfs, path, result) \
+    wallpaper::ParseJsonFile(__SHORT_FILE__, __FUNCTION__, __LINE__, (vfs), (path), (result))
+#define PARSE_JSON_FILE_SHARED(vfs, path) \
+    wallpaper::ParseJsonFileShared(__SHORT_FILE__, __FUNCTION__, __LINE__, (vfs), (path))
 
 namespace wallpaper
 {
+namespace fs
+{
+class VFS;
+}
 
 template<typename T>
 struct JsonTemplateTypeCheck {
@@ -37,6 +54,50 @@ typename wallpaper::JsonTemplateTypeCheck<T>::type
 GetJsonValue(const char* file, const char* func, int line, const nlohmann::json& json, T& value,
              bool has_name, std::string_view name, bool warn);
 
-bool ParseJson(const char* file, const char* func, int line, const std::string& source,
+bool ParseJson(const char* file, const char* func, int line, std::string_view source,
                nlohmann::json& result);
+// parses the file in place when the vfs can map it
+bool ParseJsonFile(const char* file, const char* func, int line, fs::VFS& vfs,
+                   std::string_view path, nlohmann::json& result);
+// null on failure, a file parsed before while a JsonFileCache is current is not parsed again
+std::shared_ptr<const nlohmann::json> ParseJsonFileShared(const char* file, const char* func,
+                                                          int line, fs::VFS& vfs,
+                                                          std::string_view path);
+
+// what a parsed json holds in memory, its values, strings and the nodes of its objects, about
+// since allocator overhead isn't known
+usize JsonBytes(const nlohmann::json&);
+
+// Parsed json files by path, one is made current for a scene parse so materials and particles
+// shared by many objects are read once. The files are kept raw, user properties still resolve
+// when values are read.
+class JsonFileCache : NoCopy, NoMove {
+public:
+    static JsonFileCache* Current();
+
+    std::shared_ptr<const nlohmann::json> Find(std::string_view path) const;
+    void Insert(std::string_view path, std::shared_ptr<const nlohmann::json>);
+    usize hits() const;
+    usize size() const;
+
+    using File = std::pair<std::string, std::shared_ptr<const nlohmann::json>>;
+    // what was read so far, by path
+    std::vector<File> Files() const;
+
+    // makes a cache current on this thread for the scope, objects read on jobs share one
+    class Scope : NoCopy, NoMove {
+    public:
+        explicit Scope(JsonFileCache*);
+        ~Scope();
+
+    private:
+        JsonFileCache* m_previous;
+    };
+
+private:
+    mutable std::mutex                                      m_lock;
+    Map<std::string, std::shared_ptr<const nlohmann::json>> m_files;
+    mutable usize                                           m_hits { 0 };
+    memuse::Held                                            m_held { memuse::Pool::Json };
+};
 } // namespace wallpaper
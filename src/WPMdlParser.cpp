@@ -1,7 +1,6 @@
 #include "WPMdlParser.hpp"
 #include "Fs/VFS.h"
 #include "Fs/IBinaryStream.h"
-#include "Fs/MemBinaryStream.h"
 #include "WPCommon.hpp"
 #include "Utils/Logging.h"
 #include "Scene/SceneMesh.h"
@@ -9,6 +8,8 @@
 #include "wpscene/WPMaterial.h"
 #include "WPShaderParser.hpp"
 
+#include <cstddef>
+
 using namespace wallpaper;
 
 namespace
@@ -39,12 +40,18 @@ constexpr uint32_t alt_format_vertex_size_herald_value = 0x0180000F;
 
 constexpr uint32_t singile_bone_frame = 4 * 9;
 
-bool WPMdlParser::Parse(std::string_view path, fs::VFS& vfs, WPMdl& mdl) {
+// the file's layouts, so vertices and indices are read in bulk
+static_assert(sizeof(WPMdl::Vertex) == singile_vertex);
+static_assert(offsetof(WPMdl::Vertex, blend_indices) == sizeof(WPMdl::Vertex::position));
+static_assert(sizeof(std::array<uint16_t, 3>) == singile_indices);
+
+bool WPMdlParser::Parse(std::string_view path, fs::VFS& vfs, WPMdl& mdl,
+                        std::shared_ptr<fs::IBinaryStream> read) {
     auto str_path = std::string(path);
-    auto pfile    = vfs.Open("/assets/" + str_path);
-    auto memfile  = fs::MemBinaryStream(*pfile);
+    // a view of a mapped pkg or the whole file read in at once
+    auto pfile = read ? std::move(read) : vfs.ReadAsync("/assets/" + str_path).get();
     if (! pfile) return false;
-    auto& f = memfile;
+    fs::IBinaryStream& f = *pfile;
 
     mdl.mdlv = ReadMDLVesion(f);
 
@@ -87,12 +94,27 @@ bool WPMdlParser::Parse(std::string_view path, fs::VFS& vfs, WPMdl& mdl) {
     // position and blend indices
     uint32_t vertex_num = vertex_size / (alt_mdl_format ? alt_singile_vertex : singile_vertex);
     mdl.vertexs.resize(vertex_num);
-    for (auto& vert : mdl.vertexs) {
-        for (auto& v : vert.position) v = f.ReadFloat();
-        if(alt_mdl_format) {for (int i = 0; i < 7; i++) f.ReadUint32();}
-        for (auto& v : vert.blend_indices) v = f.ReadUint32();
-        for (auto& v : vert.weight) v = f.ReadFloat();
-        for (auto& v : vert.texcoord) v = f.ReadFloat();
+    // vertices are read as they lie in the file, floats are never swapped
+    bool vertex_read = true;
+    if (! alt_mdl_format) {
+        vertex_read = f.Read(mdl.vertexs.data(), vertex_size) == vertex_size;
+    } else {
+        constexpr usize tail = singile_vertex - sizeof(WPMdl::Vertex::position);
+        for (auto& vert : mdl.vertexs) {
+            if (! vertex_read) break;
+            vertex_read = f.Read(vert.position.data(), sizeof(vert.position)) ==
+                              sizeof(vert.position) &&
+                          f.SeekCur(4 * 7) && f.Read(vert.blend_indices.data(), tail) == tail;
+        }
+    }
+    if (! vertex_read) {
+        LOG_ERROR("mdl '%s' ends in its vertices", str_path.c_str());
+        return false;
+    }
+    if (f.Swaps()) {
+        for (auto& vert : mdl.vertexs) {
+            for (auto& v : vert.blend_indices) v = fs::bswap<uint32_t>(v);
+        }
     }
 
     uint32_t indices_size = f.ReadUint32();
@@ -103,8 +125,9 @@ bool WPMdlParser::Parse(std::string_view path, fs::VFS& vfs, WPMdl& mdl) {
 
     uint32_t indices_num = indices_size / singile_indices;
     mdl.indices.resize(indices_num);
-    for (auto& id : mdl.indices) {
-        for (auto& v : id) v = f.ReadUint16();
+    if (! f.ReadInts(mdl.indices.data()->data(), indices_num * 3)) {
+        LOG_ERROR("mdl '%s' ends in its indices", str_path.c_str());
+        return false;
     }
 
     mdl.mdls = ReadMDLVesion(f);
@@ -20,6 +20,7 @@ class WPMaterial;
 namespace fs
 {
 class VFS;
+class IBinaryStream;
 };
 
 struct WPMdl {
@@ -53,7 +54,9 @@ class SceneMesh;
 
 class WPMdlParser {
 public:
-    static bool Parse(std::string_view path, fs::VFS&, WPMdl&);
+    // read, the file as VFS::ReadAsync gave it, the file is read here if null
+    static bool Parse(std::string_view path, fs::VFS&, WPMdl&,
+                      std::shared_ptr<fs::IBinaryStream> read = nullptr);
 
     static void AddPuppetShaderInfo(WPShaderInfo& info, const WPMdl& mdl);
     static void AddPuppetMatInfo(wpscene::WPMaterial& mat, const WPMdl& mdl);
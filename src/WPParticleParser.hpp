@@ -2,14 +2,18 @@
 #include "Particle/ParticleEmitter.h"
 #include "wpscene/WPParticleObject.h"
 
+#include <optional>
+
 namespace wallpaper
 {
 class WPParticleParser {
 public:
-    static ParticleInitOp     genParticleInitOp(const nlohmann::json&);
-    static ParticleOperatorOp genParticleOperatorOp(const nlohmann::json&,
-                                                    const wpscene::ParticleInstanceoverride&);
-    static ParticleEmittOp genParticleEmittOp(const wpscene::Emitter&, bool sort = false);
-    static ParticleInitOp  genOverrideInitOp(const wpscene::ParticleInstanceoverride&);
+    // nullopt for unknown names
+    static std::optional<ParticleInitOp>     genParticleInitOp(const nlohmann::json&);
+    static std::optional<ParticleOperatorOp> genParticleOperatorOp(
+        const nlohmann::json&, const wpscene::ParticleInstanceoverride&);
+    static std::optional<ParticleEmittOp> genParticleEmittOp(const wpscene::Emitter&,
+                                                             bool sort = false);
+    static ParticleInitOp genOverrideInitOp(const wpscene::ParticleInstanceoverride&);
 };
 } // namespace wallpaper
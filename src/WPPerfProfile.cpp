@@ -0,0 +1,76 @@
+#include "WPPerfProfile.hpp"
+
+#include "Fs/IBinaryStream.h"
+#include "Utils/Logging.h"
+#include "Utils/Sha.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#define PERF_DIR    "perf01"
+#define PERF_SUFFIX "prof"
+
+using namespace wallpaper;
+namespace sfs = std::filesystem;
+
+namespace
+{
+constexpr std::string_view perf_version { "WPPF1" };
+// scale and lod are written in thousandths, the host's locale may put commas in floats
+constexpr float per_mille { 1000.0f };
+} // namespace
+
+WPPerfProfiles::WPPerfProfiles(sfs::path dir, u64 max_bytes): m_dir(std::move(dir), max_bytes) {}
+
+std::unique_ptr<WPPerfProfiles> WPPerfProfiles::FromVfs(fs::VFS& vfs) {
+    auto dir = WPCacheDir::FromVfs(vfs, PERF_DIR);
+    if (dir.empty()) return nullptr;
+    return std::make_unique<WPPerfProfiles>(dir);
+}
+
+std::string WPPerfProfiles::Key(std::string_view scene_id, std::span<const u8> gpu_uuid) {
+    // ids are workshop numbers mostly, but may be any folder name
+    std::string key { scene_id };
+    key += ' ';
+    for (auto byte : gpu_uuid) {
+        char hex[3] { '\0' };
+        std::snprintf(hex, sizeof(hex), "%02x", byte);
+        key += hex;
+    }
+    return utils::genSha1({ key.data(), key.size() });
+}
+
+bool WPPerfProfiles::Load(std::string_view key, WPPerfProfile& profile) {
+    auto path = m_dir.FilePath(key, PERF_SUFFIX);
+    auto file = m_dir.Open(path);
+    if (! file) return false;
+
+    // version, then scale, lod and fps on a line
+    std::istringstream in(file->ReadAllStr());
+    std::string        version;
+    u32                scale { 0 }, lod { 0 }, fps { 0 };
+    if (! (in >> version >> scale >> lod >> fps) || version != perf_version) {
+        LOG_ERROR("broken perf profile \'%s\'", path.c_str());
+        return false;
+    }
+    profile = { .res_scale    = std::min((float)scale / per_mille, 1.0f),
+                .particle_lod = std::min((float)lod / per_mille, 1.0f),
+                .fps          = (u16)std::min<u32>(fps, 1000) };
+    return true;
+}
+
+void WPPerfProfiles::Save(std::string_view key, const WPPerfProfile& profile) {
+    char line[64] { '\0' };
+    int  size = std::snprintf(line,
+                             sizeof(line),
+                             "%s\n%u %u %u\n",
+                             perf_version.data(),
+                             (unsigned)(profile.res_scale * per_mille + 0.5f),
+                             (unsigned)(profile.particle_lod * per_mille + 0.5f),
+                             (unsigned)profile.fps);
+    m_dir.WriteFile(m_dir.FilePath(key, PERF_SUFFIX), [&](fs::IBinaryStreamW& file) {
+        file.Write(line, (usize)std::max(size, 0));
+    });
+    m_dir.Trim();
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+#include "WPCacheDir.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace wallpaper
+{
+namespace fs
+{
+class VFS;
+}
+
+// what the adaptive systems settled on for a scene on one gpu
+struct WPPerfProfile {
+    // of screen sized targets, with dynamic resolution
+    float res_scale { 1.0f };
+    // of the particle systems' budget
+    float particle_lod { 1.0f };
+    // frames a second the gpu kept up with, 0 if it wasn't timed
+    u16 fps { 0 };
+
+    bool operator==(const WPPerfProfile&) const = default;
+};
+
+// Profiles of the scenes run before, a file each named by the scene id and the gpu's uuid, so a
+// scene's next start begins where the last one settled instead of learning it all again.
+class WPPerfProfiles : NoCopy, NoMove {
+public:
+    constexpr static u64 DefaultMaxBytes { 1ull << 20 };
+
+    explicit WPPerfProfiles(std::filesystem::path dir, u64 max_bytes = DefaultMaxBytes);
+
+    // in the mounted cache folder, null when there is none or it's not on disk
+    static std::unique_ptr<WPPerfProfiles> FromVfs(fs::VFS&);
+
+    static std::string Key(std::string_view scene_id, std::span<const u8> gpu_uuid);
+
+    // false on a miss or a broken file
+    bool Load(std::string_view key, WPPerfProfile&);
+    void Save(std::string_view key, const WPPerfProfile&);
+
+private:
+    WPCacheDir m_dir;
+};
+
+} // namespace wallpaper
@@ -2,61 +2,281 @@
 #include "Utils/Logging.h"
 #include "Fs/LimitedBinaryStream.h"
 #include "Fs/CBinaryStream.h"
+#include "Fs/SpanBinaryStream.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace wallpaper;
 using namespace wallpaper::fs;
 
 namespace
 {
-std::string ReadSizedString(IBinaryStream& f) {
-    idx ilen = f.ReadInt32();
-    assert(ilen >= 0);
+// pkgs opened lately, mostly the one being reloaded, each holds its mapping
+constexpr usize max_recent_indices { 4 };
+// the stream fallback reads this much of the front for the toc first, more if it's longer
+constexpr usize toc_read_size { 64 * 1024 };
+// entries closer than this are prefetched as one range
+constexpr idx prefetch_gap { 64 * 1024 };
+
+i32 ReadI32(const uint8_t* p) {
+    u32 x { 0 };
+    std::memcpy(&x, p, sizeof(x));
+    if constexpr (IBinaryStream::sys_byte_order != IBinaryStream::ByteOrder::LittleEndian) {
+        x = bswap<u32>(x);
+    }
+    return (i32)x;
+}
+
+// the toc at the front of the pkg, a sized version string, the entry count, then the sized
+// path, offset and length of each entry, offsets are from the end of the toc
+// the toc's size, 0 if data ends before it does or it's broken
+usize ParseToc(std::span<const uint8_t> data, std::string& version, std::string& names,
+               std::vector<std::array<i32, 4>>& entries) {
+    usize pos { 0 };
+    auto  read_int = [&data, &pos](i32& x) {
+        if (data.size() - pos < sizeof(i32)) return false;
+        x = ReadI32(data.data() + pos);
+        pos += sizeof(i32);
+        return true;
+    };
+    auto read_str = [&data, &pos, &read_int](i32& len) {
+        if (! read_int(len) || len < 0 || data.size() - pos < (usize)len) return false;
+        pos += (usize)len;
+        return true;
+    };
 
-    usize       len = (usize)ilen;
-    std::string result;
-    result.resize(len);
-    f.Read(result.data(), len);
-    return result;
+    i32 len { 0 }, count { 0 };
+    if (! read_str(len)) return 0;
+    version.assign((const char*)data.data() + pos - (usize)len, (usize)len);
+    if (! read_int(count)) return 0;
+
+    names.clear();
+    entries.clear();
+    entries.reserve((usize)std::max(count, 0));
+    for (i32 i = 0; i < count; i++) {
+        std::array<i32, 4> entry {};
+        if (! read_str(len)) return 0;
+        entry[0] = (i32)names.size();
+        entry[1] = len + 1;
+        names += '/';
+        names.append((const char*)data.data() + pos - (usize)len, (usize)len);
+        if (! read_int(entry[2]) || ! read_int(entry[3])) return 0;
+        entries.push_back(entry);
+    }
+    return pos;
+}
+
+std::string StampOf(std::string_view path) {
+    struct stat st {};
+    if (::stat(std::string(path).c_str(), &st) != 0) return {};
+    return std::to_string(st.st_size) + "-" + std::to_string(st.st_mtim.tv_sec) + "." +
+           std::to_string(st.st_mtim.tv_nsec);
+}
+
+// read only private mapping of the whole file, unmapped with the last reference
+std::shared_ptr<const void> MapFile(std::string_view path, usize& size) {
+    int fd = ::open(std::string(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    struct stat st {};
+    void*       addr = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        size = (usize)st.st_size;
+        addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (addr == MAP_FAILED) return nullptr;
+    return std::shared_ptr<const void>(addr, [size](const void* p) {
+        ::munmap(const_cast<void*>(p), size);
+    });
 }
 } // namespace
 
-std::unique_ptr<WPPkgFs> WPPkgFs::CreatePkgFs(std::string_view pkgpath) {
-    auto ppkg = fs::CreateCBinaryStream(pkgpath);
-    if (! ppkg) return nullptr;
+std::unique_ptr<WPPkgFs> WPPkgFs::CreatePkgFs(std::string_view pkgpath, bool reuse) {
+    static std::mutex                                lock;
+    static std::deque<std::shared_ptr<const Index>> recent;
+
+    std::string stamp = StampOf(pkgpath);
+    if (stamp.empty()) return nullptr;
+    if (reuse) {
+        std::lock_guard l(lock);
+        auto            it = std::find_if(recent.begin(), recent.end(), [pkgpath](auto& index) {
+            return index->pkg_path == pkgpath;
+        });
+        if (it != recent.end()) {
+            auto index = *it;
+            recent.erase(it);
+            if (index->stamp == stamp) {
+                recent.push_front(index);
+                return std::unique_ptr<WPPkgFs>(new WPPkgFs(std::move(index)));
+            }
+        }
+    }
+
+    auto index = ReadIndex(pkgpath, std::move(stamp));
+    if (! index) return nullptr;
+    {
+        std::lock_guard l(lock);
+        recent.push_front(index);
+        if (recent.size() > max_recent_indices) recent.pop_back();
+    }
+    return std::unique_ptr<WPPkgFs>(new WPPkgFs(std::move(index)));
+}
+
+std::shared_ptr<const WPPkgFs::Index> WPPkgFs::ReadIndex(std::string_view pkgpath,
+                                                         std::string      stamp) {
+    auto index      = std::make_shared<Index>();
+    index->pkg_path = pkgpath;
+    index->stamp    = std::move(stamp);
+
+    usize map_size { 0 };
+    index->mapping = MapFile(pkgpath, map_size);
 
-    auto&       pkg = *ppkg;
-    std::string ver = ReadSizedString(pkg);
-    LOG_INFO("pkg version: %s", ver.data());
+    std::string                     version;
+    std::vector<std::array<i32, 4>> entries;
+    usize                           toc_size { 0 };
+    isize                           pkg_size { 0 };
+    if (index->mapping) {
+        index->data = { static_cast<const uint8_t*>(index->mapping.get()), map_size };
+        toc_size    = ParseToc(index->data, version, index->names, entries);
+        pkg_size    = (isize)map_size;
+    } else {
+        LOG_INFO("can't map \"%s\", reading it as a stream", pkgpath.data());
+        auto pkg = fs::CreateCBinaryStream(pkgpath);
+        if (! pkg) return nullptr;
+        pkg_size = pkg->Size();
 
-    std::vector<PkgFile> pkgfiles;
-    i32                  entryCount = pkg.ReadInt32();
-    for (i32 i = 0; i < entryCount; i++) {
-        std::string path   = "/" + ReadSizedString(pkg);
-        idx         offset = pkg.ReadInt32();
-        idx         length = pkg.ReadInt32();
-        pkgfiles.push_back({ path, offset, length });
+        // the front in one read, again with more if the toc goes on
+        std::vector<uint8_t> head;
+        for (usize want = toc_read_size; toc_size == 0; want *= 2) {
+            usize have = head.size();
+            want       = std::min(want, pkg->Usize());
+            if (want <= have) break;
+            head.resize(want);
+            if (pkg->Read(head.data() + have, want - have) != want - have) break;
+            toc_size = ParseToc(head, version, index->names, entries);
+        }
     }
-    auto pkgfs       = std::unique_ptr<WPPkgFs>(new WPPkgFs());
-    pkgfs->m_pkgPath = pkgpath;
-    idx headerSize   = pkg.Tell();
-    for (auto& el : pkgfiles) {
-        el.offset += headerSize;
-        pkgfs->m_files.insert({ el.path, el });
+    if (toc_size == 0) {
+        LOG_ERROR("broken pkg toc \"%s\"", pkgpath.data());
+        return nullptr;
     }
-    return pkgfs;
+    LOG_INFO("pkg version: %s", version.c_str());
+
+    auto& files = index->files;
+    files.reserve(entries.size());
+    for (auto& [name_offset, name_length, offset, length] : entries) {
+        PkgFile file { (u32)name_offset, (u32)name_length, (idx)toc_size + offset, length };
+        if (offset < 0 || length < 0 || file.offset + file.length > pkg_size) {
+            auto path = index->path(file);
+            LOG_ERROR("pkg entry \"%.*s\" is out of the file", (int)path.size(), path.data());
+            continue;
+        }
+        files.push_back(file);
+    }
+    // the first of an entry's duplicates wins
+    std::stable_sort(files.begin(), files.end(), [&index](const PkgFile& a, const PkgFile& b) {
+        return index->path(a) < index->path(b);
+    });
+    files.erase(std::unique(files.begin(),
+                            files.end(),
+                            [&index](const PkgFile& a, const PkgFile& b) {
+                                return index->path(a) == index->path(b);
+                            }),
+                files.end());
+    return index;
 }
 
-bool WPPkgFs::Contains(std::string_view path) const { return m_files.count(std::string(path)) > 0; }
+const WPPkgFs::PkgFile* WPPkgFs::Index::find(std::string_view path) const {
+    auto it = std::lower_bound(files.begin(), files.end(), path, [this](const PkgFile& f, auto p) {
+        return this->path(f) < p;
+    });
+    if (it == files.end() || this->path(*it) != path) return nullptr;
+    return &*it;
+}
+
+bool WPPkgFs::Contains(std::string_view path) const { return m_index->find(path) != nullptr; }
 
 std::shared_ptr<IBinaryStream> WPPkgFs::Open(std::string_view path) {
-    auto pkg = fs::CreateCBinaryStream(m_pkgPath);
-    if (! pkg) return nullptr;
-    if (Contains(path)) {
-        const auto& file = m_files.at(std::string(path));
-        return std::make_shared<LimitedBinaryStream>(pkg, file.offset, file.length);
+    auto* file = m_index->find(path);
+    if (file == nullptr) return nullptr;
+    if (m_index->mapping) {
+        return std::make_shared<SpanBinaryStream>(
+            m_index->mapping, m_index->data.subspan((usize)file->offset, (usize)file->length));
     }
-    return nullptr;
+    auto pkg = fs::CreateCBinaryStream(m_index->pkg_path);
+    if (! pkg) return nullptr;
+    return std::make_shared<LimitedBinaryStream>(pkg, file->offset, file->length);
 }
 
 std::shared_ptr<IBinaryStreamW> WPPkgFs::OpenW(std::string_view) { return nullptr; }
+
+std::vector<std::string_view> WPPkgFs::Files() const {
+    std::vector<std::string_view> files;
+    files.reserve(m_index->files.size());
+    for (auto& file : m_index->files) files.push_back(m_index->path(file));
+    return files;
+}
+
+std::string WPPkgFs::Stamp() const { return m_index->stamp; }
+
+void WPPkgFs::ReadAsync(std::string_view path, idx offset, usize size, ReadDone done) {
+    auto* file = m_index->find(path);
+    if (file == nullptr || offset < 0 || offset > file->length) return done(nullptr);
+    if (size == AsyncReader::ToEnd) size = (usize)(file->length - offset);
+    if ((idx)size > file->length - offset) return done(nullptr);
+    if (m_index->mapping) {
+        return done(std::make_shared<SpanBinaryStream>(
+            m_index->mapping, m_index->data.subspan((usize)(file->offset + offset), size)));
+    }
+    AsyncReader::Shared().Read(
+        m_index->pkg_path, (u64)(file->offset + offset), size, std::move(done));
+}
+
+void WPPkgFs::Prefetch() {
+    std::vector<std::pair<idx, idx>> ranges;
+    ranges.reserve(m_index->files.size());
+    for (auto& file : m_index->files) {
+        if (file.length > 0) ranges.push_back({ file.offset, file.offset + file.length });
+    }
+    std::sort(ranges.begin(), ranges.end());
+    usize merged { 0 };
+    for (auto& range : ranges) {
+        if (merged > 0 && range.first <= ranges[merged - 1].second + prefetch_gap)
+            ranges[merged - 1].second = std::max(ranges[merged - 1].second, range.second);
+        else
+            ranges[merged++] = range;
+    }
+    ranges.resize(merged);
+    if (ranges.empty()) return;
+
+    // both only queue the reads
+    idx bytes { 0 };
+    if (m_index->mapping) {
+        const usize page = (usize)::sysconf(_SC_PAGESIZE);
+        auto*       base = m_index->data.data();
+        for (auto [begin, end] : ranges) {
+            usize from = (usize)begin / page * page;
+            ::madvise(const_cast<uint8_t*>(base + from), (usize)end - from, MADV_WILLNEED);
+            bytes += end - begin;
+        }
+    } else {
+        int fd = ::open(m_index->pkg_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        for (auto [begin, end] : ranges) {
+            ::posix_fadvise(fd, (off_t)begin, (off_t)(end - begin), POSIX_FADV_WILLNEED);
+            bytes += end - begin;
+        }
+        ::close(fd);
+    }
+    LOG_INFO("prefetch %zu ranges of the pkg, %lld KB", ranges.size(), (long long)(bytes / 1024));
+}
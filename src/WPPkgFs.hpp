@@ -1,7 +1,9 @@
 #pragma once
 
-#include <unordered_map>
+#include <span>
+#include <vector>
 #include "Fs/Fs.h"
+#include "Core/Literals.hpp"
 
 namespace wallpaper
 {
@@ -10,25 +12,56 @@ namespace fs
 class WPPkgFs : public Fs {
 public:
     virtual ~WPPkgFs() = default;
-    static std::unique_ptr<WPPkgFs> CreatePkgFs(std::string_view pkgpath);
+    // the index of a pkg opened lately is taken again while its size and modify time are the same,
+    // without reuse the toc is always read
+    static std::unique_ptr<WPPkgFs> CreatePkgFs(std::string_view pkgpath, bool reuse = true);
 
 private:
-    WPPkgFs() = default;
+    struct Index;
+    explicit WPPkgFs(std::shared_ptr<const Index> index): m_index(std::move(index)) {}
 
 public:
     bool                            Contains(std::string_view path) const override;
     std::shared_ptr<IBinaryStream>  Open(std::string_view path) override;
     std::shared_ptr<IBinaryStreamW> OpenW(std::string_view path) override;
+    std::vector<std::string_view>   Files() const override;
+    std::string                     Stamp() const override;
+    // the ranges of its entries, into the page cache in the background
+    void Prefetch() override;
+    // a view right away if the pkg is mapped
+    void ReadAsync(std::string_view path, idx offset, usize size, ReadDone done) override;
 
 private:
     struct PkgFile {
-        std::string path;
+        // of the path in the index's names, with the leading slash
+        u32 name_offset { 0 };
+        u32 name_length { 0 };
 
         idx offset { 0 };
         idx length { 0 };
     };
-    std::string                              m_pkgPath;
-    std::unordered_map<std::string, PkgFile> m_files;
+    // what is read from the pkg once, shared by the fs of every load of it
+    struct Index {
+        std::string pkg_path;
+        // size and modify time of the pkg when it was opened
+        std::string stamp;
+        // the paths back to back, files sorted by path
+        std::string          names;
+        std::vector<PkgFile> files;
+
+        // the whole pkg mapped once, files are views into it
+        // empty when mapping failed, files are read from pkg_path then
+        std::shared_ptr<const void> mapping;
+        std::span<const uint8_t>    data;
+
+        std::string_view path(const PkgFile& f) const {
+            return { names.data() + f.name_offset, f.name_length };
+        }
+        const PkgFile* find(std::string_view path) const;
+    };
+    static std::shared_ptr<const Index> ReadIndex(std::string_view pkgpath, std::string stamp);
+
+    std::shared_ptr<const Index> m_index;
 };
 } // namespace fs
 } // namespace wallpaper
@@ -1,4 +1,5 @@
 #include "WPPuppet.hpp"
+#include <algorithm>
 #include <cmath>
 #include "Utils/Logging.h"
 
@@ -31,84 +32,113 @@ void WPPuppet::prepared() {
         anim.frame_time = 1.0f / anim.fps;
         anim.max_time   = anim.length / anim.fps;
         for (auto& b : anim.bframes_array) {
+            if (b.frames.empty()) continue;
+            const Quaterniond base = ToQuaternion(b.frames.front().angle);
             for (auto& f : b.frames) {
-                f.quaternion = ToQuaternion(f.angle);
+                Quaterniond q      = ToQuaternion(f.angle);
+                f.quaternion       = q.cast<float>();
+                f.quaternion_delta = (q * base.conjugate()).cast<float>();
             }
         }
     }
 
-    m_final_affines.resize(bones.size());
+    m_palettes.clear();
 }
 
 std::span<const Eigen::Affine3f> WPPuppet::genFrame(WPPuppetLayer& puppet_layer,
                                                     double         time) noexcept {
-    double global_blend = puppet_layer.m_global_blend;
-    double total_blend = puppet_layer.m_total_blend;
-
     puppet_layer.updateInterpolation(time);
 
-    for (uint i = 0; i < m_final_affines.size(); i++) {
-        const auto& bone   = bones[i];
-        auto&       affine = m_final_affines[i];
+    m_key.clear();
+    for (auto& layer : puppet_layer.m_layers) {
+        if (layer.anim == nullptr || ! layer.anim_layer.visible) continue;
+        m_key.push_back({ .anim       = layer.anim,
+                          .frame_a    = layer.interp_info.frame_a,
+                          .frame_b    = layer.interp_info.frame_b,
+                          .t          = layer.interp_info.t,
+                          .blend      = layer.blend,
+                          .anim_blend = layer.anim_layer.blend });
+    }
+
+    for (auto& p : m_palettes) {
+        if (p.global_blend == puppet_layer.m_global_blend && p.key == m_key) {
+            p.used = m_frame;
+            return p.affines;
+        }
+    }
+
+    // the least recently used one goes, unless it was handed out this frame
+    auto lru = std::min_element(m_palettes.begin(), m_palettes.end(), [](auto& a, auto& b) {
+        return a.used < b.used;
+    });
+    Palette* palette;
+    if (m_palettes.size() < MaxPalettes || lru->used == m_frame) {
+        palette = &m_palettes.emplace_back();
+    } else {
+        palette = &*lru;
+    }
+    palette->global_blend = puppet_layer.m_global_blend;
+    palette->key          = m_key;
+    palette->used         = m_frame;
+    genPalette(puppet_layer, palette->affines);
+    return palette->affines;
+}
+
+void WPPuppet::genPalette(const WPPuppetLayer&          puppet_layer,
+                          std::vector<Eigen::Affine3f>& affines) const noexcept {
+    const float       global_blend = (float)puppet_layer.m_global_blend;
+    const Quaternionf ident { Quaternionf::Identity() };
 
-        affine = Affine3f::Identity();
+    affines.resize(bones.size());
+    for (uint i = 0; i < affines.size(); i++) {
+        const auto& bone = bones[i];
         assert(bone.parent < i || bone.noParent());
-        const Affine3f parent =
-            bone.noParent() ? Affine3f::Identity() : m_final_affines[bone.parent];
 
         Vector3f    trans { bone.transform.translation() * global_blend };
-        Vector3f    scale { Vector3f::Ones() * global_blend };
-        Quaterniond quat { Quaterniond::Identity() };
-        Quaterniond ident { Quaterniond::Identity() };
-
-        // double cur_blend { 0.0f };
+        Vector3f    scale { Vector3f::Constant(global_blend) };
+        Quaternionf quat { ident };
 
         for (auto& layer : puppet_layer.m_layers) {
-            auto& alayer = layer.anim_layer;
-            if (layer.anim == nullptr || ! alayer.visible) continue;
+            if (layer.anim == nullptr || ! layer.anim_layer.visible) continue;
             assert(i < layer.anim->bframes_array.size());
             if (i >= layer.anim->bframes_array.size()) continue;
 
-            auto&  info    = layer.interp_info;
-            auto&  frame_base = layer.anim->bframes_array[i].frames[(usize)0];
-            auto&  frame_a = layer.anim->bframes_array[i].frames[(usize)info.frame_a];
-            auto&  frame_b = layer.anim->bframes_array[i].frames[(usize)info.frame_b];
-
-            double t = info.t;
-            double one_t   = 1.0f - info.t;
+            const auto& info       = layer.interp_info;
+            const auto& frames     = layer.anim->bframes_array[i].frames;
+            const auto& frame_base = frames[(usize)0];
+            const auto& frame_a    = frames[(usize)info.frame_a];
+            const auto& frame_b    = frames[(usize)info.frame_b];
 
-            // break up the delta quaternions from the animation start quaternion
-            // blend the starting quaternion using the reduced blending factor
-            // blend the delta using the full blending factor
-            auto frame_a_quat_delta = frame_a.quaternion * frame_base.quaternion.conjugate();
-            auto frame_b_quat_delta = frame_b.quaternion * frame_base.quaternion.conjugate();
-            quat *= frame_a_quat_delta.slerp(info.t, frame_b_quat_delta).slerp(1.0 - layer.anim_layer.blend, ident) 
-                * frame_base.quaternion.slerp(1.0 - (layer.blend), ident);
-                       
-            // break up the delta positions from the animation start position
-            // blend the starting position using the reduced blending factor
-            // blend the delta using the full blending factor
-            auto frame_a_pos_delta = frame_a.position - frame_base.position;
-            auto frame_b_pos_delta = frame_b.position - frame_base.position;
-            trans += (layer.blend * frame_base.position) + (layer.anim_layer.blend * (frame_a_pos_delta * one_t + frame_b_pos_delta * t));
+            const float t          = (float)info.t;
+            const float one_t      = 1.0f - t;
+            const float blend      = (float)layer.blend;
+            const float anim_blend = (float)layer.anim_layer.blend;
 
-            // break up the delta scales from the animation start scale
-            // blend the starting scale using the reduced blending factor
+            // break up the deltas from the animation start
+            // blend the start using the reduced blending factor
             // blend the delta using the full blending factor
-            auto& frame_a_scale_delta = frame_a.scale - frame_base.scale;
-            auto& frame_b_scale_delta = frame_b.scale - frame_base.scale;
-            scale += (layer.blend * frame_base.scale) + (layer.anim_layer.blend * (frame_a_scale_delta * one_t + frame_b_scale_delta * info.t));
+            quat *= frame_a.quaternion_delta.slerp(t, frame_b.quaternion_delta)
+                        .slerp(1.0f - anim_blend, ident) *
+                    frame_base.quaternion.slerp(1.0f - blend, ident);
+
+            trans += blend * frame_base.position +
+                     anim_blend * (frame_a.position * one_t + frame_b.position * t -
+                                   frame_base.position);
+            scale += blend * frame_base.scale +
+                     anim_blend * (frame_a.scale * one_t + frame_b.scale * t - frame_base.scale);
         }
-        affine.pretranslate(trans);
-        affine.rotate(quat.slerp(global_blend, ident).cast<float>());
-        affine.scale(scale);
-        affine = parent * affine;
+
+        // translate, rotate then scale
+        Affine3f affine;
+        affine.linear() = quat.slerp(global_blend, ident).toRotationMatrix() * scale.asDiagonal();
+        affine.translation() = trans;
+        affine.makeAffine();
+        affines[i] = bone.noParent() ? affine : affines[bone.parent] * affine;
     }
 
-    for (uint i = 0; i < m_final_affines.size(); i++) {
-        m_final_affines[i] *= bones[i].offset_trans.matrix();
+    for (uint i = 0; i < affines.size(); i++) {
+        affines[i] = affines[i] * bones[i].offset_trans;
     }
-    return m_final_affines;
 }
 
 static constexpr void genInterpolationInfo(WPPuppet::Animation::InterpolationInfo& info,
@@ -141,6 +171,15 @@ WPPuppet::Animation::getInterpolationInfo(double* cur_time) const {
     return _info;
 }
 
+void WPPuppetLayer::periods(std::vector<double>& out) const {
+    for (const auto& layer : m_layers) {
+        if (! layer || layer.anim_layer.rate == 0.0) continue;
+        double period = layer.anim->max_time / std::abs(layer.anim_layer.rate);
+        if (layer.anim->mode == WPPuppet::PlayMode::Mirror) period *= 2.0;
+        out.push_back(period);
+    }
+}
+
 void WPPuppetLayer::prepared(std::span<AnimationLayer> alayers) {
     m_layers.resize(alayers.size());
     double& blend = m_global_blend;
@@ -40,7 +40,9 @@ public:
         Eigen::Vector3f scale;
 
         // prepared
-        Eigen::Quaterniond quaternion;
+        Eigen::Quaternionf quaternion;
+        // from the animation's first frame
+        Eigen::Quaternionf quaternion_delta;
     };
     struct Animation {
         i32         id;
@@ -69,11 +71,39 @@ public:
     std::vector<Bone>      bones;
     std::vector<Animation> anims;
 
+    // nodes sharing the puppet with the same layer state get the same palette, made once
+    // a palette handed out keeps its address and content until the next beginFrame
     std::span<const Eigen::Affine3f> genFrame(WPPuppetLayer&, double time) noexcept;
     void                             prepared();
+    void                             beginFrame() noexcept { m_frame++; }
 
 private:
-    std::vector<Eigen::Affine3f> m_final_affines;
+    // what a palette depends on, per layer
+    struct LayerKey {
+        const Animation* anim { nullptr };
+        idx              frame_a { 0 };
+        idx              frame_b { 0 };
+        double           t { 0.0 };
+        double           blend { 0.0 };
+        double           anim_blend { 0.0 };
+
+        bool operator==(const LayerKey&) const = default;
+    };
+    struct Palette {
+        double                       global_blend { 0.0 };
+        std::vector<LayerKey>        key;
+        std::vector<Eigen::Affine3f> affines;
+        // the frame it was last handed out in
+        u64 used { 0 };
+    };
+    // more only if a frame needs them
+    constexpr static usize MaxPalettes { 4 };
+
+    void genPalette(const WPPuppetLayer&, std::vector<Eigen::Affine3f>&) const noexcept;
+
+    std::vector<Palette>  m_palettes;
+    std::vector<LayerKey> m_key;
+    u64                   m_frame { 1 };
 };
 
 class WPPuppetLayer {
@@ -84,7 +114,8 @@ public:
     WPPuppetLayer(std::shared_ptr<WPPuppet>);
     ~WPPuppetLayer();
 
-    bool hasPuppet() const { return (bool)m_puppet; };
+    bool      hasPuppet() const { return (bool)m_puppet; };
+    WPPuppet* puppet() const { return m_puppet.get(); }
 
     struct AnimationLayer {
         i32    id { 0 };
@@ -100,6 +131,9 @@ public:
 
     void updateInterpolation(double time) noexcept;
 
+    // seconds till each playing layer starts over, a mirrored one plays forth and back
+    void periods(std::vector<double>&) const;
+
 private:
     struct Layer {
         AnimationLayer                         anim_layer;
@@ -0,0 +1,137 @@
+#include "WPSceneCache.hpp"
+#include "WPJson.hpp"
+
+#include "Fs/IBinaryStream.h"
+#include "Fs/VFS.h"
+#include "Utils/Logging.h"
+#include "Utils/Sha.hpp"
+
+#include <nlohmann/json.hpp>
+#include <vector>
+
+#define SCENE_DIR    "scenes01"
+#define SCENE_SUFFIX "scnc"
+
+using namespace wallpaper;
+namespace sfs = std::filesystem;
+
+namespace
+{
+// "WPSC", then the file count and path, stamp and cbor of each, the scene first without a path
+constexpr u32 scene_magic { 0x43535057 };
+constexpr u32 max_files { 1u << 16 };
+constexpr u32 max_name { 4096 };
+
+bool ReadString(fs::IBinaryStream& file, std::string& str) {
+    u32 size = file.ReadUint32();
+    if (size > max_name) return false;
+    str.resize(size);
+    return file.Read(str.data(), size) == size;
+}
+
+void WriteString(fs::IBinaryStreamW& file, std::string_view str) {
+    file.WriteUint32((u32)str.size());
+    file.Write(str.data(), str.size());
+}
+
+// decoded in place from the mapping when the stream has one
+bool ReadDoc(fs::IBinaryStream& file, std::vector<u8>& buf, bool decode, nlohmann::json& json) {
+    u32 size = file.ReadUint32();
+    if (! decode) return file.SeekCur(size);
+    std::span<const u8> data = file.TryMapView(file.Tell(), size);
+    if (data.empty()) {
+        buf.resize(size);
+        if (file.Read(buf.data(), size) != size) return false;
+        data = buf;
+    } else if (! file.SeekCur(size)) {
+        return false;
+    }
+    json = nlohmann::json::from_cbor(data.begin(), data.end(), true, false);
+    return ! json.is_discarded();
+}
+
+void WriteDoc(fs::IBinaryStreamW& file, const nlohmann::json& json) {
+    auto data = nlohmann::json::to_cbor(json);
+    file.WriteUint32((u32)data.size());
+    file.Write(data.data(), data.size());
+}
+} // namespace
+
+WPSceneCache::WPSceneCache(sfs::path dir, u64 max_bytes): m_dir(std::move(dir), max_bytes) {}
+
+std::unique_ptr<WPSceneCache> WPSceneCache::FromVfs(fs::VFS& vfs) {
+    auto  dir     = WPCacheDir::FromVfs(vfs, SCENE_DIR);
+    auto* bundled = WPCacheDir::Bundled(vfs);
+    if (dir.empty() && bundled == nullptr) return nullptr;
+    auto cache = std::make_unique<WPSceneCache>(dir);
+    if (bundled != nullptr) cache->m_dir.SetBundled(bundled, SCENE_DIR);
+    return cache;
+}
+
+std::string WPSceneCache::Key(std::string_view scene_src) {
+    return utils::genSha1({ scene_src.data(), scene_src.size() });
+}
+
+bool WPSceneCache::Load(std::string_view key, fs::VFS& vfs, nlohmann::json& scene,
+                        JsonFileCache& json_cache) {
+    auto path = m_dir.FilePath(key, SCENE_SUFFIX);
+    auto file = m_dir.Open(path);
+    if (! file) return false;
+
+    std::vector<u8> buf;
+    std::string     name, stamp;
+    u32             magic = file->ReadUint32();
+    u32             count = file->ReadUint32();
+
+    bool ok = magic == scene_magic && count > 0 && count <= max_files;
+    ok      = ok && ReadString(*file, name) && ReadString(*file, stamp);
+    ok      = ok && ReadDoc(*file, buf, true, scene);
+
+    usize kept { 0 };
+    for (u32 i = 1; i < count && ok; i++) {
+        ok = ReadString(*file, name) && ReadString(*file, stamp);
+        if (! ok) break;
+        // a changed pkg is read again, the others may still be good
+        bool current = stamp == vfs.Stamp(name);
+        auto json    = std::make_shared<nlohmann::json>();
+        ok           = ReadDoc(*file, buf, current, *json);
+        if (ok && current) {
+            json_cache.Insert(name, std::move(json));
+            kept++;
+        }
+    }
+    if (! ok) {
+        LOG_ERROR("broken scene cache \'%s\'", path.c_str());
+        scene = nullptr;
+        return false;
+    }
+    LOG_INFO("scene cache kept %zu of %u json files", kept, count - 1);
+    return true;
+}
+
+void WPSceneCache::Save(std::string_view key, fs::VFS& vfs, const nlohmann::json& scene,
+                        const JsonFileCache& json_cache) {
+    struct Entry {
+        JsonFileCache::File file;
+        std::string         stamp;
+    };
+    std::vector<Entry> entries;
+    for (auto& file : json_cache.Files()) {
+        auto stamp = vfs.Stamp(file.first);
+        if (stamp.empty() || ! file.second || entries.size() + 1 >= max_files) continue;
+        entries.push_back({ file, std::move(stamp) });
+    }
+    m_dir.WriteFile(m_dir.FilePath(key, SCENE_SUFFIX), [&](fs::IBinaryStreamW& file) {
+        file.WriteUint32(scene_magic);
+        file.WriteUint32((u32)entries.size() + 1);
+        WriteString(file, "");
+        WriteString(file, "");
+        WriteDoc(file, scene);
+        for (auto& entry : entries) {
+            WriteString(file, entry.file.first);
+            WriteString(file, entry.stamp);
+            WriteDoc(file, *entry.file.second);
+        }
+    });
+    m_dir.Trim();
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+#include "WPCacheDir.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <nlohmann/json_fwd.hpp>
+#include <string>
+#include <string_view>
+
+namespace wallpaper
+{
+namespace fs
+{
+class VFS;
+}
+class JsonFileCache;
+
+// The json a scene load parsed, binary encoded in one file named by the sha of the scene json,
+// so a warm load seeds the JsonFileCache from it and parses no json text. Files are kept with
+// the stamp of the fs they were read from, ones from a fs without a stamp aren't kept, and one
+// whose pkg changed since is read again.
+class WPSceneCache : NoCopy, NoMove {
+public:
+    constexpr static u64 DefaultMaxBytes { 64ull << 20 };
+
+    explicit WPSceneCache(std::filesystem::path dir, u64 max_bytes = DefaultMaxBytes);
+
+    // in the mounted cache folder, read only from a bundle at /assets, null with neither
+    static std::unique_ptr<WPSceneCache> FromVfs(fs::VFS&);
+
+    static std::string Key(std::string_view scene_src);
+
+    // false on a miss or a broken file, the files still current go to the json cache
+    bool Load(std::string_view key, fs::VFS&, nlohmann::json& scene, JsonFileCache&);
+    // the scene and every file of the json cache with a stamp, trims after
+    void Save(std::string_view key, fs::VFS&, const nlohmann::json& scene, const JsonFileCache&);
+
+private:
+    WPCacheDir m_dir;
+};
+
+} // namespace wallpaper
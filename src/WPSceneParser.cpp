@@ -1,16 +1,21 @@
 #include "WPSceneParser.hpp"
+#include "SceneWallpaper.hpp"
 #include "WPJson.hpp"
 #include "WPUserProperties.hpp"
 
 #include "Utils/String.h"
 #include "Utils/Logging.h"
+#include "Utils/Trace.h"
 #include "Utils/Algorism.h"
+#include "Utils/MemUse.hpp"
 #include "Core/Visitors.hpp"
 #include "Core/StringHelper.hpp"
 #include "Core/ArrayHelper.hpp"
 #include "SpecTexs.hpp"
 
 #include "WPShaderParser.hpp"
+#include "WPShaderCache.hpp"
+#include "WPSceneCache.hpp"
 #include "WPTexImageParser.hpp"
 #include "WPParticleParser.hpp"
 #include "WPSoundParser.hpp"
@@ -27,8 +32,10 @@
 #include "wpscene/WPScene.h"
 
 #include "Fs/VFS.h"
+#include "Looper/JobSystem.hpp"
 
 #include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -36,7 +43,11 @@
 #include <random>
 #include <cmath>
 #include <functional>
+#include <future>
+#include <limits>
+#include <optional>
 #include <regex>
+#include <set>
 #include <variant>
 #include <Eigen/Dense>
 
@@ -51,6 +62,12 @@ struct ParseContext {
     i32                    ortho_w;
     i32                    ortho_h;
     fs::VFS*               vfs;
+    WPShaderCompileQueue*  shader_queue;
+    WPCameraParallax       camera_parallax;
+    ShaderQuality          quality { ShaderQuality::Full };
+    bool                   bindless { false };
+    // puppets read in the background by path, taken by the first object using one
+    std::unordered_map<std::string, std::future<std::shared_ptr<fs::IBinaryStream>>> puppet_reads;
 
     ShaderValueMap             global_base_uniforms;
     std::shared_ptr<SceneNode> effect_camera_node;
@@ -89,34 +106,45 @@ void GenCardMesh(SceneMesh& mesh, const std::array<uint16_t, 2> size,
 	};
     // clang-format on
 
+    // texcoords within 0 to 1 as shorts
     SceneVertexArray vertex(
         {
             { WE_IN_POSITION.data(), VertexType::FLOAT3 },
-            { WE_IN_TEXCOORD.data(), VertexType::FLOAT2 },
+            { WE_IN_TEXCOORD.data(), VertexType::SNORM16X2 },
         },
         4);
-    vertex.SetVertex(WE_IN_POSITION, pos);
-    vertex.SetVertex(WE_IN_TEXCOORD, texCoord);
+    float* vertices = vertex.WriteVertices(0, 4);
+    SceneVertexArray::PutEach(vertex.FindAttr(WE_IN_POSITION), vertices, 4, pos);
+    SceneVertexArray::PutEach(vertex.FindAttr(WE_IN_TEXCOORD), vertices, 4, texCoord);
     mesh.AddVertexArray(std::move(vertex));
 }
 
+// instanced: one element per particle, the vertex shader expands it to a quad
+// corner, rotation and size as half floats and the color as bytes, the rest unpadded floats
 void SetParticleMesh(SceneMesh& mesh, const wpscene::Particle& particle, uint32_t count,
-                     bool thick_format) {
+                     bool thick_format, bool instanced) {
     (void)particle;
     std::vector<SceneVertexArray::SceneVertexAttribute> attrs {
-        { WE_IN_POSITION.data(), VertexType::FLOAT3 },
-        { WE_IN_TEXCOORDVEC4.data(), VertexType::FLOAT4 },
-        { WE_IN_COLOR.data(), VertexType::FLOAT4 },
+        { WE_IN_POSITION.data(), VertexType::FLOAT3, false },
+        { WE_IN_TEXCOORDVEC4.data(), VertexType::HALF4 },
+        { WE_IN_COLOR.data(), VertexType::UNORM8X4 },
     };
     if (thick_format) {
         attrs.push_back({ WE_IN_TEXCOORDVEC4C1.data(), VertexType::FLOAT4 });
     }
-    attrs.push_back({ WE_IN_TEXCOORDC2.data(), VertexType::FLOAT2 });
-    mesh.AddVertexArray(SceneVertexArray(attrs, count * 4));
-    mesh.AddIndexArray(SceneIndexArray(count));
+    attrs.push_back({ WE_IN_TEXCOORDC2.data(), VertexType::FLOAT2, false });
+    if (instanced) {
+        mesh.AddVertexArray(SceneVertexArray(attrs, count));
+        mesh.GetVertexArray(0).SetPerInstance(true);
+        mesh.SetInstanceVertexCount(4);
+    } else {
+        mesh.AddVertexArray(SceneVertexArray(attrs, count * 4));
+        mesh.AddIndexArray(SceneIndexArray(count));
+    }
     mesh.GetVertexArray(0).SetOption(WE_CB_THICK_FORMAT, thick_format);
 }
 
+// colors as bytes and corners as shorts
 void SetRopeParticleMesh(SceneMesh& mesh, const wpscene::Particle& particle, uint32_t count,
                          bool thick_format) {
     (void)particle;
@@ -127,15 +155,16 @@ void SetRopeParticleMesh(SceneMesh& mesh, const wpscene::Particle& particle, uin
     };
     if (thick_format) {
         attrs.push_back({ WE_IN_TEXCOORDVEC4C2.data(), VertexType::FLOAT4 });
-        attrs.push_back({ WE_IN_TEXCOORDVEC4C3.data(), VertexType::FLOAT4 });
-        attrs.push_back({ WE_IN_TEXCOORDC4.data(), VertexType::FLOAT4 });
+        attrs.push_back({ WE_IN_TEXCOORDVEC4C3.data(), VertexType::UNORM8X4 });
+        attrs.push_back({ WE_IN_TEXCOORDC4.data(), VertexType::SNORM16X2 });
     } else {
-        attrs.push_back({ WE_IN_TEXCOORDVEC3C2.data(), VertexType::FLOAT4 });
-        attrs.push_back({ WE_IN_TEXCOORDC3.data(), VertexType::FLOAT4 });
+        attrs.push_back({ WE_IN_TEXCOORDVEC3C2.data(), VertexType::FLOAT3, false });
+        attrs.push_back({ WE_IN_TEXCOORDC3.data(), VertexType::SNORM16X2 });
     }
-    attrs.push_back({ WE_IN_COLOR.data(), VertexType::FLOAT4 });
+    attrs.push_back({ WE_IN_COLOR.data(), VertexType::UNORM8X4 });
     mesh.AddVertexArray(SceneVertexArray(attrs, count * 4));
-    mesh.AddIndexArray(SceneIndexArray(count));
+    // a segment per particle, past 16k the vertices need u32 indices
+    mesh.AddIndexArray(SceneIndexArray(count, (usize)count * 4 > std::numeric_limits<u16>::max()));
     mesh.GetVertexArray(0).SetOption(WE_PRENDER_ROPE, true);
     mesh.GetVertexArray(0).SetOption(WE_CB_THICK_FORMAT, thick_format);
 }
@@ -164,14 +193,15 @@ void LoadControlPoint(ParticleSubSystem& pSys, const wpscene::Particle& wp) {
 void LoadInitializer(ParticleSubSystem& pSys, const wpscene::Particle& wp,
                      const wpscene::ParticleInstanceoverride& over) {
     for (const auto& ini : wp.initializers) {
-        pSys.AddInitializer(WPParticleParser::genParticleInitOp(ini));
+        if (auto op = WPParticleParser::genParticleInitOp(ini)) pSys.AddInitializer(std::move(*op));
     }
     if (over.enabled) pSys.AddInitializer(WPParticleParser::genOverrideInitOp(over));
 }
 void LoadOperator(ParticleSubSystem& pSys, const wpscene::Particle& wp,
                   const wpscene::ParticleInstanceoverride& over) {
     for (const auto& op : wp.operators) {
-        pSys.AddOperator(WPParticleParser::genParticleOperatorOp(op, over));
+        if (auto o = WPParticleParser::genParticleOperatorOp(op, over))
+            pSys.AddOperator(std::move(*o));
     }
 }
 void LoadEmitter(ParticleSubSystem& pSys, const wpscene::Particle& wp, float count,
@@ -181,8 +211,79 @@ void LoadEmitter(ParticleSubSystem& pSys, const wpscene::Particle& wp, float cou
         auto newEm = em;
         newEm.rate *= count;
         // newEm.origin[2] -= perspectiveZ;
-        pSys.AddEmitter(WPParticleParser::genParticleEmittOp(newEm, sort));
+        if (auto op = WPParticleParser::genParticleEmittOp(newEm, sort))
+            pSys.AddEmitter(std::move(*op));
+    }
+}
+
+// the camera a node is drawn with, null if the scene has none
+const SceneCamera* NodeCamera(const Scene& scene, const SceneNode& node) {
+    if (! node.Camera().empty() && scene.cameras.count(node.Camera()) != 0)
+        return scene.cameras.at(node.Camera()).get();
+    return scene.activeCamera;
+}
+
+// some of the box, given in the node's space, may be in the camera's view
+bool BoundsInView(const Scene& scene, const SceneNode& node, const std::array<float, 3>& lo,
+                  const std::array<float, 3>& hi) {
+    // parallax moves nodes after this, keep a margin
+    constexpr double margin = 1.1;
+
+    const SceneCamera* camera = NodeCamera(scene, node);
+    if (camera == nullptr) return true;
+
+    Matrix4d mvp = camera->GetViewProjectionMatrix() * node.ModelTrans().cast<double>();
+    // the box is hidden if all corners are out on the same side
+    std::array<u32, 4> outside {};
+    for (u32 c = 0; c < 8; c++) {
+        Vector4d p = mvp * Vector4d((c & 1) ? hi[0] : lo[0],
+                                    (c & 2) ? hi[1] : lo[1],
+                                    (c & 4) ? hi[2] : lo[2],
+                                    1.0);
+        // behind a perspective camera
+        if (p.w() <= 0.0) return true;
+        const double w = p.w() * margin;
+        outside[0] += p.x() < -w;
+        outside[1] += p.x() > w;
+        outside[2] += p.y() < -w;
+        outside[3] += p.y() > w;
     }
+    return std::none_of(outside.begin(), outside.end(), [](u32 n) {
+        return n == 8;
+    });
+}
+
+// distance from the camera of a point in the node's space, the camera looks down -z
+bool ViewDepthPlane(const Scene& scene, const SceneNode& node, std::array<float, 4>& plane) {
+    const SceneCamera* camera = NodeCamera(scene, node);
+    if (camera == nullptr) return false;
+    Matrix4d mv = camera->GetViewMatrix() * node.ModelTrans().cast<double>();
+    for (usize i = 0; i < 4; i++) plane[i] = (float)-mv(2, (Eigen::Index)i);
+    return true;
+}
+
+// the card of an image node covers all the global camera sees, and does wherever parallax moves
+// it, the camera sees at most the ortho size unless the scene is fitted
+bool CoversView(const ParseContext& context, const wpscene::WPImageObject& img,
+                const SceneNode& node) {
+    if (std::any_of(img.angles.begin(), img.angles.end(), [](float a) {
+            return a != 0.0f;
+        }))
+        return false;
+    const auto&                 para  = context.camera_parallax;
+    const std::array<double, 2> ortho { (double)context.ortho_w, (double)context.ortho_h };
+    for (usize i = 0; i < 2; i++) {
+        const double center = node.Translate()[(Eigen::Index)i];
+        const double half   = 0.5 * img.size[i] * std::abs(img.scale[i]);
+        // the camera sits in the middle, the mouse moves a node by up to half the ortho size
+        double shift { 0.0 };
+        if (para.enable && img.parallaxDepth[i] != 0.0f) {
+            shift = (std::abs(center - 0.5 * ortho[i]) + 0.5 * ortho[i] * para.mouseinfluence) *
+                    std::abs(img.parallaxDepth[i] * para.amount);
+        }
+        if (center - half + shift > 0.0 || center + half - shift < ortho[i]) return false;
+    }
+    return true;
 }
 
 ParticleSubSystem::SpawnType ParseSpawnType(std::string_view str) {
@@ -251,7 +352,7 @@ void ParseSpecTexName(std::string& name, const wpscene::WPMaterial& wpmat,
 
 bool LoadMaterial(fs::VFS& vfs, const wpscene::WPMaterial& wpmat, Scene* pScene, SceneNode* pNode,
                   SceneMaterial* pMaterial, WPShaderValueData* pSvData,
-                  WPShaderInfo* pWPShaderInfo = nullptr) {
+                  WPShaderInfo* pWPShaderInfo = nullptr, WPShaderCompileQueue* queue = nullptr) {
     (void)pNode;
 
     auto& svData   = *pSvData;
@@ -290,22 +391,20 @@ bool LoadMaterial(fs::VFS& vfs, const wpscene::WPMaterial& wpmat, Scene* pScene,
         } else if (! IsSpecTex(el)) {
             const auto& texh = pScene->imageParser->ParseHeader(el);
             texHeaders[el]   = texh;
-            if (texh.extraHeader.count("compo1") == 0) {
+            if (! texh.fromTex) {
                 texinfos.push_back({ false });
                 continue;
             }
             texinfos.push_back({ true,
-                                 {
-                                     (bool)texh.extraHeader.at("compo1").val,
-                                     (bool)texh.extraHeader.at("compo2").val,
-                                     (bool)texh.extraHeader.at("compo3").val,
-                                 } });
+                                 { texh.compo1, texh.compo2, texh.compo3 },
+                                 texh.isSprite && texh.layerable });
         } else
             texinfos.push_back({ true });
     }
 
+    WPShaderCache* cache = queue != nullptr ? queue->Cache() : nullptr;
     for (auto& unit : sd_units) {
-        unit.src = WPShaderParser::PreShaderSrc(vfs, unit.src, pWPShaderInfo, texinfos);
+        unit.src = WPShaderParser::PreShaderSrc(vfs, unit.src, pWPShaderInfo, texinfos, cache);
     }
 
     shader->default_uniforms = pWPShaderInfo->svs;
@@ -338,11 +437,11 @@ bool LoadMaterial(fs::VFS& vfs, const wpscene::WPMaterial& wpmat, Scene* pScene,
         std::array<i32, 4> resolution {};
         if (IsSpecTex(name)) {
             if (IsSpecLinkTex(name)) {
-                svData.renderTargets.push_back({ i, name });
+                svData.renderTargets.push_back({ i, StringId(name) });
             } else if (pScene->renderTargets.count(name) == 0) {
                 LOG_ERROR("%s not found in render targets", name.c_str());
             } else {
-                svData.renderTargets.push_back({ i, name });
+                svData.renderTargets.push_back({ i, StringId(name) });
                 const auto& rt = pScene->renderTargets.at(name);
                 resolution     = { rt.width, rt.height, rt.width, rt.height };
             }
@@ -401,12 +500,19 @@ bool LoadMaterial(fs::VFS& vfs, const wpscene::WPMaterial& wpmat, Scene* pScene,
         // pWPShaderInfo->combos.at("LIGHTING");
     }
 
-    if (! WPShaderParser::CompileToSpv(
-            pScene->scene_id, sd_units, shader->codes, vfs, pWPShaderInfo, texinfos)) {
+    if (! WPShaderParser::CompileToSpv(sd_units,
+                                       *shader,
+                                       pWPShaderInfo,
+                                       texinfos,
+                                       cache,
+                                       queue)) {
         return false;
     }
+    shader->spec_constants = pWPShaderInfo->spec_constants;
 
     material.blenmode = ParseBlendMode(wpmat.blending);
+    // expanded with the combos by now, a discard in a branch left out is gone
+    material.discards = std::regex_search(sd_units[1].src, std::regex(R"(\bdiscard\b)"));
 
     for (uint i = 0; i < material.textures.size(); i++) {
         if (! exists(sd_units[1].preprocess_info.active_tex_slots, i)) material.textures[i].clear();
@@ -421,6 +527,77 @@ bool LoadMaterial(fs::VFS& vfs, const wpscene::WPMaterial& wpmat, Scene* pScene,
     return true;
 }
 
+// the axis a pass of a separable blur blurs along, by its shader's name or direction combo
+enum class BlurAxis
+{
+    None,
+    X,
+    Y
+};
+
+BlurAxis SeparableBlurAxis(const wpscene::WPMaterial& mat, const wpscene::WPMaterialPass& pass) {
+    std::string shader = mat.shader;
+    std::transform(shader.begin(), shader.end(), shader.begin(), [](unsigned char c) {
+        return (char)std::tolower(c);
+    });
+    if (shader.find("blur") == std::string::npos) return BlurAxis::None;
+    for (auto* combos : { &pass.combos, &mat.combos }) {
+        if (auto it = combos->find("VERTICAL"); it != combos->end())
+            return it->second != 0 ? BlurAxis::Y : BlurAxis::X;
+    }
+    for (std::string_view end : { "_x", "_h", "horizontal" })
+        if (shader.ends_with(end)) return BlurAxis::X;
+    for (std::string_view end : { "_y", "_v", "vertical" })
+        if (shader.ends_with(end)) return BlurAxis::Y;
+    return BlurAxis::None;
+}
+
+// Fbos a separable blur's first pass writes and only its second pass, blurring along the other
+// axis, reads. What the first pass writes is smooth along its axis, so at half size along it the
+// second pass samples about the same, with half the pixels written and read.
+std::unordered_map<std::string, BlurAxis> HalvedBlurFbos(const wpscene::WPImageEffect& eff) {
+    std::unordered_map<std::string, BlurAxis> halved;
+    const usize num = std::min(eff.materials.size(), eff.passes.size());
+    for (usize i = 0; i + 1 < num; i++) {
+        const auto& target = eff.passes[i].target;
+        if (target.empty()) continue;
+        auto fbo = std::find_if(eff.fbos.begin(), eff.fbos.end(), [&target](auto& f) {
+            return f.name == target;
+        });
+        if (fbo == eff.fbos.end()) continue;
+
+        BlurAxis axis = SeparableBlurAxis(eff.materials[i], eff.passes[i]);
+        BlurAxis next = SeparableBlurAxis(eff.materials[i + 1], eff.passes[i + 1]);
+        if (axis == BlurAxis::None || next == BlurAxis::None || axis == next) continue;
+
+        bool only_next { true };
+        for (usize j = 0; j < eff.passes.size() && only_next; j++) {
+            const auto& pass = eff.passes[j];
+            if (j != i && pass.target == target) only_next = false;
+            for (auto& b : pass.bind) {
+                if (b.name != target) continue;
+                if (j != i + 1 || b.index != 0) only_next = false;
+            }
+        }
+        for (auto& cmd : eff.commands) {
+            if (cmd.target == target || cmd.source == target) only_next = false;
+        }
+        bool read_next = std::any_of(
+            eff.passes[i + 1].bind.begin(), eff.passes[i + 1].bind.end(), [&target](auto& b) {
+                return b.name == target;
+            });
+        if (only_next && read_next) halved[target] = axis;
+    }
+    return halved;
+}
+
+// the formats an effect's fbo may name, what its shaders write the first channels of
+TextureFormat FboFormat(std::string_view format) {
+    if (format == "r8") return TextureFormat::R8;
+    if (format == "rg88") return TextureFormat::RG8;
+    return TextureFormat::RGBA8;
+}
+
 void LoadAlignment(SceneNode& node, std::string_view align, Vector2f size) {
     Vector3f trans = node.Translate();
     size *= 0.5f;
@@ -470,7 +647,7 @@ void ParseCamera(ParseContext& context, wpscene::WPSceneGeneral& general) {
     auto& scene = *context.scene;
     // effect camera
     scene.cameras["effect"]    = std::make_shared<SceneCamera>(2, 2, -1.0f, 1.0f);
-    context.effect_camera_node = std::make_shared<SceneNode>(); // at 0,0,0
+    context.effect_camera_node = context.scene->arena.MakeShared<SceneNode>(); // at 0,0,0
     scene.cameras.at("effect")->AttatchNode(context.effect_camera_node);
     scene.sceneGraph->AppendChild(context.effect_camera_node);
 
@@ -483,7 +660,7 @@ void ParseCamera(ParseContext& context, wpscene::WPSceneGeneral& general) {
     Vector3f cori { (float)context.ortho_w / 2.0f, (float)context.ortho_h / 2.0f, 0 },
         cscale { 1.0f, 1.0f, 1.0f }, cangle(Vector3f::Zero());
 
-    context.global_camera_node = std::make_shared<SceneNode>(cori, cscale, cangle);
+    context.global_camera_node = context.scene->arena.MakeShared<SceneNode>(cori, cscale, cangle);
     scene.activeCamera->AttatchNode(context.global_camera_node);
     scene.sceneGraph->AppendChild(context.global_camera_node);
 
@@ -495,7 +672,8 @@ void ParseCamera(ParseContext& context, wpscene::WPSceneGeneral& general) {
 
     Vector3f cperori                       = cori;
     cperori[2]                             = 1000.0f;
-    context.global_perspective_camera_node = std::make_shared<SceneNode>(cperori, cscale, cangle);
+    context.global_perspective_camera_node =
+        context.scene->arena.MakeShared<SceneNode>(cperori, cscale, cangle);
     scene.cameras["global_perspective"]->AttatchNode(context.global_perspective_camera_node);
     scene.sceneGraph->AppendChild(context.global_perspective_camera_node);
 }
@@ -536,6 +714,7 @@ void InitContext(ParseContext& context, fs::VFS& vfs, wpscene::WPScene& sc) {
         cam_para.delay          = sc.general.cameraparallaxdelay;
         cam_para.mouseinfluence = sc.general.cameraparallaxmouseinfluence;
         context.shader_updater->SetCameraParallax(cam_para);
+        context.camera_parallax = cam_para;
     }
 }
 
@@ -549,11 +728,9 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
     if (wpimgobj.colorBlendMode != 0) {
         wpscene::WPImageEffect colorEffect;
         wpscene::WPMaterial    colorMat;
-        nlohmann::json         json;
-        if (! PARSE_JSON(fs::GetFileContent(vfs, "/assets/materials/util/effectpassthrough.json"),
-                         json))
-            return;
-        colorMat.FromJson(json);
+        auto json = PARSE_JSON_FILE_SHARED(vfs, "/assets/materials/util/effectpassthrough.json");
+        if (! json) return;
+        colorMat.FromJson(*json);
         colorMat.combos["BONECOUNT"] = 1;
         colorMat.combos["BLENDMODE"] = wpimgobj.colorBlendMode;
         colorMat.blending            = "disabled";
@@ -580,7 +757,13 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
     std::unique_ptr<WPMdl> puppet;
     if (! wpimgobj.puppet.empty()) {
         puppet = std::make_unique<WPMdl>();
-        if (! WPMdlParser::Parse(wpimgobj.puppet, vfs, *puppet)) {
+        std::shared_ptr<fs::IBinaryStream> read;
+        if (auto it = context.puppet_reads.find(wpimgobj.puppet);
+            it != context.puppet_reads.end()) {
+            read = it->second.get();
+            context.puppet_reads.erase(it);
+        }
+        if (! WPMdlParser::Parse(wpimgobj.puppet, vfs, *puppet, std::move(read))) {
             LOG_ERROR("parse puppet failed: %s", wpimgobj.puppet.c_str());
             puppet = nullptr;
         }
@@ -591,9 +774,9 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
     }
 
     // wpimgobj.origin[1] = context.ortho_h - wpimgobj.origin[1];
-    auto spImgNode = std::make_shared<SceneNode>(Vector3f(wpimgobj.origin.data()),
-                                                 Vector3f(wpimgobj.scale.data()),
-                                                 Vector3f(wpimgobj.angles.data()));
+    auto spImgNode = context.scene->arena.MakeShared<SceneNode>(Vector3f(wpimgobj.origin.data()),
+                                                                Vector3f(wpimgobj.scale.data()),
+                                                                Vector3f(wpimgobj.angles.data()));
     LoadAlignment(*spImgNode, wpimgobj.alignment, { wpimgobj.size[0], wpimgobj.size[1] });
     spImgNode->ID() = wpimgobj.id;
 
@@ -602,6 +785,8 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
 
     ShaderValueMap baseConstSvs = context.global_base_uniforms;
     WPShaderInfo   shaderInfo;
+    shaderInfo.quality  = context.quality;
+    shaderInfo.bindless = context.bindless;
     {
         if (! hasEffect) {
             svData.parallaxDepth = { wpimgobj.parallaxDepth[0], wpimgobj.parallaxDepth[1] };
@@ -627,7 +812,8 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
                            spImgNode.get(),
                            &material,
                            &svData,
-                           &shaderInfo)) {
+                           &shaderInfo,
+                           context.shader_queue)) {
             LOG_ERROR("load imageobj '%s' material faild", wpimgobj.name.c_str());
             return;
         };
@@ -657,7 +843,7 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
 
     // mesh
     SceneMesh effct_final_mesh {};
-    auto      spMesh = std::make_shared<SceneMesh>();
+    auto      spMesh = context.scene->arena.MakeShared<SceneMesh>();
     auto&     mesh   = *spMesh;
 
     {
@@ -696,6 +882,9 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
     }
     // material blendmode for last step to use
     auto imgBlendMode = material.blenmode;
+    // puppets move their vertices, compose layers draw what's beneath
+    const bool covers_view = ! puppet && ! isCompose && CoversView(context, wpimgobj, *spImgNode);
+    if (! hasEffect) material.covers_view = covers_view;
     // disable img material blend, as it's the first effect node now
     if (hasEffect) {
         material.blenmode = BlendMode::Normal;
@@ -734,6 +923,7 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
             spImgNode.get(), wpimgobj.size[0], wpimgobj.size[1], effect_ppong_a, effect_ppong_b);
         {
             imgEffectLayer->SetFinalBlend(imgBlendMode);
+            imgEffectLayer->SetFinalCoversView(covers_view);
             imgEffectLayer->FinalMesh().ChangeMeshDataFrom(effct_final_mesh);
             imgEffectLayer->FinalNode().CopyTrans(*spImgNode);
             if (isCompose) {
@@ -762,6 +952,11 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
                 i_eff--;
                 continue;
             }
+            if (wpeffobj.cosmetic && context.quality == ShaderQuality::Low) {
+                LOG_INFO("effect \'%s\' left out at low quality", wpeffobj.name.c_str());
+                i_eff--;
+                continue;
+            }
             std::shared_ptr<SceneImageEffect> imgEffect = std::make_shared<SceneImageEffect>();
 
             // this will be replace when resolve, use here to get rt info
@@ -773,25 +968,38 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
             std::unordered_map<std::string, std::string> fboMap;
             {
                 fboMap["previous"] = inRT;
+                const auto halved  = HalvedBlurFbos(wpeffobj);
                 for (usize i = 0; i < wpeffobj.fbos.size(); i++) {
                     const auto& wpfbo  = wpeffobj.fbos.at(i);
                     std::string rtname = wpfbo.name + "_" + effaddr;
+                    std::array  axis_scale { 1.0, 1.0 };
+                    if (auto it = halved.find(wpfbo.name); it != halved.end()) {
+                        axis_scale[it->second == BlurAxis::X ? 0 : 1] = 0.5;
+                        LOG_INFO("effect \'%s\' blurs into %s at half %s",
+                                 wpeffobj.name.c_str(),
+                                 wpfbo.name.c_str(),
+                                 it->second == BlurAxis::X ? "width" : "height");
+                    }
                     if (wpimgobj.fullscreen) {
                         scene.renderTargets[rtname]      = { 2, 2, true };
                         scene.renderTargets[rtname].bind = {
-                            .enable = true,
-                            .screen = true,
-                            .scale  = 1.0 / wpfbo.scale,
+                            .enable     = true,
+                            .screen     = true,
+                            .scale      = 1.0 / wpfbo.scale,
+                            .axis_scale = axis_scale,
                         };
                     } else {
                         // i+2 for not override object's rt
+                        axis_scale[0] /= wpfbo.scale;
+                        axis_scale[1] /= wpfbo.scale;
                         scene.renderTargets[rtname] = {
-                            .width      = (uint16_t)(wpimgobj.size[0] / (float)wpfbo.scale),
-                            .height     = (uint16_t)(wpimgobj.size[1] / (float)wpfbo.scale),
+                            .width      = (uint16_t)(wpimgobj.size[0] * axis_scale[0]),
+                            .height     = (uint16_t)(wpimgobj.size[1] * axis_scale[1]),
                             .allowReuse = true
                         };
                     }
-                    fboMap[wpfbo.name] = rtname;
+                    scene.renderTargets[rtname].format = FboFormat(wpfbo.format);
+                    fboMap[wpfbo.name]                 = rtname;
                 }
             }
             // load! effect commands
@@ -849,9 +1057,11 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
                 if (wpmat.textures.at(0).empty()) {
                     wpmat.textures[0] = inRT;
                 }
-                auto         spEffNode  = std::make_shared<SceneNode>();
+                auto         spEffNode  = context.scene->arena.MakeShared<SceneNode>();
                 std::string  effmataddr = getAddr(spEffNode.get());
                 WPShaderInfo wpEffShaderInfo;
+                wpEffShaderInfo.quality      = context.quality;
+                wpEffShaderInfo.bindless     = context.bindless;
                 wpEffShaderInfo.baseConstSvs = baseConstSvs;
                 wpEffShaderInfo.baseConstSvs["g_EffectTextureProjectionMatrix"] =
                     ShaderValue::fromMatrix(Eigen::Matrix4f::Identity());
@@ -865,14 +1075,15 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
                                    spEffNode.get(),
                                    &material,
                                    &svData,
-                                   &wpEffShaderInfo)) {
+                                   &wpEffShaderInfo,
+                                   context.shader_queue)) {
                     eff_mat_ok = false;
                     break;
                 }
 
                 // load glname from alias and load to constvalue
                 LoadConstvalue(material, wpmat, wpEffShaderInfo);
-                auto spMesh = std::make_shared<SceneMesh>();
+                auto spMesh = context.scene->arena.MakeShared<SceneMesh>();
                 {
                     svData.parallaxDepth = { wpimgobj.parallaxDepth[0], wpimgobj.parallaxDepth[1] };
                     if (puppet && wpmat.use_puppet) {
@@ -897,14 +1108,69 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
     context.scene->sceneGraph->AppendChild(spImgNode);
 }
 
+// subsystems of a particle object drawn from the mesh of the first, one after the other in draw
+// order
+struct ParticleBatch {
+    std::string                key;
+    ParticleSubSystem*         head { nullptr };
+    std::shared_ptr<SceneMesh> mesh;
+    const wpscene::Particle*   particle { nullptr };
+    bool                       rope { false };
+    bool                       thick_format { false };
+    bool                       instanced { false };
+    // quads of every member
+    u32 count { 0 };
+    u32 members { 1 };
+    // of the members, a child in one of them is placed like them without a transform
+    std::vector<const SceneNode*> nodes;
+};
+struct ParticleBatches {
+    std::vector<ParticleBatch> list;
+    // the subsystem parsed last is in the last batch, the next one may join it
+    bool open { false };
+};
+
 struct ParticleChildPtr {
     wpscene::ParticleChild* child { nullptr };
     SceneNode*              node_parent { nullptr };
     ParticleSubSystem*      particle_parent { nullptr };
+    ParticleBatches*        batches { nullptr };
 
     i32 max_instancecount { 1 };
 };
 
+// subsystems of equal keys draw alike, with the same pipeline, uniforms and vertex layout
+std::string ParticleBatchKey(const wpscene::Particle& particle, bool rope, bool thick_format,
+                             bool instanced, u32 maxcount) {
+    using Flag             = wpscene::Particle::FlagEnum;
+    const auto&    render  = particle.renderers.at(0);
+    nlohmann::json key     = particle.material;
+    key["cullmode"]        = particle.material.cullmode;
+    key["depthtest"]       = particle.material.depthtest;
+    key["depthwrite"]      = particle.material.depthwrite;
+    key["renderer"]        = { render.name, render.length, render.maxlength };
+    key["perspective"]     = particle.flags[Flag::perspective];
+    key["noframeblending"] = particle.flags[Flag::spritenoframeblending];
+    key["layout"]          = { rope, thick_format, instanced };
+    // trails see the max count in g_RenderVar0
+    if (send_with(render.name, "trail")) key["maxcount"] = maxcount;
+    return key.dump();
+}
+
+// the batch heads take a mesh for every member
+void SizeParticleBatches(ParticleBatches& batches) {
+    for (auto& batch : batches.list) {
+        if (batch.members < 2) continue;
+        SceneMesh mesh(true);
+        if (batch.rope)
+            SetRopeParticleMesh(mesh, *batch.particle, batch.count, batch.thick_format);
+        else
+            SetParticleMesh(
+                mesh, *batch.particle, batch.count, batch.thick_format, batch.instanced);
+        batch.mesh->ChangeMeshDataFrom(mesh);
+    }
+}
+
 void ParseParticleObj(ParseContext& context, wpscene::WPParticleObject& wppartobj,
                       ParticleChildPtr child_ptr = {}) {
     struct ChildData {
@@ -927,18 +1193,20 @@ void ParseParticleObj(ParseContext& context, wpscene::WPParticleObject& wppartob
     bool is_child = child_ptr.child != nullptr;
     if (is_child) {
         p_particle_obj = &(child_ptr.child->obj);
-        spNode         = std::make_shared<SceneNode>(Vector3f(child_ptr.child->origin.data()),
-                                             Vector3f(child_ptr.child->scale.data()),
-                                             Vector3f(child_ptr.child->angles.data()));
+        spNode         = context.scene->arena.MakeShared<SceneNode>(
+            Vector3f(child_ptr.child->origin.data()),
+            Vector3f(child_ptr.child->scale.data()),
+            Vector3f(child_ptr.child->angles.data()));
         child_data     = ChildData(*child_ptr.child);
 
         child_ptr.max_instancecount *= child_data.maxcount;
 
     } else {
         p_particle_obj = &wppartobj.particleObj;
-        spNode         = std::make_shared<SceneNode>(Vector3f(wppartobj.origin.data()),
-                                             Vector3f(wppartobj.scale.data()),
-                                             Vector3f(wppartobj.angles.data()));
+        spNode         = context.scene->arena.MakeShared<SceneNode>(
+            Vector3f(wppartobj.origin.data()),
+            Vector3f(wppartobj.scale.data()),
+            Vector3f(wppartobj.angles.data()));
     }
 
     wpscene::ParticleInstanceoverride override = wppartobj.instanceoverride;
@@ -966,6 +1234,8 @@ void ParseParticleObj(ParseContext& context, wpscene::WPParticleObject& wppartob
     }
 
     WPShaderInfo shaderInfo;
+    shaderInfo.quality                              = context.quality;
+    shaderInfo.bindless                             = context.bindless;
     shaderInfo.baseConstSvs                         = context.global_base_uniforms;
     shaderInfo.baseConstSvs["g_OrientationUp"]      = std::array { 0.0f, 1.0f, 0.0f };
     shaderInfo.baseConstSvs["g_OrientationRight"]   = std::array { 1.0f, 0.0f, 0.0f };
@@ -992,6 +1262,8 @@ void ParseParticleObj(ParseContext& context, wpscene::WPParticleObject& wppartob
     if (! particle_obj.flags[wpscene::Particle::FlagEnum::spritenoframeblending]) {
         shaderInfo.combos["SPRITESHEETBLEND"] = "1";
     }
+    // ropes connect neighbouring particles, they keep expanding on cpu
+    shaderInfo.particle_instanced = ! render_rope;
 
     if (! LoadMaterial(vfs,
                        particle_obj.material,
@@ -999,12 +1271,13 @@ void ParseParticleObj(ParseContext& context, wpscene::WPParticleObject& wppartob
                        spNode.get(),
                        &material,
                        &svData,
-                       &shaderInfo)) {
+                       &shaderInfo,
+                       context.shader_queue)) {
         LOG_ERROR("load particleobj '%s' material faild", wppartobj.name.c_str());
         return;
     }
     LoadConstvalue(material, particle_obj.material, shaderInfo);
-    auto  spMesh             = std::make_shared<SceneMesh>(true);
+    auto  spMesh             = context.scene->arena.MakeShared<SceneMesh>(true);
     auto& mesh               = *spMesh;
     auto  animationmode      = ToAnimMode(particle_obj.animationmode);
     auto  sequencemultiplier = particle_obj.sequencemultiplier;
@@ -1017,7 +1290,8 @@ void ParseParticleObj(ParseContext& context, wpscene::WPParticleObject& wppartob
         if (render_rope)
             SetRopeParticleMesh(mesh, particle_obj, mesh_maxcount, thick_format);
         else
-            SetParticleMesh(mesh, particle_obj, mesh_maxcount, thick_format);
+            SetParticleMesh(
+                mesh, particle_obj, mesh_maxcount, thick_format, shaderInfo.particle_instanced);
     }
 
     auto particleSub = std::make_unique<ParticleSubSystem>(
@@ -1028,16 +1302,18 @@ void ParseParticleObj(ParseContext& context, wpscene::WPParticleObject& wppartob
         child_data.maxcount,
         child_data.probability,
         ParseSpawnType(child_data.type),
-        [=](const Particle& p, const ParticleRawGenSpec& spec) {
+        [=](const ParticleBuffer& ps, usize i, const ParticleRawGenSpec& spec) {
             auto& lifetime = *(spec.lifetime);
             if (lifetime <= 0.0f) {
                 lifetime = 0.0f;
                 return;
             }
+            float init_lifetime = ps.at(ParticleBuffer::InitLifetime, i);
             switch (animationmode) {
-            case ParticleAnimationMode::RANDOMONE: lifetime = std::floor(p.init.lifetime); break;
+            case ParticleAnimationMode::RANDOMONE: lifetime = std::floor(init_lifetime); break;
             case ParticleAnimationMode::SEQUENCE:
-                lifetime = (1.0f - (p.lifetime / p.init.lifetime)) * sequencemultiplier;
+                lifetime = (1.0f - (ps.at(ParticleBuffer::Lifetime, i) / init_lifetime)) *
+                           sequencemultiplier;
                 break;
             }
         });
@@ -1046,9 +1322,73 @@ void ParseParticleObj(ParseContext& context, wpscene::WPParticleObject& wppartob
     LoadInitializer(*particleSub, particle_obj, override);
     LoadOperator(*particleSub, particle_obj, override);
     LoadControlPoint(*particleSub, particle_obj);
+    // blended over each other in 3d, drawn back to front, additive ones look the same any order
+    if (particle_obj.flags[wpscene::Particle::FlagEnum::perspective] && ! render_rope &&
+        material.blenmode == BlendMode::Translucent) {
+        particleSub->SetDepthSort([scene = context.scene.get(), node = spNode.get()](auto& plane) {
+            return ViewDepthPlane(*scene, *node, plane);
+        });
+    }
+    const bool on_gpu = particleSub->EnableGpuSim(animationmode, sequencemultiplier);
+    // a rope with fewer particles is a shorter rope
+    if (render_rope) particleSub->SetLodFloor(1.0f);
+    if (! is_child) {
+        particleSub->SetVisibleTest([scene = context.scene.get(), node = spNode.get()](
+                                        const auto& lo, const auto& hi) {
+            return BoundsInView(*scene, *node, lo, hi);
+        });
+    }
+
+    // subsystems following each other in draw order with the same material draw as one, the
+    // gpu writes a mesh of its own
+    ParticleBatches  own_batches;
+    ParticleBatches& batches = is_child ? *child_ptr.batches : own_batches;
+    bool             joined { false };
+    {
+        u32         mesh_maxcount = maxcount * (u32)child_ptr.max_instancecount;
+        std::string key           = ParticleBatchKey(
+            particle_obj, render_rope, thick_format, shaderInfo.particle_instanced, maxcount);
+        if (is_child && batches.open && ! on_gpu) {
+            auto&       batch  = batches.list.back();
+            const auto& child  = *child_ptr.child;
+            const bool  placed = child.origin == std::array { 0.0f, 0.0f, 0.0f } &&
+                                child.angles == std::array { 0.0f, 0.0f, 0.0f } &&
+                                child.scale == std::array { 1.0f, 1.0f, 1.0f } &&
+                                std::find(batch.nodes.begin(),
+                                          batch.nodes.end(),
+                                          child_ptr.node_parent) != batch.nodes.end();
+            // u16 indices reach 16k quads
+            const bool fits = batch.rope || batch.instanced ||
+                              ((usize)batch.count + mesh_maxcount) * 4 <=
+                                  std::numeric_limits<u16>::max();
+            joined = batch.key == key && placed && fits;
+            if (joined) {
+                particleSub->JoinBatch(*batch.head);
+                batch.count += mesh_maxcount;
+                batch.members++;
+                batch.nodes.push_back(spNode.get());
+            }
+        }
+        if (! joined) {
+            batches.open = ! on_gpu && svData.parallaxDepth == std::array { 0.0f, 0.0f };
+            if (batches.open) {
+                batches.list.push_back(ParticleBatch {
+                    .key          = std::move(key),
+                    .head         = particleSub.get(),
+                    .mesh         = spMesh,
+                    .particle     = &particle_obj,
+                    .rope         = render_rope,
+                    .thick_format = thick_format,
+                    .instanced    = shaderInfo.particle_instanced,
+                    .count        = mesh_maxcount,
+                    .nodes        = { spNode.get() },
+                });
+            }
+        }
+    }
 
     mesh.AddMaterial(std::move(material));
-    spNode->AddMesh(spMesh);
+    if (! joined) spNode->AddMesh(spMesh);
     context.shader_updater->SetNodeData(spNode.get(), svData);
 
     for (auto& child : particle_obj.children) {
@@ -1058,9 +1398,11 @@ void ParseParticleObj(ParseContext& context, wpscene::WPParticleObject& wppartob
                              .child             = &child,
                              .node_parent       = spNode.get(),
                              .particle_parent   = particleSub.get(),
+                             .batches           = &batches,
                              .max_instancecount = child_ptr.max_instancecount,
                          });
     }
+    if (! is_child) SizeParticleBatches(batches);
 
     if (is_child)
         child_ptr.particle_parent->AddChild(std::move(particleSub));
@@ -1074,9 +1416,9 @@ void ParseParticleObj(ParseContext& context, wpscene::WPParticleObject& wppartob
 }
 
 void ParseLightObj(ParseContext& context, wpscene::WPLightObject& light_obj) {
-    auto node = std::make_shared<SceneNode>(Vector3f(light_obj.origin.data()),
-                                            Vector3f(light_obj.scale.data()),
-                                            Vector3f(light_obj.angles.data()));
+    auto node = context.scene->arena.MakeShared<SceneNode>(Vector3f(light_obj.origin.data()),
+                                                           Vector3f(light_obj.scale.data()),
+                                                           Vector3f(light_obj.angles.data()));
 
     context.scene->lights.emplace_back(std::make_unique<SceneLight>(
         Vector3f(light_obj.color.data()), light_obj.radius, light_obj.intensity));
@@ -1088,22 +1430,64 @@ void ParseLightObj(ParseContext& context, wpscene::WPLightObject& light_obj) {
 }
 
 template<typename T>
-void AddWPObject(std::vector<WPObjectVar>& objs, const nlohmann::json& json_obj, fs::VFS& vfs) {
+void ReadWPObject(std::optional<WPObjectVar>& slot, const nlohmann::json& json_obj,
+                  fs::VFS& vfs) {
+    // a layer hidden by its user property isn't read, the files it names are left for the load
+    // that shows it
+    bool visible { true };
+    GET_JSON_NAME_VALUE_NOWARN(json_obj, "visible", visible);
+    if (! visible) return;
+
     T wpobj;
     if (! wpobj.FromJson(json_obj, vfs)) {
         LOG_ERROR("parse scene object failed, name: %s", wpobj.name.c_str());
         return;
     }
     if (! wpobj.visible) return;
-    objs.push_back(wpobj);
+    slot = std::move(wpobj);
 }
-} // namespace
 
-std::shared_ptr<Scene> WPSceneParser::Parse(std::string_view scene_id, const std::string& buf,
-                                            fs::VFS& vfs, audio::SoundManager& sm,
-                                            const std::string& userPropsOverride) {
-    // Load user properties from project.json if available
-    WPUserProperties userProps;
+// objects read their own json and the material, effect and particle files it names
+// independently, so they are read on jobs, each into its slot
+std::vector<WPObjectVar> ReadWPObjects(const nlohmann::json& objects, fs::VFS& vfs) {
+    std::vector<const nlohmann::json*> jsons;
+    for (auto& obj : objects) jsons.push_back(&obj);
+
+    const auto* props = g_currentUserProperties;
+    auto*       cache = JsonFileCache::Current();
+
+    std::vector<std::optional<WPObjectVar>> slots(jsons.size());
+    looper::JobSystem::Shared().parallelFor(
+        jsons.size(),
+        [&](usize i) {
+            TRACE_ZONE("ReadWPObject");
+            UserPropertiesScope  props_scope(props);
+            JsonFileCache::Scope cache_scope(cache);
+
+            auto& obj = *jsons[i];
+            if (obj.contains("image") && ! obj.at("image").is_null()) {
+                ReadWPObject<wpscene::WPImageObject>(slots[i], obj, vfs);
+            } else if (obj.contains("particle") && ! obj.at("particle").is_null()) {
+                ReadWPObject<wpscene::WPParticleObject>(slots[i], obj, vfs);
+            } else if (obj.contains("sound") && ! obj.at("sound").is_null()) {
+                ReadWPObject<wpscene::WPSoundObject>(slots[i], obj, vfs);
+            } else if (obj.contains("light") && ! obj.at("light").is_null()) {
+                ReadWPObject<wpscene::WPLightObject>(slots[i], obj, vfs);
+            }
+        },
+        looper::JobPriority::Load);
+
+    // in file order whatever order the jobs ran in
+    std::vector<WPObjectVar> wp_objs;
+    for (auto& slot : slots) {
+        if (slot) wp_objs.push_back(std::move(*slot));
+    }
+    return wp_objs;
+}
+
+// from project.json, with the host's overrides on top
+void LoadUserProperties(fs::VFS& vfs, const std::string& userPropsOverride,
+                        WPUserProperties& userProps) {
     if (vfs.Contains("/assets/project.json")) {
         auto projectFile = vfs.Open("/assets/project.json");
         if (projectFile) {
@@ -1119,33 +1503,13 @@ std::shared_ptr<Scene> WPSceneParser::Parse(std::string_view scene_id, const std
         LOG_INFO("Applying user properties override: %s", userPropsOverride.c_str());
         userProps.ApplyOverrides(userPropsOverride);
     }
+}
 
-    // Set user properties context for the duration of parsing
-    UserPropertiesScope propsScope(&userProps);
-
-    nlohmann::json json;
-    if (! PARSE_JSON(buf, json)) return nullptr;
-    wpscene::WPScene sc;
-    sc.FromJson(json);
-    //	LOG_INFO(nlohmann::json(sc).dump(4));
-
-    ParseContext context;
-
-    std::vector<WPObjectVar> wp_objs;
-
-    for (auto& obj : json.at("objects")) {
-        if (obj.contains("image") && ! obj.at("image").is_null()) {
-            AddWPObject<wpscene::WPImageObject>(wp_objs, obj, vfs);
-        } else if (obj.contains("particle") && ! obj.at("particle").is_null()) {
-            AddWPObject<wpscene::WPParticleObject>(wp_objs, obj, vfs);
-        } else if (obj.contains("sound") && ! obj.at("sound").is_null()) {
-            AddWPObject<wpscene::WPSoundObject>(wp_objs, obj, vfs);
-        } else if (obj.contains("light") && ! obj.at("light").is_null()) {
-            AddWPObject<wpscene::WPLightObject>(wp_objs, obj, vfs);
-        }
-    }
-
-    if (sc.general.orthogonalprojection.auto_) {
+// the canvas size as Parse works it out
+std::array<i32, 2> OrthoSize(wpscene::WPSceneGeneral& general,
+                             const std::vector<WPObjectVar>& wp_objs) {
+    auto& ortho = general.orthogonalprojection;
+    if (ortho.auto_) {
         i32 w = 0, h = 0;
         for (auto& obj : wp_objs) {
             auto* img = std::get_if<wpscene::WPImageObject>(&obj);
@@ -1156,8 +1520,150 @@ std::shared_ptr<Scene> WPSceneParser::Parse(std::string_view scene_id, const std
                 h = (i32)img->size.at(1);
             }
         }
-        sc.general.orthogonalprojection.width  = w;
-        sc.general.orthogonalprojection.height = h;
+        ortho.width  = w;
+        ortho.height = h;
+    }
+    return { ortho.width, ortho.height };
+}
+
+// counts what Estimate reports, the textures and shader variants by name so shared ones count once
+struct CostCounter {
+    SceneCost&            cost;
+    IImageParser&         images;
+    std::array<i32, 2>    ortho;
+    std::set<std::string> textures {};
+    std::set<std::string> variants {};
+
+    static u64 TexelBytes(TextureFormat format, u64 texels) {
+        switch (format) {
+        case TextureFormat::BC1: return texels / 2;
+        case TextureFormat::BC2:
+        case TextureFormat::BC3:
+        case TextureFormat::R8: return texels;
+        case TextureFormat::RG8: return texels * 2;
+        default: return texels * 4;
+        }
+    }
+
+    void target(i32 width, i32 height, TextureFormat format = TextureFormat::RGBA8,
+                bool mipmap = false) {
+        u64 size = TexelBytes(format, (u64)std::max(width, 1) * (u64)std::max(height, 1));
+        cost.targets++;
+        cost.target_bytes += mipmap ? size * 4 / 3 : size;
+    }
+
+    void material(const wpscene::WPMaterial& mat) {
+        // the combos go into the shader in name order
+        std::string variant = mat.shader;
+        for (auto& combo : std::map<std::string, i32>(mat.combos.begin(), mat.combos.end()))
+            variant += " " + combo.first + "=" + std::to_string(combo.second);
+        if (variants.insert(variant).second) cost.shader_variants++;
+
+        for (auto& name : mat.textures) {
+            if (name.empty() || IsSpecTex(name) || ! textures.insert(name).second) continue;
+            auto texh = images.ParseHeader(name);
+            i32  w    = texh.mipWidth > 0 ? texh.mipWidth : texh.mapWidth;
+            i32  h    = texh.mipHeight > 0 ? texh.mipHeight : texh.mapHeight;
+            u64  size = TexelBytes(texh.format, (u64)std::max(w, 0) * (u64)std::max(h, 0));
+            if (texh.mipCount > 1) size = size * 4 / 3;
+            cost.textures++;
+            cost.texture_bytes += size * (u64)std::max(texh.count, 1);
+        }
+    }
+
+    void image(const wpscene::WPImageObject& img) {
+        std::vector<const wpscene::WPImageEffect*> effects;
+        for (auto& eff : img.effects)
+            if (eff.visible) effects.push_back(&eff);
+        // as Parse, a compose or fullscreen layer without effects draws nothing
+        const bool compose = img.image == "models/util/composelayer.json";
+        const bool blend   = img.colorBlendMode != 0;
+        if (effects.empty() && ! blend && (compose || img.fullscreen)) return;
+
+        material(img.material);
+        cost.passes++;
+        if (effects.empty() && ! blend) return;
+
+        // drawn into two targets of its size and composed from the last
+        const i32 w = img.fullscreen ? ortho[0] : (i32)img.size[0];
+        const i32 h = img.fullscreen ? ortho[1] : (i32)img.size[1];
+        target(w, h);
+        target(w, h);
+        cost.passes += blend ? 2 : 1;
+        for (auto* eff : effects) {
+            for (auto& fbo : eff->fbos) {
+                const i32 scale = (i32)std::max(fbo.scale, 1u);
+                target(w / scale, h / scale, FboFormat(fbo.format));
+            }
+            for (usize i = 0; i < eff->materials.size(); i++) {
+                wpscene::WPMaterial mat = eff->materials[i];
+                if (i < eff->passes.size()) mat.MergePass(eff->passes[i]);
+                material(mat);
+            }
+            cost.passes += (u32)(eff->materials.size() + eff->commands.size());
+        }
+    }
+
+    void particle(const wpscene::Particle& obj, u64 instances) {
+        material(obj.material);
+        cost.passes++;
+        cost.particles += std::min(obj.maxcount, 20000u) * instances;
+        for (auto& child : obj.children)
+            particle(child.obj, instances * (u64)std::max(child.maxcount, 1));
+    }
+};
+} // namespace
+
+std::shared_ptr<Scene> WPSceneParser::Parse(std::string_view scene_id, const std::string& buf,
+                                            fs::VFS& vfs, audio::SoundManager& sm,
+                                            const std::string& userPropsOverride) {
+    TRACE_ZONE("WPSceneParser::Parse");
+    m_property_uses.clear();
+    m_shader_time = {};
+    m_shader_loads.clear();
+    // Load user properties from project.json if available
+    WPUserProperties userProps;
+    LoadUserProperties(vfs, userPropsOverride, userProps);
+
+    // Set user properties context for the duration of parsing
+    UserPropertiesScope propsScope(&userProps);
+    // objects sharing a material, effect or particle file read it once
+    JsonFileCache       json_cache;
+    JsonFileCache::Scope json_cache_scope(&json_cache);
+
+    // a warm load takes the scene and the files it read from the last one
+    auto           scene_cache = WPSceneCache::FromVfs(vfs);
+    std::string    scene_key   = scene_cache ? WPSceneCache::Key(buf) : std::string();
+    nlohmann::json json;
+    bool           cached = scene_cache && scene_cache->Load(scene_key, vfs, json, json_cache);
+    if (! cached && ! PARSE_JSON(buf, json)) return nullptr;
+    memuse::Held json_held { memuse::Pool::Json, JsonBytes(json) };
+    // what the objects read next comes from the pkg, its disk reads overlap the parse
+    vfs.Prefetch("/assets");
+    const usize cached_files = json_cache.size();
+    wpscene::WPScene sc;
+    sc.FromJson(json);
+    //	LOG_INFO(nlohmann::json(sc).dump(4));
+
+    ParseContext context;
+    context.quality  = m_quality;
+    context.bindless = m_bindless;
+
+    std::vector<WPObjectVar> wp_objs = ReadWPObjects(json.at("objects"), vfs);
+    memuse::Held objs_held { memuse::Pool::SceneObjects, wp_objs.capacity() * sizeof(WPObjectVar) };
+    LOG_INFO("read %zu json files for %zu objects, %zu reads shared",
+             json_cache.size(),
+             wp_objs.size(),
+             json_cache.hits());
+
+    (void)OrthoSize(sc.general, wp_objs);
+
+    // the objects before a puppet parse while it's read
+    for (auto& obj : wp_objs) {
+        auto* img = std::get_if<wpscene::WPImageObject>(&obj);
+        if (img == nullptr || img->puppet.empty() || context.puppet_reads.count(img->puppet) != 0)
+            continue;
+        context.puppet_reads[img->puppet] = vfs.ReadAsync("/assets/" + img->puppet);
     }
 
     InitContext(context, vfs, sc);
@@ -1183,7 +1689,10 @@ std::shared_ptr<Scene> WPSceneParser::Parse(std::string_view scene_id, const std
 
     context.scene->scene_id = scene_id;
 
-    WPShaderParser::InitGlslang();
+    // compiles wait for every object, then run together
+    auto                 shader_cache = WPShaderCache::FromVfs(vfs);
+    WPShaderCompileQueue shader_queue(shader_cache.get());
+    context.shader_queue = &shader_queue;
 
     for (WPObjectVar& obj : wp_objs) {
         std::visit(visitor::overload {
@@ -1193,8 +1702,8 @@ std::shared_ptr<Scene> WPSceneParser::Parse(std::string_view scene_id, const std
                        [&context](wpscene::WPParticleObject& obj) {
                            ParseParticleObj(context, obj);
                        },
-                       [&context, &sm](wpscene::WPSoundObject& obj) {
-                           WPSoundParser::Parse(obj, *context.vfs, sm);
+                       [this, &context, &sm](wpscene::WPSoundObject& obj) {
+                           if (m_sounds) WPSoundParser::Parse(obj, *context.vfs, sm);
                        },
                        [&context](wpscene::WPLightObject& obj) {
                            ParseLightObj(context, obj);
@@ -1203,6 +1712,56 @@ std::shared_ptr<Scene> WPSceneParser::Parse(std::string_view scene_id, const std
                    obj);
     }
 
-    WPShaderParser::FinalGlslang();
+    auto shader_begin = std::chrono::steady_clock::now();
+    if (! shader_queue.Run()) LOG_ERROR("some shaders failed to compile");
+    m_shader_time        = std::chrono::steady_clock::now() - shader_begin;
+    m_shader_loads       = shader_queue.Loads();
+    context.shader_queue = nullptr;
+
+    m_property_uses = userProps.Uses();
+    context.scene->nodeTable.Build(*context.scene->sceneGraph);
+    if (scene_cache && (! cached || json_cache.size() > cached_files))
+        scene_cache->Save(scene_key, vfs, json, json_cache);
     return context.scene;
 }
+
+bool WPSceneParser::Estimate(const std::string& buf, fs::VFS& vfs, SceneCost& cost,
+                             const std::string& userPropsOverride) {
+    TRACE_ZONE("WPSceneParser::Estimate");
+    WPUserProperties userProps;
+    LoadUserProperties(vfs, userPropsOverride, userProps);
+    UserPropertiesScope  propsScope(&userProps);
+    JsonFileCache        json_cache;
+    JsonFileCache::Scope json_cache_scope(&json_cache);
+
+    nlohmann::json json;
+    if (! PARSE_JSON(buf, json)) return false;
+    wpscene::WPScene sc;
+    sc.FromJson(json);
+    std::vector<WPObjectVar> wp_objs = ReadWPObjects(json.at("objects"), vfs);
+
+    cost = {};
+    WPTexImageParser images(&vfs);
+    CostCounter      counter {
+             .cost = cost, .images = images, .ortho = OrthoSize(sc.general, wp_objs)
+    };
+    // the default target and its mipmapped copy
+    counter.target(counter.ortho[0], counter.ortho[1]);
+    counter.target(counter.ortho[0], counter.ortho[1], TextureFormat::RGBA8, true);
+    for (auto& obj : wp_objs) {
+        if (auto* img = std::get_if<wpscene::WPImageObject>(&obj)) {
+            counter.image(*img);
+        } else if (auto* part = std::get_if<wpscene::WPParticleObject>(&obj)) {
+            auto& over = part->instanceoverride;
+            counter.particle(part->particleObj,
+                             over.enabled ? (u64)std::max(std::ceil(over.count), 1.0f) : 1u);
+        }
+    }
+    LOG_INFO("scene cost: textures %.1fm, targets %.1fm, %u passes, %llu particles, %u shaders",
+             (double)cost.texture_bytes / (1024.0 * 1024.0),
+             (double)cost.target_bytes / (1024.0 * 1024.0),
+             cost.passes,
+             (unsigned long long)cost.particles,
+             cost.shader_variants);
+    return true;
+}
@@ -1,14 +1,48 @@
 #pragma once
 #include "Interface/ISceneParser.h"
+#include "WPShaderParser.hpp"
+#include "WPUserProperties.hpp"
+#include <chrono>
 #include <random>
+#include <vector>
 
 namespace wallpaper
 {
 
+struct SceneCost;
+
 class WPSceneParser : public ISceneParser {
 public:
     WPSceneParser()  = default;
     ~WPSceneParser() = default;
     std::shared_ptr<Scene> Parse(std::string_view scene_id, const std::string&, fs::VFS&, audio::SoundManager&, const std::string& userPropsOverride = "") override;
+
+    // what the scene in buf would take, from its json, the files its objects name and the headers
+    // of its textures, nothing is decoded or compiled
+    static bool Estimate(const std::string& buf, fs::VFS&, SceneCost&,
+                         const std::string& userPropsOverride = "");
+
+    // false leaves sound objects out of the scenes parsed next, nothing of them is read
+    void SetSounds(bool v) { m_sounds = v; }
+    // of the scenes parsed next, low leaves out cosmetic effects and compiles cheaper shaders
+    void SetQuality(ShaderQuality v) { m_quality = v; }
+    // the renderer samples textures out of one array, the shaders of the scenes parsed next are
+    // translated for it, see WPShaderInfo::bindless
+    void SetBindless(bool v) { m_bindless = v; }
+
+    // the user properties the last parse read and what for
+    const UserPropertyUses& PropertyUses() const { return m_property_uses; }
+    // of the last parse, the glslang compiles of the shaders the cache didn't have
+    std::chrono::nanoseconds ShaderTime() const { return m_shader_time; }
+    // of the last parse, every shader and if it came from the cache
+    const std::vector<WPShaderLoad>& ShaderLoads() const { return m_shader_loads; }
+
+private:
+    bool                      m_sounds { true };
+    ShaderQuality             m_quality { ShaderQuality::Full };
+    bool                      m_bindless { false };
+    UserPropertyUses          m_property_uses;
+    std::chrono::nanoseconds  m_shader_time { 0 };
+    std::vector<WPShaderLoad> m_shader_loads;
 };
 } // namespace wallpaper
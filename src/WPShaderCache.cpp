@@ -0,0 +1,186 @@
+#include "WPShaderCache.hpp"
+#include "WPShaderParser.hpp"
+#include "WPShaderPack.hpp"
+
+#include "Fs/VFS.h"
+#include "Fs/IBinaryStream.h"
+#include "Fs/MemBinaryStream.h"
+#include "Utils/Logging.h"
+#include "Utils/Counters.hpp"
+#include "WPCommon.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+// 03 has keys of utils::genKeyHash instead of sha1
+#define SHADER_DIR    "spvs03"
+#define SHADER_SUFFIX "spvs"
+#define PRE_SUFFIX    "pre"
+// its own directory, the lru trim of the files leaves it be
+#define PACK_DIR "spvpack"
+
+using namespace wallpaper;
+namespace sfs = std::filesystem;
+
+namespace
+{
+// version 2 has the packed reflection after the codes
+inline bool LoadShaderFromFile(std::vector<ShaderCode>& codes, std::string& reflection,
+                               fs::IBinaryStream& file) {
+    codes.clear();
+    reflection.clear();
+    i32 ver = ReadSPVVesion(file);
+    if (ver != 1 && ver != 2) return false;
+
+    usize count = file.ReadUint32();
+    if (count > 16) return false;
+
+    codes.resize(count);
+    for (usize i = 0; i < count; i++) {
+        auto& c = codes[i];
+
+        u32 size = file.ReadUint32();
+        if (size % 4 != 0) return false;
+
+        c.resize(size / 4);
+        if (file.Read((char*)c.data(), size) != size) return false;
+    }
+    if (ver == 2) {
+        u32 size = file.ReadUint32();
+        if (size > (u32)file.Size()) return false;
+        reflection.resize(size);
+        if (file.Read(reflection.data(), size) != size) return false;
+    }
+    return true;
+}
+
+inline void SaveShaderToFile(std::span<const ShaderCode> codes, std::string_view reflection,
+                             fs::IBinaryStreamW& file) {
+    char nop[256] { '\0' };
+
+    WriteSPVVesion(file, 2);
+    file.WriteUint32((u32)codes.size());
+    for (const auto& c : codes) {
+        u32 size = (u32)c.size() * 4;
+        file.WriteUint32(size);
+        file.Write((const char*)c.data(), size);
+    }
+    file.WriteUint32((u32)reflection.size());
+    file.Write(reflection.data(), reflection.size());
+    file.Write(nop, sizeof(nop));
+}
+} // namespace
+
+WPShaderCache::WPShaderCache(sfs::path dir, u64 max_bytes): m_dir(std::move(dir), max_bytes) {}
+
+std::unique_ptr<WPShaderCache> WPShaderCache::FromVfs(fs::VFS& vfs) {
+    auto  dir     = WPCacheDir::FromVfs(vfs, SHADER_DIR);
+    auto* bundled = WPCacheDir::Bundled(vfs);
+    if (dir.empty() && bundled == nullptr) return nullptr;
+    auto cache = std::make_unique<WPShaderCache>(dir);
+    if (bundled != nullptr) {
+        cache->m_dir.SetBundled(bundled, SHADER_DIR);
+        auto path = "/assets" + std::string(WPCacheDir::BundledDir) + PACK_DIR "/" +
+                    std::string(WPShaderPack::FileName);
+        if (bundled->Contains(path))
+            cache->m_bundled_pack = WPShaderPack::FromStream(vfs.Open(path));
+    }
+    if (auto pack_dir = WPCacheDir::FromVfs(vfs, PACK_DIR); ! pack_dir.empty())
+        cache->m_pack = WPShaderPack::Shared(pack_dir, DefaultMaxBytes);
+    return cache;
+}
+
+bool WPShaderCache::readPacked(std::string_view name,
+                               const std::function<bool(fs::IBinaryStream&)>& read) {
+    return (m_bundled_pack && m_bundled_pack->Read(name, read)) ||
+           (m_pack && m_pack->Read(name, read));
+}
+
+bool WPShaderCache::Load(std::string_view key, std::vector<ShaderCode>& codes,
+                         std::string& reflection) {
+    using counters::Counter;
+    const auto name = std::string(key) + "." SHADER_SUFFIX;
+    u64        size { 0 };
+    bool       found = readPacked(name, [&](fs::IBinaryStream& file) {
+        size = (u64)file.Size();
+        return ::LoadShaderFromFile(codes, reflection, file);
+    });
+
+    auto path = m_dir.FilePath(key, SHADER_SUFFIX);
+    if (! found) {
+        auto file = m_dir.Open(path);
+        if (! file) {
+            counters::Add(Counter::ShaderMisses);
+            return false;
+        }
+        size  = (u64)file->Size();
+        found = ::LoadShaderFromFile(codes, reflection, *file);
+    }
+    if (! found) {
+        LOG_ERROR("broken shader cache \'%s\'", path.c_str());
+        codes.clear();
+        reflection.clear();
+        counters::Add(Counter::ShaderMisses);
+        return false;
+    }
+    counters::Add(Counter::ShaderHits);
+    counters::Add(Counter::ShaderLoadedBytes, size);
+    return true;
+}
+
+void WPShaderCache::Save(std::string_view key, std::span<const ShaderCode> codes,
+                         std::string_view reflection) {
+    if (m_pack) {
+        fs::MemBinaryStreamW data;
+        ::SaveShaderToFile(codes, reflection, data);
+        if (m_pack->Append(std::string(key) + "." SHADER_SUFFIX, data.Data())) return;
+    }
+    auto path = m_dir.FilePath(key, SHADER_SUFFIX);
+    m_dir.WriteFile(path, [codes, reflection](fs::IBinaryStreamW& file) {
+        ::SaveShaderToFile(codes, reflection, file);
+    });
+}
+
+bool WPShaderCache::LoadPreprocessed(std::string_view pre_key, std::string& key,
+                                     std::span<WPShaderUnit> units) {
+    std::string text;
+    if (! readPacked(std::string(pre_key) + "." PRE_SUFFIX, [&text](fs::IBinaryStream& file) {
+            text = file.ReadAllStr();
+            return true;
+        })) {
+        auto file = m_dir.Open(m_dir.FilePath(pre_key, PRE_SUFFIX));
+        if (! file) return false;
+        text = file->ReadAllStr();
+    }
+
+    // version, the spirv key, then the active texture slots of every unit a line each
+    std::istringstream in(text);
+    std::string        line;
+    if (! std::getline(in, line) || line != "PRE1") return false;
+    if (! std::getline(in, key) || key.empty()) return false;
+    for (auto& unit : units) {
+        if (! std::getline(in, line)) return false;
+        std::istringstream slots(line);
+        unit.preprocess_info.active_tex_slots.clear();
+        for (uint slot; slots >> slot;) unit.preprocess_info.active_tex_slots.insert(slot);
+    }
+    return true;
+}
+
+void WPShaderCache::SavePreprocessed(std::string_view pre_key, std::string_view key,
+                                     std::span<const WPShaderUnit> units) {
+    std::string data = "PRE1\n" + std::string(key) + "\n";
+    for (auto& unit : units) {
+        for (uint slot : unit.preprocess_info.active_tex_slots) data += std::to_string(slot) + " ";
+        data += "\n";
+    }
+    if (m_pack && m_pack->Append(std::string(pre_key) + "." PRE_SUFFIX,
+                                 { (const uint8_t*)data.data(), data.size() }))
+        return;
+    m_dir.WriteFile(m_dir.FilePath(pre_key, PRE_SUFFIX), [&data](fs::IBinaryStreamW& file) {
+        file.Write(data.data(), data.size());
+    });
+}
+
+void WPShaderCache::Trim() { m_dir.Trim(); }
@@ -0,0 +1,79 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+#include "Core/MapSet.hpp"
+#include "Utils/MemUse.hpp"
+#include "Scene/SceneShader.h"
+#include "WPCacheDir.hpp"
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace wallpaper
+{
+namespace fs
+{
+class VFS;
+class IBinaryStream;
+} // namespace fs
+struct WPShaderUnit;
+class WPShaderPack;
+
+// Compiled shaders of every wallpaper in one directory of the cache, named by the sha of the
+// preprocessed sources and the compile options, so generic shaders are compiled once for all.
+// The directory is a WPCacheDir, renderer processes share it.
+// Preprocessing is recorded beside, so a warm load goes from the expanded sources to the spirv
+// without the glslang preprocessor and string passes. One is made per scene load, it also keeps
+// the includes read by the load.
+// Both are kept in a WPShaderPack of the cache folder when there is one, files of the directory
+// from before it or from a bundle without a pack are still read.
+class WPShaderCache : NoCopy, NoMove {
+public:
+    constexpr static u64 DefaultMaxBytes { 256ull << 20 };
+
+    explicit WPShaderCache(std::filesystem::path dir, u64 max_bytes = DefaultMaxBytes);
+
+    // in the mounted cache folder, read only from a bundle at /assets, null with neither
+    static std::unique_ptr<WPShaderCache> FromVfs(fs::VFS&);
+
+    // false on a miss or a broken file, files from before reflection was kept have none
+    bool Load(std::string_view key, std::vector<ShaderCode>&, std::string& reflection);
+    void Save(std::string_view key, std::span<const ShaderCode>, std::string_view reflection);
+
+    // the spirv key of the units preprocessed, and what preprocessing tells LoadMaterial
+    bool LoadPreprocessed(std::string_view pre_key, std::string& key, std::span<WPShaderUnit>);
+    void SavePreprocessed(std::string_view pre_key, std::string_view key,
+                          std::span<const WPShaderUnit>);
+
+    // expanded includes by file name, for this load only, assets differ between wallpapers, null
+    // if it wasn't read yet
+    const std::string* FindInclude(const std::string& name) const {
+        auto it = m_includes.find(name);
+        return it != m_includes.end() ? &it->second : nullptr;
+    }
+    void AddInclude(const std::string& name, std::string expanded) {
+        const usize bytes = name.size() + expanded.size();
+        if (m_includes.emplace(name, std::move(expanded)).second)
+            m_includes_held.set(m_includes_held.bytes() + bytes);
+    }
+
+    // after a load saved something, cheap otherwise
+    void Trim();
+
+private:
+    // of the pack, the bundle's first
+    bool readPacked(std::string_view name, const std::function<bool(fs::IBinaryStream&)>&);
+
+    WPCacheDir                    m_dir;
+    std::shared_ptr<WPShaderPack> m_pack;
+    std::shared_ptr<WPShaderPack> m_bundled_pack;
+
+    Map<std::string, std::string> m_includes;
+    memuse::Held                  m_includes_held { memuse::Pool::ShaderSource };
+};
+
+} // namespace wallpaper
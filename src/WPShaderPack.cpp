@@ -0,0 +1,276 @@
+#include "WPShaderPack.hpp"
+#include "Fs/IBinaryStream.h"
+#include "Fs/SpanBinaryStream.h"
+#include "Utils/Logging.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace wallpaper;
+namespace sfs = std::filesystem;
+
+namespace
+{
+constexpr std::string_view pack_magic { "WPSPACK1" };
+constexpr u32              record_magic { 0x31525053 }; // SPR1
+constexpr usize            record_head { 4 * 4 };
+// compacted below the limit, so the next appends don't compact again
+constexpr u64 compact_to_percent { 75 };
+
+u32 Fnv1a(std::span<const uint8_t> data, u32 hash = 0x811c9dc5u) {
+    for (u8 c : data) {
+        hash ^= c;
+        hash *= 0x01000193u;
+    }
+    return hash;
+}
+
+u32 ReadU32(const uint8_t* p) {
+    return (u32)p[0] | (u32)p[1] << 8 | (u32)p[2] << 16 | (u32)p[3] << 24;
+}
+void PutU32(std::vector<uint8_t>& out, u32 x) {
+    for (usize i = 0; i < 4; i++) out.push_back((uint8_t)(x >> (8 * i)));
+}
+
+u64 PaddedSize(usize key, usize data) { return (record_head + key + data + 7) / 8 * 8; }
+
+void PutRecord(std::vector<uint8_t>& out, std::string_view key, std::span<const uint8_t> data) {
+    const auto* k = (const uint8_t*)key.data();
+    PutU32(out, record_magic);
+    PutU32(out, (u32)key.size());
+    PutU32(out, (u32)data.size());
+    PutU32(out, Fnv1a(data, Fnv1a({ k, key.size() })));
+    out.insert(out.end(), k, k + key.size());
+    out.insert(out.end(), data.begin(), data.end());
+    out.resize(out.size() + (8 - out.size() % 8) % 8, 0);
+}
+
+bool WriteAll(int fd, std::span<const uint8_t> data) {
+    while (! data.empty()) {
+        ssize_t n = ::write(fd, data.data(), data.size());
+        if (n <= 0) return false;
+        data = data.subspan((usize)n);
+    }
+    return true;
+}
+
+// held while it lives, closing the file releases it
+struct LockFile {
+    int fd { -1 };
+    explicit LockFile(const sfs::path& path) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd >= 0 && ::flock(fd, LOCK_EX) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    ~LockFile() {
+        if (fd >= 0) ::close(fd);
+    }
+};
+} // namespace
+
+std::shared_ptr<WPShaderPack> WPShaderPack::Shared(const sfs::path& dir, u64 max_bytes) {
+    static std::mutex                                      mutex;
+    static Map<std::string, std::shared_ptr<WPShaderPack>> packs;
+
+    std::lock_guard lock(mutex);
+    auto            path = (dir / FileName).native();
+    auto&           pack = packs[path];
+    if (! pack) pack = std::make_shared<WPShaderPack>(path, max_bytes);
+    return pack;
+}
+
+std::shared_ptr<WPShaderPack> WPShaderPack::FromStream(std::shared_ptr<fs::IBinaryStream> stream) {
+    if (! stream) return nullptr;
+    auto map = stream->TryMapView(0, (usize)stream->Size());
+    if (map.size() < pack_magic.size() ||
+        std::memcmp(map.data(), pack_magic.data(), pack_magic.size()) != 0)
+        return nullptr;
+    auto pack      = std::make_shared<WPShaderPack>(sfs::path {}, 0);
+    pack->m_stream = std::move(stream);
+    pack->m_map    = map;
+    pack->index();
+    return pack;
+}
+
+WPShaderPack::WPShaderPack(sfs::path path, u64 max_bytes)
+    : m_path(std::move(path)), m_max_bytes(max_bytes) {}
+
+WPShaderPack::~WPShaderPack() { unmap(); }
+
+void WPShaderPack::unmap() {
+    if (m_owns_map && ! m_map.empty()) ::munmap(const_cast<uint8_t*>(m_map.data()), m_map.size());
+    m_map      = {};
+    m_owns_map = false;
+    m_inode    = 0;
+    m_indexed  = 0;
+    m_records.clear();
+}
+
+void WPShaderPack::remap() {
+    if (m_path.empty()) return;
+    struct stat st {};
+    if (::stat(m_path.c_str(), &st) != 0) {
+        unmap();
+        return;
+    }
+    // a record torn when it was indexed may be whole by now
+    if ((u64)st.st_ino == m_inode && (usize)st.st_size <= m_map.size()) {
+        if (m_indexed < m_map.size()) index();
+        return;
+    }
+
+    int fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    void* addr = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        addr = ::mmap(nullptr, (usize)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) return;
+
+    // the whole file again, what is indexed stays if it only grew
+    const bool same    = (u64)st.st_ino == m_inode;
+    auto       records = same ? std::move(m_records) : StringHashMap<Record> {};
+    const u64  indexed = same ? m_indexed : 0;
+    unmap();
+    m_map      = { (const uint8_t*)addr, (usize)st.st_size };
+    m_owns_map = true;
+    m_inode    = (u64)st.st_ino;
+    m_indexed  = indexed;
+    m_records  = std::move(records);
+    index();
+}
+
+void WPShaderPack::index() {
+    if (m_indexed == 0) {
+        if (m_map.size() < pack_magic.size() ||
+            std::memcmp(m_map.data(), pack_magic.data(), pack_magic.size()) != 0)
+            return;
+        m_indexed = pack_magic.size();
+    }
+    while (m_indexed + record_head <= m_map.size()) {
+        const uint8_t* head = m_map.data() + m_indexed;
+        const u32      key  = ReadU32(head + 4);
+        const u32      size = ReadU32(head + 8);
+        const u64      end  = m_indexed + PaddedSize(key, size);
+        if (ReadU32(head) != record_magic || end > m_map.size()) break;
+        std::span<const uint8_t> k { head + record_head, key };
+        std::span<const uint8_t> data { head + record_head + key, size };
+        if (Fnv1a(data, Fnv1a(k)) != ReadU32(head + 12)) break;
+        // a later one of the key wins
+        m_records[std::string((const char*)k.data(), k.size())] = {
+            .offset = m_indexed + record_head + key, .size = size
+        };
+        m_indexed = end;
+    }
+}
+
+bool WPShaderPack::Read(std::string_view key, const std::function<bool(fs::IBinaryStream&)>& read) {
+    std::lock_guard lock(m_mutex);
+    auto            it = m_records.find(key);
+    if (it == m_records.end()) {
+        remap();
+        it = m_records.find(key);
+        if (it == m_records.end()) return false;
+    }
+    fs::SpanBinaryStream stream(nullptr, m_map.subspan((usize)it->second.offset, it->second.size));
+    return read(stream);
+}
+
+bool WPShaderPack::Append(std::string_view key, std::span<const uint8_t> data) {
+    if (m_path.empty()) return false;
+    std::lock_guard lock(m_mutex);
+    auto            lock_path = m_path;
+    lock_path += ".lock";
+    LockFile file_lock(lock_path);
+    if (file_lock.fd < 0) {
+        LOG_ERROR("can't lock shader pack \'%s\'", m_path.c_str());
+        return false;
+    }
+    remap();
+    if (m_records.contains(key)) return true;
+
+    // a torn tail or a broken magic, only a writer that died leaves them, nothing appends while
+    // the lock is held
+    const u64 adding = PaddedSize(key.size(), data.size());
+    if ((! m_map.empty() && m_indexed != m_map.size()) ||
+        (m_max_bytes > 0 && m_map.size() + adding > m_max_bytes)) {
+        if (! compact(adding)) return false;
+    }
+
+    std::vector<uint8_t> out;
+    if (m_map.empty()) out.assign(pack_magic.begin(), pack_magic.end());
+    PutRecord(out, key, data);
+    int fd = ::open(m_path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    // a file that couldn't be mapped gets no second magic
+    struct stat st {};
+    if (m_map.empty() && (::fstat(fd, &st) != 0 || st.st_size > 0)) {
+        ::close(fd);
+        return false;
+    }
+    const bool ok = WriteAll(fd, out);
+    ::close(fd);
+    if (! ok) LOG_ERROR("can't append to shader pack \'%s\'", m_path.c_str());
+    remap();
+    return ok;
+}
+
+bool WPShaderPack::compact(u64 adding) {
+    struct Live {
+        std::string_view key;
+        Record           record;
+    };
+    std::vector<Live> live;
+    for (auto& [key, record] : m_records) live.push_back({ key, record });
+    std::sort(live.begin(), live.end(), [](auto& a, auto& b) {
+        return a.record.offset < b.record.offset;
+    });
+    // the newest that fit, with room for the record added after
+    u64   total = pack_magic.size() + adding;
+    usize first = live.size();
+    const u64 target = m_max_bytes > 0 ? m_max_bytes / 100 * compact_to_percent : ~0ull;
+    while (first > 0) {
+        const auto& l    = live[first - 1];
+        const u64   size = PaddedSize(l.key.size(), l.record.size);
+        if (total + size > target) break;
+        total += size;
+        first--;
+    }
+
+    std::vector<uint8_t> out(pack_magic.begin(), pack_magic.end());
+    out.reserve(total);
+    for (usize i = first; i < live.size(); i++) {
+        const auto& r = live[i].record;
+        PutRecord(out, live[i].key, m_map.subspan((usize)r.offset, r.size));
+    }
+
+    auto tmp = m_path;
+    tmp += ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    const bool      ok = WriteAll(fd, out);
+    std::error_code ec;
+    ::close(fd);
+    if (ok) sfs::rename(tmp, m_path, ec);
+    if (! ok || ec) {
+        LOG_ERROR("can't compact shader pack \'%s\'", m_path.c_str());
+        sfs::remove(tmp, ec);
+        return false;
+    }
+    LOG_INFO("shader pack compacted, %d of %d records, %d KiB",
+             (int)(live.size() - first),
+             (int)live.size(),
+             (int)(out.size() >> 10));
+    remap();
+    return true;
+}
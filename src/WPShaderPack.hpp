@@ -0,0 +1,71 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+#include "Core/MapSet.hpp"
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+
+namespace wallpaper
+{
+namespace fs
+{
+class IBinaryStream;
+}
+
+// Records of the shader cache appended to one file, mapped once per process and read in place,
+// so a warm load opens no file per shader. Renderer processes share it: appends are single
+// writes under a lock file beside, a record a reader sees torn fails its checksum and is looked
+// at again on a later miss. A pack past its limit, or with a torn tail a writer left, is
+// compacted to a temporary file renamed over it, the oldest records dropped; mappings of the
+// old file stay valid and move to the new one on their next miss.
+//
+// Little endian: the magic, then per record its magic, key size, data size and the fnv-1a of
+// key and data as u32, the key and the data, padded to 8 bytes.
+class WPShaderPack : NoCopy, NoMove {
+public:
+    constexpr static std::string_view FileName { "shaders.pack" };
+
+    // of dir, made on the first use and kept for the process
+    static std::shared_ptr<WPShaderPack> Shared(const std::filesystem::path& dir, u64 max_bytes);
+    // read only, over a file the stream keeps mapped, a bundle's
+    static std::shared_ptr<WPShaderPack> FromStream(std::shared_ptr<fs::IBinaryStream>);
+
+    WPShaderPack(std::filesystem::path path, u64 max_bytes);
+    ~WPShaderPack();
+
+    // the record as a stream over the mapping, false on a miss or what read returns
+    bool Read(std::string_view key, const std::function<bool(fs::IBinaryStream&)>& read);
+    // true if it's in the pack after, another process may have appended it first
+    bool Append(std::string_view key, std::span<const uint8_t> data);
+
+private:
+    struct Record {
+        u64 offset { 0 };
+        u32 size { 0 };
+    };
+    // mapped anew if the file grew or was replaced, its new records indexed, under m_mutex
+    void remap();
+    void unmap();
+    void index();
+    // rewritten with the newest records that fit, under the lock file
+    bool compact(u64 adding);
+
+    std::filesystem::path m_path;
+    u64                   m_max_bytes { 0 };
+
+    std::mutex                         m_mutex;
+    std::shared_ptr<fs::IBinaryStream> m_stream;
+    std::span<const uint8_t>           m_map;
+    bool                               m_owns_map { false };
+    u64                                m_inode { 0 };
+    // the valid records end here, a torn one may follow
+    u64                                m_indexed { 0 };
+    StringHashMap<Record>              m_records;
+};
+
+} // namespace wallpaper
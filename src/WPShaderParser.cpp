@@ -1,27 +1,33 @@
 #include "WPShaderParser.hpp"
+#include "WPShaderCache.hpp"
 
 #include "Fs/IBinaryStream.h"
 #include "Utils/Logging.h"
+#include "Utils/Trace.h"
 #include "WPJson.hpp"
 
 #include "wpscene/WPUniform.h"
 #include "Fs/VFS.h"
-#include "Utils/Sha.hpp"
+#include "Utils/KeyHash.hpp"
 #include "Utils/String.h"
 #include "WPCommon.hpp"
+#include "SpecTexs.hpp"
 
 #include "Vulkan/ShaderComp.hpp"
+#include "Vulkan/Shader.hpp"
+#include "Looper/JobSystem.hpp"
 
+#include <algorithm>
 #include <regex>
 #include <stack>
 #include <charconv>
+#include <cctype>
+#include <cstdlib>
+#include <optional>
 #include <string>
 
 static constexpr std::string_view SHADER_PLACEHOLD { "__SHADER_PLACEHOLD__" };
 
-#define SHADER_DIR    "spvs01"
-#define SHADER_SUFFIX "spvs"
-
 using namespace wallpaper;
 
 namespace
@@ -39,6 +45,8 @@ static constexpr const char* pre_shader_code = R"(#version 330
 
 #define texSample2D texture
 #define texSample2DLod textureLod
+#define texSample2DLayer(s, l, uv) texture(s, vec3(uv, l))
+#define texSample2DLodLayer(s, l, uv, lod) textureLod(s, vec3(uv, l), lod)
 #define mul(x, y) ((y) * (x))
 #define frac fract
 #define atan2 atan
@@ -71,7 +79,9 @@ out vec4 glOutColor;
 
 )";
 
-inline std::string LoadGlslInclude(fs::VFS& vfs, const std::string& input) {
+// includes are looked up in and added to the map when there is one
+inline std::string LoadGlslInclude(fs::VFS& vfs, const std::string& input,
+                                   WPShaderCache* includes) {
     std::string::size_type pos = 0;
     std::string            output;
     std::string::size_type linePos = std::string::npos;
@@ -85,9 +95,17 @@ inline std::string LoadGlslInclude(fs::VFS& vfs, const std::string& input) {
         auto inP         = lineStr.find_first_of('\"') + 1;
         auto inE         = lineStr.find_last_of('\"');
         auto includeName = lineStr.substr(inP, inE - inP);
-        auto includeSrc  = fs::GetFileContent(vfs, "/assets/shaders/" + includeName);
         output.append("\n//-----include " + includeName + "\n");
-        output.append(LoadGlslInclude(vfs, includeSrc));
+        const std::string* cached = includes != nullptr ? includes->FindInclude(includeName)
+                                                        : nullptr;
+        if (cached != nullptr) {
+            output.append(*cached);
+        } else {
+            auto includeSrc = fs::GetFileContent(vfs, "/assets/shaders/" + includeName);
+            auto expanded   = LoadGlslInclude(vfs, includeSrc, includes);
+            output.append(expanded);
+            if (includes != nullptr) includes->AddInclude(includeName, std::move(expanded));
+        }
         output.append("\n//-----include end\n");
 
         pos = lineEnd;
@@ -96,6 +114,28 @@ inline std::string LoadGlslInclude(fs::VFS& vfs, const std::string& input) {
     return output;
 }
 
+// combos of the stock effects that pick how many taps or samples a pass takes, their options are
+// named by the count, as "13x13" or "30"
+constexpr std::array cost_combos { std::string_view("KERNEL"),
+                                   std::string_view("SAMPLES"),
+                                   std::string_view("QUALITY") };
+
+// of the options of a cost combo, the one with the lowest count in its name
+std::optional<i32> CheapestOption(const nlohmann::json& options) {
+    std::optional<i32> cheapest;
+    i32                fewest { 0 };
+    for (auto& [label, value] : options.items()) {
+        if (! value.is_number_integer() || label.empty() || ! std::isdigit((unsigned char)label[0]))
+            continue;
+        i32 count = std::atoi(label.c_str());
+        if (! cheapest || count < fewest) {
+            cheapest = value.get<i32>();
+            fewest   = count;
+        }
+    }
+    return cheapest;
+}
+
 inline void ParseWPShader(const std::string& src, WPShaderInfo* pWPShaderInfo,
                           const std::vector<WPShaderTexInfo>& texinfos) {
     auto& combos       = pWPShaderInfo->combos;
@@ -124,6 +164,12 @@ inline void ParseWPShader(const std::string& src, WPShaderInfo* pWPShaderInfo,
                     GET_JSON_NAME_VALUE(combo_json, "combo", name);
                     GET_JSON_NAME_VALUE(combo_json, "default", value);
                     combos[name] = std::to_string(value);
+                    if (std::find(cost_combos.begin(), cost_combos.end(), name) !=
+                            cost_combos.end() &&
+                        combo_json.contains("options") && combo_json.at("options").is_object()) {
+                        if (auto cheapest = CheapestOption(combo_json.at("options")); cheapest)
+                            pWPShaderInfo->cheapest_combos[name] = std::to_string(*cheapest);
+                    }
                 }
             }
         } else if (line.find("uniform ") != std::string::npos) {
@@ -269,6 +315,20 @@ inline usize FindIncludeInsertPos(const std::string& src, usize startPos) {
     return NposToZero(pos);
 }
 
+// instanced particles share one a_TexCoordVec4 per particle, its xy becomes this vertex's corner
+// of a 4 vertex strip, the macro doesn't expand its own name again
+inline bool InstanceParticleCorners(std::string& src) {
+    const std::regex re_decl(R"((^|\n)(\s*attribute\s+vec4\s+a_TexCoordVec4\s*;))");
+    if (! std::regex_search(src, re_decl)) return false;
+    src = std::regex_replace(
+        src,
+        re_decl,
+        "$1$2\n#define a_TexCoordVec4 vec4(float(gl_VertexIndex & 1), "
+        "float(1 - (gl_VertexIndex >> 1)), a_TexCoordVec4.zw)",
+        std::regex_constants::format_first_only);
+    return true;
+}
+
 inline EShLanguage ToGLSL(ShaderType type) {
     switch (type) {
     case ShaderType::VERTEX: return EShLangVertex;
@@ -278,10 +338,10 @@ inline EShLanguage ToGLSL(ShaderType type) {
 }
 
 inline std::string Preprocessor(const std::string& in_src, ShaderType type, const Combos& combos,
-                                WPPreprocessorInfo& process_info) {
+                                ShaderQuality quality, WPPreprocessorInfo& process_info) {
     std::string res;
 
-    std::string src = wallpaper::WPShaderParser::PreShaderHeader(in_src, combos, type);
+    std::string src = wallpaper::WPShaderParser::PreShaderHeader(in_src, combos, type, quality);
 
     // workaround #require directive
     {
@@ -289,6 +349,7 @@ inline std::string Preprocessor(const std::string& in_src, ShaderType type, cons
         src = std::regex_replace(src, re_require, "$1//#require $2$3");
     }
 
+    vulkan::InitGlslang();
     glslang::TShader::ForbidIncluder includer;
     glslang::TShader                 shader(ToGLSL(type));
     const EShMessages emsg { (EShMessages)(EShMsgDefault | EShMsgSpvRules | EShMsgRelaxedErrors |
@@ -317,7 +378,9 @@ inline std::string Preprocessor(const std::string& in_src, ShaderType type, cons
         }
     }
 
-    std::regex re_tex(R"(uniform\s+sampler2D\s+g_Texture(\d+))", std::regex::ECMAScript);
+    // or its index, see IndexTextures
+    std::regex re_tex(R"(uniform\s+(?:sampler2D(?:Array)?|uint)\s+g_Texture(\d+)(?:Index)?\b)",
+                      std::regex::ECMAScript);
     for (auto it = std::sregex_iterator(res.begin(), res.end(), re_tex);
          it != std::sregex_iterator();
          it++) {
@@ -379,58 +442,529 @@ inline std::string FixImplicitConversions(const std::string& src) {
     return result;
 }
 
-inline std::string GenSha1(std::span<const WPShaderUnit> units) {
-    std::string shas;
+// Moves the shared uniforms into WE_GLOBAL_BLOCK, see WE_GLOBAL_UNIFORMS. All or nothing for a
+// program, the block has to be the same in every stage and a declaration of another type would
+// clash with it.
+inline void ShareGlobalUniforms(std::span<WPShaderUnit> units) {
+    const std::regex re_uniform(R"(\buniform\s[^;{]*;)");
+    const std::regex re_plain(R"(uniform\s+(\w+)\s+(\w+)\s*(\[\s*(\d+)\s*\])?\s*;)");
+    const std::regex re_name(R"(\bg_\w+)");
+
+    auto find_global = [](std::string_view name) {
+        return std::find_if(WE_GLOBAL_UNIFORMS.begin(), WE_GLOBAL_UNIFORMS.end(), [name](auto& g) {
+            return g.name == name;
+        });
+    };
+    // per unit, the declarations to drop
+    std::vector<std::vector<std::pair<usize, usize>>> drops(units.size());
+    for (usize u = 0; u < units.size(); u++) {
+        auto& src = units[u].src;
+        for (auto it = std::sregex_iterator(src.begin(), src.end(), re_uniform);
+             it != std::sregex_iterator();
+             it++) {
+            const std::string decl = it->str();
+            std::smatch       mc;
+            if (std::regex_match(decl, mc, re_plain)) {
+                auto glob = find_global(mc[2].str());
+                if (glob == WE_GLOBAL_UNIFORMS.end()) continue;
+                u32 array = mc[4].matched ? (u32)std::stoul(mc[4].str()) : 0;
+                if (glob->type != mc[1].str() || glob->array != array) return;
+                drops[u].emplace_back((usize)it->position(), (usize)it->length());
+                continue;
+            }
+            // a global in any other form
+            for (auto nit = std::sregex_iterator(decl.begin(), decl.end(), re_name);
+                 nit != std::sregex_iterator();
+                 nit++) {
+                if (find_global(nit->str()) != WE_GLOBAL_UNIFORMS.end()) return;
+            }
+        }
+    }
+    if (std::all_of(drops.begin(), drops.end(), [](auto& d) {
+            return d.empty();
+        }))
+        return;
+
+    std::string block = "layout(std140) uniform " + std::string(WE_GLOBAL_BLOCK) + " {\n";
+    for (auto& g : WE_GLOBAL_UNIFORMS) {
+        block += "    " + std::string(g.type) + " " + std::string(g.name);
+        if (g.array > 0) block += "[" + std::to_string(g.array) + "]";
+        block += ";\n";
+    }
+    block += "};\n";
+
+    for (usize u = 0; u < units.size(); u++) {
+        auto& src = units[u].src;
+        for (auto it = drops[u].rbegin(); it != drops[u].rend(); it++)
+            src.erase(it->first, it->second);
+        // after the #version and any #extension
+        usize insert = 0;
+        auto  ext    = src.rfind("#extension");
+        if (ext == std::string::npos) ext = src.find("#version");
+        if (ext != std::string::npos) insert = std::min(src.find('\n', ext), src.size() - 1) + 1;
+        src.insert(insert, block);
+    }
+}
+
+#ifdef ENABLE_PUPPET_SSBO
+// Moves a plain g_Bones declaration into a storage block, WE_BONE_BLOCK, so the palette isn't
+// bound by the uniform block size and the render can share one copy between nodes.
+inline void StoreBonesInBuffer(std::span<WPShaderUnit> units) {
+    const std::regex re_bones(R"(\buniform\s+mat4x3\s+g_Bones\s*\[\s*(\w+)\s*\]\s*;)");
+    const std::regex re_other(R"(\buniform\s[^;{]*\bg_Bones\b)");
+
+    std::vector<std::smatch> decls(units.size());
+    for (usize u = 0; u < units.size(); u++) {
+        auto& src = units[u].src;
+        if (std::regex_search(src, decls[u], re_bones)) continue;
+        if (std::regex_search(src, re_other)) return;
+    }
+    for (usize u = 0; u < units.size(); u++) {
+        if (decls[u].empty()) continue;
+        auto&       src   = units[u].src;
+        std::string block = "layout(std430) readonly buffer " + std::string(WE_BONE_BLOCK) +
+                            " {\n    mat4x3 g_Bones[" + decls[u][1].str() + "];\n};";
+        src.replace((usize)decls[u].position(), (usize)decls[u].length(), block);
+
+        usize insert = 0;
+        if (auto ver = src.find("#version"); ver != std::string::npos)
+            insert = std::min(src.find('\n', ver), src.size() - 1) + 1;
+        src.insert(insert, "#extension GL_ARB_shader_storage_buffer_object : require\n");
+    }
+}
+#endif
+
+// hundreds of variants of tens of kb each are hashed on a warm load, sha1 was the most of it
+inline std::string GenKeyHash(std::span<const WPShaderUnit> units) {
+    std::string hashes;
     for (auto& unit : units) {
-        shas += utils::genSha1(unit.src);
+        hashes += utils::genKeyHash(unit.src);
     }
-    return utils::genSha1(shas);
+    return utils::genKeyHash(hashes);
 }
-inline std::string GetCachePath(std::string_view scene_id, std::string_view filename) {
-    return std::string("/cache/") + std::string(scene_id) + "/" SHADER_DIR "/" +
-           std::string(filename) + "." SHADER_SUFFIX;
+
+vulkan::ShaderCompOpt CompileOpt() {
+    vulkan::ShaderCompOpt opt;
+    opt.client_ver             = glslang::EShTargetVulkan_1_1;
+    opt.auto_map_bindings      = true;
+    opt.auto_map_locations     = true;
+    opt.relaxed_errors_glsl    = true;
+    opt.relaxed_rules_vulkan   = true;
+    opt.suppress_warnings_glsl = true;
+#ifdef ENABLE_SHADER_OPT
+    // paid once on a cold cache, the optimized spirv is what's cached
+    opt.optimize = true;
+#endif
+    return opt;
 }
 
-inline bool LoadShaderFromFile(std::vector<ShaderCode>& codes, fs::IBinaryStream& file) {
-    codes.clear();
-    i32 ver = ReadSPVVesion(file);
+// the cached spirv depends on the options too, and on the finalizing passes which change with
+// this file, bump the revision when they do
+std::string CacheKey(std::span<const WPShaderUnit> units) {
+    constexpr int revision { 2 };
+
+    const auto  opt = CompileOpt();
+    std::string key = GenKeyHash(units);
+    key += "rev" + std::to_string(revision);
+    key += " client" + std::to_string((int)opt.client_ver);
+    key += " hlsl" + std::to_string(opt.hlsl);
+    key += " maploc" + std::to_string(opt.auto_map_locations);
+    key += " mapbind" + std::to_string(opt.auto_map_bindings);
+    key += " relaxed" + std::to_string(opt.relaxed_errors_glsl) +
+           std::to_string(opt.relaxed_rules_vulkan);
+    key += " opt" + std::to_string(opt.optimize);
+#ifdef ENABLE_PUPPET_SSBO
+    key += " bonebuf";
+#endif
+    return utils::genKeyHash(key);
+}
 
-    usize count = file.ReadUint32();
-    assert(count <= 16 && count >= 0);
-    if (count > 16) return false;
+// of the units before Preprocessor, which depends on them, the combos and this file
+std::string PreprocessKey(std::span<const WPShaderUnit> units, const Combos& combos,
+                          ShaderQuality quality) {
+    constexpr int revision { 1 };
 
-    codes.resize(count);
-    for (usize i = 0; i < count; i++) {
-        auto& c = codes[i];
+    std::string key = GenKeyHash(units);
+    key += "rev" + std::to_string(revision);
+    key += " quality" + std::to_string((int)quality);
+    for (const auto& c : combos) key += " " + c.first + "=" + c.second;
+    return utils::genKeyHash(key);
+}
 
-        u32 size = file.ReadUint32();
-        assert(size % 4 == 0);
-        if (size % 4 != 0) return false;
+// finalizes and compiles, runs on the compile threads too
+// what the renderer reflects from the codes, kept with them, empty if reflecting fails
+std::string ReflectCodes(std::span<const ShaderCode> codes) {
+    std::vector<vulkan::Uni_ShaderSpv> spvs;
+    vulkan::ShaderReflected            ref;
+    if (! vulkan::GenReflect(codes, spvs, ref)) return {};
+    return vulkan::PackReflect(ref, spvs);
+}
 
-        c.resize(size / 4);
-        file.Read((char*)c.data(), size);
+bool CompileUnits(std::span<WPShaderUnit> units, std::vector<ShaderCode>& codes) {
+    TRACE_ZONE("CompileShader");
+    std::vector<vulkan::ShaderCompUnit> vunits(units.size());
+    for (usize i = 0; i < units.size(); i++) {
+        auto&               unit     = units[i];
+        WPPreprocessorInfo* pre_info = i >= 1 ? &units[i - 1].preprocess_info : nullptr;
+        WPPreprocessorInfo* post_info =
+            i + 1 < units.size() ? &units[i + 1].preprocess_info : nullptr;
+
+        unit.src = Finalprocessor(unit, pre_info, post_info);
+        unit.src = FixImplicitConversions(unit.src);
+    }
+    ShareGlobalUniforms(units);
+#ifdef ENABLE_PUPPET_SSBO
+    StoreBonesInBuffer(units);
+#endif
+    for (usize i = 0; i < units.size(); i++) {
+        vunits[i].src   = units[i].src;
+        vunits[i].stage = ToGLSL(units[i].stage);
+    }
+
+    vulkan::ShaderCompOpt opt = CompileOpt();
+
+    std::vector<vulkan::Uni_ShaderSpv> spvs(units.size());
+
+    if (! vulkan::CompileAndLinkShaderUnits(vunits, opt, spvs)) {
+        return false;
+    }
+
+    codes.clear();
+    for (auto& spv : spvs) {
+        codes.emplace_back(std::move(spv->spirv));
     }
     return true;
 }
 
-inline void SaveShaderToFile(std::span<const ShaderCode> codes, fs::IBinaryStreamW& file) {
-    char nop[256] { '\0' };
+#ifdef ENABLE_SPEC_COMBOS
+// Combos that only pick code paths inside functions become specialization constants, so one
+// module serves every value of them. `#if NAME` turns into `if (NAME != 0) {`, the value comes
+// with the pipeline. A combo qualifies when it's declared by a [COMBO] line, every mention of it
+// is an `#if NAME`, `#if !NAME` or `#if NAME == N` of its own without #elif, inside a function,
+// and the branches hold whole statements and declare nothing at their own level.
+class ComboSpecializer {
+public:
+    void Analyze(const std::string& src) {
+        std::string_view rest(src);
+        while (! rest.empty()) {
+            auto end = rest.find('\n');
+            Line(rest.substr(0, end));
+            rest = end == std::string_view::npos ? std::string_view {} : rest.substr(end + 1);
+            m_line++;
+        }
+        // unclosed groups
+        for (auto& g : m_stack) Reject(g.name);
+        m_stack.clear();
+        m_units.push_back(std::move(m_edits));
+        m_edits.clear();
+        m_line       = 0;
+        m_depth      = 0;
+        m_last       = ';';
+        m_in_comment = false;
+    }
+
+    // rewrites every unit analyzed, in order, returns the combos left to the preprocessor
+    Combos Apply(std::span<WPShaderUnit> units, const Combos& combos,
+                 std::vector<std::pair<u32, i32>>& constants) {
+        Map<std::string, std::string> values;
+        for (auto& [name, value] : combos) values[ToUpper(name)] = value;
+
+        // ids follow the names, the same for every variant
+        Set<std::string> specs;
+        std::string      decls;
+        for (auto& name : m_declared) {
+            if (exists(m_rejected, name)) continue;
+            i32 value { 0 };
+            if (auto it = values.find(name); it != values.end()) {
+                auto& str = it->second;
+                auto [ptr, ec] { std::from_chars(str.data(), str.data() + str.size(), value) };
+                if (ec != std::errc() || ptr != str.data() + str.size()) continue;
+            }
+            u32 id = (u32)specs.size();
+            constants.emplace_back(id, value);
+            specs.insert(name);
+            // defaults are 0, a value in the module would tell variants apart
+            decls += "layout(constant_id = " + std::to_string(id) + ") const int " + name +
+                     " = 0;\n";
+        }
+
+        Combos left;
+        for (auto& [name, value] : combos) {
+            if (! exists(specs, ToUpper(name))) left[name] = value;
+        }
+        if (specs.empty()) return left;
+
+        for (usize u = 0; u < units.size() && u < m_units.size(); u++) {
+            auto&                    src = units[u].src;
+            std::vector<std::string> lines;
+            std::string_view         rest(src);
+            while (true) {
+                auto end = rest.find('\n');
+                lines.emplace_back(rest.substr(0, end));
+                if (end == std::string_view::npos) break;
+                rest = rest.substr(end + 1);
+            }
+            for (auto& e : m_units[u]) {
+                if (exists(specs, e.name)) lines[e.line] = e.text;
+            }
+            src.clear();
+            for (usize i = 0; i < lines.size(); i++) {
+                src += lines[i];
+                if (i + 1 < lines.size()) src += '\n';
+            }
+            // after any #extension, those go before declarations
+            usize insert = 0;
+            if (auto ext = src.rfind("#extension"); ext != std::string::npos)
+                insert = std::min(src.find('\n', ext), src.size() - 1) + 1;
+            src.insert(insert, decls);
+        }
+        return left;
+    }
+
+private:
+    struct Edit {
+        usize       line;
+        std::string name;
+        std::string text;
+    };
+    struct Group {
+        std::string       name;
+        i32               depth { 0 };
+        bool              valid { true };
+        // no code in the branch yet
+        bool              fresh { true };
+        std::vector<Edit> edits;
+    };
+
+    static std::string ToUpper(std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), ::toupper);
+        return s;
+    }
+    static bool Boundary(char c) { return c == ';' || c == '{' || c == '}'; }
+
+    void Reject(const std::string& name) {
+        if (! name.empty()) m_rejected.insert(name);
+    }
+    Group* Top() { return m_stack.empty() ? nullptr : &m_stack.back(); }
+
+    // at a branch edge the code before has to end a statement at the group's depth
+    void EndBranch(Group& g) {
+        if (m_depth != g.depth || ! Boundary(m_last)) g.valid = false;
+    }
+
+    void Line(std::string_view raw) {
+        static const std::regex re_if(
+            R"(^\s*#\s*if\s+(!\s*)?([A-Za-z_]\w*)\s*(?:(==|!=)\s*(\d+))?\s*(?://.*)?$)");
+        static const std::regex re_decl(
+            R"(^\s*(?:(?:const|highp|mediump|lowp)\s+)*(?:float|u?int|bool|[biu]?vec[234]|mat[234](?:x[234])?|sampler2D)\s+\w+)");
+        static const std::regex re_word(R"([A-Za-z_]\w*)");
+
+        // comments out, block comments may span lines
+        std::string line;
+        for (usize i = 0; i < raw.size(); i++) {
+            if (m_in_comment) {
+                if (raw.substr(i, 2) == "*/") {
+                    m_in_comment = false;
+                    i++;
+                }
+            } else if (raw.substr(i, 2) == "/*") {
+                m_in_comment = true;
+                i++;
+            } else if (raw.substr(i, 2) == "//") {
+                if (raw.find("[COMBO]", i) != std::string_view::npos) Declare(raw.substr(i));
+                break;
+            } else
+                line += raw[i];
+        }
+
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) return;
+
+        if (line[first] == '#') {
+            Directive(line, re_if, re_word);
+            return;
+        }
+
+        bool decl  = std::regex_search(line, re_decl);
+        bool chain = line.compare(first, 4, "else") == 0;
+        for (auto& g : m_stack) {
+            if (g.depth == m_depth && decl) g.valid = false;
+            // an if before the group would lose its else
+            if (g.fresh && chain) g.valid = false;
+            g.fresh = false;
+        }
+        Mentions(line, re_word);
 
-    WriteSPVVesion(file, 1);
-    file.WriteUint32((u32)codes.size());
-    for (const auto& c : codes) {
-        u32 size = (u32)c.size() * 4;
-        file.WriteUint32(size);
-        file.Write((const char*)c.data(), size);
+        for (char c : line) {
+            if (c == '{') m_depth++;
+            if (c == '}') m_depth--;
+            for (auto& grp : m_stack) {
+                if (m_depth < grp.depth) grp.valid = false;
+            }
+        }
+        auto last = line.find_last_not_of(" \t\r");
+        m_last    = line[last];
     }
-    file.Write(nop, sizeof(nop));
+
+    void Directive(const std::string& line, const std::regex& re_if, const std::regex& re_word) {
+        std::smatch m;
+        std::string word;
+        {
+            std::smatch w;
+            auto        hash = line.find('#');
+            auto        tail = line.substr(hash + 1);
+            if (std::regex_search(tail, w, re_word)) word = w.str();
+        }
+
+        if (word == "if" || word == "ifdef" || word == "ifndef") {
+            Group g;
+            g.depth = m_depth;
+            if (word == "if" && std::regex_match(line, m, re_if)) {
+                g.name         = m[2].str();
+                bool        no = m[1].matched;
+                std::string cond;
+                if (m[3].matched)
+                    cond = g.name + " " + m[3].str() + " " + m[4].str();
+                else
+                    cond = g.name + (no ? " == 0" : " != 0");
+                g.edits.push_back({ m_line, g.name, "if (" + cond + ") {" });
+                if (m_depth <= 0 || ! Boundary(m_last)) g.valid = false;
+            } else {
+                Mentions(line, re_word);
+            }
+            m_stack.push_back(std::move(g));
+        } else if (word == "else" || word == "elif") {
+            auto* g = Top();
+            if (g == nullptr) return;
+            if (word == "elif") {
+                g->valid = false;
+                Mentions(line, re_word);
+            } else {
+                EndBranch(*g);
+                g->fresh = true;
+                g->edits.push_back({ m_line, g->name, "} else {" });
+            }
+        } else if (word == "endif") {
+            auto* g = Top();
+            if (g == nullptr) return;
+            EndBranch(*g);
+            g->edits.push_back({ m_line, g->name, "}" });
+            if (! g->name.empty()) {
+                if (g->valid)
+                    for (auto& e : g->edits) m_edits.push_back(std::move(e));
+                else
+                    Reject(g->name);
+            }
+            m_stack.pop_back();
+        } else {
+            // #define, #undef and the like
+            Mentions(line, re_word);
+        }
+        // a directive line starts a statement
+        m_last = ';';
+    }
+
+    // any mention but its own #if keeps a combo a define
+    void Mentions(const std::string& line, const std::regex& re_word) {
+        for (auto it = std::sregex_iterator(line.begin(), line.end(), re_word);
+             it != std::sregex_iterator();
+             it++) {
+            Reject(it->str());
+        }
+    }
+
+    void Declare(std::string_view comment) {
+        auto brace = comment.find('{');
+        if (brace == std::string_view::npos) return;
+        nlohmann::json json;
+        if (! PARSE_JSON(comment.substr(brace), json)) return;
+        std::string name;
+        if (! json.contains("combo")) return;
+        GET_JSON_NAME_VALUE(json, "combo", name);
+        if (! name.empty()) m_declared.insert(ToUpper(name));
+    }
+
+    Set<std::string>               m_declared;
+    Set<std::string>               m_rejected;
+    std::vector<Group>             m_stack;
+    std::vector<Edit>              m_edits;
+    std::vector<std::vector<Edit>> m_units;
+
+    usize m_line { 0 };
+    i32   m_depth { 0 };
+    char  m_last { ';' };
+    bool  m_in_comment { false };
+};
+#endif
+
+// makes the sampler of a texture slot an array and its samples read the layer uniform, false
+// and nothing changed if the sampler is used in any other way
+bool LayerTexture(std::string& src, usize slot) {
+    const std::string name(WE_GLTEX_NAMES[slot]);
+    const std::regex  re_decl(R"(uniform\s+sampler2D\s+)" + name + R"(\s*;)");
+    const std::regex  re_call(R"(\b(texSample2D(?:Lod)?)\s*\(\s*)" + name + R"(\s*,)");
+    const std::regex  re_name(R"(\b)" + name + R"(\b)");
+
+    auto count = [](const std::string& str, const std::regex& re) {
+        return std::distance(std::sregex_iterator(str.begin(), str.end(), re),
+                             std::sregex_iterator());
+    };
+    auto decls = count(src, re_decl);
+    if (decls == 0 || count(src, re_name) != decls + count(src, re_call)) return false;
+
+    const std::string layer(WE_GLTEX_LAYER_NAMES[slot]);
+    src = std::regex_replace(src, re_call, "$1Layer(" + name + ", " + layer + ",");
+    src = std::regex_replace(
+        src, re_decl, "uniform sampler2DArray " + name + "; uniform float " + layer + ";");
+    return true;
+}
+
+// makes the samplers of texture slots elements of WE_BINDLESS_ARRAY, their samples read it at the
+// index uniform, a slot whose sampler is used in any other way keeps it. Indexing by a uniform
+// takes glsl 400, a source naming something after one of its keywords is left as it is
+bool IndexTextures(std::string& src) {
+    static const std::regex re_keyword(
+        R"(\b(?:sample|patch|subroutine|precise|dvec[234]|dmat[234](?:x[234])?)\b)");
+    if (std::regex_search(src, re_keyword)) return false;
+
+    auto count = [](const std::string& str, const std::regex& re) {
+        return std::distance(std::sregex_iterator(str.begin(), str.end(), re),
+                             std::sregex_iterator());
+    };
+    const std::string array(WE_BINDLESS_ARRAY);
+    bool              indexed { false };
+    for (usize i = 0; i < WE_GLTEX_NAMES.size(); i++) {
+        const std::string name(WE_GLTEX_NAMES[i]);
+        if (src.find(name) == std::string::npos) continue;
+        const std::regex re_decl(R"(uniform\s+sampler2D\s+)" + name + R"(\s*;)");
+        const std::regex re_call(R"(\b(texSample2D(?:Lod)?)\s*\(\s*)" + name + R"(\s*,)");
+        const std::regex re_name(R"(\b)" + name + R"(\b)");
+
+        auto decls = count(src, re_decl);
+        if (decls == 0 || count(src, re_name) != decls + count(src, re_call)) continue;
+
+        const std::string index(WE_GLTEX_INDEX_NAMES[i]);
+        src = std::regex_replace(src, re_call, "$1(" + array + "[" + index + "],");
+        src = std::regex_replace(src, re_decl, "uniform uint " + index + ";");
+        indexed = true;
+    }
+    if (! indexed) return false;
+    // after any #extension, outside of any #if
+    usize insert = 0;
+    if (auto ext = src.rfind("#extension"); ext != std::string::npos)
+        insert = std::min(src.find('\n', ext), src.size() - 1) + 1;
+    src.insert(insert,
+               "layout(set = 1, binding = 0) uniform sampler2D " + array + "[" +
+                   std::to_string(WE_BINDLESS_CAPACITY) + "];\n");
+    return true;
 }
 
 } // namespace
 
 std::string WPShaderParser::PreShaderSrc(fs::VFS& vfs, const std::string& src,
                                          WPShaderInfo*                       pWPShaderInfo,
-                                         const std::vector<WPShaderTexInfo>& texinfos) {
+                                         const std::vector<WPShaderTexInfo>& texinfos,
+                                         WPShaderCache*                      cache) {
     std::string            newsrc(src);
     std::string::size_type pos = 0;
     std::string            include;
@@ -440,18 +974,26 @@ std::string WPShaderParser::PreShaderSrc(fs::VFS& vfs, const std::string& src,
         newsrc.replace(begin, pos - begin, pos - begin, ' ');
         include.append(src.substr(begin, pos - begin) + "\n");
     }
-    include = LoadGlslInclude(vfs, include);
+    include = LoadGlslInclude(vfs, include, cache);
 
     ParseWPShader(include, pWPShaderInfo, texinfos);
     ParseWPShader(newsrc, pWPShaderInfo, texinfos);
 
     newsrc.insert(FindIncludeInsertPos(newsrc, 0), include);
+    for (usize i = 0; i < texinfos.size() && i < WE_GLTEX_NAMES.size(); i++) {
+        if (texinfos[i].layered && ! LayerTexture(newsrc, i))
+            LOG_INFO("g_Texture%d is not only sampled, its sprite frames stay apart", (int)i);
+    }
+    if (pWPShaderInfo->bindless) (void)IndexTextures(newsrc);
     return newsrc;
 }
 
 std::string WPShaderParser::PreShaderHeader(const std::string& src, const Combos& combos,
-                                            ShaderType type) {
+                                            ShaderType type, ShaderQuality quality) {
     std::string pre(pre_shader_code);
+    // see IndexTextures
+    if (src.find(WE_BINDLESS_ARRAY) != std::string::npos)
+        pre.replace(0, pre.find('\n'), "#version 400");
     if (type == ShaderType::VERTEX) pre += pre_shader_code_vert;
     if (type == ShaderType::FRAGMENT) pre += pre_shader_code_frag;
     std::string header(pre);
@@ -464,79 +1006,134 @@ std::string WPShaderParser::PreShaderHeader(const std::string& src, const Combos
         }
         header.append("#define " + cup + " " + c.second + "\n");
     }
+    // vulkan rules keep default precisions, highp is defined away above
+    if (quality == ShaderQuality::Low && type == ShaderType::FRAGMENT)
+        header.append("precision mediump float;\n");
     return header + src;
 }
 
-void WPShaderParser::InitGlslang() { glslang::InitializeProcess(); }
-void WPShaderParser::FinalGlslang() { glslang::FinalizeProcess(); }
-
-bool WPShaderParser::CompileToSpv(std::string_view scene_id, std::span<WPShaderUnit> units,
-                                  std::vector<ShaderCode>& codes, fs::VFS& vfs,
-                                  WPShaderInfo* shader_info, std::span<const WPShaderTexInfo> texs) {
+bool WPShaderParser::CompileToSpv(std::span<WPShaderUnit> units, SceneShader& shader,
+                                  WPShaderInfo* shader_info, std::span<const WPShaderTexInfo> texs,
+                                  WPShaderCache* cache, WPShaderCompileQueue* queue) {
     (void)texs;
+    auto& codes = shader.codes;
+
+    if (shader_info->particle_instanced) {
+        auto vert = std::find_if(units.begin(), units.end(), [](const auto& unit) {
+            return unit.stage == ShaderType::VERTEX;
+        });
+        if (vert == units.end() || ! InstanceParticleCorners(vert->src)) {
+            LOG_INFO("particle shader has no a_TexCoordVec4, not instanced");
+            shader_info->particle_instanced = false;
+        }
+    }
 
-    std::for_each(units.begin(), units.end(), [shader_info](auto& unit) {
-        unit.src = Preprocessor(unit.src, unit.stage, shader_info->combos, unit.preprocess_info);
-    });
-
-    auto compile = [](std::span<WPShaderUnit> units, std::vector<ShaderCode>& codes) {
-        std::vector<vulkan::ShaderCompUnit> vunits(units.size());
-        for (usize i = 0; i < units.size(); i++) {
-            auto&               unit     = units[i];
-            auto&               vunit    = vunits[i];
-            WPPreprocessorInfo* pre_info = i >= 1 ? &units[i - 1].preprocess_info : nullptr;
-            WPPreprocessorInfo* post_info =
-                i + 1 < units.size() ? &units[i + 1].preprocess_info : nullptr;
-
-            unit.src = Finalprocessor(unit, pre_info, post_info);
-            unit.src = FixImplicitConversions(unit.src);
+    const ShaderQuality quality = shader_info->quality;
+    if (quality == ShaderQuality::Low) {
+        for (auto& [name, value] : shader_info->cheapest_combos) shader_info->combos[name] = value;
+    }
 
-            vunit.src   = unit.src;
-            vunit.stage = ToGLSL(unit.stage);
+#ifdef ENABLE_SPEC_COMBOS
+    ComboSpecializer specializer;
+    for (auto& unit : units) specializer.Analyze(unit.src);
+    shader_info->spec_constants.clear();
+    const Combos combos = specializer.Apply(units, shader_info->combos, shader_info->spec_constants);
+#else
+    const Combos& combos = shader_info->combos;
+#endif
+
+    // a warm load finds the spirv key from the expanded sources
+    std::string pre_key = cache != nullptr ? PreprocessKey(units, combos, quality) : "";
+    std::string key;
+    if (cache != nullptr && cache->LoadPreprocessed(pre_key, key, units)) {
+        if (cache->Load(key, codes, shader.reflection)) {
+            if (queue != nullptr) queue->m_loads.push_back({ .name = shader.name, .cached = true });
+            shader.CountCodes();
+            return true;
         }
+        // the spirv was trimmed
+    }
 
-        vulkan::ShaderCompOpt opt;
-        opt.client_ver             = glslang::EShTargetVulkan_1_1;
-        opt.auto_map_bindings      = true;
-        opt.auto_map_locations     = true;
-        opt.relaxed_errors_glsl    = true;
-        opt.relaxed_rules_vulkan   = true;
-        opt.suppress_warnings_glsl = true;
-
-        std::vector<vulkan::Uni_ShaderSpv> spvs(units.size());
+    std::for_each(units.begin(), units.end(), [&combos, quality](auto& unit) {
+        unit.src = Preprocessor(unit.src, unit.stage, combos, quality, unit.preprocess_info);
+    });
 
-        if (! vulkan::CompileAndLinkShaderUnits(vunits, opt, spvs)) {
-            return false;
+    key = cache != nullptr || queue != nullptr ? CacheKey(units) : std::string {};
+    if (cache != nullptr) {
+        cache->SavePreprocessed(pre_key, key, units);
+        if (cache->Load(key, codes, shader.reflection)) {
+            if (queue != nullptr) queue->m_loads.push_back({ .name = shader.name, .cached = true });
+            shader.CountCodes();
+            return true;
         }
+    }
 
-        codes.clear();
-        for (auto& spv : spvs) {
-            codes.emplace_back(std::move(spv->spirv));
-        }
+    if (queue != nullptr) {
+        queue->Push(key, units, shader, cache != nullptr);
         return true;
-    };
-
-    bool has_cache_dir = vfs.IsMounted("cache");
+    }
+    if (! CompileUnits(units, codes)) return false;
+    shader.reflection = ReflectCodes(codes);
+    shader.CountCodes();
+    if (cache != nullptr) cache->Save(key, codes, shader.reflection);
+    return true;
+}
 
-    if (has_cache_dir) {
-        std::string sha1            = GenSha1(units);
-        std::string cache_file_path = GetCachePath(scene_id, sha1);
+void WPShaderCompileQueue::Push(std::string_view key, std::span<const WPShaderUnit> units,
+                                SceneShader& shader, bool save) {
+    if (auto it = m_index.find(key); it != m_index.end()) {
+        m_jobs[it->second].targets.push_back(&shader);
+        return;
+    }
+    m_index.emplace(std::string(key), m_jobs.size());
+    m_jobs.push_back(Job {
+        .units   = { units.begin(), units.end() },
+        .targets = { &shader },
+        .key     = std::string(key),
+        .save    = save,
+    });
+    usize bytes { 0 };
+    for (auto& unit : units) bytes += unit.src.size();
+    m_jobs.back().src_bytes.set(bytes);
+}
 
-        if (vfs.Contains(cache_file_path)) {
-            auto cache_file = vfs.Open(cache_file_path);
-            if (! cache_file || ! ::LoadShaderFromFile(codes, *cache_file)) {
-                LOG_ERROR("load shader from \'%s\' failed", cache_file_path.c_str());
-                return false;
-            }
-        } else {
-            if (! compile(units, codes)) return false;
-            if (auto cache_file = vfs.OpenW(cache_file_path); cache_file) {
-                ::SaveShaderToFile(codes, *cache_file);
-            }
+bool WPShaderCompileQueue::Run() {
+    if (m_jobs.empty()) return true;
+
+    auto& jobs = looper::JobSystem::Shared();
+    jobs.parallelFor(
+        m_jobs.size(),
+        [this](usize i) {
+            auto& job    = m_jobs[i];
+            auto& shader = *job.targets.front();
+            auto  begin  = std::chrono::steady_clock::now();
+            job.ok       = CompileUnits(job.units, shader.codes);
+            if (job.ok) shader.reflection = ReflectCodes(shader.codes);
+            job.time = std::chrono::steady_clock::now() - begin;
+        },
+        looper::JobPriority::Load);
+
+    bool ok = true;
+    for (auto& job : m_jobs) {
+        m_loads.push_back({ .name = job.targets.front()->name, .compile = job.time });
+        if (! job.ok) {
+            ok = false;
+            continue;
         }
-        return true;
-
-    } else {
-        return compile(units, codes);
+        auto& shader = *job.targets.front();
+        shader.CountCodes();
+        for (usize i = 1; i < job.targets.size(); i++) {
+            job.targets[i]->codes      = shader.codes;
+            job.targets[i]->reflection = shader.reflection;
+            job.targets[i]->CountCodes();
+        }
+        if (job.save && m_cache != nullptr) m_cache->Save(job.key, shader.codes, shader.reflection);
     }
+    if (m_cache != nullptr) m_cache->Trim();
+    LOG_INFO("compiled %d shaders on %d threads",
+             m_jobs.size(),
+             std::min(m_jobs.size(), jobs.workerCount() + 1));
+    m_jobs.clear();
+    m_index.clear();
+    return ok;
 }
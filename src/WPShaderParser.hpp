@@ -1,9 +1,12 @@
 #pragma once
 
+#include <chrono>
 #include <span>
+#include "Core/NoCopyMove.hpp"
 #include "Scene/Scene.h"
 #include "Scene/SceneShader.h"
 #include "Type.hpp"
+#include "Utils/MemUse.hpp"
 
 namespace wallpaper
 {
@@ -11,6 +14,7 @@ namespace fs
 {
 class VFS;
 }
+class WPShaderCache;
 using Combos = Map<std::string, std::string>;
 
 // ui material name to gl uniform name
@@ -18,12 +22,35 @@ using WPAliasValueDict = Map<std::string, std::string>;
 
 using WPDefaultTexs = std::vector<std::pair<i32, std::string>>;
 
+// what shaders are compiled for, low trades detail for gpu time, see PROPERTY_QUALITY
+enum class ShaderQuality
+{
+    Full,
+    Low
+};
+
 struct WPShaderInfo {
     Combos           combos;
     ShaderValueMap   svs;
     ShaderValueMap   baseConstSvs;
     WPAliasValueDict alias;
     WPDefaultTexs    defTexs;
+
+    // particles drawn one instance per particle, the vertex shader takes the quad corner from
+    // gl_VertexIndex, cleared when the vertex shader has no a_TexCoordVec4 to rewrite
+    bool particle_instanced { false };
+
+    // combos made specialization constants, id and value (ENABLE_SPEC_COMBOS)
+    std::vector<std::pair<u32, i32>> spec_constants;
+
+    ShaderQuality quality { ShaderQuality::Full };
+    // combos picking how many taps or samples are taken, to the option taking the fewest, they
+    // replace the combos at low quality
+    Combos cheapest_combos;
+
+    // samplers of texture slots that are only sampled become elements of WE_BINDLESS_ARRAY,
+    // read at an index uniform of the node's block
+    bool bindless { false };
 };
 
 struct WPPreprocessorInfo {
@@ -36,6 +63,8 @@ struct WPPreprocessorInfo {
 struct WPShaderTexInfo {
     bool                enabled { false };
     std::array<bool, 3> composEnabled { false, false, false };
+    // sprite frames in the layers of one texture, sampled at g_TextureNLayer
+    bool layered { false };
 };
 
 struct WPShaderUnit {
@@ -44,18 +73,66 @@ struct WPShaderUnit {
     WPPreprocessorInfo preprocess_info;
 };
 
+// a shader of a scene load, compiled shaders sharing a source are one
+struct WPShaderLoad {
+    std::string              name;
+    bool                     cached { false };
+    std::chrono::nanoseconds compile { 0 };
+};
+
+// The glslang compiles of a scene load, CompileToSpv queues its cache misses here and Run
+// compiles them together on a pool of threads. Units with the same source are compiled once.
+class WPShaderCompileQueue : NoCopy, NoMove {
+public:
+    // the cache may be null
+    explicit WPShaderCompileQueue(WPShaderCache* cache): m_cache(cache) {}
+
+    WPShaderCache* Cache() const { return m_cache; }
+
+    // joins, then saves to the cache on the calling thread
+    // false if a compile failed, the shaders it was for keep no code and aren't drawn
+    bool Run();
+
+    // the shaders the cache had, and the ones Run compiled
+    const std::vector<WPShaderLoad>& Loads() const { return m_loads; }
+
+private:
+    friend class WPShaderParser;
+
+    struct Job {
+        std::vector<WPShaderUnit> units;
+        // the scene shaders, they outlive the queue
+        std::vector<SceneShader*> targets;
+        std::string               key;
+        bool                      save { false };
+        bool                      ok { false };
+        std::chrono::nanoseconds  time { 0 };
+        // of the units' sources
+        memuse::Held src_bytes { memuse::Pool::ShaderSource };
+    };
+    void Push(std::string_view key, std::span<const WPShaderUnit>, SceneShader&, bool save);
+
+    WPShaderCache*          m_cache;
+    std::vector<Job>          m_jobs;
+    Map<std::string, usize>   m_index;
+    std::vector<WPShaderLoad> m_loads;
+};
+
 class WPShaderParser {
 public:
+    // includes are reused from the cache's load when given
     static std::string PreShaderSrc(fs::VFS&, const std::string& src, WPShaderInfo* pWPShaderInfo,
-                                    const std::vector<WPShaderTexInfo>& texs);
+                                    const std::vector<WPShaderTexInfo>& texs,
+                                    WPShaderCache*                      cache = nullptr);
 
-    static std::string PreShaderHeader(const std::string& src, const Combos& combos, ShaderType);
+    // fragment floats are mediump at low quality, relaxed precision in the spirv
+    static std::string PreShaderHeader(const std::string& src, const Combos& combos, ShaderType,
+                                       ShaderQuality = ShaderQuality::Full);
 
-    static void InitGlslang();
-    static void FinalGlslang();
 
-    static bool CompileToSpv(std::string_view         scene_id, std::span<WPShaderUnit>,
-                             std::vector<ShaderCode>& spvs, fs::VFS&, WPShaderInfo*,
-                             std::span<const WPShaderTexInfo>);
+    // with a queue a cache miss is compiled by its Run, the shader's codes stay empty till then
+    static bool CompileToSpv(std::span<WPShaderUnit>, SceneShader&, WPShaderInfo*,
+                             std::span<const WPShaderTexInfo>, WPShaderCache* cache = nullptr,
+                             WPShaderCompileQueue* queue = nullptr);
 };
 } // namespace wallpaper
@@ -6,9 +6,12 @@
 #include "SpecTexs.hpp"
 #include "Core/ArrayHelper.hpp"
 #include "Utils/Algorism.h"
+#include "Utils/Logging.h"
+#include "Utils/Trace.h"
 
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
+#include <cstring>
 #include <iostream>
 #include <chrono>
 #include <ctime>
@@ -26,73 +29,103 @@ void WPShaderValueUpdater::FrameBegin() {
             (((cTime->tm_hour * 60) + cTime->tm_min) * 60 + cTime->tm_sec) / (24.0f * 60.0f
        * 60.0f);
     */
+    // world transforms of what moved, in one pass before the nodes are updated
+    m_scene->nodeTable.Propagate();
+
     double new_time    = m_mouseDelayedTime + m_scene->frameTime;
     new_time           = new_time > m_parallax.delay ? m_parallax.delay : new_time;
     m_mouseDelayedTime = new_time;
     double t           = new_time / m_parallax.delay;
     m_mousePos         = std::array { (float)algorism::lerp(t, m_mousePos[0], m_mousePosInput[0]),
                               (float)algorism::lerp(t, m_mousePos[1], m_mousePosInput[1]) };
+
+    // palettes handed out last frame may go now
+    for (auto& entry : m_nodes) {
+        if (entry.has_data && entry.data.puppet_layer.hasPuppet())
+            entry.data.puppet_layer.puppet()->beginFrame();
+    }
+    // the frame's bones are made here, the uniform update only hands them out
+    for (auto& entry : m_nodes) {
+        entry.bones = {};
+        if (! (entry.has_data && entry.data.puppet_layer.hasPuppet())) continue;
+        if (HasUniform(entry.info.BONES))
+            entry.bones = entry.data.puppet_layer.genFrame(m_scene->frameTime);
+    }
 }
 
 void WPShaderValueUpdater::FrameEnd() {}
 
 void WPShaderValueUpdater::MouseInput(double x, double y) {
-    using namespace std::chrono;
-
-    auto   now_time = steady_clock::now();
-    double new_time = m_mouseDelayedTime -
-                      duration_cast<duration<double>>(now_time - m_last_mouse_input_time).count();
-    m_mouseDelayedTime = new_time < 0.0f ? 0.0f : new_time;
+    // of scene time, not the clock's, so a replay of the same frames follows the same
+    const double now      = m_scene->elapsingTime;
+    double       new_time = m_mouseDelayedTime - (now - m_last_mouse_input_time);
+    m_mouseDelayedTime    = new_time < 0.0f ? 0.0f : new_time;
 
     m_mousePosInput[0] = (float)x;
     m_mousePosInput[1] = (float)y;
 
-    m_last_mouse_input_time = now_time;
+    m_last_mouse_input_time = now;
 }
 
-void WPShaderValueUpdater::InitUniforms(SceneNode* pNode, const ExistsUniformOp& existsOp) {
-    m_nodeUniformInfoMap[pNode] = WPUniformInfo();
-    auto& info                  = m_nodeUniformInfoMap[pNode];
-    info.has_MI                 = existsOp(G_MI);
-    info.has_M                  = existsOp(G_M);
-    info.has_AM                 = existsOp(G_AM);
-    info.has_MVP                = existsOp(G_MVP);
-    info.has_MVPI               = existsOp(G_MVPI);
-    info.has_ETVP               = existsOp(G_ETVP);
-    info.has_ETVPI              = existsOp(G_ETVPI);
-
-    info.has_VP = existsOp(G_VP);
-
-    info.has_BONES            = existsOp(G_BONES);
-    info.has_TIME             = existsOp(G_TIME);
-    info.has_DAYTIME          = existsOp(G_DAYTIME);
-    info.has_POINTERPOSITION  = existsOp(G_POINTERPOSITION);
-    info.has_PARALLAXPOSITION = existsOp(G_PARALLAXPOSITION);
-    info.has_TEXELSIZE        = existsOp(G_TEXELSIZE);
-    info.has_TEXELSIZEHALF    = existsOp(G_TEXELSIZEHALF);
-    info.has_SCREEN           = existsOp(G_SCREEN);
-    info.has_LP               = existsOp(G_LP);
-
-    std::accumulate(begin(info.texs), end(info.texs), 0, [&existsOp](uint index, auto& value) {
-        value.has_resolution = existsOp(WE_GLTEX_RESOLUTION_NAMES[index]);
-        value.has_mipmap     = existsOp(WE_GLTEX_MIPMAPINFO_NAMES[index]);
+void WPShaderValueUpdater::InitUniforms(SceneNode* pNode, const ResolveUniformOp& resolveOp) {
+    auto& entry = Entry(pNode);
+    if (! pNode->Camera().empty()) {
+        auto cam = m_scene->cameras.find(pNode->Camera());
+        if (cam == m_scene->cameras.end())
+            LOG_ERROR("no camera %s for node", pNode->Camera().c_str());
+        else
+            entry.camera = cam->second.get();
+    }
+    entry.effect_camera = pNode->Camera() == "effect";
+    // looked up once here, the lookups of the updates then only read
+    if (entry.has_data) {
+        for (const auto& el : entry.data.renderTargets) (void)m_scene->FindRenderTarget(el.second);
+    }
+
+    entry.info = WPUniformInfo();
+    auto& info = entry.info;
+    info.MI    = resolveOp(G_MI);
+    info.M     = resolveOp(G_M);
+    info.AM    = resolveOp(G_AM);
+    info.MVP   = resolveOp(G_MVP);
+    info.MVPI  = resolveOp(G_MVPI);
+    info.ETVP  = resolveOp(G_ETVP);
+    info.ETVPI = resolveOp(G_ETVPI);
+
+    info.VP = resolveOp(G_VP);
+
+    info.BONES            = resolveOp(G_BONES);
+    info.TIME             = resolveOp(G_TIME);
+    info.DAYTIME          = resolveOp(G_DAYTIME);
+    info.POINTERPOSITION  = resolveOp(G_POINTERPOSITION);
+    info.PARALLAXPOSITION = resolveOp(G_PARALLAXPOSITION);
+    info.TEXELSIZE        = resolveOp(G_TEXELSIZE);
+    info.TEXELSIZEHALF    = resolveOp(G_TEXELSIZEHALF);
+    info.SCREEN           = resolveOp(G_SCREEN);
+    info.LP               = resolveOp(G_LP);
+    info.LCP              = resolveOp(G_LCP);
+
+    std::accumulate(begin(info.texs), end(info.texs), 0, [&resolveOp](uint index, auto& value) {
+        value.resolution  = resolveOp(WE_GLTEX_RESOLUTION_NAMES[index]);
+        value.mipmap      = resolveOp(WE_GLTEX_MIPMAPINFO_NAMES[index]);
+        value.rotation    = resolveOp(WE_GLTEX_ROTATION_NAMES[index]);
+        value.translation = resolveOp(WE_GLTEX_TRANSLATION_NAMES[index]);
         return index + 1;
     });
 }
 
 void WPShaderValueUpdater::UpdateUniforms(SceneNode* pNode, sprite_map_t& sprites,
-                                          const UpdateUniformOp& updateOp) {
+                                          const UpdateUniformOp&     updateOp,
+                                          const UpdateUniformSpanOp& updateSpanOp) {
     if (! pNode->Mesh()) return;
+    TRACE_ZONE("UpdateUniforms");
 
     pNode->UpdateTrans();
 
-    const SceneCamera* camera;
-    std::string_view   cam_name = pNode->Camera();
-    if (! pNode->Camera().empty()) {
-        camera = m_scene->cameras.at(cam_name.data()).get();
-    } else
-        camera = m_scene->activeCamera;
+    assert(pNode->Index() < m_nodes.size());
+    auto& entry = m_nodes[pNode->Index()];
 
+    const SceneCamera* camera = pNode->Camera().empty() ? m_scene->activeCamera : entry.camera;
     if (! camera) return;
 
     auto* material = pNode->Mesh()->Material();
@@ -100,54 +133,60 @@ void WPShaderValueUpdater::UpdateUniforms(SceneNode* pNode, sprite_map_t& sprite
     // auto& shadervs = material->customShader.updateValueList;
     // const auto& valueSet = material->customShader.valueSet;
 
-    assert(exists(m_nodeUniformInfoMap, pNode));
-    const auto& info = m_nodeUniformInfoMap[pNode];
+    auto& info = entry.info;
 
-    bool hasNodeData = exists(m_nodeDataMap, pNode);
+    bool hasNodeData = entry.has_data;
     if (hasNodeData) {
-        auto& nodeData = m_nodeDataMap.at(pNode);
+        auto& nodeData = entry.data;
         for (const auto& el : nodeData.renderTargets) {
-            if (m_scene->renderTargets.count(el.second) == 0) continue;
-            const auto& rt = m_scene->renderTargets[el.second];
+            const auto* found = m_scene->FindRenderTarget(el.second);
+            if (found == nullptr) continue;
+            const auto& rt = *found;
 
             const auto& unifrom_tex = info.texs[el.first];
 
-            if (unifrom_tex.has_resolution) {
+            if (HasUniform(unifrom_tex.resolution)) {
                 std::array<i32, 4> resolution_uint({ rt.width, rt.height, rt.width, rt.height });
-                updateOp(WE_GLTEX_RESOLUTION_NAMES[el.first],
-                         ShaderValue(array_cast<float>(resolution_uint)));
+                updateOp(unifrom_tex.resolution, ShaderValue(array_cast<float>(resolution_uint)));
             }
-            if (unifrom_tex.has_mipmap) {
-                updateOp(WE_GLTEX_MIPMAPINFO_NAMES[el.first], (float)rt.mipmap_level);
+            if (HasUniform(unifrom_tex.mipmap)) {
+                updateOp(unifrom_tex.mipmap, (float)rt.mipmap_level);
             }
         }
-        if (nodeData.puppet_layer.hasPuppet() && info.has_BONES) {
-            auto data = nodeData.puppet_layer.genFrame(m_scene->frameTime);
-            updateOp(G_BONES, std::span<const float> { data[0].data(), data.size() * 16 });
+        if (! entry.bones.empty() && HasUniform(info.BONES)) {
+            const auto& data = entry.bones;
+            updateSpanOp(info.BONES, std::span<const float> { data[0].data(), data.size() * 16 });
         }
     }
 
-    bool reqMI    = info.has_MI;
-    bool reqM     = info.has_M;
-    bool reqAM    = info.has_AM;
-    bool reqMVP   = info.has_MVP;
-    bool reqMVPI  = info.has_MVPI;
-    bool reqETVP  = info.has_ETVP;
-    bool reqETVPI = info.has_ETVPI;
-
-    Matrix4d viewProTrans = camera->GetViewProjectionMatrix();
-
-    if (info.has_VP) {
-        updateOp(G_VP, ShaderValue::fromMatrix(viewProTrans));
-    }
-    if (reqM || reqMVP || reqMI || reqMVPI) {
-        Matrix4d modelTrans = pNode->ModelTrans();
-        if (hasNodeData && cam_name != "effect") {
-            const auto& nodeData = m_nodeDataMap.at(pNode);
-            if (m_parallax.enable) {
-                Vector3f nodePos = pNode->Translate();
-                Vector2f depth(&nodeData.parallaxDepth[0]);
-                Vector2f ortho { (float)m_scene->ortho[0], (float)m_scene->ortho[1] };
+    bool reqMI    = HasUniform(info.MI);
+    bool reqM     = HasUniform(info.M);
+    bool reqAM    = HasUniform(info.AM);
+    bool reqMVP   = HasUniform(info.MVP);
+    bool reqMVPI  = HasUniform(info.MVPI);
+    bool reqETVP  = HasUniform(info.ETVP);
+    bool reqETVPI = HasUniform(info.ETVPI);
+
+    auto& mats     = info.matrices;
+    bool  parallax = m_parallax.enable && hasNodeData && ! entry.effect_camera;
+    bool  stale    = mats.camera != camera || mats.camera_generation != camera->Generation() ||
+                     mats.node_generation != pNode->TransGeneration() ||
+                     (parallax && mats.mouse != m_mousePos);
+    if (stale) {
+        mats.camera            = camera;
+        mats.camera_generation = camera->Generation();
+        mats.node_generation   = pNode->TransGeneration();
+        mats.mouse             = m_mousePos;
+
+        const Matrix4d& viewProTrans = camera->GetViewProjectionMatrix();
+        mats.vp                      = viewProTrans.cast<float>();
+        if (reqM || reqMVP || reqMI || reqMVPI) {
+            Matrix4d modelTrans = pNode->ModelTrans().cast<double>();
+            if (parallax) {
+                const auto& nodeData = entry.data;
+                Vector3f    nodePos  = pNode->Translate();
+                Vector2f    depth(&nodeData.parallaxDepth[0]);
+                Vector2f    ortho { (float)m_scene->ortho[0], (float)m_scene->ortho[1] };
                 // flip mouse y axis
                 Vector2f mouseVec =
                     Scaling(1.0f, -1.0f) * (Vector2f { 0.5f, 0.5f } - Vector2f(&m_mousePos[0]));
@@ -160,15 +199,24 @@ void WPShaderValueUpdater::UpdateUniforms(SceneNode* pNode, sprite_map_t& sprite
                     Affine3d(Translation3d(Vector3d(paraVec.x(), paraVec.y(), 0.0f))).matrix() *
                     modelTrans;
             }
+            mats.m = modelTrans.cast<float>();
+            if (reqMI) mats.mi = modelTrans.inverse().cast<float>();
+            if (reqMVP) {
+                Matrix4d mvpTrans = viewProTrans * modelTrans;
+                mats.mvp          = mvpTrans.cast<float>();
+                if (reqMVPI) mats.mvpi = mvpTrans.inverse().cast<float>();
+            }
         }
+    }
 
-        if (reqM) updateOp(G_M, ShaderValue::fromMatrix(modelTrans));
-        if (reqAM) updateOp(G_AM, ShaderValue::fromMatrix(modelTrans));
-        if (reqMI) updateOp(G_MI, ShaderValue::fromMatrix(modelTrans.inverse()));
+    if (HasUniform(info.VP)) updateOp(info.VP, ShaderValue::fromMatrix(mats.vp));
+    if (reqM || reqMVP || reqMI || reqMVPI) {
+        if (reqM) updateOp(info.M, ShaderValue::fromMatrix(mats.m));
+        if (reqAM) updateOp(info.AM, ShaderValue::fromMatrix(mats.m));
+        if (reqMI) updateOp(info.MI, ShaderValue::fromMatrix(mats.mi));
         if (reqMVP) {
-            Matrix4d mvpTrans = viewProTrans * modelTrans;
-            updateOp(G_MVP, ShaderValue::fromMatrix(mvpTrans));
-            if (reqMVPI) updateOp(G_MVPI, ShaderValue::fromMatrix(mvpTrans.inverse()));
+            updateOp(info.MVP, ShaderValue::fromMatrix(mats.mvp));
+            if (reqMVPI) updateOp(info.MVPI, ShaderValue::fromMatrix(mats.mvpi));
         }
         if (reqETVP || reqETVPI) {
             /*
@@ -176,8 +224,8 @@ void WPShaderValueUpdater::UpdateUniforms(SceneNode* pNode, sprite_map_t& sprite
             nodePos.z()      = 1.0f;
             Matrix4d etvpTrans =
                 viewProTrans * modelTrans * Affine3d(Eigen::Scaling(nodePos)).matrix();
-            if (reqETVPI) updateOp(G_ETVP, ShaderValue::fromMatrix(etvpTrans));
-            if (reqETVPI) updateOp(G_ETVPI, ShaderValue::fromMatrix(etvpTrans.inverse()));
+            if (reqETVPI) updateOp(info.ETVP, ShaderValue::fromMatrix(etvpTrans));
+            if (reqETVPI) updateOp(info.ETVPI, ShaderValue::fromMatrix(etvpTrans.inverse()));
             */
         }
     }
@@ -185,60 +233,133 @@ void WPShaderValueUpdater::UpdateUniforms(SceneNode* pNode, sprite_map_t& sprite
     //	g_EffectTextureProjectionMatrix
     // shadervs.push_back({"g_EffectTextureProjectionMatrixInverse",
     // ShaderValue::ValueOf(Eigen::Matrix4f::Identity())});
-    if (info.has_TIME) updateOp(G_TIME, (float)m_scene->elapsingTime);
+    if (HasUniform(info.TIME)) updateOp(info.TIME, (float)m_scene->elapsingTime);
 
-    if (info.has_DAYTIME) updateOp(G_DAYTIME, (float)m_dayTime);
+    if (HasUniform(info.DAYTIME)) updateOp(info.DAYTIME, (float)m_dayTime);
 
-    if (info.has_POINTERPOSITION) updateOp(G_POINTERPOSITION, m_mousePos);
+    if (HasUniform(info.POINTERPOSITION)) updateOp(info.POINTERPOSITION, m_mousePos);
 
-    if (info.has_TEXELSIZE) updateOp(G_TEXELSIZE, m_texelSize);
+    if (HasUniform(info.TEXELSIZE)) updateOp(info.TEXELSIZE, m_texelSize);
 
-    if (info.has_TEXELSIZEHALF)
-        updateOp(G_TEXELSIZEHALF, std::array { m_texelSize[0] / 2.0f, m_texelSize[1] / 2.0f });
+    if (HasUniform(info.TEXELSIZEHALF))
+        updateOp(info.TEXELSIZEHALF, std::array { m_texelSize[0] / 2.0f, m_texelSize[1] / 2.0f });
 
-    if (info.has_SCREEN)
-        updateOp(G_SCREEN,
+    if (HasUniform(info.SCREEN))
+        updateOp(info.SCREEN,
                  std::array<float, 3> {
                      m_screen_size[0], m_screen_size[1], m_screen_size[0] / m_screen_size[1] });
 
-    if (info.has_PARALLAXPOSITION) {
-        Vector2f para =
-            Vector2f { 0.5f, 0.5f } +
-            (Scaling(1.0f, -1.0f) * (Vector2f(&m_mousePos[0])) - Vector2f { 0.5f, 0.5f }) *
-                m_parallax.mouseinfluence;
-        updateOp(G_PARALLAXPOSITION, std::array { para[0], para[1] });
-    }
+    if (HasUniform(info.PARALLAXPOSITION)) updateOp(info.PARALLAXPOSITION, ParallaxPosition());
 
     for (auto& [i, sp] : sprites) {
-        const auto& f      = sp.GetAnimateFrame(m_scene->frameTime);
-        auto        grot   = WE_GLTEX_ROTATION_NAMES[i];
-        auto        gtrans = WE_GLTEX_TRANSLATION_NAMES[i];
-        updateOp(grot, std::array { f.xAxis[0], f.xAxis[1], f.yAxis[0], f.yAxis[1] });
-        updateOp(gtrans, std::array { f.x, f.y });
+        const auto& f = sp.GetAnimateFrame(m_scene->frameTime);
+        if (i >= info.texs.size()) continue;
+        const auto& tex = info.texs[i];
+        if (HasUniform(tex.rotation))
+            updateOp(tex.rotation, std::array { f.xAxis[0], f.xAxis[1], f.yAxis[0], f.yAxis[1] });
+        if (HasUniform(tex.translation)) updateOp(tex.translation, std::array { f.x, f.y });
     }
 
-    if (info.has_LP) {
+    if (HasUniform(info.LP)) {
         std::array<float, 16> lights { 0 };
         std::array<float, 12> lights_color { 0 };
-        uint                  i = 0;
-        for (auto& l : m_scene->lights) {
-            if (i == 4) break;
-            assert(l->node() != nullptr);
-            const auto& trans = l->node()->Translate();
-            std::copy(trans.begin(), trans.end(), lights.begin() + i * 4);
-            if (i < 3) {
-                const auto& color = l->premultipliedColor();
-                std::copy(color.begin(), color.end(), lights_color.begin() + i * 4);
-            }
-            i++;
-        }
-        updateOp(G_LP, lights);
-        updateOp(G_LCP, lights_color);
+        GenLights(lights, lights_color);
+        updateOp(info.LP, lights);
+        if (HasUniform(info.LCP)) updateOp(info.LCP, lights_color);
+    }
+}
+
+void WPShaderValueUpdater::UpdateSharedUniforms(std::vector<uint8_t>& block) {
+    block.assign(WE_GLOBAL_BLOCK_SIZE, 0);
+    auto write = [&block](std::string_view name, std::span<const float> value) {
+        auto glob =
+            std::find_if(WE_GLOBAL_UNIFORMS.begin(), WE_GLOBAL_UNIFORMS.end(), [name](auto& g) {
+                return g.name == name;
+            });
+        assert(glob != WE_GLOBAL_UNIFORMS.end());
+        usize size = std::min(value.size_bytes(), block.size() - glob->offset);
+        std::memcpy(block.data() + glob->offset, value.data(), size);
+    };
+    // float arrays, std140 puts an element every 16 bytes
+    auto write_floats = [&block](std::string_view name, std::span<const float> value) {
+        auto glob =
+            std::find_if(WE_GLOBAL_UNIFORMS.begin(), WE_GLOBAL_UNIFORMS.end(), [name](auto& g) {
+                return g.name == name;
+            });
+        assert(glob != WE_GLOBAL_UNIFORMS.end());
+        for (usize i = 0; i < value.size() && i < glob->array; i++)
+            std::memcpy(block.data() + glob->offset + i * 16, &value[i], sizeof(float));
+    };
+    write(G_TIME, std::array { (float)m_scene->elapsingTime });
+    write(G_DAYTIME, std::array { (float)m_dayTime });
+    write(G_POINTERPOSITION, m_mousePos);
+    write(G_TEXELSIZE, m_texelSize);
+    write(G_TEXELSIZEHALF, std::array { m_texelSize[0] / 2.0f, m_texelSize[1] / 2.0f });
+    write(G_PARALLAXPOSITION, ParallaxPosition());
+    write(G_SCREEN,
+          std::array<float, 3> {
+              m_screen_size[0], m_screen_size[1], m_screen_size[0] / m_screen_size[1] });
+
+    std::array<float, 16> lights { 0 };
+    std::array<float, 12> lights_color { 0 };
+    GenLights(lights, lights_color);
+    write(G_LP, lights);
+    write(G_LCP, lights_color);
+
+    // the audio thread analyzed it, only copied here
+    if (m_spectrum) {
+        auto& bands = m_spectrum->latest();
+        write_floats(G_AUDIOSPECTRUM16LEFT, bands.left16);
+        write_floats(G_AUDIOSPECTRUM16RIGHT, bands.right16);
+        write_floats(G_AUDIOSPECTRUM32LEFT, bands.left32);
+        write_floats(G_AUDIOSPECTRUM32RIGHT, bands.right32);
+        write_floats(G_AUDIOSPECTRUM64LEFT, bands.left64);
+        write_floats(G_AUDIOSPECTRUM64RIGHT, bands.right64);
     }
 }
 
-void WPShaderValueUpdater::SetNodeData(void* nodeAddr, const WPShaderValueData& data) {
-    m_nodeDataMap[nodeAddr] = data;
+void WPShaderValueUpdater::SetNodeData(SceneNode* pNode, const WPShaderValueData& data) {
+    auto& entry    = Entry(pNode);
+    entry.has_data = true;
+    entry.data     = data;
+}
+
+void WPShaderValueUpdater::AnimationPeriods(std::vector<double>& out) const {
+    for (const auto& entry : m_nodes) {
+        if (entry.has_data && entry.data.puppet_layer.hasPuppet())
+            entry.data.puppet_layer.periods(out);
+    }
+}
+
+WPShaderValueUpdater::NodeEntry& WPShaderValueUpdater::Entry(SceneNode* pNode) {
+    if (pNode->Index() >= m_nodes.size()) {
+        pNode->SetIndex((u32)m_nodes.size());
+        m_nodes.emplace_back();
+    }
+    return m_nodes[pNode->Index()];
+}
+
+std::array<float, 2> WPShaderValueUpdater::ParallaxPosition() const {
+    Vector2f para = Vector2f { 0.5f, 0.5f } +
+                    (Scaling(1.0f, -1.0f) * (Vector2f(&m_mousePos[0])) - Vector2f { 0.5f, 0.5f }) *
+                        m_parallax.mouseinfluence;
+    return { para[0], para[1] };
+}
+
+void WPShaderValueUpdater::GenLights(std::array<float, 16>& lights,
+                                     std::array<float, 12>& lights_color) const {
+    uint i = 0;
+    for (auto& l : m_scene->lights) {
+        if (i == 4) break;
+        assert(l->node() != nullptr);
+        const auto& trans = l->node()->Translate();
+        std::copy(trans.begin(), trans.end(), lights.begin() + i * 4);
+        if (i < 3) {
+            const auto& color = l->premultipliedColor();
+            std::copy(color.begin(), color.end(), lights_color.begin() + i * 4);
+        }
+        i++;
+    }
 }
 
 void WPShaderValueUpdater::SetTexelSize(float x, float y) { m_texelSize = { x, y }; }
@@ -5,51 +5,75 @@
 #include <unordered_map>
 #include <cstdint>
 #include <chrono>
+#include <span>
 
 #include <Eigen/Dense>
 
 #include "Core/Core.hpp"
 #include "Interface/IShaderValueUpdater.h"
 #include "Core/MapSet.hpp"
+#include "Core/StringId.hpp"
 #include "SpriteAnimation.hpp"
 #include "WPPuppet.hpp"
+#include "Audio/AudioSpectrum.h"
 
 namespace wallpaper
 {
 
 class Scene;
+class SceneCamera;
+class SceneNode;
 
+// slots of the uniforms the node's shader has
 struct WPUniformInfo {
-    bool has_MI { false };
-    bool has_M { false };
-    bool has_AM { false };
-    bool has_MVP { false };
-    bool has_MVPI { false };
-    bool has_ETVP { false };
-    bool has_ETVPI { false };
-    bool has_VP { false };
-
-    bool has_BONES { false };
-    bool has_TIME { false };
-    bool has_DAYTIME { false };
-    bool has_POINTERPOSITION { false };
-    bool has_PARALLAXPOSITION { false };
-    bool has_TEXELSIZE { false };
-    bool has_TEXELSIZEHALF { false };
-    bool has_SCREEN { false };
-    bool has_LP { false };
+    UniformSlot MI { NoUniformSlot };
+    UniformSlot M { NoUniformSlot };
+    UniformSlot AM { NoUniformSlot };
+    UniformSlot MVP { NoUniformSlot };
+    UniformSlot MVPI { NoUniformSlot };
+    UniformSlot ETVP { NoUniformSlot };
+    UniformSlot ETVPI { NoUniformSlot };
+    UniformSlot VP { NoUniformSlot };
+
+    UniformSlot BONES { NoUniformSlot };
+    UniformSlot TIME { NoUniformSlot };
+    UniformSlot DAYTIME { NoUniformSlot };
+    UniformSlot POINTERPOSITION { NoUniformSlot };
+    UniformSlot PARALLAXPOSITION { NoUniformSlot };
+    UniformSlot TEXELSIZE { NoUniformSlot };
+    UniformSlot TEXELSIZEHALF { NoUniformSlot };
+    UniformSlot SCREEN { NoUniformSlot };
+    UniformSlot LP { NoUniformSlot };
+    UniformSlot LCP { NoUniformSlot };
 
     struct Tex {
-        bool has_resolution { false };
-        bool has_mipmap { false };
+        UniformSlot resolution { NoUniformSlot };
+        UniformSlot mipmap { NoUniformSlot };
+        UniformSlot rotation { NoUniformSlot };
+        UniformSlot translation { NoUniformSlot };
     };
     std::array<Tex, 12> texs;
+
+    // the matrices in float, rebuilt only when the node, its camera or the parallax moved
+    struct Matrices {
+        const SceneCamera*   camera { nullptr };
+        u64                  camera_generation { 0 };
+        u64                  node_generation { 0 };
+        std::array<float, 2> mouse { -1.0f, -1.0f };
+
+        Eigen::Matrix4f vp;
+        Eigen::Matrix4f m;
+        Eigen::Matrix4f mi;
+        Eigen::Matrix4f mvp;
+        Eigen::Matrix4f mvpi;
+    };
+    Matrices matrices;
 };
 
 struct WPShaderValueData {
     std::array<float, 2> parallaxDepth { 0.0f, 0.0f };
     // index + name
-    std::vector<std::pair<usize, std::string>> renderTargets;
+    std::vector<std::pair<usize, StringId>> renderTargets;
 
     WPPuppetLayer puppet_layer;
 };
@@ -68,21 +92,46 @@ public:
 
     void FrameBegin() override;
 
-    void InitUniforms(SceneNode*, const ExistsUniformOp&) override;
-    void UpdateUniforms(SceneNode*, sprite_map_t&, const UpdateUniformOp&) override;
+    void InitUniforms(SceneNode*, const ResolveUniformOp&) override;
+    void UpdateUniforms(SceneNode*, sprite_map_t&, const UpdateUniformOp&,
+                        const UpdateUniformSpanOp&) override;
     void FrameEnd() override;
+    void UpdateSharedUniforms(std::vector<uint8_t>&) override;
     void MouseInput(double, double) override;
     void SetTexelSize(float x, float y) override;
 
-    void SetNodeData(void*, const WPShaderValueData&);
+    void SetNodeData(SceneNode*, const WPShaderValueData&);
     void SetCameraParallax(const WPCameraParallax& value) { m_parallax = value; }
+    const WPCameraParallax& CameraParallax() const { return m_parallax; }
+    // seconds till each puppet animation of the nodes starts over
+    void AnimationPeriods(std::vector<double>&) const;
 
     void SetScreenSize(i32 w, i32 h) override { m_screen_size = { (float)w, (float)h }; }
+    // the g_AudioSpectrum uniforms of the shared block, 0 without
+    void SetAudioSpectrum(std::shared_ptr<audio::AudioSpectrum> v) { m_spectrum = std::move(v); }
 
     // Get interpolated mouse position in normalized coordinates (0-1)
     std::array<float, 2> GetMousePosition() const { return m_mousePos; }
 
 private:
+    // everything kept for a node, at the node's index
+    struct NodeEntry {
+        bool              has_data { false };
+        WPShaderValueData data;
+        WPUniformInfo     info;
+        // the named camera, resolved at init
+        const SceneCamera* camera { nullptr };
+        bool               effect_camera { false };
+        // the puppet's palette for this frame, from FrameBegin
+        std::span<const Eigen::Affine3f> bones;
+    };
+    // gives the node an index the first time it's seen
+    NodeEntry& Entry(SceneNode*);
+
+    std::array<float, 2> ParallaxPosition() const;
+    // the first 4 lights and the colors of the first 3, vec4 aligned
+    void GenLights(std::array<float, 16>& lights, std::array<float, 12>& lights_color) const;
+
     Scene*               m_scene;
     WPCameraParallax     m_parallax;
     double               m_dayTime { 0.0f };
@@ -93,11 +142,13 @@ private:
     double               m_mouseDelayedTime { 0.0f };
     uint                 m_mouseInputCount { 0 };
 
-    std::chrono::time_point<std::chrono::steady_clock> m_last_mouse_input_time;
+    // scene seconds
+    double m_last_mouse_input_time { 0.0 };
 
     std::array<float, 2> m_screen_size { 1920, 1080 };
 
-    Map<void*, WPShaderValueData> m_nodeDataMap;
-    Map<void*, WPUniformInfo>     m_nodeUniformInfoMap;
+    std::shared_ptr<audio::AudioSpectrum> m_spectrum;
+
+    std::vector<NodeEntry> m_nodes;
 };
 } // namespace wallpaper
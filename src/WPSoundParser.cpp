@@ -1,11 +1,18 @@
 #include "WPSoundParser.hpp"
 #include "Audio/SoundManager.h"
 #include "Fs/VFS.h"
+#include "Fs/IBinaryStream.h"
 #include "wpscene/WPSoundObject.h"
 #include "Utils/Logging.h"
+#include "Utils/MemUse.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <vector>
 
 using namespace wallpaper;
 
@@ -23,6 +30,39 @@ static PlaybackMode ToPlaybackMode(std::string_view s) {
     return PlaybackMode::Loop;
 };
 
+namespace
+{
+// files up to this are decoded once into memory, if they end within the seconds
+constexpr usize ClipMaxBytes { 1024 * 1024 };
+constexpr u32   ClipMaxSeconds { 10 };
+// bytes of decoded clips of all streams
+constexpr usize         ClipBudget { 64 * 1024 * 1024 };
+std::atomic<usize>      g_clip_bytes { 0 };
+
+using ClipPcm = std::vector<float>;
+
+// plays a decoded clip once
+class ClipStream : public audio::SoundStream {
+public:
+    ClipStream(std::shared_ptr<const ClipPcm> pcm, u32 channels)
+        : m_pcm(std::move(pcm)), m_channels(channels) {}
+
+    uint64_t NextPcmData(void* pData, uint32_t frameCount) override {
+        usize left   = (m_pcm->size() - m_pos) / m_channels;
+        usize frames = std::min<usize>(frameCount, left);
+        std::memcpy(pData, m_pcm->data() + m_pos, frames * m_channels * sizeof(float));
+        m_pos += frames * m_channels;
+        return frames;
+    }
+    void PassDesc(const Desc&) override {}
+
+private:
+    std::shared_ptr<const ClipPcm> m_pcm;
+    u32                            m_channels;
+    usize                          m_pos { 0 };
+};
+} // namespace
+
 class WPSoundStream : public audio::SoundStream {
 public:
     struct Config {
@@ -33,35 +73,93 @@ public:
     };
     WPSoundStream(const std::vector<std::string>& paths, fs::VFS& vfs, Config c)
         : vfs(vfs), m_config(c), m_soundPaths(paths) {};
-    virtual ~WPSoundStream() = default;
+    virtual ~WPSoundStream() { DropClips(); };
 
     uint64_t NextPcmData(void* pData, uint32_t frameCount) override {
         // first
         if (! m_curActive) {
+            LoadClips();
             Switch();
         }
 
-        // loop
+        // loop, on the feeder thread, not the device's
         uint64_t frameReads = m_curActive->NextPcmData(pData, frameCount);
         if (frameReads == 0) {
             Switch();
             frameReads = m_curActive->NextPcmData(pData, frameCount);
         }
-        // volume
-        {
-            float*     pData_float = static_cast<float*>(pData);
-            const auto num         = frameReads * m_desc.channels;
-            for (uint i = 0; i < num; i++, pData_float++) {
-                (*pData_float) *= m_config.volume;
-            }
-        }
         return frameReads;
     };
-    void PassDesc(const Desc& d) override { m_desc = d; }
+    float Gain() const override { return m_config.volume; }
+    void PassDesc(const Desc& d) override {
+        // decoders convert to the desc they were made with
+        m_desc = d;
+        m_curActive.reset();
+        m_next.reset();
+        DropClips();
+    }
     void Switch() {
-        std::string path = m_soundPaths[LoopIndex()];
+        if (! m_next) m_next = Open(LoopIndex());
+        m_curActive = std::move(m_next);
+        // opened now so the switch to it doesn't wait for the file
+        m_next = Open(LoopIndex());
+    }
+    std::unique_ptr<SoundStream> Open(uint32_t index) {
+        if (index < m_clips.size() && m_clips[index])
+            return std::make_unique<ClipStream>(m_clips[index], m_desc.channels);
+        const std::string& path = m_soundPaths[index];
         // LOG_INFO("Switch to audio file: %s", path.c_str());
-        m_curActive = audio::CreateSoundStream(vfs.Open("/assets/" + path), m_desc);
+        return audio::CreateSoundStream(vfs.Open("/assets/" + path), m_desc);
+    }
+    // small files decoded whole before the first plays, later cycles of them only copy
+    void LoadClips() {
+        if (m_clips_loaded || m_desc.channels == 0) return;
+        m_clips_loaded = true;
+        m_clips.resize(m_soundPaths.size());
+        for (usize i = 0; i < m_soundPaths.size(); i++) {
+            auto same = std::find(m_soundPaths.begin(), m_soundPaths.begin() + (isize)i,
+                                  m_soundPaths[i]);
+            if (same != m_soundPaths.begin() + (isize)i) {
+                m_clips[i] = m_clips[(usize)(same - m_soundPaths.begin())];
+                continue;
+            }
+            m_clips[i] = DecodeClip(m_soundPaths[i]);
+        }
+    }
+    std::shared_ptr<const ClipPcm> DecodeClip(const std::string& path) {
+        auto file = vfs.Open("/assets/" + path);
+        if (! file || file->Size() <= 0 || (usize)file->Size() > ClipMaxBytes) return nullptr;
+        auto decoder = audio::CreateSoundStream(std::move(file), m_desc);
+
+        const usize   max_frames = (usize)ClipMaxSeconds * m_desc.sampleRate;
+        constexpr u32 chunk { 4096 };
+        auto          pcm = std::make_shared<ClipPcm>();
+        while (true) {
+            usize at = pcm->size();
+            pcm->resize(at + (usize)chunk * m_desc.channels);
+            u64 frames = decoder->NextPcmData(pcm->data() + at, chunk);
+            pcm->resize(at + (usize)frames * m_desc.channels);
+            if (frames == 0) break;
+            if (pcm->size() / m_desc.channels > max_frames) return nullptr;
+        }
+        if (pcm->empty()) return nullptr;
+        pcm->shrink_to_fit();
+
+        const usize bytes = pcm->size() * sizeof(float);
+        if (g_clip_bytes.fetch_add(bytes) + bytes > ClipBudget) {
+            g_clip_bytes.fetch_sub(bytes);
+            return nullptr;
+        }
+        m_clip_bytes += bytes;
+        m_clip_held.set(m_clip_bytes);
+        return pcm;
+    }
+    void DropClips() {
+        m_clips.clear();
+        m_clips_loaded = false;
+        g_clip_bytes.fetch_sub(m_clip_bytes);
+        m_clip_bytes = 0;
+        m_clip_held.set(0);
     }
     uint32_t LoopIndex() {
         m_curIndex++;
@@ -77,6 +175,13 @@ private:
 
     const std::vector<std::string> m_soundPaths;
     std::unique_ptr<SoundStream>   m_curActive;
+    std::unique_ptr<SoundStream>   m_next;
+
+    // of m_soundPaths, null for those decoded as they play
+    std::vector<std::shared_ptr<const ClipPcm>> m_clips;
+    bool                                        m_clips_loaded { false };
+    usize                                       m_clip_bytes { 0 };
+    memuse::Held                                m_clip_held { memuse::Pool::AudioClips };
 };
 
 void WPSoundParser::Parse(const wpscene::WPSoundObject& obj, fs::VFS& vfs,
@@ -0,0 +1,82 @@
+#include "WPTexCache.hpp"
+
+#include "Fs/IBinaryStream.h"
+#include "Utils/Logging.h"
+#include "Utils/Sha.hpp"
+#include "Image.hpp"
+#include "BcEncode.hpp"
+
+#include <cstring>
+
+#define TEX_DIR    "texs02"
+#define TEX_SUFFIX "mip"
+
+using namespace wallpaper;
+namespace sfs = std::filesystem;
+
+namespace
+{
+// "WPTC", then format, width, height and the pixel size
+constexpr u32 tex_magic { 0x43545057 };
+} // namespace
+
+WPTexCache::WPTexCache(sfs::path dir, u64 max_bytes): m_dir(std::move(dir), max_bytes) {}
+
+std::unique_ptr<WPTexCache> WPTexCache::FromVfs(fs::VFS& vfs) {
+    auto dir = WPCacheDir::FromVfs(vfs, TEX_DIR);
+    if (dir.empty()) return nullptr;
+    return std::make_unique<WPTexCache>(dir);
+}
+
+std::string WPTexCache::Key(std::span<const char> encoded) { return utils::genSha1(encoded); }
+
+bool WPTexCache::Load(std::string_view key, Image& img, ImageData& mip, TextureFormat& format) {
+    auto path = m_dir.FilePath(key, TEX_SUFFIX);
+    auto file = m_dir.Open(path);
+    if (! file) return false;
+
+    u32  magic  = file->ReadUint32();
+    auto fmt    = (TextureFormat)file->ReadUint32();
+    i32  width  = file->ReadInt32();
+    i32  height = file->ReadInt32();
+    u32  size   = file->ReadUint32();
+    if (magic != tex_magic || width != mip.width || height != mip.height || size == 0 ||
+        size != MipDataSize(fmt, width, height)) {
+        LOG_ERROR("broken texture cache \'%s\'", path.c_str());
+        return false;
+    }
+
+    format = fmt;
+    if (auto view = file->TryMapView(file->Tell(), size); ! view.empty()) {
+        mip.size = size;
+        mip.fill = [file, view](std::span<uint8_t> dst) {
+            if (dst.size() != view.size()) return false;
+            std::memcpy(dst.data(), view.data(), dst.size());
+            return true;
+        };
+        return true;
+    }
+    auto dst = img.allocate(mip, size);
+    if (file->Read(dst.data(), size) != size) {
+        img.release(mip);
+        return false;
+    }
+    return true;
+}
+
+void WPTexCache::Save(std::string_view key, const Image& img, const ImageData& mip,
+                      TextureFormat format) {
+    const uint8_t* data = img.data(mip);
+    if (data == nullptr || mip.size <= 0) return;
+    auto write = [&mip, data, format](fs::IBinaryStreamW& file) {
+        file.WriteUint32(tex_magic);
+        file.WriteUint32((u32)format);
+        file.WriteInt32(mip.width);
+        file.WriteInt32(mip.height);
+        file.WriteUint32((u32)mip.size);
+        file.Write(data, (usize)mip.size);
+    };
+    m_dir.WriteFile(m_dir.FilePath(key, TEX_SUFFIX), write);
+}
+
+void WPTexCache::Trim() { m_dir.Trim(); }
@@ -0,0 +1,49 @@
+#pragma once
+#include "Core/Literals.hpp"
+#include "Core/NoCopyMove.hpp"
+#include "Type.hpp"
+#include "WPCacheDir.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace wallpaper
+{
+namespace fs
+{
+class VFS;
+}
+struct Image;
+struct ImageData;
+
+// Decoded pixels of the png and jpeg mips of tex files, named by the sha of the encoded bytes,
+// so a warm load skips the image decode and wallpapers sharing an image share the file.
+// Mips transcoded to bc, or downscaled to a size cap, are kept the same way under their own keys.
+// A file is the pixels behind a small header, loads copy them from its mapping.
+class WPTexCache : NoCopy, NoMove {
+public:
+    constexpr static u64 DefaultMaxBytes { 1ull << 30 };
+
+    explicit WPTexCache(std::filesystem::path dir, u64 max_bytes = DefaultMaxBytes);
+
+    // in the mounted cache folder, null when there is none or it's not on disk
+    static std::unique_ptr<WPTexCache> FromVfs(fs::VFS&);
+
+    static std::string Key(std::span<const char> encoded);
+
+    // false on a miss or a file not matching the mip's size, thread safe
+    // format is what the file holds, rgba8 or a bc format, the pixels go to the image's
+    bool Load(std::string_view key, Image&, ImageData&, TextureFormat& format);
+    void Save(std::string_view key, const Image&, const ImageData&, TextureFormat format);
+
+    // after a load saved something, cheap otherwise
+    void Trim();
+
+private:
+    WPCacheDir m_dir;
+};
+
+} // namespace wallpaper
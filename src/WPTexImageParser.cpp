@@ -6,14 +6,21 @@
 #include <lz4.h>
 
 #include "SpriteAnimation.hpp"
+#include "BcEncode.hpp"
 #include "Utils/Algorism.h"
+#include "Utils/Hash.h"
 #include "Fs/VFS.h"
+#include "Fs/LimitedBinaryStream.h"
 #include "Utils/BitFlags.hpp"
+#include "Looper/JobSystem.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <algorithm>
 #include <cstring>
+#include <future>
+#include <memory>
 #include <iostream>
 #include <string_view>
 
@@ -68,9 +75,23 @@ TextureFormat ToTexFormate(int type) {
         return TextureFormat::RGBA8;
     }
 }
+// -1 for the ones a tex can't hold
+i32 FromTexFormat(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::RGBA8: return 0;
+    case TextureFormat::BC3: return 4;
+    case TextureFormat::BC2: return 6;
+    case TextureFormat::BC1: return 7;
+    case TextureFormat::RG8: return 8;
+    case TextureFormat::R8: return 9;
+    default: return -1;
+    }
+}
+
 void LoadHeader(fs::IBinaryStream& file, ImageHeader& header) {
-    header.extraHeader["texv"].val = ReadTexVesion(file);
-    header.extraHeader["texi"].val = ReadTexVesion(file);
+    header.fromTex = true;
+    header.texv    = ReadTexVesion(file);
+    header.texi    = ReadTexVesion(file);
 
     header.format = ToTexFormate(file.ReadInt32());
     WPTexFlags flags(file.ReadUint32());
@@ -80,9 +101,9 @@ void LoadHeader(fs::IBinaryStream& file, ImageHeader& header) {
             flags[WPTexFlagEnum::clampUVs] ? TextureWrap::CLAMP_TO_EDGE : TextureWrap::REPEAT;
         header.sample.minFilter = header.sample.magFilter =
             flags[WPTexFlagEnum::noInterpolation] ? TextureFilter::NEAREST : TextureFilter::LINEAR;
-        header.extraHeader["compo1"].val = flags[WPTexFlagEnum::compo1];
-        header.extraHeader["compo2"].val = flags[WPTexFlagEnum::compo2];
-        header.extraHeader["compo3"].val = flags[WPTexFlagEnum::compo3];
+        header.compo1 = flags[WPTexFlagEnum::compo1];
+        header.compo2 = flags[WPTexFlagEnum::compo2];
+        header.compo3 = flags[WPTexFlagEnum::compo3];
     }
 
     /*
@@ -107,11 +128,12 @@ void LoadHeader(fs::IBinaryStream& file, ImageHeader& header) {
 
     file.ReadInt32(); // unknown
 
-    header.extraHeader["texb"].val = ReadTexVesion(file);
+    header.texb = ReadTexVesion(file);
 
     header.count = file.ReadInt32();
 
-    if (header.extraHeader["texb"].val == 3) header.type = static_cast<ImageType>(file.ReadInt32());
+    if (header.texb >= 3) header.type = static_cast<ImageType>(file.ReadInt32());
+    if (header.texb >= 4) header.isVideo = file.ReadInt32() == 1;
 }
 
 void SetHeaderPow2(ImageHeader& header, i32 mip_0_w, i32 mip_0_h) {
@@ -131,12 +153,16 @@ inline ImageHeader MakeFallbackHeader() {
     header.height    = 1;
     header.mapWidth  = 1;
     header.mapHeight = 1;
+    header.mipWidth  = 1;
+    header.mipHeight = 1;
+    header.mipCount  = 1;
     header.format    = TextureFormat::RGBA8;
     header.count     = 1;
     return header;
 }
 
-inline std::shared_ptr<Image> MakeFallbackImage(const std::string& name) {
+// one texel of value in every channel
+inline std::shared_ptr<Image> MakeFallbackImage(const std::string& name, uint8_t value = 255) {
     auto  img_ptr = std::make_shared<Image>();
     auto& img     = *img_ptr;
     img.key        = name;
@@ -149,17 +175,171 @@ inline std::shared_ptr<Image> MakeFallbackImage(const std::string& name) {
     ImageData mipmap;
     mipmap.width  = 1;
     mipmap.height = 1;
-    mipmap.size   = 4;
-    mipmap.data   = ImageDataPtr(new uint8_t[4] { 255, 255, 255, 255 },
-                                 [](uint8_t* p) { delete[] p; });
+    std::ranges::fill(img.allocate(mipmap, 4), value);
     slot.mipmaps.push_back(std::move(mipmap));
     img.slots.push_back(std::move(slot));
     return img_ptr;
 }
 
+// rgba8 to the image's bc format, the first mip picks bc1 if opaque, bc3 if not
+// the mip must be the last of the image's pixels, the bc data takes the place of the rgba8
+bool TranscodeMip(WPTexCache& cache, std::string_view key, TextureFormat& format, Image& img,
+                  ImageData& mip) {
+    const usize    rgba_size = MipDataSize(TextureFormat::RGBA8, mip.width, mip.height);
+    const uint8_t* rgba      = img.data(mip);
+    if (rgba == nullptr || (usize)mip.size != rgba_size) return false;
+    if (format == TextureFormat::RGBA8)
+        format = IsOpaque({ rgba, rgba_size }) ? TextureFormat::BC1 : TextureFormat::BC3;
+
+    const usize size = MipDataSize(format, mip.width, mip.height);
+    auto        out  = std::make_unique_for_overwrite<uint8_t[]>(size);
+    if (! EncodeBc(format, rgba, mip.width, mip.height, out.get())) return false;
+    img.release(mip);
+    std::memcpy(img.allocate(mip, size).data(), out.get(), size);
+    cache.Save(key, img, mip, format);
+    return true;
+}
+
+// halved until both sides fit in max, as the mip chain would have it, 0 for no cap
+void CapSize(i32& w, i32& h, u32 max) {
+    while (max > 0 && (w > (i32)max || h > (i32)max)) {
+        w = std::max(w / 2, 1);
+        h = std::max(h / 2, 1);
+    }
+}
+
+// of the formats a downscale can average, 0 for compressed ones
+usize PixelBytes(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::RGBA8: return 4;
+    case TextureFormat::RG8: return 2;
+    case TextureFormat::R8: return 1;
+    default: return 0;
+    }
+}
+
+// src_w x src_h pixels to the mip's size, box filtered a halving at a time
+// the mip must be the last of the image's pixels, an image left with no others gives up its buffer
+bool ShrinkMip(Image& img, ImageData& mip, i32 src_w, i32 src_h, usize bpp) {
+    const uint8_t* src = img.data(mip);
+    if (src == nullptr || (usize)mip.size != (usize)src_w * (usize)src_h * bpp) return false;
+
+    std::vector<uint8_t> cur, next;
+    i32                  w = src_w, h = src_h;
+    while (w > mip.width || h > mip.height) {
+        const i32 nw = std::max(w / 2, 1), nh = std::max(h / 2, 1);
+        next.resize((usize)nw * (usize)nh * bpp);
+        for (i32 y = 0; y < nh; y++) {
+            const usize row0 = (usize)std::min(y * 2, h - 1) * (usize)w;
+            const usize row1 = (usize)std::min(y * 2 + 1, h - 1) * (usize)w;
+            for (i32 x = 0; x < nw; x++) {
+                const usize x0  = (usize)std::min(x * 2, w - 1);
+                const usize x1  = (usize)std::min(x * 2 + 1, w - 1);
+                uint8_t*    out = &next[((usize)y * (usize)nw + (usize)x) * bpp];
+                for (usize c = 0; c < bpp; c++) {
+                    u32 sum = (u32)src[(row0 + x0) * bpp + c] + src[(row0 + x1) * bpp + c] +
+                              src[(row1 + x0) * bpp + c] + src[(row1 + x1) * bpp + c];
+                    out[c] = (uint8_t)((sum + 2) / 4);
+                }
+            }
+        }
+        cur.swap(next);
+        src = cur.data();
+        w   = nw;
+        h   = nh;
+    }
+    img.release(mip);
+    if (img.pixels_size == 0) {
+        img.pixels.reset();
+        img.pixels_capacity = 0;
+        img.pixels_held.set(0);
+    }
+    std::memcpy(img.allocate(mip, cur.size()).data(), cur.data(), cur.size());
+    return true;
+}
+
+// large payloads by their size, both ends and the middle, it only tells images apart
+std::size_t PayloadHash(const char* src, usize size) {
+    constexpr usize  part = 64 * 1024;
+    std::string_view all { src, size };
+    if (size <= part * 4) return std::hash<std::string_view>()(all);
+    std::size_t seed { 0 };
+    utils::hash_combine(seed, size);
+    utils::hash_combine(seed, all.substr(0, part));
+    utils::hash_combine(seed, all.substr(size / 2 - part / 2, part));
+    utils::hash_combine(seed, all.substr(size - part));
+    return seed;
+}
+
 } // namespace
 
 std::shared_ptr<Image> WPTexImageParser::Parse(const std::string& name) {
+    if (auto it = m_preloaded.find(name); it != m_preloaded.end()) {
+        auto img = std::move(it->second);
+        m_preloaded.erase(it);
+        return img;
+    }
+    return Decode(name);
+}
+
+void WPTexImageParser::Preload(const std::string& name) {
+    if (m_preloaded.count(name) != 0) return;
+    if (auto img = Decode(name)) m_preloaded[name] = std::move(img);
+}
+
+void WPTexImageParser::DropPreloaded() {
+    if (m_preloaded.empty()) return;
+    usize bytes { 0 };
+    for (auto& [_, img] : m_preloaded) bytes += img->pixels_capacity;
+    LOG_INFO("dropped %d decoded textures no pass used, %.1f MiB",
+             (int)m_preloaded.size(),
+             (double)bytes / (1024.0 * 1024.0));
+    m_preloaded.clear();
+}
+
+void WPTexImageParser::SetTranscode(bool enable) {
+    if (enable && ! m_cache) LOG_INFO("texture transcoding needs a cache folder, disabled");
+    m_transcode = enable && m_cache;
+}
+
+void WPTexImageParser::SetMaxSize(u32 max) { m_max_size = max; }
+
+void WPTexImageParser::Preload(std::span<const std::string> names, std::function<bool()> stop) {
+    std::vector<const std::string*> todo;
+    for (auto& name : names) {
+        if (m_preloaded.count(name) == 0) todo.push_back(&name);
+    }
+    if (todo.empty()) return;
+
+    // every read is in flight before the first decode waits on its own
+    std::vector<std::future<std::shared_ptr<fs::IBinaryStream>>> reads(todo.size());
+    for (usize i = 0; i < todo.size(); i++) {
+        std::string path = "/assets/materials/" + *todo[i] + ".tex";
+        if (m_vfs->Contains(path)) reads[i] = m_vfs->ReadAsync(path);
+    }
+
+    // decode only reads the vfs, a texture a job
+    std::vector<std::shared_ptr<Image>> images(todo.size());
+    auto&                               jobs = looper::JobSystem::Shared();
+    jobs.parallelFor(
+        todo.size(),
+        [&](usize i) {
+            if (stop && stop()) return;
+            images[i] = Decode(*todo[i], reads[i].valid() ? reads[i].get() : nullptr);
+        },
+        looper::JobPriority::Load);
+
+    for (usize i = 0; i < todo.size(); i++) {
+        if (images[i]) m_preloaded[*todo[i]] = std::move(images[i]);
+    }
+    LOG_INFO("decoded %d textures on %d threads",
+             (int)todo.size(),
+             (int)std::min(todo.size(), jobs.workerCount() + 1));
+    if (m_cache) m_cache->Trim();
+}
+
+std::shared_ptr<Image> WPTexImageParser::Decode(const std::string&             name,
+                                                std::shared_ptr<fs::IBinaryStream> read) {
     std::string path = "/assets/materials/" + name + ".tex";
     if (IsAliasTexture(name) && ! m_vfs->Contains(path)) {
         LOG_INFO("using fallback 1x1 white texture for \"%s\"", name.c_str());
@@ -168,17 +348,47 @@ std::shared_ptr<Image> WPTexImageParser::Parse(const std::string& name) {
     std::shared_ptr<Image> img_ptr = std::make_shared<Image>();
     auto&                  img     = *img_ptr;
     img.key                        = name;
-    auto pfile = m_vfs->Open(path);
+    auto pfile = read ? std::move(read) : m_vfs->Open(path);
     if (! pfile) return nullptr;
     auto& file     = *pfile;
     auto  startpos = file.Tell();
     LoadHeader(file, img.header);
+    if (img.header.isVideo) {
+        // the clip is the one mip of the one image, the slot is a transparent texel the renderer
+        // draws the decoded frames over
+        auto  video  = MakeFallbackImage(name, 0);
+        auto& header = video->header;
+
+        header.isVideo   = true;
+        header.sample    = img.header.sample;
+        header.width     = img.header.width;
+        header.height    = img.header.height;
+        header.mapWidth  = img.header.mapWidth;
+        header.mapHeight = img.header.mapHeight;
+        if (img.header.count < 1 || file.ReadInt32() < 1) return video;
+        file.ReadInt32(); // width
+        file.ReadInt32(); // height
+        if (img.header.texb > 1) {
+            file.ReadInt32(); // lz4, clips are stored as they are
+            file.ReadInt32();
+        }
+        i32 size = file.ReadInt32();
+        if (size <= 0 || file.Tell() + size > file.Size()) {
+            LOG_ERROR("video texture \"%s\" is cut short", name.c_str());
+            return video;
+        }
+        video->video = std::make_shared<fs::LimitedBinaryStream>(pfile, file.Tell(), size);
+        return video;
+    }
 
     // image
     i32 _image_count = img.header.count;
     if (_image_count < 0) return nullptr;
     usize image_count = (usize)_image_count;
 
+    // set by the first mip, the image's format changes once that's transcoded
+    bool transcode { false };
+
     img.slots.resize(image_count);
     for (usize i_image = 0; i_image < image_count; i_image++) {
         auto& img_slot = img.slots[i_image];
@@ -186,21 +396,39 @@ std::shared_ptr<Image> WPTexImageParser::Parse(const std::string& name) {
 
         usize mipmap_count = (usize)std::max<i32>(file.ReadInt32(), 0);
         mipmaps.resize(mipmap_count);
+        // levels over the size cap are read past, the first kept one sizes the slot
+        usize first { 0 };
+        // of a single mip over the cap, decoded at its own size and downscaled after
+        i32 src_w { 0 }, src_h { 0 };
         // load image
         for (usize i_mipmap = 0; i_mipmap < mipmap_count; i_mipmap++) {
             auto& mipmap  = mipmaps.at(i_mipmap);
             mipmap.width  = file.ReadInt32();
             mipmap.height = file.ReadInt32();
-            if (i_mipmap == 0) {
+            if (i_mipmap == 0) SetHeaderPow2(img.header, mipmap.width, mipmap.height);
+            const bool skip = m_max_size > 0 && i_mipmap == first && i_mipmap + 1 < mipmap_count &&
+                              std::max(mipmap.width, mipmap.height) > (i32)m_max_size;
+            const bool container = img.header.texb >= 3 && img.header.type != ImageType::UNKNOWN;
+            if (i_mipmap == first && ! skip) {
+                src_w = src_h = 0;
+                if (mipmap_count == 1 && (container || PixelBytes(img.header.format) > 0)) {
+                    src_w = mipmap.width;
+                    src_h = mipmap.height;
+                    CapSize(mipmap.width, mipmap.height, m_max_size);
+                    if (mipmap.width == src_w && mipmap.height == src_h) src_w = src_h = 0;
+                }
                 img_slot.width  = mipmap.width;
                 img_slot.height = mipmap.height;
-                SetHeaderPow2(img.header, mipmap.width, mipmap.height);
+                transcode = i_image == 0 && m_transcode && m_cache && image_count == 1 &&
+                            ! img.header.isSprite && img.header.format == TextureFormat::RGBA8 &&
+                            (i64)mipmap.width * mipmap.height >= MinTranscodePixels;
             }
+            const bool shrink = src_w > 0;
 
             bool    LZ4_compressed    = false;
             int32_t decompressed_size = 0;
             // check compress
-            if (img.header.extraHeader["texb"].val > 1) {
+            if (img.header.texb > 1) {
                 LZ4_compressed    = file.ReadInt32() == 1;
                 decompressed_size = file.ReadInt32();
             }
@@ -208,46 +436,208 @@ std::shared_ptr<Image> WPTexImageParser::Parse(const std::string& name) {
             i32 src_size = file.ReadInt32();
             if (src_size <= 0 || mipmap.width <= 0 || mipmap.height <= 0 || decompressed_size < 0)
                 return nullptr;
+            if (skip) {
+                first++;
+                file.SeekCur(src_size);
+                continue;
+            }
+            // caches of downscaled mips hold them per cap
+            const std::string cap_key = shrink ? "cap" + std::to_string(m_max_size) : "";
+
+            // mapped files are read in place, others through a buffer
+            std::unique_ptr<char[]> read_buf;
+            const char*             src  = nullptr;
+            auto                    view = file.TryMapView(file.Tell(), (usize)src_size);
+            if (! view.empty()) {
+                src = reinterpret_cast<const char*>(view.data());
+                file.SeekCur(src_size);
+            } else {
+                read_buf.reset(new char[(usize)src_size]);
+                if (file.Read(read_buf.get(), (usize)src_size) != (usize)src_size) return nullptr;
+                src = read_buf.get();
+            }
+            utils::hash_combine(img.content, mipmap.width);
+            utils::hash_combine(img.content, mipmap.height);
+            utils::hash_combine(img.content, PayloadHash(src, (usize)src_size));
+
+            // transcoded mips are named by the payload, hashed before any decode
+            std::string bc_key;
+            if (transcode) {
+                bc_key = WPTexCache::Key({ src, (usize)src_size }) + "bc" + cap_key;
+                TextureFormat format;
+                if (m_cache->Load(bc_key, img, mipmap, format)) {
+                    if (i_mipmap == first) img.header.format = format;
+                    if (format == img.header.format) continue;
+                    img.release(mipmap);
+                    mipmap.fill = {};
+                }
+            }
+
+            // mapped payloads without an image container go straight to the upload staging,
+            // copied or lz4 decompressed into it, the file stays open for that
+            if (! view.empty() && ! container && ! transcode && ! shrink) {
+                mipmap.size = LZ4_compressed ? decompressed_size : src_size;
+                mipmap.fill = [pfile, src, src_size, LZ4_compressed](std::span<uint8_t> dst) {
+                    if (LZ4_compressed) {
+                        int load_size = LZ4_decompress_safe(
+                            src, (char*)dst.data(), src_size, (int)dst.size());
+                        return load_size == (int)dst.size();
+                    }
+                    if (dst.size() != (usize)src_size) return false;
+                    std::memcpy(dst.data(), src, dst.size());
+                    return true;
+                };
+                continue;
+            }
 
-            char* result;
-            result = new char[(usize)src_size];
-            file.Read(result, (usize)src_size);
-
-            // is LZ4 compress
-            if (LZ4_compressed) {
-                char* decompressed_char = Lz4Decompress(result, src_size, decompressed_size);
-                src_size                = decompressed_size;
-                if (decompressed_char != nullptr) {
-                    delete[] result;
-                    result = decompressed_char;
-                } else {
+            // is LZ4 compress, raw payloads are decompressed into the image's pixels
+            std::unique_ptr<char[]> decompressed;
+            if (LZ4_compressed && ! container) {
+                auto dst       = img.allocate(mipmap, (usize)decompressed_size);
+                int  load_size = LZ4_decompress_safe(
+                    src, (char*)dst.data(), src_size, decompressed_size);
+                if (load_size < decompressed_size) {
                     LOG_ERROR("lz4 decompress failed");
-                    delete[] result;
                     return nullptr;
                 }
+            } else if (LZ4_compressed) {
+                decompressed.reset(Lz4Decompress(src, src_size, decompressed_size));
+                if (! decompressed) {
+                    LOG_ERROR("lz4 decompress failed");
+                    return nullptr;
+                }
+                src      = decompressed.get();
+                src_size = decompressed_size;
             }
             // is image container
-            if (img.header.extraHeader["texb"].val == 3 && img.header.type != ImageType::UNKNOWN) {
+            std::string cache_key;
+            if (container) {
+                // transcoded ones are cached as bc
+                if (m_cache && ! transcode) {
+                    cache_key = WPTexCache::Key({ src, (usize)src_size }) + cap_key;
+                    TextureFormat format;
+                    if (m_cache->Load(cache_key, img, mipmap, format) &&
+                        format == TextureFormat::RGBA8)
+                        continue;
+                    img.release(mipmap);
+                    mipmap.fill = {};
+                }
                 int32_t w, h, n;
                 auto*   data =
-                    stbi_load_from_memory((const unsigned char*)result, src_size, &w, &h, &n, 4);
-                mipmap.data = ImageDataPtr((uint8_t*)data, [](uint8_t* data) {
-                    stbi_image_free((unsigned char*)data);
-                });
-                src_size    = w * h * 4;
-            } else {
-                mipmap.data = ImageDataPtr(new uint8_t[(usize)src_size], [](uint8_t* data) {
-                    delete[] data;
-                });
-                std::copy(result, result + src_size, mipmap.data.get());
+                    stbi_load_from_memory((const unsigned char*)src, src_size, &w, &h, &n, 4);
+                if (data == nullptr) {
+                    LOG_ERROR("can't decode mipmap of \"%s\"", name.c_str());
+                    return nullptr;
+                }
+                const usize size = (usize)w * (usize)h * 4;
+                std::memcpy(img.allocate(mipmap, size).data(), data, size);
+                stbi_image_free(data);
+                if (w != (shrink ? src_w : mipmap.width) || h != (shrink ? src_h : mipmap.height))
+                    cache_key.clear();
+            } else if (! LZ4_compressed) {
+                std::memcpy(img.allocate(mipmap, (usize)src_size).data(), src, (usize)src_size);
+            }
+            if (shrink) {
+                const usize bpp = container ? 4 : PixelBytes(img.header.format);
+                if (! ShrinkMip(img, mipmap, src_w, src_h, bpp)) {
+                    LOG_ERROR("can't downscale \"%s\" of %dx%d", name.c_str(), src_w, src_h);
+                    return nullptr;
+                }
+            }
+            if (! cache_key.empty())
+                m_cache->Save(cache_key, img, mipmap, TextureFormat::RGBA8);
+
+            if (transcode && ! TranscodeMip(*m_cache, bc_key, img.header.format, img, mipmap)) {
+                if (i_mipmap == first) {
+                    transcode = false;
+                    continue;
+                }
+                // the format is fixed already, the image keeps the mips made so far
+                LOG_ERROR("can't transcode mipmap %d of \"%s\"", (int)i_mipmap, name.c_str());
+                img.release(mipmap);
+                mipmaps.resize(i_mipmap);
+                break;
             }
-            mipmap.size = src_size * (i32)sizeof(uint8_t);
-            delete[] result;
         }
+        mipmaps.erase(mipmaps.begin(), mipmaps.begin() + (isize)std::min(first, mipmaps.size()));
+    }
+    // transcoding may have changed the format, and cut the mips, the size cap sizes the slots
+    utils::hash_combine(img.content, (i32)img.header.format);
+    for (auto& slot : img.slots) {
+        utils::hash_combine(img.content, slot.mipmaps.size());
+        utils::hash_combine(img.content, slot.width);
     }
     return img_ptr;
 }
 
+bool WPTexImageParser::WriteRaw(fs::IBinaryStreamW& file, const Image& img) {
+    const auto& header = img.header;
+    const i32   format = FromTexFormat(header.format);
+    if (! header.fromTex || header.isVideo || format < 0) return false;
+
+    WriteVersion("TEXV", file, header.texv);
+    WriteVersion("TEXI", file, header.texi);
+    file.WriteInt32(format);
+    WPTexFlags flags;
+    flags.set(WPTexFlagEnum::noInterpolation, header.sample.minFilter == TextureFilter::NEAREST);
+    flags.set(WPTexFlagEnum::clampUVs, header.sample.wrapS == TextureWrap::CLAMP_TO_EDGE);
+    flags.set(WPTexFlagEnum::sprite, header.isSprite);
+    flags.set(WPTexFlagEnum::compo1, header.compo1);
+    flags.set(WPTexFlagEnum::compo2, header.compo2);
+    flags.set(WPTexFlagEnum::compo3, header.compo3);
+    file.WriteUint32(flags.value());
+    file.WriteInt32(header.width);
+    file.WriteInt32(header.height);
+    file.WriteInt32(header.mapWidth);
+    file.WriteInt32(header.mapHeight);
+    file.WriteInt32(0);
+    // no image container, the mips are the pixels
+    WriteVersion("TEXB", file, 3);
+    file.WriteInt32((i32)img.slots.size());
+    file.WriteInt32((i32)ImageType::UNKNOWN);
+
+    std::vector<uint8_t> buf;
+    for (auto& slot : img.slots) {
+        file.WriteInt32((i32)slot.mipmaps.size());
+        for (auto& mip : slot.mipmaps) {
+            const uint8_t* data = img.data(mip);
+            if (data == nullptr) {
+                buf.resize((usize)mip.size);
+                if (! mip.fill || ! mip.fill(buf)) return false;
+                data = buf.data();
+            }
+            file.WriteInt32(mip.width);
+            file.WriteInt32(mip.height);
+            file.WriteInt32(0);
+            file.WriteInt32((i32)mip.size);
+            file.WriteInt32((i32)mip.size);
+            file.Write(data, (usize)mip.size);
+        }
+    }
+    if (! header.isSprite) return true;
+
+    // positions and axes in pixels of the frame's image, as LoadHeader reads them
+    const auto& frames = header.spriteAnim.frames();
+    WriteVersion("TEXS", file, 3);
+    file.WriteInt32((i32)frames.size());
+    file.WriteInt32(header.mapWidth);
+    file.WriteInt32(header.mapHeight);
+    for (const auto& f : frames) {
+        if (f.imageId < 0 || (usize)f.imageId >= img.slots.size()) return false;
+        const auto w = (float)img.slots[(usize)f.imageId].width;
+        const auto h = (float)img.slots[(usize)f.imageId].height;
+        file.WriteInt32(f.imageId);
+        file.WriteFloat(f.frametime);
+        file.WriteFloat(f.x * w);
+        file.WriteFloat(f.y * h);
+        file.WriteFloat(f.xAxis[0] * w);
+        file.WriteFloat(f.xAxis[1] * w);
+        file.WriteFloat(f.yAxis[0] * h);
+        file.WriteFloat(f.yAxis[1] * h);
+    }
+    return true;
+}
+
 ImageHeader WPTexImageParser::ParseHeader(const std::string& name) {
     ImageHeader header;
     std::string path = "/assets/materials/" + name + ".tex";
@@ -276,7 +666,17 @@ ImageHeader WPTexImageParser::ParseHeader(const std::string& name) {
                     imageDatas.at(i_image) = { (float)width, (float)height };
                     header.mipmap_pow2     = algorism::IsPowOfTwo((u32)(width * height));
                 }
-                if (header.extraHeader["texb"].val > 1) {
+                if (i_image == 0 && i_mipmap == 0) {
+                    header.mipWidth  = width;
+                    header.mipHeight = height;
+                    header.mipCount  = mipmap_count;
+                    header.layerable = image_count > 1;
+                } else if (i_mipmap == 0 &&
+                           (width != header.mipWidth || height != header.mipHeight ||
+                            mipmap_count != header.mipCount)) {
+                    header.layerable = false;
+                }
+                if (header.texb > 1) {
                     int32_t LZ4_compressed    = file.ReadInt32();
                     int32_t decompressed_size = file.ReadInt32();
                     (void)LZ4_compressed;
@@ -334,11 +734,20 @@ ImageHeader WPTexImageParser::ParseHeader(const std::string& name) {
             header.spriteAnim.AppendFrame(sf);
         }
     } else {
-        i32 mipmap_count = file.ReadInt32();
-        (void)mipmap_count;
-        i32 width  = file.ReadInt32();
-        i32 height = file.ReadInt32();
-        SetHeaderPow2(header, width, height);
+        header.mipCount  = file.ReadInt32();
+        header.mipWidth  = file.ReadInt32();
+        header.mipHeight = file.ReadInt32();
+        SetHeaderPow2(header, header.mipWidth, header.mipHeight);
+        // what decode keeps under the size cap
+        const i32 max = (i32)m_max_size;
+        while (max > 0 && header.mipCount > 1 &&
+               std::max(header.mipWidth, header.mipHeight) > max) {
+            header.mipWidth  = std::max(header.mipWidth / 2, 1);
+            header.mipHeight = std::max(header.mipHeight / 2, 1);
+            header.mipCount--;
+        }
+        if (header.mipCount == 1 && PixelBytes(header.format) > 0)
+            CapSize(header.mipWidth, header.mipHeight, m_max_size);
     }
     return header;
 }
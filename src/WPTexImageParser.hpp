@@ -1,19 +1,45 @@
 #pragma once
 #include "Interface/IImageParser.h"
 #include "Fs/VFS.h"
+#include "Core/MapSet.hpp"
+#include "WPTexCache.hpp"
 
 namespace wallpaper
 {
 
 class WPTexImageParser : public IImageParser {
 public:
-    WPTexImageParser(fs::VFS* vfs): m_vfs(vfs) {}
+    WPTexImageParser(fs::VFS* vfs): m_vfs(vfs), m_cache(WPTexCache::FromVfs(*vfs)) {}
     virtual ~WPTexImageParser() = default;
 
     std::shared_ptr<Image> Parse(const std::string&) override;
     ImageHeader            ParseHeader(const std::string&) override;
+    void                   Preload(const std::string&) override;
+    void                   Preload(std::span<const std::string>,
+                                   std::function<bool()> stop) override;
+    void                   SetTranscode(bool) override;
+    void                   SetMaxSize(u32) override;
+    void                   DropPreloaded() override;
+
+    // the decoded image as a tex of raw mips, which loads without decoding, sprites with their
+    // frames, false for videos, their tex has more than the mips
+    static bool WriteRaw(fs::IBinaryStreamW&, const Image&);
 
 private:
+    // background sized, smaller ones don't save enough to pay for the encode
+    constexpr static i64 MinTranscodePixels { 1024 * 1024 };
+
+    // thread safe, touches nothing but the vfs, read is the tex as VFS::ReadAsync gave it, the
+    // tex is opened here if null
+    std::shared_ptr<Image> Decode(const std::string&,
+                                  std::shared_ptr<fs::IBinaryStream> read = nullptr);
+
     fs::VFS* m_vfs;
+    // decoded png and jpeg mips, null without a cache folder
+    std::unique_ptr<WPTexCache> m_cache;
+    bool                        m_transcode { false };
+    u32                         m_max_size { 0 };
+    // not locked, preloads finish before the scene is handed to the renderer
+    Map<std::string, std::shared_ptr<Image>> m_preloaded;
 };
 } // namespace wallpaper
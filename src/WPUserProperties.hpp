@@ -1,14 +1,40 @@
 #pragma once
 #include <nlohmann/json.hpp>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <optional>
+#include <vector>
 
 #include "Utils/Logging.h"
 
 namespace wallpaper
 {
 
+// What a user property was read for while parsing, a value written to a uniform can be patched
+// into a running scene, anything else takes a reload
+enum class UserPropertyUse
+{
+    Structure,
+    Uniform,
+};
+
+// Set while parsing the values that only end up as uniforms
+inline thread_local UserPropertyUse g_currentUserPropertyUse = UserPropertyUse::Structure;
+
+class UserPropertyUseScope {
+public:
+    explicit UserPropertyUseScope(UserPropertyUse use): m_previous(g_currentUserPropertyUse) {
+        g_currentUserPropertyUse = use;
+    }
+    ~UserPropertyUseScope() { g_currentUserPropertyUse = m_previous; }
+
+private:
+    UserPropertyUse m_previous;
+};
+
+using UserPropertyUses = std::unordered_map<std::string, UserPropertyUse>;
+
 // Stores and provides access to user-configurable properties from project.json
 class WPUserProperties {
 public:
@@ -84,6 +110,8 @@ public:
             return json;
         }
 
+        RecordUse(propName);
+
         // Get the user property value
         auto propValue = GetProperty(propName);
         if (!propValue.has_value()) {
@@ -115,6 +143,33 @@ public:
     // Check if empty
     bool Empty() const { return m_properties.empty(); }
 
+    // Every property read since loading and what for, a structural read wins
+    const UserPropertyUses& Uses() const { return m_uses; }
+
+    // Names whose value differs between two override strings, added and removed ones included
+    // nullopt if one of them doesn't parse
+    static std::optional<std::vector<std::string>> ChangedOverrides(const std::string& a,
+                                                                     const std::string& b) {
+        nlohmann::json ja, jb;
+        try {
+            ja = a.empty() ? nlohmann::json::object() : nlohmann::json::parse(a);
+            jb = b.empty() ? nlohmann::json::object() : nlohmann::json::parse(b);
+        } catch (const nlohmann::json::exception&) {
+            return std::nullopt;
+        }
+        if (!ja.is_object() || !jb.is_object()) return std::nullopt;
+
+        std::vector<std::string> changed;
+        for (auto it = jb.begin(); it != jb.end(); ++it) {
+            auto old = ja.find(it.key());
+            if (old == ja.end() || *old != it.value()) changed.push_back(it.key());
+        }
+        for (auto it = ja.begin(); it != ja.end(); ++it) {
+            if (!jb.contains(it.key())) changed.push_back(it.key());
+        }
+        return changed;
+    }
+
     // Set a single property value (used for overrides)
     void SetProperty(const std::string& name, const nlohmann::json& value) {
         m_properties[name] = value;
@@ -141,7 +196,18 @@ public:
     }
 
 private:
+    void RecordUse(const std::string& name) const {
+        std::lock_guard lock(m_uses_lock);
+        auto [it, inserted] = m_uses.try_emplace(name, g_currentUserPropertyUse);
+        if (!inserted && g_currentUserPropertyUse == UserPropertyUse::Structure)
+            it->second = UserPropertyUse::Structure;
+    }
+
     std::unordered_map<std::string, nlohmann::json> m_properties;
+    // filled while resolving, parsing reads through a const pointer
+    // objects are read on jobs
+    mutable std::mutex       m_uses_lock;
+    mutable UserPropertyUses m_uses;
 };
 
 // Global thread-local pointer to current user properties context
@@ -46,6 +46,17 @@ bool WPImageEffect::IsEffectBlacklisted(const std::string& filePath) {
     return false;
 }
     
+// stock effects, by their folder under effects/
+const std::unordered_set<std::string> WPImageEffect::COSMETIC_EFFECTS = {
+    "shine", "reflection", "chromaticaberration", "filmgrain", "vhs"
+};
+
+bool WPImageEffect::IsEffectCosmetic(const std::string& filePath) {
+    std::filesystem::path dir = std::filesystem::path(filePath).parent_path();
+    return dir.parent_path() == "effects" &&
+           COSMETIC_EFFECTS.find(dir.filename().string()) != COSMETIC_EFFECTS.end();
+}
+
 bool WPImageEffect::FromJson(const nlohmann::json& json, fs::VFS& vfs) {
     std::string filePath;
     GET_JSON_NAME_VALUE(json, "file", filePath);
@@ -54,11 +65,12 @@ bool WPImageEffect::FromJson(const nlohmann::json& json, fs::VFS& vfs) {
         //hide blacklisted effects
         visible = false;
     }
+    cosmetic = IsEffectCosmetic(filePath);
 	GET_JSON_NAME_VALUE_NOWARN(json, "id", id);
-    nlohmann::json jEffect;
-    if(!PARSE_JSON(fs::GetFileContent(vfs, "/assets/" + filePath), jEffect))
+    auto jEffect = PARSE_JSON_FILE_SHARED(vfs, "/assets/" + filePath);
+    if(!jEffect)
         return false;
-    if(!FromFileJson(jEffect, vfs))
+    if(!FromFileJson(*jEffect, vfs))
         return false;
 
     if(json.contains("passes")) {
@@ -104,11 +116,11 @@ bool WPImageEffect::FromFileJson(const nlohmann::json& json, fs::VFS& vfs) {
             }
             std::string matPath;
             GET_JSON_NAME_VALUE(jP, "material", matPath);
-            nlohmann::json jMat;
-            if(!PARSE_JSON(fs::GetFileContent(vfs, "/assets/" + matPath), jMat))
+            auto jMat = PARSE_JSON_FILE_SHARED(vfs, "/assets/" + matPath);
+            if(!jMat)
                 return false;
             WPMaterial material;
-            material.FromJson(jMat);
+            material.FromJson(*jMat);
             materials.push_back(std::move(material));
             WPMaterialPass pass;
             pass.FromJson(jP);
@@ -138,11 +150,12 @@ bool WPImageObject::FromJson(const nlohmann::json& json, fs::VFS& vfs) {
     GET_JSON_NAME_VALUE(json, "image", image);
     GET_JSON_NAME_VALUE_NOWARN(json, "visible", visible);
     GET_JSON_NAME_VALUE_NOWARN(json, "alignment", alignment);
-    nlohmann::json jImage;
-    if(!PARSE_JSON(fs::GetFileContent(vfs, "/assets/" + image), jImage)) {
+    auto pImage = PARSE_JSON_FILE_SHARED(vfs, "/assets/" + image);
+    if(!pImage) {
         LOG_ERROR("Can't load image json: %s", image.c_str());
         return false;
     }
+    const auto& jImage = *pImage;
     GET_JSON_NAME_VALUE_NOWARN(jImage, "fullscreen", fullscreen);
 	GET_JSON_NAME_VALUE_NOWARN(json, "name", name);
 	GET_JSON_NAME_VALUE_NOWARN(json, "id", id);
@@ -172,12 +185,12 @@ bool WPImageObject::FromJson(const nlohmann::json& json, fs::VFS& vfs) {
     if(jImage.contains("material")) {
         std::string matPath;
 		GET_JSON_NAME_VALUE(jImage, "material", matPath);	
-        nlohmann::json jMat;
-        if(!PARSE_JSON(fs::GetFileContent(vfs, "/assets/" + matPath), jMat)) {
+        auto jMat = PARSE_JSON_FILE_SHARED(vfs, "/assets/" + matPath);
+        if(!jMat) {
             LOG_ERROR("Can't load material json: %s", matPath.c_str());
             return false;
         }
-        material.FromJson(jMat);
+        material.FromJson(*jMat);
     } else {
         LOG_INFO("image object no material");
         return false;
@@ -39,13 +39,17 @@ public:
 class WPImageEffect {
 private:
     static const std::unordered_set<std::string> BLACKLISTED_WORKSHOP_EFFECTS;
+    static const std::unordered_set<std::string> COSMETIC_EFFECTS;
     bool IsEffectBlacklisted(const std::string& filePath);
+    bool IsEffectCosmetic(const std::string& filePath);
 public:
     bool                         FromJson(const nlohmann::json&, fs::VFS& vfs);
     bool                         FromFileJson(const nlohmann::json&, fs::VFS& vfs);
     int32_t                      id;
     std::string                  name;
     bool                         visible { true };
+    // only adds sheen, grain or the like, left out at low quality
+    bool                         cosmetic { false };
     int32_t                      version;
     std::vector<WPMaterial>      materials;
     std::vector<WPMaterialPass>  passes;
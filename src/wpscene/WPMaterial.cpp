@@ -1,4 +1,5 @@
 #include "WPMaterial.h"
+#include "WPUserProperties.hpp"
 
 using namespace wallpaper::wpscene;
 
@@ -55,6 +56,8 @@ bool WPMaterialPass::FromJson(const nlohmann::json& json) {
         }
     }
     if(json.contains("constantshadervalues")) {
+        // only uniforms, a change of these is patched in place
+        UserPropertyUseScope use(UserPropertyUse::Uniform);
         for(const auto& jC:json.at("constantshadervalues").items()) {
             std::string name;
             std::vector<float> value;
@@ -107,6 +110,7 @@ bool WPMaterial::FromJson(const nlohmann::json& json) {
         }
     }
     if(jContent.contains("constantshadervalues")) {
+        UserPropertyUseScope use(UserPropertyUse::Uniform);
         for(const auto& jC:jContent.at("constantshadervalues").items()) {
             std::string name;
             std::vector<float> value;
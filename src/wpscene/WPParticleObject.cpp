@@ -14,10 +14,10 @@ bool ParticleChild::FromJson(const nlohmann::json& json, fs::VFS& vfs) {
         return false;
     }
 
-    nlohmann::json jParticle;
-    if (! PARSE_JSON(fs::GetFileContent(vfs, "/assets/" + name), jParticle)) return false;
+    auto jParticle = PARSE_JSON_FILE_SHARED(vfs, "/assets/" + name);
+    if (! jParticle) return false;
 
-    if (! obj.FromJson(jParticle, vfs)) return false;
+    if (! obj.FromJson(*jParticle, vfs)) return false;
 
     GET_JSON_NAME_VALUE_NOWARN(json, "maxcount", maxcount);
     GET_JSON_NAME_VALUE_NOWARN(json, "controlpointstartindex", controlpointstartindex);
@@ -157,9 +157,9 @@ bool Particle::FromJson(const nlohmann::json& json, fs::VFS& vfs) {
     if (json.contains("material")) {
         std::string matPath;
         GET_JSON_NAME_VALUE(json, "material", matPath);
-        nlohmann::json jMat;
-        if (! PARSE_JSON(fs::GetFileContent(vfs, "/assets/" + matPath), jMat)) return false;
-        material.FromJson(jMat);
+        auto jMat = PARSE_JSON_FILE_SHARED(vfs, "/assets/" + matPath);
+        if (! jMat) return false;
+        material.FromJson(*jMat);
     } else {
         LOG_ERROR("particle object no material");
         return false;
@@ -192,8 +192,8 @@ bool WPParticleObject::FromJson(const nlohmann::json& json, fs::VFS& vfs) {
         instanceoverride.FromJosn(json.at("instanceoverride"));
     }
 
-    nlohmann::json jParticle;
-    if (! PARSE_JSON(fs::GetFileContent(vfs, "/assets/" + particle), jParticle)) return false;
-    if (! particleObj.FromJson(jParticle, vfs)) return false;
+    auto jParticle = PARSE_JSON_FILE_SHARED(vfs, "/assets/" + particle);
+    if (! jParticle) return false;
+    if (! particleObj.FromJson(*jParticle, vfs)) return false;
     return true;
 }
@@ -11,6 +11,8 @@ constexpr std::string_view OPT_GRAPHVIZ    = "--graphviz";
 constexpr std::string_view OPT_FPS         = "--fps";
 constexpr std::string_view OPT_RESOLUTION  = "--resolution";
 constexpr std::string_view OPT_CACHE_PATH  = "--cache-path";
+constexpr std::string_view OPT_PRESENT     = "--present-mode";
+constexpr std::string_view OPT_SWAP_IMAGES = "--swapchain-images";
 
 struct Resolution {
 	uint w;
@@ -50,6 +52,17 @@ void setAndParseArg(argparse::ArgumentParser& arg, int argc, char** argv) {
         .nargs(1)
         .append();
 
+    arg.add_argument(OPT_PRESENT)
+        .help("fifo, fifo-relaxed, mailbox or immediate")
+        .default_value(std::string("fifo"))
+        .nargs(1);
+
+    arg.add_argument(OPT_SWAP_IMAGES)
+        .help("swapchain images, 0 for one more than the surface's minimum")
+        .default_value<int32_t>(0)
+        .nargs(1)
+        .scan<'i', int32_t>();
+
     arg.add_argument("-R", OPT_RESOLUTION)
         .help("Set the resolution, eg. 1920x1080")
         .default_value(Resolution{1280, 720})
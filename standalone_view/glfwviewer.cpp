@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <set>
 #include <fstream>
@@ -60,6 +61,18 @@ int main(int argc, char** argv) {
     info.enable_valid_layer = program.get<bool>(OPT_VALID_LAYER);
     info.width              = w_width;
     info.height             = w_height;
+    info.swapchain_images   = (uint8_t)std::clamp(program.get<int32_t>(OPT_SWAP_IMAGES), 0, 8);
+    {
+        auto mode = program.get<std::string>(OPT_PRESENT);
+        if (mode == "fifo-relaxed")
+            info.present_mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+        else if (mode == "mailbox")
+            info.present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+        else if (mode == "immediate")
+            info.present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        else if (mode != "fifo")
+            std::cerr << "unknown present mode " << mode << ", use fifo" << std::endl;
+    }
 
     auto& sf_info = info.surface_info;
     {
@@ -84,16 +97,16 @@ int main(int argc, char** argv) {
     data.psw  = psw;
 
     psw->init();
+    // before vulkan, the device picked last time is cached there
+    std::string cache_path = program.get<std::string>(OPT_CACHE_PATH);
+    if (cache_path.empty()) cache_path = wallpaper::platform::GetCachePath("wescene-renderer");
+    psw->setPropertyString(wallpaper::PROPERTY_CACHE_PATH, cache_path);
     psw->initVulkan(info);
     psw->setPropertyString(wallpaper::PROPERTY_ASSETS, program.get<std::string>(ARG_ASSETS));
     psw->setPropertyString(wallpaper::PROPERTY_SOURCE, program.get<std::string>(ARG_SCENE));
     psw->setPropertyBool(wallpaper::PROPERTY_GRAPHIVZ, program.get<bool>(OPT_GRAPHVIZ));
     psw->setPropertyInt32(wallpaper::PROPERTY_FPS, program.get<int32_t>(OPT_FPS));
 
-    std::string cache_path = program.get<std::string>(OPT_CACHE_PATH);
-    if (cache_path.empty()) cache_path = wallpaper::platform::GetCachePath("wescene-renderer");
-    psw->setPropertyString(wallpaper::PROPERTY_CACHE_PATH, cache_path);
-
     glfwSetWindowUserPointer(window, &data);
 
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);